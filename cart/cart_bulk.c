@@ -0,0 +1,328 @@
+/**
+ * @file cart_bulk.c
+ * @brief Transferts de masse : fenêtre glissante dans les trames libres, reprise par offset.
+ * @ingroup cart
+ */
+
+#include "cart_bulk.h"
+#include "spilink_frame.h"
+#include <string.h>
+
+BRICK_STATIC_ASSERT(CART_BULK_BEGIN_BYTES <= CART_MSG_MAX_BYTES, cart_bulk_begin_fits);
+BRICK_STATIC_ASSERT(CART_BULK_WINDOW >= CART_BULK_CHUNK, cart_bulk_window_holds_chunk);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    cart_bulk_state_t state;
+    bool           ready;         /* Slot prêt (événements du gestionnaire). */
+    uint8_t        id;
+    uint8_t        kind;
+    const uint8_t *data;
+    uint32_t       size;
+    uint32_t       crc;
+
+    uint32_t       sent;          /* Prochain offset à émettre. */
+    uint32_t       high;          /* Plus grand offset déjà émis. */
+    uint32_t       acked;
+    uint8_t        interval;
+    uint8_t        skip;
+    uint8_t        retries;       /* Délais consécutifs sans progrès. */
+    bool           begin_due;
+    bool           abort_pending;
+    uint8_t        abort_id;
+    systime_t      last;          /* Dernier progrès (ou émission d'ouverture). */
+
+    systime_t      t_open;
+    uint32_t       acked_base;
+    uint32_t       bytes_per_s;   /* Figé en fin de transfert. */
+
+    cart_bulk_status_t stats;
+} cart_bulk_slot_t;
+
+static cart_bulk_slot_t cart_bulk[BRICK_MAX_CARTRIDGES];
+static uint8_t cart_bulk_next_id = 0U;
+
+/* -------------------------------------------------------------------------- */
+/* Émission (thread audio)                                                    */
+/* -------------------------------------------------------------------------- */
+
+/* Sous verrou. */
+static uint32_t cart_bulk_rate(const cart_bulk_slot_t *sl) {
+    const uint32_t ms = (uint32_t)TIME_I2MS(chVTTimeElapsedSinceX(sl->t_open));
+    if (ms == 0U) {
+        return 0U;
+    }
+    return (uint32_t)(((uint64_t)(sl->acked - sl->acked_base) * 1000U) / ms);
+}
+
+/* Sous verrou. */
+static void cart_bulk_fail(cart_bulk_slot_t *sl) {
+    sl->state = CART_BULK_FAILED;
+    sl->data = NULL;
+}
+
+/* Sous verrou : ouverture, éventuellement réémise après délai. */
+static size_t cart_bulk_emit_begin(cart_bulk_slot_t *sl, uint8_t *msg) {
+    if (!sl->begin_due) {
+        if (chVTTimeElapsedSinceX(sl->last) < TIME_MS2I(CART_BULK_TIMEOUT_MS)) {
+            return 0U;
+        }
+        if (++sl->retries > CART_BULK_RETRIES) {
+            cart_bulk_fail(sl);
+            return 0U;
+        }
+    }
+    sl->begin_due = false;
+    sl->last = chVTGetSystemTimeX();
+
+    msg[0] = CART_MSG_BULK_BEGIN;
+    msg[1] = sl->id;
+    msg[2] = sl->kind;
+    cart_proto_put32(&msg[3], sl->size);
+    cart_proto_put32(&msg[7], sl->crc);
+    return CART_BULK_BEGIN_BYTES;
+}
+
+/* Sous verrou : prochain morceau de la fenêtre. */
+static size_t cart_bulk_emit_data(cart_bulk_slot_t *sl, uint8_t *msg) {
+    /* Sans accusé : reprise au dernier offset confirmé (au dernier octet si tout l'est). */
+    if (((sl->sent > sl->acked) || (sl->acked == sl->size)) &&
+        (chVTTimeElapsedSinceX(sl->last) >= TIME_MS2I(CART_BULK_TIMEOUT_MS))) {
+        if (++sl->retries > CART_BULK_RETRIES) {
+            cart_bulk_fail(sl);
+            return 0U;
+        }
+        sl->sent = (sl->acked == sl->size) ? (sl->size - 1U) : sl->acked;
+        sl->last = chVTGetSystemTimeX();
+        sl->stats.rewinds++;
+    }
+
+    if ((sl->sent >= sl->size) || ((sl->sent - sl->acked) >= CART_BULK_WINDOW)) {
+        return 0U;
+    }
+    if (sl->skip > 0U) {
+        sl->skip--;
+        return 0U;
+    }
+    sl->skip = (uint8_t)(sl->interval - 1U);
+
+    uint32_t n = sl->size - sl->sent;
+    if (n > CART_BULK_CHUNK) {
+        n = CART_BULK_CHUNK;
+    }
+    msg[0] = CART_MSG_BULK_DATA;
+    msg[1] = sl->id;
+    cart_proto_put32(&msg[2], sl->sent);
+    memcpy(&msg[CART_BULK_DATA_HDR], &sl->data[sl->sent], n);
+
+    if (sl->sent < sl->high) {
+        sl->stats.resent_bytes += (sl->high - sl->sent < n) ? (sl->high - sl->sent) : n;
+    }
+    if (sl->sent == sl->acked) {
+        sl->last = chVTGetSystemTimeX();    /* Le délai court depuis le premier octet en vol. */
+    }
+    sl->sent += n;
+    if (sl->sent > sl->high) {
+        sl->high = sl->sent;
+    }
+    sl->stats.sent_bytes += n;
+    return CART_BULK_DATA_HDR + n;
+}
+
+/* Transport, push du thread audio : trame sans contrôle ni mise à jour. */
+static size_t cart_bulk_idle(uint8_t cart, uint8_t *msg, size_t max) {
+    if ((cart >= BRICK_MAX_CARTRIDGES) || (max < CART_MSG_MAX_BYTES)) {
+        return 0U;
+    }
+    cart_bulk_slot_t *sl = &cart_bulk[cart];
+    size_t len = 0U;
+
+    chSysLock();
+    if (sl->abort_pending) {
+        sl->abort_pending = false;
+        msg[0] = CART_MSG_BULK_ABORT;
+        msg[1] = sl->abort_id;
+        len = 2U;
+    } else if (sl->ready && (sl->state == CART_BULK_OPENING)) {
+        len = cart_bulk_emit_begin(sl, msg);
+    } else if (sl->ready && (sl->state == CART_BULK_ACTIVE)) {
+        len = cart_bulk_emit_data(sl, msg);
+    }
+    chSysUnlock();
+    return len;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Accusés (thread du gestionnaire)                                           */
+/* -------------------------------------------------------------------------- */
+
+/* Sous verrou. */
+static void cart_bulk_ack(cart_bulk_slot_t *sl, uint32_t off, uint8_t status) {
+    const systime_t now = chVTGetSystemTimeX();
+
+    if (status == CART_BULK_ACK_ERROR) {
+        cart_bulk_fail(sl);
+        return;
+    }
+    if (status == CART_BULK_ACK_BUSY) {
+        sl->last = now;
+        sl->retries = 0U;
+        return;
+    }
+
+    if (sl->state == CART_BULK_OPENING) {
+        if (off > sl->size) {
+            cart_bulk_fail(sl);
+            return;
+        }
+        if (off > 0U) {
+            sl->stats.resumes++;
+        }
+        sl->state = CART_BULK_ACTIVE;
+        sl->sent = off;
+        sl->acked = off;
+        sl->acked_base = off;
+        sl->t_open = now;
+        sl->skip = 0U;
+        sl->retries = 0U;
+        sl->last = now;
+    } else if ((off > sl->acked) && (off <= sl->high)) {
+        sl->acked = off;
+        sl->retries = 0U;
+        sl->last = now;
+        if (sl->sent < off) {
+            sl->sent = off;
+        }
+    }
+
+    if (status == CART_BULK_ACK_DONE) {
+        if ((sl->state == CART_BULK_ACTIVE) && (off == sl->size)) {
+            sl->bytes_per_s = cart_bulk_rate(sl);
+            sl->state = CART_BULK_DONE;
+            sl->data = NULL;
+        }
+    } else if ((status == CART_BULK_ACK_GAP) && (off == sl->acked) && (sl->sent > off)) {
+        sl->sent = off;
+        sl->stats.rewinds++;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void cart_bulk_init(const spilink_link_ops_t *link) {
+    memset(cart_bulk, 0, sizeof(cart_bulk));
+    if (link != NULL) {
+        link->set_ctrl_idle_cb(cart_bulk_idle);
+    }
+}
+
+void cart_bulk_slot_event(uint8_t slot, cart_slot_state_t state) {
+    if (slot >= BRICK_MAX_CARTRIDGES) {
+        return;
+    }
+    cart_bulk_slot_t *sl = &cart_bulk[slot];
+
+    chSysLock();
+    sl->ready = (state == CART_SLOT_READY);
+    sl->abort_pending = false;
+    if (sl->ready) {
+        if ((sl->state == CART_BULK_SUSPENDED) || (sl->state == CART_BULK_OPENING) ||
+            (sl->state == CART_BULK_ACTIVE)) {
+            sl->state = CART_BULK_OPENING;
+            sl->begin_due = true;
+            sl->retries = 0U;
+        }
+    } else if ((sl->state == CART_BULK_OPENING) || (sl->state == CART_BULK_ACTIVE)) {
+        sl->state = CART_BULK_SUSPENDED;
+        sl->sent = sl->acked;
+    }
+    chSysUnlock();
+}
+
+void cart_bulk_on_msg(uint8_t slot, const uint8_t *msg, size_t len) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (msg == NULL) || (len < CART_BULK_ACK_BYTES) ||
+        (msg[0] != CART_MSG_BULK_ACK)) {
+        return;
+    }
+    cart_bulk_slot_t *sl = &cart_bulk[slot];
+
+    chSysLock();
+    if ((msg[1] == sl->id) &&
+        ((sl->state == CART_BULK_OPENING) || (sl->state == CART_BULK_ACTIVE))) {
+        cart_bulk_ack(sl, cart_proto_get32(&msg[2]), msg[6]);
+    }
+    chSysUnlock();
+}
+
+bool cart_bulk_start(uint8_t slot, uint8_t kind, const uint8_t *data, uint32_t size,
+                     uint8_t interval) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (data == NULL) || (size == 0U) || (interval == 0U)) {
+        return false;
+    }
+    cart_bulk_slot_t *sl = &cart_bulk[slot];
+
+    chSysLock();
+    const bool busy = (sl->state == CART_BULK_OPENING) || (sl->state == CART_BULK_ACTIVE) ||
+                      (sl->state == CART_BULK_SUSPENDED);
+    chSysUnlock();
+    if (busy) {
+        return false;
+    }
+
+    /* Hors verrou : le slot est inactif, seul l'appelant le démarre. */
+    const uint32_t crc = spilink_frame_crc_sw(data, size);
+
+    chSysLock();
+    const bool ready = sl->ready;
+    memset(sl, 0, sizeof(*sl));
+    sl->ready = ready;
+    sl->id = cart_bulk_next_id++;
+    sl->kind = kind;
+    sl->data = data;
+    sl->size = size;
+    sl->crc = crc;
+    sl->interval = interval;
+    sl->begin_due = true;
+    sl->state = ready ? CART_BULK_OPENING : CART_BULK_SUSPENDED;
+    chSysUnlock();
+    return true;
+}
+
+void cart_bulk_abort(uint8_t slot) {
+    if (slot >= BRICK_MAX_CARTRIDGES) {
+        return;
+    }
+    cart_bulk_slot_t *sl = &cart_bulk[slot];
+
+    chSysLock();
+    if ((sl->state == CART_BULK_OPENING) || (sl->state == CART_BULK_ACTIVE) ||
+        (sl->state == CART_BULK_SUSPENDED)) {
+        sl->abort_pending = sl->ready;
+        sl->abort_id = sl->id;
+        sl->state = CART_BULK_IDLE;
+        sl->data = NULL;
+    }
+    chSysUnlock();
+}
+
+void cart_bulk_get_status(uint8_t slot, cart_bulk_status_t *st) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (st == NULL)) {
+        return;
+    }
+    const cart_bulk_slot_t *sl = &cart_bulk[slot];
+
+    chSysLock();
+    *st = sl->stats;
+    st->state = sl->state;
+    st->kind = sl->kind;
+    st->size = sl->size;
+    st->acked = sl->acked;
+    st->percent = (sl->size > 0U) ? (uint8_t)(((uint64_t)sl->acked * 100U) / sl->size) : 0U;
+    st->bytes_per_s = (sl->state == CART_BULK_ACTIVE) ? cart_bulk_rate(sl) : sl->bytes_per_s;
+    chSysUnlock();
+}
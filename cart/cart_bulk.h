@@ -0,0 +1,82 @@
+/**
+ * @file cart_bulk.h
+ * @brief Transferts de masse vers les cartouches (firmware, tables d'onde, échantillons).
+ * @details Les données passent par le champ de contrôle des trames SPI-LINK
+ * que rien d'autre n'occupe (trafic de fond du transport, spilink_link.h) : messages du
+ * gestionnaire, notes et paramètres (cart_params) passent toujours avant,
+ * et l'audio a sa place fixe dans la trame. La lecture n'est jamais
+ * interrompue ; au mieux CART_BULK_CHUNK octets par bloc et par cartouche
+ * (~72 ko/s à 48 kHz), moins le trafic de contrôle. `interval` bride encore
+ * le débit : un morceau toutes les `interval` trames libres.
+ *
+ * Protocole (cart_proto.h) : ouverture avec taille et CRC du contenu, puis
+ * morceaux adressés par offset, fenêtre de CART_BULK_WINDOW octets non
+ * acquittés. Sur trou signalé par la cartouche ou faute d'accusé après
+ * CART_BULK_TIMEOUT_MS, l'émission reprend au dernier offset acquitté ;
+ * après CART_BULK_RETRIES délais sans progrès, le transfert échoue. Un
+ * retrait suspend le transfert : à la réinsertion, la réouverture reprend à
+ * l'offset annoncé par la cartouche.
+ *
+ * Le contenu reste lu en place (flash ou RAM) jusqu'à la fin du transfert.
+ * Un transfert à la fois par cartouche. Émission depuis le thread audio,
+ * accusés depuis le thread du gestionnaire, API depuis n'importe quel
+ * thread : sections critiques courtes.
+ *
+ * @ingroup cart
+ */
+
+#ifndef CART_BULK_H
+#define CART_BULK_H
+
+#include "ch.h"
+#include "cart_manager.h"
+
+#define CART_BULK_WINDOW              512U    /* Octets émis non acquittés. */
+#define CART_BULK_TIMEOUT_MS          20U
+#define CART_BULK_RETRIES             10U
+
+typedef enum {
+    CART_BULK_IDLE = 0,
+    CART_BULK_OPENING,        /* Ouverture émise, offset de reprise attendu. */
+    CART_BULK_ACTIVE,
+    CART_BULK_SUSPENDED,      /* Cartouche absente : reprise à la réinsertion. */
+    CART_BULK_DONE,
+    CART_BULK_FAILED
+} cart_bulk_state_t;
+
+typedef struct {
+    cart_bulk_state_t state;
+    uint8_t  kind;            /* CART_BULK_FIRMWARE, _WAVETABLE, _SAMPLE. */
+    uint8_t  percent;
+    uint32_t size;
+    uint32_t acked;           /* Octets confirmés par la cartouche. */
+    uint32_t sent_bytes;      /* Octets émis, réémissions comprises. */
+    uint32_t resent_bytes;
+    uint32_t rewinds;         /* Reprises sur trou ou délai. */
+    uint32_t resumes;         /* Ouvertures reprises à un offset non nul. */
+    uint32_t bytes_per_s;     /* Débit utile depuis la dernière (ré)ouverture. */
+} cart_bulk_status_t;
+
+/* S'accroche aux trames libres du transport `link` (voir cart_manager_init). */
+void cart_bulk_init(const spilink_link_ops_t *link);
+
+/* Suit l'état des slots (callback d'événement du gestionnaire). */
+void cart_bulk_slot_event(uint8_t slot, cart_slot_state_t state);
+
+/* Messages de la cartouche (callback de messages du gestionnaire) ; ignore ce qui n'est pas un accusé. */
+void cart_bulk_on_msg(uint8_t slot, const uint8_t *msg, size_t len);
+
+/*
+ * Démarre un transfert (remplace un transfert terminé ou échoué) ; false si
+ * un transfert est en cours sur le slot, si `size` est nul ou `interval`
+ * nul. Le CRC du contenu est calculé ici, dans le thread appelant.
+ */
+bool cart_bulk_start(uint8_t slot, uint8_t kind, const uint8_t *data, uint32_t size,
+                     uint8_t interval);
+
+/* Abandonne le transfert du slot (message d'abandon si la cartouche est prête). */
+void cart_bulk_abort(uint8_t slot);
+
+void cart_bulk_get_status(uint8_t slot, cart_bulk_status_t *st);
+
+#endif /* CART_BULK_H */
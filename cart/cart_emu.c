@@ -0,0 +1,682 @@
+/**
+ * @file cart_emu.c
+ * @brief Émulation de cartouches : trames réelles, signaux de test, défauts injectés.
+ * @ingroup cart
+ */
+
+#include "cart_emu.h"
+#include "spilink_conceal.h"
+#include <string.h>
+
+#define EMU_RING              16U     /* Puissance de 2, > CART_EMU_MAX_DELAY. */
+#define EMU_TYPE_ID           0xEE01U
+#define EMU_NAME              "EMULATOR"
+#define EMU_PARAM_MIN         (-8192)
+#define EMU_PARAM_MAX         8191
+#define EMU_BULK_ACK_EVERY    96U     /* Octets reçus entre deux accusés. */
+
+BRICK_STATIC_ASSERT(CART_EMU_MAX_DELAY < EMU_RING, cart_emu_ring_covers_delay);
+BRICK_STATIC_ASSERT((EMU_RING & (EMU_RING - 1U)) == 0U, cart_emu_ring_pow2);
+BRICK_STATIC_ASSERT(CART_MSG_MAX_BYTES == SPILINK_CTRL_PAYLOAD, cart_emu_msg_fits_frame);
+BRICK_STATIC_ASSERT(SPILINK_CHANNELS == SPILINK_CONCEAL_CHANNELS, cart_emu_conceal_channels);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+/* Trame cartouche -> H7 en transit, livrée au pull du bloc `due`. */
+typedef struct {
+    uint8_t  bytes[SPILINK_BUFFER_BYTES] __attribute__((aligned(4)));
+    uint32_t due;
+    bool     valid;
+} emu_slot_t;
+
+/* Réception de masse : seuls taille, progression et CRC sont conservés. */
+typedef struct {
+    bool     open;
+    bool     done;
+    bool     gap;             /* Trou déjà signalé. */
+    uint8_t  id;
+    uint8_t  kind;
+    uint32_t size;
+    uint32_t crc;
+    uint32_t next;
+    uint32_t run;
+    uint32_t acked;
+} emu_bulk_t;
+
+/* Présence vue du H7 (comme drv_spilink) : survit au retrait, perdue au silence. */
+typedef struct {
+    bool     linked;
+    uint8_t  count;           /* Trames valides consécutives, ou blocs sans trame neuve. */
+    uint32_t ups;
+    uint32_t downs;
+} emu_link_t;
+
+typedef struct {
+    cart_emu_config_t cfg;
+
+    /* Côté H7 : présence, numéros, masquage, files de contrôle (comme drv_spilink). */
+    emu_link_t link;
+    uint8_t  tx_seq;
+    uint8_t  rx_seq;
+    bool     rx_seq_valid;
+    spilink_conceal_t conceal;
+    bool     ctrl_tx_pending;
+    uint8_t  ctrl_tx_len;
+    uint8_t  ctrl_tx[SPILINK_CTRL_PAYLOAD];
+    uint8_t  ctrl_rx[CART_EMU_CTRL_DEPTH][SPILINK_CTRL_PAYLOAD + 1U];
+    uint8_t  ctrl_rx_rd;
+    uint8_t  ctrl_rx_count;
+
+    /* Côté cartouche : générateur, dernier audio reçu, réponses, paramètres. */
+    uint8_t  cart_seq;
+    bool     loop;                /* CART_MSG_LOOPBACK : bouclage imposé. */
+    uint32_t phase;
+    uint32_t phase_inc;
+    int32_t  in[BRICK_AUDIO_FRAME_SAMPLES][SPILINK_CHANNELS];
+    uint8_t  reply[CART_EMU_CTRL_DEPTH][SPILINK_CTRL_PAYLOAD + 1U];
+    uint8_t  reply_rd;
+    uint8_t  reply_count;
+    int16_t  params[CART_EMU_MAX_PARAMS];
+
+    emu_bulk_t bulk;
+
+    emu_slot_t ring[EMU_RING];
+    uint32_t next_flip;       /* Bits avant la prochaine erreur binaire. */
+
+    cart_emu_stats_t stats;
+} emu_cart_t;
+
+static emu_cart_t emu_cart[BRICK_MAX_CARTRIDGES];
+static uint8_t emu_wire[SPILINK_BUFFER_BYTES] __attribute__((aligned(4)));
+static uint32_t emu_block = 0U;
+static uint32_t emu_rng = 1U;
+static cart_emu_ctrl_fill_cb_t emu_fill_cb = NULL;
+static cart_emu_ctrl_fill_cb_t emu_idle_cb = NULL;
+static spilink_link_cb_t emu_link_cb = NULL;
+
+/* -------------------------------------------------------------------------- */
+/* Outils                                                                     */
+/* -------------------------------------------------------------------------- */
+
+static uint32_t emu_rand(void) {
+    uint32_t x = emu_rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emu_rng = x;
+    return x;
+}
+
+/* Écart jusqu'à la prochaine erreur : uniforme, de moyenne 10^6 / ppm bits. */
+static uint32_t emu_flip_gap(uint32_t ber_ppm) {
+    const uint32_t mean = (ber_ppm >= 1000000U) ? 1U : (1000000U / ber_ppm);
+    return 1U + (emu_rand() % (2U * mean - 1U));
+}
+
+static void emu_corrupt(emu_cart_t *ec, uint8_t *bytes, size_t len) {
+    const uint32_t bits = (uint32_t)len * 8U;
+
+    if (ec->cfg.ber_ppm == 0U) {
+        return;
+    }
+    while (ec->next_flip < bits) {
+        bytes[ec->next_flip >> 3] ^= (uint8_t)(0x80U >> (ec->next_flip & 7U));
+        ec->stats.bit_flips++;
+        ec->next_flip += emu_flip_gap(ec->cfg.ber_ppm);
+    }
+    ec->next_flip -= bits;
+}
+
+/* Sinus Q23 d'une phase Q32 : parabole corrigée (erreur < 0,1 %). */
+static int32_t emu_sine(uint32_t phase) {
+    const int32_t x = (int32_t)phase;                 /* Q31 de x / pi. */
+    const int64_t ax = (x < 0) ? -(int64_t)x : (int64_t)x;
+    int64_t y = (((int64_t)x * (((int64_t)1 << 31) - ax)) >> 31) * 4;
+    const int64_t ay = (y < 0) ? -y : y;
+    y += (((((y * ay) >> 31) - y)) * 14746) >> 16;    /* 0,225 en Q16. */
+    return (int32_t)(y >> 8);
+}
+
+static int32_t emu_scale(int32_t x, int32_t level) {
+    return (int32_t)(((int64_t)x * level) >> 23);
+}
+
+static void emu_queue_put(uint8_t (*queue)[SPILINK_CTRL_PAYLOAD + 1U], uint8_t rd, uint8_t *count,
+                          const uint8_t *msg, size_t len) {
+    if ((len == 0U) || (len > SPILINK_CTRL_PAYLOAD) || (*count >= CART_EMU_CTRL_DEPTH)) {
+        return;
+    }
+    uint8_t *q = queue[(rd + *count) % CART_EMU_CTRL_DEPTH];
+    q[0] = (uint8_t)len;
+    memcpy(&q[1], msg, len);
+    (*count)++;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Cartouche émulée                                                           */
+/* -------------------------------------------------------------------------- */
+
+static void emu_cart_reply(emu_cart_t *ec, const uint8_t *msg, size_t len) {
+    emu_queue_put(ec->reply, ec->reply_rd, &ec->reply_count, msg, len);
+}
+
+static void emu_cart_caps(emu_cart_t *ec, const uint8_t *msg, size_t len) {
+    uint8_t out[CART_MSG_MAX_BYTES];
+
+    if ((len >= 2U) && (msg[1] == CART_CAPS_PAGE_HDR)) {
+        memset(out, 0, sizeof(out));
+        out[0] = CART_MSG_CAPS_HDR;
+        out[1] = CART_PROTO_VERSION;
+        cart_proto_put16(&out[2], EMU_TYPE_ID);
+        out[4] = 1U;
+        out[5] = 0U;
+        out[6] = ec->cfg.voices;
+        out[7] = SPILINK_CHANNELS;
+        out[8] = SPILINK_CHANNELS;
+        cart_proto_put16(&out[9], ec->cfg.param_count);
+        memcpy(&out[11], EMU_NAME, sizeof(EMU_NAME) - 1U);
+        emu_cart_reply(ec, out, CART_CAPS_HDR_BYTES);
+    } else if ((len >= 4U) && (msg[1] == CART_CAPS_PAGE_PARAMS)) {
+        const uint16_t first = cart_proto_get16(&msg[2]);
+        if (first >= ec->cfg.param_count) {
+            return;
+        }
+        uint16_t n = (uint16_t)(ec->cfg.param_count - first);
+        if (n > CART_CAPS_PARAMS_PER_MSG) {
+            n = CART_CAPS_PARAMS_PER_MSG;
+        }
+        out[0] = CART_MSG_CAPS_PARAMS;
+        cart_proto_put16(&out[1], first);
+        out[3] = (uint8_t)n;
+        uint8_t *p = &out[4];
+        for (uint16_t i = 0U; i < n; ++i) {
+            cart_proto_put16(&p[0], (uint16_t)EMU_PARAM_MIN);
+            cart_proto_put16(&p[2], (uint16_t)EMU_PARAM_MAX);
+            cart_proto_put16(&p[4], 0U);
+            p[6] = CART_PARAM_PLOCK | CART_PARAM_MOD;
+            p += CART_CAPS_PARAM_BYTES;
+        }
+        emu_cart_reply(ec, out, 4U + ((size_t)n * CART_CAPS_PARAM_BYTES));
+    }
+}
+
+static void emu_cart_update(emu_cart_t *ec, const uint8_t *msg, size_t len) {
+    for (size_t i = 1U; (i + CART_REC_BYTES) <= len; i += CART_REC_BYTES) {
+        if ((msg[i] & CART_REC_NOTE) != 0U) {
+            ec->stats.notes_rx++;
+        } else if (msg[i] < ec->cfg.param_count) {
+            ec->params[msg[i]] = (int16_t)cart_proto_get16(&msg[i + 1U]);
+            ec->stats.params_rx++;
+        }
+    }
+}
+
+static void emu_bulk_ack(emu_cart_t *ec, uint8_t status) {
+    uint8_t ack[CART_BULK_ACK_BYTES];
+
+    ack[0] = CART_MSG_BULK_ACK;
+    ack[1] = ec->bulk.id;
+    cart_proto_put32(&ack[2], ec->bulk.next);
+    ack[6] = status;
+    emu_cart_reply(ec, ack, sizeof(ack));
+    ec->bulk.acked = ec->bulk.next;
+}
+
+static void emu_bulk_begin(emu_cart_t *ec, const uint8_t *msg, size_t len) {
+    if (len < CART_BULK_BEGIN_BYTES) {
+        return;
+    }
+    const uint32_t size = cart_proto_get32(&msg[3]);
+    const uint32_t crc = cart_proto_get32(&msg[7]);
+    const bool same = (ec->bulk.open || ec->bulk.done) && (ec->bulk.kind == msg[2]) &&
+                      (ec->bulk.size == size) && (ec->bulk.crc == crc);
+
+    if (!same) {
+        ec->bulk.kind = msg[2];
+        ec->bulk.size = size;
+        ec->bulk.crc = crc;
+        ec->bulk.next = 0U;
+        ec->bulk.run = SPILINK_FRAME_CRC_INIT;
+        ec->bulk.done = false;
+    }
+    ec->bulk.id = msg[1];
+    ec->bulk.open = !ec->bulk.done;
+    ec->bulk.gap = false;
+    emu_bulk_ack(ec, ec->bulk.done ? CART_BULK_ACK_DONE : CART_BULK_ACK_OK);
+}
+
+static void emu_bulk_data(emu_cart_t *ec, const uint8_t *msg, size_t len) {
+    if ((len <= CART_BULK_DATA_HDR) || (msg[1] != ec->bulk.id) ||
+        (!ec->bulk.open && !ec->bulk.done)) {
+        return;
+    }
+    const uint32_t off = cart_proto_get32(&msg[2]);
+    const uint32_t n = (uint32_t)(len - CART_BULK_DATA_HDR);
+
+    if (off > ec->bulk.next) {
+        if (!ec->bulk.gap) {
+            ec->bulk.gap = true;
+            emu_bulk_ack(ec, CART_BULK_ACK_GAP);
+        }
+        return;
+    }
+    if (ec->bulk.done || ((off + n) <= ec->bulk.next) || ((off + n) > ec->bulk.size)) {
+        emu_bulk_ack(ec, ec->bulk.done ? CART_BULK_ACK_DONE : CART_BULK_ACK_OK);
+        return;
+    }
+
+    const uint32_t skip = ec->bulk.next - off;
+    ec->bulk.run = spilink_frame_crc_sw_update(ec->bulk.run, &msg[CART_BULK_DATA_HDR + skip],
+                                               n - skip);
+    ec->bulk.next += n - skip;
+    ec->bulk.gap = false;
+    ec->stats.bulk_rx += n - skip;
+
+    if (ec->bulk.next == ec->bulk.size) {
+        ec->bulk.open = false;
+        ec->bulk.done = (ec->bulk.run == ec->bulk.crc);
+        if (ec->bulk.done) {
+            ec->stats.bulk_done++;
+        }
+        emu_bulk_ack(ec, ec->bulk.done ? CART_BULK_ACK_DONE : CART_BULK_ACK_ERROR);
+    } else if ((ec->bulk.next - ec->bulk.acked) >= EMU_BULK_ACK_EVERY) {
+        emu_bulk_ack(ec, CART_BULK_ACK_OK);
+    }
+}
+
+/* Trame H7 -> cartouche, après le fil. */
+static void emu_cart_receive(emu_cart_t *ec, const uint8_t *w, size_t frames) {
+    const size_t n = spilink_frame_bytes(ec->cfg.format) - SPILINK_CRC_BYTES;
+
+    if (spilink_frame_crc_sw(w, n) != spilink_frame_get_crc(&w[n])) {
+        ec->stats.cart_crc_errors++;
+        return;
+    }
+
+    const uint8_t len = w[SPILINK_HDR_CTRL_LEN];
+    const uint8_t *msg = &w[SPILINK_HDR_CTRL];
+    if ((len > 0U) && (len <= SPILINK_CTRL_PAYLOAD)) {
+        if (msg[0] == CART_MSG_CAPS_REQ) {
+            emu_cart_caps(ec, msg, len);
+        } else if (msg[0] == CART_MSG_UPDATE) {
+            emu_cart_update(ec, msg, len);
+        } else if (msg[0] == CART_MSG_LOOPBACK) {
+            ec->loop = (len >= 2U) && (msg[1] != 0U);
+        } else if (msg[0] == CART_MSG_BULK_BEGIN) {
+            emu_bulk_begin(ec, msg, len);
+        } else if (msg[0] == CART_MSG_BULK_DATA) {
+            emu_bulk_data(ec, msg, len);
+        } else if (msg[0] == CART_MSG_BULK_ABORT) {
+            if ((len >= 2U) && (msg[1] == ec->bulk.id)) {
+                ec->bulk.open = false;
+                ec->bulk.done = false;
+            }
+        } else {
+            uint8_t echo[SPILINK_CTRL_PAYLOAD];
+            memcpy(echo, msg, len);
+            echo[0] |= CART_MSG_FROM_CART;
+            emu_cart_reply(ec, echo, len);
+            ec->stats.echoed++;
+        }
+    }
+    (void)spilink_wire_unpack(ec->cfg.format, &ec->in[0][0], &w[SPILINK_HDR_BYTES],
+                              frames * SPILINK_CHANNELS);
+}
+
+static void emu_cart_generate(emu_cart_t *ec, int32_t (*out)[SPILINK_CHANNELS], size_t frames) {
+    const int32_t level = ec->cfg.level;
+    const bool loop = ec->loop || (ec->cfg.signal == CART_EMU_LOOPBACK);
+
+    for (size_t f = 0U; f < frames; ++f) {
+        int32_t s = 0;
+        switch (ec->cfg.signal) {
+        case CART_EMU_SINE:
+            s = emu_scale(emu_sine(ec->phase), level);
+            break;
+        case CART_EMU_SQUARE:
+            s = (ec->phase < 0x80000000U) ? level : -level;
+            break;
+        case CART_EMU_IMPULSE:
+            s = (ec->phase < ec->phase_inc) ? level : 0;
+            break;
+        case CART_EMU_NOISE:
+            s = (int32_t)(((int64_t)(int32_t)emu_rand() * level) >> 31);
+            break;
+        default:
+            break;
+        }
+        ec->phase += ec->phase_inc;
+
+        for (size_t ch = 0U; ch < SPILINK_CHANNELS; ++ch) {
+            out[f][ch] = loop ? ec->in[f][ch] : s;
+        }
+    }
+}
+
+/* Trame cartouche -> H7, mise en transit avec latence et gigue. */
+static void emu_cart_transmit(emu_cart_t *ec, size_t frames) {
+    int32_t out[BRICK_AUDIO_FRAME_SAMPLES][SPILINK_CHANNELS];
+    uint32_t delay = 1U + ec->cfg.latency_blocks;
+
+    if (ec->cfg.jitter_blocks > 0U) {
+        delay += emu_rand() % (ec->cfg.jitter_blocks + 1U);
+    }
+    const uint32_t due = emu_block + delay;
+    emu_slot_t *slot = &ec->ring[due & (EMU_RING - 1U)];
+    if (slot->valid) {
+        ec->stats.lost++;     /* Rattrapée par une trame plus récente. */
+    }
+
+    uint8_t *w = slot->bytes;
+    memset(w, 0, SPILINK_HDR_BYTES);
+    w[SPILINK_HDR_SEQ] = ec->cart_seq++;
+    if (ec->reply_count > 0U) {
+        const uint8_t *r = ec->reply[ec->reply_rd];
+        w[SPILINK_HDR_CTRL_LEN] = r[0];
+        memcpy(&w[SPILINK_HDR_CTRL], &r[1], r[0]);
+        ec->reply_rd = (uint8_t)((ec->reply_rd + 1U) % CART_EMU_CTRL_DEPTH);
+        ec->reply_count--;
+    }
+
+    emu_cart_generate(ec, out, frames);
+    const size_t n = SPILINK_HDR_BYTES +
+                     spilink_wire_pack(ec->cfg.format, &w[SPILINK_HDR_BYTES], &out[0][0],
+                                       frames * SPILINK_CHANNELS);
+    spilink_frame_put_crc(&w[n], spilink_frame_crc_sw(w, n));
+    slot->due = due;
+    slot->valid = true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Côté H7                                                                    */
+/* -------------------------------------------------------------------------- */
+
+/* Même contrôle que drv_spilink, plus le rejet des trames arrivées dans le désordre. */
+static bool emu_h7_check(emu_cart_t *ec, const uint8_t *w) {
+    const size_t n = spilink_frame_bytes(ec->cfg.format) - SPILINK_CRC_BYTES;
+
+    if (spilink_frame_crc_sw(w, n) != spilink_frame_get_crc(&w[n])) {
+        ec->stats.crc_errors++;
+        return false;
+    }
+    const uint8_t seq = w[SPILINK_HDR_SEQ];
+    if (ec->rx_seq_valid) {
+        const uint8_t ahead = (uint8_t)(seq - ec->rx_seq);
+        if ((ahead == 0U) || (ahead >= 128U)) {
+            ec->stats.repeats++;
+            return false;
+        }
+        ec->stats.seq_gaps += (uint32_t)ahead - 1U;
+    }
+    ec->rx_seq = seq;
+    ec->rx_seq_valid = true;
+    return true;
+}
+
+static void emu_h7_ctrl_take(uint8_t cart, emu_cart_t *ec, uint8_t *w) {
+    size_t len = 0U;
+
+    if (ec->ctrl_tx_pending) {
+        len = ec->ctrl_tx_len;
+        memcpy(&w[SPILINK_HDR_CTRL], ec->ctrl_tx, len);
+        ec->ctrl_tx_pending = false;
+    } else if (ec->link.linked) {
+        if (emu_fill_cb != NULL) {
+            len = emu_fill_cb(cart, &w[SPILINK_HDR_CTRL], SPILINK_CTRL_PAYLOAD);
+        }
+        if ((len == 0U) && (emu_idle_cb != NULL)) {
+            len = emu_idle_cb(cart, &w[SPILINK_HDR_CTRL], SPILINK_CTRL_PAYLOAD);
+        }
+        if (len > SPILINK_CTRL_PAYLOAD) {
+            len = 0U;
+        }
+    }
+    w[SPILINK_HDR_CTRL_LEN] = (uint8_t)len;
+    if (len > 0U) {
+        ec->stats.ctrl_tx++;
+    }
+}
+
+/*
+ * Présence d'après le bloc reçu (`fresh` : trame neuve). Retourne true si
+ * l'état relié a changé.
+ */
+static bool emu_link_update(emu_cart_t *ec, bool fresh) {
+    emu_link_t *lk = &ec->link;
+
+    if (!lk->linked) {
+        lk->count = fresh ? (uint8_t)(lk->count + 1U) : 0U;
+        if (lk->count < SPILINK_LINK_UP_FRAMES) {
+            return false;
+        }
+        lk->linked = true;
+        lk->count = 0U;
+        lk->ups++;
+        return true;
+    }
+    if (fresh) {
+        lk->count = 0U;
+        return false;
+    }
+    if (++lk->count < SPILINK_LINK_DOWN_BLOCKS) {
+        return false;
+    }
+
+    /* Cartouche perdue : rien de son contrôle ne doit survivre. */
+    lk->linked = false;
+    lk->count = 0U;
+    lk->downs++;
+    ec->ctrl_tx_pending = false;
+    ec->ctrl_rx_count = 0U;
+    ec->rx_seq_valid = false;
+    spilink_conceal_reset(&ec->conceal);
+    return true;
+}
+
+/*
+ * Le contenu de masse reçu survit au retrait, comme en mémoire de la
+ * cartouche ; la présence vue du H7 aussi, jusqu'à ce que le silence la
+ * fasse perdre.
+ */
+static void emu_reset_link(emu_cart_t *ec) {
+    const cart_emu_config_t cfg = ec->cfg;
+    const emu_bulk_t bulk = ec->bulk;
+    const emu_link_t link = ec->link;
+
+    memset(ec, 0, sizeof(*ec));
+    ec->cfg = cfg;
+    ec->bulk = bulk;
+    ec->link = link;
+    if (!link.linked) {
+        ec->link.count = 0U;
+    }
+    ec->phase_inc = (uint32_t)(((uint64_t)cfg.freq_hz << 32) / BRICK_AUDIO_SAMPLE_RATE);
+    ec->next_flip = (cfg.ber_ppm > 0U) ? emu_flip_gap(cfg.ber_ppm) : 0U;
+    spilink_conceal_reset(&ec->conceal);
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void cart_emu_init(uint32_t seed) {
+    memset(emu_cart, 0, sizeof(emu_cart));
+    emu_block = 0U;
+    emu_rng = (seed != 0U) ? seed : 1U;
+    emu_fill_cb = NULL;
+    emu_idle_cb = NULL;
+    emu_link_cb = NULL;
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        spilink_conceal_reset(&emu_cart[c].conceal);
+    }
+}
+
+void cart_emu_default_config(cart_emu_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->present = true;
+    cfg->format = SPILINK_FORMAT_S24;
+    cfg->signal = CART_EMU_SINE;
+    cfg->freq_hz = 1000U;
+    cfg->level = 0x400000;        /* -6 dBFS. */
+    cfg->voices = BRICK_MAX_VOICES_PER_CART;
+    cfg->param_count = 16U;
+}
+
+bool cart_emu_configure(uint8_t cart, const cart_emu_config_t *cfg) {
+    if ((cart >= BRICK_MAX_CARTRIDGES) || (cfg == NULL) || (cfg->format >= SPILINK_FORMAT_COUNT) ||
+        ((cfg->latency_blocks + 1U + cfg->jitter_blocks) > CART_EMU_MAX_DELAY) ||
+        (cfg->param_count > CART_EMU_MAX_PARAMS) || (cfg->voices > BRICK_MAX_VOICES_PER_CART)) {
+        return false;
+    }
+
+    emu_cart_t *ec = &emu_cart[cart];
+    const bool inserted = cfg->present && !ec->cfg.present;
+    ec->cfg = *cfg;
+    if (inserted || !cfg->present) {
+        emu_reset_link(ec);
+    } else {
+        ec->phase_inc = (uint32_t)(((uint64_t)cfg->freq_hz << 32) / BRICK_AUDIO_SAMPLE_RATE);
+    }
+    return true;
+}
+
+void cart_emu_pull(cart_emu_block_t dest, size_t frames) {
+    emu_block++;
+
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        emu_cart_t *ec = &emu_cart[c];
+        const bool was_linked = ec->link.linked;
+        emu_slot_t *slot = &ec->ring[emu_block & (EMU_RING - 1U)];
+        bool fresh = false;
+
+        if (ec->cfg.present) {
+            ec->stats.blocks++;
+            if (slot->valid && (slot->due == emu_block)) {
+                slot->valid = false;
+                emu_corrupt(ec, slot->bytes, spilink_frame_bytes(ec->cfg.format));
+                fresh = emu_h7_check(ec, slot->bytes);
+            } else {
+                ec->stats.lost++;
+            }
+        } else if (!was_linked) {
+            memset(dest[c], 0, sizeof(dest[c]));
+            continue;
+        }
+
+        if (fresh && was_linked) {
+            const uint8_t len = slot->bytes[SPILINK_HDR_CTRL_LEN];
+            if ((len > 0U) && (len <= SPILINK_CTRL_PAYLOAD)) {
+                emu_queue_put(ec->ctrl_rx, ec->ctrl_rx_rd, &ec->ctrl_rx_count,
+                              &slot->bytes[SPILINK_HDR_CTRL], len);
+                ec->stats.ctrl_rx++;
+            }
+            (void)spilink_wire_unpack(ec->cfg.format, &dest[c][0][0],
+                                      &slot->bytes[SPILINK_HDR_BYTES], frames * SPILINK_CHANNELS);
+            spilink_conceal_good(&ec->conceal, dest[c], frames);
+        } else if (was_linked) {
+            spilink_conceal_lost(&ec->conceal, dest[c], frames);
+            ec->stats.concealed++;
+        } else {
+            memset(dest[c], 0, sizeof(dest[c]));
+        }
+
+        if (emu_link_update(ec, fresh) && (emu_link_cb != NULL)) {
+            emu_link_cb(c, ec->link.linked);
+        }
+    }
+}
+
+void cart_emu_push(const cart_emu_block_t src, size_t frames) {
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        emu_cart_t *ec = &emu_cart[c];
+
+        if (!ec->cfg.present) {
+            continue;
+        }
+
+        uint8_t *w = emu_wire;
+        w[SPILINK_HDR_SEQ] = ec->tx_seq++;
+        emu_h7_ctrl_take(c, ec, w);
+        const size_t n = SPILINK_HDR_BYTES +
+                         spilink_wire_pack(ec->cfg.format, &w[SPILINK_HDR_BYTES], &src[c][0][0],
+                                           frames * SPILINK_CHANNELS);
+        spilink_frame_put_crc(&w[n], spilink_frame_crc_sw(w, n));
+
+        emu_corrupt(ec, w, n + SPILINK_CRC_BYTES);
+        emu_cart_receive(ec, w, frames);
+        emu_cart_transmit(ec, frames);
+    }
+}
+
+bool cart_emu_ctrl_send(uint8_t cart, const uint8_t *data, size_t len) {
+    if ((cart >= BRICK_MAX_CARTRIDGES) || (data == NULL) || (len == 0U) ||
+        (len > SPILINK_CTRL_PAYLOAD)) {
+        return false;
+    }
+    emu_cart_t *ec = &emu_cart[cart];
+    if (!ec->link.linked || ec->ctrl_tx_pending) {
+        return false;
+    }
+    ec->ctrl_tx_len = (uint8_t)len;
+    memcpy(ec->ctrl_tx, data, len);
+    ec->ctrl_tx_pending = true;
+    return true;
+}
+
+size_t cart_emu_ctrl_recv(uint8_t cart, uint8_t *data) {
+    if ((cart >= BRICK_MAX_CARTRIDGES) || (data == NULL)) {
+        return 0U;
+    }
+    emu_cart_t *ec = &emu_cart[cart];
+    if (ec->ctrl_rx_count == 0U) {
+        return 0U;
+    }
+    const uint8_t *msg = ec->ctrl_rx[ec->ctrl_rx_rd];
+    const size_t len = msg[0];
+    memcpy(data, &msg[1], len);
+    ec->ctrl_rx_rd = (uint8_t)((ec->ctrl_rx_rd + 1U) % CART_EMU_CTRL_DEPTH);
+    ec->ctrl_rx_count--;
+    return len;
+}
+
+void cart_emu_set_ctrl_fill_cb(cart_emu_ctrl_fill_cb_t cb) {
+    emu_fill_cb = cb;
+}
+
+void cart_emu_set_ctrl_idle_cb(cart_emu_ctrl_fill_cb_t cb) {
+    emu_idle_cb = cb;
+}
+
+void cart_emu_set_link_cb(spilink_link_cb_t cb) {
+    emu_link_cb = cb;
+}
+
+void cart_emu_get_link(uint8_t cart, spilink_link_state_t *st) {
+    if ((cart < BRICK_MAX_CARTRIDGES) && (st != NULL)) {
+        st->linked = emu_cart[cart].link.linked;
+        st->link_ups = emu_cart[cart].link.ups;
+    }
+}
+
+int16_t cart_emu_get_param(uint8_t cart, uint16_t index) {
+    if ((cart >= BRICK_MAX_CARTRIDGES) || (index >= CART_EMU_MAX_PARAMS)) {
+        return 0;
+    }
+    return emu_cart[cart].params[index];
+}
+
+void cart_emu_get_stats(uint8_t cart, cart_emu_stats_t *st) {
+    if ((cart < BRICK_MAX_CARTRIDGES) && (st != NULL)) {
+        *st = emu_cart[cart].stats;
+        st->link_ups = emu_cart[cart].link.ups;
+        st->link_downs = emu_cart[cart].link.downs;
+        st->linked = emu_cart[cart].link.linked;
+    }
+}
+
+const spilink_link_ops_t cart_emu_link_ops = {
+    cart_emu_ctrl_send, cart_emu_ctrl_recv, cart_emu_get_link,
+    cart_emu_set_link_cb, cart_emu_set_ctrl_fill_cb, cart_emu_set_ctrl_idle_cb
+};
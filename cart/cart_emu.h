@@ -0,0 +1,128 @@
+/**
+ * @file cart_emu.h
+ * @brief Cartouches logicielles derrière les callbacks SPI-LINK de drv_audio.
+ * @details cart_emu_pull / cart_emu_push ont les signatures de
+ * drv_spilink_pull_cb_t / drv_spilink_push_cb_t : enregistrés auprès de
+ * drv_audio à la place de drv_spilink, ou appelés bloc après bloc par un
+ * banc hôte, ils font tourner le chemin cartouche complet sans matériel.
+ *
+ * Chaque bloc, dans chaque sens, une vraie trame est construite (en-tête,
+ * spilink_wire, CRC logiciel de spilink_frame), altérée selon la
+ * configuration puis vérifiée et décodée comme sur le H7 : numéro, CRC,
+ * masquage par spilink_conceal. Pour chaque cartouche émulée :
+ *  - signal : silence, sinus, carré, impulsion périodique, bruit, ou
+ *    bouclage de l'audio reçu (mesure d'aller-retour) ;
+ *  - contrôle : répond à l'énumération (cart_proto.h) avec sa
+ *    configuration, applique les CART_MSG_UPDATE (paramètres, notes comptés)
+ *    et CART_MSG_LOOPBACK, reçoit les transferts de masse (CRC vérifié,
+ *    reprise d'un contenu identique) et renvoie tout autre message en écho
+ *    (type | CART_MSG_FROM_CART) ;
+ *  - défauts : latence fixe et gigue aléatoire (en blocs, trames arrivant
+ *    en retard, dans le désordre ou jamais), erreurs binaires dans les deux
+ *    sens (taux en ppm de bits).
+ *
+ * Côté H7, contrôle et présence suivent drv_spilink : cart_emu_link_ops
+ * (spilink_link.h) se passe à cart_manager, cart_params et cart_bulk à la
+ * place de drv_spilink_link_ops. Un bus est relié après
+ * SPILINK_LINK_UP_FRAMES trames valides consécutives (sans sondage espacé)
+ * et perdu après SPILINK_LINK_DOWN_BLOCKS blocs sans trame neuve, retrait
+ * compris : l'entrée est alors masquée jusqu'à la perte, comme sur le H7.
+ * Les compteurs distinguent les pertes vues par chaque côté.
+ *
+ * Non réentrant (un seul thread audio ou banc). Arithmétique entière,
+ * module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup cart
+ */
+
+#ifndef CART_EMU_H
+#define CART_EMU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "brick_config.h"
+#include "cart_proto.h"
+#include "spilink_frame.h"
+#include "spilink_link.h"
+
+/** Retard maximal d'une trame (latence + gigue), en blocs. */
+#define CART_EMU_MAX_DELAY            15U
+#define CART_EMU_MAX_PARAMS           32U
+#define CART_EMU_CTRL_DEPTH           4U
+
+typedef int32_t cart_emu_block_t[BRICK_MAX_CARTRIDGES][BRICK_AUDIO_FRAME_SAMPLES][SPILINK_CHANNELS];
+
+typedef enum {
+    CART_EMU_SILENCE = 0,
+    CART_EMU_SINE,
+    CART_EMU_SQUARE,
+    CART_EMU_IMPULSE,         /* Une impulsion pleine échelle par période. */
+    CART_EMU_NOISE,
+    CART_EMU_LOOPBACK         /* Renvoie l'audio reçu de l'H7. */
+} cart_emu_signal_t;
+
+typedef struct {
+    bool              present;
+    spilink_format_t  format;
+    cart_emu_signal_t signal;
+    uint32_t          freq_hz;        /* Sinus, carré, impulsion. */
+    int32_t           level;          /* Amplitude crête, 24 bits. */
+    uint8_t           latency_blocks; /* Retard fixe ajouté au pipeline nominal. */
+    uint8_t           jitter_blocks;  /* Retard aléatoire supplémentaire, 0..jitter. */
+    uint32_t          ber_ppm;        /* Erreurs binaires par million de bits. */
+
+    /* Descripteur annoncé à l'énumération. */
+    uint8_t           voices;
+    uint16_t          param_count;    /* <= CART_EMU_MAX_PARAMS. */
+} cart_emu_config_t;
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t bit_flips;       /* Bits altérés, deux sens. */
+    uint32_t cart_crc_errors; /* Trames H7 rejetées par la cartouche. */
+    uint32_t crc_errors;      /* Trames cartouche rejetées côté H7. */
+    uint32_t lost;            /* Aucune trame à l'échéance (retard, collision). */
+    uint32_t repeats;
+    uint32_t seq_gaps;
+    uint32_t concealed;
+    uint32_t ctrl_tx;
+    uint32_t ctrl_rx;
+    uint32_t echoed;
+    uint32_t notes_rx;
+    uint32_t params_rx;
+    uint32_t bulk_rx;         /* Octets de masse reçus en séquence. */
+    uint32_t bulk_done;       /* Transferts complets, CRC vérifié. */
+    uint32_t link_ups;        /* Conservés au retrait. */
+    uint32_t link_downs;
+    bool     linked;
+} cart_emu_stats_t;
+
+typedef spilink_ctrl_fill_cb_t cart_emu_ctrl_fill_cb_t;
+
+/* Toutes les cartouches absentes, graine du générateur pseudo-aléatoire. */
+void cart_emu_init(uint32_t seed);
+
+/* Applique une configuration (insertion, retrait, défauts) ; false si invalide. */
+bool cart_emu_configure(uint8_t cart, const cart_emu_config_t *cfg);
+void cart_emu_default_config(cart_emu_config_t *cfg);
+
+void cart_emu_pull(cart_emu_block_t dest, size_t frames);
+void cart_emu_push(const cart_emu_block_t src, size_t frames);
+
+bool cart_emu_ctrl_send(uint8_t cart, const uint8_t *data, size_t len);
+size_t cart_emu_ctrl_recv(uint8_t cart, uint8_t *data);
+void cart_emu_set_ctrl_fill_cb(cart_emu_ctrl_fill_cb_t cb);
+void cart_emu_set_ctrl_idle_cb(cart_emu_ctrl_fill_cb_t cb);
+void cart_emu_set_link_cb(spilink_link_cb_t cb);
+void cart_emu_get_link(uint8_t cart, spilink_link_state_t *st);
+
+/* Valeur d'un paramètre reçue par la cartouche émulée. */
+int16_t cart_emu_get_param(uint8_t cart, uint16_t index);
+
+void cart_emu_get_stats(uint8_t cart, cart_emu_stats_t *st);
+
+/* Contrôle et présence pour cart_manager, cart_params et cart_bulk. */
+extern const spilink_link_ops_t cart_emu_link_ops;
+
+#endif /* CART_EMU_H */
@@ -0,0 +1,316 @@
+/**
+ * @file cart_manager.c
+ * @brief Détection des cartouches et lecture de leur descripteur de capacités.
+ * @ingroup cart
+ */
+
+#include "cart_manager.h"
+#include "spilink_frame.h"
+#include <string.h>
+
+BRICK_STATIC_ASSERT(CART_MSG_MAX_BYTES == SPILINK_CTRL_PAYLOAD, cart_msg_fits_frame);
+BRICK_STATIC_ASSERT(CART_CAPS_HDR_BYTES <= CART_MSG_MAX_BYTES, cart_caps_hdr_fits);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    cart_slot_state_t state;
+    uint32_t  link_ups;           /* Détection du transport à l'origine de l'état. */
+
+    /* Énumération : en-tête reçu, prochain paramètre, requête en vol. */
+    bool      hdr_done;
+    uint16_t  next_param;
+    bool      req_pending;
+    systime_t req_time;
+    uint8_t   retries;
+    systime_t enum_start;
+
+    cart_caps_t          caps;
+    cart_manager_stats_t stats;
+} cart_slot_t;
+
+static cart_slot_t cart_slots[BRICK_MAX_CARTRIDGES];
+static const spilink_link_ops_t *cart_link = NULL;
+
+static cart_event_cb_t cart_event_cb = NULL;
+static cart_msg_cb_t cart_msg_cb = NULL;
+static bool cart_initialized = false;
+static bool cart_running = false;
+
+static binary_semaphore_t cart_wake_sem;
+static THD_WORKING_AREA(cartManagerThreadWA, CART_MANAGER_THREAD_STACK_SIZE);
+
+/* -------------------------------------------------------------------------- */
+/* Transitions                                                                */
+/* -------------------------------------------------------------------------- */
+
+static void cart_set_state(uint8_t slot, cart_slot_state_t state) {
+    cart_slots[slot].state = state;
+    if (cart_event_cb != NULL) {
+        cart_event_cb(slot, state);
+    }
+}
+
+static void cart_enum_begin(uint8_t slot) {
+    cart_slot_t *sl = &cart_slots[slot];
+
+    memset(&sl->caps, 0, sizeof(sl->caps));
+    sl->hdr_done = false;
+    sl->next_param = 0U;
+    sl->req_pending = false;
+    sl->retries = 0U;
+    sl->enum_start = chVTGetSystemTimeX();
+    sl->stats.inserts++;
+    cart_set_state(slot, CART_SLOT_ENUMERATING);
+}
+
+static void cart_enum_fail(uint8_t slot) {
+    cart_slots[slot].stats.enum_failures++;
+    cart_set_state(slot, CART_SLOT_FAULT);
+}
+
+static void cart_enum_done(uint8_t slot) {
+    cart_slot_t *sl = &cart_slots[slot];
+
+    sl->stats.enum_ms = (uint32_t)TIME_I2MS(chVTTimeElapsedSinceX(sl->enum_start));
+    cart_set_state(slot, CART_SLOT_READY);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Énumération                                                                */
+/* -------------------------------------------------------------------------- */
+
+static void cart_caps_rx_hdr(uint8_t slot, const uint8_t *msg, size_t len) {
+    cart_slot_t *sl = &cart_slots[slot];
+    cart_caps_t *caps = &sl->caps;
+
+    if (sl->hdr_done || (len < CART_CAPS_HDR_BYTES)) {
+        return;
+    }
+    if (msg[1] != CART_PROTO_VERSION) {
+        cart_enum_fail(slot);
+        return;
+    }
+
+    caps->type_id = cart_proto_get16(&msg[2]);
+    caps->fw_major = msg[4];
+    caps->fw_minor = msg[5];
+    caps->voices = msg[6];
+    caps->channels_in = msg[7];
+    caps->channels_out = msg[8];
+    caps->param_count = cart_proto_get16(&msg[9]);
+    memcpy(caps->name, &msg[11], CART_CAPS_NAME_LEN);
+    caps->name[CART_CAPS_NAME_LEN] = '\0';
+
+    /* Bornes de compilation : au-delà, la cartouche est inutilisable ici. */
+    if ((caps->voices > BRICK_MAX_VOICES_PER_CART) ||
+        (caps->channels_in > SPILINK_CHANNELS) || (caps->channels_out > SPILINK_CHANNELS) ||
+        (caps->param_count > CART_MAX_PARAMS)) {
+        cart_enum_fail(slot);
+        return;
+    }
+
+    sl->hdr_done = true;
+    sl->req_pending = false;
+    sl->retries = 0U;
+    if (caps->param_count == 0U) {
+        cart_enum_done(slot);
+    }
+}
+
+static void cart_caps_rx_params(uint8_t slot, const uint8_t *msg, size_t len) {
+    cart_slot_t *sl = &cart_slots[slot];
+    cart_caps_t *caps = &sl->caps;
+
+    if (!sl->hdr_done || (len < 4U)) {
+        return;
+    }
+    const uint16_t first = cart_proto_get16(&msg[1]);
+    const uint8_t n = msg[3];
+    if ((first != sl->next_param) || (n == 0U) || (n > CART_CAPS_PARAMS_PER_MSG) ||
+        (len < (4U + ((size_t)n * CART_CAPS_PARAM_BYTES))) ||
+        ((first + n) > caps->param_count)) {
+        return;     /* Réponse périmée ou incohérente : la requête sera réémise. */
+    }
+
+    const uint8_t *p = &msg[4];
+    for (uint8_t i = 0U; i < n; ++i) {
+        cart_param_desc_t *d = &caps->params[first + i];
+        d->min = (int16_t)cart_proto_get16(&p[0]);
+        d->max = (int16_t)cart_proto_get16(&p[2]);
+        d->def = (int16_t)cart_proto_get16(&p[4]);
+        d->flags = p[6];
+        p += CART_CAPS_PARAM_BYTES;
+    }
+
+    sl->next_param = (uint16_t)(first + n);
+    sl->req_pending = false;
+    sl->retries = 0U;
+    if (sl->next_param >= caps->param_count) {
+        cart_enum_done(slot);
+    }
+}
+
+/* Émet la requête suivante, ou réémet celle restée sans réponse. */
+static void cart_caps_request(uint8_t slot) {
+    cart_slot_t *sl = &cart_slots[slot];
+    uint8_t req[4];
+
+    if (sl->req_pending) {
+        if (chVTTimeElapsedSinceX(sl->req_time) < TIME_MS2I(CART_CAPS_TIMEOUT_MS)) {
+            return;
+        }
+        if (sl->retries >= CART_CAPS_RETRIES) {
+            cart_enum_fail(slot);
+            return;
+        }
+        sl->retries++;
+        sl->stats.retries++;
+    }
+
+    req[0] = CART_MSG_CAPS_REQ;
+    req[1] = sl->hdr_done ? CART_CAPS_PAGE_PARAMS : CART_CAPS_PAGE_HDR;
+    cart_proto_put16(&req[2], sl->next_param);
+    if (cart_link->ctrl_send(slot, req, sizeof(req))) {
+        sl->req_pending = true;
+        sl->req_time = chVTGetSystemTimeX();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Transport, thread audio : ne fait que réveiller le gestionnaire. */
+static void cart_link_cb(uint8_t cart, bool linked) {
+    (void)cart;
+    (void)linked;
+    chSysLock();
+    chBSemSignalI(&cart_wake_sem);
+    chSysUnlock();
+}
+
+static void cart_slot_service(uint8_t slot) {
+    cart_slot_t *sl = &cart_slots[slot];
+    spilink_link_state_t link;
+
+    /*
+     * Présence et nombre de détections lus ensemble : un retrait suivi d'une
+     * insertion entre deux passages reste un retrait.
+     */
+    cart_link->get_link(slot, &link);
+    if ((sl->state != CART_SLOT_EMPTY) && (!link.linked || (link.link_ups != sl->link_ups))) {
+        sl->stats.removals++;
+        cart_set_state(slot, CART_SLOT_EMPTY);
+    }
+    if (!link.linked) {
+        return;
+    }
+    if (sl->state == CART_SLOT_EMPTY) {
+        sl->link_ups = link.link_ups;
+        cart_enum_begin(slot);
+    }
+
+    uint8_t msg[CART_MSG_MAX_BYTES];
+    size_t len;
+    while ((len = cart_link->ctrl_recv(slot, msg)) > 0U) {
+        if (sl->state == CART_SLOT_ENUMERATING) {
+            if (msg[0] == CART_MSG_CAPS_HDR) {
+                cart_caps_rx_hdr(slot, msg, len);
+            } else if (msg[0] == CART_MSG_CAPS_PARAMS) {
+                cart_caps_rx_params(slot, msg, len);
+            }
+        } else if ((sl->state == CART_SLOT_READY) && (cart_msg_cb != NULL)) {
+            sl->stats.msgs_rx++;
+            cart_msg_cb(slot, msg, len);
+        }
+    }
+
+    if (sl->state == CART_SLOT_ENUMERATING) {
+        cart_caps_request(slot);
+    }
+}
+
+static THD_FUNCTION(cartManagerThread, arg) {
+    (void)arg;
+    chRegSetThreadName("cartManager");
+
+    while (true) {
+        (void)chBSemWaitTimeout(&cart_wake_sem, TIME_MS2I(CART_MANAGER_POLL_MS));
+
+        for (uint8_t s = 0U; s < BRICK_MAX_CARTRIDGES; ++s) {
+            cart_slot_service(s);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void cart_manager_init(const spilink_link_ops_t *link) {
+    if (cart_initialized || (link == NULL)) {
+        return;
+    }
+    memset(cart_slots, 0, sizeof(cart_slots));
+    cart_link = link;
+    chBSemObjectInit(&cart_wake_sem, true);
+    cart_initialized = true;
+}
+
+void cart_manager_start(void) {
+    if (!cart_initialized || cart_running) {
+        return;
+    }
+    cart_running = true;
+    chThdCreateStatic(cartManagerThreadWA, sizeof(cartManagerThreadWA),
+                      CART_MANAGER_THREAD_PRIORITY, cartManagerThread, NULL);
+    cart_link->set_link_cb(cart_link_cb);
+}
+
+void cart_manager_set_event_cb(cart_event_cb_t cb) {
+    cart_event_cb = cb;
+}
+
+void cart_manager_set_msg_cb(cart_msg_cb_t cb) {
+    cart_msg_cb = cb;
+}
+
+cart_slot_state_t cart_manager_get_state(uint8_t slot) {
+    return (slot < BRICK_MAX_CARTRIDGES) ? cart_slots[slot].state : CART_SLOT_EMPTY;
+}
+
+uint8_t cart_manager_ready_mask(void) {
+    uint8_t mask = 0U;
+    for (uint8_t s = 0U; s < BRICK_MAX_CARTRIDGES; ++s) {
+        if (cart_slots[s].state == CART_SLOT_READY) {
+            mask |= (uint8_t)(1U << s);
+        }
+    }
+    return mask;
+}
+
+const cart_caps_t *cart_manager_get_caps(uint8_t slot) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (cart_slots[slot].state != CART_SLOT_READY)) {
+        return NULL;
+    }
+    return &cart_slots[slot].caps;
+}
+
+bool cart_manager_send(uint8_t slot, const uint8_t *msg, size_t len) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (cart_slots[slot].state != CART_SLOT_READY)) {
+        return false;
+    }
+    return cart_link->ctrl_send(slot, msg, len);
+}
+
+void cart_manager_get_stats(uint8_t slot, cart_manager_stats_t *st) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (st == NULL)) {
+        return;
+    }
+    chSysLock();
+    *st = cart_slots[slot].stats;
+    chSysUnlock();
+}
@@ -0,0 +1,105 @@
+/**
+ * @file cart_manager.h
+ * @brief Cartouches : détection à chaud et énumération des capacités.
+ * @details BRICK_MAX_CARTRIDGES et BRICK_MAX_VOICES_PER_CART ne sont plus que
+ * des bornes : ce que chaque slot contient est découvert à l'exécution.
+ *
+ * Le transport (drv_spilink, ou cart_emu sur banc, voir spilink_link.h)
+ * détecte la présence (trames valides) et adapte seul son
+ * ordonnancement : bus vide sondé à basse cadence, entrée audio en fondu
+ * puis silencieuse au retrait, en fondu à l'insertion. Sur insertion, le
+ * thread du gestionnaire lit le descripteur de la cartouche (cart_proto.h :
+ * en-tête puis carte des paramètres), avec délai et reprises ; le slot passe
+ * alors à CART_SLOT_READY. Un descripteur hors bornes (voix, canaux,
+ * paramètres) ou une énumération sans réponse met le slot en
+ * CART_SLOT_FAULT jusqu'au retrait. Le flux SAI et les autres slots ne sont
+ * jamais interrompus.
+ *
+ * Le callback d'événement (thread du gestionnaire) permet au propriétaire du
+ * graphe audio d'ajouter ou retirer la voie du slot. Une fois prêt, les
+ * messages de la cartouche hors énumération sont passés au callback de
+ * messages.
+ *
+ * @ingroup cart
+ */
+
+#ifndef CART_MANAGER_H
+#define CART_MANAGER_H
+
+#include "ch.h"
+#include "brick_config.h"
+#include "cart_proto.h"
+#include "spilink_link.h"
+
+#define CART_MAX_PARAMS               128U
+
+#define CART_MANAGER_POLL_MS          2U
+#define CART_CAPS_TIMEOUT_MS          20U
+#define CART_CAPS_RETRIES             5U
+
+#define CART_MANAGER_THREAD_STACK_SIZE 1024U
+#define CART_MANAGER_THREAD_PRIORITY  (NORMALPRIO + 2)
+
+typedef enum {
+    CART_SLOT_EMPTY = 0,
+    CART_SLOT_ENUMERATING,
+    CART_SLOT_READY,
+    CART_SLOT_FAULT
+} cart_slot_state_t;
+
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int16_t def;
+    uint8_t flags;            /* CART_PARAM_*. */
+} cart_param_desc_t;
+
+typedef struct {
+    uint16_t          type_id;
+    uint8_t           fw_major;
+    uint8_t           fw_minor;
+    uint8_t           voices;
+    uint8_t           channels_in;
+    uint8_t           channels_out;
+    uint16_t          param_count;
+    char              name[CART_CAPS_NAME_LEN + 1U];
+    cart_param_desc_t params[CART_MAX_PARAMS];
+} cart_caps_t;
+
+typedef struct {
+    uint32_t inserts;
+    uint32_t removals;
+    uint32_t retries;         /* Requêtes d'énumération réémises. */
+    uint32_t enum_failures;
+    uint32_t enum_ms;         /* Durée de la dernière énumération réussie. */
+    uint32_t msgs_rx;         /* Messages passés au callback. */
+} cart_manager_stats_t;
+
+/* Appelés depuis le thread du gestionnaire. */
+typedef void (*cart_event_cb_t)(uint8_t slot, cart_slot_state_t state);
+typedef void (*cart_msg_cb_t)(uint8_t slot, const uint8_t *msg, size_t len);
+
+/* `link` : transport des cartouches (drv_spilink_link_ops, cart_emu_link_ops), initialisé. */
+void cart_manager_init(const spilink_link_ops_t *link);
+void cart_manager_start(void);
+
+void cart_manager_set_event_cb(cart_event_cb_t cb);
+void cart_manager_set_msg_cb(cart_msg_cb_t cb);
+
+cart_slot_state_t cart_manager_get_state(uint8_t slot);
+
+/** Bit n : slot n prêt. */
+uint8_t cart_manager_ready_mask(void);
+
+/*
+ * Descripteur d'un slot prêt, NULL sinon. Inchangé tant que le slot reste
+ * prêt ; à ne plus utiliser après un événement du slot.
+ */
+const cart_caps_t *cart_manager_get_caps(uint8_t slot);
+
+/* Message vers une cartouche prête ; false si le slot n'est pas prêt ou si un message attend. */
+bool cart_manager_send(uint8_t slot, const uint8_t *msg, size_t len);
+
+void cart_manager_get_stats(uint8_t slot, cart_manager_stats_t *st);
+
+#endif /* CART_MANAGER_H */
@@ -0,0 +1,311 @@
+/**
+ * @file cart_params.c
+ * @brief Miroir des paramètres cartouches : cartes de bits par classe, trames par deltas.
+ * @ingroup cart
+ */
+
+#include "cart_params.h"
+#include <string.h>
+
+#define CART_PARAMS_WORDS     (CART_MAX_PARAMS / 32U)
+#define CART_PARAMS_NOTE_MASK (CART_PARAMS_NOTE_QUEUE - 1U)
+
+BRICK_STATIC_ASSERT(CART_MAX_PARAMS <= CART_REC_NOTE, cart_param_index_fits_record);
+BRICK_STATIC_ASSERT((CART_MAX_PARAMS % 32U) == 0U, cart_param_words);
+BRICK_STATIC_ASSERT((CART_PARAMS_NOTE_QUEUE & CART_PARAMS_NOTE_MASK) == 0U, cart_note_queue_pow2);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    bool               active;
+    uint16_t           count;
+    const cart_caps_t *caps;
+    int16_t            value[CART_MAX_PARAMS];
+
+    /* Bit i du mot i / 32 : paramètre i à envoyer ([CART_PRIO_NOTE] inutilisé). */
+    uint32_t           dirty[CART_PRIO_COUNT][CART_PARAMS_WORDS];
+    uint8_t            cursor[CART_PRIO_COUNT];
+
+    /* File de notes, enregistrements prêts à copier. */
+    uint8_t            notes[CART_PARAMS_NOTE_QUEUE][CART_REC_BYTES];
+    uint8_t            note_rd;
+    uint8_t            note_count;
+
+    cart_params_stats_t stats;
+} cart_params_slot_t;
+
+static cart_params_slot_t cart_params[BRICK_MAX_CARTRIDGES];
+
+/* -------------------------------------------------------------------------- */
+/* Cartes de bits                                                             */
+/* -------------------------------------------------------------------------- */
+
+static bool cart_params_is_dirty(const cart_params_slot_t *sl, uint32_t w, uint32_t bit) {
+    for (uint8_t p = CART_PRIO_PLOCK; p < CART_PRIO_COUNT; ++p) {
+        if ((sl->dirty[p][w] & bit) != 0U) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool cart_params_any_pending(const cart_params_slot_t *sl) {
+    uint32_t any = sl->note_count;
+    for (uint8_t p = CART_PRIO_PLOCK; p < CART_PRIO_COUNT; ++p) {
+        for (uint32_t w = 0U; w < CART_PARAMS_WORDS; ++w) {
+            any |= sl->dirty[p][w];
+        }
+    }
+    return any != 0U;
+}
+
+/*
+ * Envoie au plus `room` paramètres marqués dans la classe `prio`, à partir
+ * du curseur et en bouclant. Sous verrou.
+ */
+static size_t cart_params_emit_class(cart_params_slot_t *sl, uint8_t prio, uint8_t *rec, size_t room) {
+    uint32_t *dirty = sl->dirty[prio];
+    const uint32_t start = sl->cursor[prio];
+    uint32_t w = start >> 5;
+    uint32_t mask = ~0U << (start & 31U);
+    size_t n = 0U;
+
+    /* WORDS + 1 passages : le premier mot est repris en entier à la fin. */
+    for (uint32_t k = 0U; (k <= CART_PARAMS_WORDS) && (n < room); ++k) {
+        uint32_t bits = dirty[w] & mask;
+        while ((bits != 0U) && (n < room)) {
+            const uint32_t b = (uint32_t)__builtin_ctz(bits);
+            const uint32_t i = (w << 5) | b;
+            bits &= bits - 1U;
+
+            for (uint8_t p = CART_PRIO_PLOCK; p < CART_PRIO_COUNT; ++p) {
+                sl->dirty[p][w] &= ~(1U << b);
+            }
+            rec[0] = (uint8_t)i;
+            cart_proto_put16(&rec[1], (uint16_t)sl->value[i]);
+            rec += CART_REC_BYTES;
+            n++;
+            sl->cursor[prio] = (uint8_t)((i + 1U) % CART_MAX_PARAMS);
+        }
+        w = (w + 1U) % CART_PARAMS_WORDS;
+        mask = ~0U;
+    }
+
+    sl->stats.records[prio] += (uint32_t)n;
+    return n;
+}
+
+/* Transport, push du thread audio : une mise à jour par trame. */
+static size_t cart_params_fill(uint8_t cart, uint8_t *msg, size_t max) {
+    if ((cart >= BRICK_MAX_CARTRIDGES) || (max < (1U + CART_REC_BYTES))) {
+        return 0U;
+    }
+
+    cart_params_slot_t *sl = &cart_params[cart];
+    size_t room = (max - 1U) / CART_REC_BYTES;
+    if (room > CART_PARAMS_FRAME_RECORDS) {
+        room = CART_PARAMS_FRAME_RECORDS;
+    }
+    uint8_t *rec = &msg[1];
+    size_t n = 0U;
+
+    chSysLock();
+    if (!sl->active) {
+        chSysUnlock();
+        return 0U;
+    }
+
+    while ((sl->note_count > 0U) && (n < room)) {
+        memcpy(rec, sl->notes[sl->note_rd], CART_REC_BYTES);
+        sl->note_rd = (uint8_t)((sl->note_rd + 1U) & CART_PARAMS_NOTE_MASK);
+        sl->note_count--;
+        sl->stats.records[CART_PRIO_NOTE]++;
+        rec += CART_REC_BYTES;
+        n++;
+    }
+    for (uint8_t p = CART_PRIO_PLOCK; (p < CART_PRIO_COUNT) && (n < room); ++p) {
+        const size_t k = cart_params_emit_class(sl, p, rec, room - n);
+        rec += k * CART_REC_BYTES;
+        n += k;
+    }
+
+    if (n > 0U) {
+        sl->stats.frames++;
+        if ((n == room) && cart_params_any_pending(sl)) {
+            sl->stats.deferred++;
+        }
+    }
+    chSysUnlock();
+
+    if (n == 0U) {
+        return 0U;
+    }
+    msg[0] = CART_MSG_UPDATE;
+    return 1U + (n * CART_REC_BYTES);
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void cart_params_init(const spilink_link_ops_t *link) {
+    memset(cart_params, 0, sizeof(cart_params));
+    if (link != NULL) {
+        link->set_ctrl_fill_cb(cart_params_fill);
+    }
+}
+
+void cart_params_slot_event(uint8_t slot, cart_slot_state_t state) {
+    if (slot >= BRICK_MAX_CARTRIDGES) {
+        return;
+    }
+    cart_params_slot_t *sl = &cart_params[slot];
+
+    chSysLock();
+    sl->active = false;
+    chSysUnlock();
+
+    const cart_caps_t *caps = (state == CART_SLOT_READY) ? cart_manager_get_caps(slot) : NULL;
+    if (caps == NULL) {
+        return;
+    }
+
+    /* Hors ligne : personne d'autre n'accède au slot tant qu'il est inactif. */
+    sl->caps = caps;
+    sl->count = caps->param_count;
+    for (uint16_t i = 0U; i < sl->count; ++i) {
+        sl->value[i] = caps->params[i].def;
+    }
+    memset(sl->dirty, 0, sizeof(sl->dirty));
+    memset(sl->cursor, 0, sizeof(sl->cursor));
+    sl->note_rd = 0U;
+    sl->note_count = 0U;
+
+    chSysLock();
+    sl->active = true;
+    chSysUnlock();
+}
+
+/* Écriture d'une valeur déjà bornée ; appelée sous verrou, slot actif et index valide. */
+static void cart_params_store_s(cart_params_slot_t *sl, uint16_t index, int16_t value, uint8_t prio) {
+    if (value != sl->value[index]) {
+        const uint32_t w = (uint32_t)index >> 5;
+        const uint32_t bit = 1U << (index & 31U);
+        if (cart_params_is_dirty(sl, w, bit)) {
+            sl->stats.coalesced++;
+        }
+        sl->value[index] = value;
+        sl->dirty[prio][w] |= bit;
+    }
+}
+
+bool cart_params_set(uint8_t slot, uint16_t index, int16_t value, cart_prio_t prio) {
+    bool ok = false;
+
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (prio < CART_PRIO_PLOCK) || (prio >= CART_PRIO_COUNT)) {
+        return false;
+    }
+    cart_params_slot_t *sl = &cart_params[slot];
+
+    chSysLock();
+    if (sl->active && (index < sl->count)) {
+        const cart_param_desc_t *d = &sl->caps->params[index];
+        if (value < d->min) {
+            value = d->min;
+        } else if (value > d->max) {
+            value = d->max;
+        }
+        cart_params_store_s(sl, index, value, (uint8_t)prio);
+        ok = true;
+    }
+    chSysUnlock();
+    return ok;
+}
+
+bool cart_params_set_norm(uint8_t slot, uint16_t index, uint16_t norm, cart_prio_t prio) {
+    bool ok = false;
+
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (prio < CART_PRIO_PLOCK) || (prio >= CART_PRIO_COUNT)) {
+        return false;
+    }
+    cart_params_slot_t *sl = &cart_params[slot];
+
+    chSysLock();
+    if (sl->active && (index < sl->count)) {
+        const cart_param_desc_t *d = &sl->caps->params[index];
+        /* 0 -> min, 65535 -> max, arrondi au plus proche. */
+        const uint32_t span = (d->max > d->min) ? (uint32_t)((int32_t)d->max - (int32_t)d->min) : 0U;
+        const int32_t value = (int32_t)d->min + (int32_t)(((span * norm) + 32767U) / 65535U);
+        cart_params_store_s(sl, index, (int16_t)value, (uint8_t)prio);
+        ok = true;
+    }
+    chSysUnlock();
+    return ok;
+}
+
+int16_t cart_params_get(uint8_t slot, uint16_t index) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (index >= CART_MAX_PARAMS)) {
+        return 0;
+    }
+    return cart_params[slot].value[index];
+}
+
+bool cart_params_note(uint8_t slot, uint8_t voice, uint8_t note, uint8_t velocity) {
+    bool ok = false;
+
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (voice >= CART_REC_NOTE) ||
+        (note > 0x7FU) || (velocity > 0x7FU)) {
+        return false;
+    }
+    cart_params_slot_t *sl = &cart_params[slot];
+
+    chSysLock();
+    if (sl->active && (voice < sl->caps->voices)) {
+        if (sl->note_count >= CART_PARAMS_NOTE_QUEUE) {
+            sl->stats.notes_dropped++;
+        } else {
+            uint8_t *rec = sl->notes[(sl->note_rd + sl->note_count) & CART_PARAMS_NOTE_MASK];
+            rec[0] = (uint8_t)(CART_REC_NOTE | voice);
+            rec[1] = note;
+            rec[2] = velocity;
+            sl->note_count++;
+            ok = true;
+        }
+    }
+    chSysUnlock();
+    return ok;
+}
+
+void cart_params_resync(uint8_t slot) {
+    if (slot >= BRICK_MAX_CARTRIDGES) {
+        return;
+    }
+    cart_params_slot_t *sl = &cart_params[slot];
+
+    chSysLock();
+    for (uint16_t i = 0U; sl->active && (i < sl->count); ++i) {
+        sl->dirty[CART_PRIO_UI][i >> 5] |= 1U << (i & 31U);
+    }
+    chSysUnlock();
+}
+
+void cart_params_get_stats(uint8_t slot, cart_params_stats_t *st) {
+    if ((slot >= BRICK_MAX_CARTRIDGES) || (st == NULL)) {
+        return;
+    }
+    const cart_params_slot_t *sl = &cart_params[slot];
+
+    chSysLock();
+    *st = sl->stats;
+    st->pending[CART_PRIO_NOTE] = sl->note_count;
+    for (uint8_t p = CART_PRIO_PLOCK; p < CART_PRIO_COUNT; ++p) {
+        uint16_t count = 0U;
+        for (uint32_t w = 0U; w < CART_PARAMS_WORDS; ++w) {
+            count = (uint16_t)(count + (uint16_t)__builtin_popcount(sl->dirty[p][w]));
+        }
+        st->pending[p] = count;
+    }
+    chSysUnlock();
+}
@@ -0,0 +1,79 @@
+/**
+ * @file cart_params.h
+ * @brief Miroir local des paramètres des cartouches, synchronisé par deltas.
+ * @details Chaque slot prêt a un miroir de ses paramètres (valeurs bornées par
+ * le descripteur) et une carte de bits « modifié » par classe de priorité.
+ * Une écriture ne marque le paramètre que si sa valeur change ; plusieurs
+ * écritures avant l'envoi n'en font qu'une, avec la dernière valeur.
+ *
+ * Le champ de contrôle de chaque trame SPI-LINK (CART_MSG_UPDATE, au plus
+ * CART_PARAMS_FRAME_RECORDS enregistrements) est rempli au push par ordre
+ * de priorité : notes (file par slot), puis paramètres marqués p-lock,
+ * modulation et enfin UI. Dans une classe, le balayage reprend là où la
+ * trame précédente s'est arrêtée. Un flot de p-locks ne retarde donc jamais
+ * les notes, et n'occupe qu'un slot : chaque cartouche a son bus et son
+ * budget.
+ *
+ * Un paramètre marqué dans plusieurs classes part une fois, dans la plus
+ * prioritaire. Les messages du gestionnaire (cart_manager_send) passent
+ * avant le remplissage et occupent la trame entière.
+ *
+ * Écritures depuis n'importe quel thread, y compris le thread audio
+ * (séquenceur, modulation) : sections critiques courtes, sans blocage.
+ *
+ * @ingroup cart
+ */
+
+#ifndef CART_PARAMS_H
+#define CART_PARAMS_H
+
+#include "ch.h"
+#include "cart_manager.h"
+
+typedef enum {
+    CART_PRIO_NOTE = 0,       /* File de notes (cart_params_note). */
+    CART_PRIO_PLOCK,
+    CART_PRIO_MOD,
+    CART_PRIO_UI,
+    CART_PRIO_COUNT
+} cart_prio_t;
+
+/** Enregistrements par trame : le budget de contrôle fixe d'un bloc. */
+#define CART_PARAMS_FRAME_RECORDS     ((CART_MSG_MAX_BYTES - 1U) / CART_REC_BYTES)
+#define CART_PARAMS_NOTE_QUEUE        32U     /* Notes par slot (puissance de 2). */
+
+typedef struct {
+    uint32_t frames;                      /* Trames portant une mise à jour. */
+    uint32_t records[CART_PRIO_COUNT];    /* Enregistrements envoyés par classe. */
+    uint32_t coalesced;                   /* Écritures remplacées avant envoi. */
+    uint32_t deferred;                    /* Trames pleines laissant du travail en attente. */
+    uint32_t notes_dropped;               /* File de notes pleine. */
+    uint16_t pending[CART_PRIO_COUNT];    /* En attente à l'instant de la lecture. */
+} cart_params_stats_t;
+
+/* S'accroche au remplissage des trames du transport `link` (voir cart_manager_init). */
+void cart_params_init(const spilink_link_ops_t *link);
+
+/*
+ * Suit l'état d'un slot (callback d'événement du gestionnaire) : au passage
+ * à CART_SLOT_READY, le miroir prend les valeurs par défaut du descripteur,
+ * supposées appliquées par la cartouche ; il est vidé dans les autres états.
+ */
+void cart_params_slot_event(uint8_t slot, cart_slot_state_t state);
+
+/* Valeur bornée à [min, max] ; false si le slot n'est pas prêt ou l'index invalide. */
+bool cart_params_set(uint8_t slot, uint16_t index, int16_t value, cart_prio_t prio);
+
+/* Valeur normalisée (0 -> min, 65535 -> max, linéaire) : sorties de la matrice de modulation. */
+bool cart_params_set_norm(uint8_t slot, uint16_t index, uint16_t norm, cart_prio_t prio);
+int16_t cart_params_get(uint8_t slot, uint16_t index);
+
+/* Note vers une voix de la cartouche (vélocité 0 : note off). */
+bool cart_params_note(uint8_t slot, uint8_t voice, uint8_t note, uint8_t velocity);
+
+/* Renvoie tout le miroir (classe UI), par exemple après un reset de la cartouche. */
+void cart_params_resync(uint8_t slot);
+
+void cart_params_get_stats(uint8_t slot, cart_params_stats_t *st);
+
+#endif /* CART_PARAMS_H */
@@ -0,0 +1,133 @@
+/**
+ * @file cart_proto.h
+ * @brief Protocole de contrôle des cartouches, porté par les messages SPI-LINK.
+ * @details Un message tient dans le champ de contrôle d'une trame (au plus
+ * CART_MSG_MAX_BYTES octets). L'octet 0 est le type : bit 7 à 0 pour H7 ->
+ * cartouche, à 1 pour cartouche -> H7. Entiers gros-boutistes.
+ *
+ * Énumération (CART_MSG_CAPS_*) : le H7 demande l'en-tête de capacités, puis
+ * la carte des paramètres par tranches de CART_CAPS_PARAMS_PER_MSG ; chaque
+ * requête attend sa réponse. Une réponse inattendue est ignorée.
+ *
+ * En-tête seul : compilable sur hôte (émulateur de cartouche).
+ *
+ * @ingroup cart
+ */
+
+#ifndef CART_PROTO_H
+#define CART_PROTO_H
+
+#include <stdint.h>
+
+#define CART_PROTO_VERSION            1U
+#define CART_MSG_MAX_BYTES            30U
+#define CART_MSG_FROM_CART            0x80U
+
+/* -------------------------------------------------------------------------- */
+/* Énumération                                                                */
+/* -------------------------------------------------------------------------- */
+
+/** Requête : [1] page ; [2..3] premier paramètre (page PARAMS). */
+#define CART_MSG_CAPS_REQ             0x01U
+#define CART_CAPS_PAGE_HDR            0U
+#define CART_CAPS_PAGE_PARAMS         1U
+
+/**
+ * En-tête : [1] version, [2..3] type, [4..5] firmware (majeur, mineur),
+ * [6] voix, [7] canaux entrants, [8] canaux sortants, [9..10] nombre de
+ * paramètres, [11..22] nom (ASCII, complété de zéros).
+ */
+#define CART_MSG_CAPS_HDR             0x81U
+#define CART_CAPS_NAME_LEN            12U
+#define CART_CAPS_HDR_BYTES           (11U + CART_CAPS_NAME_LEN)
+
+/**
+ * Paramètres : [1..2] premier index, [3] nombre n, puis n entrées de
+ * CART_CAPS_PARAM_BYTES octets : min, max, défaut (int16), drapeaux.
+ */
+#define CART_MSG_CAPS_PARAMS          0x82U
+#define CART_CAPS_PARAM_BYTES         7U
+#define CART_CAPS_PARAMS_PER_MSG      ((CART_MSG_MAX_BYTES - 4U) / CART_CAPS_PARAM_BYTES)
+
+/** Drapeaux de paramètre. */
+#define CART_PARAM_PLOCK              0x01U   /* Verrouillable par pas. */
+#define CART_PARAM_MOD                0x02U   /* Destination de modulation. */
+#define CART_PARAM_STEPPED            0x04U   /* Valeurs discrètes (sélecteur). */
+
+/* -------------------------------------------------------------------------- */
+/* Mises à jour                                                               */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Mise à jour (H7 -> cartouche) : [1..] suite d'enregistrements de
+ * CART_REC_BYTES octets, appliqués dans l'ordre :
+ *  - note : [0] CART_REC_NOTE | voix, [1] note, [2] vélocité (0 : note off) ;
+ *  - paramètre : [0] index (< 0x80), [1..2] valeur (int16).
+ */
+#define CART_MSG_UPDATE               0x10U
+#define CART_REC_NOTE                 0x80U
+#define CART_REC_BYTES                3U
+
+/**
+ * Boucle audio (H7 -> cartouche) : [1] 1 pour renvoyer l'entrée SPI-LINK
+ * en sortie à travers toute la chaîne de la cartouche (mesure de latence),
+ * 0 pour revenir au jeu normal.
+ */
+#define CART_MSG_LOOPBACK             0x11U
+
+/* -------------------------------------------------------------------------- */
+/* Transferts de masse                                                        */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Ouverture (H7 -> cartouche) : [1] identifiant, [2] nature, [3..6] taille,
+ * [7..10] CRC-32/MPEG-2 du contenu. La cartouche répond par un accusé
+ * portant l'offset de reprise : 0, ou les octets déjà reçus d'un contenu de
+ * même nature, taille et CRC.
+ */
+#define CART_MSG_BULK_BEGIN           0x20U
+#define CART_BULK_BEGIN_BYTES         11U
+#define CART_BULK_FIRMWARE            0U
+#define CART_BULK_WAVETABLE           1U
+#define CART_BULK_SAMPLE              2U
+
+/** Données : [1] identifiant, [2..5] offset, [6..] octets. */
+#define CART_MSG_BULK_DATA            0x21U
+#define CART_BULK_DATA_HDR            6U
+#define CART_BULK_CHUNK               (CART_MSG_MAX_BYTES - CART_BULK_DATA_HDR)
+
+/** Abandon : [1] identifiant. */
+#define CART_MSG_BULK_ABORT           0x22U
+
+/**
+ * Accusé (cartouche -> H7) : [1] identifiant, [2..5] octets reçus en
+ * séquence, [6] état. Les données hors séquence sont ignorées ; un seul
+ * CART_BULK_ACK_GAP par trou, les doublons provoquent un accusé.
+ */
+#define CART_MSG_BULK_ACK             0xA0U
+#define CART_BULK_ACK_BYTES           7U
+#define CART_BULK_ACK_OK              0U
+#define CART_BULK_ACK_GAP             1U      /* Reprendre à l'offset. */
+#define CART_BULK_ACK_BUSY            2U      /* Écriture en cours : patienter. */
+#define CART_BULK_ACK_DONE            3U      /* Contenu complet, CRC vérifié. */
+#define CART_BULK_ACK_ERROR           4U      /* CRC faux ou stockage refusé. */
+
+static inline uint16_t cart_proto_get16(const uint8_t *p) {
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static inline void cart_proto_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static inline uint32_t cart_proto_get32(const uint8_t *p) {
+    return ((uint32_t)cart_proto_get16(p) << 16) | cart_proto_get16(&p[2]);
+}
+
+static inline void cart_proto_put32(uint8_t *p, uint32_t v) {
+    cart_proto_put16(p, (uint16_t)(v >> 16));
+    cart_proto_put16(&p[2], (uint16_t)v);
+}
+
+#endif /* CART_PROTO_H */
@@ -0,0 +1,328 @@
+/**
+ * @file audio_align.c
+ * @brief Mesure de latence par impulsion et lignes à retard par blocs.
+ * @ingroup drivers
+ */
+
+#include "audio_align.h"
+#include <string.h>
+
+#define ALIGN_RING_MASK       (AUDIO_ALIGN_RING_FRAMES - 1U)
+
+BRICK_STATIC_ASSERT((AUDIO_ALIGN_RING_FRAMES & ALIGN_RING_MASK) == 0U, audio_align_ring_pow2);
+BRICK_STATIC_ASSERT(AUDIO_ALIGN_RING_FRAMES > BRICK_AUDIO_FRAME_SAMPLES, audio_align_ring_holds_block);
+BRICK_STATIC_ASSERT(AUDIO_ALIGN_TIMEOUT_FRAMES > AUDIO_ALIGN_MAX_DELAY, audio_align_timeout_covers_ring);
+
+typedef enum {
+    ALIGN_REQ_NONE = 0,
+    ALIGN_REQ_MEASURE,
+    ALIGN_REQ_MANUAL,
+    ALIGN_REQ_FORGET
+} align_req_t;
+
+typedef enum {
+    ALIGN_PH_WAIT = 0,        /* Mise en boucle, ou extinction de l'impulsion précédente. */
+    ALIGN_PH_EMIT,
+    ALIGN_PH_LISTEN
+} align_phase_t;
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    /* Demande en attente : paramètres écrits avant l'octet de requête. */
+    volatile uint8_t  req;
+    volatile uint8_t  req_out;
+    volatile uint8_t  req_in;
+    volatile uint16_t req_latency;
+
+    audio_align_status_t st;
+    align_phase_t phase;
+    uint8_t  out_ch;
+    uint8_t  in_ch;
+    uint32_t wait;
+    uint32_t t_emit;
+    uint16_t result[AUDIO_ALIGN_RUNS];
+} align_path_t;
+
+static align_path_t align_path[AUDIO_ALIGN_PATHS];
+static int32_t align_cart_ring[BRICK_MAX_CARTRIDGES][AUDIO_ALIGN_RING_FRAMES][AUDIO_ALIGN_CART_CHANNELS];
+static int32_t align_adc_ring[AUDIO_ALIGN_RING_FRAMES][AUDIO_ALIGN_ADC_CHANNELS];
+static uint32_t align_now = 0U;           /* Première frame du bloc courant. */
+static bool align_live = false;
+static audio_align_loop_cb_t align_loop_cb = NULL;
+
+/* -------------------------------------------------------------------------- */
+/* Compensation                                                               */
+/* -------------------------------------------------------------------------- */
+
+static bool align_known(const align_path_t *p) {
+    return (p->st.state == AUDIO_ALIGN_MEASURED) || (p->st.state == AUDIO_ALIGN_MANUAL);
+}
+
+/* Chaque chemin connu est retardé jusqu'au plus lent. */
+static void align_update_delays(void) {
+    uint16_t target = 0U;
+
+    for (uint8_t i = 0U; i < AUDIO_ALIGN_PATHS; ++i) {
+        if (align_known(&align_path[i]) && (align_path[i].st.latency > target)) {
+            target = align_path[i].st.latency;
+        }
+    }
+    for (uint8_t i = 0U; i < AUDIO_ALIGN_PATHS; ++i) {
+        align_path_t *p = &align_path[i];
+        uint32_t d = align_known(p) ? (uint32_t)(target - p->st.latency) : 0U;
+        p->st.delay = (uint16_t)((d > AUDIO_ALIGN_MAX_DELAY) ? AUDIO_ALIGN_MAX_DELAY : d);
+    }
+}
+
+/*
+ * Écrit le bloc dans l'anneau puis relit `delay` frames en arrière ; `in`
+ * et `out` peuvent coïncider.
+ */
+static void align_delay(int32_t *ring, size_t ch, const int32_t *in, int32_t *out,
+                        size_t frames, uint32_t delay) {
+    const uint32_t w = align_now & ALIGN_RING_MASK;
+    size_t n = AUDIO_ALIGN_RING_FRAMES - w;
+    if (n > frames) {
+        n = frames;
+    }
+    memcpy(&ring[w * ch], in, n * ch * sizeof(int32_t));
+    memcpy(ring, &in[n * ch], (frames - n) * ch * sizeof(int32_t));
+
+    if (delay == 0U) {
+        if (out != in) {
+            memcpy(out, in, frames * ch * sizeof(int32_t));
+        }
+        return;
+    }
+    const uint32_t r = (align_now - delay) & ALIGN_RING_MASK;
+    n = AUDIO_ALIGN_RING_FRAMES - r;
+    if (n > frames) {
+        n = frames;
+    }
+    memcpy(out, &ring[r * ch], n * ch * sizeof(int32_t));
+    memcpy(&out[n * ch], ring, (frames - n) * ch * sizeof(int32_t));
+}
+
+/* -------------------------------------------------------------------------- */
+/* Mesure                                                                     */
+/* -------------------------------------------------------------------------- */
+
+static void align_finish(uint8_t path, align_path_t *p) {
+    uint16_t s[AUDIO_ALIGN_RUNS];
+
+    memcpy(s, p->result, sizeof(s));
+    for (uint32_t i = 1U; i < AUDIO_ALIGN_RUNS; ++i) {
+        const uint16_t v = s[i];
+        uint32_t j = i;
+        for (; (j > 0U) && (s[j - 1U] > v); --j) {
+            s[j] = s[j - 1U];
+        }
+        s[j] = v;
+    }
+    p->st.spread = (uint16_t)(s[AUDIO_ALIGN_RUNS - 1U] - s[0]);
+    if (p->st.spread <= AUDIO_ALIGN_TOLERANCE) {
+        p->st.latency = s[AUDIO_ALIGN_RUNS / 2U];
+        p->st.state = AUDIO_ALIGN_MEASURED;
+    } else {
+        p->st.state = AUDIO_ALIGN_FAILED;
+    }
+    if (align_loop_cb != NULL) {
+        align_loop_cb(path, false);
+    }
+}
+
+static void align_fail(uint8_t path, align_path_t *p) {
+    p->st.state = AUDIO_ALIGN_FAILED;
+    if (align_loop_cb != NULL) {
+        align_loop_cb(path, false);
+    }
+}
+
+/* Cherche l'impulsion dans le bloc d'entrée (canal `in_ch`, `ch` canaux par frame). */
+static void align_listen(uint8_t path, align_path_t *p, const int32_t *in, size_t ch, size_t frames) {
+    for (size_t f = 0U; f < frames; ++f) {
+        const int32_t x = in[(f * ch) + p->in_ch];
+        if ((x >= AUDIO_ALIGN_THRESHOLD) || (x <= -AUDIO_ALIGN_THRESHOLD)) {
+            p->result[p->st.runs++] = (uint16_t)(align_now + (uint32_t)f - p->t_emit);
+            if (p->st.runs >= AUDIO_ALIGN_RUNS) {
+                align_finish(path, p);
+            } else {
+                p->phase = ALIGN_PH_WAIT;
+                p->wait = AUDIO_ALIGN_GAP_FRAMES;
+            }
+            return;
+        }
+    }
+    if ((align_now + (uint32_t)frames - p->t_emit) > AUDIO_ALIGN_TIMEOUT_FRAMES) {
+        align_fail(path, p);
+    }
+}
+
+/* Demandes en attente, dans le thread audio. Retourne true si une latence connue a changé. */
+static bool align_take_requests(void) {
+    bool changed = false;
+
+    for (uint8_t i = 0U; i < AUDIO_ALIGN_PATHS; ++i) {
+        align_path_t *p = &align_path[i];
+        const uint8_t req = p->req;
+        if (req == ALIGN_REQ_NONE) {
+            continue;
+        }
+        const bool was_measuring = (p->st.state == AUDIO_ALIGN_MEASURING);
+        changed |= align_known(p);
+
+        if (req == ALIGN_REQ_MEASURE) {
+            memset(&p->st, 0, sizeof(p->st));
+            p->st.state = AUDIO_ALIGN_MEASURING;
+            p->out_ch = p->req_out;
+            p->in_ch = p->req_in;
+            p->phase = ALIGN_PH_WAIT;
+            p->wait = AUDIO_ALIGN_SETTLE_FRAMES;
+        } else if (req == ALIGN_REQ_MANUAL) {
+            memset(&p->st, 0, sizeof(p->st));
+            p->st.state = AUDIO_ALIGN_MANUAL;
+            p->st.latency = p->req_latency;
+            changed = true;
+        } else {
+            memset(&p->st, 0, sizeof(p->st));
+        }
+        p->req = ALIGN_REQ_NONE;
+
+        if ((align_loop_cb != NULL) && (was_measuring != (req == ALIGN_REQ_MEASURE))) {
+            align_loop_cb(i, req == ALIGN_REQ_MEASURE);
+        }
+    }
+    return changed;
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void audio_align_init(void) {
+    memset(align_path, 0, sizeof(align_path));
+    memset(align_cart_ring, 0, sizeof(align_cart_ring));
+    memset(align_adc_ring, 0, sizeof(align_adc_ring));
+    align_now = 0U;
+    align_live = false;
+}
+
+void audio_align_set_loop_cb(audio_align_loop_cb_t cb) {
+    align_loop_cb = cb;
+}
+
+bool audio_align_measure(uint8_t path, uint8_t out_ch, uint8_t in_ch) {
+    const size_t ch = (path == AUDIO_ALIGN_ADC) ? AUDIO_ALIGN_ADC_CHANNELS : AUDIO_ALIGN_CART_CHANNELS;
+
+    if ((path >= AUDIO_ALIGN_PATHS) || (in_ch >= ch) ||
+        ((path != AUDIO_ALIGN_ADC) && (out_ch >= AUDIO_ALIGN_CART_CHANNELS))) {
+        return false;
+    }
+    align_path[path].req_out = out_ch;
+    align_path[path].req_in = in_ch;
+    align_path[path].req = ALIGN_REQ_MEASURE;
+    return true;
+}
+
+bool audio_align_set_latency(uint8_t path, uint16_t frames) {
+    if (path >= AUDIO_ALIGN_PATHS) {
+        return false;
+    }
+    align_path[path].req_latency = frames;
+    align_path[path].req = ALIGN_REQ_MANUAL;
+    return true;
+}
+
+void audio_align_forget(uint8_t path) {
+    if (path < AUDIO_ALIGN_PATHS) {
+        align_path[path].req = ALIGN_REQ_FORGET;
+    }
+}
+
+void audio_align_get_status(uint8_t path, audio_align_status_t *st) {
+    if ((path < AUDIO_ALIGN_PATHS) && (st != NULL)) {
+        *st = align_path[path].st;
+    }
+}
+
+void audio_align_reset_lines(void) {
+    memset(align_cart_ring, 0, sizeof(align_cart_ring));
+    memset(align_adc_ring, 0, sizeof(align_adc_ring));
+    align_now = 0U;
+}
+
+void audio_align_input(const int32_t *adc_in, int32_t *adc_out,
+                       int32_t (*spi_in)[BRICK_AUDIO_FRAME_SAMPLES][AUDIO_ALIGN_CART_CHANNELS],
+                       size_t frames, bool live) {
+    if (frames > BRICK_AUDIO_FRAME_SAMPLES) {
+        frames = BRICK_AUDIO_FRAME_SAMPLES;
+    }
+    align_live = live;
+    bool changed = align_take_requests();
+
+    for (uint8_t i = 0U; i < AUDIO_ALIGN_PATHS; ++i) {
+        align_path_t *p = &align_path[i];
+        if (p->st.state != AUDIO_ALIGN_MEASURING) {
+            continue;
+        }
+        if (!live) {
+            p->phase = ALIGN_PH_WAIT;       /* Rendu hors ligne : mesure suspendue. */
+            continue;
+        }
+        if (p->phase == ALIGN_PH_LISTEN) {
+            if (i == AUDIO_ALIGN_ADC) {
+                align_listen(i, p, adc_in, AUDIO_ALIGN_ADC_CHANNELS, frames);
+            } else {
+                align_listen(i, p, &spi_in[i][0][0], AUDIO_ALIGN_CART_CHANNELS, frames);
+            }
+            changed |= align_known(p);
+        } else if (p->phase == ALIGN_PH_WAIT) {
+            p->wait = (p->wait > frames) ? (p->wait - (uint32_t)frames) : 0U;
+            if (p->wait == 0U) {
+                p->phase = ALIGN_PH_EMIT;
+            }
+        }
+    }
+    if (changed) {
+        align_update_delays();
+    }
+
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        align_delay(&align_cart_ring[c][0][0], AUDIO_ALIGN_CART_CHANNELS, &spi_in[c][0][0],
+                    &spi_in[c][0][0], frames, align_path[c].st.delay);
+        if (align_path[c].st.state == AUDIO_ALIGN_MEASURING) {
+            memset(spi_in[c], 0, sizeof(spi_in[c]));
+        }
+    }
+    align_delay(&align_adc_ring[0][0], AUDIO_ALIGN_ADC_CHANNELS, adc_in, adc_out, frames,
+                align_path[AUDIO_ALIGN_ADC].st.delay);
+    if (align_path[AUDIO_ALIGN_ADC].st.state == AUDIO_ALIGN_MEASURING) {
+        memset(adc_out, 0, frames * AUDIO_ALIGN_ADC_CHANNELS * sizeof(int32_t));
+    }
+}
+
+void audio_align_output(int32_t *dac_out, size_t dac_channels,
+                        int32_t (*spi_out)[BRICK_AUDIO_FRAME_SAMPLES][AUDIO_ALIGN_CART_CHANNELS],
+                        size_t frames) {
+    for (uint8_t i = 0U; align_live && (i < AUDIO_ALIGN_PATHS); ++i) {
+        align_path_t *p = &align_path[i];
+        if ((p->st.state != AUDIO_ALIGN_MEASURING) || (p->phase != ALIGN_PH_EMIT)) {
+            continue;
+        }
+        if (i == AUDIO_ALIGN_ADC) {
+            if (p->out_ch >= dac_channels) {
+                align_fail(i, p);
+                continue;
+            }
+            dac_out[p->out_ch] = AUDIO_ALIGN_LEVEL;
+        } else {
+            spi_out[i][0][p->out_ch] = AUDIO_ALIGN_LEVEL;
+        }
+        p->t_emit = align_now;
+        p->phase = ALIGN_PH_LISTEN;
+    }
+    align_now += (uint32_t)((frames > BRICK_AUDIO_FRAME_SAMPLES) ? BRICK_AUDIO_FRAME_SAMPLES : frames);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file audio_align.h
+ * @brief Mesure de latence des chemins d'entrée et alignement temporel avant le mixeur.
+ * @details Chemins : chaque cartouche (4 canaux SPI-LINK) et l'entrée ADC
+ * (8 canaux). La latence d'un chemin se mesure par impulsion : une
+ * impulsion de AUDIO_ALIGN_LEVEL part sur un canal de sortie (SPI-LINK vers
+ * la cartouche, ou DAC), puis le canal d'entrée est guetté jusqu'au premier
+ * échantillon au-delà de AUDIO_ALIGN_THRESHOLD. AUDIO_ALIGN_RUNS mesures
+ * espacées ; la médiane est retenue si l'écart entre extrêmes reste dans
+ * AUDIO_ALIGN_TOLERANCE frames, sinon la mesure échoue (trajet instable,
+ * impulsion noyée). Le chemin mesuré est muet pendant la mesure.
+ *
+ * La boucle est fournie par le chemin lui-même : le callback de boucle
+ * demande à la cartouche de renvoyer son entrée par toute sa chaîne
+ * (CART_MSG_LOOPBACK) ; pour l'ADC, un câble ou le banc relie la sortie DAC
+ * choisie à l'entrée. La latence mesurée est celle de la boucle : pour une
+ * cartouche, c'est aussi le retard d'un son déclenché par une note partie
+ * dans la même trame ; pour l'ADC elle inclut celle du DAC, à corriger par
+ * audio_align_set_latency si besoin.
+ *
+ * Compensation : les chemins de latence connue (mesurée ou imposée) sont
+ * retardés jusqu'au plus lent, de sorte que tout arrive aligné aux sorties
+ * PCM4104. Lignes à retard en anneaux statiques de AUDIO_ALIGN_RING_FRAMES
+ * frames, écrits et lus par blocs (deux copies au plus), sans allocation ;
+ * un changement de retard est appliqué d'un coup, au bloc suivant.
+ *
+ * Demandes depuis n'importe quel thread (octet de requête par chemin),
+ * traitement dans le thread audio (drv_audio) ; l'état lu est indicatif.
+ * Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef AUDIO_ALIGN_H
+#define AUDIO_ALIGN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "brick_config.h"
+
+#define AUDIO_ALIGN_CART_CHANNELS     4U
+#define AUDIO_ALIGN_ADC_CHANNELS      8U
+#define AUDIO_ALIGN_ADC               BRICK_MAX_CARTRIDGES    /* Chemin de l'entrée ADC. */
+#define AUDIO_ALIGN_PATHS             (BRICK_MAX_CARTRIDGES + 1U)
+
+/** Anneau par chemin (puissance de 2) ; retard maximal : un bloc de moins. */
+#define AUDIO_ALIGN_RING_FRAMES       256U
+#define AUDIO_ALIGN_MAX_DELAY         (AUDIO_ALIGN_RING_FRAMES - BRICK_AUDIO_FRAME_SAMPLES)
+
+#define AUDIO_ALIGN_LEVEL             0x400000        /* -6 dBFS. */
+#define AUDIO_ALIGN_THRESHOLD         0x100000        /* -18 dBFS. */
+#define AUDIO_ALIGN_RUNS              5U
+#define AUDIO_ALIGN_TOLERANCE         2U              /* Frames entre mesures extrêmes. */
+#define AUDIO_ALIGN_SETTLE_FRAMES     512U            /* Mise en boucle du chemin. */
+#define AUDIO_ALIGN_GAP_FRAMES        256U            /* Extinction entre deux impulsions. */
+#define AUDIO_ALIGN_TIMEOUT_FRAMES    2048U
+
+typedef enum {
+    AUDIO_ALIGN_UNKNOWN = 0,      /* Jamais retardé, exclu de l'alignement. */
+    AUDIO_ALIGN_MEASURING,
+    AUDIO_ALIGN_MEASURED,
+    AUDIO_ALIGN_MANUAL,
+    AUDIO_ALIGN_FAILED
+} audio_align_state_t;
+
+typedef struct {
+    audio_align_state_t state;
+    uint16_t latency;             /* Frames (mesurée ou imposée). */
+    uint16_t delay;               /* Retard appliqué, frames. */
+    uint16_t spread;              /* Écart entre mesures extrêmes. */
+    uint8_t  runs;                /* Mesures abouties. */
+} audio_align_status_t;
+
+/* Met en boucle (true) ou rétablit (false) un chemin ; appelé depuis le thread audio. */
+typedef void (*audio_align_loop_cb_t)(uint8_t path, bool loop);
+
+void audio_align_init(void);
+void audio_align_set_loop_cb(audio_align_loop_cb_t cb);
+
+/*
+ * Lance une mesure : impulsion sur le canal `out_ch` (SPI-LINK de la
+ * cartouche, ou DAC pour AUDIO_ALIGN_ADC), détection sur `in_ch` du chemin.
+ */
+bool audio_align_measure(uint8_t path, uint8_t out_ch, uint8_t in_ch);
+
+/* Latence imposée (frames), ou oubli du chemin (retrait) : plus de retard ni d'alignement sur lui. */
+bool audio_align_set_latency(uint8_t path, uint16_t frames);
+void audio_align_forget(uint8_t path);
+
+void audio_align_get_status(uint8_t path, audio_align_status_t *st);
+
+/* Lignes à retard vidées et position remise à zéro (latences conservées) ; flux arrêté uniquement. */
+void audio_align_reset_lines(void);
+
+/*
+ * Thread audio, après le pull SPI-LINK : mesure (si `live`), silence des
+ * chemins mesurés et retards. `spi_in` est retardé sur place, l'entrée ADC
+ * copiée retardée dans `adc_out`.
+ */
+void audio_align_input(const int32_t *adc_in, int32_t *adc_out,
+                       int32_t (*spi_in)[BRICK_AUDIO_FRAME_SAMPLES][AUDIO_ALIGN_CART_CHANNELS],
+                       size_t frames, bool live);
+
+/* Thread audio, après le DSP et avant le push : impulsions de mesure. */
+void audio_align_output(int32_t *dac_out, size_t dac_channels,
+                        int32_t (*spi_out)[BRICK_AUDIO_FRAME_SAMPLES][AUDIO_ALIGN_CART_CHANNELS],
+                        size_t frames);
+
+#endif /* AUDIO_ALIGN_H */
@@ -4,6 +4,7 @@
  */
 
 #include "drv_audio.h"
+#include "audio_align.h"
 #include "audio_codec_ada1979.h"
 #include "audio_codec_pcm4104.h"
 #include <string.h>
@@ -50,6 +51,12 @@ static volatile int32_t AUDIO_DMA_BUFFER_ATTR audio_out_buffers[2][AUDIO_FRAMES_
 static volatile spilink_audio_block_t AUDIO_DMA_BUFFER_ATTR spi_in_buffers;
 static volatile spilink_audio_block_t AUDIO_DMA_BUFFER_ATTR spi_out_buffers;
 
+BRICK_STATIC_ASSERT(AUDIO_FRAMES_PER_BUFFER == BRICK_AUDIO_FRAME_SAMPLES, audio_align_block_size);
+BRICK_STATIC_ASSERT(AUDIO_NUM_INPUT_CHANNELS == AUDIO_ALIGN_ADC_CHANNELS, audio_align_adc_channels);
+
+/* Entrée ADC retardée (audio_align), vue par le DSP. */
+static int32_t audio_adc_aligned[AUDIO_FRAMES_PER_BUFFER][AUDIO_NUM_INPUT_CHANNELS];
+
 static volatile uint8_t audio_in_ready_index = 0xFFU;
 static volatile uint8_t audio_out_ready_index = 0xFFU;
 
@@ -62,6 +69,19 @@ static volatile uint8_t audio_sync_half = 0xFFU;
 /* SPI-LINK callbacks. */
 static drv_spilink_pull_cb_t spilink_pull_cb = NULL;
 static drv_spilink_push_cb_t spilink_push_cb = NULL;
+static drv_audio_block_isr_cb_t block_isr_cb = NULL;
+
+/* Hook de contrôle exécuté à cadence bloc. */
+static drv_audio_control_cb_t control_cb = NULL;
+static drv_audio_reset_cb_t reset_cb = NULL;
+
+/*
+ * Horloge audio : position (frames) du bloc courant et instant (compteur de
+ * cycles) de son début. Mis à jour ensemble sous verrou.
+ */
+static uint32_t audio_frame_counter = 0U;
+static uint32_t audio_frame_next = 0U;
+static rtcnt_t  audio_block_stamp = 0U;
 
 typedef struct {
     float gain_main;
@@ -116,6 +136,7 @@ static void audio_control_init(void);
 static void audio_control_get_snapshot(audio_control_snapshot_t *dst);
 static float soft_clip(float x);
 static void audio_dma_sync_mark(uint8_t half, uint8_t flag);
+static void audio_run_block(const int32_t *in_buf, int32_t *out_buf, size_t frames, bool link);
 
 static void audio_dma_rx_cb(void *p, uint32_t flags);
 static void audio_dma_tx_cb(void *p, uint32_t flags);
@@ -156,6 +177,7 @@ void drv_audio_init(void) {
     memset((void *)spi_in_buffers, 0, sizeof(spi_in_buffers));
     memset((void *)spi_out_buffers, 0, sizeof(spi_out_buffers));
     audio_routes_reset_defaults();
+    audio_align_init();
 
     /* Les GPIO SAI sont déjà configurés via board.h. */
     audio_hw_configure_sai();
@@ -221,6 +243,50 @@ void drv_audio_stop(void) {
     audio_state = AUDIO_STOPPED;
 }
 
+bool drv_audio_is_running(void) {
+    return audio_state == AUDIO_RUNNING;
+}
+
+uint32_t drv_audio_get_frame_timeI(void) {
+    /* Interpolation entre deux blocs : cycles écoulés convertis en frames. */
+    const rtcnt_t elapsed = (rtcnt_t)(chSysGetRealtimeCounterX() - audio_block_stamp);
+    uint32_t extra = (uint32_t)(((uint64_t)elapsed * AUDIO_SAMPLE_RATE_HZ) / STM32_CORE_CK);
+    if (extra > AUDIO_FRAMES_PER_BUFFER) {
+        extra = AUDIO_FRAMES_PER_BUFFER;
+    }
+    return audio_frame_counter + extra;
+}
+
+uint32_t drv_audio_get_frame_time(void) {
+    chSysLock();
+    const uint32_t t = drv_audio_get_frame_timeI();
+    chSysUnlock();
+    return t;
+}
+
+uint32_t drv_audio_get_block_frame(void) {
+    return audio_frame_counter;
+}
+
+bool drv_audio_render_block(const int32_t *adc_in, int32_t *dac_out) {
+    if ((audio_state == AUDIO_RUNNING) || (adc_in == NULL) || (dac_out == NULL)) {
+        return false;
+    }
+    audio_run_block(adc_in, dac_out, AUDIO_FRAMES_PER_BUFFER, false);
+    return true;
+}
+
+bool drv_audio_reset_render(void) {
+    if (audio_state == AUDIO_RUNNING) {
+        return false;
+    }
+    audio_align_reset_lines();
+    if (reset_cb != NULL) {
+        reset_cb();
+    }
+    return true;
+}
+
 const int32_t* drv_audio_get_input_buffer(uint8_t *index, size_t *frames) {
     chSysLock();
     uint8_t ready = audio_in_ready_index;
@@ -283,6 +349,20 @@ void drv_audio_register_spilink_push(drv_spilink_push_cb_t cb) {
     spilink_push_cb = cb;
 }
 
+void drv_audio_register_block_isr_cb(drv_audio_block_isr_cb_t cb) {
+    chSysLock();
+    block_isr_cb = cb;
+    chSysUnlock();
+}
+
+void drv_audio_register_control_cb(drv_audio_control_cb_t cb) {
+    control_cb = cb;
+}
+
+void drv_audio_register_reset_cb(drv_audio_reset_cb_t cb) {
+    reset_cb = cb;
+}
+
 void drv_audio_set_master_volume(float vol) {
     if (vol < 0.0f) {
         vol = 0.0f;
@@ -338,6 +418,26 @@ void drv_audio_set_route_gain(uint8_t track, float gain_main, float gain_cue) {
     chMtxUnlock(&audio_control.lock);
 }
 
+void drv_audio_get_mix(drv_audio_mix_t *mix) {
+    if (mix == NULL) {
+        return;
+    }
+
+    const audio_control_snapshot_t *ctrl = &audio_control_cached;
+    memset(mix, 0, sizeof(*mix));
+    mix->master_volume = ctrl->master_volume;
+    for (uint8_t t = 0U; t < 4U; ++t) {
+        mix->gain_main[t] = ctrl->routes[t].gain_main;
+        mix->gain_cue[t] = ctrl->routes[t].gain_cue;
+        if (ctrl->routes[t].to_main) {
+            mix->to_main_mask |= (uint8_t)(1U << t);
+        }
+        if (ctrl->routes[t].to_cue) {
+            mix->to_cue_mask |= (uint8_t)(1U << t);
+        }
+    }
+}
+
 static void audio_routes_reset_defaults(void) {
     chMtxLock(&audio_control.lock);
     audio_control.state.master_volume = 1.0f;
@@ -380,6 +480,9 @@ static void audio_dma_sync_mark(uint8_t half, uint8_t flag) {
         audio_out_ready_index = half;
         audio_sync_mask = 0U;
         audio_sync_half = 0xFFU;
+        if (block_isr_cb != NULL) {
+            block_isr_cb();
+        }
         chBSemSignalI(&audio_dma_sem);
     }
 
@@ -458,6 +561,57 @@ void __attribute__((weak)) drv_audio_process_block(const int32_t              *a
     }
 }
 
+/* -------------------------------------------------------------------------- */
+/* Traitement d'un bloc (temps réel ou rendu hors ligne)                      */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Chaîne complète d'un bloc : audio cartouches, snapshot de contrôle, hook de
+ * contrôle puis DSP. `link` = false en rendu hors ligne : le SPI-LINK suit
+ * l'horloge matérielle et ne peut pas être cadencé plus vite, l'entrée
+ * cartouches est alors silencieuse et rien ne leur est renvoyé.
+ */
+static void audio_run_block(const int32_t *in_buf, int32_t *out_buf, size_t frames, bool link) {
+    chSysLock();
+    audio_block_stamp = chSysGetRealtimeCounterX();
+    audio_frame_counter = audio_frame_next;
+    audio_frame_next += (uint32_t)frames;
+    chSysUnlock();
+
+    /* Récupère l'audio des cartouches si disponible. */
+    if (link && (spilink_pull_cb != NULL)) {
+        spilink_pull_cb((int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_in_buffers, frames);
+    } else {
+        memset((void *)spi_in_buffers, 0, sizeof(spi_in_buffers));
+    }
+
+    /* Mesures de latence, puis entrées alignées sur le chemin le plus lent. */
+    audio_align_input(in_buf, &audio_adc_aligned[0][0],
+                      (int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_in_buffers, frames, link);
+
+    audio_control_snapshot_t ctrl_snapshot;
+    audio_control_get_snapshot(&ctrl_snapshot);
+    audio_control_cached = ctrl_snapshot;
+
+    /* Traitements à cadence contrôle (modulation, séquenceur). */
+    if (control_cb != NULL) {
+        control_cb(frames);
+    }
+
+    drv_audio_process_block(&audio_adc_aligned[0][0],
+                             (int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_in_buffers,
+                             out_buf,
+                             (int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_out_buffers,
+                             frames);
+    audio_align_output(out_buf, AUDIO_NUM_OUTPUT_CHANNELS,
+                       (int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_out_buffers, frames);
+
+    /* Exporte le flux vers les cartouches si besoin. */
+    if (link && (spilink_push_cb != NULL)) {
+        spilink_push_cb((int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_out_buffers, frames);
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /* Thread audio : déclenché par les callbacks DMA                             */
 /* -------------------------------------------------------------------------- */
@@ -487,30 +641,8 @@ static THD_FUNCTION(audioThread, arg) {
         int32_t *out_buf = (int32_t *)audio_out_buffers[out_idx];
         audio_dcache_invalidate((void *)audio_in_buffers[in_idx], sizeof(audio_in_buffers[in_idx]));
 
-
-        /* Récupère l'audio des cartouches si disponible. */
-        if (spilink_pull_cb != NULL) {
-            spilink_pull_cb((int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_in_buffers, frames);
-        } else {
-            memset((void *)spi_in_buffers, 0, sizeof(spi_in_buffers));
-        }
-
-        audio_control_snapshot_t ctrl_snapshot;
-        audio_control_get_snapshot(&ctrl_snapshot);
-        audio_control_cached = ctrl_snapshot;
-
-        drv_audio_process_block(in_buf,
-                                 (int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_in_buffers,
-                                 out_buf,
-                                 (int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_out_buffers,
-                                 frames);
+        audio_run_block(in_buf, out_buf, frames, true);
         audio_dcache_clean((void *)audio_out_buffers[out_idx], sizeof(audio_out_buffers[out_idx]));
-
-
-        /* Exporte le flux vers les cartouches si besoin. */
-        if (spilink_push_cb != NULL) {
-            spilink_push_cb((int32_t (*)[AUDIO_FRAMES_PER_BUFFER][4])spi_out_buffers, frames);
-        }
     }
 }
 
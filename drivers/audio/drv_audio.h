@@ -17,6 +17,33 @@
 void drv_audio_init(void);
 void drv_audio_start(void);
 void drv_audio_stop(void);
+bool drv_audio_is_running(void);
+
+/*
+ * Horloge audio en frames (base des horodatages MIDI, latence…) : frames
+ * traitées depuis le démarrage, interpolées dans le bloc courant. La
+ * variante I s'appelle sous verrou ou depuis une ISR.
+ */
+uint32_t drv_audio_get_frame_time(void);
+uint32_t drv_audio_get_frame_timeI(void);
+
+/* Position (frames) du début du bloc en cours de traitement : thread audio uniquement. */
+uint32_t drv_audio_get_block_frame(void);
+
+/*
+ * Rendu hors ligne : exécute un bloc de AUDIO_FRAMES_PER_BUFFER frames (hook
+ * de contrôle + DSP) sur des buffers fournis, depuis le thread appelant.
+ * Refusé tant que le flux SAI/DMA tourne (drv_audio_stop d'abord).
+ */
+bool drv_audio_render_block(const int32_t *adc_in,   /* [frames][AUDIO_NUM_INPUT_CHANNELS]  */
+                            int32_t       *dac_out); /* [frames][AUDIO_NUM_OUTPUT_CHANNELS] */
+
+/*
+ * Avant un rendu hors ligne : lignes à retard d'alignement vidées, puis hook
+ * de remise à zéro du DSP (drv_audio_register_reset_cb). Refusé tant que le
+ * flux tourne.
+ */
+bool drv_audio_reset_render(void);
 
 const int32_t* drv_audio_get_input_buffer(uint8_t *index, size_t *frames);
 int32_t*       drv_audio_get_output_buffer(uint8_t *index, size_t *frames);
@@ -31,6 +58,18 @@ void drv_audio_set_master_volume(float vol);
 void drv_audio_set_route(uint8_t track, bool to_main, bool to_cue);
 void drv_audio_set_route_gain(uint8_t track, float gain_main, float gain_cue);
 
+/* Réglage de mixage appliqué au bloc courant. */
+typedef struct {
+    float   master_volume;
+    float   gain_main[4];
+    float   gain_cue[4];
+    uint8_t to_main_mask;     /* Une route par bit. */
+    uint8_t to_cue_mask;
+} drv_audio_mix_t;
+
+/* Thread audio uniquement (hook de contrôle) : copie sans verrou. */
+void drv_audio_get_mix(drv_audio_mix_t *mix);
+
 /* Hook faible pour le traitement DSP. */
 __attribute__((weak)) void drv_audio_process_block(
     const int32_t               *adc_in,   /* [frames][AUDIO_NUM_INPUT_CHANNELS]   */
@@ -39,11 +78,30 @@ __attribute__((weak)) void drv_audio_process_block(
     spilink_audio_block_t        spi_out,  /* [4][frames][4] cartouches sortantes */
     size_t                       frames);
 
-/* Interfaces SPI-LINK (stubs extensibles). */
+/* Interfaces SPI-LINK (drv_spilink), appelées par le thread audio autour du DSP. */
 typedef void (*drv_spilink_pull_cb_t)(spilink_audio_block_t dest, size_t frames);
 typedef void (*drv_spilink_push_cb_t)(const spilink_audio_block_t src, size_t frames);
 
 void drv_audio_register_spilink_pull(drv_spilink_pull_cb_t cb);
 void drv_audio_register_spilink_push(drv_spilink_push_cb_t cb);
 
+/*
+ * Hook de frontière de bloc, appelé sous verrou depuis l'ISR DMA SAI qui
+ * complète un demi-tampon (RX et TX), avant le réveil du thread audio : y
+ * lancer les transferts qui doivent recouvrir le DSP du bloc.
+ */
+typedef void (*drv_audio_block_isr_cb_t)(void);
+
+void drv_audio_register_block_isr_cb(drv_audio_block_isr_cb_t cb);
+
+/* Hook de contrôle (modulation, séquenceur…) appelé une fois par bloc, avant le DSP. */
+typedef void (*drv_audio_control_cb_t)(size_t frames);
+
+void drv_audio_register_control_cb(drv_audio_control_cb_t cb);
+
+/* Remise à zéro de l'état du DSP (oscillateurs, enveloppes…), voir drv_audio_reset_render. */
+typedef void (*drv_audio_reset_cb_t)(void);
+
+void drv_audio_register_reset_cb(drv_audio_reset_cb_t cb);
+
 #endif /* DRV_AUDIO_H */
@@ -14,9 +14,10 @@
 /* ========================== MIDI ========================= */
 /* ========================================================= */
 
-/* Port série utilisé pour le DIN MIDI (configuré dans midi.c).
- * Par défaut sur SD3 pour cette cible H743 (adapter selon le routage PCB). */
-#define BRICK_MIDI_UART            &SD3
+/* USART du DIN MIDI, piloté en registres + DMA par drivers/midi/drv_midi.c.
+ * USART3 pour cette cible H743 (adapter selon le routage PCB ; les vecteurs,
+ * horloge et requêtes DMAMUX associés sont dans drv_midi.h). */
+#define BRICK_MIDI_UART            USART3
 
 
 /* ========================================================= */
@@ -30,6 +31,15 @@
 #define BRICK_WS2812_DYNAMIC_MAP     1
 
 
+/* ========================================================= */
+/* ======================== BOUTONS ======================== */
+/* ========================================================= */
+
+/* 25 boutons lus par la chaîne de registres à décalage sur SPI5 */
+#define BRICK_NUM_BUTTONS            25
+#define BRICK_BUTTON_SR_BYTES        ((BRICK_NUM_BUTTONS + 7) / 8)
+
+
 /* ========================================================= */
 /* ==================== POTENTIOMÈTRES ===================== */
 /* ========================================================= */
@@ -78,8 +88,8 @@
 /* Pas de debug pour l’instant */
 #define BRICK_DEBUG_ENABLE           0
 
-/* Si activé plus tard : debug via SD3 (USART3) */
-#define BRICK_DEBUG_USE_SD3          1
+/* USART3 est réservé au DIN MIDI : pas de console série de debug. */
+#define BRICK_DEBUG_USE_SD3          0
 
 
 /* ========================================================= */
@@ -107,6 +117,34 @@
 #define BRICK_MAX_PLOCKS_PER_STEP    64
 
 
+/* ========================================================= */
+/* ====================== MODULATION ======================= */
+/* ========================================================= */
+
+/* Sources par piste : 2 LFO + 1 enveloppe */
+#define BRICK_MOD_LFOS_PER_TRACK     2
+#define BRICK_MOD_ENVS_PER_TRACK     1
+
+/* Taille de la matrice (routages et destinations) */
+#define BRICK_MOD_MAX_ROUTES         64
+#define BRICK_MOD_MAX_DESTS          64
+
+
+/* ========================================================= */
+/* ======================== MÉMOIRE ======================== */
+/* ========================================================= */
+
+/* SDRAM externe sur FMC (banque 2) : 0 tant que l'init FMC n'est pas câblée.
+ * Les pools volumineux (historique d'édition…) y sont placés quand elle est active. */
+#define BRICK_SDRAM_ENABLE           0
+
+#if BRICK_SDRAM_ENABLE
+#define BRICK_SDRAM_ATTR             __attribute__((section(".sdram"), aligned(32)))
+#else
+#define BRICK_SDRAM_ATTR             __attribute__((aligned(32)))
+#endif
+
+
 /* ========================================================= */
 /* ======================== AUDIO ========================== */
 /* ========================================================= */
@@ -136,10 +174,18 @@ BRICK_STATIC_ASSERT(BRICK_POT_MUX_COUNT == 1,
 BRICK_STATIC_ASSERT(BRICK_HALL_MUX_CHANNELS * BRICK_HALL_MUX_COUNT == BRICK_NUM_HALL_SENSORS,
                     hall_mux_mismatch);
 
+/* Boutons : états et compteurs anti-rebond sur un mot de 32 bits */
+BRICK_STATIC_ASSERT(BRICK_NUM_BUTTONS <= 32, too_many_buttons);
+
 /* Séquenceur figé V1 */
 BRICK_STATIC_ASSERT(BRICK_NUM_TRACKS == 16, tracks_must_be_16);
 BRICK_STATIC_ASSERT(BRICK_STEPS_PER_TRACK == 64, steps_must_be_64);
 
+/* Modulation : index de source/destination codés sur 8 bits */
+BRICK_STATIC_ASSERT(BRICK_NUM_TRACKS * (BRICK_MOD_LFOS_PER_TRACK + BRICK_MOD_ENVS_PER_TRACK) <= 255,
+                    too_many_mod_sources);
+BRICK_STATIC_ASSERT(BRICK_MOD_MAX_DESTS <= 255, too_many_mod_dests);
+
 /* Cartouches */
 BRICK_STATIC_ASSERT(BRICK_MAX_CARTRIDGES <= 4, too_many_cartridges);
 BRICK_STATIC_ASSERT(BRICK_MAX_VOICES_PER_CART <= 4, too_many_voices);
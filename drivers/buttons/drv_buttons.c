@@ -0,0 +1,269 @@
+/**
+ * @file drv_buttons.c
+ * @brief Scan SPI5 des 74HC165, anti-rebond par compteurs verticaux, file d'évènements datés.
+ * @ingroup drivers
+ */
+
+#include "drv_buttons.h"
+#include <string.h>
+
+#define BUTTONS_MASK          ((BUTTONS_COUNT >= 32) ? 0xFFFFFFFFU : ((1U << BUTTONS_COUNT) - 1U))
+
+BRICK_STATIC_ASSERT(BUTTONS_SR_BYTES <= 4, buttons_sr_fits_u32);
+BRICK_STATIC_ASSERT(BUTTONS_DEBOUNCE_SAMPLES == 4U, buttons_two_bit_counters);
+BRICK_STATIC_ASSERT((BUTTONS_EVENT_QUEUE_SIZE & (BUTTONS_EVENT_QUEUE_SIZE - 1U)) == 0U,
+                    buttons_queue_pow2);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+static uint8_t BUTTONS_DMA_BUFFER_ATTR btn_rx[BUTTONS_SR_BYTES];
+static SPIConfig btn_spi_cfg;
+
+/* Anti-rebond : état validé et compteurs 2 bits (bit i = bouton i). */
+static uint32_t btn_state = 0U;
+static uint32_t btn_cnt0 = 0U;
+static uint32_t btn_cnt1 = 0U;
+
+/* Maintien : date d'appui des boutons enfoncés, boutons déjà signalés. */
+static systime_t btn_press_time[BUTTONS_COUNT];
+static uint32_t btn_held = 0U;
+
+/* File [tail, head) : scan -> consommateur. */
+static drv_button_event_t btn_queue[BUTTONS_EVENT_QUEUE_SIZE];
+static uint32_t btn_head = 0U;
+static uint32_t btn_tail = 0U;
+static binary_semaphore_t btn_sem;
+
+static drv_buttons_stats_t btn_stats;
+static bool btn_initialized = false;
+static bool btn_running = false;
+
+static THD_WORKING_AREA(buttonsThreadWA, BUTTONS_THREAD_STACK_SIZE);
+
+static inline uint32_t btn_cycles_to_us(rtcnt_t cycles) {
+    return (uint32_t)(((uint64_t)cycles * 1000000U) / STM32_CORE_CK);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Lecture de la chaîne                                                       */
+/* -------------------------------------------------------------------------- */
+
+/* Un échantillon brut (1 = enfoncé) ; `t` reçoit la date du chargement parallèle. */
+static uint32_t btn_sample(systime_t *t) {
+    const rtcnt_t t0 = chSysGetRealtimeCounterX();
+    spiAcquireBus(&BUTTONS_SPI);
+    const uint32_t wait_us = btn_cycles_to_us(chSysGetRealtimeCounterX() - t0);
+
+    /* SH/LD bas pendant la configuration du SPI : largeur de chargement garantie. */
+    *t = chVTGetSystemTimeX();
+    palClearLine(BUTTONS_LINE_LOAD);
+    (void)spiStart(&BUTTONS_SPI, &btn_spi_cfg);
+    palSetLine(BUTTONS_LINE_LOAD);
+    spiReceive(&BUTTONS_SPI, BUTTONS_SR_BYTES, btn_rx);
+    spiReleaseBus(&BUTTONS_SPI);
+
+    uint32_t raw = 0U;
+    for (uint32_t i = 0U; i < BUTTONS_SR_BYTES; ++i) {
+        raw |= (uint32_t)btn_rx[i] << (8U * i);
+    }
+
+    chSysLock();
+    btn_stats.bus_wait_us_last = wait_us;
+    if (wait_us > btn_stats.bus_wait_us_max) {
+        btn_stats.bus_wait_us_max = wait_us;
+    }
+    chSysUnlock();
+    return ~raw & BUTTONS_MASK;
+}
+
+/*
+ * Compteurs verticaux : pour chaque bit où l'échantillon diffère de l'état,
+ * (cnt1, cnt0) avance de 00 à 11 puis repasse à 00 en basculant l'état ;
+ * ailleurs il est remis à 00. Retourne les bits basculés.
+ */
+static uint32_t btn_debounce(uint32_t sample) {
+    const uint32_t delta = sample ^ btn_state;
+
+    btn_cnt1 = (btn_cnt1 ^ btn_cnt0) & delta;
+    btn_cnt0 = ~btn_cnt0 & delta;
+    const uint32_t toggled = delta & ~(btn_cnt0 | btn_cnt1);
+    btn_state ^= toggled;
+    return toggled;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Évènements                                                                 */
+/* -------------------------------------------------------------------------- */
+
+static void btn_push_s(uint8_t button, drv_button_evt_type_t type, systime_t time) {
+    if (((btn_head - btn_tail) & (BUTTONS_EVENT_QUEUE_SIZE - 1U)) == (BUTTONS_EVENT_QUEUE_SIZE - 1U)) {
+        btn_stats.dropped++;
+        return;
+    }
+    drv_button_event_t *ev = &btn_queue[btn_head];
+    ev->time = time;
+    ev->button = button;
+    ev->type = (uint8_t)type;
+    btn_head = (btn_head + 1U) & (BUTTONS_EVENT_QUEUE_SIZE - 1U);
+    btn_stats.events++;
+    chBSemSignalI(&btn_sem);
+}
+
+static void btn_emit(uint32_t toggled, systime_t now) {
+    /* La bascule valide une série commencée BUTTONS_DEBOUNCE_SAMPLES - 1 scans plus tôt. */
+    const systime_t edge = (systime_t)(now -
+        TIME_US2I(BUTTONS_SCAN_PERIOD_US * (BUTTONS_DEBOUNCE_SAMPLES - 1U)));
+    const sysinterval_t hold = TIME_MS2I(BUTTONS_HOLD_MS);
+
+    chSysLock();
+    while (toggled != 0U) {
+        const uint8_t b = (uint8_t)__builtin_ctz(toggled);
+        const uint32_t bit = 1U << b;
+        toggled &= ~bit;
+        if ((btn_state & bit) != 0U) {
+            btn_press_time[b] = edge;
+            btn_push_s(b, BUTTON_EVT_PRESS, edge);
+        } else {
+            btn_held &= ~bit;
+            btn_push_s(b, BUTTON_EVT_RELEASE, edge);
+        }
+    }
+
+    uint32_t pending = btn_state & ~btn_held;
+    while (pending != 0U) {
+        const uint8_t b = (uint8_t)__builtin_ctz(pending);
+        const uint32_t bit = 1U << b;
+        pending &= ~bit;
+        if (chTimeDiffX(btn_press_time[b], now) >= hold) {
+            btn_held |= bit;
+            btn_push_s(b, BUTTON_EVT_HOLD, chTimeAddX(btn_press_time[b], hold));
+        }
+    }
+    chSchRescheduleS();
+    chSysUnlock();
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread de scan                                                             */
+/* -------------------------------------------------------------------------- */
+
+static THD_FUNCTION(buttonsThread, arg) {
+    (void)arg;
+    chRegSetThreadName("buttons");
+
+    const systime_t period = TIME_US2I(BUTTONS_SCAN_PERIOD_US);
+    systime_t next = chVTGetSystemTimeX();
+
+    while (true) {
+        systime_t prev = next;
+        next = chTimeAddX(next, period);
+
+        systime_t t;
+        const uint32_t toggled = btn_debounce(btn_sample(&t));
+        btn_emit(toggled, t);
+
+        /* Échéance dépassée (bus tenu par l'écran) : repart de maintenant. */
+        const systime_t now = chVTGetSystemTimeX();
+        chSysLock();
+        btn_stats.scans++;
+        if (!chTimeIsInRangeX(now, prev, next)) {
+            btn_stats.late++;
+            prev = now;
+            next = chTimeAddX(now, period);
+        }
+        chSysUnlock();
+        chThdSleepUntilWindowed(prev, next);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void drv_buttons_init(void) {
+    if (btn_initialized) {
+        return;
+    }
+
+    chBSemObjectInit(&btn_sem, true);
+    memset(&btn_stats, 0, sizeof(btn_stats));
+    memset(btn_press_time, 0, sizeof(btn_press_time));
+    btn_state = 0U;
+    btn_cnt0 = 0U;
+    btn_cnt1 = 0U;
+    btn_held = 0U;
+    btn_head = 0U;
+    btn_tail = 0U;
+
+    /* Plus petit prescaler (2^(MBR+1)) ne dépassant pas BUTTONS_SPI_CLOCK_HZ. */
+    uint32_t mbr = 0U;
+    while ((mbr < 7U) && ((STM32_SPI5CLK >> (mbr + 1U)) > BUTTONS_SPI_CLOCK_HZ)) {
+        mbr++;
+    }
+    memset(&btn_spi_cfg, 0, sizeof(btn_spi_cfg));
+    btn_spi_cfg.circular = false;
+    btn_spi_cfg.slave = false;
+    /* Ligne pilotée à la main (SH/LD, pas une sélection) : spiSelect n'est pas utilisé. */
+    btn_spi_cfg.ssport = PAL_PORT(BUTTONS_LINE_LOAD);
+    btn_spi_cfg.sspad = PAL_PAD(BUTTONS_LINE_LOAD);
+    btn_spi_cfg.cfg1 = SPI_CFG1_MBR_VALUE(mbr) | SPI_CFG1_DSIZE_VALUE(7U);   /* Octets, mode 0. */
+    btn_spi_cfg.cfg2 = 0U;
+
+    palSetLine(BUTTONS_LINE_LOAD);
+    btn_initialized = true;
+}
+
+void drv_buttons_start(void) {
+    if (!btn_initialized) {
+        drv_buttons_init();
+    }
+    if (btn_running) {
+        return;
+    }
+    chThdCreateStatic(buttonsThreadWA, sizeof(buttonsThreadWA),
+                      BUTTONS_THREAD_PRIORITY, buttonsThread, NULL);
+    btn_running = true;
+}
+
+bool drv_buttons_read(drv_button_event_t *ev, sysinterval_t timeout) {
+    if (ev == NULL) {
+        return false;
+    }
+
+    chSysLock();
+    while (btn_tail == btn_head) {
+        if (chBSemWaitTimeoutS(&btn_sem, timeout) != MSG_OK) {
+            chSysUnlock();
+            return false;
+        }
+    }
+    *ev = btn_queue[btn_tail];
+    btn_tail = (btn_tail + 1U) & (BUTTONS_EVENT_QUEUE_SIZE - 1U);
+    chSysUnlock();
+    return true;
+}
+
+uint32_t drv_buttons_get_state(void) {
+    chSysLock();
+    const uint32_t st = btn_state;
+    chSysUnlock();
+    return st;
+}
+
+bool drv_buttons_is_pressed(uint8_t button) {
+    if (button >= BUTTONS_COUNT) {
+        return false;
+    }
+    return (drv_buttons_get_state() & (1U << button)) != 0U;
+}
+
+void drv_buttons_get_stats(drv_buttons_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = btn_stats;
+    chSysUnlock();
+}
@@ -0,0 +1,92 @@
+/**
+ * @file drv_buttons.h
+ * @brief Boutons : chaîne de 74HC165 sur SPI5 (partagé avec l'OLED), anti-rebond par compteurs verticaux.
+ * @details Toutes les BUTTONS_SCAN_PERIOD_US, le thread de scan acquiert
+ * SPI5 (spiAcquireBus, le même verrou que drv_display), charge les entrées
+ * parallèles (LINE_SPI5_CS_SR bas, relié aux SH/LD des 74HC165), repasse en
+ * décalage et lit BRICK_BUTTON_SR_BYTES octets par DMA. Le thread dort
+ * pendant le transfert ; le bus est rendu aussitôt après, si bien qu'un scan
+ * ne retarde une image de l'écran que de quelques microsecondes, et
+ * qu'une image en cours retarde le scan d'au plus son propre transfert.
+ *
+ * Bouton i = entrée D(i % 8) du (i / 8)-ième 74HC165 en partant de MISO
+ * (premier octet reçu = boutons 0..7, D7 décalée en premier). Entrées
+ * actives à l'état bas (tirage au +3V3).
+ *
+ * Anti-rebond : un compteur de 2 bits par bouton, stocké « verticalement »
+ * (bit i de deux mots de 32 bits). Tous les boutons sont traités ensemble
+ * en six opérations logiques : le compteur d'un bouton avance tant que
+ * l'échantillon diffère de l'état validé, revient à 0 sinon, et l'état
+ * bascule au BUTTONS_DEBOUNCE_SAMPLES-ième échantillon différent
+ * consécutif.
+ *
+ * Évènements (appui, relâchement, maintien après BUTTONS_HOLD_MS) datés
+ * du premier échantillon de la série validée, dans une file lue par
+ * drv_buttons_read (un seul consommateur). File pleine : évènement perdu
+ * et compté, l'état (drv_buttons_get_state) reste exact.
+ *
+ * @ingroup drivers
+ */
+
+#ifndef DRV_BUTTONS_H
+#define DRV_BUTTONS_H
+
+#include "ch.h"
+#include "hal.h"
+#include "brick_config.h"
+
+#define BUTTONS_COUNT                 BRICK_NUM_BUTTONS
+#define BUTTONS_SR_BYTES              BRICK_BUTTON_SR_BYTES
+
+#define BUTTONS_SPI                   SPID5
+#define BUTTONS_LINE_LOAD             LINE_SPI5_CS_SR
+#define BUTTONS_SPI_CLOCK_HZ          10000000U
+
+#define BUTTONS_SCAN_PERIOD_US        1000U
+#define BUTTONS_DEBOUNCE_SAMPLES      4U          /* Fixé par les compteurs 2 bits. */
+#define BUTTONS_HOLD_MS               500U
+
+#define BUTTONS_EVENT_QUEUE_SIZE      32U         /* Puissance de 2. */
+
+#define BUTTONS_THREAD_STACK_SIZE     512U
+#define BUTTONS_THREAD_PRIORITY       NORMALPRIO
+
+/* Octets reçus par DMA SPI : RAM D2 non cacheable. */
+#define BUTTONS_DMA_BUFFER_ATTR       __attribute__((section(".ram_d2"), aligned(32)))
+
+typedef enum {
+    BUTTON_EVT_PRESS = 0,
+    BUTTON_EVT_RELEASE,
+    BUTTON_EVT_HOLD
+} drv_button_evt_type_t;
+
+typedef struct {
+    systime_t time;               /* Premier échantillon de la série validée. */
+    uint8_t   button;
+    uint8_t   type;               /* drv_button_evt_type_t. */
+} drv_button_event_t;
+
+typedef struct {
+    uint32_t scans;
+    uint32_t late;                /* Échéances de scan manquées. */
+    uint32_t events;
+    uint32_t dropped;             /* File d'évènements pleine. */
+    uint32_t bus_wait_us_last;    /* Attente du bus SPI5 (trafic écran). */
+    uint32_t bus_wait_us_max;
+} drv_buttons_stats_t;
+
+void drv_buttons_init(void);
+
+/* init si nécessaire + thread de scan. */
+void drv_buttons_start(void);
+
+/* Évènement suivant ; faux si aucun dans le délai. */
+bool drv_buttons_read(drv_button_event_t *ev, sysinterval_t timeout);
+
+/* États validés (anti-rebond), un bouton par bit. */
+uint32_t drv_buttons_get_state(void);
+bool drv_buttons_is_pressed(uint8_t button);
+
+void drv_buttons_get_stats(drv_buttons_stats_t *st);
+
+#endif /* DRV_BUTTONS_H */
@@ -0,0 +1,502 @@
+/**
+ * @file display_gfx.c
+ * @brief Primitives 1 bpp par mots de 32 bits et cache de glyphes prérastérisés.
+ * @ingroup drivers
+ */
+
+#include "display_gfx.h"
+#include <string.h>
+
+#define GFX_BYTES_X4(b)       ((uint32_t)(b) * 0x01010101U)
+#define GFX_CACHE_SETS        (GFX_GLYPH_CACHE_SLOTS / 2U)          /* Deux voies par ensemble. */
+#define GFX_CACHE_MASK        (GFX_CACHE_SETS - 1U)
+#define GFX_GLYPH_STRIDE      (GFX_FONT_W * GFX_MAX_SCALE + 2U)     /* 12 : multiple de 4. */
+#define GFX_GLYPH_PAGES       ((GFX_FONT_H * GFX_MAX_SCALE + 7U + 7U) / 8U)
+
+BRICK_STATIC_ASSERT((GFX_CACHE_SETS & GFX_CACHE_MASK) == 0U, gfx_cache_pow2);
+BRICK_STATIC_ASSERT(GFX_WIDTH <= 255U && (GFX_HEIGHT % 8U) == 0U, gfx_screen_geometry);
+BRICK_STATIC_ASSERT(GFX_FONT_H < 8U, gfx_font_single_page);
+
+/* -------------------------------------------------------------------------- */
+/* Police 5 × 7                                                               */
+/* -------------------------------------------------------------------------- */
+
+/* Une colonne par octet, bit 0 en haut (format de l'écran). */
+static const uint8_t gfx_font[GFX_FONT_LAST - GFX_FONT_FIRST + 1U][GFX_FONT_W] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, /*   ! */
+    {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14}, /* " # */
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, /* $ % */
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, /* & ' */
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00}, /* ( ) */
+    {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08}, /* * + */
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, /* , - */
+    {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02}, /* . / */
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, /* 0 1 */
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, /* 2 3 */
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, /* 4 5 */
+    {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03}, /* 6 7 */
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, /* 8 9 */
+    {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00}, /* : ; */
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, /* < = */
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, /* > ? */
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E}, /* @ A */
+    {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22}, /* B C */
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, /* D E */
+    {0x7F, 0x09, 0x09, 0x09, 0x01}, {0x3E, 0x41, 0x49, 0x49, 0x7A}, /* F G */
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, /* H I */
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, /* J K */
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x0C, 0x02, 0x7F}, /* L M */
+    {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E}, /* N O */
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, /* P Q */
+    {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31}, /* R S */
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, /* T U */
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, /* V W */
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x07, 0x08, 0x70, 0x08, 0x07}, /* X Y */
+    {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00}, /* Z [ */
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, /* \ ] */
+    {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40}, /* ^ _ */
+    {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78}, /* ` a */
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, /* b c */
+    {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18}, /* d e */
+    {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E}, /* f g */
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, /* h i */
+    {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x7F, 0x10, 0x28, 0x44, 0x00}, /* j k */
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78}, /* l m */
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, /* n o */
+    {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C}, /* p q */
+    {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20}, /* r s */
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, /* t u */
+    {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C}, /* v w */
+    {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C}, /* x y */
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, /* z { */
+    {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00}, /* | } */
+    {0x08, 0x04, 0x08, 0x10, 0x08}                                  /* ~   */
+};
+
+/* -------------------------------------------------------------------------- */
+/* Cache de glyphes                                                           */
+/* -------------------------------------------------------------------------- */
+
+/* Bandes de pages déjà décalées de `shift` lignes, `w` colonnes utiles. */
+typedef struct {
+    uint16_t key;                 /* 0 : entrée vide. */
+    uint8_t  pages;
+    uint8_t  w;
+    uint8_t  data[GFX_GLYPH_PAGES][GFX_GLYPH_STRIDE];
+} gfx_glyph_t;
+
+static gfx_glyph_t gfx_cache[GFX_CACHE_SETS][2];
+static uint8_t gfx_cache_lru[GFX_CACHE_SETS];     /* Voie la moins récemment servie. */
+static display_gfx_stats_t gfx_stats;
+
+/* -------------------------------------------------------------------------- */
+/* Outils                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Accès 32 bits non alignés : une seule instruction sur Cortex-M7. */
+static inline uint32_t gfx_load32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void gfx_store32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t gfx_apply32(uint32_t d, uint32_t v, display_gfx_mode_t mode) {
+    switch (mode) {
+    case GFX_CLEAR: return d & ~v;
+    case GFX_XOR:   return d ^ v;
+    default:        return d | v;
+    }
+}
+
+/* Page contenant y (division par défaut, y éventuellement négatif). */
+static inline int32_t gfx_page_of(int32_t y) {
+    return (y - (y & 7)) / 8;
+}
+
+/* Lignes y0..y1 (incluses) de la page p, en masque d'octet. */
+static inline uint8_t gfx_page_mask(int32_t p, int32_t y0, int32_t y1) {
+    const int32_t base = p * 8;
+    const int32_t a = (y0 > base) ? (y0 - base) : 0;
+    const int32_t b = (y1 < base + 7) ? (y1 - base) : 7;
+    return (uint8_t)((0xFFU << a) & (0xFFU >> (7 - b)));
+}
+
+static inline uint8_t gfx_scale(uint8_t scale) {
+    if (scale < 1U) {
+        return 1U;
+    }
+    return (scale > GFX_MAX_SCALE) ? (uint8_t)GFX_MAX_SCALE : scale;
+}
+
+static void gfx_mark(const display_gfx_t *g, int32_t p0, int32_t p1, int32_t x0, int32_t x1) {
+    if (g->mark == NULL) {
+        return;
+    }
+    for (int32_t p = p0; p <= p1; p++) {
+        g->mark((uint8_t)p, (uint8_t)x0, (uint8_t)x1);
+    }
+}
+
+/*
+ * Rogne le rectangle (x, y, w, h) à la découpe ; bornes incluses en sortie.
+ * Faux si rien ne reste.
+ */
+static bool gfx_clip(const display_gfx_t *g, int32_t x, int32_t y, int32_t w, int32_t h,
+                     int32_t *x0, int32_t *y0, int32_t *x1, int32_t *y1) {
+    if ((w <= 0) || (h <= 0)) {
+        return false;
+    }
+    *x0 = (x > g->clip_x0) ? x : g->clip_x0;
+    *y0 = (y > g->clip_y0) ? y : g->clip_y0;
+    *x1 = (x + w - 1 < g->clip_x1) ? (x + w - 1) : g->clip_x1;
+    *y1 = (y + h - 1 < g->clip_y1) ? (y + h - 1) : g->clip_y1;
+    return (*x0 <= *x1) && (*y0 <= *y1);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Noyaux                                                                     */
+/* -------------------------------------------------------------------------- */
+
+static void gfx_fill_core(display_gfx_t *g, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                          display_gfx_mode_t mode) {
+    const int32_t p0 = gfx_page_of(y0);
+    const int32_t p1 = gfx_page_of(y1);
+
+    for (int32_t p = p0; p <= p1; p++) {
+        const uint8_t m = gfx_page_mask(p, y0, y1);
+        const uint32_t m4 = GFX_BYTES_X4(m);
+        uint8_t *row = g->fb[p];
+        int32_t x = x0;
+
+        for (; (x + 3) <= x1; x += 4) {
+            gfx_store32(&row[x], gfx_apply32(gfx_load32(&row[x]), m4, mode));
+        }
+        for (; x <= x1; x++) {
+            row[x] = (uint8_t)gfx_apply32(row[x], m, mode);
+        }
+    }
+    gfx_mark(g, p0, p1, x0, x1);
+}
+
+/*
+ * Copie masquée d'une image en pages. La rangée k de `src` couvre les lignes
+ * 8 × (page0 + k) + shift .. + 7 ; seules les lignes top..bottom sont
+ * écrites. Un décalage non nul répartit chaque octet source sur deux pages,
+ * quatre colonnes à la fois.
+ */
+static void gfx_blit_core(display_gfx_t *g, const uint8_t *src, uint32_t stride,
+                          uint32_t src_pages, int32_t x, int32_t w, int32_t page0,
+                          uint32_t shift, int32_t top, int32_t bottom,
+                          display_gfx_mode_t mode) {
+    int32_t x0, y0, x1, y1;
+
+    if (!gfx_clip(g, x, top, w, bottom - top + 1, &x0, &y0, &x1, &y1)) {
+        return;
+    }
+
+    const uint32_t lo_m = GFX_BYTES_X4((0xFFU << shift) & 0xFFU);
+    const uint32_t hi_m = GFX_BYTES_X4(0xFFU >> ((8U - shift) & 7U));
+    const int32_t p0 = gfx_page_of(y0);
+    const int32_t p1 = gfx_page_of(y1);
+
+    for (int32_t p = p0; p <= p1; p++) {
+        const int32_t k = p - page0;
+        const uint8_t *cur = ((uint32_t)k < src_pages) ? &src[(uint32_t)k * stride] : NULL;
+        const uint8_t *prev = ((shift != 0U) && (k >= 1)) ? &src[(uint32_t)(k - 1) * stride] : NULL;
+        const uint8_t m = gfx_page_mask(p, y0, y1);
+        const uint32_t m4 = GFX_BYTES_X4(m);
+        uint8_t *row = g->fb[p];
+        int32_t c = x0;
+
+        for (; (c + 3) <= x1; c += 4) {
+            const int32_t s = c - x;
+            uint32_t v = 0U;
+            if (cur != NULL) {
+                v = (gfx_load32(&cur[s]) << shift) & lo_m;
+            }
+            if (prev != NULL) {
+                v |= (gfx_load32(&prev[s]) >> (8U - shift)) & hi_m;
+            }
+            gfx_store32(&row[c], gfx_apply32(gfx_load32(&row[c]), v & m4, mode));
+        }
+        for (; c <= x1; c++) {
+            const int32_t s = c - x;
+            uint32_t v = 0U;
+            if (cur != NULL) {
+                v = ((uint32_t)cur[s] << shift) & 0xFFU;
+            }
+            if (prev != NULL) {
+                v |= (uint32_t)prev[s] >> (8U - shift);
+            }
+            row[c] = (uint8_t)gfx_apply32(row[c], v & m, mode);
+        }
+    }
+    gfx_mark(g, p0, p1, x0, x1);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Glyphes                                                                    */
+/* -------------------------------------------------------------------------- */
+
+/* Colonne de 7 lignes agrandie ×2 : chaque bit dédoublé. */
+static uint32_t gfx_double_bits(uint32_t c) {
+    uint32_t r = 0U;
+    for (uint32_t i = 0U; i < GFX_FONT_H; i++) {
+        if ((c & (1U << i)) != 0U) {
+            r |= 3U << (2U * i);
+        }
+    }
+    return r;
+}
+
+static void gfx_rasterize(gfx_glyph_t *e, uint8_t ch, uint8_t scale, uint8_t shift) {
+    const uint8_t *cols = gfx_font[ch - GFX_FONT_FIRST];
+
+    memset(e->data, 0, sizeof(e->data));
+    e->w = (uint8_t)(GFX_FONT_W * scale);
+    e->pages = (uint8_t)((GFX_FONT_H * scale + shift + 7U) / 8U);
+    for (uint32_t i = 0U; i < GFX_FONT_W; i++) {
+        uint32_t bits = (scale == 2U) ? gfx_double_bits(cols[i]) : cols[i];
+        bits <<= shift;
+        for (uint32_t s = 0U; s < scale; s++) {
+            const uint32_t col = i * scale + s;
+            for (uint32_t p = 0U; p < e->pages; p++) {
+                e->data[p][col] = (uint8_t)(bits >> (8U * p));
+            }
+        }
+    }
+}
+
+static const gfx_glyph_t *gfx_glyph(uint8_t ch, uint8_t scale, uint8_t shift) {
+    const uint16_t key = (uint16_t)(ch | ((uint16_t)scale << 8) | ((uint16_t)shift << 10));
+    /* Hachage de Fibonacci sur la clé : ordonnées et échelles réparties sur les ensembles. */
+    const uint32_t set = ((uint32_t)(uint16_t)(key * 40503U) * GFX_CACHE_SETS) >> 16;
+    gfx_glyph_t *ways = gfx_cache[set];
+
+    for (uint32_t w = 0U; w < 2U; w++) {
+        if (ways[w].key == key) {
+            gfx_cache_lru[set] = (uint8_t)(w ^ 1U);
+            gfx_stats.glyph_hits++;
+            return &ways[w];
+        }
+    }
+
+    const uint32_t victim = gfx_cache_lru[set];
+    gfx_glyph_t *e = &ways[victim];
+    if (e->key != 0U) {
+        gfx_stats.glyph_evictions++;
+    }
+    gfx_stats.glyph_misses++;
+    gfx_rasterize(e, ch, scale, shift);
+    e->key = key;
+    gfx_cache_lru[set] = (uint8_t)(victim ^ 1U);
+    return e;
+}
+
+/* -------------------------------------------------------------------------- */
+/* API                                                                        */
+/* -------------------------------------------------------------------------- */
+
+void display_gfx_init(void) {
+    memset(gfx_cache, 0, sizeof(gfx_cache));
+    memset(gfx_cache_lru, 0, sizeof(gfx_cache_lru));
+    memset(&gfx_stats, 0, sizeof(gfx_stats));
+}
+
+void display_gfx_bind(display_gfx_t *g, display_gfx_fb_t *fb, display_gfx_mark_cb_t mark) {
+    g->fb = *fb;
+    g->mark = mark;
+    display_gfx_reset_clip(g);
+}
+
+void display_gfx_set_clip(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h) {
+    const display_gfx_t screen = {
+        .clip_x0 = 0, .clip_y0 = 0,
+        .clip_x1 = (int16_t)(GFX_WIDTH - 1U), .clip_y1 = (int16_t)(GFX_HEIGHT - 1U)
+    };
+    int32_t x0, y0, x1, y1;
+
+    if (!gfx_clip(&screen, x, y, w, h, &x0, &y0, &x1, &y1)) {
+        /* Découpe vide : plus rien n'est tracé. */
+        g->clip_x0 = 1;
+        g->clip_x1 = 0;
+        g->clip_y0 = 1;
+        g->clip_y1 = 0;
+        return;
+    }
+    g->clip_x0 = (int16_t)x0;
+    g->clip_y0 = (int16_t)y0;
+    g->clip_x1 = (int16_t)x1;
+    g->clip_y1 = (int16_t)y1;
+}
+
+void display_gfx_reset_clip(display_gfx_t *g) {
+    g->clip_x0 = 0;
+    g->clip_y0 = 0;
+    g->clip_x1 = (int16_t)(GFX_WIDTH - 1U);
+    g->clip_y1 = (int16_t)(GFX_HEIGHT - 1U);
+}
+
+void display_gfx_fill(display_gfx_t *g, display_gfx_mode_t mode) {
+    display_gfx_fill_rect(g, g->clip_x0, g->clip_y0,
+                          (int16_t)(g->clip_x1 - g->clip_x0 + 1),
+                          (int16_t)(g->clip_y1 - g->clip_y0 + 1), mode);
+}
+
+void display_gfx_fill_rect(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h,
+                           display_gfx_mode_t mode) {
+    int32_t x0, y0, x1, y1;
+
+    if (gfx_clip(g, x, y, w, h, &x0, &y0, &x1, &y1)) {
+        gfx_fill_core(g, x0, y0, x1, y1, mode);
+    }
+}
+
+void display_gfx_rect(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h,
+                      display_gfx_mode_t mode) {
+    if ((w <= 0) || (h <= 0)) {
+        return;
+    }
+    display_gfx_hline(g, x, y, w, mode);
+    if (h > 1) {
+        display_gfx_hline(g, x, (int16_t)(y + h - 1), w, mode);
+    }
+    if (h > 2) {
+        /* Côtés sans les coins : un XOR ne les inverse qu'une fois. */
+        display_gfx_vline(g, x, (int16_t)(y + 1), (int16_t)(h - 2), mode);
+        if (w > 1) {
+            display_gfx_vline(g, (int16_t)(x + w - 1), (int16_t)(y + 1), (int16_t)(h - 2), mode);
+        }
+    }
+}
+
+void display_gfx_invert_rect(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h) {
+    display_gfx_fill_rect(g, x, y, w, h, GFX_XOR);
+}
+
+void display_gfx_hline(display_gfx_t *g, int16_t x, int16_t y, int16_t w, display_gfx_mode_t mode) {
+    display_gfx_fill_rect(g, x, y, w, 1, mode);
+}
+
+void display_gfx_vline(display_gfx_t *g, int16_t x, int16_t y, int16_t h, display_gfx_mode_t mode) {
+    display_gfx_fill_rect(g, x, y, 1, h, mode);
+}
+
+void display_gfx_pixel(display_gfx_t *g, int16_t x, int16_t y, display_gfx_mode_t mode) {
+    display_gfx_fill_rect(g, x, y, 1, 1, mode);
+}
+
+void display_gfx_line(display_gfx_t *g, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                      display_gfx_mode_t mode) {
+    if (y0 == y1) {
+        const int16_t xa = (x0 < x1) ? x0 : x1;
+        display_gfx_hline(g, xa, y0, (int16_t)((x0 < x1 ? x1 - x0 : x0 - x1) + 1), mode);
+        return;
+    }
+    if (x0 == x1) {
+        const int16_t ya = (y0 < y1) ? y0 : y1;
+        display_gfx_vline(g, x0, ya, (int16_t)((y0 < y1 ? y1 - y0 : y0 - y1) + 1), mode);
+        return;
+    }
+
+    /* Bresenham, points rognés un à un, marquage du rectangle englobant. */
+    const int32_t dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
+    const int32_t dy = (y1 > y0) ? (y0 - y1) : (y1 - y0);
+    const int32_t sx = (x1 > x0) ? 1 : -1;
+    const int32_t sy = (y1 > y0) ? 1 : -1;
+    int32_t err = dx + dy;
+    int32_t x = x0;
+    int32_t y = y0;
+
+    for (;;) {
+        if ((x >= g->clip_x0) && (x <= g->clip_x1) && (y >= g->clip_y0) && (y <= g->clip_y1)) {
+            uint8_t *b = &g->fb[y >> 3][x];
+            *b = (uint8_t)gfx_apply32(*b, 1U << (y & 7), mode);
+        }
+        if ((x == x1) && (y == y1)) {
+            break;
+        }
+        const int32_t e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y += sy;
+        }
+    }
+
+    int32_t cx0, cy0, cx1, cy1;
+    if (gfx_clip(g, (x0 < x1) ? x0 : x1, (y0 < y1) ? y0 : y1, dx + 1, -dy + 1,
+                 &cx0, &cy0, &cx1, &cy1)) {
+        gfx_mark(g, gfx_page_of(cy0), gfx_page_of(cy1), cx0, cx1);
+    }
+}
+
+void display_gfx_bitmap(display_gfx_t *g, int16_t x, int16_t y, const display_gfx_bitmap_t *bmp,
+                        display_gfx_mode_t mode) {
+    if ((bmp == NULL) || (bmp->data == NULL)) {
+        return;
+    }
+    gfx_blit_core(g, bmp->data, bmp->w, (bmp->h + 7U) / 8U, x, bmp->w,
+                  gfx_page_of(y), (uint32_t)(y & 7), y, y + bmp->h - 1, mode);
+}
+
+int16_t display_gfx_char(display_gfx_t *g, int16_t x, int16_t y, char c,
+                         uint8_t scale, display_gfx_mode_t mode) {
+    uint8_t ch = (uint8_t)c;
+
+    scale = gfx_scale(scale);
+    if ((ch < GFX_FONT_FIRST) || (ch > GFX_FONT_LAST)) {
+        ch = '?';
+    }
+
+    const int16_t next = (int16_t)(x + GFX_CELL_W * scale);
+
+    /* Cellule entièrement hors découpe : pas de rastérisation. */
+    if ((x > g->clip_x1) || (next <= g->clip_x0) ||
+        (y > g->clip_y1) || ((y + (int16_t)(GFX_CELL_H * scale)) <= g->clip_y0)) {
+        return next;
+    }
+    if (ch == ' ') {
+        return next;
+    }
+
+    const gfx_glyph_t *e = gfx_glyph(ch, scale, (uint8_t)(y & 7));
+    gfx_blit_core(g, &e->data[0][0], GFX_GLYPH_STRIDE, e->pages, x, e->w,
+                  gfx_page_of(y), 0U, y, y + (int32_t)(GFX_FONT_H * scale) - 1, mode);
+    return next;
+}
+
+int16_t display_gfx_text(display_gfx_t *g, int16_t x, int16_t y, const char *str,
+                         uint8_t scale, display_gfx_mode_t mode) {
+    if (str == NULL) {
+        return x;
+    }
+    while ((*str != '\0') && (x <= g->clip_x1)) {
+        x = display_gfx_char(g, x, y, *str++, scale, mode);
+    }
+    /* Reste hors découpe : avance seule. */
+    while (*str++ != '\0') {
+        x = (int16_t)(x + GFX_CELL_W * gfx_scale(scale));
+    }
+    return x;
+}
+
+int16_t display_gfx_text_width(const char *str, uint8_t scale) {
+    if (str == NULL) {
+        return 0;
+    }
+    return (int16_t)(strlen(str) * GFX_CELL_W * gfx_scale(scale));
+}
+
+void display_gfx_get_stats(display_gfx_stats_t *st) {
+    if (st != NULL) {
+        *st = gfx_stats;
+    }
+}
@@ -0,0 +1,118 @@
+/**
+ * @file display_gfx.h
+ * @brief Primitives de dessin 1 bpp sur le tampon en pages de l'écran (texte, traits, rectangles, bitmaps).
+ * @details Le tampon est celui de drv_display : l'octet [page][x] porte les
+ * pixels (x, 8 × page .. 8 × page + 7), bit 0 en haut. Les primitives
+ * travaillent par mots de 32 bits, soit 4 colonnes × 8 lignes à la fois :
+ * un rectangle est un masque de lignes par page répété sur les colonnes,
+ * un bitmap est décalé verticalement par mots (décalage puis masquage des
+ * octets voisins), jamais pixel par pixel. Seuls les segments obliques
+ * (display_gfx_line) sont tracés point par point.
+ *
+ * Texte : police 5 × 7 en colonnes (ASCII 32..126), cellule 6 × 8, ou
+ * agrandie ×2 (cellule 12 × 16). Les glyphes sont prérastérisés à la
+ * demande dans un cache : bandes de pages déjà décalées pour l'ordonnée
+ * d'affichage (y & 7) et l'échelle, recopiées telles quelles au tracé. Une
+ * page d'UI réaffiche ses textes aux mêmes lignes : après la première
+ * image, le tracé d'un caractère n'est qu'une copie masquée de mots
+ * (cache associatif à deux voies, 128 glyphes, ~5 ko).
+ *
+ * Tout est rogné au rectangle de découpe du contexte (l'écran par défaut).
+ * Chaque primitive signale les octets touchés au callback de marquage
+ * (drv_display_mark sur cible), page par page.
+ *
+ * Non réentrant (cache partagé) : thread d'UI seulement.
+ * Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef DISPLAY_GFX_H
+#define DISPLAY_GFX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "brick_config.h"
+
+#define GFX_WIDTH                     BRICK_OLED_WIDTH
+#define GFX_HEIGHT                    BRICK_OLED_HEIGHT
+#define GFX_PAGES                     (BRICK_OLED_HEIGHT / 8U)
+
+#define GFX_FONT_FIRST                32U
+#define GFX_FONT_LAST                 126U
+#define GFX_FONT_W                    5U
+#define GFX_FONT_H                    7U
+#define GFX_CELL_W                    6U          /* Avance par caractère à l'échelle 1. */
+#define GFX_CELL_H                    8U
+#define GFX_MAX_SCALE                 2U
+
+#define GFX_GLYPH_CACHE_SLOTS         128U        /* Associatif à deux voies, puissance de 2. */
+
+typedef uint8_t display_gfx_fb_t[GFX_PAGES][GFX_WIDTH];
+
+typedef enum {
+    GFX_SET = 0,
+    GFX_CLEAR,
+    GFX_XOR
+} display_gfx_mode_t;
+
+/* Octets modifiés : page, colonnes x0..x1 incluses (signature de drv_display_mark). */
+typedef void (*display_gfx_mark_cb_t)(uint8_t page, uint8_t x0, uint8_t x1);
+
+typedef struct {
+    uint8_t (*fb)[GFX_WIDTH];
+    display_gfx_mark_cb_t mark;
+    int16_t clip_x0;              /* Découpe, bornes incluses. */
+    int16_t clip_y0;
+    int16_t clip_x1;
+    int16_t clip_y1;
+} display_gfx_t;
+
+/* Bitmap en pages, même format que l'écran : (h + 7) / 8 rangées de w octets. */
+typedef struct {
+    uint8_t w;
+    uint8_t h;
+    const uint8_t *data;
+} display_gfx_bitmap_t;
+
+typedef struct {
+    uint32_t glyph_hits;
+    uint32_t glyph_misses;
+    uint32_t glyph_evictions;
+} display_gfx_stats_t;
+
+void display_gfx_init(void);
+
+/* Contexte sur un tampon (drv_display_begin sur cible), découpe à l'écran entier. */
+void display_gfx_bind(display_gfx_t *g, display_gfx_fb_t *fb, display_gfx_mark_cb_t mark);
+void display_gfx_set_clip(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h);
+void display_gfx_reset_clip(display_gfx_t *g);
+
+void display_gfx_fill(display_gfx_t *g, display_gfx_mode_t mode);
+void display_gfx_fill_rect(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h,
+                           display_gfx_mode_t mode);
+void display_gfx_rect(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h,
+                      display_gfx_mode_t mode);
+void display_gfx_invert_rect(display_gfx_t *g, int16_t x, int16_t y, int16_t w, int16_t h);
+void display_gfx_hline(display_gfx_t *g, int16_t x, int16_t y, int16_t w, display_gfx_mode_t mode);
+void display_gfx_vline(display_gfx_t *g, int16_t x, int16_t y, int16_t h, display_gfx_mode_t mode);
+void display_gfx_line(display_gfx_t *g, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                      display_gfx_mode_t mode);
+void display_gfx_pixel(display_gfx_t *g, int16_t x, int16_t y, display_gfx_mode_t mode);
+
+void display_gfx_bitmap(display_gfx_t *g, int16_t x, int16_t y, const display_gfx_bitmap_t *bmp,
+                        display_gfx_mode_t mode);
+
+/*
+ * Texte à partir de (x, y), coin haut gauche de la première cellule ;
+ * caractères hors police affichés comme '?'. Retourne l'abscisse suivante.
+ */
+int16_t display_gfx_text(display_gfx_t *g, int16_t x, int16_t y, const char *str,
+                         uint8_t scale, display_gfx_mode_t mode);
+int16_t display_gfx_char(display_gfx_t *g, int16_t x, int16_t y, char c,
+                         uint8_t scale, display_gfx_mode_t mode);
+int16_t display_gfx_text_width(const char *str, uint8_t scale);
+
+void display_gfx_get_stats(display_gfx_stats_t *st);
+
+#endif /* DISPLAY_GFX_H */
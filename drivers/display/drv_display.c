@@ -0,0 +1,404 @@
+/**
+ * @file drv_display.c
+ * @brief SSD1309 sur SPI5 : comparaison au tampon avant, fenêtres DMA, cadence fixe.
+ * @ingroup drivers
+ */
+
+#include "drv_display.h"
+#include <string.h>
+
+BRICK_STATIC_ASSERT((BRICK_OLED_HEIGHT % 8) == 0, display_height_pages);
+BRICK_STATIC_ASSERT(BRICK_OLED_WIDTH <= 256, display_width_fits_byte);
+
+/* Commandes SSD1309 utilisées. */
+#define SSD_DISPLAY_OFF       0xAEU
+#define SSD_DISPLAY_ON        0xAFU
+#define SSD_SET_CONTRAST      0x81U
+#define SSD_ADDR_MODE         0x20U
+#define SSD_COLUMN_ADDR       0x21U
+#define SSD_PAGE_ADDR         0x22U
+
+#define DISPLAY_CMD_BYTES     8U
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+/* Fenêtre d'adressage : pages p0..p1, colonnes x0..x1. */
+typedef struct {
+    uint8_t p0;
+    uint8_t p1;
+    uint8_t x0;
+    uint8_t x1;
+} display_window_t;
+
+static drv_display_fb_t display_back;
+static drv_display_fb_t DISPLAY_DMA_BUFFER_ATTR display_front;
+static uint8_t DISPLAY_DMA_BUFFER_ATTR display_cmd[DISPLAY_CMD_BYTES];
+
+/* Plages marquées par page (lo > hi : page propre), sous display_lock. */
+static uint8_t display_dirty_lo[DISPLAY_PAGES];
+static uint8_t display_dirty_hi[DISPLAY_PAGES];
+static bool display_full = true;          /* Première image : tout envoyer. */
+
+static mutex_t display_lock;
+static SPIConfig display_spi_cfg;
+static uint32_t display_clock_hz;
+static volatile uint8_t display_fps = DISPLAY_DEFAULT_FPS;
+static volatile uint16_t display_contrast_req = 0U;    /* 0x100 | valeur : à envoyer. */
+static drv_display_stats_t display_stats;
+static bool display_initialized = false;
+static bool display_running = false;
+
+static THD_WORKING_AREA(displayThreadWA, DISPLAY_THREAD_STACK_SIZE);
+
+/* Configuration initiale (mode d'adressage horizontal, orientation, tensions). */
+static const uint8_t display_init_seq[] = {
+    SSD_DISPLAY_OFF,
+    0xD5U, 0x80U,                 /* Horloge interne. */
+    0xA8U, (uint8_t)(DISPLAY_HEIGHT - 1U),
+    0xD3U, 0x00U,                 /* Décalage vertical. */
+    0x40U,                        /* Ligne de départ 0. */
+    SSD_ADDR_MODE, 0x00U,         /* Horizontal : fenêtres colonnes × pages. */
+    0xA1U,                        /* Segments inversés. */
+    0xC8U,                        /* Balayage COM descendant. */
+    0xDAU, 0x12U,                 /* Broches COM alternées. */
+    SSD_SET_CONTRAST, DISPLAY_DEFAULT_CONTRAST,
+    0xD9U, 0xF1U,                 /* Précharge. */
+    0xDBU, 0x34U,                 /* VCOMH. */
+    0xA4U,                        /* Affiche la RAM. */
+    0xA6U,                        /* Non inversé. */
+};
+
+/* -------------------------------------------------------------------------- */
+/* Bus                                                                        */
+/* -------------------------------------------------------------------------- */
+
+static inline uint32_t display_cycles_to_us(rtcnt_t cycles) {
+    return (uint32_t)(((uint64_t)cycles * 1000000U) / STM32_CORE_CK);
+}
+
+/* Sous bus acquis et sélectionné. */
+static void display_send_cmd(const uint8_t *cmd, size_t len) {
+    palClearLine(DISPLAY_LINE_DC);
+    memcpy(display_cmd, cmd, len);
+    spiSend(&DISPLAY_SPI, len, display_cmd);
+}
+
+static void display_bus_begin(void) {
+    spiAcquireBus(&DISPLAY_SPI);
+    (void)spiStart(&DISPLAY_SPI, &display_spi_cfg);
+    spiSelect(&DISPLAY_SPI);
+}
+
+static void display_bus_end(void) {
+    spiUnselect(&DISPLAY_SPI);
+    spiReleaseBus(&DISPLAY_SPI);
+}
+
+static void display_controller_init(void) {
+    palClearLine(DISPLAY_LINE_RES);
+    chThdSleepMilliseconds(1);
+    palSetLine(DISPLAY_LINE_RES);
+    chThdSleepMilliseconds(1);
+
+    display_bus_begin();
+    for (size_t i = 0U; i < sizeof(display_init_seq); i += DISPLAY_CMD_BYTES) {
+        const size_t n = sizeof(display_init_seq) - i;
+        display_send_cmd(&display_init_seq[i], (n > DISPLAY_CMD_BYTES) ? DISPLAY_CMD_BYTES : n);
+    }
+    display_bus_end();
+}
+
+/* -------------------------------------------------------------------------- */
+/* Préparation d'une image                                                    */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Sous display_lock : réduit chaque plage marquée aux octets différents du
+ * tampon avant, les recopie, et regroupe les pages consécutives de même
+ * plage. Retourne le nombre de fenêtres.
+ */
+static size_t display_collect(display_window_t *win) {
+    size_t n = 0U;
+
+    for (uint8_t p = 0U; p < DISPLAY_PAGES; ++p) {
+        int32_t lo = display_dirty_lo[p];
+        int32_t hi = display_dirty_hi[p];
+        display_dirty_lo[p] = 0xFFU;
+        display_dirty_hi[p] = 0U;
+        if (lo > hi) {
+            continue;
+        }
+
+        const uint8_t *b = display_back[p];
+        uint8_t *f = display_front[p];
+        if (!display_full) {
+            while ((lo <= hi) && (b[lo] == f[lo])) {
+                lo++;
+            }
+            while ((hi >= lo) && (b[hi] == f[hi])) {
+                hi--;
+            }
+            if (lo > hi) {
+                continue;
+            }
+        }
+        memcpy(&f[lo], &b[lo], (size_t)(hi - lo + 1));
+
+        if ((n > 0U) && (win[n - 1U].p1 == (uint8_t)(p - 1U)) &&
+            (win[n - 1U].x0 == (uint8_t)lo) && (win[n - 1U].x1 == (uint8_t)hi)) {
+            win[n - 1U].p1 = p;
+        } else {
+            win[n].p0 = p;
+            win[n].p1 = p;
+            win[n].x0 = (uint8_t)lo;
+            win[n].x1 = (uint8_t)hi;
+            n++;
+        }
+    }
+    display_full = false;
+    return n;
+}
+
+/* Bus acquis : une commande d'adressage, puis les pixels page par page. */
+static uint32_t display_send_window(const display_window_t *w) {
+    const uint8_t cmd[6] = { SSD_COLUMN_ADDR, w->x0, w->x1, SSD_PAGE_ADDR, w->p0, w->p1 };
+    const size_t len = (size_t)(w->x1 - w->x0) + 1U;
+
+    display_send_cmd(cmd, sizeof(cmd));
+    palSetLine(DISPLAY_LINE_DC);
+    for (uint8_t p = w->p0; p <= w->p1; ++p) {
+        spiSend(&DISPLAY_SPI, len, &display_front[p][w->x0]);
+    }
+    return (uint32_t)(len * (size_t)(w->p1 - w->p0 + 1U));
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread d'affichage                                                         */
+/* -------------------------------------------------------------------------- */
+
+static THD_FUNCTION(displayThread, arg) {
+    (void)arg;
+    chRegSetThreadName("display");
+
+    display_controller_init();
+
+    display_window_t win[DISPLAY_PAGES];
+    systime_t next = chVTGetSystemTimeX();
+    systime_t window_start = next;
+    uint32_t window_bus_us = 0U;
+    bool on = false;
+
+    while (true) {
+        const rtcnt_t t0 = chSysGetRealtimeCounterX();
+        chMtxLock(&display_lock);
+        const size_t nwin = display_collect(win);
+        chMtxUnlock(&display_lock);
+        chSysLock();
+        const uint16_t contrast = display_contrast_req;
+        display_contrast_req = 0U;
+        chSysUnlock();
+        rtcnt_t cpu = chSysGetRealtimeCounterX() - t0;
+
+        uint32_t bytes = 0U;
+        uint32_t bus_us = 0U;
+        if ((nwin > 0U) || (contrast != 0U) || !on) {
+            const rtcnt_t b0 = chSysGetRealtimeCounterX();
+            display_bus_begin();
+            if (contrast != 0U) {
+                const uint8_t cmd[2] = { SSD_SET_CONTRAST, (uint8_t)contrast };
+                display_send_cmd(cmd, sizeof(cmd));
+            }
+            for (size_t i = 0U; i < nwin; ++i) {
+                bytes += display_send_window(&win[i]);
+            }
+            if (!on) {
+                const uint8_t cmd = SSD_DISPLAY_ON;
+                display_send_cmd(&cmd, 1U);
+                on = true;
+            }
+            display_bus_end();
+            const rtcnt_t bus = chSysGetRealtimeCounterX() - b0;
+            bus_us = display_cycles_to_us(bus);
+
+            /* Temps CPU de l'envoi : préparation des commandes, le DMA n'en fait pas partie. */
+            const rtcnt_t dma = (rtcnt_t)(((uint64_t)bytes * 8U * STM32_CORE_CK) /
+                                          display_clock_hz);
+            cpu += (bus > dma) ? (bus - dma) : 0U;
+        }
+
+        /* Occupation du bus par fenêtres d'une seconde. */
+        window_bus_us += bus_us;
+        const systime_t now = chVTGetSystemTimeX();
+        const uint32_t elapsed_us = (uint32_t)TIME_I2US(chTimeDiffX(window_start, now));
+        uint8_t bus_pct = 0xFFU;
+        if (elapsed_us >= 1000000U) {
+            const uint32_t pct = (uint32_t)(((uint64_t)window_bus_us * 100U) / elapsed_us);
+            bus_pct = (uint8_t)((pct > 100U) ? 100U : pct);
+            window_bus_us = 0U;
+            window_start = now;
+        }
+
+        /* Échéance suivante ; une image trop longue repart d'ici, sans rattrapage. */
+        const systime_t period = TIME_US2I(1000000U / display_fps);
+        systime_t prev = next;
+        next = chTimeAddX(next, period);
+        const bool overrun = !chTimeIsInRangeX(now, prev, next);
+        if (overrun) {
+            prev = now;
+            next = chTimeAddX(now, period);
+        }
+
+        chSysLock();
+        const uint32_t cpu_us = display_cycles_to_us(cpu);
+        display_stats.cpu_us_last = cpu_us;
+        if (cpu_us > display_stats.cpu_us_max) {
+            display_stats.cpu_us_max = cpu_us;
+        }
+        display_stats.bus_us_last = bus_us;
+        if (bus_us > display_stats.bus_us_max) {
+            display_stats.bus_us_max = bus_us;
+        }
+        if (nwin > 0U) {
+            display_stats.frames++;
+            display_stats.windows += (uint32_t)nwin;
+            display_stats.bytes += bytes;
+        } else {
+            display_stats.idle_frames++;
+        }
+        if (overrun) {
+            display_stats.overruns++;
+        }
+        if (bus_pct != 0xFFU) {
+            display_stats.bus_pct = bus_pct;
+        }
+        chSysUnlock();
+
+        chThdSleepUntilWindowed(prev, next);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void drv_display_init(void) {
+    if (display_initialized) {
+        return;
+    }
+
+    chMtxObjectInit(&display_lock);
+    memset(display_back, 0, sizeof(display_back));
+    memset(display_front, 0, sizeof(display_front));
+    memset(&display_stats, 0, sizeof(display_stats));
+    for (uint8_t p = 0U; p < DISPLAY_PAGES; ++p) {
+        display_dirty_lo[p] = 0U;
+        display_dirty_hi[p] = (uint8_t)(DISPLAY_WIDTH - 1U);
+    }
+    display_full = true;
+
+    /* Plus petit prescaler (2^(MBR+1)) ne dépassant pas DISPLAY_SPI_CLOCK_HZ. */
+    uint32_t mbr = 0U;
+    while ((mbr < 7U) && ((STM32_SPI5CLK >> (mbr + 1U)) > DISPLAY_SPI_CLOCK_HZ)) {
+        mbr++;
+    }
+    display_clock_hz = STM32_SPI5CLK >> (mbr + 1U);
+    memset(&display_spi_cfg, 0, sizeof(display_spi_cfg));
+    display_spi_cfg.circular = false;
+    display_spi_cfg.slave = false;
+    display_spi_cfg.ssport = PAL_PORT(DISPLAY_LINE_CS);
+    display_spi_cfg.sspad = PAL_PAD(DISPLAY_LINE_CS);
+    display_spi_cfg.cfg1 = SPI_CFG1_MBR_VALUE(mbr) | SPI_CFG1_DSIZE_VALUE(7U);   /* Octets, mode 0. */
+    display_spi_cfg.cfg2 = 0U;
+
+    palSetLine(DISPLAY_LINE_CS);
+    palSetLine(DISPLAY_LINE_RES);
+    display_fps = DISPLAY_DEFAULT_FPS;
+    display_stats.fps = DISPLAY_DEFAULT_FPS;
+    display_initialized = true;
+}
+
+void drv_display_start(void) {
+    if (!display_initialized || display_running) {
+        return;
+    }
+    chThdCreateStatic(displayThreadWA, sizeof(displayThreadWA),
+                      DISPLAY_THREAD_PRIORITY, displayThread, NULL);
+    display_running = true;
+}
+
+drv_display_fb_t *drv_display_begin(void) {
+    chMtxLock(&display_lock);
+    return &display_back;
+}
+
+void drv_display_end(void) {
+    chMtxUnlock(&display_lock);
+}
+
+void drv_display_mark(uint8_t page, uint8_t x0, uint8_t x1) {
+    if ((page >= DISPLAY_PAGES) || (x0 > x1) || (x0 >= DISPLAY_WIDTH)) {
+        return;
+    }
+    if (x1 >= DISPLAY_WIDTH) {
+        x1 = (uint8_t)(DISPLAY_WIDTH - 1U);
+    }
+    if (x0 < display_dirty_lo[page]) {
+        display_dirty_lo[page] = x0;
+    }
+    if (x1 > display_dirty_hi[page]) {
+        display_dirty_hi[page] = x1;
+    }
+}
+
+void drv_display_mark_rect(int16_t x, int16_t y, int16_t w, int16_t h) {
+    int32_t x0 = x;
+    int32_t y0 = y;
+    int32_t x1 = (int32_t)x + w - 1;
+    int32_t y1 = (int32_t)y + h - 1;
+
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 >= (int32_t)DISPLAY_WIDTH) {
+        x1 = (int32_t)DISPLAY_WIDTH - 1;
+    }
+    if (y1 >= (int32_t)DISPLAY_HEIGHT) {
+        y1 = (int32_t)DISPLAY_HEIGHT - 1;
+    }
+    if ((x0 > x1) || (y0 > y1)) {
+        return;
+    }
+    for (int32_t p = y0 >> 3; p <= (y1 >> 3); ++p) {
+        drv_display_mark((uint8_t)p, (uint8_t)x0, (uint8_t)x1);
+    }
+}
+
+void drv_display_set_fps(uint8_t fps) {
+    if (fps == 0U) {
+        fps = 1U;
+    } else if (fps > DISPLAY_MAX_FPS) {
+        fps = DISPLAY_MAX_FPS;
+    }
+    display_fps = fps;
+    chSysLock();
+    display_stats.fps = fps;
+    chSysUnlock();
+}
+
+void drv_display_set_contrast(uint8_t contrast) {
+    display_contrast_req = (uint16_t)(0x100U | contrast);
+}
+
+void drv_display_get_stats(drv_display_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = display_stats;
+    chSysUnlock();
+}
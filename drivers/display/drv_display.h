@@ -0,0 +1,91 @@
+/**
+ * @file drv_display.h
+ * @brief Écran OLED SSD1309 128×64 sur SPI5 : tampon 1 bpp, pages modifiées seules envoyées.
+ * @details Tampon en pages (format natif du contrôleur) : l'octet
+ * [page][x] porte les pixels (x, 8 × page .. 8 × page + 7), bit 0 en haut.
+ *
+ * Double tampon : l'UI dessine dans le tampon arrière entre
+ * drv_display_begin et drv_display_end (mutex) et marque ce qu'elle touche,
+ * par page et plage de colonnes. À chaque échéance, le thread d'affichage
+ * prend le mutex le temps de comparer les plages marquées au tampon avant
+ * (l'image à l'écran, en RAM D2 non cacheable pour le DMA), de réduire
+ * chaque plage aux octets réellement différents et de les recopier ; une
+ * image redessinée à l'identique ne coûte donc rien sur le bus. Les pages
+ * consécutives de même plage partagent une fenêtre d'adressage (une
+ * commande, puis une émission DMA par page).
+ *
+ * Cadence : une échéance toutes les 1/fps s (drv_display_set_fps), sans
+ * rattrapage si une image déborde. Compteurs : temps CPU du thread par
+ * image (comparaison, copie, commandes, hors attente DMA), durée d'occupation
+ * du bus par image et occupation moyenne du bus sur la dernière seconde.
+ *
+ * SPI5 est partagé (registres à décalage des boutons) : chaque image prend
+ * le bus avec spiAcquireBus et reprogramme sa configuration.
+ *
+ * @ingroup drivers
+ */
+
+#ifndef DRV_DISPLAY_H
+#define DRV_DISPLAY_H
+
+#include "ch.h"
+#include "hal.h"
+#include "brick_config.h"
+
+#define DISPLAY_WIDTH                 BRICK_OLED_WIDTH
+#define DISPLAY_HEIGHT                BRICK_OLED_HEIGHT
+#define DISPLAY_PAGES                 (BRICK_OLED_HEIGHT / 8U)
+
+#define DISPLAY_SPI                   SPID5
+#define DISPLAY_LINE_CS               LINE_SPI5_CS_OLED
+#define DISPLAY_LINE_DC               LINE_SPI5_DC_OLED
+#define DISPLAY_LINE_RES              LINE_SPI5_RES_OLED
+#define DISPLAY_SPI_CLOCK_HZ          10000000U   /* Maximum SSD1309 (cycle 100 ns). */
+
+#define DISPLAY_DEFAULT_FPS           60U
+#define DISPLAY_MAX_FPS               120U
+#define DISPLAY_DEFAULT_CONTRAST      0xCFU
+
+#define DISPLAY_THREAD_STACK_SIZE     768U
+#define DISPLAY_THREAD_PRIORITY       (NORMALPRIO - 1)
+
+/** Tampon avant, lu par le DMA SPI5 : RAM D2 non cacheable. */
+#define DISPLAY_DMA_BUFFER_ATTR       __attribute__((section(".ram_d2"), aligned(32)))
+
+typedef uint8_t drv_display_fb_t[DISPLAY_PAGES][DISPLAY_WIDTH];
+
+typedef struct {
+    uint32_t frames;          /* Échéances avec au moins un octet envoyé. */
+    uint32_t idle_frames;     /* Échéances sans changement. */
+    uint32_t overruns;        /* Image plus longue que la période. */
+    uint32_t bytes;           /* Octets de pixels envoyés. */
+    uint32_t windows;         /* Fenêtres d'adressage envoyées. */
+    uint32_t cpu_us_last;
+    uint32_t cpu_us_max;
+    uint32_t bus_us_last;
+    uint32_t bus_us_max;
+    uint8_t  bus_pct;         /* Occupation du bus sur la dernière seconde. */
+    uint8_t  fps;
+} drv_display_stats_t;
+
+void drv_display_init(void);
+
+/* Lance le thread : reset et configuration du contrôleur, puis images cadencées. */
+void drv_display_start(void);
+
+/* Tampon arrière, mutex pris ; à rendre par drv_display_end. */
+drv_display_fb_t *drv_display_begin(void);
+void drv_display_end(void);
+
+/* Marque des octets modifiés (entre begin et end) : page, colonnes x0..x1 incluses. */
+void drv_display_mark(uint8_t page, uint8_t x0, uint8_t x1);
+
+/* Marque le rectangle de pixels (x, y, w, h), rogné à l'écran. */
+void drv_display_mark_rect(int16_t x, int16_t y, int16_t w, int16_t h);
+
+void drv_display_set_fps(uint8_t fps);
+void drv_display_set_contrast(uint8_t contrast);
+
+void drv_display_get_stats(drv_display_stats_t *st);
+
+#endif /* DRV_DISPLAY_H */
@@ -5,6 +5,10 @@
  */
 
 #include "drivers.h"
+#include "display_gfx.h"
+#include "drv_buttons.h"
+#include "drv_display.h"
+#include "drv_leds_addr.h"
 
 void drivers_init_all(void) {
 
@@ -15,12 +19,18 @@ void drivers_init_all(void) {
        - drv_encoders  : start = init + thread de scan
        - drv_pots      : start = init + thread de scan */
 
+    drv_display_init();
+    display_gfx_init();
+    drv_display_start();
+
+    drv_leds_addr_init();
+    drv_buttons_start();
 }
 
-/* Mise à jour périodique : surtout pour l’écran (les LEDs sont rendues via ui_led_backend_refresh). */
+/* Mise à jour périodique : surtout pour l’écran (les LEDs sont rendues par le thread d’UI). */
 void drivers_update_all(void) {
     /* ⚠️ Ne **pas** appeler drv_leds_addr_update() ici.
-       Le pipeline LED passe par ui_led_backend_refresh() → drv_leds_addr_render().
+       Le thread de rendu de l’UI appelle drv_leds_addr_render() à chaque échéance.
 
        L’écran est rafraîchi par le thread lancé dans drv_display_start(),
        aucun appel direct à drv_display_update() n’est nécessaire ici. */
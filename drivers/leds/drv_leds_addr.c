@@ -0,0 +1,352 @@
+/**
+ * @file drv_leds_addr.c
+ * @brief WS2812 : TIM8_CH2 en PWM, DMA vers CCR2 sur mise à jour, réencodage des LEDs changées.
+ * @ingroup drivers
+ */
+
+#include "drv_leds_addr.h"
+#include <string.h>
+
+#if STM32_PWM_USE_TIM8 || STM32_GPT_USE_TIM8
+#error "drv_leds_addr pilote TIM8 directement : STM32_PWM_USE_TIM8 / STM32_GPT_USE_TIM8 doivent être FALSE"
+#endif
+
+/* Période d'un bit et durées hautes, en ticks du timer. */
+#define LEDS_ARR              ((LEDS_ADDR_TIM_CLOCK / LEDS_ADDR_BIT_HZ) - 1U)
+#define LEDS_T0H              ((uint16_t)(((uint64_t)LEDS_ADDR_TIM_CLOCK * LEDS_ADDR_T0H_NS) / 1000000000U))
+#define LEDS_T1H              ((uint16_t)(((uint64_t)LEDS_ADDR_TIM_CLOCK * LEDS_ADDR_T1H_NS) / 1000000000U))
+
+#define LEDS_BITS_PER_LED     24U
+#define LEDS_TAIL_SLOTS       2U          /* Périodes à 0 : dernier bit complet à l'arrêt. */
+#define LEDS_BUF_LEN          ((LEDS_ADDR_COUNT * LEDS_BITS_PER_LED) + LEDS_TAIL_SLOTS)
+
+#define LEDS_COLOR_NONE       0xFFFFFFFFU /* Jamais une couleur GRB 24 bits. */
+
+BRICK_STATIC_ASSERT(LEDS_ADDR_COUNT <= 255, leds_count_fits_u8);
+BRICK_STATIC_ASSERT(LEDS_ARR <= 0xFFFFU, leds_arr_fits_16bit);
+BRICK_STATIC_ASSERT((LEDS_T0H > 0U) && (LEDS_T0H < LEDS_T1H) && (LEDS_T1H < LEDS_ARR), leds_timing_valid);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+/* Une valeur de CCR2 par bit, lue par le DMA. */
+static uint16_t LEDS_ADDR_DMA_BUFFER_ATTR leds_buf[LEDS_BUF_LEN];
+
+/* Quartet -> 4 valeurs de CCR2, bit de poids fort d'abord. */
+#define LEDS_B(n, bit)        ((((n) >> (bit)) & 1U) ? LEDS_T1H : LEDS_T0H)
+#define LEDS_NIB(n)           { LEDS_B(n, 3), LEDS_B(n, 2), LEDS_B(n, 1), LEDS_B(n, 0) }
+static const uint16_t leds_nibble[16][4] = {
+    LEDS_NIB(0U),  LEDS_NIB(1U),  LEDS_NIB(2U),  LEDS_NIB(3U),
+    LEDS_NIB(4U),  LEDS_NIB(5U),  LEDS_NIB(6U),  LEDS_NIB(7U),
+    LEDS_NIB(8U),  LEDS_NIB(9U),  LEDS_NIB(10U), LEDS_NIB(11U),
+    LEDS_NIB(12U), LEDS_NIB(13U), LEDS_NIB(14U), LEDS_NIB(15U),
+};
+
+/* Gamma 2,2, entrée et sortie 8 bits. */
+static const uint8_t leds_gamma[256] = {
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,
+      1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
+      3,  3,  3,  3,  3,  4,  4,  4,  4,  5,  5,  5,  5,  6,  6,  6,
+      6,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10, 10, 11, 11, 11, 12,
+     12, 13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19,
+     20, 20, 21, 22, 22, 23, 23, 24, 25, 25, 26, 26, 27, 28, 28, 29,
+     30, 30, 31, 32, 33, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41,
+     42, 43, 43, 44, 45, 46, 47, 48, 49, 49, 50, 51, 52, 53, 54, 55,
+     56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71,
+     73, 74, 75, 76, 77, 78, 79, 81, 82, 83, 84, 85, 87, 88, 89, 90,
+     91, 93, 94, 95, 97, 98, 99,100,102,103,105,106,107,109,110,111,
+    113,114,116,117,119,120,121,123,124,126,127,129,130,132,133,135,
+    137,138,140,141,143,145,146,148,149,151,153,154,156,158,159,161,
+    163,165,166,168,170,172,173,175,177,179,181,182,184,186,188,190,
+    192,194,196,197,199,201,203,205,207,209,211,213,215,217,219,221,
+    223,225,227,229,231,234,236,238,240,242,244,246,248,251,253,255,
+};
+
+/* Luminosité puis gamma, recalculée par drv_leds_addr_set_brightness. */
+static uint8_t leds_lut[256];
+static uint8_t leds_brightness = LEDS_ADDR_DEFAULT_BRIGHTNESS;
+
+/* Couleurs demandées (index logique) et dernière couleur encodée (position physique). */
+static uint8_t leds_rgb[LEDS_ADDR_COUNT][3];
+static uint32_t leds_sent[LEDS_ADDR_COUNT];
+static uint8_t leds_map[LEDS_ADDR_COUNT];
+static bool leds_dirty = false;
+
+static const stm32_dma_stream_t *leds_dma = NULL;
+static binary_semaphore_t leds_done_sem;
+static bool leds_busy = false;
+static volatile systime_t leds_frame_end;
+
+static drv_leds_addr_stats_t leds_stats;
+static bool leds_initialized = false;
+
+static inline uint32_t leds_cycles_to_us(rtcnt_t cycles) {
+    return (uint32_t)(((uint64_t)cycles * 1000000U) / STM32_CORE_CK);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Transfert                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* Timer arrêté, sortie basse : CCR2 à 0 chargé dans le registre actif. */
+static void leds_tim_idle(void) {
+    LEDS_ADDR_TIM->CR1 &= ~TIM_CR1_CEN;
+    LEDS_ADDR_TIM->DIER = 0U;
+    LEDS_ADDR_TIM->CCR2 = 0U;
+    LEDS_ADDR_TIM->CNT = 0U;
+    LEDS_ADDR_TIM->EGR = TIM_EGR_UG;
+    LEDS_ADDR_TIM->SR = 0U;
+}
+
+/*
+ * À chaque mise à jour, CCR2 préchargé devient actif puis le DMA écrit la
+ * valeur suivante : l'écriture i démarre la période du bit i-1. À la fin du
+ * transfert, le registre actif porte la première période de queue (0), le
+ * dernier bit est donc entièrement sorti.
+ */
+static void leds_dma_cb(void *p, uint32_t flags) {
+    (void)p;
+    if ((flags & (STM32_DMA_ISR_TCIF | STM32_DMA_ISR_TEIF | STM32_DMA_ISR_DMEIF)) != 0U) {
+        dmaStreamDisable(leds_dma);
+        leds_tim_idle();
+        chSysLockFromISR();
+        if ((flags & (STM32_DMA_ISR_TEIF | STM32_DMA_ISR_DMEIF)) != 0U) {
+            leds_stats.dma_errors++;
+        }
+        leds_frame_end = chVTGetSystemTimeX();
+        chBSemSignalI(&leds_done_sem);
+        chSysUnlockFromISR();
+    }
+}
+
+static void leds_start_frame(void) {
+    dmaStreamSetMemory0(leds_dma, leds_buf);
+    dmaStreamSetTransactionSize(leds_dma, LEDS_BUF_LEN);
+    dmaStreamEnable(leds_dma);
+
+    /* UG avec UDE : première requête immédiate, la sortie reste basse une période. */
+    LEDS_ADDR_TIM->DIER = TIM_DIER_UDE;
+    LEDS_ADDR_TIM->EGR = TIM_EGR_UG;
+    LEDS_ADDR_TIM->CR1 |= TIM_CR1_CEN;
+    leds_busy = true;
+}
+
+/* Attend la fin de la trame en cours puis le temps de verrouillage. */
+static bool leds_wait_idle(void) {
+    if (leds_busy) {
+        chSysLock();
+        if (chBSemGetStateI(&leds_done_sem)) {
+            leds_stats.waits++;
+        }
+        chSysUnlock();
+        if (chBSemWaitTimeout(&leds_done_sem, TIME_MS2I(LEDS_ADDR_FRAME_TIMEOUT_MS)) != MSG_OK) {
+            /* Trame bloquée : transfert abandonné, tout sera réémis. */
+            dmaStreamDisable(leds_dma);
+            leds_tim_idle();
+            chBSemReset(&leds_done_sem, true);
+            leds_busy = false;
+            for (uint32_t i = 0U; i < LEDS_ADDR_COUNT; ++i) {
+                leds_sent[i] = LEDS_COLOR_NONE;
+            }
+            leds_dirty = true;
+            leds_frame_end = chVTGetSystemTimeX();
+            leds_stats.timeouts++;
+            return false;
+        }
+        leds_busy = false;
+    }
+
+    /* +1 tick : la date de fin est arrondie au tick inférieur. */
+    const sysinterval_t latch = TIME_US2I(LEDS_ADDR_LATCH_US) + 1U;
+    const sysinterval_t elapsed = chTimeDiffX(leds_frame_end, chVTGetSystemTimeX());
+    if (elapsed < latch) {
+        chThdSleep(latch - elapsed);
+    }
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Encodage                                                                   */
+/* -------------------------------------------------------------------------- */
+
+static inline uint32_t leds_grb(const uint8_t rgb[3]) {
+    return ((uint32_t)leds_lut[rgb[1]] << 16) |
+           ((uint32_t)leds_lut[rgb[0]] << 8) |
+           (uint32_t)leds_lut[rgb[2]];
+}
+
+static void leds_encode(uint8_t pos, uint32_t grb) {
+    uint16_t *dst = &leds_buf[(uint32_t)pos * LEDS_BITS_PER_LED];
+
+    for (int32_t shift = 20; shift >= 0; shift -= 4) {
+        memcpy(dst, leds_nibble[(grb >> (uint32_t)shift) & 0x0FU], sizeof(leds_nibble[0]));
+        dst += 4;
+    }
+}
+
+static void leds_build_lut(void) {
+    for (uint32_t v = 0U; v < 256U; ++v) {
+        leds_lut[v] = leds_gamma[((v * leds_brightness) + 127U) / 255U];
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void drv_leds_addr_init(void) {
+    if (leds_initialized) {
+        return;
+    }
+
+    chBSemObjectInit(&leds_done_sem, true);
+    memset(&leds_stats, 0, sizeof(leds_stats));
+    memset(leds_rgb, 0, sizeof(leds_rgb));
+    memset(leds_buf, 0, sizeof(leds_buf));
+    /* État réel des LEDs inconnu à la mise sous tension : première trame complète. */
+    for (uint32_t i = 0U; i < LEDS_ADDR_COUNT; ++i) {
+        leds_map[i] = (uint8_t)i;
+        leds_sent[i] = LEDS_COLOR_NONE;
+    }
+    leds_brightness = LEDS_ADDR_DEFAULT_BRIGHTNESS;
+    leds_build_lut();
+    leds_dirty = true;
+    leds_busy = false;
+    leds_frame_end = chVTGetSystemTimeX();
+
+    /* Le GPIO PC7 (AF3) est configuré via board.h. */
+    rccEnableTIM8(true);
+    rccResetTIM8();
+
+    LEDS_ADDR_TIM->CR1 = TIM_CR1_ARPE;
+    LEDS_ADDR_TIM->PSC = 0U;
+    LEDS_ADDR_TIM->ARR = LEDS_ARR;
+    LEDS_ADDR_TIM->CCMR1 = TIM_CCMR1_OC2M_2 | TIM_CCMR1_OC2M_1 | TIM_CCMR1_OC2PE;  /* PWM1. */
+    LEDS_ADDR_TIM->CCER = TIM_CCER_CC2E;
+    LEDS_ADDR_TIM->BDTR = TIM_BDTR_MOE;
+    leds_tim_idle();
+
+    leds_dma = dmaStreamAlloc(LEDS_ADDR_DMA_STREAM, LEDS_ADDR_DMA_IRQ_PRIORITY, leds_dma_cb, NULL);
+    osalDbgAssert(leds_dma != NULL, "LEDs DMA stream busy");
+    dmaSetRequestSource(leds_dma, LEDS_ADDR_DMA_REQUEST);
+
+    /* M2P, demi-mots vers CCR2, un transfert par trame. */
+    dmaStreamSetPeripheral(leds_dma, &LEDS_ADDR_TIM->CCR2);
+    dmaStreamSetMode(leds_dma, STM32_DMA_CR_PL(LEDS_ADDR_DMA_PRIORITY) |
+                               STM32_DMA_CR_DIR_M2P |
+                               STM32_DMA_CR_PSIZE_HWORD |
+                               STM32_DMA_CR_MSIZE_HWORD |
+                               STM32_DMA_CR_MINC |
+                               STM32_DMA_CR_TCIE |
+                               STM32_DMA_CR_TEIE);
+
+    leds_initialized = true;
+}
+
+void drv_leds_addr_set(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+    if (index >= LEDS_ADDR_COUNT) {
+        return;
+    }
+    uint8_t *c = leds_rgb[index];
+    if ((c[0] != r) || (c[1] != g) || (c[2] != b)) {
+        c[0] = r;
+        c[1] = g;
+        c[2] = b;
+        leds_dirty = true;
+    }
+}
+
+void drv_leds_addr_fill(uint8_t r, uint8_t g, uint8_t b) {
+    for (uint8_t i = 0U; i < LEDS_ADDR_COUNT; ++i) {
+        drv_leds_addr_set(i, r, g, b);
+    }
+}
+
+void drv_leds_addr_clear(void) {
+    drv_leds_addr_fill(0U, 0U, 0U);
+}
+
+void drv_leds_addr_set_brightness(uint8_t brightness) {
+    if (brightness == leds_brightness) {
+        return;
+    }
+    leds_brightness = brightness;
+    leds_build_lut();
+    /* Les couleurs encodées sont comparées après la table : seules les changées repartent. */
+    leds_dirty = true;
+}
+
+#if BRICK_WS2812_DYNAMIC_MAP
+bool drv_leds_addr_set_map(const uint8_t map[LEDS_ADDR_COUNT]) {
+    uint32_t seen[(LEDS_ADDR_COUNT + 31U) / 32U] = { 0U };
+
+    if (map == NULL) {
+        return false;
+    }
+    for (uint32_t i = 0U; i < LEDS_ADDR_COUNT; ++i) {
+        const uint8_t pos = map[i];
+        if ((pos >= LEDS_ADDR_COUNT) || ((seen[pos / 32U] & (1U << (pos % 32U))) != 0U)) {
+            return false;
+        }
+        seen[pos / 32U] |= 1U << (pos % 32U);
+    }
+    memcpy(leds_map, map, sizeof(leds_map));
+    leds_dirty = true;
+    return true;
+}
+#endif
+
+bool drv_leds_addr_render(void) {
+    if (!leds_initialized) {
+        return false;
+    }
+    if (!leds_dirty) {
+        leds_stats.skipped++;
+        return true;
+    }
+    if (!leds_wait_idle()) {
+        return false;
+    }
+
+    /* Le tampon n'est plus lu par le DMA : réencodage des seules positions changées. */
+    const rtcnt_t t0 = chSysGetRealtimeCounterX();
+    uint32_t encoded = 0U;
+    leds_dirty = false;
+    for (uint32_t i = 0U; i < LEDS_ADDR_COUNT; ++i) {
+        const uint8_t pos = leds_map[i];
+        const uint32_t grb = leds_grb(leds_rgb[i]);
+        if (grb != leds_sent[pos]) {
+            leds_sent[pos] = grb;
+            leds_encode(pos, grb);
+            encoded++;
+        }
+    }
+    const uint32_t us = leds_cycles_to_us(chSysGetRealtimeCounterX() - t0);
+
+    if (encoded == 0U) {
+        /* Changement absorbé par la table (ex. niveaux confondus après gamma). */
+        leds_stats.skipped++;
+        return true;
+    }
+    leds_start_frame();
+
+    chSysLock();
+    leds_stats.frames++;
+    leds_stats.encoded += encoded;
+    leds_stats.encode_us_last = us;
+    if (us > leds_stats.encode_us_max) {
+        leds_stats.encode_us_max = us;
+    }
+    chSysUnlock();
+    return true;
+}
+
+void drv_leds_addr_get_stats(drv_leds_addr_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = leds_stats;
+    chSysUnlock();
+}
@@ -0,0 +1,87 @@
+/**
+ * @file drv_leds_addr.h
+ * @brief LEDs adressables WS2812 sur TIM8_CH2 : PWM alimentée par DMA, réencodage incrémental.
+ * @details Chaque bit WS2812 est une période PWM de 1,25 µs (800 kHz) dont
+ * le rapport cyclique code 0 ou 1 : le DMA recopie, à chaque mise à jour du
+ * timer, une valeur de CCR2 depuis un tampon de bits en RAM D2 (non
+ * cacheable), 24 valeurs par LED (ordre G, R, B, bit de poids fort
+ * d'abord), suivies de deux périodes à 0. En fin de transfert, l'ISR
+ * arrête le timer (sortie basse) ; le verrouillage des LEDs (>= 280 µs
+ * bas) est garanti avant la trame suivante.
+ *
+ * Les couleurs demandées (RGB 8 bits, index logique) passent par une table
+ * unique luminosité puis gamma (256 octets, recalculée au changement de
+ * luminosité) ; seules les LEDs dont la couleur de sortie a changé depuis
+ * la trame précédente sont réencodées dans le tampon, par quartets
+ * (table de 16 × 4 valeurs de CCR). Sans changement, aucune trame n'est
+ * émise.
+ *
+ * drv_leds_addr_render attend la fin de la trame précédente sur sémaphore
+ * (pas d'attente active), réencode puis lance le DMA et rend la main : le
+ * CPU ne fait rien pendant les ~0,8 ms de transfert.
+ *
+ * TIM8 est piloté en registres : STM32_PWM_USE_TIM8 / STM32_GPT_USE_TIM8
+ * doivent rester à FALSE dans mcuconf.h. Non réentrant : thread d'UI seulement.
+ *
+ * @ingroup drivers
+ */
+
+#ifndef DRV_LEDS_ADDR_H
+#define DRV_LEDS_ADDR_H
+
+#include "ch.h"
+#include "hal.h"
+#include "brick_config.h"
+
+#define LEDS_ADDR_COUNT               BRICK_NUM_WS2812_LEDS
+#define LEDS_ADDR_LINE                LINE_TIM8_CH2_WS2812
+
+#define LEDS_ADDR_TIM                 TIM8
+#define LEDS_ADDR_TIM_CLOCK           STM32_TIMCLK2
+#define LEDS_ADDR_BIT_HZ              800000U
+#define LEDS_ADDR_T0H_NS              400U
+#define LEDS_ADDR_T1H_NS              800U
+#define LEDS_ADDR_LATCH_US            300U        /* WS2812B récentes : >= 280 µs. */
+
+#define LEDS_ADDR_DMA_STREAM          STM32_DMA_STREAM_ID(1, 6)
+#define LEDS_ADDR_DMA_REQUEST         STM32_DMAMUX1_TIM8_UP
+#define LEDS_ADDR_DMA_PRIORITY        1U
+#define LEDS_ADDR_DMA_IRQ_PRIORITY    12U
+
+#define LEDS_ADDR_DEFAULT_BRIGHTNESS  128U
+#define LEDS_ADDR_FRAME_TIMEOUT_MS    5U
+
+/* Tampon de bits lu par le DMA : RAM D2 non cacheable. */
+#define LEDS_ADDR_DMA_BUFFER_ATTR     __attribute__((section(".ram_d2"), aligned(32)))
+
+typedef struct {
+    uint32_t frames;              /* Trames émises. */
+    uint32_t skipped;             /* Rendus sans changement. */
+    uint32_t encoded;             /* LEDs réencodées (cumul). */
+    uint32_t waits;               /* Rendus ayant attendu la trame précédente. */
+    uint32_t timeouts;            /* Trame précédente jamais terminée. */
+    uint32_t dma_errors;
+    uint32_t encode_us_last;
+    uint32_t encode_us_max;
+} drv_leds_addr_stats_t;
+
+void drv_leds_addr_init(void);
+
+/* Couleur d'une LED (index logique, voir drv_leds_addr_set_map). */
+void drv_leds_addr_set(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
+void drv_leds_addr_fill(uint8_t r, uint8_t g, uint8_t b);
+void drv_leds_addr_clear(void);
+
+void drv_leds_addr_set_brightness(uint8_t brightness);
+
+#if BRICK_WS2812_DYNAMIC_MAP
+/* Correspondance index logique -> position sur la chaîne ; faux si ce n'est pas une permutation. */
+bool drv_leds_addr_set_map(const uint8_t map[LEDS_ADDR_COUNT]);
+#endif
+
+/* Émet les changements ; faux si la trame précédente ne s'est pas terminée. */
+bool drv_leds_addr_render(void);
+
+void drv_leds_addr_get_stats(drv_leds_addr_stats_t *st);
+
+#endif /* DRV_LEDS_ADDR_H */
@@ -0,0 +1,410 @@
+/**
+ * @file drv_midi.c
+ * @brief DIN MIDI sur USART3 : DMA circulaire + IDLE en réception, DMA en émission.
+ * @ingroup drivers
+ */
+
+#include "drv_midi.h"
+#include "drv_audio.h"
+#include <string.h>
+
+#if STM32_SERIAL_USE_USART3
+#error "drv_midi pilote USART3 directement : STM32_SERIAL_USE_USART3 doit être FALSE"
+#endif
+
+#define MIDI_USART      BRICK_MIDI_UART
+
+BRICK_STATIC_ASSERT((MIDI_RX_RING_SIZE & (MIDI_RX_RING_SIZE - 1U)) == 0U, midi_rx_ring_pow2);
+BRICK_STATIC_ASSERT((MIDI_TX_RING_SIZE & (MIDI_TX_RING_SIZE - 1U)) == 0U, midi_tx_ring_pow2);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+static volatile uint8_t MIDI_DMA_BUFFER_ATTR midi_rx_ring[MIDI_RX_RING_SIZE];
+static volatile uint8_t MIDI_DMA_BUFFER_ATTR midi_tx_ring[MIDI_TX_RING_SIZE];
+static volatile uint8_t MIDI_DMA_BUFFER_ATTR midi_tx_rt[MIDI_TX_RT_SIZE];
+
+static const stm32_dma_stream_t *midi_rx_dma = NULL;
+static const stm32_dma_stream_t *midi_tx_dma = NULL;
+
+/*
+ * Réception : octets écrits par le DMA depuis le démarrage (compteur libre)
+ * et date du dernier octet, relevés dans les ISR ; `rx_pos` est la dernière
+ * position relevée dans l'anneau. `rx_rd` compte les octets consommés.
+ */
+static volatile uint32_t midi_rx_total = 0U;
+static volatile uint32_t midi_rx_frame = 0U;
+static uint32_t midi_rx_pos = 0U;
+static uint32_t midi_rx_rd = 0U;
+static binary_semaphore_t midi_rx_sem;
+
+/* Émission : anneau [tail, head), `busy` octets en cours de DMA depuis tail. */
+static uint32_t midi_tx_head = 0U;
+static uint32_t midi_tx_tail = 0U;
+static uint32_t midi_tx_busy = 0U;
+/* Voie temps réel : `rt_len` octets en attente, dont `rt_busy` en cours de DMA. */
+static uint32_t midi_tx_rt_len = 0U;
+static uint32_t midi_tx_rt_busy = 0U;
+static midi_tx_state_t midi_tx_state;
+static systime_t midi_tx_last;
+
+static midi_parser_t midi_parser;
+static midi_msg_cb_t midi_msg_cb = NULL;
+static midi_sysex_cb_t midi_sysex_cb = NULL;
+static void *midi_cb_ctx = NULL;
+
+static drv_midi_stats_t midi_stats;
+static bool midi_initialized = false;
+
+static THD_WORKING_AREA(midiThreadWA, MIDI_THREAD_STACK_SIZE);
+
+/* -------------------------------------------------------------------------- */
+/* Réception                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Relève la position d'écriture du DMA et date la rafale. Sous verrou.
+ * Les interruptions demi-tampon et tampon plein garantissent un relevé au
+ * moins tous les MIDI_RX_RING_SIZE / 2 octets : l'avance depuis le relevé
+ * précédent, lue dans NDTR modulo l'anneau, est exacte et le compteur libre
+ * ne perd aucun tour, même si le thread ne lit plus.
+ */
+static void midi_rx_mark_i(void) {
+    const uint32_t pos = (MIDI_RX_RING_SIZE - (uint32_t)dmaStreamGetTransactionSize(midi_rx_dma)) &
+                         (MIDI_RX_RING_SIZE - 1U);
+    midi_rx_total += (pos - midi_rx_pos) & (MIDI_RX_RING_SIZE - 1U);
+    midi_rx_pos = pos;
+    midi_rx_frame = drv_audio_get_frame_timeI();
+    chBSemSignalI(&midi_rx_sem);
+}
+
+static void midi_rx_dma_cb(void *p, uint32_t flags) {
+    (void)p;
+    if ((flags & (STM32_DMA_ISR_TEIF | STM32_DMA_ISR_DMEIF)) != 0U) {
+        chSysHalt("MIDI DMA ERROR");
+    }
+    if ((flags & (STM32_DMA_ISR_HTIF | STM32_DMA_ISR_TCIF)) != 0U) {
+        chSysLockFromISR();
+        midi_rx_mark_i();
+        chSysUnlockFromISR();
+    }
+}
+
+OSAL_IRQ_HANDLER(MIDI_USART_IRQ_HANDLER) {
+    OSAL_IRQ_PROLOGUE();
+
+    const uint32_t isr = MIDI_USART->ISR;
+    MIDI_USART->ICR = isr & (USART_ICR_IDLECF | USART_ICR_ORECF |
+                             USART_ICR_FECF | USART_ICR_NECF | USART_ICR_PECF);
+
+    if ((isr & USART_ISR_ORE) != 0U) {
+        midi_stats.rx_overruns++;
+    }
+    if ((isr & (USART_ISR_FE | USART_ISR_NE)) != 0U) {
+        midi_stats.rx_framing++;
+    }
+    if ((isr & USART_ISR_IDLE) != 0U) {
+        chSysLockFromISR();
+        midi_rx_mark_i();
+        chSysUnlockFromISR();
+    }
+
+    OSAL_IRQ_EPILOGUE();
+}
+
+static void midi_parser_msg_cb(void *ctx, const midi_msg_t *msg) {
+    (void)ctx;
+    if (midi_msg_cb != NULL) {
+        midi_msg_cb(midi_cb_ctx, msg);
+    }
+}
+
+static void midi_parser_sysex_cb(void *ctx, const uint8_t *data, size_t len,
+                                 uint8_t flags, uint32_t frame) {
+    (void)ctx;
+    if (midi_sysex_cb != NULL) {
+        midi_sysex_cb(midi_cb_ctx, data, len, flags, frame);
+    }
+}
+
+static THD_FUNCTION(midiThread, arg) {
+    (void)arg;
+    chRegSetThreadName("midiRx");
+
+    while (true) {
+        chBSemWait(&midi_rx_sem);
+
+        chSysLock();
+        const uint32_t written = midi_rx_total;
+        const uint32_t frame = midi_rx_frame;
+        chSysUnlock();
+
+        const uint32_t total = written - midi_rx_rd;
+        if (total == 0U) {
+            continue;
+        }
+        if (total >= MIDI_RX_RING_SIZE) {
+            /*
+             * Tour d'anneau : l'octet suivant à lire est (ou va être) réécrit
+             * et le flux est coupé en un point inconnu. Tout l'arriéré est
+             * abandonné, l'analyseur oublie son running status.
+             */
+            midi_rx_rd = written;
+            midi_parser_reset(&midi_parser);
+            chSysLock();
+            midi_stats.rx_overruns++;
+            midi_stats.rx_lost += total;
+            chSysUnlock();
+            continue;
+        }
+
+        /* Anneau non cacheable : lecture directe. Au plus deux segments. */
+        const uint8_t *ring = (const uint8_t *)midi_rx_ring;
+        const uint32_t rd = midi_rx_rd & (MIDI_RX_RING_SIZE - 1U);
+        const uint32_t wr = written & (MIDI_RX_RING_SIZE - 1U);
+        if (wr > rd) {
+            midi_parser_feed(&midi_parser, &ring[rd], total, frame, MIDI_PARSER_BYTE_FRAMES_Q8);
+        } else {
+            const uint32_t first = MIDI_RX_RING_SIZE - rd;
+            const uint32_t back = (uint32_t)((wr * MIDI_PARSER_BYTE_FRAMES_Q8) >> 8);
+            midi_parser_feed(&midi_parser, &ring[rd], first, frame - back,
+                             MIDI_PARSER_BYTE_FRAMES_Q8);
+            midi_parser_feed(&midi_parser, ring, wr, frame, MIDI_PARSER_BYTE_FRAMES_Q8);
+        }
+        midi_rx_rd = written;
+
+        chSysLock();
+        midi_stats.rx_bytes += total;
+        midi_stats.rx_bursts++;
+        chSysUnlock();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Émission                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/* Lance le DMA : octets temps réel d'abord, sinon segment suivant de l'anneau. Sous verrou. */
+static void midi_tx_kick_i(void) {
+    if ((midi_tx_busy != 0U) || (midi_tx_rt_busy != 0U)) {
+        return;
+    }
+    if (midi_tx_rt_len != 0U) {
+        midi_tx_rt_busy = midi_tx_rt_len;
+        dmaStreamSetMemory0(midi_tx_dma, (void *)midi_tx_rt);
+        dmaStreamSetTransactionSize(midi_tx_dma, midi_tx_rt_len);
+        dmaStreamEnable(midi_tx_dma);
+        return;
+    }
+    if (midi_tx_head == midi_tx_tail) {
+        return;
+    }
+    uint32_t len = (midi_tx_head > midi_tx_tail) ? (midi_tx_head - midi_tx_tail)
+                                                 : (MIDI_TX_RING_SIZE - midi_tx_tail);
+    if (len > MIDI_TX_DMA_CHUNK) {
+        len = MIDI_TX_DMA_CHUNK;
+    }
+    midi_tx_busy = len;
+    dmaStreamSetMemory0(midi_tx_dma, (void *)&midi_tx_ring[midi_tx_tail]);
+    dmaStreamSetTransactionSize(midi_tx_dma, len);
+    dmaStreamEnable(midi_tx_dma);
+}
+
+static void midi_tx_dma_cb(void *p, uint32_t flags) {
+    (void)p;
+    if ((flags & (STM32_DMA_ISR_TEIF | STM32_DMA_ISR_DMEIF)) != 0U) {
+        chSysHalt("MIDI DMA ERROR");
+    }
+    if ((flags & STM32_DMA_ISR_TCIF) != 0U) {
+        chSysLockFromISR();
+        dmaStreamDisable(midi_tx_dma);
+        if (midi_tx_rt_busy != 0U) {
+            /* Octets temps réel arrivés pendant le transfert : ramenés en tête. */
+            const uint32_t rest = midi_tx_rt_len - midi_tx_rt_busy;
+            for (uint32_t i = 0U; i < rest; ++i) {
+                midi_tx_rt[i] = midi_tx_rt[midi_tx_rt_busy + i];
+            }
+            midi_stats.tx_bytes += midi_tx_rt_busy;
+            midi_tx_rt_len = rest;
+            midi_tx_rt_busy = 0U;
+        } else {
+            midi_stats.tx_bytes += midi_tx_busy;
+            midi_tx_tail = (midi_tx_tail + midi_tx_busy) & (MIDI_TX_RING_SIZE - 1U);
+            midi_tx_busy = 0U;
+        }
+        midi_tx_kick_i();
+        chSysUnlockFromISR();
+    }
+}
+
+static inline uint32_t midi_tx_free_s(void) {
+    return (MIDI_TX_RING_SIZE - 1U) - ((midi_tx_head - midi_tx_tail) & (MIDI_TX_RING_SIZE - 1U));
+}
+
+static void midi_tx_put_s(const uint8_t *data, size_t len) {
+    for (size_t i = 0U; i < len; ++i) {
+        midi_tx_ring[midi_tx_head] = data[i];
+        midi_tx_head = (midi_tx_head + 1U) & (MIDI_TX_RING_SIZE - 1U);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void drv_midi_init(void) {
+    if (midi_initialized) {
+        return;
+    }
+
+    chBSemObjectInit(&midi_rx_sem, true);
+    memset(&midi_stats, 0, sizeof(midi_stats));
+    midi_parser_init(&midi_parser, MIDI_PORT_DIN, midi_parser_msg_cb, midi_parser_sysex_cb, NULL);
+    midi_tx_reset(&midi_tx_state);
+    midi_tx_last = chVTGetSystemTimeX();
+
+    /* Les GPIO TX/RX USART3 sont configurés via board.h. */
+    rccEnableUSART3(true);
+    rccResetUSART3();
+
+    MIDI_USART->CR1 = 0U;
+    MIDI_USART->BRR = (uint32_t)((MIDI_USART_CLOCK + (MIDI_BAUDRATE / 2U)) / MIDI_BAUDRATE);
+    MIDI_USART->CR2 = 0U;
+    MIDI_USART->CR3 = USART_CR3_DMAR | USART_CR3_DMAT | USART_CR3_EIE;
+    MIDI_USART->ICR = 0xFFFFFFFFU;
+
+    midi_rx_dma = dmaStreamAlloc(MIDI_RX_DMA_STREAM, MIDI_DMA_IRQ_PRIORITY, midi_rx_dma_cb, NULL);
+    midi_tx_dma = dmaStreamAlloc(MIDI_TX_DMA_STREAM, MIDI_DMA_IRQ_PRIORITY, midi_tx_dma_cb, NULL);
+    osalDbgAssert((midi_rx_dma != NULL) && (midi_tx_dma != NULL), "MIDI DMA streams busy");
+
+    dmaSetRequestSource(midi_rx_dma, MIDI_RX_DMA_REQUEST);
+    dmaSetRequestSource(midi_tx_dma, MIDI_TX_DMA_REQUEST);
+
+    /* RX : P2M, octets, circulaire, half/full interrupt. */
+    dmaStreamSetPeripheral(midi_rx_dma, &MIDI_USART->RDR);
+    dmaStreamSetMemory0(midi_rx_dma, (void *)midi_rx_ring);
+    dmaStreamSetTransactionSize(midi_rx_dma, MIDI_RX_RING_SIZE);
+    dmaStreamSetMode(midi_rx_dma, STM32_DMA_CR_PL(MIDI_DMA_PRIORITY) |
+                                  STM32_DMA_CR_DIR_P2M |
+                                  STM32_DMA_CR_PSIZE_BYTE |
+                                  STM32_DMA_CR_MSIZE_BYTE |
+                                  STM32_DMA_CR_MINC |
+                                  STM32_DMA_CR_CIRC |
+                                  STM32_DMA_CR_HTIE |
+                                  STM32_DMA_CR_TCIE |
+                                  STM32_DMA_CR_TEIE);
+
+    /* TX : M2P, octets, un segment contigu par transfert. */
+    dmaStreamSetPeripheral(midi_tx_dma, &MIDI_USART->TDR);
+    dmaStreamSetMode(midi_tx_dma, STM32_DMA_CR_PL(MIDI_DMA_PRIORITY) |
+                                  STM32_DMA_CR_DIR_M2P |
+                                  STM32_DMA_CR_PSIZE_BYTE |
+                                  STM32_DMA_CR_MSIZE_BYTE |
+                                  STM32_DMA_CR_MINC |
+                                  STM32_DMA_CR_TCIE |
+                                  STM32_DMA_CR_TEIE);
+
+    midi_initialized = true;
+}
+
+void drv_midi_start(void) {
+    if (!midi_initialized) {
+        drv_midi_init();
+    }
+
+    midi_rx_rd = 0U;
+    midi_rx_total = 0U;
+    midi_rx_pos = 0U;
+    dmaStreamEnable(midi_rx_dma);
+
+    nvicEnableVector(MIDI_USART_IRQ_NUMBER, MIDI_USART_IRQ_PRIORITY);
+    MIDI_USART->CR1 = USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE | USART_CR1_UE;
+
+    chThdCreateStatic(midiThreadWA, sizeof(midiThreadWA),
+                      MIDI_THREAD_PRIORITY, midiThread, NULL);
+}
+
+void drv_midi_set_rx_cb(midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx) {
+    chSysLock();
+    midi_msg_cb = msg_cb;
+    midi_sysex_cb = sysex_cb;
+    midi_cb_ctx = ctx;
+    chSysUnlock();
+}
+
+bool drv_midi_send(const midi_msg_t *msg) {
+    uint8_t buf[3];
+    bool ok = false;
+
+    chSysLock();
+    if (midi_is_realtime(msg->status)) {
+        if (midi_tx_rt_len < MIDI_TX_RT_SIZE) {
+            midi_tx_rt[midi_tx_rt_len++] = msg->status;
+            midi_stats.tx_realtime++;
+            midi_tx_kick_i();
+            ok = true;
+        } else {
+            midi_stats.tx_dropped++;
+        }
+        chSysUnlock();
+        return ok;
+    }
+    if (chVTTimeElapsedSinceX(midi_tx_last) > TIME_MS2I(MIDI_TX_RUNNING_REFRESH_MS)) {
+        midi_tx_reset(&midi_tx_state);
+    }
+    const midi_tx_state_t saved = midi_tx_state;
+    const size_t n = midi_tx_encode(&midi_tx_state, msg, buf);
+    if (n <= midi_tx_free_s()) {
+        midi_tx_put_s(buf, n);
+        midi_tx_last = chVTGetSystemTimeX();
+        if (n < (size_t)(1U + midi_data_length(msg->status))) {
+            midi_stats.tx_saved++;
+        }
+        midi_tx_kick_i();
+        ok = true;
+    } else {
+        midi_tx_state = saved;
+        midi_stats.tx_dropped++;
+    }
+    chSysUnlock();
+    return ok;
+}
+
+bool drv_midi_send_sysex(const uint8_t *data, size_t len) {
+    bool ok = false;
+
+    if ((data == NULL) || (len == 0U) || (len >= MIDI_TX_RING_SIZE)) {
+        return false;
+    }
+
+    chSysLock();
+    if (len <= midi_tx_free_s()) {
+        midi_tx_put_s(data, len);
+        midi_tx_reset(&midi_tx_state);
+        midi_tx_last = chVTGetSystemTimeX();
+        midi_tx_kick_i();
+        ok = true;
+    } else {
+        midi_stats.tx_dropped++;
+    }
+    chSysUnlock();
+    return ok;
+}
+
+size_t drv_midi_tx_backlog(void) {
+    chSysLock();
+    const uint32_t n = (midi_tx_head - midi_tx_tail) & (MIDI_TX_RING_SIZE - 1U);
+    chSysUnlock();
+    return n;
+}
+
+void drv_midi_get_stats(drv_midi_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = midi_stats;
+    st->parser = midi_parser.stats;
+    chSysUnlock();
+}
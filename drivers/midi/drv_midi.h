@@ -0,0 +1,102 @@
+/**
+ * @file drv_midi.h
+ * @brief Driver DIN MIDI (USART3) : réception et émission par DMA.
+ * @details Réception : DMA circulaire sur un anneau en .ram_d2, réveil du
+ * thread MIDI sur demi-tampon, tampon plein et ligne inactive (IDLE). Chaque
+ * rafale est datée dans l'ISR sur l'horloge audio puis analysée par
+ * midi_parser (running status, temps réel intercalé, SysEx en fragments).
+ * Les ISR tiennent le compte des octets écrits par le DMA ; si le thread
+ * prend un tour de retard, l'arriéré est abandonné, l'analyseur remis à
+ * zéro (running status oublié) et le dépassement compté dans rx_overruns.
+ *
+ * Émission : les messages sont sérialisés avec running status dans un anneau
+ * vidé par DMA. Le running status est oublié après un SysEx et après
+ * MIDI_TX_RUNNING_REFRESH_MS d'inactivité, pour resynchroniser un récepteur
+ * branché à chaud. Les octets temps réel (horloge, start/stop) ne passent
+ * pas par l'anneau : ils partent au transfert DMA suivant, et les transferts
+ * de l'anneau sont limités à MIDI_TX_DMA_CHUNK octets, ce qui borne leur
+ * attente (~1,3 ms) quel que soit l'arriéré.
+ *
+ * L'USART est piloté en registres : STM32_SERIAL_USE_USART3 doit rester à
+ * FALSE dans mcuconf.h (le vecteur USART3 est défini ici).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef DRV_MIDI_H
+#define DRV_MIDI_H
+
+#include "ch.h"
+#include "hal.h"
+#include "brick_config.h"
+#include "midi_parser.h"
+
+/* -------------------------------------------------------------------------- */
+/* Configuration                                                              */
+/* -------------------------------------------------------------------------- */
+
+#define MIDI_BAUDRATE                 31250U
+
+#define MIDI_USART_CLOCK              STM32_USART3CLK
+#define MIDI_USART_IRQ_HANDLER        STM32_USART3_HANDLER
+#define MIDI_USART_IRQ_NUMBER         STM32_USART3_NUMBER
+#define MIDI_USART_IRQ_PRIORITY       STM32_IRQ_USART3_PRIORITY
+
+#define MIDI_RX_DMA_STREAM            STM32_DMA_STREAM_ID(1, 2)
+#define MIDI_TX_DMA_STREAM            STM32_DMA_STREAM_ID(1, 3)
+#define MIDI_RX_DMA_REQUEST           STM32_DMAMUX1_USART3_RX
+#define MIDI_TX_DMA_REQUEST           STM32_DMAMUX1_USART3_TX
+#define MIDI_DMA_PRIORITY             1U
+#define MIDI_DMA_IRQ_PRIORITY         12U
+
+/** Anneaux DMA (puissances de 2). */
+#define MIDI_RX_RING_SIZE             256U
+#define MIDI_TX_RING_SIZE             512U
+#define MIDI_TX_RT_SIZE               8U
+#define MIDI_TX_DMA_CHUNK             4U
+
+#define MIDI_TX_RUNNING_REFRESH_MS    300U
+
+#define MIDI_THREAD_STACK_SIZE        1024U
+#define MIDI_THREAD_PRIORITY          (NORMALPRIO + 8)
+
+/* Même contrainte que l'audio : anneaux DMA en RAM D2 non cacheable. */
+#define MIDI_DMA_BUFFER_ATTR          __attribute__((section(".ram_d2"), aligned(32)))
+
+typedef struct {
+    uint32_t            rx_bytes;
+    uint32_t            rx_bursts;
+    uint32_t            rx_overruns;      /* ORE matériel ou anneau dépassé. */
+    uint32_t            rx_lost;          /* Octets abandonnés sur dépassement d'anneau. */
+    uint32_t            rx_framing;       /* Erreurs de trame / bruit. */
+    uint32_t            tx_bytes;
+    uint32_t            tx_saved;         /* Octets de statut économisés (running status). */
+    uint32_t            tx_realtime;      /* Octets temps réel passés hors anneau. */
+    uint32_t            tx_dropped;       /* Anneau d'émission plein. */
+    midi_parser_stats_t parser;
+} drv_midi_stats_t;
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void drv_midi_init(void);
+void drv_midi_start(void);
+
+/* Callbacks appelés depuis le thread MIDI. */
+void drv_midi_set_rx_cb(midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx);
+
+/*
+ * Retournent false si l'anneau d'émission est plein (rien n'est écrit).
+ * Un message temps réel emprunte la voie prioritaire. drv_midi_send_sysex
+ * émet les octets tels quels : un SysEx peut être envoyé par fragments.
+ */
+bool drv_midi_send(const midi_msg_t *msg);
+bool drv_midi_send_sysex(const uint8_t *data, size_t len);
+
+/* Octets en attente dans l'anneau d'émission (hors voie temps réel). */
+size_t drv_midi_tx_backlog(void);
+
+void drv_midi_get_stats(drv_midi_stats_t *st);
+
+#endif /* DRV_MIDI_H */
@@ -0,0 +1,151 @@
+/**
+ * @file midi_clock_pll.c
+ * @brief Boucle à verrouillage de phase sur l'horloge MIDI entrante.
+ * @ingroup drivers
+ */
+
+#include "midi_clock_pll.h"
+#include <string.h>
+
+#define PLL_PPQN    24U
+
+static uint32_t pll_period_for_bpm(uint32_t sample_rate, uint32_t bpm) {
+    return (uint32_t)((((uint64_t)sample_rate * 60U) << 16) / ((uint64_t)bpm * PLL_PPQN));
+}
+
+/* Recale l'origine sur la partie entière de la prédiction : next_q16 reste petit. */
+static void pll_rebase(midi_clock_pll_t *pll) {
+    const int64_t whole = pll->next_q16 >> 16;
+    pll->origin += (uint32_t)whole;
+    pll->next_q16 -= whole << 16;
+}
+
+static void pll_first(midi_clock_pll_t *pll, uint32_t frame) {
+    pll->state = (uint8_t)MIDI_CLOCK_PLL_FIRST;
+    pll->last_frame = frame;
+    pll->outlier_run = 0U;
+}
+
+void midi_clock_pll_init(midi_clock_pll_t *pll, uint32_t sample_rate) {
+    memset(pll, 0, sizeof(*pll));
+    pll->min_period_q16 = pll_period_for_bpm(sample_rate, MIDI_CLOCK_PLL_MAX_BPM);
+    pll->max_period_q16 = pll_period_for_bpm(sample_rate, MIDI_CLOCK_PLL_MIN_BPM);
+}
+
+void midi_clock_pll_reset(midi_clock_pll_t *pll) {
+    pll->state = (uint8_t)MIDI_CLOCK_PLL_IDLE;
+    pll->outlier_run = 0U;
+    pll->acq_count = 0U;
+    pll->next_q16 = 0;
+    pll->period_q16 = 0U;
+}
+
+void midi_clock_pll_tick(midi_clock_pll_t *pll, uint32_t frame) {
+    switch ((midi_clock_pll_state_t)pll->state) {
+    case MIDI_CLOCK_PLL_IDLE:
+        pll_first(pll, frame);
+        pll->index++;
+        pll->stats.ticks++;
+        return;
+
+    case MIDI_CLOCK_PLL_FIRST: {
+        const uint32_t interval = frame - pll->last_frame;
+        pll->index++;
+        pll->stats.ticks++;
+        if ((interval >= (pll->min_period_q16 >> 16)) &&
+            (interval <= (pll->max_period_q16 >> 16))) {
+            pll->period_q16 = interval << 16;
+            pll->origin = frame;
+            pll->next_q16 = (int64_t)pll->period_q16;
+            pll->acq_count = 0U;
+            pll->state = (uint8_t)MIDI_CLOCK_PLL_ACQUIRE;
+        } else {
+            pll_first(pll, frame);
+        }
+        return;
+    }
+
+    case MIDI_CLOCK_PLL_ACQUIRE:
+    case MIDI_CLOCK_PLL_LOCKED:
+    default:
+        break;
+    }
+
+    const int64_t period = (int64_t)pll->period_q16;
+    const int64_t half = period / 2;
+    const int64_t meas = (int64_t)(int32_t)(frame - pll->origin) * 65536;
+    int64_t err = meas - pll->next_q16;
+
+    /* Retard d'environ k périodes : k impulsions perdues, la phase suit. */
+    if (err > half) {
+        const int64_t k = (err + half) / period;
+        if (k <= (int64_t)MIDI_CLOCK_PLL_MAX_MISSED) {
+            pll->next_q16 += k * period;
+            pll->index += (uint32_t)k;
+            pll->stats.missed += (uint32_t)k;
+            err = meas - pll->next_q16;
+        }
+    }
+
+    if ((err > half) || (err < -half)) {
+        pll->stats.outliers++;
+        if (++pll->outlier_run >= MIDI_CLOCK_PLL_RELOCK_OUTLIERS) {
+            pll->stats.relocks++;
+            pll_first(pll, frame);
+            pll->index++;
+            pll->stats.ticks++;
+        }
+        return;
+    }
+    pll->outlier_run = 0U;
+
+    const uint32_t abs_err = (uint32_t)((err < 0) ? -err : err);
+
+    /* Écart d'un quart de période verrouillé : changement de tempo, gains larges. */
+    if ((pll->state == (uint8_t)MIDI_CLOCK_PLL_LOCKED) && (abs_err > (pll->period_q16 / 4U))) {
+        pll->state = (uint8_t)MIDI_CLOCK_PLL_ACQUIRE;
+        pll->acq_count = 0U;
+    }
+
+    const bool locked = pll->state == (uint8_t)MIDI_CLOCK_PLL_LOCKED;
+    const int64_t b = locked ? MIDI_CLOCK_PLL_TRACK_B_Q16 : MIDI_CLOCK_PLL_ACQ_B_Q16;
+    const int64_t c = locked ? MIDI_CLOCK_PLL_TRACK_C_Q16 : MIDI_CLOCK_PLL_ACQ_C_Q16;
+
+    pll->next_q16 += period + ((b * err) / 65536);
+    int64_t p = period + ((c * err) / 65536);
+    if (p < (int64_t)pll->min_period_q16) {
+        p = (int64_t)pll->min_period_q16;
+    }
+    if (p > (int64_t)pll->max_period_q16) {
+        p = (int64_t)pll->max_period_q16;
+    }
+    pll->period_q16 = (uint32_t)p;
+    pll->index++;
+    pll->stats.ticks++;
+    pll_rebase(pll);
+
+    if (locked) {
+        if (abs_err > pll->stats.jitter_max_q16) {
+            pll->stats.jitter_max_q16 = abs_err;
+        }
+        pll->stats.jitter_avg_q16 = (uint32_t)((int32_t)pll->stats.jitter_avg_q16 +
+                                    (((int32_t)abs_err - (int32_t)pll->stats.jitter_avg_q16) / 16));
+    } else if (++pll->acq_count >= MIDI_CLOCK_PLL_ACQ_TICKS) {
+        pll->state = (uint8_t)MIDI_CLOCK_PLL_LOCKED;
+    }
+}
+
+int64_t midi_clock_pll_time_q16(const midi_clock_pll_t *pll, uint32_t index, uint32_t ref_frame) {
+    const int64_t base = (int64_t)(int32_t)(pll->origin - ref_frame) * 65536;
+    const int64_t ahead = (int64_t)(int32_t)(index - pll->index) * (int64_t)pll->period_q16;
+    return base + pll->next_q16 + ahead;
+}
+
+uint16_t midi_clock_pll_bpm_x10(const midi_clock_pll_t *pll, uint32_t sample_rate) {
+    if (!midi_clock_pll_has_period(pll) || (pll->period_q16 == 0U)) {
+        return 0U;
+    }
+    const uint64_t num = ((uint64_t)sample_rate * 60U * 10U) << 16;
+    const uint64_t den = (uint64_t)pll->period_q16 * PLL_PPQN;
+    return (uint16_t)((num + (den / 2U)) / den);
+}
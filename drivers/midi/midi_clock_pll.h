@@ -0,0 +1,98 @@
+/**
+ * @file midi_clock_pll.h
+ * @brief Suivi d'une horloge MIDI entrante (24 ppqn) par boucle à verrouillage de phase.
+ * @details Boucle du second ordre (DLL) en virgule fixe : à chaque impulsion
+ * datée, l'écart à la prédiction corrige la phase (gain B) et la période
+ * (gain C). Deux jeux de gains : large à l'accrochage, étroit une fois
+ * verrouillé, ce qui lisse la gigue d'un émetteur ou d'un transport USB
+ * tout en suivant les changements de tempo : un écart d'un quart de période
+ * une fois verrouillé repasse en accrochage.
+ *
+ * Une impulsion en retard d'environ k périodes est comptée comme k - 1
+ * impulsions perdues ; un écart supérieur à une demi-période est rejeté, et
+ * MIDI_CLOCK_PLL_RELOCK_OUTLIERS rejets consécutifs relancent l'accrochage
+ * (saut de tempo, changement de source).
+ *
+ * Les instants sont en frames de l'horloge audio, les périodes et écarts en
+ * frames Q16. Module sans dépendance à ChibiOS : un flux d'horloge enregistré
+ * se rejoue tel quel dans un outil hôte.
+ *
+ * @ingroup drivers
+ */
+
+#ifndef MIDI_CLOCK_PLL_H
+#define MIDI_CLOCK_PLL_H
+
+#include "midi_msg.h"
+
+/** Tempos acceptés à l'accrochage. */
+#define MIDI_CLOCK_PLL_MIN_BPM          20U
+#define MIDI_CLOCK_PLL_MAX_BPM          400U
+
+/** Gains Q16 : accrochage (w = 0,25) puis poursuite (w = 0,05), B = w·√2, C = w². */
+#define MIDI_CLOCK_PLL_ACQ_B_Q16        23170
+#define MIDI_CLOCK_PLL_ACQ_C_Q16        4096
+#define MIDI_CLOCK_PLL_TRACK_B_Q16      4634
+#define MIDI_CLOCK_PLL_TRACK_C_Q16      164
+
+/** Impulsions d'accrochage avant verrouillage (une noire). */
+#define MIDI_CLOCK_PLL_ACQ_TICKS        24U
+#define MIDI_CLOCK_PLL_MAX_MISSED       4U
+#define MIDI_CLOCK_PLL_RELOCK_OUTLIERS  3U
+
+typedef enum {
+    MIDI_CLOCK_PLL_IDLE = 0,
+    MIDI_CLOCK_PLL_FIRST,          /* Une impulsion reçue, période inconnue. */
+    MIDI_CLOCK_PLL_ACQUIRE,
+    MIDI_CLOCK_PLL_LOCKED
+} midi_clock_pll_state_t;
+
+typedef struct {
+    uint32_t ticks;                /* Impulsions acceptées. */
+    uint32_t missed;               /* Impulsions perdues comblées. */
+    uint32_t outliers;             /* Impulsions rejetées. */
+    uint32_t relocks;
+    uint32_t jitter_avg_q16;       /* Moyenne glissante de |écart| verrouillé (frames Q16). */
+    uint32_t jitter_max_q16;       /* Pire |écart| verrouillé (frames Q16). */
+} midi_clock_pll_stats_t;
+
+typedef struct {
+    uint8_t                state;
+    uint8_t                outlier_run;
+    uint16_t               acq_count;
+    uint32_t               min_period_q16;
+    uint32_t               max_period_q16;
+    uint32_t               origin;        /* Base (frames) de next_q16. */
+    int64_t                next_q16;      /* Prochaine impulsion prédite, relative à origin. */
+    uint32_t               period_q16;
+    uint32_t               index;         /* Index de la prochaine impulsion attendue. */
+    uint32_t               last_frame;
+    midi_clock_pll_stats_t stats;
+} midi_clock_pll_t;
+
+void midi_clock_pll_init(midi_clock_pll_t *pll, uint32_t sample_rate);
+
+/* Oublie la phase et la période (les statistiques sont conservées). */
+void midi_clock_pll_reset(midi_clock_pll_t *pll);
+
+/* Impulsion 0xF8 reçue à l'horodatage `frame`. */
+void midi_clock_pll_tick(midi_clock_pll_t *pll, uint32_t frame);
+
+static inline bool midi_clock_pll_has_period(const midi_clock_pll_t *pll) {
+    return pll->state >= (uint8_t)MIDI_CLOCK_PLL_ACQUIRE;
+}
+
+static inline bool midi_clock_pll_locked(const midi_clock_pll_t *pll) {
+    return pll->state == (uint8_t)MIDI_CLOCK_PLL_LOCKED;
+}
+
+/*
+ * Instant prédit de l'impulsion `index`, en frames Q16 relatives à
+ * `ref_frame` (négatif = passé). Valide si midi_clock_pll_has_period().
+ */
+int64_t midi_clock_pll_time_q16(const midi_clock_pll_t *pll, uint32_t index, uint32_t ref_frame);
+
+/* Tempo lissé en dixièmes de BPM (0 sans période). */
+uint16_t midi_clock_pll_bpm_x10(const midi_clock_pll_t *pll, uint32_t sample_rate);
+
+#endif /* MIDI_CLOCK_PLL_H */
@@ -0,0 +1,79 @@
+/**
+ * @file midi_msg.h
+ * @brief Message MIDI court horodaté, commun aux transports (DIN, USB) et au routeur.
+ * @details Indépendant de ChibiOS : utilisable tel quel dans un outil hôte.
+ * @ingroup drivers
+ */
+
+#ifndef MIDI_MSG_H
+#define MIDI_MSG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Statuts utiles. */
+#define MIDI_NOTE_OFF           0x80U
+#define MIDI_NOTE_ON            0x90U
+#define MIDI_POLY_PRESSURE      0xA0U
+#define MIDI_CONTROL_CHANGE     0xB0U
+#define MIDI_PROGRAM_CHANGE     0xC0U
+#define MIDI_CHANNEL_PRESSURE   0xD0U
+#define MIDI_PITCH_BEND         0xE0U
+#define MIDI_SYSEX_START        0xF0U
+#define MIDI_MTC_QUARTER        0xF1U
+#define MIDI_SONG_POSITION      0xF2U
+#define MIDI_SONG_SELECT        0xF3U
+#define MIDI_TUNE_REQUEST       0xF6U
+#define MIDI_SYSEX_END          0xF7U
+#define MIDI_CLOCK              0xF8U
+#define MIDI_START              0xFAU
+#define MIDI_CONTINUE           0xFBU
+#define MIDI_STOP               0xFCU
+#define MIDI_ACTIVE_SENSING     0xFEU
+#define MIDI_RESET              0xFFU
+
+/* Origine d'un message (routeur). */
+#define MIDI_PORT_DIN           0U
+#define MIDI_PORT_USB           1U
+#define MIDI_PORT_INTERNAL      2U
+#define MIDI_NUM_PORTS          3U
+
+typedef struct {
+    uint32_t frame;       /* Horodatage, horloge audio (drv_audio_get_frame_time). */
+    uint8_t  status;
+    uint8_t  data[2];
+    uint8_t  port;        /* MIDI_PORT_*. */
+} midi_msg_t;
+
+/** Flags de fragment SysEx. */
+#define MIDI_SYSEX_FLAG_START   0x01U
+#define MIDI_SYSEX_FLAG_END     0x02U
+#define MIDI_SYSEX_FLAG_ABORT   0x04U   /* Interrompu par un statut non temps réel. */
+
+static inline bool midi_is_realtime(uint8_t status) {
+    return status >= 0xF8U;
+}
+
+static inline bool midi_is_channel(uint8_t status) {
+    return (status >= 0x80U) && (status < 0xF0U);
+}
+
+/* Octets de données attendus après un statut (SysEx : 0, flux à part). */
+static inline uint8_t midi_data_length(uint8_t status) {
+    if (status < 0xF0U) {
+        const uint8_t kind = status & 0xF0U;
+        return ((kind == MIDI_PROGRAM_CHANGE) || (kind == MIDI_CHANNEL_PRESSURE)) ? 1U : 2U;
+    }
+    switch (status) {
+    case MIDI_MTC_QUARTER:
+    case MIDI_SONG_SELECT:
+        return 1U;
+    case MIDI_SONG_POSITION:
+        return 2U;
+    default:
+        return 0U;
+    }
+}
+
+#endif /* MIDI_MSG_H */
@@ -0,0 +1,177 @@
+/**
+ * @file midi_parser.c
+ * @brief Machine à états de l'analyseur MIDI et encodeur running status.
+ * @ingroup drivers
+ */
+
+#include "midi_parser.h"
+#include <string.h>
+
+static void sysex_flush(midi_parser_t *p, uint8_t flags, uint32_t frame) {
+    if (p->sysex_first) {
+        flags |= MIDI_SYSEX_FLAG_START;
+    }
+    if ((p->sysex_cb != NULL) && ((p->sysex_len > 0U) || (flags != 0U))) {
+        p->sysex_cb(p->ctx, p->sysex_buf, p->sysex_len, flags, frame);
+    }
+    p->sysex_first = false;
+    p->sysex_len = 0U;
+}
+
+static void sysex_close(midi_parser_t *p, uint8_t flags, uint32_t frame) {
+    sysex_flush(p, flags, frame);
+    p->in_sysex = false;
+}
+
+static void emit(midi_parser_t *p, uint8_t status, uint32_t frame) {
+    midi_msg_t msg;
+    msg.frame = frame;
+    msg.status = status;
+    msg.data[0] = p->data[0];
+    msg.data[1] = p->data[1];
+    msg.port = p->port;
+    p->stats.messages++;
+    if (p->msg_cb != NULL) {
+        p->msg_cb(p->ctx, &msg);
+    }
+}
+
+static void parse_byte(midi_parser_t *p, uint8_t b, uint32_t frame) {
+    if (midi_is_realtime(b)) {
+        /* Intercalé n'importe où, sans toucher au running status ni au SysEx. */
+        if ((b == 0xF9U) || (b == 0xFDU)) {
+            p->stats.undefined++;
+            return;
+        }
+        const uint8_t d0 = p->data[0];
+        const uint8_t d1 = p->data[1];
+        p->data[0] = 0U;
+        p->data[1] = 0U;
+        emit(p, b, frame);
+        p->data[0] = d0;
+        p->data[1] = d1;
+        return;
+    }
+
+    if (b >= 0x80U) {
+        if (p->in_sysex) {
+            if (b == MIDI_SYSEX_END) {
+                sysex_close(p, MIDI_SYSEX_FLAG_END, frame);
+                return;
+            }
+            p->stats.sysex_aborted++;
+            sysex_close(p, MIDI_SYSEX_FLAG_ABORT, frame);
+        }
+
+        p->count = 0U;
+        p->data[0] = 0U;
+        p->data[1] = 0U;
+
+        if (b == MIDI_SYSEX_START) {
+            p->running = 0U;
+            p->in_sysex = true;
+            p->sysex_first = true;
+            p->sysex_len = 0U;
+            return;
+        }
+        if (midi_is_channel(b)) {
+            p->running = b;
+            p->expected = midi_data_length(b);
+            return;
+        }
+
+        /* Commun système : annule le running status. */
+        p->running = 0U;
+        if ((b == 0xF4U) || (b == 0xF5U) || (b == MIDI_SYSEX_END)) {
+            p->stats.undefined++;
+            return;
+        }
+        p->expected = midi_data_length(b);
+        if (p->expected == 0U) {
+            emit(p, b, frame);
+        } else {
+            p->running = b;   /* Provisoire : libéré dès le message complet. */
+        }
+        return;
+    }
+
+    /* Octet de données. */
+    if (p->in_sysex) {
+        p->sysex_buf[p->sysex_len++] = b;
+        p->stats.sysex_bytes++;
+        if (p->sysex_len == MIDI_PARSER_SYSEX_CHUNK) {
+            sysex_flush(p, 0U, frame);
+        }
+        return;
+    }
+    if (p->running == 0U) {
+        p->stats.stray_bytes++;
+        return;
+    }
+
+    p->data[p->count++] = b;
+    if (p->count >= p->expected) {
+        const uint8_t status = p->running;
+        emit(p, status, frame);
+        p->count = 0U;
+        if (!midi_is_channel(status)) {
+            p->running = 0U;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void midi_parser_init(midi_parser_t *p, uint8_t port,
+                      midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx) {
+    memset(p, 0, sizeof(*p));
+    p->port = port;
+    p->msg_cb = msg_cb;
+    p->sysex_cb = sysex_cb;
+    p->ctx = ctx;
+}
+
+void midi_parser_reset(midi_parser_t *p) {
+    p->running = 0U;
+    p->expected = 0U;
+    p->count = 0U;
+    p->in_sysex = false;
+    p->sysex_first = false;
+    p->sysex_len = 0U;
+}
+
+void midi_parser_feed(midi_parser_t *p, const uint8_t *data, size_t len,
+                      uint32_t frame, uint32_t byte_frames_q8) {
+    for (size_t i = 0U; i < len; ++i) {
+        /* Antidatage : octet i reçu (len - 1 - i) durées d'octet avant le dernier. */
+        const uint32_t back = (uint32_t)(((uint64_t)(len - 1U - i) * byte_frames_q8) >> 8);
+        parse_byte(p, data[i], frame - back);
+    }
+}
+
+size_t midi_tx_encode(midi_tx_state_t *tx, const midi_msg_t *msg, uint8_t *out) {
+    const uint8_t status = msg->status;
+    size_t n = 0U;
+
+    if (midi_is_realtime(status)) {
+        out[0] = status;
+        return 1U;
+    }
+    if (midi_is_channel(status)) {
+        if (status != tx->running) {
+            out[n++] = status;
+            tx->running = status;
+        }
+    } else {
+        out[n++] = status;
+        tx->running = 0U;
+    }
+
+    const uint8_t dl = midi_data_length(status);
+    for (uint8_t i = 0U; i < dl; ++i) {
+        out[n++] = (uint8_t)(msg->data[i] & 0x7FU);
+    }
+    return n;
+}
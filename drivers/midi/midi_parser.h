@@ -0,0 +1,92 @@
+/**
+ * @file midi_parser.h
+ * @brief Analyseur MIDI en flux (running status, temps réel intercalé, SysEx par fragments).
+ * @details L'analyseur consomme des octets par paquets de taille quelconque
+ * (typiquement une rafale DMA terminée par une détection de ligne inactive)
+ * et ne garde aucun buffer de message : l'état tient dans quelques octets.
+ *
+ * Horodatage : la rafale est datée à la réception de son dernier octet ;
+ * chaque octet antérieur est antidaté de sa durée de transmission
+ * (MIDI_PARSER_BYTE_FRAMES_Q8 frames par octet à 31 250 bauds), et un
+ * message porte la date de son dernier octet.
+ *
+ * Robustesse : un octet de données sans statut courant est compté et ignoré,
+ * un statut non temps réel au milieu d'un SysEx clôt le SysEx (fragment
+ * ABORT), les statuts indéfinis (F4, F5, F9, FD) sont ignorés. Aucune suite
+ * d'octets ne peut faire sortir l'analyseur de ses bornes.
+ *
+ * Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef MIDI_PARSER_H
+#define MIDI_PARSER_H
+
+#include "midi_msg.h"
+
+/** Taille maximale d'un fragment SysEx transmis au callback. */
+#define MIDI_PARSER_SYSEX_CHUNK     32U
+
+/** Durée d'un octet DIN (10 bits à 31 250 bauds) en frames à 48 kHz, Q8. */
+#define MIDI_PARSER_BYTE_FRAMES_Q8  ((10UL * 48000UL * 256UL) / 31250UL)
+
+typedef void (*midi_msg_cb_t)(void *ctx, const midi_msg_t *msg);
+typedef void (*midi_sysex_cb_t)(void *ctx, const uint8_t *data, size_t len,
+                                uint8_t flags, uint32_t frame);
+
+typedef struct {
+    uint32_t messages;
+    uint32_t sysex_bytes;
+    uint32_t stray_bytes;       /* Données sans statut courant. */
+    uint32_t undefined;         /* Statuts indéfinis ignorés. */
+    uint32_t sysex_aborted;
+} midi_parser_stats_t;
+
+typedef struct {
+    midi_msg_cb_t       msg_cb;
+    midi_sysex_cb_t     sysex_cb;
+    void               *ctx;
+    uint8_t             port;
+    uint8_t             running;     /* Statut courant (0 = aucun). */
+    uint8_t             expected;    /* Octets de données attendus. */
+    uint8_t             count;
+    uint8_t             data[2];
+    bool                in_sysex;
+    bool                sysex_first;
+    uint8_t             sysex_len;
+    uint8_t             sysex_buf[MIDI_PARSER_SYSEX_CHUNK];
+    midi_parser_stats_t stats;
+} midi_parser_t;
+
+void midi_parser_init(midi_parser_t *p, uint8_t port,
+                      midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx);
+void midi_parser_reset(midi_parser_t *p);
+
+/*
+ * Consomme `len` octets dont le dernier a été reçu à l'horodatage `frame`.
+ * `byte_frames_q8` : durée d'un octet (Q8) pour l'antidatage, 0 = aucun.
+ */
+void midi_parser_feed(midi_parser_t *p, const uint8_t *data, size_t len,
+                      uint32_t frame, uint32_t byte_frames_q8);
+
+/* -------------------------------------------------------------------------- */
+/* Émission avec running status                                               */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    uint8_t running;             /* Dernier statut canal émis (0 = aucun). */
+} midi_tx_state_t;
+
+/*
+ * Sérialise `msg` dans `out` (3 octets max) en omettant le statut quand il
+ * répète le running status. Retourne le nombre d'octets écrits.
+ */
+size_t midi_tx_encode(midi_tx_state_t *tx, const midi_msg_t *msg, uint8_t *out);
+
+/* Oublie le running status (SysEx émis, ligne restée inactive…). */
+static inline void midi_tx_reset(midi_tx_state_t *tx) {
+    tx->running = 0U;
+}
+
+#endif /* MIDI_PARSER_H */
@@ -0,0 +1,776 @@
+/**
+ * @file midi_router.c
+ * @brief Table de routage, voies temps réel / canal / SysEx et thread de sortie.
+ * @ingroup drivers
+ */
+
+#include "midi_router.h"
+#include "drv_midi.h"
+#include "usb_midi.h"
+#include <string.h>
+
+BRICK_STATIC_ASSERT((MIDI_ROUTER_QUEUE_SIZE & (MIDI_ROUTER_QUEUE_SIZE - 1U)) == 0U,
+                    midi_router_queue_pow2);
+BRICK_STATIC_ASSERT((MIDI_ROUTER_SYSEX_RING_SIZE & (MIDI_ROUTER_SYSEX_RING_SIZE - 1U)) == 0U,
+                    midi_router_sysex_ring_pow2);
+
+#define ROUTE_BIT(p)          ((uint8_t)(1U << (p)))
+
+/* Octets SysEx remis au transport par passage du thread. */
+#define ROUTER_SYSEX_BURST    32U
+#define ROUTER_IDLE_POLL_MS   100U
+#define ROUTER_RATE_WINDOW_MS 1000U
+
+/* -------------------------------------------------------------------------- */
+/* Transports de sortie                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    bool   (*ready)(void);
+    bool   (*send)(const midi_msg_t *msg);
+    bool   (*send_sysex)(const uint8_t *data, size_t len);
+    size_t (*room)(void);        /* Octets acceptés sans dépasser la borne d'arriéré. */
+} router_ops_t;
+
+static bool din_ready(void) {
+    return true;
+}
+
+static size_t din_room(void) {
+    const size_t backlog = drv_midi_tx_backlog();
+    return (backlog < MIDI_ROUTER_DIN_MAX_BACKLOG) ? (MIDI_ROUTER_DIN_MAX_BACKLOG - backlog) : 0U;
+}
+
+/* Un paquet USB porte trois octets de SysEx ou un message. */
+static size_t usb_room(void) {
+    return usb_midi_tx_room() * 3U;
+}
+
+static const router_ops_t router_ops[MIDI_NUM_PORTS] = {
+    [MIDI_PORT_DIN]      = {din_ready, drv_midi_send, drv_midi_send_sysex, din_room},
+    [MIDI_PORT_USB]      = {usb_midi_is_ready, usb_midi_send, usb_midi_send_sysex, usb_room},
+    [MIDI_PORT_INTERNAL] = {NULL, NULL, NULL, NULL}
+};
+
+/* Intervalle minimal entre deux valeurs d'un même contrôleur, par sortie. */
+static const uint16_t router_ctl_interval_ms[MIDI_NUM_PORTS] = {
+    [MIDI_PORT_DIN]      = MIDI_ROUTER_CTL_INTERVAL_DIN_MS,
+    [MIDI_PORT_USB]      = MIDI_ROUTER_CTL_INTERVAL_USB_MS,
+    [MIDI_PORT_INTERNAL] = 0U
+};
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    midi_msg_t msg;
+    systime_t  stamp;
+} router_entry_t;
+
+/* Dernière valeur d'un contrôleur continu (status 0 : entrée libre). */
+typedef struct {
+    uint8_t   status;
+    uint8_t   key;           /* Numéro de CC ou note (pression polyphonique). */
+    uint8_t   value[2];
+    bool      dirty;         /* Valeur pas encore émise. */
+    systime_t stamp;         /* Arrivée de la première valeur non émise. */
+    systime_t sent;          /* Dernière émission. */
+} router_ctl_t;
+
+typedef struct {
+    router_entry_t     queue[MIDI_ROUTER_QUEUE_SIZE];
+    uint32_t           q_head;
+    uint32_t           q_tail;
+    router_ctl_t       ctl[MIDI_ROUTER_CTL_SLOTS];
+    uint8_t            sx_ring[MIDI_ROUTER_SYSEX_RING_SIZE];
+    uint32_t           sx_head;
+    uint32_t           sx_tail;
+    int8_t             sx_owner;     /* Source qui réserve la sortie (-1 : libre). */
+    bool               sx_open;      /* SysEx du propriétaire pas encore clos. */
+    uint8_t            sx_reject;    /* Sources dont le SysEx courant est rejeté. */
+    systime_t          sx_last;
+    binary_semaphore_t sx_space;
+} router_out_t;
+
+static struct {
+    midi_route_t             routes[MIDI_NUM_PORTS][MIDI_NUM_PORTS];  /* [source][destination] */
+    router_out_t             out[MIDI_NUM_PORTS];
+    midi_router_port_stats_t stats[MIDI_NUM_PORTS];
+    uint32_t                 win_in[MIDI_NUM_PORTS];
+    uint32_t                 win_out[MIDI_NUM_PORTS];
+    systime_t                win_start;
+    midi_msg_cb_t            internal_msg_cb;
+    midi_sysex_cb_t          internal_sysex_cb;
+    void                    *internal_ctx;
+    binary_semaphore_t       wake;
+    bool                     initialized;
+} router;
+
+static THD_WORKING_AREA(midiRouterThreadWA, MIDI_ROUTER_THREAD_STACK_SIZE);
+
+static inline size_t msg_bytes(uint8_t status) {
+    return 1U + midi_data_length(status);
+}
+
+static uint8_t msg_class(uint8_t status) {
+    if (midi_is_realtime(status)) {
+        return MIDI_ROUTE_REALTIME;
+    }
+    return midi_is_channel(status) ? MIDI_ROUTE_CHANNEL : MIDI_ROUTE_COMMON;
+}
+
+/*
+ * Contrôles continus : seule la dernière valeur compte, ils sont fusionnés
+ * et écartables s'ils sont périmés. Les CC dont l'ordre a un sens (banque,
+ * entrée de données RPN / NRPN, pédales, modes de canal) restent en file.
+ */
+static bool msg_coalescable(const midi_msg_t *msg) {
+    const uint8_t type = (uint8_t)(msg->status & 0xF0U);
+    if (type != MIDI_CONTROL_CHANGE) {
+        return (type == MIDI_POLY_PRESSURE) || (type == MIDI_CHANNEL_PRESSURE) ||
+               (type == MIDI_PITCH_BEND);
+    }
+    const uint8_t cc = msg->data[0];
+    return (cc != 0U) && (cc != 6U) && (cc != 32U) && (cc != 38U) &&
+           ((cc < 64U) || (cc > 69U)) && ((cc < 96U) || (cc > 101U)) && (cc < 120U);
+}
+
+static inline uint8_t msg_ctl_key(const midi_msg_t *msg) {
+    const uint8_t type = (uint8_t)(msg->status & 0xF0U);
+    return ((type == MIDI_CONTROL_CHANGE) || (type == MIDI_POLY_PRESSURE)) ? msg->data[0] : 0U;
+}
+
+/* Destinations d'un message de classe `cls`. Sous verrou. */
+static uint8_t route_dests(uint8_t src, uint8_t cls, uint8_t status) {
+    uint8_t dests = 0U;
+    for (uint8_t d = 0U; d < MIDI_NUM_PORTS; ++d) {
+        const midi_route_t *r = &router.routes[src][d];
+        if ((r->types & cls) == 0U) {
+            continue;
+        }
+        if ((cls == MIDI_ROUTE_CHANNEL) && ((r->channels & (1U << (status & 0x0FU))) == 0U)) {
+            continue;
+        }
+        dests |= ROUTE_BIT(d);
+    }
+    /* Pas de boucle interne. */
+    if (src == MIDI_PORT_INTERNAL) {
+        dests &= (uint8_t)~ROUTE_BIT(MIDI_PORT_INTERNAL);
+    }
+    return dests;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Voie SysEx                                                                 */
+/* -------------------------------------------------------------------------- */
+
+static inline uint32_t sx_free_s(const router_out_t *o) {
+    return MIDI_ROUTER_SYSEX_RING_SIZE - (o->sx_head - o->sx_tail);
+}
+
+static inline void sx_push_s(router_out_t *o, uint8_t b) {
+    o->sx_ring[o->sx_head & (MIDI_ROUTER_SYSEX_RING_SIZE - 1U)] = b;
+    o->sx_head++;
+}
+
+/* Clôt le SysEx du propriétaire par F7 (une place est toujours réservée). Sous verrou. */
+static void sx_abort_s(router_out_t *o, uint8_t port) {
+    sx_push_s(o, MIDI_SYSEX_END);
+    o->sx_reject |= ROUTE_BIT((uint8_t)o->sx_owner);
+    o->sx_open = false;
+    router.stats[port].sysex_aborted++;
+}
+
+/* Retourne false si le fragment n'a pas été accepté (sortie réservée, délai). */
+static bool sx_to_output(uint8_t port, uint8_t src, const uint8_t *data, size_t len,
+                         uint8_t flags) {
+    router_out_t *o = &router.out[port];
+    const uint8_t bit = ROUTE_BIT(src);
+    const bool start = (flags & MIDI_SYSEX_FLAG_START) != 0U;
+    const bool end = (flags & (MIDI_SYSEX_FLAG_END | MIDI_SYSEX_FLAG_ABORT)) != 0U;
+
+    chSysLock();
+    if (start) {
+        /* Un nouveau SysEx du propriétaire se range derrière le précédent. */
+        if ((o->sx_owner < 0) || (o->sx_owner == (int8_t)src)) {
+            o->sx_owner = (int8_t)src;
+            o->sx_open = true;
+            o->sx_reject &= (uint8_t)~bit;
+        } else {
+            o->sx_reject |= bit;
+            router.stats[port].sysex_rejected++;
+        }
+    }
+    if ((o->sx_owner != (int8_t)src) || !o->sx_open || ((o->sx_reject & bit) != 0U)) {
+        if (end) {
+            o->sx_reject &= (uint8_t)~bit;
+        }
+        chSysUnlock();
+        return false;
+    }
+
+    const size_t total = len + (start ? 1U : 0U) + (end ? 1U : 0U);
+    for (size_t i = 0U; i < total; ++i) {
+        uint8_t b;
+        if (start && (i == 0U)) {
+            b = MIDI_SYSEX_START;
+        } else if (end && (i == (total - 1U))) {
+            b = MIDI_SYSEX_END;
+        } else {
+            b = data[i - (start ? 1U : 0U)];
+        }
+
+        /* La dernière place reste au F7 de clôture. */
+        while (sx_free_s(o) <= ((b == MIDI_SYSEX_END) ? 0U : 1U)) {
+            chBSemResetI(&o->sx_space, true);
+            chSysUnlock();
+            const msg_t r = chBSemWaitTimeout(&o->sx_space, TIME_MS2I(MIDI_ROUTER_SYSEX_TIMEOUT_MS));
+            chSysLock();
+            if ((o->sx_owner != (int8_t)src) || !o->sx_open) {
+                chSysUnlock();
+                return false;
+            }
+            if (r != MSG_OK) {
+                sx_abort_s(o, port);
+                if (end) {
+                    o->sx_reject &= (uint8_t)~bit;
+                }
+                chBSemSignalI(&router.wake);
+                chSchRescheduleS();
+                chSysUnlock();
+                return false;
+            }
+        }
+        sx_push_s(o, b);
+    }
+    o->sx_last = chVTGetSystemTimeX();
+    if (end) {
+        o->sx_open = false;
+    }
+    chBSemSignalI(&router.wake);
+    chSchRescheduleS();
+    chSysUnlock();
+    return true;
+}
+
+/* Vide la voie SysEx. Retourne true si la sortie reste réservée. */
+static bool drain_sysex(uint8_t port, const router_ops_t *ops) {
+    router_out_t *o = &router.out[port];
+    uint8_t buf[ROUTER_SYSEX_BURST];
+
+    const size_t room = ops->room();
+
+    chSysLock();
+    if (o->sx_owner < 0) {
+        chSysUnlock();
+        return false;
+    }
+    const uint32_t pending = o->sx_head - o->sx_tail;
+    if (pending == 0U) {
+        if (!o->sx_open) {
+            o->sx_owner = -1;
+            chSysUnlock();
+            return false;
+        }
+        /* Source muette au milieu d'un SysEx : la sortie est libérée. */
+        if (chVTTimeElapsedSinceX(o->sx_last) > TIME_MS2I(MIDI_ROUTER_SYSEX_TIMEOUT_MS)) {
+            sx_abort_s(o, port);
+        }
+        chSysUnlock();
+        return true;
+    }
+
+    size_t n = pending;
+    if (n > room) {
+        n = room;
+    }
+    if (n > ROUTER_SYSEX_BURST) {
+        n = ROUTER_SYSEX_BURST;
+    }
+    for (size_t i = 0U; i < n; ++i) {
+        buf[i] = o->sx_ring[(o->sx_tail + i) & (MIDI_ROUTER_SYSEX_RING_SIZE - 1U)];
+    }
+    chSysUnlock();
+
+    if (n == 0U) {
+        return true;
+    }
+    const bool ok = ops->send_sysex(buf, n);
+
+    chSysLock();
+    o->sx_tail += (uint32_t)n;
+    if (ok) {
+        router.stats[port].out_bytes += (uint32_t)n;
+    } else {
+        router.stats[port].dropped_full++;
+    }
+    chBSemSignalI(&o->sx_space);
+    chSchRescheduleS();
+    chSysUnlock();
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Voie canal                                                                 */
+/* -------------------------------------------------------------------------- */
+
+/* Vide la file de messages. Retourne true s'il reste des messages en attente. */
+static bool drain_queue(uint8_t port, const router_ops_t *ops) {
+    router_out_t *o = &router.out[port];
+    midi_router_port_stats_t *st = &router.stats[port];
+
+    while (true) {
+        const size_t room = ops->room();
+
+        chSysLock();
+        /* Contrôles périmés écartés en tête de file. */
+        while (o->q_tail != o->q_head) {
+            const router_entry_t *e = &o->queue[o->q_tail & (MIDI_ROUTER_QUEUE_SIZE - 1U)];
+            if (!msg_coalescable(&e->msg) ||
+                (chVTTimeElapsedSinceX(e->stamp) <= TIME_MS2I(MIDI_ROUTER_MAX_LATENCY_MS))) {
+                break;
+            }
+            o->q_tail++;
+            st->dropped_stale++;
+        }
+        if (o->q_tail == o->q_head) {
+            chSysUnlock();
+            return false;
+        }
+        const router_entry_t e = o->queue[o->q_tail & (MIDI_ROUTER_QUEUE_SIZE - 1U)];
+        chSysUnlock();
+
+        const size_t need = msg_bytes(e.msg.status);
+        if (room < need) {
+            return true;
+        }
+        const bool ok = ops->send(&e.msg);
+
+        chSysLock();
+        o->q_tail++;
+        if (ok) {
+            const uint32_t us = (uint32_t)TIME_I2US(chVTTimeElapsedSinceX(e.stamp));
+            st->out_msgs++;
+            st->out_bytes += (uint32_t)need;
+            if (us > st->latency_max_us) {
+                st->latency_max_us = us;
+            }
+        } else {
+            st->dropped_full++;
+        }
+        chSysUnlock();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Voie des contrôleurs                                                       */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Range la valeur d'un contrôleur continu : écrase la valeur en attente du
+ * même contrôleur, sinon prend une entrée libre ou la moins récemment émise
+ * des entrées propres. Retourne false si toutes les entrées attendent. Sous
+ * verrou.
+ */
+static bool ctl_put_s(uint8_t port, const midi_msg_t *msg) {
+    router_out_t *o = &router.out[port];
+    const uint8_t key = msg_ctl_key(msg);
+    const systime_t now = chVTGetSystemTimeX();
+    router_ctl_t *slot = NULL;
+
+    for (uint8_t i = 0U; i < MIDI_ROUTER_CTL_SLOTS; ++i) {
+        router_ctl_t *e = &o->ctl[i];
+        if ((e->status == msg->status) && (e->key == key)) {
+            if (e->dirty) {
+                router.stats[port].coalesced++;
+            } else {
+                e->dirty = true;
+                e->stamp = now;
+            }
+            e->value[0] = msg->data[0];
+            e->value[1] = msg->data[1];
+            return true;
+        }
+        if (e->status == 0U) {
+            if ((slot == NULL) || (slot->status != 0U)) {
+                slot = e;
+            }
+        } else if (!e->dirty && ((slot == NULL) ||
+                                 ((slot->status != 0U) &&
+                                  (chVTTimeElapsedSinceX(e->sent) > chVTTimeElapsedSinceX(slot->sent))))) {
+            slot = e;
+        }
+    }
+    if (slot == NULL) {
+        return false;
+    }
+
+    slot->status = msg->status;
+    slot->key = key;
+    slot->value[0] = msg->data[0];
+    slot->value[1] = msg->data[1];
+    slot->dirty = true;
+    slot->stamp = now;
+    /* Nouveau contrôleur : émissible immédiatement. */
+    slot->sent = now - TIME_MS2I(router_ctl_interval_ms[port]);
+    return true;
+}
+
+/*
+ * Émet les contrôleurs en attente, la plus ancienne valeur d'abord, chacun
+ * au plus une fois par intervalle, dans la place laissée par la file.
+ * Retourne true s'il reste des valeurs en attente.
+ */
+static bool drain_ctl(uint8_t port, const router_ops_t *ops) {
+    router_out_t *o = &router.out[port];
+    midi_router_port_stats_t *st = &router.stats[port];
+    const sysinterval_t interval = TIME_MS2I(router_ctl_interval_ms[port]);
+
+    while (true) {
+        const size_t room = ops->room();
+
+        chSysLock();
+        router_ctl_t *best = NULL;
+        bool pending = false;
+        for (uint8_t i = 0U; i < MIDI_ROUTER_CTL_SLOTS; ++i) {
+            router_ctl_t *e = &o->ctl[i];
+            if (!e->dirty) {
+                continue;
+            }
+            pending = true;
+            if ((chVTTimeElapsedSinceX(e->sent) >= interval) &&
+                ((best == NULL) ||
+                 (chVTTimeElapsedSinceX(e->stamp) > chVTTimeElapsedSinceX(best->stamp)))) {
+                best = e;
+            }
+        }
+        if (best == NULL) {
+            chSysUnlock();
+            return pending;
+        }
+        const size_t need = msg_bytes(best->status);
+        if (room < need) {
+            chSysUnlock();
+            return true;
+        }
+        const midi_msg_t msg = {0U, best->status, {best->value[0], best->value[1]}, port};
+        const systime_t stamp = best->stamp;
+        best->dirty = false;
+        best->sent = chVTGetSystemTimeX();
+        chSysUnlock();
+
+        const bool ok = ops->send(&msg);
+
+        chSysLock();
+        if (ok) {
+            const uint32_t us = (uint32_t)TIME_I2US(chVTTimeElapsedSinceX(stamp));
+            st->out_msgs++;
+            st->out_bytes += (uint32_t)need;
+            if (us > st->latency_max_us) {
+                st->latency_max_us = us;
+            }
+        } else {
+            st->dropped_full++;
+        }
+        chSysUnlock();
+    }
+}
+
+/* Sortie indisponible : files vidées, réservation SysEx levée. */
+static void flush_output(uint8_t port) {
+    router_out_t *o = &router.out[port];
+
+    chSysLock();
+    uint32_t n = o->q_head - o->q_tail;
+    for (uint8_t i = 0U; i < MIDI_ROUTER_CTL_SLOTS; ++i) {
+        if (o->ctl[i].dirty) {
+            o->ctl[i].dirty = false;
+            n++;
+        }
+    }
+    if ((n != 0U) || (o->sx_owner >= 0)) {
+        router.stats[port].dropped_offline += n;
+        o->q_tail = o->q_head;
+        o->sx_tail = o->sx_head;
+        o->sx_owner = -1;
+        o->sx_open = false;
+        o->sx_reject = 0U;
+        chBSemSignalI(&o->sx_space);
+        chSchRescheduleS();
+    }
+    chSysUnlock();
+}
+
+static void update_rates(void) {
+    if (chVTTimeElapsedSinceX(router.win_start) < TIME_MS2I(ROUTER_RATE_WINDOW_MS)) {
+        return;
+    }
+    router.win_start = chVTGetSystemTimeX();
+
+    chSysLock();
+    for (uint8_t p = 0U; p < MIDI_NUM_PORTS; ++p) {
+        midi_router_port_stats_t *st = &router.stats[p];
+        st->in_rate = st->in_bytes - router.win_in[p];
+        st->out_rate = st->out_bytes - router.win_out[p];
+        router.win_in[p] = st->in_bytes;
+        router.win_out[p] = st->out_bytes;
+    }
+    chSysUnlock();
+}
+
+static THD_FUNCTION(midiRouterThread, arg) {
+    (void)arg;
+    chRegSetThreadName("midiRouter");
+
+    bool busy = false;
+    while (true) {
+        (void)chBSemWaitTimeout(&router.wake, busy ? TIME_MS2I(1) : TIME_MS2I(ROUTER_IDLE_POLL_MS));
+
+        busy = false;
+        for (uint8_t p = 0U; p < MIDI_NUM_PORTS; ++p) {
+            const router_ops_t *ops = &router_ops[p];
+            if (ops->send == NULL) {
+                continue;
+            }
+            if (!ops->ready()) {
+                flush_output(p);
+                continue;
+            }
+            /* SysEx atomique : la voie canal attend la fin de la réservation. */
+            if (drain_sysex(p, ops)) {
+                busy = true;
+                continue;
+            }
+            /* Notes et messages ordonnés d'abord, contrôleurs dans la place restante. */
+            if (drain_queue(p, ops)) {
+                busy = true;
+                continue;
+            }
+            busy = drain_ctl(p, ops) || busy;
+        }
+        update_rates();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void midi_router_init(void) {
+    if (router.initialized) {
+        return;
+    }
+    memset(&router, 0, sizeof(router));
+    chBSemObjectInit(&router.wake, true);
+    for (uint8_t p = 0U; p < MIDI_NUM_PORTS; ++p) {
+        router.out[p].sx_owner = -1;
+        chBSemObjectInit(&router.out[p].sx_space, true);
+        for (uint8_t d = 0U; d < MIDI_NUM_PORTS; ++d) {
+            if (d != p) {
+                router.routes[p][d].types = MIDI_ROUTE_ALL;
+                router.routes[p][d].channels = MIDI_ROUTE_ALL_CHANNELS;
+            }
+        }
+    }
+
+    /* L'horloge externe passe par le séquenceur (suivi PLL, réémission). */
+    router.routes[MIDI_PORT_DIN][MIDI_PORT_USB].types = MIDI_ROUTE_ALL & ~MIDI_ROUTE_REALTIME;
+    router.routes[MIDI_PORT_USB][MIDI_PORT_DIN].types = MIDI_ROUTE_ALL & ~MIDI_ROUTE_REALTIME;
+    router.win_start = chVTGetSystemTimeX();
+    router.initialized = true;
+}
+
+void midi_router_start(void) {
+    if (!router.initialized) {
+        midi_router_init();
+    }
+    chThdCreateStatic(midiRouterThreadWA, sizeof(midiRouterThreadWA),
+                      MIDI_ROUTER_THREAD_PRIORITY, midiRouterThread, NULL);
+}
+
+void midi_router_set_route(uint8_t src, uint8_t dst, const midi_route_t *route) {
+    if ((src >= MIDI_NUM_PORTS) || (dst >= MIDI_NUM_PORTS) || (route == NULL)) {
+        return;
+    }
+    chSysLock();
+    router.routes[src][dst] = *route;
+    chSysUnlock();
+}
+
+void midi_router_get_route(uint8_t src, uint8_t dst, midi_route_t *route) {
+    if ((src >= MIDI_NUM_PORTS) || (dst >= MIDI_NUM_PORTS) || (route == NULL)) {
+        return;
+    }
+    chSysLock();
+    *route = router.routes[src][dst];
+    chSysUnlock();
+}
+
+void midi_router_set_internal_cb(midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx) {
+    chSysLock();
+    router.internal_msg_cb = msg_cb;
+    router.internal_sysex_cb = sysex_cb;
+    router.internal_ctx = ctx;
+    chSysUnlock();
+}
+
+void midi_router_rx_msg(void *ctx, const midi_msg_t *in) {
+    const uint8_t src = (uint8_t)(uintptr_t)ctx;
+    if (src >= MIDI_NUM_PORTS) {
+        return;
+    }
+
+    midi_msg_t msg = *in;
+    msg.port = src;
+    const uint8_t cls = msg_class(msg.status);
+    const size_t bytes = msg_bytes(msg.status);
+
+    chSysLock();
+    router.stats[src].in_msgs++;
+    router.stats[src].in_bytes += (uint32_t)bytes;
+    const uint8_t dests = route_dests(src, cls, msg.status);
+    const midi_msg_cb_t internal_cb = router.internal_msg_cb;
+    void *internal_ctx = router.internal_ctx;
+    chSysUnlock();
+
+    bool queued = false;
+    for (uint8_t p = 0U; p < MIDI_NUM_PORTS; ++p) {
+        if ((dests & ROUTE_BIT(p)) == 0U) {
+            continue;
+        }
+        midi_router_port_stats_t *st = &router.stats[p];
+
+        if (p == MIDI_PORT_INTERNAL) {
+            if (internal_cb != NULL) {
+                internal_cb(internal_ctx, &msg);
+            }
+            chSysLock();
+            st->out_msgs++;
+            st->out_bytes += (uint32_t)bytes;
+            chSysUnlock();
+            continue;
+        }
+
+        const router_ops_t *ops = &router_ops[p];
+        if (!ops->ready()) {
+            chSysLock();
+            st->dropped_offline++;
+            chSysUnlock();
+            continue;
+        }
+
+        /* Temps réel : voie prioritaire du transport, sans file. */
+        if (cls == MIDI_ROUTE_REALTIME) {
+            const bool ok = ops->send(&msg);
+            chSysLock();
+            if (ok) {
+                st->realtime++;
+                st->out_msgs++;
+                st->out_bytes++;
+            } else {
+                st->dropped_full++;
+            }
+            chSysUnlock();
+            continue;
+        }
+
+        router_out_t *o = &router.out[p];
+        chSysLock();
+        if (msg_coalescable(&msg) && ctl_put_s(p, &msg)) {
+            chSysUnlock();
+            queued = true;
+            continue;
+        }
+        const uint32_t depth = o->q_head - o->q_tail;
+        if (depth < MIDI_ROUTER_QUEUE_SIZE) {
+            router_entry_t *e = &o->queue[o->q_head & (MIDI_ROUTER_QUEUE_SIZE - 1U)];
+            e->msg = msg;
+            e->stamp = chVTGetSystemTimeX();
+            o->q_head++;
+            if ((depth + 1U) > st->queue_max) {
+                st->queue_max = (uint16_t)(depth + 1U);
+            }
+            queued = true;
+        } else {
+            st->dropped_full++;
+        }
+        chSysUnlock();
+    }
+
+    if (queued) {
+        chSysLock();
+        chBSemSignalI(&router.wake);
+        chSchRescheduleS();
+        chSysUnlock();
+    }
+}
+
+void midi_router_rx_sysex(void *ctx, const uint8_t *data, size_t len,
+                          uint8_t flags, uint32_t frame) {
+    const uint8_t src = (uint8_t)(uintptr_t)ctx;
+    if (src >= MIDI_NUM_PORTS) {
+        return;
+    }
+
+    const size_t framing = (((flags & MIDI_SYSEX_FLAG_START) != 0U) ? 1U : 0U) +
+                           (((flags & MIDI_SYSEX_FLAG_END) != 0U) ? 1U : 0U);
+
+    chSysLock();
+    router.stats[src].in_bytes += (uint32_t)(len + framing);
+    if ((flags & MIDI_SYSEX_FLAG_END) != 0U) {
+        router.stats[src].in_msgs++;
+    }
+    const uint8_t dests = route_dests(src, MIDI_ROUTE_SYSEX, MIDI_SYSEX_START);
+    const midi_sysex_cb_t internal_cb = router.internal_sysex_cb;
+    chSysUnlock();
+
+    for (uint8_t p = 0U; p < MIDI_NUM_PORTS; ++p) {
+        if ((dests & ROUTE_BIT(p)) == 0U) {
+            continue;
+        }
+        if (p == MIDI_PORT_INTERNAL) {
+            if (internal_cb != NULL) {
+                internal_cb(MIDI_ROUTER_PORT_CTX(src), data, len, flags, frame);
+            }
+            chSysLock();
+            router.stats[p].out_bytes += (uint32_t)(len + framing);
+            chSysUnlock();
+            continue;
+        }
+        if (!router_ops[p].ready()) {
+            continue;
+        }
+        (void)sx_to_output(p, src, data, len, flags);
+    }
+}
+
+void midi_router_send(const midi_msg_t *msg) {
+    midi_router_rx_msg(MIDI_ROUTER_PORT_CTX(MIDI_PORT_INTERNAL), msg);
+}
+
+bool midi_router_send_sysex(uint8_t dst, const uint8_t *data, size_t len, uint8_t flags) {
+    if ((dst >= MIDI_NUM_PORTS) || (dst == MIDI_PORT_INTERNAL) || !router_ops[dst].ready()) {
+        return false;
+    }
+
+    const size_t framing = (((flags & MIDI_SYSEX_FLAG_START) != 0U) ? 1U : 0U) +
+                           (((flags & MIDI_SYSEX_FLAG_END) != 0U) ? 1U : 0U);
+    chSysLock();
+    router.stats[MIDI_PORT_INTERNAL].in_bytes += (uint32_t)(len + framing);
+    if ((flags & MIDI_SYSEX_FLAG_END) != 0U) {
+        router.stats[MIDI_PORT_INTERNAL].in_msgs++;
+    }
+    chSysUnlock();
+
+    return sx_to_output(dst, MIDI_PORT_INTERNAL, data, len, flags);
+}
+
+void midi_router_get_stats(uint8_t port, midi_router_port_stats_t *st) {
+    if ((port >= MIDI_NUM_PORTS) || (st == NULL)) {
+        return;
+    }
+    chSysLock();
+    *st = router.stats[port];
+    chSysUnlock();
+}
@@ -0,0 +1,129 @@
+/**
+ * @file midi_router.h
+ * @brief Routeur / fusionneur MIDI : DIN, USB et séquenceur interne.
+ * @details La table de routage a une entrée par couple (source, destination)
+ * de ports MIDI_PORT_* : classes de messages et canaux acceptés. Par défaut
+ * chaque entrée est fusionnée vers les deux autres ports, sauf le temps réel
+ * entre DIN et USB : l'horloge externe est suivie par le séquenceur, qui la
+ * réémet lissée. Trois voies par sortie :
+ *  - temps réel (F8..FF) : aucune file, transmis depuis le thread appelant
+ *    vers la voie prioritaire du transport (drv_midi, usb_midi), donc jamais
+ *    derrière un arriéré de messages canal ;
+ *  - messages canal / communs : file bornée par sortie, vidée par le thread
+ *    routeur sans dépasser MIDI_ROUTER_DIN_MAX_BACKLOG octets en attente dans
+ *    le transport DIN ; notes et program change ne sont jamais écartés ;
+ *  - contrôleurs continus (CC hors banque, RPN / NRPN, pédales et modes ;
+ *    pressions, pitch bend) : une entrée par contrôleur et par sortie qui ne
+ *    garde que la dernière valeur. Chaque contrôleur est émis au plus une
+ *    fois par intervalle (MIDI_ROUTER_CTL_INTERVAL_*_MS), la plus ancienne
+ *    valeur en attente d'abord, et seulement quand la file est vide : une
+ *    sortie saturée perd les valeurs intermédiaires, jamais une note ni
+ *    l'horloge. Faute d'entrée libre, la valeur passe par la file, où un
+ *    contrôle resté plus de MIDI_ROUTER_MAX_LATENCY_MS est écarté ;
+ *  - SysEx : atomique par sortie. La première source qui ouvre un SysEx vers
+ *    une sortie la réserve jusqu'à son F7 ; la voie canal de cette sortie est
+ *    suspendue pendant ce temps, et un SysEx concurrent d'une autre source y
+ *    est rejeté en entier. Le producteur attend la place (contre-pression
+ *    naturelle sur l'USB), au plus MIDI_ROUTER_SYSEX_TIMEOUT_MS ; un SysEx
+ *    interrompu est clos par F7.
+ *
+ * La sortie interne (séquenceur, SysEx de l'appareil) n'a pas de file : ses
+ * callbacks sont appelés depuis le thread de la source.
+ *
+ * Comptage par port : octets et messages entrants / sortants, débit sur la
+ * dernière seconde, profondeur et latence maximales de file, pertes.
+ *
+ * @ingroup drivers
+ */
+
+#ifndef MIDI_ROUTER_H
+#define MIDI_ROUTER_H
+
+#include "ch.h"
+#include "hal.h"
+#include "midi_parser.h"
+
+/** Classes de messages (midi_route_t.types). */
+#define MIDI_ROUTE_CHANNEL            0x01U
+#define MIDI_ROUTE_COMMON             0x02U   /* F1, F2, F3, F6. */
+#define MIDI_ROUTE_REALTIME           0x04U
+#define MIDI_ROUTE_SYSEX              0x08U
+#define MIDI_ROUTE_ALL                0x0FU
+
+#define MIDI_ROUTE_ALL_CHANNELS       0xFFFFU
+
+#define MIDI_ROUTER_QUEUE_SIZE        64U     /* Messages par sortie (puissance de 2). */
+#define MIDI_ROUTER_SYSEX_RING_SIZE   256U    /* Octets SysEx par sortie (puissance de 2). */
+#define MIDI_ROUTER_MAX_LATENCY_MS    30U
+#define MIDI_ROUTER_DIN_MAX_BACKLOG   12U     /* ~4 ms de ligne DIN. */
+#define MIDI_ROUTER_SYSEX_TIMEOUT_MS  200U
+
+/* Contrôleurs suivis par sortie et cadence maximale par contrôleur. */
+#define MIDI_ROUTER_CTL_SLOTS            32U
+#define MIDI_ROUTER_CTL_INTERVAL_DIN_MS  10U     /* 100 valeurs/s par contrôleur. */
+#define MIDI_ROUTER_CTL_INTERVAL_USB_MS  2U
+
+#define MIDI_ROUTER_THREAD_STACK_SIZE 1024U
+#define MIDI_ROUTER_THREAD_PRIORITY   (NORMALPRIO + 7)
+
+/** Contexte des callbacks de réception : port source. */
+#define MIDI_ROUTER_PORT_CTX(p)       ((void *)(uintptr_t)(p))
+
+typedef struct {
+    uint8_t  types;       /* Masque MIDI_ROUTE_* (0 : route coupée). */
+    uint16_t channels;    /* Bit n : canal n + 1. */
+} midi_route_t;
+
+typedef struct {
+    uint32_t in_msgs;
+    uint32_t in_bytes;
+    uint32_t out_msgs;
+    uint32_t out_bytes;
+    uint32_t in_rate;             /* Octets/s, dernière seconde. */
+    uint32_t out_rate;
+    uint32_t realtime;            /* Octets temps réel passés en dérivation. */
+    uint32_t dropped_full;        /* File pleine ou transport refusé. */
+    uint32_t dropped_stale;       /* Contrôles périmés écartés. */
+    uint32_t coalesced;           /* Valeurs intermédiaires de contrôleurs remplacées. */
+    uint32_t dropped_offline;     /* Sortie indisponible (hôte USB absent). */
+    uint32_t sysex_rejected;      /* SysEx refusés : sortie réservée par une autre source. */
+    uint32_t sysex_aborted;       /* SysEx tronqués (délai, source muette). */
+    uint16_t queue_max;
+    uint32_t latency_max_us;      /* Pire attente en file d'un message transmis. */
+} midi_router_port_stats_t;
+
+void midi_router_init(void);
+void midi_router_start(void);
+
+void midi_router_set_route(uint8_t src, uint8_t dst, const midi_route_t *route);
+void midi_router_get_route(uint8_t src, uint8_t dst, midi_route_t *route);
+
+/*
+ * Sortie interne : appelée depuis le thread de la source. Un fragment SysEx
+ * ne portant pas de port, sysex_cb reçoit ctx = MIDI_ROUTER_PORT_CTX(source)
+ * (`ctx` ne sert qu'à msg_cb).
+ */
+void midi_router_set_internal_cb(midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx);
+
+/*
+ * Entrées, au format des callbacks de réception des drivers (ctx =
+ * MIDI_ROUTER_PORT_CTX(source)). midi_router_rx_msg ne bloque pas et peut
+ * être appelé depuis le thread audio ; midi_router_rx_sysex peut attendre.
+ */
+void midi_router_rx_msg(void *ctx, const midi_msg_t *msg);
+void midi_router_rx_sysex(void *ctx, const uint8_t *data, size_t len,
+                          uint8_t flags, uint32_t frame);
+
+/* Message émis par l'appareil lui-même (port MIDI_PORT_INTERNAL). */
+void midi_router_send(const midi_msg_t *msg);
+
+/*
+ * SysEx émis par l'appareil vers la seule sortie `dst` (réponse à une requête,
+ * dump), fragment au format des callbacks SysEx. Attend la place comme une
+ * source externe ; false si la sortie est absente, réservée ou bloquée.
+ */
+bool midi_router_send_sysex(uint8_t dst, const uint8_t *data, size_t len, uint8_t flags);
+
+void midi_router_get_stats(uint8_t port, midi_router_port_stats_t *st);
+
+#endif /* MIDI_ROUTER_H */
@@ -0,0 +1,56 @@
+/**
+ * @file midi_sysex7.c
+ * @brief Empaquetage / dépaquetage 7 bits par groupes de 7 octets.
+ * @ingroup drivers
+ */
+
+#include "midi_sysex7.h"
+
+size_t midi_sysex7_pack(const uint8_t *src, size_t len, uint8_t *dst) {
+    size_t n = 0U;
+
+    for (size_t i = 0U; i < len; i += 7U) {
+        const size_t group = ((len - i) < 7U) ? (len - i) : 7U;
+        uint8_t msbs = 0U;
+
+        for (size_t k = 0U; k < group; ++k) {
+            msbs |= (uint8_t)((src[i + k] >> 7) << k);
+            dst[n + 1U + k] = (uint8_t)(src[i + k] & 0x7FU);
+        }
+        dst[n] = msbs;
+        n += group + 1U;
+    }
+    return n;
+}
+
+size_t midi_sysex7_unpack(const uint8_t *src, size_t len, uint8_t *dst) {
+    size_t n = 0U;
+
+    for (size_t i = 0U; i < len; i += 8U) {
+        const size_t group = ((len - i) < 8U) ? (len - i) : 8U;
+        if (group < 2U) {
+            return 0U;
+        }
+
+        const uint8_t msbs = src[i];
+        if (msbs >= 0x80U) {
+            return 0U;
+        }
+        for (size_t k = 1U; k < group; ++k) {
+            const uint8_t b = src[i + k];
+            if (b >= 0x80U) {
+                return 0U;
+            }
+            dst[n++] = (uint8_t)(b | (((msbs >> (k - 1U)) & 1U) << 7));
+        }
+    }
+    return n;
+}
+
+uint8_t midi_sysex7_checksum(const uint8_t *data, size_t len) {
+    uint8_t x = 0U;
+    for (size_t i = 0U; i < len; ++i) {
+        x ^= data[i];
+    }
+    return (uint8_t)(x & 0x7FU);
+}
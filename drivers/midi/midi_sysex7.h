@@ -0,0 +1,35 @@
+/**
+ * @file midi_sysex7.h
+ * @brief Empaquetage 7 bits des données binaires transportées en SysEx.
+ * @details Chaque groupe de 7 octets bruts devient 8 octets MIDI : un octet
+ * de poids forts (bit i = bit 7 de l'octet i du groupe) suivi des 7 octets
+ * masqués à 7 bits. Le dernier groupe peut être incomplet (n octets bruts,
+ * n + 1 octets empaquetés). Le codage se fait morceau par morceau : un
+ * morceau brut multiple de 7 octets donne un morceau empaqueté autonome.
+ *
+ * Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef MIDI_SYSEX7_H
+#define MIDI_SYSEX7_H
+
+#include "midi_msg.h"
+
+/** Taille empaquetée de `n` octets bruts. */
+#define MIDI_SYSEX7_PACKED_SIZE(n)   ((n) + (((n) + 6U) / 7U))
+
+/* Retourne la taille empaquetée écrite dans `dst`. */
+size_t midi_sysex7_pack(const uint8_t *src, size_t len, uint8_t *dst);
+
+/*
+ * Retourne le nombre d'octets bruts écrits dans `dst`, 0 si le flux est
+ * invalide (octet >= 0x80, groupe final réduit à son octet de poids forts).
+ */
+size_t midi_sysex7_unpack(const uint8_t *src, size_t len, uint8_t *dst);
+
+/* Somme de contrôle 7 bits (XOR) d'octets déjà empaquetés. */
+uint8_t midi_sysex7_checksum(const uint8_t *data, size_t len);
+
+#endif /* MIDI_SYSEX7_H */
@@ -0,0 +1,657 @@
+/**
+ * @file drv_spilink.c
+ * @brief SPI-LINK : 4 bus SPI maîtres en DMA, échanges lancés à la frontière de bloc audio.
+ * @ingroup drivers
+ */
+
+#include "drv_spilink.h"
+#include "drv_audio.h"
+#include "brick_config.h"
+#include <string.h>
+
+#if !STM32_SPI_USE_SPI1 || !STM32_SPI_USE_SPI2 || !STM32_SPI_USE_SPI3 || !STM32_SPI_USE_SPI6
+#error "drv_spilink : STM32_SPI_USE_SPI1/2/3/6 doivent être à TRUE dans mcuconf.h"
+#endif
+
+BRICK_STATIC_ASSERT((SPILINK_SAMPLES % 4U) == 0U, spilink_wire_groups);
+BRICK_STATIC_ASSERT((SPILINK_HDR_BYTES % 4U) == 0U, spilink_crc_words);
+BRICK_STATIC_ASSERT(SPILINK_CHANNELS == 4U, spilink_channels_match_audio_block);
+BRICK_STATIC_ASSERT(SPILINK_NUM_CARTS == BRICK_MAX_CARTRIDGES, spilink_buses_match_cart_slots);
+BRICK_STATIC_ASSERT(AUDIO_FRAMES_PER_BUFFER == BRICK_AUDIO_FRAME_SAMPLES, spilink_frame_matches_audio_block);
+
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+/* Tampons alignés sur 32 ; une invalidation couvre toujours le tampon entier. */
+static inline void spilink_dcache_clean(const void *addr, size_t bytes) {
+    SCB_CleanDCache_by_Addr((uint32_t *)(uintptr_t)addr, (int32_t)bytes);
+}
+
+static inline void spilink_dcache_invalidate(const void *addr, size_t bytes) {
+    SCB_InvalidateDCache_by_Addr((uint32_t *)(uintptr_t)addr, (int32_t)bytes);
+}
+#else
+static inline void spilink_dcache_clean(const void *addr, size_t bytes) { (void)addr; (void)bytes; }
+static inline void spilink_dcache_invalidate(const void *addr, size_t bytes) { (void)addr; (void)bytes; }
+#endif
+
+/* Sens dans un jeu de tampons. */
+#define SPILINK_TX      0U
+#define SPILINK_RX      1U
+
+/* Tampons d'un bus : [jeu][sens][octets]. */
+typedef uint8_t spilink_wire_t[2][2][SPILINK_BUFFER_BYTES];
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+static spilink_wire_t SPILINK_DMA_BUFFER_ATTR spilink_wire_d2[SPILINK_NUM_CARTS - 1U];
+static spilink_wire_t SPILINK_BDMA_BUFFER_ATTR spilink_wire_d3;
+
+typedef struct {
+    SPIDriver      *spip;
+    ioline_t        cs;
+    uint32_t        kernel_hz;
+    spilink_wire_t *wire;
+} spilink_bus_t;
+
+static const spilink_bus_t spilink_bus[SPILINK_NUM_CARTS] = {
+    {&SPID1, LINE_SPI1_CS, STM32_SPI1CLK, &spilink_wire_d2[0]},
+    {&SPID2, LINE_SPI2_CS, STM32_SPI2CLK, &spilink_wire_d2[1]},
+    {&SPID3, LINE_SPI3_CS, STM32_SPI3CLK, &spilink_wire_d2[2]},
+    {&SPID6, LINE_SPI6_CS, STM32_SPI6CLK, &spilink_wire_d3},
+};
+
+typedef struct {
+    /* Échange en cours : jeu utilisé et instant du lancement. */
+    uint8_t  xfer_set;
+    rtcnt_t  xfer_stamp;
+    uint8_t  rx_sent;             /* Bit s : échange lancé dans le jeu s. */
+    uint8_t  rx_ok;               /* Bit s : trame reçue complète dans le jeu s. */
+    bool     fault;               /* Bus en erreur, redémarré par le thread. */
+    uint32_t clock_hz;
+
+    /* Format demandé, et format de la trame préparée dans chaque jeu. */
+    spilink_format_t format;
+    spilink_format_t set_format[2];
+
+    /* Numéros de trame : émis, et dernier reçu valide. */
+    uint8_t  tx_seq;
+    uint8_t  rx_seq;
+    bool     rx_seq_valid;
+    spilink_conceal_t conceal;
+
+    /* Présence : trames valides consécutives (non relié) ou blocs perdus (relié). */
+    bool     linked;
+    uint8_t  link_count;
+
+    /* Contrôle sortant : un message en attente de trame. */
+    bool     ctrl_tx_pending;
+    uint8_t  ctrl_tx_len;
+    uint8_t  ctrl_tx[SPILINK_CTRL_PAYLOAD];
+
+    /* Contrôle entrant : file de messages, longueur en [0]. */
+    uint8_t  ctrl_rx[SPILINK_CTRL_RX_DEPTH][SPILINK_CTRL_PAYLOAD + 1U];
+    uint8_t  ctrl_rx_rd;
+    uint8_t  ctrl_rx_count;
+
+    rtcnt_t  xfer_cycles_max;
+    drv_spilink_stats_t stats;
+} spilink_cart_t;
+
+static spilink_cart_t spilink_cart[SPILINK_NUM_CARTS];
+static SPIConfig spilink_spi_cfg[SPILINK_NUM_CARTS];
+
+/* Jeu échangé par le DMA pendant le bloc courant ; le thread audio travaille sur l'autre. */
+static uint8_t spilink_active = 0U;
+static uint8_t spilink_work_set = 1U;
+static uint32_t spilink_block_count = 0U;
+static drv_spilink_link_cb_t spilink_link_cb = NULL;
+static drv_spilink_ctrl_fill_cb_t spilink_ctrl_fill_cb = NULL;
+static drv_spilink_ctrl_idle_cb_t spilink_ctrl_idle_cb = NULL;
+static bool spilink_running = false;
+static bool spilink_initialized = false;
+
+static binary_semaphore_t spilink_fault_sem;
+static THD_WORKING_AREA(spilinkThreadWA, SPILINK_THREAD_STACK_SIZE);
+
+/* -------------------------------------------------------------------------- */
+/* CRC                                                                        */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Unité CRC du H7 (AHB4), réservée au SPI-LINK et utilisée par le seul
+ * thread audio. Registre CR remis à zéro : polynôme 32 bits, sans réflexion.
+ */
+static void spilink_crc_init(void) {
+    rccEnableCRC(true);
+    CRC->INIT = 0xFFFFFFFFU;
+    CRC->POL = 0x04C11DB7U;
+    CRC->CR = CRC_CR_RESET;
+}
+
+/* CRC-32/MPEG-2 de `len` octets (multiple de 4), dans l'ordre du fil. */
+static uint32_t spilink_crc32(const uint8_t *data, size_t len) {
+    const uint32_t *w = (const uint32_t *)(const void *)data;
+
+    CRC->CR = CRC_CR_RESET;
+    for (size_t i = 0U; i < (len / 4U); ++i) {
+        CRC->DR = __REV(w[i]);
+    }
+    return CRC->DR;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ISR : frontière de bloc et fin d'échange                                   */
+/* -------------------------------------------------------------------------- */
+
+static uint8_t spilink_cart_of(const SPIDriver *spip) {
+    uint8_t c = 0U;
+    while ((c < (SPILINK_NUM_CARTS - 1U)) && (spilink_bus[c].spip != spip)) {
+        c++;
+    }
+    return c;
+}
+
+/* Hook drv_audio, sous verrou dans l'ISR DMA SAI : lance les quatre échanges. */
+static void spilink_block_isr(void) {
+    if (!spilink_running) {
+        return;
+    }
+
+    const uint8_t set = (uint8_t)(spilink_active ^ 1U);
+    spilink_active = set;
+    const rtcnt_t now = chSysGetRealtimeCounterX();
+    spilink_block_count++;
+
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        const spilink_bus_t *bus = &spilink_bus[c];
+        spilink_cart_t *ct = &spilink_cart[c];
+
+        ct->rx_sent &= (uint8_t)~(1U << set);
+        ct->rx_ok &= (uint8_t)~(1U << set);
+        if (ct->fault) {
+            continue;
+        }
+        /* Bus vide : une sonde par période, puis chaque bloc tant qu'elle répond. */
+        if (!ct->linked && (ct->link_count == 0U) &&
+            (((spilink_block_count + c) % SPILINK_PROBE_BLOCKS) != 0U)) {
+            continue;
+        }
+        if (bus->spip->state != SPI_READY) {
+            /* Échange du bloc précédent inachevé : abandonné, trame perdue. */
+            (void)spiStopTransferI(bus->spip, NULL);
+            spiUnselectI(bus->spip);
+            ct->stats.overruns++;
+        }
+
+        ct->rx_sent |= (uint8_t)(1U << set);
+        ct->xfer_set = set;
+        ct->xfer_stamp = now;
+        spiSelectI(bus->spip);
+        (void)spiStartExchangeI(bus->spip, spilink_frame_bytes(ct->set_format[set]),
+                                (*bus->wire)[set][SPILINK_TX],
+                                (*bus->wire)[set][SPILINK_RX]);
+    }
+}
+
+static void spilink_xfer_done_cb(SPIDriver *spip) {
+    chSysLockFromISR();
+    spilink_cart_t *ct = &spilink_cart[spilink_cart_of(spip)];
+    spiUnselectI(spip);
+    ct->rx_ok |= (uint8_t)(1U << ct->xfer_set);
+    ct->stats.frames++;
+
+    const rtcnt_t cycles = (rtcnt_t)(chSysGetRealtimeCounterX() - ct->xfer_stamp);
+    if (cycles > ct->xfer_cycles_max) {
+        ct->xfer_cycles_max = cycles;
+    }
+    chSysUnlockFromISR();
+}
+
+/* Le LLD a déjà réinitialisé le périphérique : le thread le redémarre. */
+static void spilink_xfer_error_cb(SPIDriver *spip) {
+    chSysLockFromISR();
+    spilink_cart_t *ct = &spilink_cart[spilink_cart_of(spip)];
+    spiUnselectI(spip);
+    ct->fault = true;
+    ct->stats.errors++;
+    chBSemSignalI(&spilink_fault_sem);
+    chSysUnlockFromISR();
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread audio : pull / push                                                 */
+/* -------------------------------------------------------------------------- */
+
+static void spilink_ctrl_rx_put(spilink_cart_t *ct, const uint8_t *hdr) {
+    const uint8_t len = hdr[SPILINK_HDR_CTRL_LEN];
+
+    if (len == 0U) {
+        return;
+    }
+
+    chSysLock();
+    if ((len > SPILINK_CTRL_PAYLOAD) || (ct->ctrl_rx_count >= SPILINK_CTRL_RX_DEPTH)) {
+        ct->stats.ctrl_dropped++;
+    } else {
+        uint8_t *msg = ct->ctrl_rx[(ct->ctrl_rx_rd + ct->ctrl_rx_count) % SPILINK_CTRL_RX_DEPTH];
+        msg[0] = len;
+        memcpy(&msg[1], &hdr[SPILINK_HDR_CTRL], len);
+        ct->ctrl_rx_count++;
+        ct->stats.ctrl_rx++;
+    }
+    chSysUnlock();
+}
+
+/* Message en attente d'abord ; sinon le champ est offert au remplissage, puis au trafic de fond. */
+static void spilink_ctrl_tx_take(uint8_t cart, spilink_cart_t *ct, uint8_t *hdr) {
+    chSysLock();
+    const bool pending = ct->ctrl_tx_pending;
+    if (pending) {
+        hdr[SPILINK_HDR_CTRL_LEN] = ct->ctrl_tx_len;
+        memcpy(&hdr[SPILINK_HDR_CTRL], ct->ctrl_tx, SPILINK_CTRL_PAYLOAD);
+        ct->ctrl_tx_pending = false;
+        ct->stats.ctrl_tx++;
+    }
+    const drv_spilink_ctrl_fill_cb_t fill = ct->linked ? spilink_ctrl_fill_cb : NULL;
+    const drv_spilink_ctrl_idle_cb_t idle = ct->linked ? spilink_ctrl_idle_cb : NULL;
+    chSysUnlock();
+    if (pending) {
+        return;
+    }
+
+    size_t len = 0U;
+    if (fill != NULL) {
+        len = fill(cart, &hdr[SPILINK_HDR_CTRL], SPILINK_CTRL_PAYLOAD);
+    }
+    if ((len == 0U) && (idle != NULL)) {
+        len = idle(cart, &hdr[SPILINK_HDR_CTRL], SPILINK_CTRL_PAYLOAD);
+    }
+    if (len > SPILINK_CTRL_PAYLOAD) {
+        len = 0U;
+    }
+    hdr[SPILINK_HDR_CTRL_LEN] = (uint8_t)len;
+    if (len > 0U) {
+        chSysLock();
+        ct->stats.ctrl_tx++;
+        chSysUnlock();
+    }
+}
+
+/*
+ * Vérifie une trame reçue complète : CRC puis numéro. true si son audio est
+ * neuf et peut être joué.
+ */
+static bool spilink_rx_check(spilink_cart_t *ct, const uint8_t *rx, spilink_format_t fmt) {
+    const size_t n = spilink_frame_bytes(fmt) - SPILINK_CRC_BYTES;
+    const uint32_t crc = spilink_frame_get_crc(&rx[n]);
+    bool fresh = false;
+    uint32_t gap = 0U;
+
+    const bool crc_ok = (spilink_crc32(rx, n) == crc);
+    const uint8_t seq = rx[SPILINK_HDR_SEQ];
+    if (crc_ok && (!ct->rx_seq_valid || (seq != ct->rx_seq))) {
+        if (ct->rx_seq_valid) {
+            gap = (uint8_t)(seq - ct->rx_seq - 1U);
+        }
+        ct->rx_seq = seq;
+        ct->rx_seq_valid = true;
+        fresh = true;
+    }
+
+    if (!ct->linked) {
+        return fresh;
+    }
+    chSysLock();
+    if (!crc_ok) {
+        ct->stats.crc_errors++;
+    } else if (!fresh) {
+        ct->stats.repeats++;
+    } else {
+        ct->stats.seq_gaps += gap;
+    }
+    chSysUnlock();
+    return fresh;
+}
+
+/*
+ * Suivi de présence d'après la trame du bloc (`sent` : un échange a eu lieu).
+ * Retourne true si l'état relié a changé.
+ */
+static bool spilink_link_update(spilink_cart_t *ct, bool sent, bool fresh) {
+    bool changed = false;
+
+    chSysLock();
+    if (!ct->linked) {
+        if (sent) {
+            ct->link_count = fresh ? (uint8_t)(ct->link_count + 1U) : 0U;
+            if (ct->link_count >= SPILINK_LINK_UP_FRAMES) {
+                ct->linked = true;
+                ct->link_count = 0U;
+                ct->stats.link_ups++;
+                changed = true;
+            }
+        }
+    } else if (fresh) {
+        ct->link_count = 0U;
+    } else if (++ct->link_count >= SPILINK_LINK_DOWN_BLOCKS) {
+        /* Cartouche perdue : rien de son contrôle ne doit survivre à un échange. */
+        ct->linked = false;
+        ct->link_count = 0U;
+        ct->ctrl_tx_pending = false;
+        ct->ctrl_rx_count = 0U;
+        ct->stats.link_downs++;
+        changed = true;
+    }
+    chSysUnlock();
+
+    if (changed && !ct->linked) {
+        ct->rx_seq_valid = false;
+        spilink_conceal_reset(&ct->conceal);
+    }
+    return changed;
+}
+
+/* Trames reçues au bloc précédent ; masquage des trames absentes ou invalides. */
+static void spilink_pull(spilink_audio_block_t dest, size_t frames) {
+    chSysLock();
+    const uint8_t set = (uint8_t)(spilink_active ^ 1U);
+    spilink_work_set = set;
+    uint8_t ok = 0U;
+    uint8_t sent = 0U;
+    spilink_format_t fmt[SPILINK_NUM_CARTS];
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        spilink_cart_t *ct = &spilink_cart[c];
+        fmt[c] = ct->set_format[set];
+        if ((ct->rx_ok & (1U << set)) != 0U) {
+            ok |= (uint8_t)(1U << c);
+        }
+        if ((ct->rx_sent & (1U << set)) != 0U) {
+            sent |= (uint8_t)(1U << c);
+        }
+        ct->rx_ok &= (uint8_t)~(1U << set);
+        ct->rx_sent &= (uint8_t)~(1U << set);
+    }
+    const drv_spilink_link_cb_t link_cb = spilink_link_cb;
+    chSysUnlock();
+
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        spilink_cart_t *ct = &spilink_cart[c];
+        const uint8_t *rx = (*spilink_bus[c].wire)[set][SPILINK_RX];
+        const bool was_linked = ct->linked;
+        bool fresh = false;
+
+        if ((ok & (1U << c)) != 0U) {
+            spilink_dcache_invalidate(rx, SPILINK_BUFFER_BYTES);
+            fresh = spilink_rx_check(ct, rx, fmt[c]);
+        }
+
+        if (fresh && was_linked) {
+            spilink_ctrl_rx_put(ct, rx);
+            (void)spilink_wire_unpack(fmt[c], &dest[c][0][0], &rx[SPILINK_HDR_BYTES],
+                                      frames * SPILINK_CHANNELS);
+            spilink_conceal_good(&ct->conceal, dest[c], frames);
+        } else if (was_linked) {
+            spilink_conceal_lost(&ct->conceal, dest[c], frames);
+            chSysLock();
+            ct->stats.concealed++;
+            chSysUnlock();
+        } else {
+            memset(dest[c], 0, sizeof(dest[c]));
+        }
+
+        if (spilink_link_update(ct, (sent & (1U << c)) != 0U, fresh) && (link_cb != NULL)) {
+            link_cb(c, ct->linked);
+        }
+    }
+}
+
+/* Trames du bloc suivant, dans le jeu libéré par pull. */
+static void spilink_push(const spilink_audio_block_t src, size_t frames) {
+    chSysLock();
+    const uint8_t set = spilink_work_set;
+    const bool late = (spilink_active == set);
+    spilink_format_t fmt[SPILINK_NUM_CARTS];
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        if (late) {
+            spilink_cart[c].stats.late++;
+        } else {
+            spilink_cart[c].set_format[set] = spilink_cart[c].format;
+        }
+        fmt[c] = spilink_cart[c].format;
+    }
+    chSysUnlock();
+    if (late) {
+        return;     /* Le DMA a déjà repris ce jeu : la trame précédente repart. */
+    }
+
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        spilink_cart_t *ct = &spilink_cart[c];
+        uint8_t *tx = (*spilink_bus[c].wire)[set][SPILINK_TX];
+
+        tx[SPILINK_HDR_SEQ] = ct->tx_seq++;
+        spilink_ctrl_tx_take(c, ct, tx);
+        const size_t n = SPILINK_HDR_BYTES +
+                         spilink_wire_pack(fmt[c], &tx[SPILINK_HDR_BYTES], &src[c][0][0],
+                                           frames * SPILINK_CHANNELS);
+        spilink_frame_put_crc(&tx[n], spilink_crc32(tx, n));
+        spilink_dcache_clean(tx, n + SPILINK_CRC_BYTES);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread de service : redémarrage des bus en défaut                          */
+/* -------------------------------------------------------------------------- */
+
+static THD_FUNCTION(spilinkThread, arg) {
+    (void)arg;
+    chRegSetThreadName("spilink");
+
+    while (true) {
+        chBSemWait(&spilink_fault_sem);
+
+        for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+            SPIDriver *spip = spilink_bus[c].spip;
+
+            chSysLock();
+            const bool fault = spilink_cart[c].fault;
+            if (fault) {
+                (void)spiStopTransferI(spip, NULL);
+            }
+            chSysUnlock();
+            if (!fault) {
+                continue;
+            }
+
+            spiStop(spip);
+            (void)spiStart(spip, &spilink_spi_cfg[c]);
+
+            chSysLock();
+            spilink_cart[c].fault = false;
+            chSysUnlock();
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void drv_spilink_init(void) {
+    if (spilink_initialized) {
+        return;
+    }
+
+    memset(spilink_cart, 0, sizeof(spilink_cart));
+    memset(spilink_wire_d2, 0, sizeof(spilink_wire_d2));
+    memset(spilink_wire_d3, 0, sizeof(spilink_wire_d3));
+    spilink_dcache_clean(spilink_wire_d3, sizeof(spilink_wire_d3));
+    chBSemObjectInit(&spilink_fault_sem, true);
+    spilink_crc_init();
+
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        const spilink_bus_t *bus = &spilink_bus[c];
+        SPIConfig *cfg = &spilink_spi_cfg[c];
+
+        /* Plus petit prescaler (2^(MBR+1)) ne dépassant pas SPILINK_CLOCK_HZ. */
+        uint32_t mbr = 0U;
+        while ((mbr < 7U) && ((bus->kernel_hz >> (mbr + 1U)) > SPILINK_CLOCK_HZ)) {
+            mbr++;
+        }
+        spilink_cart[c].clock_hz = bus->kernel_hz >> (mbr + 1U);
+        spilink_cart[c].format = SPILINK_DEFAULT_FORMAT;
+        spilink_cart[c].set_format[0] = SPILINK_DEFAULT_FORMAT;
+        spilink_cart[c].set_format[1] = SPILINK_DEFAULT_FORMAT;
+        spilink_conceal_reset(&spilink_cart[c].conceal);
+
+        memset(cfg, 0, sizeof(*cfg));
+        cfg->circular = false;
+        cfg->slave = false;
+        cfg->data_cb = spilink_xfer_done_cb;
+        cfg->error_cb = spilink_xfer_error_cb;
+        cfg->ssport = PAL_PORT(bus->cs);
+        cfg->sspad = PAL_PAD(bus->cs);
+        cfg->cfg1 = SPI_CFG1_MBR_VALUE(mbr) | SPI_CFG1_DSIZE_VALUE(7U);   /* Octets, mode 0. */
+        cfg->cfg2 = 0U;
+
+        palSetLine(bus->cs);
+    }
+
+    chThdCreateStatic(spilinkThreadWA, sizeof(spilinkThreadWA),
+                      SPILINK_THREAD_PRIORITY, spilinkThread, NULL);
+
+    spilink_initialized = true;
+}
+
+void drv_spilink_start(void) {
+    if (!spilink_initialized || spilink_running) {
+        return;
+    }
+
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        (void)spiStart(spilink_bus[c].spip, &spilink_spi_cfg[c]);
+    }
+
+    drv_audio_register_spilink_pull(spilink_pull);
+    drv_audio_register_spilink_push(spilink_push);
+
+    chSysLock();
+    spilink_running = true;
+    chSysUnlock();
+    drv_audio_register_block_isr_cb(spilink_block_isr);
+}
+
+void drv_spilink_set_link_cb(drv_spilink_link_cb_t cb) {
+    chSysLock();
+    spilink_link_cb = cb;
+    chSysUnlock();
+}
+
+void drv_spilink_set_ctrl_fill_cb(drv_spilink_ctrl_fill_cb_t cb) {
+    chSysLock();
+    spilink_ctrl_fill_cb = cb;
+    chSysUnlock();
+}
+
+void drv_spilink_set_ctrl_idle_cb(drv_spilink_ctrl_idle_cb_t cb) {
+    chSysLock();
+    spilink_ctrl_idle_cb = cb;
+    chSysUnlock();
+}
+
+bool drv_spilink_is_linked(uint8_t cart) {
+    return (cart < SPILINK_NUM_CARTS) && spilink_cart[cart].linked;
+}
+
+void drv_spilink_get_link(uint8_t cart, spilink_link_state_t *st) {
+    if ((cart >= SPILINK_NUM_CARTS) || (st == NULL)) {
+        return;
+    }
+    chSysLock();
+    st->linked = spilink_cart[cart].linked;
+    st->link_ups = spilink_cart[cart].stats.link_ups;
+    chSysUnlock();
+}
+
+bool drv_spilink_ctrl_send(uint8_t cart, const uint8_t *data, size_t len) {
+    bool ok = false;
+
+    if ((cart >= SPILINK_NUM_CARTS) || (data == NULL) || (len == 0U) ||
+        (len > SPILINK_CTRL_PAYLOAD)) {
+        return false;
+    }
+
+    spilink_cart_t *ct = &spilink_cart[cart];
+    chSysLock();
+    if (ct->linked && !ct->ctrl_tx_pending) {
+        ct->ctrl_tx_len = (uint8_t)len;
+        memcpy(ct->ctrl_tx, data, len);
+        memset(&ct->ctrl_tx[len], 0, SPILINK_CTRL_PAYLOAD - len);
+        ct->ctrl_tx_pending = true;
+        ok = true;
+    }
+    chSysUnlock();
+    return ok;
+}
+
+size_t drv_spilink_ctrl_recv(uint8_t cart, uint8_t *data) {
+    size_t len = 0U;
+
+    if ((cart >= SPILINK_NUM_CARTS) || (data == NULL)) {
+        return 0U;
+    }
+
+    spilink_cart_t *ct = &spilink_cart[cart];
+    chSysLock();
+    if (ct->ctrl_rx_count > 0U) {
+        const uint8_t *msg = ct->ctrl_rx[ct->ctrl_rx_rd];
+        len = msg[0];
+        memcpy(data, &msg[1], len);
+        ct->ctrl_rx_rd = (uint8_t)((ct->ctrl_rx_rd + 1U) % SPILINK_CTRL_RX_DEPTH);
+        ct->ctrl_rx_count--;
+    }
+    chSysUnlock();
+    return len;
+}
+
+bool drv_spilink_set_format(uint8_t cart, spilink_format_t fmt) {
+    if ((cart >= SPILINK_NUM_CARTS) || (fmt >= SPILINK_FORMAT_COUNT)) {
+        return false;
+    }
+    chSysLock();
+    spilink_cart[cart].format = fmt;
+    chSysUnlock();
+    return true;
+}
+
+spilink_format_t drv_spilink_get_format(uint8_t cart) {
+    return (cart < SPILINK_NUM_CARTS) ? spilink_cart[cart].format : SPILINK_DEFAULT_FORMAT;
+}
+
+uint32_t drv_spilink_get_clock_hz(uint8_t cart) {
+    return (cart < SPILINK_NUM_CARTS) ? spilink_cart[cart].clock_hz : 0U;
+}
+
+void drv_spilink_get_stats(uint8_t cart, drv_spilink_stats_t *st) {
+    if ((cart >= SPILINK_NUM_CARTS) || (st == NULL)) {
+        return;
+    }
+    chSysLock();
+    *st = spilink_cart[cart].stats;
+    const rtcnt_t cycles = spilink_cart[cart].xfer_cycles_max;
+    const spilink_format_t fmt = spilink_cart[cart].format;
+    st->linked = spilink_cart[cart].linked;
+    chSysUnlock();
+
+    const uint32_t bytes = (uint32_t)spilink_frame_bytes(fmt);
+    const uint32_t clock = spilink_cart[cart].clock_hz;
+    st->xfer_us_max = (uint32_t)(((uint64_t)cycles * 1000000U) / STM32_CORE_CK);
+    st->frame_bytes = (uint16_t)bytes;
+    st->load_pct = (uint8_t)((clock != 0U) ?
+                             (((uint64_t)bytes * 8U * SPILINK_BLOCKS_PER_S * 100U) / clock) : 100U);
+}
+
+const spilink_link_ops_t drv_spilink_link_ops = {
+    drv_spilink_ctrl_send, drv_spilink_ctrl_recv, drv_spilink_get_link,
+    drv_spilink_set_link_cb, drv_spilink_set_ctrl_fill_cb, drv_spilink_set_ctrl_idle_cb
+};
@@ -0,0 +1,171 @@
+/**
+ * @file drv_spilink.h
+ * @brief Transport SPI-LINK : échange audio + contrôle avec les 4 cartouches.
+ * @details Une cartouche par bus (SPI1, SPI2, SPI3, SPI6, voir board.h), le
+ * H7 maître. À chaque frontière de bloc audio, dans l'ISR DMA du SAI qui
+ * complète le demi-tampon, les quatre échanges DMA sont lancés ensemble :
+ * chaque cartouche reçoit et renvoie une trame d'au plus SPILINK_FRAME_BYTES
+ * octets (contrôle puis 4 canaux × AUDIO_FRAMES_PER_BUFFER échantillons). Les
+ * transferts se déroulent pendant le DSP du bloc, jamais dans le thread
+ * audio.
+ *
+ * Double tampon par bus : pendant le bloc n, le DMA échange le jeu n & 1 ;
+ * le thread audio lit la trame reçue au bloc n - 1 (pull) et prépare dans
+ * l'autre jeu celle qui partira au bloc n + 1 (push). Latence : un bloc dans
+ * chaque sens (~333 µs). Un échange encore en cours à la frontière suivante
+ * est interrompu (overrun).
+ *
+ * Trame : numéro, message de contrôle, échantillons au format du bus
+ * (spilink_wire : 24 bits serrés par défaut, 16 bits pour une cartouche à
+ * faible débit) et CRC-32/MPEG-2, voir spilink_frame.h ; le CRC est calculé
+ * par l'unité CRC matérielle du H7.
+ *
+ * Intégrité : une trame reçue au CRC faux, inachevée ou portant le même
+ * numéro que la précédente (cartouche qui n'a pas rafraîchi son tampon) est
+ * masquée par spilink_conceal (maintien du dernier échantillon et fondu) ;
+ * un saut de numéro compte les trames manquantes. Compteurs par cartouche
+ * dans drv_spilink_stats_t.
+ *
+ * Présence : un bus est « relié » après SPILINK_LINK_UP_FRAMES trames
+ * valides consécutives, et perdu après SPILINK_LINK_DOWN_BLOCKS blocs sans
+ * trame neuve (le masquage a alors fini son fondu). Un bus non relié n'est
+ * sondé qu'un bloc sur SPILINK_PROBE_BLOCKS (sondes décalées d'un bus à
+ * l'autre), puis à chaque bloc dès qu'une sonde répond ; son entrée est
+ * silencieuse et ses erreurs ne sont pas comptées ; ses files de contrôle
+ * sont vidées à la perte. Les changements sont
+ * signalés par drv_spilink_set_link_cb depuis le thread audio ; les autres
+ * bus et le flux SAI n'en sont pas affectés.
+ *
+ * Contrôle et présence sont aussi exposés par drv_spilink_link_ops
+ * (spilink_link.h), la table que reçoivent les modules cartouche.
+ *
+ * Occupation d'un bloc de 333 µs à 12,5 MHz (octets par trame, part du bloc) :
+ *  - int32_t bruts         : 292 octets, 56 % ;
+ *  - SPILINK_FORMAT_S24    : 228 octets, 44 % ;
+ *  - SPILINK_FORMAT_S16    : 164 octets, 31 %.
+ * La marge mesurée (pire durée d'échange) est publiée dans les stats.
+ *
+ * Les tampons de SPI1..3 sont en .ram_d2 ; SPI6 est servi par le BDMA, qui
+ * n'atteint que la RAM D3 : ses tampons sont en .ram4 (cacheable, nettoyés /
+ * invalidés à chaque bloc). STM32_SPI_USE_SPI1/2/3/6 doivent être à TRUE ;
+ * leurs streams sont fixés dans mcuconf.h hors de DMA1 0..3 (SAI, MIDI).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef DRV_SPILINK_H
+#define DRV_SPILINK_H
+
+#include "ch.h"
+#include "hal.h"
+#include "audio_conf.h"
+#include "spilink_frame.h"
+#include "spilink_conceal.h"
+#include "spilink_link.h"
+
+/* -------------------------------------------------------------------------- */
+/* Configuration                                                              */
+/* -------------------------------------------------------------------------- */
+
+#define SPILINK_NUM_CARTS             4U
+#define SPILINK_BLOCKS_PER_S          (AUDIO_SAMPLE_RATE_HZ / AUDIO_FRAMES_PER_BUFFER)
+#define SPILINK_DEFAULT_FORMAT        SPILINK_FORMAT_S24
+
+/**
+ * Horloge SPI visée ; le prescaler retenu donne la plus proche par défaut
+ * (SPI123 : PLL1_Q 50 MHz / 4, SPI6 : PCLK4 100 MHz / 8 = 12,5 MHz).
+ */
+#define SPILINK_CLOCK_HZ              12500000U
+
+/**
+ * Sondage d'un bus non relié (voir plus haut) : ~10,7 ms entre sondes ;
+ * SPILINK_LINK_UP_FRAMES et SPILINK_LINK_DOWN_BLOCKS (~16 ms de perte) dans
+ * spilink_link.h.
+ */
+#define SPILINK_PROBE_BLOCKS          32U
+
+/** Messages de contrôle reçus en attente, par cartouche. */
+#define SPILINK_CTRL_RX_DEPTH         4U
+
+#define SPILINK_THREAD_STACK_SIZE     512U
+#define SPILINK_THREAD_PRIORITY       (NORMALPRIO + 10)
+
+#define SPILINK_DMA_BUFFER_ATTR       __attribute__((section(".ram_d2"), aligned(32)))
+#define SPILINK_BDMA_BUFFER_ATTR      __attribute__((section(".ram4"), aligned(32)))
+
+typedef struct {
+    uint32_t frames;          /* Échanges complets. */
+    uint32_t overruns;        /* Échange encore en cours à la frontière de bloc. */
+    uint32_t errors;          /* Erreurs SPI / DMA (bus redémarré). */
+    uint32_t late;            /* Push hors délai (thread audio en retard). */
+    uint32_t crc_errors;      /* Trames reçues au CRC faux. */
+    uint32_t seq_gaps;        /* Trames manquantes d'après les numéros reçus. */
+    uint32_t repeats;         /* Trames reçues avec le numéro précédent. */
+    uint32_t concealed;       /* Blocs masqués (toutes causes). */
+    uint32_t ctrl_tx;
+    uint32_t ctrl_rx;
+    uint32_t ctrl_dropped;    /* Messages reçus perdus, file pleine ou longueur invalide. */
+    uint32_t link_ups;        /* Cartouche détectée. */
+    uint32_t link_downs;      /* Cartouche perdue (retrait ou silence). */
+    uint32_t xfer_us_max;     /* Pire durée d'échange, sélection comprise. */
+    uint16_t frame_bytes;     /* Trame au format courant. */
+    uint8_t  load_pct;        /* Part théorique du bloc occupée par la trame. */
+    bool     linked;
+} drv_spilink_stats_t;
+
+/* Changement de présence, appelé depuis le thread audio : ne pas bloquer. */
+typedef spilink_link_cb_t drv_spilink_link_cb_t;
+
+/*
+ * Remplissage du champ de contrôle d'une trame sans message en attente, au
+ * push (thread audio) d'un bus relié : écrit au plus `max` octets, retourne
+ * la longueur (0 : aucun message).
+ */
+typedef spilink_ctrl_fill_cb_t drv_spilink_ctrl_fill_cb_t;
+
+/*
+ * Même forme, appelé en dernier : seulement si ni message en attente ni
+ * remplissage n'occupent le champ (trafic de fond, transferts de masse).
+ */
+typedef drv_spilink_ctrl_fill_cb_t drv_spilink_ctrl_idle_cb_t;
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+/* Démarre les bus et s'accroche à drv_audio (pull / push, frontière de bloc). */
+void drv_spilink_init(void);
+void drv_spilink_start(void);
+
+void drv_spilink_set_link_cb(drv_spilink_link_cb_t cb);
+void drv_spilink_set_ctrl_fill_cb(drv_spilink_ctrl_fill_cb_t cb);
+void drv_spilink_set_ctrl_idle_cb(drv_spilink_ctrl_idle_cb_t cb);
+bool drv_spilink_is_linked(uint8_t cart);
+void drv_spilink_get_link(uint8_t cart, spilink_link_state_t *st);
+
+/*
+ * Message de contrôle vers une cartouche, émis dans la prochaine trame ;
+ * false si le bus n'est pas relié, si un message attend déjà ou si `len`
+ * dépasse SPILINK_CTRL_PAYLOAD.
+ */
+bool drv_spilink_ctrl_send(uint8_t cart, const uint8_t *data, size_t len);
+
+/* Plus ancien message reçu (au plus SPILINK_CTRL_PAYLOAD octets) ; 0 si aucun. */
+size_t drv_spilink_ctrl_recv(uint8_t cart, uint8_t *data);
+
+/*
+ * Format audio du bus, appliqué à la prochaine trame préparée ; la cartouche
+ * doit répondre dans le même format.
+ */
+bool drv_spilink_set_format(uint8_t cart, spilink_format_t fmt);
+spilink_format_t drv_spilink_get_format(uint8_t cart);
+
+/* Horloge effective du bus (Hz). */
+uint32_t drv_spilink_get_clock_hz(uint8_t cart);
+
+void drv_spilink_get_stats(uint8_t cart, drv_spilink_stats_t *st);
+
+/* Contrôle et présence pour cart_manager, cart_params et cart_bulk. */
+extern const spilink_link_ops_t drv_spilink_link_ops;
+
+#endif /* DRV_SPILINK_H */
@@ -0,0 +1,61 @@
+/**
+ * @file spilink_conceal.c
+ * @brief Maintien du dernier échantillon avec fondu de sortie, fondu d'entrée au retour.
+ * @ingroup drivers
+ */
+
+#include "spilink_conceal.h"
+
+#define CONCEAL_FADE_STEP   (SPILINK_CONCEAL_UNITY / (int32_t)SPILINK_CONCEAL_FADE_FRAMES)
+
+static inline int32_t conceal_scale(int32_t x, int32_t gain) {
+    return (int32_t)(((int64_t)x * gain) >> 15);
+}
+
+void spilink_conceal_reset(spilink_conceal_t *cc) {
+    for (size_t ch = 0U; ch < SPILINK_CONCEAL_CHANNELS; ++ch) {
+        cc->hold[ch] = 0;
+    }
+    /* Départ du silence : la première trame valide est fondue. */
+    cc->gain = 0;
+    cc->active = true;
+}
+
+void spilink_conceal_good(spilink_conceal_t *cc, int32_t (*blk)[SPILINK_CONCEAL_CHANNELS],
+                          size_t frames) {
+    if (frames == 0U) {
+        return;
+    }
+
+    if (cc->active) {
+        /* Fondu enchaîné du maintien atténué vers le signal sur le bloc. */
+        int32_t base[SPILINK_CONCEAL_CHANNELS];
+        for (size_t ch = 0U; ch < SPILINK_CONCEAL_CHANNELS; ++ch) {
+            base[ch] = conceal_scale(cc->hold[ch], cc->gain);
+        }
+        for (size_t n = 0U; n < frames; ++n) {
+            const int32_t w = (int32_t)(((uint32_t)(n + 1U) * SPILINK_CONCEAL_UNITY) / frames);
+            for (size_t ch = 0U; ch < SPILINK_CONCEAL_CHANNELS; ++ch) {
+                blk[n][ch] = base[ch] + conceal_scale(blk[n][ch] - base[ch], w);
+            }
+        }
+        cc->active = false;
+    }
+
+    for (size_t ch = 0U; ch < SPILINK_CONCEAL_CHANNELS; ++ch) {
+        cc->hold[ch] = blk[frames - 1U][ch];
+    }
+    cc->gain = SPILINK_CONCEAL_UNITY;
+}
+
+void spilink_conceal_lost(spilink_conceal_t *cc, int32_t (*blk)[SPILINK_CONCEAL_CHANNELS],
+                          size_t frames) {
+    cc->active = true;
+
+    for (size_t n = 0U; n < frames; ++n) {
+        cc->gain = (cc->gain > CONCEAL_FADE_STEP) ? (cc->gain - CONCEAL_FADE_STEP) : 0;
+        for (size_t ch = 0U; ch < SPILINK_CONCEAL_CHANNELS; ++ch) {
+            blk[n][ch] = conceal_scale(cc->hold[ch], cc->gain);
+        }
+    }
+}
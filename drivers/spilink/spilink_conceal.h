@@ -0,0 +1,44 @@
+/**
+ * @file spilink_conceal.h
+ * @brief Masquage des trames SPI-LINK perdues : maintien et fondus.
+ * @details Une trame perdue (CRC faux, échange inachevé, numéro répété) est
+ * remplacée par le dernier échantillon reçu de chaque canal, atténué
+ * linéairement jusqu'au silence en SPILINK_CONCEAL_FADE_FRAMES frames. La
+ * première trame valide qui suit est fondue depuis ce niveau sur la durée
+ * du bloc. Une coupure de connecteur donne ainsi un creux bref au lieu d'un
+ * saut à pleine échelle dans le mix.
+ *
+ * Arithmétique entière (gain Q15), module sans dépendance à ChibiOS
+ * (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef SPILINK_CONCEAL_H
+#define SPILINK_CONCEAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPILINK_CONCEAL_CHANNELS      4U
+#define SPILINK_CONCEAL_FADE_FRAMES   64U     /* ~1,3 ms à 48 kHz. */
+#define SPILINK_CONCEAL_UNITY         32768
+
+typedef struct {
+    int32_t hold[SPILINK_CONCEAL_CHANNELS];   /* Dernier échantillon valide. */
+    int32_t gain;                             /* Q15, niveau du maintien. */
+    bool    active;                           /* Perte en cours. */
+} spilink_conceal_t;
+
+void spilink_conceal_reset(spilink_conceal_t *cc);
+
+/* Bloc valide, en place : fondu d'entrée après une perte, puis mémorisation. */
+void spilink_conceal_good(spilink_conceal_t *cc, int32_t (*blk)[SPILINK_CONCEAL_CHANNELS],
+                          size_t frames);
+
+/* Bloc perdu : écrit le maintien atténué dans `blk`. */
+void spilink_conceal_lost(spilink_conceal_t *cc, int32_t (*blk)[SPILINK_CONCEAL_CHANNELS],
+                          size_t frames);
+
+#endif /* SPILINK_CONCEAL_H */
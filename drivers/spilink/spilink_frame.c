@@ -0,0 +1,28 @@
+/**
+ * @file spilink_frame.c
+ * @brief CRC-32/MPEG-2 logiciel, par quartets.
+ * @ingroup drivers
+ */
+
+#include "spilink_frame.h"
+
+/* Restes des 16 quartets pour le polynôme 0x04C11DB7, non réfléchi. */
+static const uint32_t frame_crc_nibble[16] = {
+    0x00000000U, 0x04C11DB7U, 0x09823B6EU, 0x0D4326D9U,
+    0x130476DCU, 0x17C56B6BU, 0x1A864DB2U, 0x1E475005U,
+    0x2608EDB8U, 0x22C9F00FU, 0x2F8AD6D6U, 0x2B4BCB61U,
+    0x350C9B64U, 0x31CD86D3U, 0x3C8EA00AU, 0x384FBDBDU,
+};
+
+uint32_t spilink_frame_crc_sw_update(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0U; i < len; ++i) {
+        crc ^= (uint32_t)data[i] << 24;
+        crc = (crc << 4) ^ frame_crc_nibble[crc >> 28];
+        crc = (crc << 4) ^ frame_crc_nibble[crc >> 28];
+    }
+    return crc;
+}
+
+uint32_t spilink_frame_crc_sw(const uint8_t *data, size_t len) {
+    return spilink_frame_crc_sw_update(SPILINK_FRAME_CRC_INIT, data, len);
+}
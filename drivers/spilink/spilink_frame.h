@@ -0,0 +1,68 @@
+/**
+ * @file spilink_frame.h
+ * @brief Disposition d'une trame SPI-LINK et CRC de référence.
+ * @details Trame (octets, ordre du fil) :
+ *  - [0] numéro de trame (modulo 256, propre à chaque sens) ;
+ *  - [1] longueur du message de contrôle (0 : aucun), [2..31] message ;
+ *  - les échantillons [frame][canal] au format du bus (spilink_wire) ;
+ *  - CRC-32 gros-boutiste de tout ce qui précède (polynôme 0x04C11DB7, init
+ *    0xFFFFFFFF, sans réflexion ni XOR final : CRC-32/MPEG-2).
+ *
+ * spilink_frame_crc_sw calcule le même CRC en logiciel (table de 16
+ * entrées) : la cible utilise l'unité CRC matérielle, l'émulateur de
+ * cartouche et les outils hôte celui-ci.
+ *
+ * Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef SPILINK_FRAME_H
+#define SPILINK_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "brick_config.h"
+#include "spilink_wire.h"
+
+#define SPILINK_CHANNELS              4U
+
+/* En-tête de trame : numéro, longueur et message de contrôle. */
+#define SPILINK_HDR_SEQ               0U
+#define SPILINK_HDR_CTRL_LEN          1U
+#define SPILINK_HDR_CTRL              2U
+#define SPILINK_HDR_BYTES             32U
+#define SPILINK_CTRL_PAYLOAD          (SPILINK_HDR_BYTES - SPILINK_HDR_CTRL)
+#define SPILINK_CRC_BYTES             4U
+
+#define SPILINK_SAMPLES               (BRICK_AUDIO_FRAME_SAMPLES * SPILINK_CHANNELS)
+/** Trame la plus longue (24 bits), et tampon arrondi aux lignes de cache. */
+#define SPILINK_FRAME_BYTES           (SPILINK_HDR_BYTES + SPILINK_WIRE_BYTES_S24(SPILINK_SAMPLES) + \
+                                       SPILINK_CRC_BYTES)
+#define SPILINK_BUFFER_BYTES          ((SPILINK_FRAME_BYTES + 31U) & ~31U)
+
+#define SPILINK_FRAME_CRC_INIT        0xFFFFFFFFU
+
+/* Taille de trame sur le fil, CRC compris. */
+static inline size_t spilink_frame_bytes(spilink_format_t fmt) {
+    return SPILINK_HDR_BYTES + spilink_wire_bytes(fmt, SPILINK_SAMPLES) + SPILINK_CRC_BYTES;
+}
+
+static inline void spilink_frame_put_crc(uint8_t *p, uint32_t crc) {
+    p[0] = (uint8_t)(crc >> 24);
+    p[1] = (uint8_t)(crc >> 16);
+    p[2] = (uint8_t)(crc >> 8);
+    p[3] = (uint8_t)crc;
+}
+
+static inline uint32_t spilink_frame_get_crc(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+uint32_t spilink_frame_crc_sw(const uint8_t *data, size_t len);
+
+/* Calcul par morceaux : partir de SPILINK_FRAME_CRC_INIT. */
+uint32_t spilink_frame_crc_sw_update(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif /* SPILINK_FRAME_H */
@@ -0,0 +1,64 @@
+/**
+ * @file spilink_link.h
+ * @brief Contrôle et présence SPI-LINK vus des modules cartouche : table d'opérations.
+ * @details Deux transports fournissent cette table : drv_spilink (bus réels,
+ * drv_spilink_link_ops) et cart_emu (cartouches logicielles,
+ * cart_emu_link_ops). cart_manager, cart_params et cart_bulk la reçoivent à
+ * l'initialisation et ne passent que par elle ; le même code cartouche tourne
+ * ainsi sur le H7 ou sur un banc hôte. Sémantique commune, détaillée dans
+ * drv_spilink.h :
+ *  - présence : relié après SPILINK_LINK_UP_FRAMES trames valides
+ *    consécutives, perdu après SPILINK_LINK_DOWN_BLOCKS blocs sans trame
+ *    neuve ; files de contrôle vidées à la perte ; changements signalés
+ *    depuis le thread audio ;
+ *  - contrôle : un message en attente d'émission par cartouche, réception
+ *    en file ; remplissage puis trafic de fond offerts, au push d'un bus
+ *    relié, au champ de contrôle d'une trame sans message en attente.
+ *
+ * Sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef SPILINK_LINK_H
+#define SPILINK_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Détection de présence, en trames et en blocs. */
+#define SPILINK_LINK_UP_FRAMES        4U
+#define SPILINK_LINK_DOWN_BLOCKS      48U
+
+/* Changement de présence, appelé depuis le thread audio : ne pas bloquer. */
+typedef void (*spilink_link_cb_t)(uint8_t cart, bool linked);
+
+/*
+ * Remplissage du champ de contrôle d'une trame (thread audio) : écrit au
+ * plus `max` octets, retourne la longueur (0 : aucun message).
+ */
+typedef size_t (*spilink_ctrl_fill_cb_t)(uint8_t cart, uint8_t *msg, size_t max);
+
+/*
+ * Présence et nombre de détections, lus ensemble : un retrait suivi d'une
+ * insertion entre deux lectures se voit au compteur.
+ */
+typedef struct {
+    bool     linked;
+    uint32_t link_ups;
+} spilink_link_state_t;
+
+typedef struct {
+    /* false si le bus n'est pas relié, si un message attend déjà ou si `len` est invalide. */
+    bool   (*ctrl_send)(uint8_t cart, const uint8_t *data, size_t len);
+    /* Plus ancien message reçu (au plus SPILINK_CTRL_PAYLOAD octets) ; 0 si aucun. */
+    size_t (*ctrl_recv)(uint8_t cart, uint8_t *data);
+    void   (*get_link)(uint8_t cart, spilink_link_state_t *st);
+    void   (*set_link_cb)(spilink_link_cb_t cb);
+    void   (*set_ctrl_fill_cb)(spilink_ctrl_fill_cb_t cb);
+    /* Appelé en dernier : ni message en attente ni remplissage (transferts de masse). */
+    void   (*set_ctrl_idle_cb)(spilink_ctrl_fill_cb_t cb);
+} spilink_link_ops_t;
+
+#endif /* SPILINK_LINK_H */
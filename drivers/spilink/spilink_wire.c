@@ -0,0 +1,131 @@
+/**
+ * @file spilink_wire.c
+ * @brief Pack / unpack des échantillons SPI-LINK, 24 bits serrés ou 16 bits.
+ * @ingroup drivers
+ */
+
+#include "spilink_wire.h"
+
+/*
+ * Primitives : sur Cortex-M7, GCC traduit bswap en REV et les motifs
+ * demi-mot bas | demi-mot haut en PKHBT / PKHTB ; ACLE fournit SSAT.
+ */
+#define WIRE_REV(x)   __builtin_bswap32(x)
+
+#if defined(__ARM_FEATURE_SAT) && (__ARM_FEATURE_SAT == 1)
+#include <arm_acle.h>
+#define WIRE_SSAT24(x)  __ssat((x), 24)
+#define WIRE_SSAT16(x)  __ssat((x), 16)
+#else
+static inline int32_t wire_ssat(int32_t x, int32_t max) {
+    if (x > max) {
+        return max;
+    }
+    if (x < (-max - 1)) {
+        return -max - 1;
+    }
+    return x;
+}
+#define WIRE_SSAT24(x)  wire_ssat((x), 0x7FFFFF)
+#define WIRE_SSAT16(x)  wire_ssat((x), 0x7FFF)
+#endif
+
+/* PKHBT(lo, hi, 16) / PKHTB(hi, lo, 16). */
+static inline uint32_t wire_pkhbt16(uint32_t lo, uint32_t hi) {
+    return (lo & 0x0000FFFFU) | (hi << 16);
+}
+
+static inline uint32_t wire_pkhtb16(uint32_t hi, uint32_t lo) {
+    return (hi & 0xFFFF0000U) | (lo >> 16);
+}
+
+/* -------------------------------------------------------------------------- */
+/* 24 bits : a2 a1 a0 b2 | b1 b0 c2 c1 | c0 d2 d1 d0                           */
+/* -------------------------------------------------------------------------- */
+
+static void wire_pack_s24(uint32_t *w, const int32_t *src, size_t samples) {
+    for (size_t i = 0U; i < samples; i += 4U) {
+        const uint32_t a = (uint32_t)WIRE_SSAT24(src[0]);
+        const uint32_t b = (uint32_t)WIRE_SSAT24(src[1]);
+        const uint32_t c = (uint32_t)WIRE_SSAT24(src[2]);
+        const uint32_t d = (uint32_t)WIRE_SSAT24(src[3]);
+
+        w[0] = WIRE_REV((a << 8) | ((b >> 16) & 0xFFU));
+        w[1] = WIRE_REV(wire_pkhbt16(c >> 8, b));
+        w[2] = WIRE_REV((c << 24) | (d & 0x00FFFFFFU));
+        w += 3;
+        src += 4;
+    }
+}
+
+static void wire_unpack_s24(int32_t *dst, const uint32_t *w, size_t samples) {
+    for (size_t i = 0U; i < samples; i += 4U) {
+        const uint32_t w0 = WIRE_REV(w[0]);
+        const uint32_t w1 = WIRE_REV(w[1]);
+        const uint32_t w2 = WIRE_REV(w[2]);
+
+        /* Chaque échantillon est cadré en haut du mot puis décalé arithmétiquement. */
+        dst[0] = (int32_t)w0 >> 8;
+        dst[1] = (int32_t)((w0 << 24) | ((w1 >> 8) & 0x00FFFF00U)) >> 8;
+        dst[2] = (int32_t)(wire_pkhtb16(w1 << 16, w2) & 0xFFFFFF00U) >> 8;
+        dst[3] = (int32_t)(w2 << 8) >> 8;
+        w += 3;
+        dst += 4;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* 16 bits : a1 a0 b1 b0                                                      */
+/* -------------------------------------------------------------------------- */
+
+static void wire_pack_s16(uint32_t *w, const int32_t *src, size_t samples) {
+    for (size_t i = 0U; i < samples; i += 2U) {
+        /* Bits 23..8 arrondis ; la saturation absorbe le dépassement d'arrondi. */
+        const uint32_t a = (uint32_t)WIRE_SSAT16((WIRE_SSAT24(src[0]) + 0x80) >> 8);
+        const uint32_t b = (uint32_t)WIRE_SSAT16((WIRE_SSAT24(src[1]) + 0x80) >> 8);
+
+        *w++ = WIRE_REV(wire_pkhbt16(b, a));
+        src += 2;
+    }
+}
+
+static void wire_unpack_s16(int32_t *dst, const uint32_t *w, size_t samples) {
+    for (size_t i = 0U; i < samples; i += 2U) {
+        const uint32_t v = WIRE_REV(*w++);
+
+        dst[0] = (int32_t)(v & 0xFFFF0000U) >> 8;
+        dst[1] = (int32_t)(v << 16) >> 8;
+        dst += 2;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API                                                                        */
+/* -------------------------------------------------------------------------- */
+
+size_t spilink_wire_bytes(spilink_format_t fmt, size_t samples) {
+    return (fmt == SPILINK_FORMAT_S16) ? SPILINK_WIRE_BYTES_S16(samples)
+                                       : SPILINK_WIRE_BYTES_S24(samples);
+}
+
+size_t spilink_wire_pack(spilink_format_t fmt, uint8_t *wire, const int32_t *src, size_t samples) {
+    uint32_t *w = (uint32_t *)(void *)wire;
+
+    if (fmt == SPILINK_FORMAT_S16) {
+        wire_pack_s16(w, src, samples);
+    } else {
+        wire_pack_s24(w, src, samples);
+    }
+    return spilink_wire_bytes(fmt, samples);
+}
+
+size_t spilink_wire_unpack(spilink_format_t fmt, int32_t *dst, const uint8_t *wire, size_t samples) {
+    const uint32_t *w = (const uint32_t *)(const void *)wire;
+
+    if (fmt == SPILINK_FORMAT_S16) {
+        wire_unpack_s16(dst, w, samples);
+    } else {
+        wire_unpack_s24(dst, w, samples);
+    }
+    return spilink_wire_bytes(fmt, samples);
+}
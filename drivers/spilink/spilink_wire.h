@@ -0,0 +1,44 @@
+/**
+ * @file spilink_wire.h
+ * @brief Format audio du fil SPI-LINK : noyaux de pack / unpack 24 et 16 bits.
+ * @details Les échantillons circulent gros-boutistes, sans octet de
+ * remplissage :
+ *  - SPILINK_FORMAT_S24 : 3 octets par échantillon, 4 échantillons par
+ *    groupe de 3 mots ; saturé à 24 bits à l'émission, étendu en signe à la
+ *    réception ;
+ *  - SPILINK_FORMAT_S16 : 2 octets par échantillon (bits 23..8 arrondis et
+ *    saturés), pour les cartouches à faible débit ; relu cadré sur 24 bits.
+ *
+ * Les noyaux lisent et écrivent directement le bloc [frames][canaux] d'une
+ * cartouche (une ligne de spilink_audio_block_t), par mots de 32 bits : une
+ * inversion d'octets (REV) par mot, assemblage des demi-mots par motifs
+ * PKHBT / PKHTB, saturation SSAT. Le fil doit être aligné sur 4 octets.
+ *
+ * Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef SPILINK_WIRE_H
+#define SPILINK_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SPILINK_FORMAT_S24 = 0,
+    SPILINK_FORMAT_S16,
+    SPILINK_FORMAT_COUNT
+} spilink_format_t;
+
+/** Octets sur le fil de `n` échantillons (n multiple de 4). */
+#define SPILINK_WIRE_BYTES_S24(n)     ((n) * 3U)
+#define SPILINK_WIRE_BYTES_S16(n)     ((n) * 2U)
+
+size_t spilink_wire_bytes(spilink_format_t fmt, size_t samples);
+
+/* `samples` multiple de 4 ; retournent les octets écrits / lus sur le fil. */
+size_t spilink_wire_pack(spilink_format_t fmt, uint8_t *wire, const int32_t *src, size_t samples);
+size_t spilink_wire_unpack(spilink_format_t fmt, int32_t *dst, const uint8_t *wire, size_t samples);
+
+#endif /* SPILINK_WIRE_H */
@@ -0,0 +1,79 @@
+/**
+ * @file drv_storage.c
+ * @brief Accès bloc brut SDMMC1, connexion paresseuse et sérialisation des accès.
+ */
+
+#include "drv_storage.h"
+
+#if !HAL_USE_SDC
+#error "drv_storage requiert HAL_USE_SDC = TRUE dans halconf.h"
+#endif
+
+static mutex_t storage_lock;
+static bool storage_initialized = false;
+static bool storage_connected = false;
+
+/* À appeler sous storage_lock. */
+static bool storage_ensure_connected(void) {
+    if (storage_connected) {
+        return true;
+    }
+    if (!blkIsInserted(&SDCD1)) {
+        return false;
+    }
+    if (sdcConnect(&SDCD1) != HAL_SUCCESS) {
+        return false;
+    }
+    storage_connected = true;
+    return true;
+}
+
+/* Carte retirée ou erreur bus : reconnexion complète à la prochaine requête. */
+static void storage_drop_connection(void) {
+    if (storage_connected) {
+        sdcDisconnect(&SDCD1);
+    }
+    storage_connected = false;
+}
+
+void drv_storage_init(void) {
+    if (storage_initialized) {
+        return;
+    }
+    chMtxObjectInit(&storage_lock);
+    /* Configuration par défaut du LLD (bus 4 bits). */
+    sdcStart(&SDCD1, NULL);
+    storage_initialized = true;
+}
+
+bool drv_storage_is_ready(void) {
+    return storage_initialized && storage_connected;
+}
+
+bool drv_storage_read(uint32_t lba, uint8_t *buf, uint32_t blocks) {
+    if (!storage_initialized) {
+        return false;
+    }
+    chMtxLock(&storage_lock);
+    bool ok = storage_ensure_connected() &&
+              (sdcRead(&SDCD1, lba, buf, blocks) == HAL_SUCCESS);
+    if (!ok) {
+        storage_drop_connection();
+    }
+    chMtxUnlock(&storage_lock);
+    return ok;
+}
+
+bool drv_storage_write(uint32_t lba, const uint8_t *buf, uint32_t blocks) {
+    if (!storage_initialized) {
+        return false;
+    }
+    chMtxLock(&storage_lock);
+    bool ok = storage_ensure_connected() &&
+              (sdcWrite(&SDCD1, lba, buf, blocks) == HAL_SUCCESS);
+    if (!ok) {
+        storage_drop_connection();
+    }
+    chMtxUnlock(&storage_lock);
+    return ok;
+}
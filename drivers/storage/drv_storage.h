@@ -0,0 +1,50 @@
+/**
+ * @file drv_storage.h
+ * @brief Accès bloc brut à la carte SD (SDMMC1) et plan d'occupation des zones.
+ * @details Aucun système de fichiers n'est embarqué : chaque usage dispose
+ * d'une zone de blocs fixe. L'accès est sérialisé par un mutex, les appels
+ * sont bloquants et réservés aux threads de basse priorité (chargeur de
+ * patterns, sauvegarde, rendu hors ligne), jamais au thread audio.
+ */
+
+#ifndef DRV_STORAGE_H
+#define DRV_STORAGE_H
+
+#include "ch.h"
+#include "hal.h"
+
+/** Taille d'un bloc SD. */
+#define STORAGE_BLOCK_SIZE            MMCSD_BLOCK_SIZE
+
+/* -------------------------------------------------------------------------- */
+/* Plan des zones (en blocs de 512 octets)                                    */
+/* -------------------------------------------------------------------------- */
+
+/* Les 1 Mo initiaux sont laissés libres (table de partition éventuelle). */
+#define STORAGE_PATTERN_BASE_LBA      2048U
+#define STORAGE_PATTERN_SLOT_BLOCKS   64U      /* 32 Ko réservés par pattern. */
+#define STORAGE_PATTERN_COUNT         128U
+/* Slot de transit après les patterns : restauration SysEx avant validation. */
+#define STORAGE_PATTERN_STAGING_SLOTS 1U
+
+#define STORAGE_PATTERN_END_LBA       (STORAGE_PATTERN_BASE_LBA + \
+                                       (STORAGE_PATTERN_SLOT_BLOCKS * \
+                                        (STORAGE_PATTERN_COUNT + STORAGE_PATTERN_STAGING_SLOTS)))
+
+/* Rendu hors ligne : un fichier WAV contigu (en-tête dans le premier bloc). */
+#define STORAGE_BOUNCE_BASE_LBA       STORAGE_PATTERN_END_LBA
+#define STORAGE_BOUNCE_BLOCKS         2097152U /* 1 Go. */
+#define STORAGE_BOUNCE_END_LBA        (STORAGE_BOUNCE_BASE_LBA + STORAGE_BOUNCE_BLOCKS)
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void drv_storage_init(void);
+bool drv_storage_is_ready(void);
+
+/* Retournent true en cas de succès (connexion paresseuse à la carte). */
+bool drv_storage_read(uint32_t lba, uint8_t *buf, uint32_t blocks);
+bool drv_storage_write(uint32_t lba, const uint8_t *buf, uint32_t blocks);
+
+#endif /* DRV_STORAGE_H */
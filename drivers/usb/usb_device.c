@@ -0,0 +1,38 @@
+/**
+ * @file usb_device.c
+ * @brief Démarrage du périphérique USB (OTG_FS) et de la classe USB-MIDI.
+ * @ingroup drivers
+ */
+
+#include "usb_device.h"
+#include "usbcfg.h"
+#include "usb_midi.h"
+
+#if STM32_USBSEL != STM32_USBSEL_HSI48_CK
+#error "usb_device attend l'OTG cadencé par HSI48 (recalage CRS sur SOF)"
+#endif
+
+static bool usb_device_started = false;
+
+/* CRS : recalage automatique de HSI48 sur les SOF USB (source par défaut). */
+static void usb_device_crs_start(void) {
+    RCC->APB1HENR |= RCC_APB1HENR_CRSEN;
+    (void)RCC->APB1HENR;
+    CRS->CR |= CRS_CR_AUTOTRIMEN | CRS_CR_CEN;
+}
+
+void usb_device_start(void) {
+    if (usb_device_started) {
+        return;
+    }
+
+    usb_device_crs_start();
+    usb_midi_init();
+
+    usbDisconnectBus(&USB_MIDI_DRIVER);
+    chThdSleepMilliseconds(USB_DEVICE_DISCONNECT_MS);
+    usbStart(&USB_MIDI_DRIVER, &usbcfg);
+    usbConnectBus(&USB_MIDI_DRIVER);
+
+    usb_device_started = true;
+}
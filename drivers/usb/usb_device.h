@@ -0,0 +1,21 @@
+/**
+ * @file usb_device.h
+ * @brief Démarrage du périphérique USB (OTG_FS) et de la classe USB-MIDI.
+ * @details L'OTG_FS est cadencé par HSI48, recalé en continu sur les SOF de
+ * l'hôte par le CRS (PLL1_Q à 50 MHz est hors tolérance USB).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef USB_DEVICE_H
+#define USB_DEVICE_H
+
+#include "ch.h"
+#include "hal.h"
+
+/* Durée de déconnexion forcée au démarrage, pour que l'hôte ré-énumère. */
+#define USB_DEVICE_DISCONNECT_MS    1500U
+
+void usb_device_start(void);
+
+#endif /* USB_DEVICE_H */
@@ -0,0 +1,302 @@
+/**
+ * @file usb_midi.c
+ * @brief Class driver USB-MIDI 1.0 : transferts bulk groupés, double tampon RX/TX.
+ * @ingroup drivers
+ */
+
+#include "usb_midi.h"
+#include "usbcfg.h"
+#include "drv_audio.h"
+#include <string.h>
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+static USBDriver *usb_midi_usbp = NULL;
+static bool usb_midi_ready = false;
+
+/* Émission. */
+static usb_midi_txq_t usb_midi_txq;
+static binary_semaphore_t usb_midi_tx_sem;
+static mutex_t usb_midi_sysex_mtx;
+static usb_midi_sysex_packer_t usb_midi_sysex_packer;
+
+/* Réception : `rx_arm` est le tampon confié au driver quand `rx_armed`. */
+static uint8_t usb_midi_rx_buf[2][USB_MIDI_EP_SIZE];
+static size_t usb_midi_rx_len[2];
+static uint32_t usb_midi_rx_frame[2];
+static uint8_t usb_midi_rx_pending = 0U;    /* Bit i : tampon i à décoder. */
+static uint8_t usb_midi_rx_arm = 0U;
+static bool usb_midi_rx_armed = false;
+static uint8_t usb_midi_rx_rd = 0U;
+static binary_semaphore_t usb_midi_rx_sem;
+
+static midi_parser_t usb_midi_parser;
+static midi_msg_cb_t usb_midi_msg_cb = NULL;
+static midi_sysex_cb_t usb_midi_sysex_cb = NULL;
+static void *usb_midi_cb_ctx = NULL;
+
+static usb_midi_stats_t usb_midi_stats;
+static bool usb_midi_initialized = false;
+
+static THD_WORKING_AREA(usbMidiThreadWA, USB_MIDI_THREAD_STACK_SIZE);
+
+/* -------------------------------------------------------------------------- */
+/* Réception                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* Confie le tampon `idx` à l'endpoint OUT. Sous verrou. */
+static void usb_midi_rx_arm_i(uint8_t idx) {
+    usb_midi_rx_arm = idx;
+    usb_midi_rx_armed = true;
+    usbStartReceiveI(usb_midi_usbp, USB_MIDI_EP_OUT, usb_midi_rx_buf[idx], USB_MIDI_EP_SIZE);
+}
+
+void usb_midi_out_cb(USBDriver *usbp, usbep_t ep) {
+    chSysLockFromISR();
+    const uint8_t idx = usb_midi_rx_arm;
+    usb_midi_rx_len[idx] = usbGetReceiveTransactionSizeX(usbp, ep);
+    usb_midi_rx_frame[idx] = drv_audio_get_frame_timeI();
+    usb_midi_rx_pending |= (uint8_t)(1U << idx);
+    usb_midi_rx_armed = false;
+    usb_midi_stats.rx_transfers++;
+
+    const uint8_t next = (uint8_t)(idx ^ 1U);
+    if ((usb_midi_rx_pending & (1U << next)) == 0U) {
+        usb_midi_rx_arm_i(next);
+    } else {
+        usb_midi_stats.rx_stalls++;
+    }
+    chBSemSignalI(&usb_midi_rx_sem);
+    chSysUnlockFromISR();
+}
+
+static void usb_midi_parser_msg_cb(void *ctx, const midi_msg_t *msg) {
+    (void)ctx;
+    if (usb_midi_msg_cb != NULL) {
+        usb_midi_msg_cb(usb_midi_cb_ctx, msg);
+    }
+}
+
+static void usb_midi_parser_sysex_cb(void *ctx, const uint8_t *data, size_t len,
+                                     uint8_t flags, uint32_t frame) {
+    (void)ctx;
+    if (usb_midi_sysex_cb != NULL) {
+        usb_midi_sysex_cb(usb_midi_cb_ctx, data, len, flags, frame);
+    }
+}
+
+static void usb_midi_decode(const uint8_t *buf, size_t len, uint32_t frame) {
+    size_t packets = 0U;
+
+    for (size_t i = 0U; (i + USB_MIDI_PACKET_SIZE) <= len; i += USB_MIDI_PACKET_SIZE) {
+        const uint8_t n = usb_midi_cin_length(buf[i]);
+        if (n == 0U) {
+            continue;   /* CIN réservés (0, 1) : paquet ignoré. */
+        }
+        midi_parser_feed(&usb_midi_parser, &buf[i + 1U], n, frame, 0U);
+        packets++;
+    }
+
+    chSysLock();
+    usb_midi_stats.rx_packets += (uint32_t)packets;
+    chSysUnlock();
+}
+
+static THD_FUNCTION(usbMidiThread, arg) {
+    (void)arg;
+    chRegSetThreadName("usbMidi");
+
+    while (true) {
+        chBSemWait(&usb_midi_rx_sem);
+
+        while (true) {
+            chSysLock();
+            const uint8_t idx = usb_midi_rx_rd;
+            const bool pending = (usb_midi_rx_pending & (1U << idx)) != 0U;
+            chSysUnlock();
+            if (!pending) {
+                break;
+            }
+
+            usb_midi_decode(usb_midi_rx_buf[idx], usb_midi_rx_len[idx], usb_midi_rx_frame[idx]);
+
+            chSysLock();
+            usb_midi_rx_pending &= (uint8_t)~(1U << idx);
+            if (usb_midi_ready && !usb_midi_rx_armed) {
+                usb_midi_rx_arm_i(idx);
+            }
+            usb_midi_rx_rd = (uint8_t)(idx ^ 1U);
+            chSysUnlock();
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Émission                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/* Lance le lot en attente si l'endpoint IN est libre. Sous verrou. */
+static void usb_midi_tx_kick_i(void) {
+    size_t len;
+    const uint8_t *buf = usb_midi_txq_start(&usb_midi_txq, &len);
+
+    if (buf != NULL) {
+        usb_midi_stats.tx_packets += (uint32_t)(len / USB_MIDI_PACKET_SIZE);
+        usb_midi_stats.tx_transfers++;
+        usbStartTransmitI(usb_midi_usbp, USB_MIDI_EP_IN, buf, len);
+    }
+}
+
+void usb_midi_in_cb(USBDriver *usbp, usbep_t ep) {
+    (void)usbp;
+    (void)ep;
+    chSysLockFromISR();
+    usb_midi_txq_done(&usb_midi_txq);
+    if (usb_midi_ready) {
+        usb_midi_tx_kick_i();
+    }
+    chBSemSignalI(&usb_midi_tx_sem);
+    chSysUnlockFromISR();
+}
+
+/* -------------------------------------------------------------------------- */
+/* Évènements USB                                                             */
+/* -------------------------------------------------------------------------- */
+
+void usb_midi_configured_i(USBDriver *usbp) {
+    usb_midi_usbp = usbp;
+    usb_midi_ready = true;
+    usb_midi_txq_init(&usb_midi_txq);
+    usb_midi_rx_pending = 0U;
+    usb_midi_rx_rd = 0U;
+    usb_midi_rx_arm_i(0U);
+    chBSemSignalI(&usb_midi_tx_sem);
+}
+
+void usb_midi_disconnected_i(void) {
+    usb_midi_ready = false;
+    usb_midi_rx_armed = false;
+    usb_midi_txq_init(&usb_midi_txq);
+    chBSemSignalI(&usb_midi_tx_sem);
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void usb_midi_init(void) {
+    if (usb_midi_initialized) {
+        return;
+    }
+
+    chBSemObjectInit(&usb_midi_rx_sem, true);
+    chBSemObjectInit(&usb_midi_tx_sem, true);
+    chMtxObjectInit(&usb_midi_sysex_mtx);
+    usb_midi_txq_init(&usb_midi_txq);
+    usb_midi_sysex_packer_reset(&usb_midi_sysex_packer);
+    memset(&usb_midi_stats, 0, sizeof(usb_midi_stats));
+    midi_parser_init(&usb_midi_parser, MIDI_PORT_USB,
+                     usb_midi_parser_msg_cb, usb_midi_parser_sysex_cb, NULL);
+
+    chThdCreateStatic(usbMidiThreadWA, sizeof(usbMidiThreadWA),
+                      USB_MIDI_THREAD_PRIORITY, usbMidiThread, NULL);
+
+    usb_midi_initialized = true;
+}
+
+bool usb_midi_is_ready(void) {
+    return usb_midi_ready;
+}
+
+void usb_midi_set_rx_cb(midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx) {
+    chSysLock();
+    usb_midi_msg_cb = msg_cb;
+    usb_midi_sysex_cb = sysex_cb;
+    usb_midi_cb_ctx = ctx;
+    chSysUnlock();
+}
+
+bool usb_midi_send(const midi_msg_t *msg) {
+    uint8_t pkt[USB_MIDI_PACKET_SIZE];
+    bool ok = false;
+
+    if (!usb_midi_pack(msg, USB_MIDI_CABLE, pkt)) {
+        return false;
+    }
+
+    /* Les messages non temps réel laissent la réserve libre. */
+    const size_t need = midi_is_realtime(msg->status) ? 1U : (1U + USB_MIDI_TX_RT_RESERVE);
+
+    chSysLock();
+    if (usb_midi_ready && (usb_midi_txq_room(&usb_midi_txq) >= need) &&
+        usb_midi_txq_put(&usb_midi_txq, pkt, 1U)) {
+        usb_midi_tx_kick_i();
+        ok = true;
+    } else {
+        usb_midi_stats.tx_dropped++;
+    }
+    chSysUnlock();
+    return ok;
+}
+
+bool usb_midi_send_sysex(const uint8_t *data, size_t len) {
+    uint8_t pkt[USB_MIDI_PACKET_SIZE];
+    bool ok = true;
+
+    if ((data == NULL) || (len == 0U)) {
+        return false;
+    }
+
+    /* Un flux SysEx à la fois : ses paquets ne doivent pas s'entrelacer. */
+    chMtxLock(&usb_midi_sysex_mtx);
+    for (size_t i = 0U; ok && (i < len); ++i) {
+        if (!usb_midi_sysex_packer_put(&usb_midi_sysex_packer, data[i], USB_MIDI_CABLE, pkt)) {
+            continue;
+        }
+        while (true) {
+            chSysLock();
+            if (!usb_midi_ready) {
+                usb_midi_stats.tx_dropped++;
+                usb_midi_sysex_packer_reset(&usb_midi_sysex_packer);
+                chSysUnlock();
+                ok = false;
+                break;
+            }
+            if (usb_midi_txq_room(&usb_midi_txq) > USB_MIDI_TX_RT_RESERVE) {
+                (void)usb_midi_txq_put(&usb_midi_txq, pkt, 1U);
+                usb_midi_tx_kick_i();
+                chSysUnlock();
+                break;
+            }
+            chBSemResetI(&usb_midi_tx_sem, true);
+            chSysUnlock();
+            if (chBSemWaitTimeout(&usb_midi_tx_sem,
+                                  TIME_MS2I(USB_MIDI_SYSEX_TIMEOUT_MS)) != MSG_OK) {
+                usb_midi_sysex_packer_reset(&usb_midi_sysex_packer);
+                ok = false;
+                break;
+            }
+        }
+    }
+    chMtxUnlock(&usb_midi_sysex_mtx);
+    return ok;
+}
+
+size_t usb_midi_tx_room(void) {
+    chSysLock();
+    const size_t room = usb_midi_ready ? usb_midi_txq_room(&usb_midi_txq) : 0U;
+    chSysUnlock();
+    return (room > USB_MIDI_TX_RT_RESERVE) ? (room - USB_MIDI_TX_RT_RESERVE) : 0U;
+}
+
+void usb_midi_get_stats(usb_midi_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = usb_midi_stats;
+    st->parser = usb_midi_parser.stats;
+    chSysUnlock();
+}
@@ -0,0 +1,80 @@
+/**
+ * @file usb_midi.h
+ * @brief Class driver USB-MIDI 1.0 : EP1 OUT / EP2 IN bulk 64 octets.
+ * @details Émission : les paquets s'accumulent dans le tampon en remplissage
+ * d'une file double tampon pendant que l'autre est en transfert ; à la fin du
+ * transfert (ISR) le lot suivant part, jusqu'à 16 paquets par transfert.
+ * usb_midi_send() ne bloque jamais (appelable depuis le thread audio) : si le
+ * tampon est plein le message est compté perdu. Les USB_MIDI_TX_RT_RESERVE
+ * derniers paquets du tampon sont réservés aux messages temps réel, qui ne
+ * restent donc jamais derrière un arriéré de messages canal.
+ *
+ * Réception : deux tampons OUT de 64 octets. L'ISR date le transfert sur
+ * l'horloge audio et réarme l'autre tampon s'il est libre ; sinon l'endpoint
+ * reste désarmé (NAK côté hôte) jusqu'à ce que le thread ait consommé un
+ * tampon. Le thread décode les paquets via midi_parser (port MIDI_PORT_USB).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef USB_MIDI_H
+#define USB_MIDI_H
+
+#include "ch.h"
+#include "hal.h"
+#include "midi_parser.h"
+#include "usb_midi_packet.h"
+
+#define USB_MIDI_CABLE                0U
+#define USB_MIDI_TX_RT_RESERVE        2U
+
+#define USB_MIDI_THREAD_STACK_SIZE    1024U
+#define USB_MIDI_THREAD_PRIORITY      (NORMALPRIO + 8)
+
+/* Attente maximale d'une place en émission pour un SysEx. */
+#define USB_MIDI_SYSEX_TIMEOUT_MS     100U
+
+typedef struct {
+    uint32_t            tx_packets;
+    uint32_t            tx_transfers;
+    uint32_t            tx_dropped;      /* Tampon plein ou hôte absent. */
+    uint32_t            rx_packets;
+    uint32_t            rx_transfers;
+    uint32_t            rx_stalls;       /* Endpoint OUT laissé en NAK faute de tampon. */
+    midi_parser_stats_t parser;
+} usb_midi_stats_t;
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void usb_midi_init(void);
+bool usb_midi_is_ready(void);
+
+/* Callbacks appelés depuis le thread USB-MIDI. */
+void usb_midi_set_rx_cb(midi_msg_cb_t msg_cb, midi_sysex_cb_t sysex_cb, void *ctx);
+
+/* Non bloquant ; false si l'hôte n'est pas connecté ou si le tampon est plein. */
+bool usb_midi_send(const midi_msg_t *msg);
+
+/*
+ * Fragment d'un flux SysEx (F0 … F7, découpage quelconque entre appels
+ * successifs) ; peut attendre la fin des transferts (thread uniquement).
+ */
+bool usb_midi_send_sysex(const uint8_t *data, size_t len);
+
+/* Paquets encore acceptés hors réserve temps réel (0 si l'hôte est absent). */
+size_t usb_midi_tx_room(void);
+
+void usb_midi_get_stats(usb_midi_stats_t *st);
+
+/* -------------------------------------------------------------------------- */
+/* Interface avec usbcfg.c (contexte ISR, sous verrou)                        */
+/* -------------------------------------------------------------------------- */
+
+void usb_midi_configured_i(USBDriver *usbp);
+void usb_midi_disconnected_i(void);
+void usb_midi_out_cb(USBDriver *usbp, usbep_t ep);
+void usb_midi_in_cb(USBDriver *usbp, usbep_t ep);
+
+#endif /* USB_MIDI_H */
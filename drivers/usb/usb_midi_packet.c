@@ -0,0 +1,107 @@
+/**
+ * @file usb_midi_packet.c
+ * @brief Codage des paquets USB-MIDI 1.0 et file d'émission double tampon.
+ * @ingroup drivers
+ */
+
+#include "usb_midi_packet.h"
+#include <string.h>
+
+static const uint8_t cin_length[16] = {
+    0U, 0U, 2U, 3U, 3U, 1U, 2U, 3U, 3U, 3U, 3U, 3U, 2U, 2U, 3U, 1U
+};
+
+uint8_t usb_midi_cin_length(uint8_t cin) {
+    return cin_length[cin & 0x0FU];
+}
+
+bool usb_midi_pack(const midi_msg_t *msg, uint8_t cable, uint8_t *pkt) {
+    const uint8_t status = msg->status;
+    uint8_t cin;
+
+    if (midi_is_channel(status)) {
+        cin = (uint8_t)(status >> 4);
+    } else if (midi_is_realtime(status)) {
+        cin = USB_MIDI_CIN_SINGLE_BYTE;
+    } else {
+        switch (midi_data_length(status)) {
+        case 1U:
+            cin = USB_MIDI_CIN_SYSCOM_2;
+            break;
+        case 2U:
+            cin = USB_MIDI_CIN_SYSCOM_3;
+            break;
+        default:
+            if ((status == MIDI_SYSEX_START) || (status == MIDI_SYSEX_END)) {
+                return false;
+            }
+            cin = USB_MIDI_CIN_SYSEX_END_1;
+            break;
+        }
+    }
+
+    const uint8_t len = cin_length[cin];
+    pkt[0] = (uint8_t)((cable << 4) | cin);
+    pkt[1] = status;
+    pkt[2] = (len > 1U) ? (uint8_t)(msg->data[0] & 0x7FU) : 0U;
+    pkt[3] = (len > 2U) ? (uint8_t)(msg->data[1] & 0x7FU) : 0U;
+    return true;
+}
+
+bool usb_midi_sysex_packer_put(usb_midi_sysex_packer_t *sp, uint8_t byte,
+                               uint8_t cable, uint8_t *pkt) {
+    /* Un F0 en cours de paquet ouvre un nouveau SysEx : le reste est perdu. */
+    if ((byte == MIDI_SYSEX_START) && (sp->n != 0U)) {
+        sp->n = 0U;
+    }
+    sp->buf[sp->n++] = byte;
+
+    uint8_t cin;
+    if (byte == MIDI_SYSEX_END) {
+        cin = (uint8_t)(USB_MIDI_CIN_SYSEX_END_1 + (sp->n - 1U));
+    } else if (sp->n == 3U) {
+        cin = USB_MIDI_CIN_SYSEX_START;
+    } else {
+        return false;
+    }
+
+    pkt[0] = (uint8_t)((cable << 4) | cin);
+    pkt[1] = sp->buf[0];
+    pkt[2] = (sp->n > 1U) ? sp->buf[1] : 0U;
+    pkt[3] = (sp->n > 2U) ? sp->buf[2] : 0U;
+    sp->n = 0U;
+    return true;
+}
+
+void usb_midi_txq_init(usb_midi_txq_t *q) {
+    memset(q, 0, sizeof(*q));
+}
+
+bool usb_midi_txq_put(usb_midi_txq_t *q, const uint8_t *pkts, size_t n_pkts) {
+    const size_t bytes = n_pkts * USB_MIDI_PACKET_SIZE;
+    const uint8_t f = q->fill;
+
+    if (((size_t)q->len[f] + bytes) > USB_MIDI_EP_SIZE) {
+        return false;
+    }
+    memcpy(&q->buf[f][q->len[f]], pkts, bytes);
+    q->len[f] = (uint8_t)(q->len[f] + bytes);
+    return true;
+}
+
+const uint8_t *usb_midi_txq_start(usb_midi_txq_t *q, size_t *len) {
+    const uint8_t f = q->fill;
+
+    if (q->busy || (q->len[f] == 0U)) {
+        return NULL;
+    }
+    q->busy = true;
+    q->fill = (uint8_t)(f ^ 1U);
+    q->len[q->fill] = 0U;
+    *len = q->len[f];
+    return q->buf[f];
+}
+
+void usb_midi_txq_done(usb_midi_txq_t *q) {
+    q->busy = false;
+}
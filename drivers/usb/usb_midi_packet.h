@@ -0,0 +1,80 @@
+/**
+ * @file usb_midi_packet.h
+ * @brief Paquets d'évènements USB-MIDI 1.0 et file d'émission double tampon.
+ * @details Partie du class driver USB-MIDI indépendante de la pile USB et de
+ * ChibiOS (compilable sur hôte face à un endpoint simulé) :
+ *  - conversion message MIDI <-> paquet 32 bits (CIN, câble) ;
+ *  - découpage d'un flux SysEx (fragments quelconques) en paquets CIN 4..7 ;
+ *  - file d'émission à deux tampons de USB_MIDI_EP_SIZE octets : un tampon
+ *    se remplit pendant que l'autre est en transfert, un transfert emporte
+ *    jusqu'à USB_MIDI_PACKETS_PER_TRANSFER paquets.
+ * L'appelant sérialise les accès (verrou noyau côté firmware).
+ *
+ * @ingroup drivers
+ */
+
+#ifndef USB_MIDI_PACKET_H
+#define USB_MIDI_PACKET_H
+
+#include "midi_msg.h"
+
+#define USB_MIDI_EP_SIZE                 64U
+#define USB_MIDI_PACKET_SIZE             4U
+#define USB_MIDI_PACKETS_PER_TRANSFER    (USB_MIDI_EP_SIZE / USB_MIDI_PACKET_SIZE)
+
+/* Code Index Number (octet 0, quartet bas). */
+#define USB_MIDI_CIN_SYSCOM_2            0x2U
+#define USB_MIDI_CIN_SYSCOM_3            0x3U
+#define USB_MIDI_CIN_SYSEX_START         0x4U
+#define USB_MIDI_CIN_SYSEX_END_1         0x5U   /* Aussi commun système 1 octet. */
+#define USB_MIDI_CIN_SYSEX_END_2         0x6U
+#define USB_MIDI_CIN_SYSEX_END_3         0x7U
+#define USB_MIDI_CIN_SINGLE_BYTE         0xFU
+
+/* Octets MIDI portés par un paquet selon son CIN (0 = réservé). */
+uint8_t usb_midi_cin_length(uint8_t cin);
+
+/* Message court -> paquet. Retourne false pour un statut non transportable. */
+bool usb_midi_pack(const midi_msg_t *msg, uint8_t cable, uint8_t *pkt);
+
+/* Découpage SysEx en flux : garde au plus deux octets entre deux fragments. */
+typedef struct {
+    uint8_t buf[3];
+    uint8_t n;
+} usb_midi_sysex_packer_t;
+
+static inline void usb_midi_sysex_packer_reset(usb_midi_sysex_packer_t *sp) {
+    sp->n = 0U;
+}
+
+/*
+ * Ajoute un octet du flux SysEx (F0 … F7). Retourne true quand un paquet
+ * complet a été écrit dans `pkt` : trois octets (CIN 4) ou fin (CIN 5..7).
+ */
+bool usb_midi_sysex_packer_put(usb_midi_sysex_packer_t *sp, uint8_t byte,
+                               uint8_t cable, uint8_t *pkt);
+
+typedef struct {
+    uint8_t buf[2][USB_MIDI_EP_SIZE];
+    uint8_t len[2];
+    uint8_t fill;      /* Tampon en remplissage ; l'autre est en transfert si busy. */
+    bool    busy;
+} usb_midi_txq_t;
+
+void usb_midi_txq_init(usb_midi_txq_t *q);
+
+/* Paquets libres dans le tampon en remplissage. */
+static inline size_t usb_midi_txq_room(const usb_midi_txq_t *q) {
+    return (USB_MIDI_EP_SIZE - q->len[q->fill]) / USB_MIDI_PACKET_SIZE;
+}
+
+/* Ajoute des paquets au tampon en remplissage ; false (rien d'ajouté) s'il est plein. */
+bool usb_midi_txq_put(usb_midi_txq_t *q, const uint8_t *pkts, size_t n_pkts);
+
+/* Si aucun transfert en cours et des paquets en attente : bascule et retourne le tampon à émettre. */
+const uint8_t *usb_midi_txq_start(usb_midi_txq_t *q, size_t *len);
+
+/* Transfert terminé (ou annulé). */
+void usb_midi_txq_done(usb_midi_txq_t *q);
+
+#endif /* USB_MIDI_PACKET_H */
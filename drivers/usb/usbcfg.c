@@ -0,0 +1,214 @@
+/**
+ * @file usbcfg.c
+ * @brief Descripteurs USB-MIDI, endpoints et évènements de la pile USB.
+ * @ingroup drivers
+ */
+
+#include "usbcfg.h"
+#include "usb_midi.h"
+
+/* -------------------------------------------------------------------------- */
+/* Descripteurs                                                               */
+/* -------------------------------------------------------------------------- */
+
+static const uint8_t midi_device_descriptor_data[18] = {
+    USB_DESC_DEVICE(0x0200,            /* bcdUSB (2.0).                       */
+                    0x00,              /* bDeviceClass (défini par interface). */
+                    0x00,              /* bDeviceSubClass.                    */
+                    0x00,              /* bDeviceProtocol.                    */
+                    0x40,              /* bMaxPacketSize0.                    */
+                    USB_MIDI_VID,      /* idVendor.                           */
+                    USB_MIDI_PID,      /* idProduct.                          */
+                    0x0100,            /* bcdDevice.                          */
+                    1,                 /* iManufacturer.                      */
+                    2,                 /* iProduct.                           */
+                    3,                 /* iSerialNumber.                      */
+                    1)                 /* bNumConfigurations.                 */
+};
+
+static const USBDescriptor midi_device_descriptor = {
+    sizeof(midi_device_descriptor_data),
+    midi_device_descriptor_data
+};
+
+/* Descripteurs MIDIStreaming spécifiques : en-tête, 4 jacks, 2 endpoints. */
+#define MS_CS_TOTAL_LENGTH   (7U + 6U + 6U + 9U + 9U + 9U + 5U + 9U + 5U)
+#define CONFIG_TOTAL_LENGTH  (9U + 9U + 9U + 9U + MS_CS_TOTAL_LENGTH)
+
+/* Identifiants de jacks. */
+#define JACK_IN_EMBEDDED     0x01U
+#define JACK_IN_EXTERNAL     0x02U
+#define JACK_OUT_EMBEDDED    0x03U
+#define JACK_OUT_EXTERNAL    0x04U
+
+static const uint8_t midi_configuration_descriptor_data[CONFIG_TOTAL_LENGTH] = {
+    USB_DESC_CONFIGURATION(CONFIG_TOTAL_LENGTH,
+                           0x02,       /* bNumInterfaces.                     */
+                           0x01,       /* bConfigurationValue.                */
+                           0,          /* iConfiguration.                     */
+                           0x80,       /* bmAttributes (alimenté par le bus). */
+                           50),        /* bMaxPower (100 mA).                 */
+
+    /* Interface 0 : AudioControl (obligatoire, sans unité). */
+    USB_DESC_INTERFACE(0x00, 0x00, 0x00, 0x01, 0x01, 0x00, 0),
+    0x09, 0x24, 0x01,                  /* CS_INTERFACE, HEADER.               */
+    USB_DESC_BCD(0x0100),              /* bcdADC.                             */
+    USB_DESC_WORD(0x0009),             /* wTotalLength.                       */
+    0x01,                              /* bInCollection.                      */
+    0x01,                              /* baInterfaceNr(1).                   */
+
+    /* Interface 1 : MIDIStreaming. */
+    USB_DESC_INTERFACE(0x01, 0x00, 0x02, 0x01, 0x03, 0x00, 0),
+    0x07, 0x24, 0x01,                  /* CS_INTERFACE, MS_HEADER.            */
+    USB_DESC_BCD(0x0100),              /* bcdMSC.                             */
+    USB_DESC_WORD(MS_CS_TOTAL_LENGTH),
+
+    0x06, 0x24, 0x02, 0x01, JACK_IN_EMBEDDED, 0x00,     /* MIDI_IN_JACK embarqué.  */
+    0x06, 0x24, 0x02, 0x02, JACK_IN_EXTERNAL, 0x00,     /* MIDI_IN_JACK externe.   */
+    0x09, 0x24, 0x03, 0x01, JACK_OUT_EMBEDDED, 0x01,    /* MIDI_OUT_JACK embarqué. */
+    JACK_IN_EXTERNAL, 0x01, 0x00,
+    0x09, 0x24, 0x03, 0x02, JACK_OUT_EXTERNAL, 0x01,    /* MIDI_OUT_JACK externe.  */
+    JACK_IN_EMBEDDED, 0x01, 0x00,
+
+    /* EP1 OUT bulk (descripteur audio 9 octets) + MS_GENERAL. */
+    0x09, 0x05, USB_MIDI_EP_OUT, 0x02,
+    USB_DESC_WORD(USB_MIDI_EP_SIZE), 0x00, 0x00, 0x00,
+    0x05, 0x25, 0x01, 0x01, JACK_IN_EMBEDDED,
+
+    /* EP2 IN bulk + MS_GENERAL. */
+    0x09, 0x05, (uint8_t)(0x80U | USB_MIDI_EP_IN), 0x02,
+    USB_DESC_WORD(USB_MIDI_EP_SIZE), 0x00, 0x00, 0x00,
+    0x05, 0x25, 0x01, 0x01, JACK_OUT_EMBEDDED
+};
+
+static const USBDescriptor midi_configuration_descriptor = {
+    sizeof(midi_configuration_descriptor_data),
+    midi_configuration_descriptor_data
+};
+
+static const uint8_t midi_string0[] = {
+    USB_DESC_BYTE(4),
+    USB_DESC_BYTE(USB_DESCRIPTOR_STRING),
+    USB_DESC_WORD(0x0409)              /* Anglais (US).                        */
+};
+
+static const uint8_t midi_string1[] = {
+    USB_DESC_BYTE(12),
+    USB_DESC_BYTE(USB_DESCRIPTOR_STRING),
+    'B', 0, 'r', 0, 'i', 0, 'c', 0, 'k', 0
+};
+
+static const uint8_t midi_string2[] = {
+    USB_DESC_BYTE(22),
+    USB_DESC_BYTE(USB_DESCRIPTOR_STRING),
+    'B', 0, 'r', 0, 'i', 0, 'c', 0, 'k', 0, ' ', 0, 'M', 0, 'I', 0, 'D', 0, 'I', 0
+};
+
+static const uint8_t midi_string3[] = {
+    USB_DESC_BYTE(10),
+    USB_DESC_BYTE(USB_DESCRIPTOR_STRING),
+    '0', 0, '0', 0, '0', 0, '1', 0
+};
+
+static const USBDescriptor midi_strings[] = {
+    {sizeof(midi_string0), midi_string0},
+    {sizeof(midi_string1), midi_string1},
+    {sizeof(midi_string2), midi_string2},
+    {sizeof(midi_string3), midi_string3}
+};
+
+static const USBDescriptor *get_descriptor(USBDriver *usbp,
+                                           uint8_t dtype,
+                                           uint8_t dindex,
+                                           uint16_t lang) {
+    (void)usbp;
+    (void)lang;
+
+    switch (dtype) {
+    case USB_DESCRIPTOR_DEVICE:
+        return &midi_device_descriptor;
+    case USB_DESCRIPTOR_CONFIGURATION:
+        return &midi_configuration_descriptor;
+    case USB_DESCRIPTOR_STRING:
+        if (dindex < 4U) {
+            return &midi_strings[dindex];
+        }
+        return NULL;
+    default:
+        return NULL;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Endpoints                                                                  */
+/* -------------------------------------------------------------------------- */
+
+static USBOutEndpointState ep1outstate;
+static USBInEndpointState ep2instate;
+
+static const USBEndpointConfig ep1config = {
+    USB_EP_MODE_TYPE_BULK,
+    NULL,
+    NULL,
+    usb_midi_out_cb,
+    0x0000,
+    USB_MIDI_EP_SIZE,
+    NULL,
+    &ep1outstate,
+    1,
+    NULL
+};
+
+static const USBEndpointConfig ep2config = {
+    USB_EP_MODE_TYPE_BULK,
+    NULL,
+    usb_midi_in_cb,
+    NULL,
+    USB_MIDI_EP_SIZE,
+    0x0000,
+    &ep2instate,
+    NULL,
+    1,
+    NULL
+};
+
+/* -------------------------------------------------------------------------- */
+/* Évènements (contexte ISR)                                                  */
+/* -------------------------------------------------------------------------- */
+
+static void usb_event(USBDriver *usbp, usbevent_t event) {
+    switch (event) {
+    case USB_EVENT_CONFIGURED:
+        chSysLockFromISR();
+        usbInitEndpointI(usbp, USB_MIDI_EP_OUT, &ep1config);
+        usbInitEndpointI(usbp, USB_MIDI_EP_IN, &ep2config);
+        usb_midi_configured_i(usbp);
+        chSysUnlockFromISR();
+        return;
+    case USB_EVENT_WAKEUP:
+        chSysLockFromISR();
+        if (usbGetDriverStateI(usbp) == USB_ACTIVE) {
+            usb_midi_configured_i(usbp);
+        }
+        chSysUnlockFromISR();
+        return;
+    case USB_EVENT_RESET:
+    case USB_EVENT_UNCONFIGURED:
+    case USB_EVENT_SUSPEND:
+        chSysLockFromISR();
+        usb_midi_disconnected_i();
+        chSysUnlockFromISR();
+        return;
+    case USB_EVENT_ADDRESS:
+    case USB_EVENT_STALLED:
+    default:
+        return;
+    }
+}
+
+const USBConfig usbcfg = {
+    usb_event,
+    get_descriptor,
+    NULL,
+    NULL
+};
@@ -0,0 +1,27 @@
+/**
+ * @file usbcfg.h
+ * @brief Configuration de la pile USB : périphérique USB-MIDI 1.0 (classe Audio / MIDIStreaming).
+ * @details Interface AudioControl vide + interface MIDIStreaming à un câble,
+ * EP1 OUT et EP2 IN en bulk 64 octets. Sur H743, USBD1 (OTG1 côté ChibiOS)
+ * est la cellule OTG_FS câblée sur PA11/PA12, VBUS sur PA9.
+ *
+ * @ingroup drivers
+ */
+
+#ifndef USBCFG_H
+#define USBCFG_H
+
+#include "ch.h"
+#include "hal.h"
+
+#define USB_MIDI_DRIVER          USBD1
+#define USB_MIDI_EP_OUT          1U
+#define USB_MIDI_EP_IN           2U
+
+/* VID/PID de développement (pid.codes) : à remplacer par l'identifiant produit. */
+#define USB_MIDI_VID             0x1209U
+#define USB_MIDI_PID             0x0001U
+
+extern const USBConfig usbcfg;
+
+#endif /* USBCFG_H */
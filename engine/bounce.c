@@ -0,0 +1,188 @@
+/**
+ * @file bounce.c
+ * @brief Boucle de rendu hors ligne et écriture WAV en blocs bruts.
+ * @ingroup engine
+ */
+
+#include "bounce.h"
+#include "drv_storage.h"
+#include "mod_matrix.h"
+#include "seq_engine.h"
+#include <string.h>
+
+#define BOUNCE_FRAME_BYTES    (BOUNCE_CHANNELS * BOUNCE_BYTES_PER_SAMPLE)
+#define BOUNCE_CHUNK_BYTES    (BOUNCE_CHUNK_BLOCKS * STORAGE_BLOCK_SIZE)
+#define BOUNCE_MAX_FRAMES     \
+    ((((uint64_t)STORAGE_BOUNCE_BLOCKS * STORAGE_BLOCK_SIZE) - BOUNCE_WAV_HEADER_SIZE) / \
+     BOUNCE_FRAME_BYTES)
+
+/* Fréquence du compteur de cycles (DWT) utilisé par chSysGetRealtimeCounterX. */
+#define BOUNCE_CYCLES_PER_S   STM32_CORE_CK
+
+BRICK_STATIC_ASSERT(BOUNCE_WAV_HEADER_SIZE <= STORAGE_BLOCK_SIZE, bounce_header_too_large);
+
+/*
+ * Buffer IDMA : l'IDMA de SDMMC1 n'accède qu'à l'AXI SRAM (RAM par défaut).
+ * Ni l'en-tête ni le chunk ne sont multiples d'un échantillon (3 octets) :
+ * celui qui chevauche la fin du chunk est écrit en entier dans la marge, puis
+ * reporté en tête du chunk suivant.
+ */
+static uint8_t bounce_chunk[BOUNCE_CHUNK_BYTES + BOUNCE_BYTES_PER_SAMPLE] __attribute__((aligned(32)));
+static uint8_t bounce_head_block[STORAGE_BLOCK_SIZE] __attribute__((aligned(32)));
+
+static int32_t bounce_adc[AUDIO_FRAMES_PER_BUFFER][AUDIO_NUM_INPUT_CHANNELS];
+static int32_t bounce_dac[AUDIO_FRAMES_PER_BUFFER][AUDIO_NUM_OUTPUT_CHANNELS];
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v & 0xFFU);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v & 0xFFU);
+    p[1] = (uint8_t)((v >> 8) & 0xFFU);
+    p[2] = (uint8_t)((v >> 16) & 0xFFU);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* En-tête WAVE_FORMAT_EXTENSIBLE (obligatoire au-delà de 2 canaux / 16 bits). */
+static void wav_header_build(uint8_t *h, uint32_t data_bytes) {
+    static const uint8_t pcm_guid_tail[14] = {
+        0x00U, 0x00U, 0x00U, 0x00U, 0x10U, 0x00U, 0x80U,
+        0x00U, 0x00U, 0xAAU, 0x00U, 0x38U, 0x9BU, 0x71U
+    };
+
+    memcpy(&h[0], "RIFF", 4U);
+    put_le32(&h[4], (BOUNCE_WAV_HEADER_SIZE - 8U) + data_bytes);
+    memcpy(&h[8], "WAVE", 4U);
+
+    memcpy(&h[12], "fmt ", 4U);
+    put_le32(&h[16], 40U);
+    put_le16(&h[20], 0xFFFEU);                                  /* EXTENSIBLE. */
+    put_le16(&h[22], BOUNCE_CHANNELS);
+    put_le32(&h[24], AUDIO_SAMPLE_RATE_HZ);
+    put_le32(&h[28], AUDIO_SAMPLE_RATE_HZ * BOUNCE_FRAME_BYTES);
+    put_le16(&h[32], BOUNCE_FRAME_BYTES);
+    put_le16(&h[34], BOUNCE_BYTES_PER_SAMPLE * 8U);
+    put_le16(&h[36], 22U);
+    put_le16(&h[38], BOUNCE_BYTES_PER_SAMPLE * 8U);            /* Bits valides. */
+    put_le32(&h[40], (1UL << BOUNCE_CHANNELS) - 1U);           /* FL FR FC LFE… */
+    put_le16(&h[44], 0x0001U);                                  /* KSDATAFORMAT_SUBTYPE_PCM. */
+    memcpy(&h[46], pcm_guid_tail, sizeof(pcm_guid_tail));
+
+    memcpy(&h[60], "data", 4U);
+    put_le32(&h[64], data_bytes);
+}
+
+static uint32_t speed_x100(uint32_t frames, uint64_t cycles) {
+    if (cycles == 0U) {
+        cycles = 1U;
+    }
+    return (uint32_t)(((uint64_t)frames * 100U * BOUNCE_CYCLES_PER_S) /
+                      ((uint64_t)AUDIO_SAMPLE_RATE_HZ * cycles));
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+bool bounce_run(uint32_t frames, bool write_sd, bounce_result_t *res) {
+    bounce_result_t r;
+    memset(&r, 0, sizeof(r));
+
+    if (frames > BOUNCE_MAX_FRAMES) {
+        frames = (uint32_t)BOUNCE_MAX_FRAMES;
+    }
+    const uint32_t blocks = frames / AUDIO_FRAMES_PER_BUFFER;
+    const size_t pcm_base = AUDIO_PCM4104_SUBFRAME * AUDIO_PCM4104_CHANNELS;
+
+    if (write_sd) {
+        drv_storage_init();
+    }
+
+    const bool was_running = drv_audio_is_running();
+    if (was_running) {
+        drv_audio_stop();
+    }
+
+    /* Même point de départ à chaque rendu : modulation, lignes à retard, DSP, séquenceur. */
+    memset(bounce_adc, 0, sizeof(bounce_adc));
+    mod_matrix_reset();
+    (void)drv_audio_reset_render();
+    seq_engine_start();
+
+    /* L'en-tête définitif est réécrit à la fin, tailles connues. */
+    uint32_t fill = BOUNCE_WAV_HEADER_SIZE;
+    uint32_t lba = STORAGE_BOUNCE_BASE_LBA;
+    memset(bounce_chunk, 0, BOUNCE_WAV_HEADER_SIZE);
+
+    for (uint32_t b = 0U; (b < blocks) && !r.write_error; ++b) {
+        const rtcnt_t t0 = chSysGetRealtimeCounterX();
+        if (!drv_audio_render_block(&bounce_adc[0][0], &bounce_dac[0][0])) {
+            break;
+        }
+        const rtcnt_t t1 = chSysGetRealtimeCounterX();
+        r.dsp_cycles += (rtcnt_t)(t1 - t0);
+
+        /* int32 (24 bits utiles) -> 24 bits little-endian entrelacés. */
+        for (size_t n = 0U; n < AUDIO_FRAMES_PER_BUFFER; ++n) {
+            for (size_t c = 0U; c < BOUNCE_CHANNELS; ++c) {
+                const int32_t v = bounce_dac[n][pcm_base + c];
+                bounce_chunk[fill++] = (uint8_t)((uint32_t)v & 0xFFU);
+                bounce_chunk[fill++] = (uint8_t)(((uint32_t)v >> 8) & 0xFFU);
+                bounce_chunk[fill++] = (uint8_t)(((uint32_t)v >> 16) & 0xFFU);
+                if (fill >= BOUNCE_CHUNK_BYTES) {
+                    if (write_sd) {
+                        if (lba == STORAGE_BOUNCE_BASE_LBA) {
+                            memcpy(bounce_head_block, bounce_chunk, STORAGE_BLOCK_SIZE);
+                        }
+                        r.write_error = !drv_storage_write(lba, bounce_chunk, BOUNCE_CHUNK_BLOCKS);
+                    }
+                    lba += BOUNCE_CHUNK_BLOCKS;
+                    fill -= BOUNCE_CHUNK_BYTES;
+                    memcpy(bounce_chunk, &bounce_chunk[BOUNCE_CHUNK_BYTES], fill);
+                }
+            }
+        }
+        r.frames += AUDIO_FRAMES_PER_BUFFER;
+        r.total_cycles += (rtcnt_t)(chSysGetRealtimeCounterX() - t0);
+    }
+
+    seq_engine_stop();
+
+    r.data_bytes = r.frames * BOUNCE_FRAME_BYTES;
+    if (write_sd && !r.write_error) {
+        const rtcnt_t t0 = chSysGetRealtimeCounterX();
+        const uint32_t tail_blocks = (fill + STORAGE_BLOCK_SIZE - 1U) / STORAGE_BLOCK_SIZE;
+        memset(&bounce_chunk[fill], 0, (tail_blocks * STORAGE_BLOCK_SIZE) - fill);
+        if (lba == STORAGE_BOUNCE_BASE_LBA) {
+            memcpy(bounce_head_block, bounce_chunk, STORAGE_BLOCK_SIZE);
+        }
+        if ((tail_blocks > 0U) && (lba != STORAGE_BOUNCE_BASE_LBA)) {
+            r.write_error = !drv_storage_write(lba, bounce_chunk, tail_blocks);
+        }
+
+        wav_header_build(bounce_head_block, r.data_bytes);
+        if (!r.write_error) {
+            r.write_error = !drv_storage_write(STORAGE_BOUNCE_BASE_LBA, bounce_head_block, 1U);
+        }
+        /* Rendu court tenant dans le premier bloc : reste du premier chunk. */
+        if (!r.write_error && (lba == STORAGE_BOUNCE_BASE_LBA) && (tail_blocks > 1U)) {
+            r.write_error = !drv_storage_write(STORAGE_BOUNCE_BASE_LBA + 1U,
+                                               &bounce_chunk[STORAGE_BLOCK_SIZE],
+                                               tail_blocks - 1U);
+        }
+        r.total_cycles += (rtcnt_t)(chSysGetRealtimeCounterX() - t0);
+    }
+
+    r.dsp_speed_x100 = speed_x100(r.frames, r.dsp_cycles);
+    r.total_speed_x100 = speed_x100(r.frames, r.total_cycles);
+
+    if (was_running) {
+        drv_audio_start();
+    }
+    if (res != NULL) {
+        *res = r;
+    }
+    return !r.write_error && (r.frames == (blocks * AUDIO_FRAMES_PER_BUFFER));
+}
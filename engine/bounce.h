@@ -0,0 +1,50 @@
+/**
+ * @file bounce.h
+ * @brief Rendu hors ligne (bounce) plus rapide que le temps réel.
+ * @details Le flux SAI/DMA est suspendu et la chaîne complète (hook de
+ * contrôle : séquenceur, modulation ; puis drv_audio_process_block) est
+ * cadencée par une horloge logicielle, bloc après bloc, aussi vite que le
+ * CPU le permet. Les sorties PCM4104 sont écrites dans un WAV multicanal
+ * 24 bits sur la zone SD dédiée (STORAGE_BOUNCE_BASE_LBA).
+ *
+ * Sans écriture SD, le même appel sert de banc de mesure déterministe du
+ * moteur complet : entrées ADC silencieuses ; modulation, lignes à retard
+ * d'alignement et DSP (drv_audio_reset_render) remis à zéro et séquenceur
+ * réensemencé au démarrage ; débit exprimé en multiple du temps réel.
+ *
+ * Fonction bloquante, à appeler depuis un thread de basse priorité ; le flux
+ * temps réel est relancé à la fin s'il tournait.
+ *
+ * @ingroup engine
+ */
+
+#ifndef BOUNCE_H
+#define BOUNCE_H
+
+#include "ch.h"
+#include "drv_audio.h"
+
+#define BOUNCE_CHANNELS           AUDIO_PCM4104_CHANNELS
+#define BOUNCE_BYTES_PER_SAMPLE   3U
+#define BOUNCE_WAV_HEADER_SIZE    68U      /* RIFF + fmt (EXTENSIBLE) + en-tête data. */
+
+/** Blocs SD écrits par transaction. */
+#define BOUNCE_CHUNK_BLOCKS       32U
+
+typedef struct {
+    uint32_t frames;              /* Frames effectivement rendues. */
+    uint32_t data_bytes;          /* Taille du chunk data du WAV. */
+    uint64_t dsp_cycles;          /* Cycles CPU passés dans la chaîne audio. */
+    uint64_t total_cycles;        /* Idem + mise en forme et écritures SD. */
+    uint32_t dsp_speed_x100;      /* Multiple du temps réel (×100), DSP seul. */
+    uint32_t total_speed_x100;    /* Multiple du temps réel (×100), bounce complet. */
+    bool     write_error;
+} bounce_result_t;
+
+/*
+ * Rend `frames` frames (arrondi au bloc). `write_sd` = false : mesure seule.
+ * Retourne false en cas d'erreur d'écriture ou si le rendu est impossible.
+ */
+bool bounce_run(uint32_t frames, bool write_sd, bounce_result_t *res);
+
+#endif /* BOUNCE_H */
@@ -0,0 +1,477 @@
+/**
+ * @file mod_matrix.c
+ * @brief Implémentation de la matrice de modulation (structure-de-tableaux).
+ * @ingroup engine
+ */
+
+#include "mod_matrix.h"
+#include <string.h>
+
+/* -------------------------------------------------------------------------- */
+/* Constantes internes                                                        */
+/* -------------------------------------------------------------------------- */
+
+/* Niveau d'enveloppe en Q23 (Q15 << 8) pour garder de la résolution sur les rampes lentes. */
+#define ENV_LEVEL_SHIFT       8
+#define ENV_LEVEL_FULL        ((int32_t)32767 << ENV_LEVEL_SHIFT)
+
+#define MOD_PARAM_MAX         65535
+
+typedef enum {
+    ENV_IDLE = 0,
+    ENV_ATTACK,
+    ENV_DECAY,
+    ENV_SUSTAIN,
+    ENV_RELEASE
+} env_stage_t;
+
+/* -------------------------------------------------------------------------- */
+/* État (structure-de-tableaux)                                               */
+/* -------------------------------------------------------------------------- */
+/*
+ * Chaque champ est un tableau contigu : les boucles de process_block
+ * parcourent la mémoire séquentiellement, sans indirection par objet.
+ * Les écritures de configuration se font sous chSysLock() afin que le thread
+ * audio (plus prioritaire) ne voie jamais un routage ou une source à moitié
+ * mis à jour.
+ */
+
+static struct {
+    uint32_t phase[MOD_NUM_LFOS];
+    uint32_t inc[MOD_NUM_LFOS];        /* Incrément de phase par échantillon. */
+    uint32_t rng[MOD_NUM_LFOS];        /* État xorshift32 (sample & hold). */
+    int16_t  held[MOD_NUM_LFOS];
+    uint8_t  shape[MOD_NUM_LFOS];
+} lfo;
+
+static struct {
+    int32_t  level[MOD_NUM_ENVS];      /* Q23. */
+    int32_t  attack_inc[MOD_NUM_ENVS]; /* Incréments par échantillon (Q23). */
+    int32_t  decay_inc[MOD_NUM_ENVS];
+    int32_t  release_inc[MOD_NUM_ENVS];
+    int32_t  sustain[MOD_NUM_ENVS];    /* Q23. */
+    uint8_t  stage[MOD_NUM_ENVS];
+} env;
+
+static struct {
+    uint8_t  src[MOD_NUM_ROUTES];
+    uint8_t  dest[MOD_NUM_ROUTES];
+    int16_t  depth[MOD_NUM_ROUTES];
+} route;
+
+static struct {
+    uint16_t param[MOD_NUM_DESTS];
+    uint16_t base[MOD_NUM_DESTS];
+    uint16_t threshold[MOD_NUM_DESTS];
+    int32_t  sent[MOD_NUM_DESTS];      /* Dernière valeur émise, -1 = jamais. */
+    uint8_t  target[MOD_NUM_DESTS];
+    bool     force[MOD_NUM_DESTS];     /* Base modifiée : émettre même sous le seuil. */
+} dest;
+
+/* Valeurs calculées du bloc courant. */
+static int16_t src_value[MOD_NUM_SOURCES];
+static int32_t dest_accum[MOD_NUM_DESTS];
+
+/* Destination par laquelle commence l'émission du prochain bloc (round-robin). */
+static uint8_t emit_start = 0U;
+
+static mod_output_cb_t output_cb = NULL;
+static mod_matrix_stats_t stats;
+
+/* -------------------------------------------------------------------------- */
+/* Helpers                                                                    */
+/* -------------------------------------------------------------------------- */
+
+static inline uint32_t xorshift32(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static inline int32_t clamp_param(int32_t v) {
+    if (v < 0) {
+        return 0;
+    }
+    if (v > MOD_PARAM_MAX) {
+        return MOD_PARAM_MAX;
+    }
+    return v;
+}
+
+/* Convertit une durée en incrément Q23 par échantillon (0 ms => instantané). */
+static int32_t env_ms_to_inc(uint16_t ms) {
+    const uint32_t samples = ((uint32_t)ms * (uint32_t)BRICK_AUDIO_SAMPLE_RATE) / 1000U;
+    if (samples == 0U) {
+        return ENV_LEVEL_FULL;
+    }
+    const int32_t inc = ENV_LEVEL_FULL / (int32_t)samples;
+    return (inc > 0) ? inc : 1;
+}
+
+/*
+ * Sinus parabolique en Q15 : y = 4x(1-|x|) puis correction y += 0.225(y|y| - y).
+ * Erreur < 0.1 %, aucune table ni multiplication flottante.
+ */
+static inline int16_t lfo_sine(uint32_t phase) {
+    const int32_t x = (int32_t)(phase >> 16) - 32768;
+    const int32_t ax = (x < 0) ? -x : x;
+    int32_t y = (4 * x * (32768 - ax)) >> 15;
+    const int32_t ay = (y < 0) ? -y : y;
+    y += (7373 * (((y * ay) >> 15) - y)) >> 15;
+    if (y > 32767) {
+        y = 32767;
+    }
+    if (y < -32768) {
+        y = -32768;
+    }
+    return (int16_t)y;
+}
+
+static inline int16_t lfo_eval(uint8_t i, bool wrapped) {
+    const uint32_t p = lfo.phase[i];
+    const int32_t u = (int32_t)(p >> 16);
+
+    switch ((mod_lfo_shape_t)lfo.shape[i]) {
+    case MOD_LFO_SINE:
+        return lfo_sine(p);
+    case MOD_LFO_TRIANGLE:
+        return (int16_t)((u < 32768) ? ((u * 2) - 32768) : (32767 - ((u - 32768) * 2)));
+    case MOD_LFO_SAW:
+        return (int16_t)(u - 32768);
+    case MOD_LFO_SQUARE:
+        return (p < 0x80000000U) ? (int16_t)32767 : (int16_t)-32768;
+    case MOD_LFO_SAMPLE_HOLD:
+    default:
+        if (wrapped) {
+            lfo.rng[i] = xorshift32(lfo.rng[i]);
+            lfo.held[i] = (int16_t)(lfo.rng[i] >> 16);
+        }
+        return lfo.held[i];
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+/* Graine déterministe et non nulle : rendu reproductible. */
+static void mod_seed_lfo(uint8_t i) {
+    lfo.rng[i] = 0x9E3779B9U ^ ((uint32_t)i * 0x85EBCA6BU);
+    if (lfo.rng[i] == 0U) {
+        lfo.rng[i] = 1U;
+    }
+}
+
+void mod_matrix_init(void) {
+    memset(&lfo, 0, sizeof(lfo));
+    memset(&env, 0, sizeof(env));
+    memset(&stats, 0, sizeof(stats));
+    memset(src_value, 0, sizeof(src_value));
+
+    for (uint8_t i = 0U; i < MOD_NUM_LFOS; ++i) {
+        mod_seed_lfo(i);
+        lfo.shape[i] = (uint8_t)MOD_LFO_SINE;
+    }
+
+    for (uint8_t i = 0U; i < MOD_NUM_ENVS; ++i) {
+        env.attack_inc[i] = ENV_LEVEL_FULL;
+        env.decay_inc[i] = ENV_LEVEL_FULL;
+        env.release_inc[i] = ENV_LEVEL_FULL;
+        env.sustain[i] = ENV_LEVEL_FULL;
+        env.stage[i] = (uint8_t)ENV_IDLE;
+    }
+
+    for (uint8_t r = 0U; r < MOD_NUM_ROUTES; ++r) {
+        route.src[r] = MOD_SRC_NONE;
+        route.dest[r] = 0U;
+        route.depth[r] = 0;
+    }
+
+    for (uint8_t d = 0U; d < MOD_NUM_DESTS; ++d) {
+        dest.target[d] = MOD_TARGET_NONE;
+        dest.param[d] = 0U;
+        dest.base[d] = 0U;
+        dest.threshold[d] = MOD_DEFAULT_THRESHOLD;
+        dest.sent[d] = -1;
+        dest.force[d] = false;
+    }
+
+    emit_start = 0U;
+}
+
+void mod_matrix_reset(void) {
+    chSysLock();
+    for (uint8_t i = 0U; i < MOD_NUM_LFOS; ++i) {
+        lfo.phase[i] = 0U;
+        lfo.held[i] = 0;
+        mod_seed_lfo(i);
+    }
+    for (uint8_t i = 0U; i < MOD_NUM_ENVS; ++i) {
+        env.level[i] = 0;
+        env.stage[i] = (uint8_t)ENV_IDLE;
+    }
+    for (uint8_t d = 0U; d < MOD_NUM_DESTS; ++d) {
+        dest.sent[d] = -1;
+        dest.force[d] = false;
+    }
+    memset(src_value, 0, sizeof(src_value));
+    memset(dest_accum, 0, sizeof(dest_accum));
+    emit_start = 0U;
+    chSysUnlock();
+}
+
+void mod_matrix_set_output_cb(mod_output_cb_t cb) {
+    output_cb = cb;
+}
+
+void mod_matrix_lfo_config(uint8_t i, mod_lfo_shape_t shape, uint32_t rate_mhz) {
+    if (i >= MOD_NUM_LFOS) {
+        return;
+    }
+    /* inc = rate * 2^32 / Fs, avec rate en mHz. */
+    const uint32_t inc = (uint32_t)(((uint64_t)rate_mhz << 32) /
+                                    ((uint64_t)BRICK_AUDIO_SAMPLE_RATE * 1000U));
+    chSysLock();
+    lfo.shape[i] = (uint8_t)shape;
+    lfo.inc[i] = inc;
+    chSysUnlock();
+}
+
+void mod_matrix_lfo_retrigger(uint8_t i) {
+    if (i >= MOD_NUM_LFOS) {
+        return;
+    }
+    chSysLock();
+    lfo.phase[i] = 0U;
+    chSysUnlock();
+}
+
+void mod_matrix_env_config(uint8_t i,
+                           uint16_t attack_ms,
+                           uint16_t decay_ms,
+                           int16_t  sustain,
+                           uint16_t release_ms) {
+    if (i >= MOD_NUM_ENVS) {
+        return;
+    }
+    if (sustain < 0) {
+        sustain = 0;
+    }
+    const int32_t a = env_ms_to_inc(attack_ms);
+    const int32_t d = env_ms_to_inc(decay_ms);
+    const int32_t r = env_ms_to_inc(release_ms);
+
+    chSysLock();
+    env.attack_inc[i] = a;
+    env.decay_inc[i] = d;
+    env.release_inc[i] = r;
+    env.sustain[i] = (int32_t)sustain << ENV_LEVEL_SHIFT;
+    chSysUnlock();
+}
+
+void mod_matrix_env_gate(uint8_t i, bool on) {
+    if (i >= MOD_NUM_ENVS) {
+        return;
+    }
+    chSysLock();
+    if (on) {
+        env.stage[i] = (uint8_t)ENV_ATTACK;
+    } else if (env.stage[i] != (uint8_t)ENV_IDLE) {
+        env.stage[i] = (uint8_t)ENV_RELEASE;
+    }
+    chSysUnlock();
+}
+
+bool mod_matrix_dest_config(uint8_t d, uint8_t target, uint16_t param,
+                            uint16_t base, uint16_t threshold) {
+    if (d >= MOD_NUM_DESTS) {
+        return false;
+    }
+    if ((target != MOD_TARGET_ENGINE) && (target != MOD_TARGET_NONE) &&
+        (target >= BRICK_MAX_CARTRIDGES)) {
+        return false;
+    }
+    chSysLock();
+    dest.target[d] = target;
+    dest.param[d] = param;
+    dest.base[d] = base;
+    dest.threshold[d] = (threshold == 0U) ? 1U : threshold;
+    dest.sent[d] = -1;
+    dest.force[d] = false;
+    chSysUnlock();
+    return true;
+}
+
+void mod_matrix_dest_set_base(uint8_t d, uint16_t base) {
+    if (d >= MOD_NUM_DESTS) {
+        return;
+    }
+    chSysLock();
+    dest.base[d] = base;
+    dest.force[d] = true;
+    chSysUnlock();
+}
+
+bool mod_matrix_route_set(uint8_t r, uint8_t src, uint8_t d, int16_t depth) {
+    if ((r >= MOD_NUM_ROUTES) || (src >= MOD_NUM_SOURCES) || (d >= MOD_NUM_DESTS)) {
+        return false;
+    }
+    chSysLock();
+    route.src[r] = src;
+    route.dest[r] = d;
+    route.depth[r] = depth;
+    chSysUnlock();
+    return true;
+}
+
+void mod_matrix_route_clear(uint8_t r) {
+    if (r >= MOD_NUM_ROUTES) {
+        return;
+    }
+    chSysLock();
+    route.src[r] = MOD_SRC_NONE;
+    chSysUnlock();
+}
+
+int16_t mod_matrix_get_source(uint8_t src) {
+    if (src >= MOD_NUM_SOURCES) {
+        return 0;
+    }
+    return src_value[src];
+}
+
+void mod_matrix_get_stats(mod_matrix_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = stats;
+    chSysUnlock();
+}
+
+/* -------------------------------------------------------------------------- */
+/* Évaluation par bloc                                                        */
+/* -------------------------------------------------------------------------- */
+
+static void mod_eval_lfos(uint32_t frames) {
+    for (uint8_t i = 0U; i < MOD_NUM_LFOS; ++i) {
+        const uint32_t prev = lfo.phase[i];
+        lfo.phase[i] = prev + (lfo.inc[i] * frames);
+        src_value[i] = lfo_eval(i, lfo.phase[i] < prev);
+    }
+}
+
+static void mod_eval_envs(int32_t frames) {
+    int16_t *out = &src_value[MOD_NUM_LFOS];
+
+    for (uint8_t i = 0U; i < MOD_NUM_ENVS; ++i) {
+        int32_t level = env.level[i];
+
+        switch ((env_stage_t)env.stage[i]) {
+        case ENV_ATTACK:
+            level += env.attack_inc[i] * frames;
+            if (level >= ENV_LEVEL_FULL) {
+                level = ENV_LEVEL_FULL;
+                env.stage[i] = (uint8_t)ENV_DECAY;
+            }
+            break;
+        case ENV_DECAY:
+            level -= env.decay_inc[i] * frames;
+            if (level <= env.sustain[i]) {
+                level = env.sustain[i];
+                env.stage[i] = (uint8_t)ENV_SUSTAIN;
+            }
+            break;
+        case ENV_SUSTAIN:
+            level = env.sustain[i];
+            break;
+        case ENV_RELEASE:
+            level -= env.release_inc[i] * frames;
+            if (level <= 0) {
+                level = 0;
+                env.stage[i] = (uint8_t)ENV_IDLE;
+            }
+            break;
+        case ENV_IDLE:
+        default:
+            level = 0;
+            break;
+        }
+
+        env.level[i] = level;
+        out[i] = (int16_t)(level >> ENV_LEVEL_SHIFT);
+    }
+}
+
+static void mod_accumulate(void) {
+    for (uint8_t d = 0U; d < MOD_NUM_DESTS; ++d) {
+        dest_accum[d] = (int32_t)dest.base[d];
+    }
+
+    /* Q15 × Q15 = Q30 ; >> 14 ramène une excursion pleine échelle à ±65535. */
+    for (uint8_t r = 0U; r < MOD_NUM_ROUTES; ++r) {
+        const uint8_t s = route.src[r];
+        if (s == MOD_SRC_NONE) {
+            continue;
+        }
+        dest_accum[route.dest[r]] += ((int32_t)src_value[s] * (int32_t)route.depth[r]) >> 14;
+    }
+}
+
+static void mod_emit(void) {
+    uint8_t budget = MOD_MAX_UPDATES_PER_BLOCK;
+    uint8_t next_start = emit_start;
+    bool deferred = false;
+
+    for (uint8_t k = 0U; k < MOD_NUM_DESTS; ++k) {
+        const uint8_t d = (uint8_t)((emit_start + k) % MOD_NUM_DESTS);
+        if (dest.target[d] == MOD_TARGET_NONE) {
+            continue;
+        }
+
+        const int32_t v = clamp_param(dest_accum[d]);
+        const int32_t last = dest.sent[d];
+        if (v == last) {
+            dest.force[d] = false;
+            continue;
+        }
+
+        const int32_t diff = (last < 0) ? MOD_PARAM_MAX : ((v > last) ? (v - last) : (last - v));
+        /* Les butées sont toujours atteintes exactement, même sous le seuil. */
+        const bool at_edge = (v == 0) || (v == MOD_PARAM_MAX);
+        if ((diff < (int32_t)dest.threshold[d]) && !dest.force[d] && !at_edge) {
+            stats.updates_filtered++;
+            continue;
+        }
+
+        if (budget == 0U) {
+            stats.updates_deferred++;
+            if (!deferred) {
+                /* Le prochain bloc reprend à la première destination reportée. */
+                next_start = d;
+                deferred = true;
+            }
+            continue;
+        }
+
+        output_cb(dest.target[d], dest.param[d], (uint16_t)v);
+        dest.sent[d] = v;
+        dest.force[d] = false;
+        stats.updates_sent++;
+        budget--;
+    }
+
+    emit_start = deferred ? next_start : (uint8_t)((emit_start + 1U) % MOD_NUM_DESTS);
+}
+
+void mod_matrix_process_block(size_t frames) {
+    mod_eval_lfos((uint32_t)frames);
+    mod_eval_envs((int32_t)frames);
+    mod_accumulate();
+
+    if (output_cb != NULL) {
+        mod_emit();
+    }
+    stats.blocks++;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file mod_matrix.h
+ * @brief Matrice de modulation à cadence contrôle (LFO + enveloppes par piste).
+ * @details Les sources (LFO, enveloppes) et les routages sont stockés en
+ * structure-de-tableaux et évalués une fois par bloc audio depuis le hook de
+ * contrôle de drv_audio. Chaque destination ne produit une mise à jour vers
+ * la cartouche ou le moteur interne que lorsque sa valeur modulée s'écarte
+ * de la dernière valeur envoyée d'au moins son seuil : le coût par bloc et
+ * la bande passante SPI-LINK restent bornés quel que soit le nombre de
+ * routages actifs.
+ *
+ * Représentation des valeurs :
+ *  - sources   : Q15 bipolaire [-32768, 32767] (enveloppes : [0, 32767]) ;
+ *  - profondeur: Q15 signée, 32767 = excursion pleine échelle ;
+ *  - paramètres: 16 bits non signés [0, 65535].
+ *
+ * @ingroup engine
+ */
+
+#ifndef MOD_MATRIX_H
+#define MOD_MATRIX_H
+
+#include "ch.h"
+#include "brick_config.h"
+
+/* -------------------------------------------------------------------------- */
+/* Dimensions                                                                 */
+/* -------------------------------------------------------------------------- */
+
+#define MOD_NUM_LFOS          (BRICK_NUM_TRACKS * BRICK_MOD_LFOS_PER_TRACK)
+#define MOD_NUM_ENVS          (BRICK_NUM_TRACKS * BRICK_MOD_ENVS_PER_TRACK)
+#define MOD_NUM_SOURCES       (MOD_NUM_LFOS + MOD_NUM_ENVS)
+#define MOD_NUM_ROUTES        BRICK_MOD_MAX_ROUTES
+#define MOD_NUM_DESTS         BRICK_MOD_MAX_DESTS
+
+/** Nombre maximal de mises à jour émises par bloc (borne la charge SPI-LINK). */
+#define MOD_MAX_UPDATES_PER_BLOCK  8U
+
+/** Seuil par défaut (en pas de paramètre 16 bits) : ~0.1 % de l'échelle. */
+#define MOD_DEFAULT_THRESHOLD      64U
+
+/** Index de source invalide / routage libre. */
+#define MOD_SRC_NONE          0xFFU
+
+/** Cibles d'une destination : 0..BRICK_MAX_CARTRIDGES-1 = cartouche. */
+#define MOD_TARGET_ENGINE     0xFEU
+#define MOD_TARGET_NONE       0xFFU
+
+/** Index de source d'un LFO / d'une enveloppe d'une piste. */
+#define MOD_SRC_LFO(track, n) ((uint8_t)((track) * BRICK_MOD_LFOS_PER_TRACK + (n)))
+#define MOD_SRC_ENV(track, n) ((uint8_t)(MOD_NUM_LFOS + (track) * BRICK_MOD_ENVS_PER_TRACK + (n)))
+
+/* -------------------------------------------------------------------------- */
+/* Types                                                                      */
+/* -------------------------------------------------------------------------- */
+
+typedef enum {
+    MOD_LFO_SINE = 0,
+    MOD_LFO_TRIANGLE,
+    MOD_LFO_SAW,
+    MOD_LFO_SQUARE,
+    MOD_LFO_SAMPLE_HOLD
+} mod_lfo_shape_t;
+
+/**
+ * @brief Sortie d'une destination modulée (appelée depuis le thread audio).
+ * @param target  cartouche (0..3) ou MOD_TARGET_ENGINE.
+ * @param param   identifiant du paramètre côté cible.
+ * @param value   valeur modulée sur 16 bits.
+ */
+typedef void (*mod_output_cb_t)(uint8_t target, uint16_t param, uint16_t value);
+
+typedef struct {
+    uint32_t blocks;            /* Blocs évalués. */
+    uint32_t updates_sent;      /* Mises à jour émises vers les cibles. */
+    uint32_t updates_filtered;  /* Variations inférieures au seuil. */
+    uint32_t updates_deferred;  /* Reportées faute de budget dans le bloc. */
+} mod_matrix_stats_t;
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void mod_matrix_init(void);
+void mod_matrix_set_output_cb(mod_output_cb_t cb);
+
+/*
+ * État courant remis comme à l'initialisation (phases, graines, enveloppes,
+ * valeurs émises), configuration conservée : rendu hors ligne reproductible.
+ */
+void mod_matrix_reset(void);
+
+/* Sources. La fréquence est exprimée en milli-hertz (0.001 Hz de résolution). */
+void mod_matrix_lfo_config(uint8_t lfo, mod_lfo_shape_t shape, uint32_t rate_mhz);
+void mod_matrix_lfo_retrigger(uint8_t lfo);
+void mod_matrix_env_config(uint8_t env,
+                           uint16_t attack_ms,
+                           uint16_t decay_ms,
+                           int16_t  sustain,
+                           uint16_t release_ms);
+void mod_matrix_env_gate(uint8_t env, bool on);
+
+/* Destinations et routages. */
+bool mod_matrix_dest_config(uint8_t dest, uint8_t target, uint16_t param,
+                            uint16_t base, uint16_t threshold);
+void mod_matrix_dest_set_base(uint8_t dest, uint16_t base);
+bool mod_matrix_route_set(uint8_t route, uint8_t src, uint8_t dest, int16_t depth);
+void mod_matrix_route_clear(uint8_t route);
+
+/* Évaluation à cadence bloc (thread audio). */
+void mod_matrix_process_block(size_t frames);
+
+int16_t mod_matrix_get_source(uint8_t src);
+void    mod_matrix_get_stats(mod_matrix_stats_t *st);
+
+#endif /* MOD_MATRIX_H */
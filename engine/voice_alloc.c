@@ -0,0 +1,328 @@
+/**
+ * @file voice_alloc.c
+ * @brief Allocateur de voix à masques de bits : libre en tourniquet, vol borné.
+ * @ingroup engine
+ */
+
+#include "voice_alloc.h"
+#include <string.h>
+
+BRICK_STATIC_ASSERT(VOICE_ALLOC_VOICES <= 32, voice_masks_fit_32_bits);
+BRICK_STATIC_ASSERT(VOICE_ALLOC_TRACKS < VOICE_NONE, voice_track_index_fits);
+
+#define VOICE_NOTES           128U
+#define VOICE_BIT(v)          ((uint32_t)1U << (v))
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    uint8_t  track;
+    uint8_t  note;
+    uint16_t level;
+    uint32_t age;             /* Valeur de va_age à l'allocation. */
+} voice_t;
+
+static voice_t va_voice[VOICE_ALLOC_VOICES];
+
+/* Note tenue ou relâchée -> voix, par piste ; voix tenue d'une piste legato. */
+static uint8_t va_note_voice[VOICE_ALLOC_TRACKS][VOICE_NOTES];
+static uint8_t va_mono_voice[VOICE_ALLOC_TRACKS];
+
+static voice_track_cfg_t va_track[VOICE_ALLOC_TRACKS];
+static uint32_t va_reserved_all = 0U;
+
+static uint32_t va_available = 0U;
+static uint32_t va_held = 0U;
+static uint32_t va_released = 0U;
+
+/* Écrit par voice_alloc_set_cart_voices, repris au prochain appel du thread audio. */
+static volatile uint32_t va_available_req = 0U;
+
+static uint32_t va_age = 0U;
+static uint8_t va_rr = 0U;
+static voice_alloc_stats_t va_stats;
+
+/* -------------------------------------------------------------------------- */
+/* Outils                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Détache la voix de sa note : elle redevient libre. */
+static void va_unmap(uint8_t v) {
+    const voice_t *vo = &va_voice[v];
+
+    if (((va_held | va_released) & VOICE_BIT(v)) == 0U) {
+        return;
+    }
+    if (va_note_voice[vo->track][vo->note] == v) {
+        va_note_voice[vo->track][vo->note] = VOICE_NONE;
+    }
+    if (va_mono_voice[vo->track] == v) {
+        va_mono_voice[vo->track] = VOICE_NONE;
+    }
+    va_held &= ~VOICE_BIT(v);
+    va_released &= ~VOICE_BIT(v);
+}
+
+/* Cartouches retirées : leurs voix disparaissent sans note off. */
+static void va_apply_available(void) {
+    const uint32_t req = va_available_req;
+
+    if (req == va_available) {
+        return;
+    }
+    uint32_t lost = (va_held | va_released) & ~req;
+    while (lost != 0U) {
+        const uint8_t v = (uint8_t)__builtin_ctz(lost);
+        lost &= lost - 1U;
+        va_unmap(v);
+    }
+    va_available = req;
+}
+
+/* Première voix libre à partir du tourniquet. */
+static uint8_t va_pick_free(uint32_t idle) {
+    const uint32_t r = va_rr;
+    const uint32_t rot = (r == 0U) ? idle : ((idle >> r) | (idle << (32U - r)));
+    const uint8_t v = (uint8_t)((__builtin_ctz(rot) + r) & 31U);
+
+    va_rr = (uint8_t)((v + 1U) % VOICE_ALLOC_VOICES);
+    return v;
+}
+
+static uint8_t va_oldest(uint32_t mask) {
+    uint8_t best = VOICE_NONE;
+    uint32_t best_age = 0U;
+
+    while (mask != 0U) {
+        const uint8_t v = (uint8_t)__builtin_ctz(mask);
+        mask &= mask - 1U;
+        const uint32_t elapsed = va_age - va_voice[v].age;
+        if ((best == VOICE_NONE) || (elapsed > best_age)) {
+            best = v;
+            best_age = elapsed;
+        }
+    }
+    return best;
+}
+
+static uint8_t va_quietest(uint32_t mask) {
+    uint8_t best = VOICE_NONE;
+    uint16_t best_level = 0U;
+    uint32_t best_age = 0U;
+
+    while (mask != 0U) {
+        const uint8_t v = (uint8_t)__builtin_ctz(mask);
+        mask &= mask - 1U;
+        const uint16_t level = va_voice[v].level;
+        const uint32_t elapsed = va_age - va_voice[v].age;
+        if ((best == VOICE_NONE) || (level < best_level) ||
+            ((level == best_level) && (elapsed > best_age))) {
+            best = v;
+            best_level = level;
+            best_age = elapsed;
+        }
+    }
+    return best;
+}
+
+/* Voix jouant la même hauteur (toutes pistes), la plus ancienne. */
+static uint8_t va_same_note(uint32_t mask, uint8_t note) {
+    uint32_t same = 0U;
+
+    while (mask != 0U) {
+        const uint8_t v = (uint8_t)__builtin_ctz(mask);
+        mask &= mask - 1U;
+        if (va_voice[v].note == note) {
+            same |= VOICE_BIT(v);
+        }
+    }
+    return va_oldest(same);
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void voice_alloc_init(void) {
+    memset(va_voice, 0, sizeof(va_voice));
+    memset(va_note_voice, VOICE_NONE, sizeof(va_note_voice));
+    memset(va_mono_voice, VOICE_NONE, sizeof(va_mono_voice));
+    memset(&va_stats, 0, sizeof(va_stats));
+
+    for (uint8_t t = 0U; t < VOICE_ALLOC_TRACKS; ++t) {
+        va_track[t].eligible = (VOICE_ALLOC_VOICES == 32) ? 0xFFFFFFFFU
+                                                          : (VOICE_BIT(VOICE_ALLOC_VOICES) - 1U);
+        va_track[t].reserved = 0U;
+        va_track[t].steal = VOICE_STEAL_OLDEST;
+        va_track[t].legato = false;
+    }
+    va_reserved_all = 0U;
+    va_available = 0U;
+    va_available_req = 0U;
+    va_held = 0U;
+    va_released = 0U;
+    va_age = 0U;
+    va_rr = 0U;
+}
+
+void voice_alloc_set_cart_voices(uint8_t cart, uint8_t voices) {
+    if (cart >= BRICK_MAX_CARTRIDGES) {
+        return;
+    }
+    if (voices > BRICK_MAX_VOICES_PER_CART) {
+        voices = BRICK_MAX_VOICES_PER_CART;
+    }
+    const uint32_t bits = (VOICE_BIT(voices) - 1U) << (cart * BRICK_MAX_VOICES_PER_CART);
+    va_available_req = (va_available_req & ~VOICE_ALLOC_CART_MASK(cart)) | bits;
+}
+
+bool voice_alloc_config_track(uint8_t track, const voice_track_cfg_t *cfg) {
+    if ((track >= VOICE_ALLOC_TRACKS) || (cfg == NULL) ||
+        ((cfg->reserved & ~cfg->eligible) != 0U)) {
+        return false;
+    }
+    const uint32_t others = va_reserved_all & ~va_track[track].reserved;
+    if ((cfg->reserved & others) != 0U) {
+        return false;
+    }
+
+    va_track[track] = *cfg;
+    va_reserved_all = others | cfg->reserved;
+    if (!cfg->legato) {
+        va_mono_voice[track] = VOICE_NONE;
+    }
+    return true;
+}
+
+bool voice_alloc_note_on(uint8_t track, uint8_t note, uint8_t velocity,
+                         voice_alloc_result_t *res) {
+    if ((track >= VOICE_ALLOC_TRACKS) || (note >= VOICE_NOTES) || (res == NULL)) {
+        return false;
+    }
+    va_apply_available();
+
+    const voice_track_cfg_t *cfg = &va_track[track];
+    const uint32_t cand = cfg->eligible & va_available & ~(va_reserved_all & ~cfg->reserved);
+    if (cand == 0U) {
+        va_stats.failures++;
+        return false;
+    }
+
+    uint8_t v = VOICE_NONE;
+    uint8_t flags = 0U;
+    const uint8_t mono = va_mono_voice[track];
+    const uint8_t same = va_note_voice[track][note];
+
+    if (cfg->legato && (mono != VOICE_NONE) && ((va_held & cand & VOICE_BIT(mono)) != 0U)) {
+        v = mono;
+        flags = VOICE_ALLOC_LEGATO;
+    } else if ((same != VOICE_NONE) && ((cand & VOICE_BIT(same)) != 0U)) {
+        v = same;
+        flags = VOICE_ALLOC_RETRIGGER;
+    } else {
+        const uint32_t idle = cand & ~(va_held | va_released);
+        if (idle != 0U) {
+            v = va_pick_free(idle);
+        } else if ((cand & va_released) != 0U) {
+            v = va_oldest(cand & va_released);
+        } else {
+            if (cfg->steal == VOICE_STEAL_QUIETEST) {
+                v = va_quietest(cand);
+            } else if (cfg->steal == VOICE_STEAL_SAME_NOTE) {
+                v = va_same_note(cand, note);
+            }
+            if (v == VOICE_NONE) {
+                v = va_oldest(cand);
+            }
+            flags = VOICE_ALLOC_STOLEN;
+        }
+    }
+
+    voice_t *vo = &va_voice[v];
+    res->prev_track = VOICE_NONE;
+    res->prev_note = VOICE_NONE;
+    if (((va_held | va_released) & VOICE_BIT(v)) != 0U) {
+        res->prev_track = vo->track;
+        res->prev_note = vo->note;
+        va_unmap(v);
+    }
+
+    vo->track = track;
+    vo->note = note;
+    vo->level = (uint16_t)((uint16_t)velocity << 9);
+    vo->age = ++va_age;
+    va_note_voice[track][note] = v;
+    if (cfg->legato) {
+        va_mono_voice[track] = v;
+    }
+    va_held |= VOICE_BIT(v);
+
+    res->voice = v;
+    res->cart = (uint8_t)(v / BRICK_MAX_VOICES_PER_CART);
+    res->cart_voice = (uint8_t)(v % BRICK_MAX_VOICES_PER_CART);
+    res->flags = flags;
+
+    va_stats.allocs++;
+    if ((flags & VOICE_ALLOC_STOLEN) != 0U) {
+        va_stats.steals++;
+    } else if ((flags & VOICE_ALLOC_LEGATO) != 0U) {
+        va_stats.legato++;
+    } else if ((flags & VOICE_ALLOC_RETRIGGER) != 0U) {
+        va_stats.retriggers++;
+    }
+    const uint8_t active = (uint8_t)__builtin_popcount(va_held);
+    if (active > va_stats.active_max) {
+        va_stats.active_max = active;
+    }
+    return true;
+}
+
+uint8_t voice_alloc_note_off(uint8_t track, uint8_t note) {
+    if ((track >= VOICE_ALLOC_TRACKS) || (note >= VOICE_NOTES)) {
+        return VOICE_NONE;
+    }
+    va_apply_available();
+
+    const uint8_t v = va_note_voice[track][note];
+    if ((v == VOICE_NONE) || ((va_held & VOICE_BIT(v)) == 0U)) {
+        return VOICE_NONE;
+    }
+    va_held &= ~VOICE_BIT(v);
+    va_released |= VOICE_BIT(v);
+    if (va_mono_voice[track] == v) {
+        va_mono_voice[track] = VOICE_NONE;
+    }
+    return v;
+}
+
+void voice_alloc_voice_idle(uint8_t voice) {
+    if (voice < VOICE_ALLOC_VOICES) {
+        va_unmap(voice);
+    }
+}
+
+void voice_alloc_set_level(uint8_t voice, uint16_t level) {
+    if (voice < VOICE_ALLOC_VOICES) {
+        va_voice[voice].level = level;
+    }
+}
+
+void voice_alloc_all_off(uint8_t track) {
+    uint32_t busy = va_held | va_released;
+
+    while (busy != 0U) {
+        const uint8_t v = (uint8_t)__builtin_ctz(busy);
+        busy &= busy - 1U;
+        if ((track >= VOICE_ALLOC_TRACKS) || (va_voice[v].track == track)) {
+            va_unmap(v);
+        }
+    }
+}
+
+void voice_alloc_get_stats(voice_alloc_stats_t *st) {
+    if (st != NULL) {
+        *st = va_stats;
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * @file voice_alloc.h
+ * @brief Allocateur global de voix sur l'ensemble des cartouches.
+ * @details Les BRICK_MAX_CARTRIDGES × BRICK_MAX_VOICES_PER_CART voix sont
+ * numérotées v = cartouche × BRICK_MAX_VOICES_PER_CART + voix et suivies par
+ * masques de bits (au plus 32 voix) : disponibles (cartouches présentes),
+ * tenues, relâchées. Allouer et libérer coûtent un nombre borné d'opérations
+ * indépendant de la densité du séquenceur :
+ *  - voix libre : une rotation et un comptage de zéros (tourniquet) ;
+ *  - note tenue d'une piste : table note -> voix par piste ;
+ *  - vol : balayage des seules voix candidates (16 au plus), les voix
+ *    relâchées (en release) avant les voix tenues.
+ *
+ * Chaque piste déclare ses voix utilisables (en pratique celles de sa
+ * cartouche) et peut s'en réserver une partie, interdite aux autres pistes.
+ * Une note rejouée sur sa piste reprend sa voix si elle sonne encore.
+ * Politique de vol par piste : plus ancienne, plus faible (niveau fourni par
+ * voice_alloc_set_level, vélocité par défaut) ou même hauteur (voix la plus
+ * ancienne jouant la même note, toutes pistes, sinon la plus ancienne). En
+ * mode legato, la piste est monophonique : une note jouée pendant qu'une
+ * autre est tenue reprend la même voix sans réattaque.
+ *
+ * Non réentrant : toutes les fonctions sont appelées depuis le thread audio
+ * (séquenceur), sauf voice_alloc_set_cart_voices, appliquée au prochain
+ * appel. Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup engine
+ */
+
+#ifndef VOICE_ALLOC_H
+#define VOICE_ALLOC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "brick_config.h"
+
+#define VOICE_ALLOC_VOICES            (BRICK_MAX_CARTRIDGES * BRICK_MAX_VOICES_PER_CART)
+#define VOICE_ALLOC_TRACKS            BRICK_NUM_TRACKS
+#define VOICE_NONE                    0xFFU
+
+/** Voix d'une cartouche, pour voice_track_cfg_t.eligible. */
+#define VOICE_ALLOC_CART_MASK(cart) \
+    ((((uint32_t)1U << BRICK_MAX_VOICES_PER_CART) - 1U) << ((cart) * BRICK_MAX_VOICES_PER_CART))
+
+/** voice_alloc_result_t.flags */
+#define VOICE_ALLOC_STOLEN            0x01U   /* La voix jouait une autre note. */
+#define VOICE_ALLOC_LEGATO            0x02U   /* Changement de hauteur sans réattaque. */
+#define VOICE_ALLOC_RETRIGGER         0x04U   /* Même note rejouée sur sa voix. */
+
+typedef enum {
+    VOICE_STEAL_OLDEST = 0,
+    VOICE_STEAL_QUIETEST,
+    VOICE_STEAL_SAME_NOTE
+} voice_steal_t;
+
+typedef struct {
+    uint32_t      eligible;   /* Voix utilisables par la piste. */
+    uint32_t      reserved;   /* Sous-ensemble réservé à la piste. */
+    voice_steal_t steal;
+    bool          legato;
+} voice_track_cfg_t;
+
+typedef struct {
+    uint8_t voice;
+    uint8_t cart;
+    uint8_t cart_voice;
+    uint8_t flags;            /* VOICE_ALLOC_*. */
+    uint8_t prev_track;       /* Note interrompue (VOICE_ALLOC_STOLEN / LEGATO). */
+    uint8_t prev_note;
+} voice_alloc_result_t;
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t steals;
+    uint32_t legato;
+    uint32_t retriggers;
+    uint32_t failures;        /* Aucune voix candidate. */
+    uint8_t  active_max;      /* Pire nombre de voix tenues simultanément. */
+} voice_alloc_stats_t;
+
+void voice_alloc_init(void);
+
+/* Voix présentes sur une cartouche (descripteur ; 0 au retrait). */
+void voice_alloc_set_cart_voices(uint8_t cart, uint8_t voices);
+
+/* false si la réservation chevauche celle d'une autre piste ou sort de `eligible`. */
+bool voice_alloc_config_track(uint8_t track, const voice_track_cfg_t *cfg);
+
+bool voice_alloc_note_on(uint8_t track, uint8_t note, uint8_t velocity,
+                         voice_alloc_result_t *res);
+
+/* Voix relâchée, ou VOICE_NONE si la note n'est plus tenue (volée, legato). */
+uint8_t voice_alloc_note_off(uint8_t track, uint8_t note);
+
+/* Fin de release signalée par la cartouche : la voix redevient libre. */
+void voice_alloc_voice_idle(uint8_t voice);
+
+/* Niveau courant (enveloppe) d'une voix, pour VOICE_STEAL_QUIETEST. */
+void voice_alloc_set_level(uint8_t voice, uint16_t level);
+
+/* Libère toutes les voix de la piste (VOICE_ALLOC_TRACKS : toutes). */
+void voice_alloc_all_off(uint8_t track);
+
+void voice_alloc_get_stats(voice_alloc_stats_t *st);
+
+#endif /* VOICE_ALLOC_H */
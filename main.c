@@ -2,7 +2,26 @@
 #include "hal.h"
 
 #include "drivers.h"
+#include "cart/cart_manager.h"
+#include "cart/cart_params.h"
+#include "cart/cart_bulk.h"
+#include "drivers/audio/audio_align.h"
 #include "drivers/audio/drv_audio.h"
+#include "drivers/midi/drv_midi.h"
+#include "drivers/midi/midi_router.h"
+#include "drivers/spilink/drv_spilink.h"
+#include "drivers/usb/usb_device.h"
+#include "drivers/usb/usb_midi.h"
+#include "engine/bounce.h"
+#include "engine/mod_matrix.h"
+#include "engine/voice_alloc.h"
+#include "seq/seq_clock.h"
+#include "seq/seq_engine.h"
+#include "seq/seq_history.h"
+#include "seq/seq_song.h"
+#include "seq/seq_sysex.h"
+#include "ui/ui_render.h"
+#include "ui/ui_snapshot.h"
 
 #include <string.h>
 
@@ -11,6 +30,15 @@
 #define AUDIO_BEEP_OFF_MS       200U
 #define AUDIO_BEEP_AMPLITUDE    ((int32_t)(8388607L * 3L / 5L))
 
+static uint32_t beep_sample = 0U;
+static uint32_t tone_phase = 0U;
+
+/* Rendu hors ligne : le bip repart de son début. */
+static void app_dsp_reset(void) {
+    beep_sample = 0U;
+    tone_phase = 0U;
+}
+
 void drv_audio_process_block(const int32_t               *adc_in,
                              const spilink_audio_block_t spi_in,
                              int32_t                     *dac_out,
@@ -19,8 +47,6 @@ void drv_audio_process_block(const int32_t               *adc_in,
     (void)adc_in;
     (void)spi_in;
 
-    static uint32_t beep_sample = 0U;
-    static uint32_t tone_phase = 0U;
     const uint32_t samples_per_cycle = AUDIO_SAMPLE_RATE_HZ / AUDIO_BEEP_FREQUENCY_HZ;
     const uint32_t samples_per_on = (AUDIO_SAMPLE_RATE_HZ * AUDIO_BEEP_ON_MS) / 1000U;
     const uint32_t samples_per_off = (AUDIO_SAMPLE_RATE_HZ * AUDIO_BEEP_OFF_MS) / 1000U;
@@ -54,12 +80,420 @@ void drv_audio_process_block(const int32_t               *adc_in,
     }
 }
 
+BRICK_STATIC_ASSERT(SEQ_SONG_ROW_NONE == UI_SONG_ROW_NONE, ui_song_row_none_matches);
+BRICK_STATIC_ASSERT(CART_CAPS_NAME_LEN == UI_CART_NAME_LEN, ui_cart_name_matches);
+
+/*
+ * État du séquenceur et du mixeur pour l'UI (thread audio). Publié à chaque
+ * bloc, ignoré par ui_snapshot tant qu'il ne change pas.
+ */
+static void app_ui_publish_block(void) {
+    ui_seq_state_t seq;
+    ui_mix_state_t mix;
+    drv_audio_mix_t m;
+    const seq_pattern_t *pat = seq_engine_get_pattern();
+
+    memset(&seq, 0, sizeof(seq));
+    seq.playing = seq_engine_is_playing();
+    seq.fill = seq_engine_get_fill();
+    seq.tempo_x10 = seq_engine_get_tempo();
+    seq.ext_clock = (seq_clock_get_source() == SEQ_CLOCK_EXTERNAL);
+    seq.song_row = seq_song_get_row();
+    if ((pat != NULL) && (pat->length != 0U)) {
+        /* Dernier step joué : le moteur tient l'index du prochain. */
+        const uint32_t last = (seq_engine_get_pattern_tick() + pat->length - 1U) % pat->length;
+
+        seq.pattern_id = pat->id;
+        seq.pattern_len = pat->length;
+        seq.step = (uint8_t)last;
+        for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+            const seq_track_t *track = pat->tracks[t];
+            if ((track == NULL) || (track->length == 0U)) {
+                continue;
+            }
+            if ((track->flags & SEQ_TRACK_MUTED) != 0U) {
+                seq.muted_mask |= (uint16_t)(1U << t);
+            }
+            const seq_step_t *step = &track->steps[last % track->length];
+            for (uint8_t k = 0U; k < BRICK_MAX_TRIGS_PER_STEP; ++k) {
+                if ((step->trigs[k].flags & SEQ_TRIG_ACTIVE) != 0U) {
+                    seq.trig_mask |= (uint16_t)(1U << t);
+                    break;
+                }
+            }
+        }
+    }
+    (void)ui_snapshot_publish_seq(&seq);
+
+    drv_audio_get_mix(&m);
+    memset(&mix, 0, sizeof(mix));
+    mix.master_volume = m.master_volume;
+    for (uint8_t r = 0U; r < BRICK_MAX_CARTRIDGES; ++r) {
+        mix.gain_main[r] = m.gain_main[r];
+        mix.gain_cue[r] = m.gain_cue[r];
+    }
+    mix.to_main_mask = m.to_main_mask;
+    mix.to_cue_mask = m.to_cue_mask;
+    (void)ui_snapshot_publish_mix(&mix);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Séquenceur -> cartouches (thread audio)                                    */
+/* -------------------------------------------------------------------------- */
+
+#define APP_PLOCK_WORDS         ((CART_MAX_PARAMS + 31U) / 32U)
+#define APP_TRACK_CART_NONE     0xFFU
+
+/* Note tenue par voix globale, jusqu'à l'impulsion de fin de gate. */
+typedef struct {
+    uint32_t end_pulse;
+    uint8_t  track;
+    uint8_t  note;
+    bool     active;
+} app_gate_t;
+
+/* Paramètres verrouillés par une piste et valeurs à leur rendre. */
+typedef struct {
+    uint32_t held[APP_PLOCK_WORDS];
+    int16_t  base[CART_MAX_PARAMS];
+    uint8_t  cart;
+} app_plocks_t;
+
+static app_gate_t app_gates[VOICE_ALLOC_VOICES];
+static app_plocks_t app_plocks[BRICK_NUM_TRACKS];
+static uint8_t app_track_cart[BRICK_NUM_TRACKS];
+static uint32_t app_seq_pulse = 0U;
+static bool app_seq_playing = false;
+
+/*
+ * La voie d'une piste (seq_track_t.channel) désigne sa cartouche : ses notes
+ * ne prennent que les voix de ce slot. Les voix éligibles suivent la voie.
+ */
+static bool app_track_route(uint8_t track, uint8_t channel) {
+    if (channel >= BRICK_MAX_CARTRIDGES) {
+        return false;
+    }
+    if (app_track_cart[track] != channel) {
+        const voice_track_cfg_t cfg = {
+            VOICE_ALLOC_CART_MASK(channel), 0U, VOICE_STEAL_OLDEST, false
+        };
+        if (!voice_alloc_config_track(track, &cfg)) {
+            return false;
+        }
+        app_track_cart[track] = channel;
+    }
+    return true;
+}
+
+static void app_seq_event(const seq_event_t *ev) {
+    voice_alloc_result_t res;
+    const uint8_t velocity = (ev->velocity != 0U) ? ev->velocity : 1U;
+
+    if (!app_track_route(ev->track, ev->channel) ||
+        !voice_alloc_note_on(ev->track, ev->note, velocity, &res)) {
+        return;
+    }
+    (void)cart_params_note(res.cart, res.cart_voice, ev->note, velocity);
+
+    /* Voix volée ou reprise : son gate précédent est remplacé. */
+    app_gate_t *g = &app_gates[res.voice];
+    g->end_pulse = seq_engine_get_pulse() +
+                   ((ev->length != 0U) ? ((uint32_t)ev->length * SEQ_PULSES_PER_STEP)
+                                       : (SEQ_PULSES_PER_STEP / 2U));
+    g->track = ev->track;
+    g->note = ev->note;
+    g->active = true;
+}
+
+/* Note off des gates échus (tous si `all`). */
+static void app_release_gates(bool all) {
+    const uint32_t pulse = seq_engine_get_pulse();
+
+    for (uint8_t v = 0U; v < VOICE_ALLOC_VOICES; ++v) {
+        app_gate_t *g = &app_gates[v];
+        if (!g->active || (!all && ((int32_t)(pulse - g->end_pulse) <= 0))) {
+            continue;
+        }
+        g->active = false;
+        const uint8_t voice = voice_alloc_note_off(g->track, g->note);
+        if (voice != VOICE_NONE) {
+            (void)cart_params_note((uint8_t)(voice / BRICK_MAX_VOICES_PER_CART),
+                                   (uint8_t)(voice % BRICK_MAX_VOICES_PER_CART), g->note, 0U);
+        }
+    }
+}
+
+/* Rend leur valeur aux paramètres verrouillés hors de `keep`. */
+static void app_plocks_revert(app_plocks_t *pl, const uint32_t keep[APP_PLOCK_WORDS]) {
+    for (uint32_t w = 0U; w < APP_PLOCK_WORDS; ++w) {
+        uint32_t m = pl->held[w] & ((keep != NULL) ? ~keep[w] : 0xFFFFFFFFU);
+        pl->held[w] &= ~m;
+        while (m != 0U) {
+            const uint16_t param = (uint16_t)((w * 32U) + (uint32_t)__builtin_ctz(m));
+            m &= m - 1U;
+            (void)cart_params_set(pl->cart, param, pl->base[param], CART_PRIO_PLOCK);
+        }
+    }
+}
+
+static void app_seq_plocks(uint8_t track, uint8_t channel, const seq_plock_t *locks, uint8_t count) {
+    app_plocks_t *pl = &app_plocks[track];
+    uint32_t now[APP_PLOCK_WORDS] = { 0U };
+
+    if (channel != pl->cart) {
+        app_plocks_revert(pl, NULL);
+        pl->cart = channel;
+    }
+    for (uint8_t i = 0U; (i < count) && (channel < BRICK_MAX_CARTRIDGES); ++i) {
+        const uint8_t param = locks[i].param;
+        if (param >= CART_MAX_PARAMS) {
+            continue;
+        }
+        const uint32_t w = (uint32_t)param >> 5;
+        const uint32_t bit = 1U << (param & 31U);
+        if ((pl->held[w] & bit) == 0U) {
+            pl->base[param] = cart_params_get(channel, param);
+            pl->held[w] |= bit;
+        }
+        now[w] |= bit;
+        (void)cart_params_set(channel, param, locks[i].value, CART_PRIO_PLOCK);
+    }
+    app_plocks_revert(pl, now);
+}
+
+/*
+ * Avant l'avance du bloc : gates échus relâchés, tous à l'arrêt ou au
+ * redémarrage du transport (impulsion revenue en arrière), verrous rendus à l'arrêt.
+ */
+static void app_seq_block(void) {
+    const bool playing = seq_engine_is_playing();
+    const uint32_t pulse = seq_engine_get_pulse();
+
+    app_release_gates(!playing || (pulse < app_seq_pulse));
+    if (!playing && app_seq_playing) {
+        for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+            app_plocks_revert(&app_plocks[t], NULL);
+        }
+    }
+    app_seq_playing = playing;
+    app_seq_pulse = pulse;
+}
+
+/* Traitements à cadence contrôle, exécutés par le thread audio avant le DSP. */
+static void app_control_block(size_t frames) {
+    seq_clock_process_block(drv_audio_get_block_frame(), frames);
+    app_seq_block();
+    seq_engine_process_block(frames);
+    mod_matrix_process_block(frames);
+    app_ui_publish_block();
+}
+
+/*
+ * Sorties de la matrice de modulation (thread audio) : cible 0..3 = slot,
+ * paramètre = index du descripteur, valeur 16 bits étalée sur [min, max].
+ * MOD_TARGET_ENGINE n'a pas encore de paramètres internes : ignorée.
+ */
+static void app_mod_output(uint8_t target, uint16_t param, uint16_t value) {
+    if (target < BRICK_MAX_CARTRIDGES) {
+        (void)cart_params_set_norm(target, param, value, CART_PRIO_MOD);
+    }
+}
+
+/* Horloge MIDI sortante : voie temps réel du routeur. */
+static void app_clock_out(uint8_t status, uint16_t offset) {
+    (void)offset;
+    const midi_msg_t msg = {0U, status, {0U, 0U}, MIDI_PORT_INTERNAL};
+    midi_router_send(&msg);
+}
+
+/* Sortie interne du routeur : seuls les octets temps réel sont exploités. */
+static void app_midi_rx(void *ctx, const midi_msg_t *msg) {
+    (void)ctx;
+    if (midi_is_realtime(msg->status)) {
+        seq_clock_input(msg);
+    }
+}
+
+/* État des slots pour l'UI (thread du gestionnaire de cartouches). */
+static void app_ui_publish_carts(void) {
+    ui_cart_state_t carts;
+
+    memset(&carts, 0, sizeof(carts));
+    for (uint8_t s = 0U; s < BRICK_MAX_CARTRIDGES; ++s) {
+        const cart_caps_t *caps = cart_manager_get_caps(s);
+        carts.slots[s].state = (uint8_t)cart_manager_get_state(s);
+        if (caps != NULL) {
+            carts.slots[s].voices = caps->voices;
+            memcpy(carts.slots[s].name, caps->name, UI_CART_NAME_LEN);
+        }
+    }
+    (void)ui_snapshot_publish_carts(&carts);
+}
+
+/* Insertion / retrait d'une cartouche : miroir de paramètres et voix suivent le slot. */
+static void app_cart_event(uint8_t slot, cart_slot_state_t state) {
+    const cart_caps_t *caps = cart_manager_get_caps(slot);
+
+    cart_params_slot_event(slot, state);
+    cart_bulk_slot_event(slot, state);
+    voice_alloc_set_cart_voices(slot, (caps != NULL) ? caps->voices : 0U);
+
+    if (state == CART_SLOT_READY) {
+        (void)audio_align_measure(slot, 0U, 0U);
+    } else {
+        audio_align_forget(slot);
+    }
+    app_ui_publish_carts();
+}
+
+/* Mesure de latence (thread audio) : la cartouche boucle son entrée le temps de la mesure. */
+static void app_align_loop(uint8_t path, bool loop) {
+    if (path < BRICK_MAX_CARTRIDGES) {
+        const uint8_t msg[2] = { CART_MSG_LOOPBACK, loop ? 1U : 0U };
+        (void)cart_manager_send(path, msg, sizeof(msg));
+    }
+}
+
+/* Messages des cartouches prêtes : accusés de transfert de masse. */
+static void app_cart_msg(uint8_t slot, const uint8_t *msg, size_t len) {
+    cart_bulk_on_msg(slot, msg, len);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Rendu hors ligne sur commande SysEx                                        */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * F0 7D 42 30 <mesures> <sd> F7 : rend <mesures> mesures au tempo courant,
+ * dans le WAV de la zone SD si <sd> != 0, en mesure seule sinon. Réponse sur
+ * le port source à la fin du rendu : F0 7D 42 31 <frames, 4 × 7 bits>
+ * <multiple du temps réel ×100 DSP seul, 3 × 7> <idem bounce complet, 3 × 7>
+ * <1 : succès> F7. Une requête reçue pendant un rendu est ignorée.
+ */
+#define APP_SYSEX_CMD_BOUNCE        SEQ_SYSEX_CMD_APP_FIRST
+#define APP_SYSEX_CMD_BOUNCE_DONE   (SEQ_SYSEX_CMD_APP_FIRST + 1U)
+#define APP_BOUNCE_REPLY_SIZE       14U
+
+/* La chaîne audio complète tourne sur ce thread : même pile que le thread audio. */
+#define APP_BOUNCE_STACK_SIZE       AUDIO_THREAD_STACK_SIZE
+#define APP_BOUNCE_PRIORITY         (NORMALPRIO - 10)
+
+static struct {
+    bool    pending;
+    uint8_t port;
+    uint8_t bars;
+    bool    write_sd;
+} app_bounce_req;
+
+static binary_semaphore_t app_bounce_sem;
+static THD_WORKING_AREA(appBounceWA, APP_BOUNCE_STACK_SIZE);
+
+/* Commandes de l'application (callback SysEx du routeur) : ne bloque pas. */
+static void app_sysex_cmd(uint8_t port, uint8_t cmd, const uint8_t *args, size_t n) {
+    if ((cmd != APP_SYSEX_CMD_BOUNCE) || (n != 2U) || (args[0] == 0U)) {
+        return;
+    }
+    chSysLock();
+    if (!app_bounce_req.pending) {
+        app_bounce_req.pending = true;
+        app_bounce_req.port = port;
+        app_bounce_req.bars = args[0];
+        app_bounce_req.write_sd = (args[1] != 0U);
+        chBSemSignalI(&app_bounce_sem);
+        chSchRescheduleS();
+    }
+    chSysUnlock();
+}
+
+static uint8_t *app_put_7bit(uint8_t *p, uint32_t v, uint8_t groups) {
+    for (uint8_t i = 0U; i < groups; ++i) {
+        *p++ = (uint8_t)((v >> (7U * i)) & 0x7FU);
+    }
+    return p;
+}
+
+static THD_FUNCTION(appBounceThread, arg) {
+    (void)arg;
+    chRegSetThreadName("appBounce");
+
+    while (true) {
+        bounce_result_t res;
+        uint8_t reply[APP_BOUNCE_REPLY_SIZE];
+
+        chBSemWait(&app_bounce_sem);
+        chSysLock();
+        const uint8_t port = app_bounce_req.port;
+        const uint8_t bars = app_bounce_req.bars;
+        const bool write_sd = app_bounce_req.write_sd;
+        chSysUnlock();
+
+        /* Mesure de 4 noires, tempo en dixièmes de BPM. */
+        const uint32_t frames_per_bar = (AUDIO_SAMPLE_RATE_HZ * 60U * 4U * 10U) /
+                                        (uint32_t)seq_engine_get_tempo();
+        const bool ok = bounce_run((uint32_t)bars * frames_per_bar, write_sd, &res);
+
+        uint8_t *p = reply;
+        *p++ = SEQ_SYSEX_MANUFACTURER;
+        *p++ = SEQ_SYSEX_MODEL;
+        *p++ = APP_SYSEX_CMD_BOUNCE_DONE;
+        p = app_put_7bit(p, res.frames, 4U);
+        p = app_put_7bit(p, res.dsp_speed_x100, 3U);
+        p = app_put_7bit(p, res.total_speed_x100, 3U);
+        *p = ok ? 1U : 0U;
+        (void)midi_router_send_sysex(port, reply, sizeof(reply),
+                                     MIDI_SYSEX_FLAG_START | MIDI_SYSEX_FLAG_END);
+
+        chSysLock();
+        app_bounce_req.pending = false;
+        chSysUnlock();
+    }
+}
+
 int main(void) {
     halInit();
     chSysInit();
 
+    drivers_init_all();
+    ui_snapshot_init();
+    mod_matrix_init();
+    mod_matrix_set_output_cb(app_mod_output);
+    voice_alloc_init();
+    seq_engine_init();
+    memset(app_track_cart, APP_TRACK_CART_NONE, sizeof(app_track_cart));
+    seq_engine_set_event_cb(app_seq_event);
+    seq_engine_set_plock_cb(app_seq_plocks);
+    seq_clock_init();
+    seq_clock_set_output_cb(app_clock_out);
+    seq_song_init();
+    seq_history_init();
+    seq_sysex_init();
+    seq_sysex_set_app_cb(app_sysex_cmd);
+
     drv_audio_init();
+    drv_audio_register_control_cb(app_control_block);
+    drv_audio_register_reset_cb(app_dsp_reset);
+    audio_align_set_loop_cb(app_align_loop);
+    drv_spilink_init();
+    drv_spilink_start();
+    cart_manager_init(&drv_spilink_link_ops);
+    cart_params_init(&drv_spilink_link_ops);
+    cart_bulk_init(&drv_spilink_link_ops);
+    cart_manager_set_event_cb(app_cart_event);
+    cart_manager_set_msg_cb(app_cart_msg);
+    cart_manager_start();
     drv_audio_start();
+    midi_router_init();
+    midi_router_set_internal_cb(app_midi_rx, seq_sysex_rx, NULL);
+    drv_midi_set_rx_cb(midi_router_rx_msg, midi_router_rx_sysex,
+                       MIDI_ROUTER_PORT_CTX(MIDI_PORT_DIN));
+    usb_midi_set_rx_cb(midi_router_rx_msg, midi_router_rx_sysex,
+                       MIDI_ROUTER_PORT_CTX(MIDI_PORT_USB));
+    midi_router_start();
+    drv_midi_start();
+    usb_device_start();
+    ui_render_start();
+    chBSemObjectInit(&app_bounce_sem, true);
+    chThdCreateStatic(appBounceWA, sizeof(appBounceWA), APP_BOUNCE_PRIORITY, appBounceThread, NULL);
 
     while (true) {
         chThdSleepMilliseconds(1000);
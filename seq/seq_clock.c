@@ -0,0 +1,236 @@
+/**
+ * @file seq_clock.c
+ * @brief Horloge MIDI maître (impulsions du séquenceur) et esclave (PLL).
+ * @ingroup seq
+ */
+
+#include "seq_clock.h"
+#include <string.h>
+
+BRICK_STATIC_ASSERT((SEQ_CLOCK_IN_QUEUE_SIZE & (SEQ_CLOCK_IN_QUEUE_SIZE - 1U)) == 0U,
+                    seq_clock_queue_pow2);
+
+typedef struct {
+    uint32_t frame;
+    uint8_t  status;
+} clock_event_t;
+
+static struct {
+    volatile seq_clock_source_t source;
+    seq_clock_out_cb_t out_cb;
+    midi_clock_pll_t   pll;
+    /* File d'entrée : threads MIDI -> thread audio, sous verrou. */
+    clock_event_t      queue[SEQ_CLOCK_IN_QUEUE_SIZE];
+    uint32_t           q_head;
+    uint32_t           q_tail;
+    /* Esclave : impulsion PLL correspondant à l'impulsion 0 du séquenceur. */
+    uint32_t           base;
+    bool               pending_start;
+    bool               pending_continue;
+    seq_clock_stats_t  stats;
+} clk;
+
+/* -------------------------------------------------------------------------- */
+/* Maître                                                                     */
+/* -------------------------------------------------------------------------- */
+
+static void clock_pulse_cb(uint32_t pulse, uint16_t offset) {
+    (void)pulse;
+    const seq_clock_out_cb_t cb = clk.out_cb;
+    if (cb != NULL) {
+        cb(MIDI_CLOCK, offset);
+        clk.stats.out_pulses++;
+    }
+}
+
+static void clock_send(uint8_t status) {
+    const seq_clock_out_cb_t cb = clk.out_cb;
+    if (cb != NULL) {
+        cb(status, 0U);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Esclave                                                                    */
+/* -------------------------------------------------------------------------- */
+
+static void clock_handle_event(const clock_event_t *ev, bool slave) {
+    if (ev->status == MIDI_CLOCK) {
+        midi_clock_pll_tick(&clk.pll, ev->frame);
+        if (!slave) {
+            return;
+        }
+        /* Impulsion reçue : index PLL de cette impulsion. */
+        const uint32_t index = clk.pll.index - 1U;
+        if (clk.pending_start) {
+            clk.pending_start = false;
+            clk.base = index;
+            seq_engine_start();
+        } else if (clk.pending_continue) {
+            clk.pending_continue = false;
+            clk.base = index - seq_engine_get_pulse();
+            seq_engine_continue();
+        }
+        return;
+    }
+    if (!slave) {
+        return;
+    }
+    switch (ev->status) {
+    case MIDI_START:
+        clk.pending_start = true;
+        clk.pending_continue = false;
+        break;
+    case MIDI_CONTINUE:
+        clk.pending_continue = !seq_engine_is_playing();
+        break;
+    case MIDI_STOP:
+        clk.pending_start = false;
+        clk.pending_continue = false;
+        seq_engine_stop();
+        break;
+    default:
+        break;
+    }
+}
+
+/* Impose au séquenceur la durée et la phase prédites par la PLL. */
+static void clock_follow(uint32_t block_frame, size_t frames) {
+    if (!seq_engine_is_playing() || !midi_clock_pll_has_period(&clk.pll)) {
+        return;
+    }
+
+    const uint32_t target = clk.base + seq_engine_get_pulse();
+    const uint32_t period = clk.pll.period_q16;
+    seq_engine_set_pulse_len_q16(period);
+
+    if ((int32_t)(target - clk.pll.index) >= (int32_t)SEQ_CLOCK_MAX_FREEWHEEL) {
+        /* Horloge muette : l'impulsion attendue est repoussée au-delà du bloc. */
+        seq_engine_set_next_pulse_q16(((uint32_t)frames << 16) + 1U);
+        clk.stats.holds++;
+        return;
+    }
+
+    int64_t until = midi_clock_pll_time_q16(&clk.pll, target, block_frame);
+    if (until < 0) {
+        until = 0;
+        clk.stats.late_pulses++;
+    } else if (until > (int64_t)period * SEQ_CLOCK_MAX_FREEWHEEL) {
+        until = (int64_t)period * SEQ_CLOCK_MAX_FREEWHEEL;
+    }
+    seq_engine_set_next_pulse_q16((uint32_t)until);
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void seq_clock_init(void) {
+    memset(&clk, 0, sizeof(clk));
+    clk.source = SEQ_CLOCK_INTERNAL;
+    midi_clock_pll_init(&clk.pll, BRICK_AUDIO_SAMPLE_RATE);
+    seq_engine_set_pulse_cb(clock_pulse_cb);
+}
+
+void seq_clock_set_source(seq_clock_source_t src) {
+    chSysLock();
+    clk.source = src;
+    clk.pending_start = false;
+    clk.pending_continue = false;
+    chSysUnlock();
+}
+
+seq_clock_source_t seq_clock_get_source(void) {
+    return clk.source;
+}
+
+void seq_clock_set_output_cb(seq_clock_out_cb_t cb) {
+    clk.out_cb = cb;
+}
+
+void seq_clock_start(void) {
+    if (clk.source != SEQ_CLOCK_INTERNAL) {
+        return;
+    }
+    /* FA avant la première impulsion, émise par le bloc audio suivant. */
+    clock_send(MIDI_START);
+    seq_engine_start();
+}
+
+void seq_clock_stop(void) {
+    if (clk.source != SEQ_CLOCK_INTERNAL) {
+        return;
+    }
+    seq_engine_stop();
+    clock_send(MIDI_STOP);
+}
+
+void seq_clock_continue(void) {
+    if (clk.source != SEQ_CLOCK_INTERNAL) {
+        return;
+    }
+    clock_send(MIDI_CONTINUE);
+    seq_engine_continue();
+}
+
+void seq_clock_input(const midi_msg_t *msg) {
+    const uint8_t status = msg->status;
+    if ((status != MIDI_CLOCK) && (status != MIDI_START) &&
+        (status != MIDI_CONTINUE) && (status != MIDI_STOP)) {
+        return;
+    }
+
+    chSysLock();
+    if ((clk.q_head - clk.q_tail) < SEQ_CLOCK_IN_QUEUE_SIZE) {
+        clock_event_t *ev = &clk.queue[clk.q_head & (SEQ_CLOCK_IN_QUEUE_SIZE - 1U)];
+        ev->frame = msg->frame;
+        ev->status = status;
+        clk.q_head++;
+        clk.stats.in_events++;
+    } else {
+        clk.stats.in_overflows++;
+    }
+    chSysUnlock();
+}
+
+void seq_clock_process_block(uint32_t block_frame, size_t frames) {
+    const bool slave = clk.source == SEQ_CLOCK_EXTERNAL;
+
+    while (true) {
+        clock_event_t ev;
+        chSysLock();
+        if (clk.q_tail == clk.q_head) {
+            chSysUnlock();
+            break;
+        }
+        ev = clk.queue[clk.q_tail & (SEQ_CLOCK_IN_QUEUE_SIZE - 1U)];
+        clk.q_tail++;
+        chSysUnlock();
+
+        clock_handle_event(&ev, slave);
+    }
+
+    if (slave) {
+        clock_follow(block_frame, frames);
+    }
+}
+
+void seq_clock_get_stats(seq_clock_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = clk.stats;
+    st->locked = midi_clock_pll_locked(&clk.pll);
+    st->in_bpm_x10 = midi_clock_pll_bpm_x10(&clk.pll, BRICK_AUDIO_SAMPLE_RATE);
+    st->pll = clk.pll.stats;
+    chSysUnlock();
+}
+
+void seq_clock_reset_stats(void) {
+    chSysLock();
+    const midi_clock_pll_stats_t zero = {0};
+    clk.pll.stats = zero;
+    memset(&clk.stats, 0, sizeof(clk.stats));
+    chSysUnlock();
+}
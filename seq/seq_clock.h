@@ -0,0 +1,72 @@
+/**
+ * @file seq_clock.h
+ * @brief Horloge MIDI maître / esclave du séquenceur (24 ppqn).
+ * @details Maître : chaque impulsion du séquenceur (seq_engine, cadencé à
+ * l'échantillon) produit un 0xF8 avec son offset dans le bloc audio. La
+ * gigue de sortie est bornée par la durée d'un bloc (16 frames, 333 µs),
+ * sans quantification sur le tick système.
+ *
+ * Esclave : les octets temps réel reçus (datés sur l'horloge audio par les
+ * drivers) alimentent une PLL (midi_clock_pll). À chaque bloc, la durée
+ * exacte des impulsions et l'instant prédit de la prochaine sont imposés au
+ * séquenceur : il joue sur la trajectoire lissée de l'horloge entrante et
+ * non sur ses instants bruts. Sans horloge, le séquenceur continue en roue
+ * libre au plus SEQ_CLOCK_MAX_FREEWHEEL impulsions puis s'arrête d'avancer.
+ *
+ * Start / Continue prennent effet à l'impulsion suivante, comme le veut la
+ * norme ; Song Position Pointer n'est pas géré.
+ *
+ * @ingroup seq
+ */
+
+#ifndef SEQ_CLOCK_H
+#define SEQ_CLOCK_H
+
+#include "ch.h"
+#include "midi_msg.h"
+#include "midi_clock_pll.h"
+#include "seq_engine.h"
+
+#define SEQ_CLOCK_IN_QUEUE_SIZE    32U
+#define SEQ_CLOCK_MAX_FREEWHEEL    SEQ_PPQN
+
+typedef enum {
+    SEQ_CLOCK_INTERNAL = 0,
+    SEQ_CLOCK_EXTERNAL
+} seq_clock_source_t;
+
+/** Émission d'un octet temps réel (F8 depuis le thread audio, FA/FB/FC depuis l'appelant). */
+typedef void (*seq_clock_out_cb_t)(uint8_t status, uint16_t offset);
+
+typedef struct {
+    uint32_t               out_pulses;
+    uint32_t               in_events;
+    uint32_t               in_overflows;   /* File d'entrée pleine. */
+    uint32_t               late_pulses;    /* Impulsion esclave jouée après l'instant prédit. */
+    uint32_t               holds;          /* Blocs retenus en fin de roue libre. */
+    bool                   locked;
+    uint16_t               in_bpm_x10;     /* Tempo lissé de l'horloge entrante. */
+    midi_clock_pll_stats_t pll;            /* Gigue d'entrée (frames Q16). */
+} seq_clock_stats_t;
+
+void seq_clock_init(void);
+
+void               seq_clock_set_source(seq_clock_source_t src);
+seq_clock_source_t seq_clock_get_source(void);
+void               seq_clock_set_output_cb(seq_clock_out_cb_t cb);
+
+/* Transport maître (FA/FC/FB émis) ; sans effet en esclave. */
+void seq_clock_start(void);
+void seq_clock_stop(void);
+void seq_clock_continue(void);
+
+/* Octet temps réel reçu (threads MIDI) : F8, FA, FB, FC ; les autres sont ignorés. */
+void seq_clock_input(const midi_msg_t *msg);
+
+/* Thread audio, avant seq_engine_process_block. */
+void seq_clock_process_block(uint32_t block_frame, size_t frames);
+
+void seq_clock_get_stats(seq_clock_stats_t *st);
+void seq_clock_reset_stats(void);
+
+#endif /* SEQ_CLOCK_H */
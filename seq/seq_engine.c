@@ -0,0 +1,503 @@
+/**
+ * @file seq_engine.c
+ * @brief Transport et avance de step du séquenceur (thread audio).
+ * @ingroup seq
+ */
+
+#include "seq_engine.h"
+#include <string.h>
+
+static struct {
+    const seq_pattern_t * volatile pattern;
+    seq_event_cb_t   event_cb;
+    seq_plock_cb_t   plock_cb;
+    seq_bar_cb_t     bar_cb;
+    seq_pulse_cb_t   pulse_cb;
+    uint32_t         pulse_len_q16;    /* Durée d'une impulsion 24 ppqn en échantillons (Q16). */
+    uint32_t         until_pulse_q16;  /* Reste avant la prochaine impulsion (Q16). */
+    uint32_t         pulse;            /* Impulsions émises depuis le démarrage. */
+    uint32_t         frame;            /* Horloge échantillon depuis le démarrage. */
+    uint32_t         tick;             /* Steps joués depuis le démarrage. */
+    uint32_t         pattern_tick;     /* Steps joués depuis l'entrée dans le pattern. */
+    uint32_t         loops;            /* Passages complets du pattern depuis l'entrée. */
+    uint32_t         iter[BRICK_NUM_TRACKS];  /* Passages de chaque piste (conditions A:B). */
+    uint32_t         rng[BRICK_NUM_TRACKS];   /* État xorshift32 par piste. */
+    uint32_t         seed;
+    uint16_t         plocked;          /* Pistes dont le dernier step joué portait des verrous. */
+    seq_plock_t      plock_buf[SEQ_TRACK_PLOCKS];
+    bool             entered;          /* Aucun step joué depuis l'entrée dans le pattern. */
+    volatile bool    fill;
+    uint16_t         tempo_x10;
+    volatile bool    playing;
+    time_measurement_t step_tm;
+} seq;
+
+/* Durée d'une impulsion : Fs * 60 / (BPM * 24), en Q16. */
+static uint32_t seq_pulse_len_q16(uint16_t bpm_x10) {
+    const uint64_t num = ((uint64_t)BRICK_AUDIO_SAMPLE_RATE * 60U * 10U) << 16;
+    return (uint32_t)(num / ((uint64_t)bpm_x10 * SEQ_PPQN));
+}
+
+static inline uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Graine propre à chaque piste, jamais nulle (point fixe de xorshift). */
+static void seq_reseed(void) {
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        const uint32_t s = seq.seed ^ ((uint32_t)(t + 1U) * 0x9E3779B9UL);
+        seq.rng[t] = (s != 0U) ? s : SEQ_DEFAULT_SEED;
+    }
+}
+
+/* Entrée dans un pattern : compteurs de passage remis à zéro. */
+static void seq_enter_pattern(void) {
+    seq.pattern_tick = 0U;
+    seq.loops = 0U;
+    seq.entered = true;
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        seq.iter[t] = 0U;
+    }
+}
+
+static bool seq_trig_condition(uint8_t t, const seq_trig_t *trig) {
+    switch (trig->cond) {
+    case SEQ_COND_PROB:
+        /* Tirage 0..99 sans division : r16 * 100 / 65536. */
+        return (((xorshift32(&seq.rng[t]) >> 16) * 100U) >> 16) < trig->cond_arg;
+    case SEQ_COND_FILL:
+        return seq.fill;
+    case SEQ_COND_NOT_FILL:
+        return !seq.fill;
+    case SEQ_COND_FIRST:
+        return seq.loops == 0U;
+    case SEQ_COND_NOT_FIRST:
+        return seq.loops != 0U;
+    case SEQ_COND_AB: {
+        const uint32_t a = (uint32_t)(trig->cond_arg >> 4);
+        const uint32_t b = (uint32_t)(trig->cond_arg & 0x0FU);
+        if ((a == 0U) || (b == 0U) || (a > b)) {
+            return true;
+        }
+        return (seq.iter[t] % b) == (a - 1U);
+    }
+    default:
+        return true;
+    }
+}
+
+/* Verrous du step `idx` de la piste (aucun si `track` est NULL : piste coupée). */
+static void seq_track_plocks(uint8_t t, const seq_track_t *track, uint32_t idx, uint8_t channel) {
+    const uint16_t bit = (uint16_t)(1U << t);
+    uint8_t count = 0U;
+
+    if (track != NULL) {
+        for (uint8_t i = 0U; i < SEQ_TRACK_PLOCKS; ++i) {
+            const seq_plock_t *pl = &track->plocks[i];
+            if (((pl->flags & SEQ_PLOCK_ACTIVE) != 0U) && (pl->step == idx)) {
+                seq.plock_buf[count++] = *pl;
+            }
+        }
+    }
+    if ((count != 0U) || ((seq.plocked & bit) != 0U)) {
+        seq.plock_cb(t, channel, seq.plock_buf, count);
+    }
+    if (count != 0U) {
+        seq.plocked |= bit;
+    } else {
+        seq.plocked &= (uint16_t)~bit;
+    }
+}
+
+static void seq_fire_step(uint16_t offset) {
+    chTMStartMeasurementX(&seq.step_tm);
+
+    if ((seq.tick % SEQ_STEPS_PER_BAR) == 0U) {
+        if (seq.bar_cb != NULL) {
+            const bool playing = seq.playing;
+            const seq_pattern_t *next = seq.bar_cb(seq.tick / SEQ_STEPS_PER_BAR,
+                                                   seq.frame + offset);
+            if (next != NULL) {
+                seq.pattern = next;
+                seq_enter_pattern();
+            }
+            if (playing && !seq.playing) {
+                /* Transport arrêté par le callback (fin de song) : mesure non jouée. */
+                chTMStopMeasurementX(&seq.step_tm);
+                return;
+            }
+        }
+    }
+
+    const seq_pattern_t *p = seq.pattern;
+    if (p != NULL) {
+        seq_event_t ev;
+        ev.offset = offset;
+
+        for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+            const seq_track_t *track = p->tracks[t];
+            if (track == NULL) {
+                continue;
+            }
+            const uint32_t idx = seq.pattern_tick % track->length;
+            if ((idx == 0U) && !seq.entered) {
+                seq.iter[t]++;
+            }
+            const bool muted = (track->flags & SEQ_TRACK_MUTED) != 0U;
+            if (seq.plock_cb != NULL) {
+                seq_track_plocks(t, muted ? NULL : track, idx, track->channel);
+            }
+            if (muted || (seq.event_cb == NULL)) {
+                continue;
+            }
+            const seq_step_t *step = &track->steps[idx];
+
+            for (uint8_t k = 0U; k < BRICK_MAX_TRIGS_PER_STEP; ++k) {
+                const seq_trig_t *trig = &step->trigs[k];
+                if (((trig->flags & SEQ_TRIG_ACTIVE) == 0U) || !seq_trig_condition(t, trig)) {
+                    continue;
+                }
+                ev.track = t;
+                ev.channel = track->channel;
+                ev.note = trig->note;
+                ev.velocity = trig->velocity;
+                ev.length = trig->length;
+                seq.event_cb(&ev);
+            }
+        }
+    }
+
+    seq.entered = false;
+    seq.tick++;
+    seq.pattern_tick++;
+    if ((p != NULL) && (seq.pattern_tick >= p->length)) {
+        seq.pattern_tick = 0U;
+        seq.loops++;
+    }
+
+    chTMStopMeasurementX(&seq.step_tm);
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void seq_engine_init(void) {
+    seq.pattern = NULL;
+    seq.event_cb = NULL;
+    seq.plock_cb = NULL;
+    seq.bar_cb = NULL;
+    seq.pulse_cb = NULL;
+    seq.tempo_x10 = SEQ_DEFAULT_TEMPO_X10;
+    seq.pulse_len_q16 = seq_pulse_len_q16(SEQ_DEFAULT_TEMPO_X10);
+    seq.until_pulse_q16 = 0U;
+    seq.pulse = 0U;
+    seq.frame = 0U;
+    seq.tick = 0U;
+    seq.seed = SEQ_DEFAULT_SEED;
+    seq.plocked = 0U;
+    seq.fill = false;
+    seq.playing = false;
+    seq_enter_pattern();
+    seq_reseed();
+    chTMObjectInit(&seq.step_tm);
+}
+
+void seq_engine_set_event_cb(seq_event_cb_t cb) {
+    seq.event_cb = cb;
+}
+
+void seq_engine_set_plock_cb(seq_plock_cb_t cb) {
+    seq.plock_cb = cb;
+}
+
+void seq_engine_set_bar_cb(seq_bar_cb_t cb) {
+    seq.bar_cb = cb;
+}
+
+void seq_engine_set_pulse_cb(seq_pulse_cb_t cb) {
+    seq.pulse_cb = cb;
+}
+
+void seq_engine_set_pattern(const seq_pattern_t *pattern) {
+    chSysLock();
+    seq.pattern = pattern;
+    seq_enter_pattern();
+    chSysUnlock();
+}
+
+const seq_pattern_t *seq_engine_get_pattern(void) {
+    return seq.pattern;
+}
+
+bool seq_engine_replace_pattern(const seq_pattern_t *expected, const seq_pattern_t *pattern) {
+    bool ok = false;
+    chSysLock();
+    if (seq.pattern == expected) {
+        seq.pattern = pattern;
+        if ((pattern != NULL) && (seq.pattern_tick >= pattern->length)) {
+            seq.pattern_tick = 0U;
+            seq.loops++;
+        }
+        ok = true;
+    }
+    chSysUnlock();
+    return ok;
+}
+
+void seq_engine_set_tempo(uint16_t bpm_x10) {
+    if (bpm_x10 < SEQ_MIN_TEMPO_X10) {
+        bpm_x10 = SEQ_MIN_TEMPO_X10;
+    }
+    if (bpm_x10 > SEQ_MAX_TEMPO_X10) {
+        bpm_x10 = SEQ_MAX_TEMPO_X10;
+    }
+    const uint32_t len = seq_pulse_len_q16(bpm_x10);
+
+    chSysLock();
+    seq.tempo_x10 = bpm_x10;
+    seq.pulse_len_q16 = len;
+    if (seq.until_pulse_q16 > len) {
+        seq.until_pulse_q16 = len;
+    }
+    chSysUnlock();
+}
+
+uint16_t seq_engine_get_tempo(void) {
+    return seq.tempo_x10;
+}
+
+void seq_engine_set_pulse_len_q16(uint32_t len_q16) {
+    const uint32_t min_len = seq_pulse_len_q16(SEQ_MAX_TEMPO_X10);
+    const uint32_t max_len = seq_pulse_len_q16(SEQ_MIN_TEMPO_X10);
+    if (len_q16 < min_len) {
+        len_q16 = min_len;
+    }
+    if (len_q16 > max_len) {
+        len_q16 = max_len;
+    }
+    /* Tempo affiché arrondi ; la durée Q16 reste celle imposée. */
+    const uint64_t num = ((uint64_t)BRICK_AUDIO_SAMPLE_RATE * 60U * 10U) << 16;
+    const uint16_t bpm_x10 = (uint16_t)((num + ((uint64_t)len_q16 * SEQ_PPQN) / 2U) /
+                                        ((uint64_t)len_q16 * SEQ_PPQN));
+
+    chSysLock();
+    seq.tempo_x10 = bpm_x10;
+    seq.pulse_len_q16 = len_q16;
+    chSysUnlock();
+}
+
+void seq_engine_set_next_pulse_q16(uint32_t until_q16) {
+    chSysLock();
+    seq.until_pulse_q16 = until_q16;
+    chSysUnlock();
+}
+
+void seq_engine_set_seed(uint32_t seed) {
+    seq.seed = seed;
+}
+
+void seq_engine_set_fill(bool fill) {
+    seq.fill = fill;
+}
+
+bool seq_engine_get_fill(void) {
+    return seq.fill;
+}
+
+void seq_engine_start(void) {
+    chSysLock();
+    seq.until_pulse_q16 = 0U;
+    seq.pulse = 0U;
+    seq.tick = 0U;
+    seq_enter_pattern();
+    seq_reseed();
+    seq.playing = true;
+    chSysUnlock();
+}
+
+void seq_engine_stop(void) {
+    seq.playing = false;
+}
+
+void seq_engine_continue(void) {
+    seq.playing = true;
+}
+
+bool seq_engine_is_playing(void) {
+    return seq.playing;
+}
+
+uint32_t seq_engine_get_frame(void) {
+    return seq.frame;
+}
+
+uint32_t seq_engine_get_tick(void) {
+    return seq.tick;
+}
+
+uint32_t seq_engine_get_pattern_tick(void) {
+    return seq.pattern_tick;
+}
+
+uint32_t seq_engine_get_pulse(void) {
+    return seq.pulse;
+}
+
+static void step_stats_copy(seq_step_stats_t *st) {
+    chSysLock();
+    st->steps = (uint32_t)seq.step_tm.n;
+    st->last_cycles = seq.step_tm.last;
+    st->worst_cycles = seq.step_tm.worst;
+    st->best_cycles = (seq.step_tm.n > 0U) ? seq.step_tm.best : 0U;
+    chSysUnlock();
+}
+
+void seq_engine_get_step_stats(seq_step_stats_t *st) {
+    if (st != NULL) {
+        step_stats_copy(st);
+    }
+}
+
+void seq_engine_reset_step_stats(void) {
+    chSysLock();
+    chTMObjectInit(&seq.step_tm);
+    chSysUnlock();
+}
+
+void seq_engine_process_block(size_t frames) {
+    if (seq.playing) {
+        const uint32_t span = (uint32_t)frames << 16;
+        uint32_t left = span;
+
+        /* Une impulsion tombe dans ce bloc tant que la distance restante est inférieure au bloc. */
+        while (seq.until_pulse_q16 < left) {
+            left -= seq.until_pulse_q16;
+            const uint16_t offset = (uint16_t)((span - left) >> 16);
+            if (seq.pulse_cb != NULL) {
+                seq.pulse_cb(seq.pulse, offset);
+            }
+            if ((seq.pulse % SEQ_PULSES_PER_STEP) == 0U) {
+                seq_fire_step(offset);
+            }
+            seq.pulse++;
+            seq.until_pulse_q16 = seq.pulse_len_q16;
+        }
+        seq.until_pulse_q16 -= left;
+    }
+
+    seq.frame += (uint32_t)frames;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Mesure du pire cas                                                         */
+/* -------------------------------------------------------------------------- */
+
+/* Un seul bloc piste suffit : la vue de mesure le référence 16 fois. */
+static seq_track_t bench_track;
+
+static void bench_event_cb(const seq_event_t *ev) {
+    (void)ev;
+}
+
+static void bench_plock_cb(uint8_t track, uint8_t channel, const seq_plock_t *locks, uint8_t count) {
+    (void)track;
+    (void)channel;
+    (void)locks;
+    (void)count;
+}
+
+bool seq_engine_benchmark(uint32_t steps, seq_step_stats_t *st) {
+    if ((steps == 0U) || (st == NULL) || seq.playing) {
+        return false;
+    }
+
+    seq_track_clear(&bench_track);
+    for (uint8_t s = 0U; s < BRICK_STEPS_PER_TRACK; ++s) {
+        for (uint8_t k = 0U; k < BRICK_MAX_TRIGS_PER_STEP; ++k) {
+            seq_trig_t *trig = &bench_track.steps[s].trigs[k];
+            trig->note = (uint8_t)(36U + k);
+            trig->velocity = 100U;
+            trig->length = 1U;
+            trig->flags = SEQ_TRIG_ACTIVE;
+            trig->cond = (uint8_t)(1U + (((uint32_t)s * BRICK_MAX_TRIGS_PER_STEP + k) %
+                                         (SEQ_COND_COUNT - 1U)));
+            trig->cond_arg = (trig->cond == SEQ_COND_PROB) ? 50U :
+                             (trig->cond == SEQ_COND_AB)   ? SEQ_COND_AB_ARG(2U, 3U) : 0U;
+        }
+        /* Un verrou par step, au bout de la table : balayage complet. */
+        seq_plock_t *pl = &bench_track.plocks[(SEQ_TRACK_PLOCKS - 1U) - (s % SEQ_TRACK_PLOCKS)];
+        pl->step = s;
+        pl->param = s;
+        pl->flags = SEQ_PLOCK_ACTIVE;
+        pl->value = (int16_t)s;
+    }
+
+    seq_pattern_t view;
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        view.tracks[t] = &bench_track;
+    }
+    view.id = 0xFFFFU;
+    view.length = BRICK_STEPS_PER_TRACK;
+    view.reserved = 0U;
+
+    /* Le thread audio n'avance que l'horloge tant que le transport est arrêté. */
+    chSysLock();
+    const seq_pattern_t *pattern = seq.pattern;
+    const seq_event_cb_t event_cb = seq.event_cb;
+    const seq_plock_cb_t plock_cb = seq.plock_cb;
+    const uint16_t plocked = seq.plocked;
+    const seq_bar_cb_t bar_cb = seq.bar_cb;
+    const uint32_t tick = seq.tick;
+    const uint32_t pattern_tick = seq.pattern_tick;
+    const uint32_t loops = seq.loops;
+    const bool entered = seq.entered;
+    uint32_t iter[BRICK_NUM_TRACKS];
+    uint32_t rng[BRICK_NUM_TRACKS];
+    memcpy(iter, seq.iter, sizeof(iter));
+    memcpy(rng, seq.rng, sizeof(rng));
+    const bool fill = seq.fill;
+    const time_measurement_t tm = seq.step_tm;
+
+    seq.pattern = &view;
+    seq.event_cb = bench_event_cb;
+    seq.plock_cb = bench_plock_cb;
+    seq.plocked = 0U;
+    seq.bar_cb = NULL;
+    seq.tick = 0U;
+    seq.fill = true;
+    seq_enter_pattern();
+    seq_reseed();
+    chTMObjectInit(&seq.step_tm);
+    chSysUnlock();
+
+    /* Chaque step sous verrou : ni le thread audio ni une IRQ dans la mesure. */
+    for (uint32_t i = 0U; i < steps; ++i) {
+        chSysLock();
+        seq_fire_step(0U);
+        chSysUnlock();
+    }
+    step_stats_copy(st);
+
+    chSysLock();
+    seq.pattern = pattern;
+    seq.event_cb = event_cb;
+    seq.plock_cb = plock_cb;
+    seq.plocked = plocked;
+    seq.bar_cb = bar_cb;
+    seq.tick = tick;
+    seq.fill = fill;
+    seq.step_tm = tm;
+    seq.pattern_tick = pattern_tick;
+    seq.loops = loops;
+    seq.entered = entered;
+    memcpy(seq.iter, iter, sizeof(iter));
+    memcpy(seq.rng, rng, sizeof(rng));
+    chSysUnlock();
+    return true;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file seq_engine.h
+ * @brief Moteur du séquenceur : transport, horloge échantillon et avance de step.
+ * @details Le moteur est cadencé par le hook de contrôle du thread audio
+ * (seq_engine_process_block). La position est tenue en échantillons (Q16),
+ * chaque évènement porte son offset dans le bloc courant. Le pattern joué
+ * n'est qu'un pointeur : un changement de pattern sur une frontière de
+ * mesure est une simple affectation, sans copie ni décodage sur le chemin
+ * temps réel.
+ *
+ * Les conditions de trig (probabilité, fill, premier passage, A:B) sont
+ * évaluées dans l'avance de step. Chaque piste a son propre générateur
+ * xorshift32, réensemencé au démarrage à partir d'une graine fixe : un même
+ * pattern rejoué ou rendu hors ligne produit la même suite de trigs.
+ *
+ * Les verrous de paramètre d'une piste passent, avant ses notes, par le
+ * callback de verrous : une fois par step joué qui en porte, et une fois de
+ * plus (liste vide) au premier step joué sans verrou ou piste coupée, pour
+ * que le destinataire rende leurs valeurs aux paramètres.
+ *
+ * L'unité de temps interne est l'impulsion d'horloge MIDI (24 ppqn, 6 par
+ * step) : l'horloge maître en sort directement avec son offset échantillon,
+ * et en esclave seq_clock impose durée et phase des impulsions.
+ *
+ * @ingroup seq
+ */
+
+#ifndef SEQ_ENGINE_H
+#define SEQ_ENGINE_H
+
+#include "ch.h"
+#include "seq_pattern.h"
+
+/** Graine par défaut des générateurs de piste. */
+#define SEQ_DEFAULT_SEED          0x2545F491UL
+
+/** Tempo par défaut (dixièmes de BPM). */
+#define SEQ_DEFAULT_TEMPO_X10     1200U
+#define SEQ_MIN_TEMPO_X10         300U
+#define SEQ_MAX_TEMPO_X10         3000U
+
+/** Impulsions d'horloge MIDI par noire et par step (double-croche). */
+#define SEQ_PPQN                  24U
+#define SEQ_PULSES_PER_STEP       (SEQ_PPQN / 4U)
+
+typedef struct {
+    uint8_t  track;
+    uint8_t  channel;
+    uint8_t  note;
+    uint8_t  velocity;
+    uint8_t  length;      /* Durée du gate en steps. */
+    uint16_t offset;      /* Offset (frames) dans le bloc courant. */
+} seq_event_t;
+
+/** Coût de l'avance de step (compteur de cycles, voir chTM). */
+typedef struct {
+    uint32_t steps;
+    rtcnt_t  last_cycles;
+    rtcnt_t  worst_cycles;
+    rtcnt_t  best_cycles;
+} seq_step_stats_t;
+
+/** Évènement de note émis par l'avance de step (thread audio). */
+typedef void (*seq_event_cb_t)(const seq_event_t *ev);
+
+/**
+ * @brief Verrous du step joué par une piste (thread audio), avant ses notes.
+ * @param locks  verrous actifs du step (tampon du moteur, valide pendant l'appel).
+ * @param count  0 : la piste n'a plus de verrou, les paramètres reprennent leur valeur.
+ */
+typedef void (*seq_plock_cb_t)(uint8_t track, uint8_t channel,
+                               const seq_plock_t *locks, uint8_t count);
+
+/** Impulsion d'horloge (thread audio) : index depuis le démarrage, offset dans le bloc. */
+typedef void (*seq_pulse_cb_t)(uint32_t pulse, uint16_t offset);
+
+/**
+ * @brief Frontière de mesure (thread audio).
+ * @param bar    index de mesure depuis le démarrage.
+ * @param frame  horloge échantillon du séquenceur à la frontière.
+ * @return pattern à jouer à partir de cette mesure, ou NULL pour continuer.
+ * Le callback peut arrêter le transport (seq_engine_stop) : la mesure qui
+ * commence n'est alors pas jouée.
+ */
+typedef const seq_pattern_t *(*seq_bar_cb_t)(uint32_t bar, uint32_t frame);
+
+void seq_engine_init(void);
+
+void seq_engine_set_event_cb(seq_event_cb_t cb);
+void seq_engine_set_plock_cb(seq_plock_cb_t cb);
+void seq_engine_set_bar_cb(seq_bar_cb_t cb);
+void seq_engine_set_pulse_cb(seq_pulse_cb_t cb);
+
+void                 seq_engine_set_pattern(const seq_pattern_t *pattern);
+const seq_pattern_t *seq_engine_get_pattern(void);
+
+/*
+ * Remplace le pattern joué par une autre version du même pattern, sans
+ * toucher à la position (édition, undo/redo). Échoue si le séquenceur joue
+ * autre chose que `expected` (changement de pattern entre-temps).
+ */
+bool seq_engine_replace_pattern(const seq_pattern_t *expected, const seq_pattern_t *pattern);
+
+void     seq_engine_set_tempo(uint16_t bpm_x10);
+uint16_t seq_engine_get_tempo(void);
+
+/*
+ * Synchronisation externe (thread audio, avant seq_engine_process_block) :
+ * durée exacte d'une impulsion et distance, depuis le début du bloc, jusqu'à
+ * la prochaine impulsion. Échantillons en Q16.
+ */
+void seq_engine_set_pulse_len_q16(uint32_t len_q16);
+void seq_engine_set_next_pulse_q16(uint32_t until_q16);
+
+/* Graine appliquée à chaque démarrage (rendu reproductible). */
+void seq_engine_set_seed(uint32_t seed);
+void seq_engine_set_fill(bool fill);
+bool seq_engine_get_fill(void);
+
+void seq_engine_start(void);
+void seq_engine_stop(void);
+/* Reprise sans retour au début (MIDI Continue). */
+void seq_engine_continue(void);
+bool seq_engine_is_playing(void);
+
+/* Thread audio : avance l'horloge de `frames` échantillons. */
+void seq_engine_process_block(size_t frames);
+
+uint32_t seq_engine_get_frame(void);
+uint32_t seq_engine_get_tick(void);
+/* Steps joués depuis l'entrée dans le pattern courant (index du prochain). */
+uint32_t seq_engine_get_pattern_tick(void);
+/* Impulsions émises depuis le démarrage (index de la prochaine). */
+uint32_t seq_engine_get_pulse(void);
+
+void seq_engine_get_step_stats(seq_step_stats_t *st);
+void seq_engine_reset_step_stats(void);
+
+/*
+ * Mesure le pire cas de l'avance de step : 16 pistes × 4 trigs actifs, toutes
+ * conditions armées, un verrou par step, évènements émis vers des callbacks
+ * vides. Chaque step est mesuré sous chSysLock (ni préemption ni IRQ).
+ * Séquenceur arrêté uniquement ; transport, position dans le pattern,
+ * compteurs de passage et générateurs sont restaurés à la sortie.
+ */
+bool seq_engine_benchmark(uint32_t steps, seq_step_stats_t *st);
+
+#endif /* SEQ_ENGINE_H */
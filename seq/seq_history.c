@@ -0,0 +1,333 @@
+/**
+ * @file seq_history.c
+ * @brief Anneau de versions, pool de blocs piste compté par référence.
+ * @ingroup seq
+ */
+
+#include "seq_history.h"
+#include "seq_engine.h"
+#include <string.h>
+
+#define BLOCK_NONE   0xFFFFU
+
+BRICK_STATIC_ASSERT(SEQ_HISTORY_DEPTH >= 2U, history_too_shallow);
+BRICK_STATIC_ASSERT(SEQ_HISTORY_DEPTH <= 254U, history_too_deep);
+BRICK_STATIC_ASSERT(SEQ_HISTORY_POOL_BLOCKS >= BRICK_NUM_TRACKS, history_pool_too_small);
+BRICK_STATIC_ASSERT(SEQ_HISTORY_POOL_BLOCKS < BLOCK_NONE, history_pool_too_large);
+
+typedef struct {
+    seq_pattern_t view;
+    uint16_t      blocks[BRICK_NUM_TRACKS];   /* Index pool, ou BLOCK_NONE (bloc de base). */
+} seq_version_t;
+
+/* Pool de blocs : alloué une fois, jamais touché par le thread audio hors version publiée. */
+static seq_track_t pool[SEQ_HISTORY_POOL_BLOCKS] BRICK_SDRAM_ATTR;
+static uint8_t     pool_refs[SEQ_HISTORY_POOL_BLOCKS];
+static uint16_t    pool_free[SEQ_HISTORY_POOL_BLOCKS];
+static uint16_t    pool_free_count;
+
+static seq_version_t ring[SEQ_HISTORY_DEPTH];
+
+static struct {
+    bool                 valid;
+    uint8_t              head;       /* Slot de la version la plus ancienne. */
+    uint8_t              count;
+    uint8_t              cur;        /* Position de la version courante (0..count-1). */
+    const seq_pattern_t *published;  /* Pattern que le séquenceur joue selon nous. */
+    bool                 editing;
+    uint16_t             owned;      /* Pistes déjà recopiées dans le brouillon. */
+    seq_version_t        draft;
+} hist;
+
+static seq_history_stats_t stats;
+static mutex_t hist_mtx;
+
+/* -------------------------------------------------------------------------- */
+/* Helpers                                                                    */
+/* -------------------------------------------------------------------------- */
+
+static inline seq_version_t *version_at(uint8_t pos) {
+    return &ring[(hist.head + pos) % SEQ_HISTORY_DEPTH];
+}
+
+static uint16_t block_alloc(void) {
+    if (pool_free_count == 0U) {
+        return BLOCK_NONE;
+    }
+    const uint16_t b = pool_free[--pool_free_count];
+    pool_refs[b] = 1U;
+    return b;
+}
+
+static inline void block_ref(uint16_t b) {
+    if (b != BLOCK_NONE) {
+        pool_refs[b]++;
+    }
+}
+
+static inline void block_unref(uint16_t b) {
+    if ((b != BLOCK_NONE) && (--pool_refs[b] == 0U)) {
+        pool_free[pool_free_count++] = b;
+    }
+}
+
+static void version_release(seq_version_t *v) {
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        block_unref(v->blocks[t]);
+        v->blocks[t] = BLOCK_NONE;
+    }
+}
+
+/* Abandonne les versions au-delà de la courante (branche redo). */
+static void drop_redo(void) {
+    while (hist.count > (uint8_t)(hist.cur + 1U)) {
+        hist.count--;
+        version_release(version_at(hist.count));
+    }
+}
+
+/* Abandonne la plus ancienne version ; jamais la courante. */
+static bool drop_oldest(void) {
+    if (hist.cur == 0U) {
+        return false;
+    }
+    version_release(version_at(0U));
+    hist.head = (uint8_t)((hist.head + 1U) % SEQ_HISTORY_DEPTH);
+    hist.count--;
+    hist.cur--;
+    stats.dropped++;
+    return true;
+}
+
+/*
+ * L'historique ne vaut que pour le pattern que joue le séquenceur : après un
+ * changement de pattern (song, chaînage), éditions et undo/redo sont refusés
+ * jusqu'au prochain seq_history_begin.
+ */
+static bool hist_in_sync(void) {
+    return hist.valid && (seq_engine_get_pattern() == hist.published);
+}
+
+/*
+ * Bascule le séquenceur sur la nouvelle version courante s'il joue encore la
+ * précédente. Le thread audio est plus prioritaire et ne bloque jamais au
+ * milieu d'un step : il ne voit qu'une version complète.
+ */
+static void publish(void) {
+    const seq_pattern_t *v = &version_at(hist.cur)->view;
+    if (seq_engine_replace_pattern(hist.published, v)) {
+        hist.published = v;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void seq_history_init(void) {
+    chMtxObjectInit(&hist_mtx);
+    memset(&hist, 0, sizeof(hist));
+    memset(&stats, 0, sizeof(stats));
+    memset(pool_refs, 0, sizeof(pool_refs));
+    for (uint16_t b = 0U; b < SEQ_HISTORY_POOL_BLOCKS; ++b) {
+        pool_free[b] = (uint16_t)(SEQ_HISTORY_POOL_BLOCKS - 1U - b);
+    }
+    pool_free_count = SEQ_HISTORY_POOL_BLOCKS;
+}
+
+void seq_history_begin(const seq_pattern_t *base) {
+    chMtxLock(&hist_mtx);
+    if (hist.editing) {
+        for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+            if ((hist.owned & (1U << t)) != 0U) {
+                block_unref(hist.draft.blocks[t]);
+            }
+        }
+        hist.editing = false;
+    }
+    while (hist.count > 0U) {
+        hist.count--;
+        version_release(version_at(hist.count));
+    }
+    hist.head = 0U;
+    hist.cur = 0U;
+    hist.valid = (base != NULL);
+    hist.published = base;
+
+    if (base != NULL) {
+        /*
+         * Blocs de base recopiés dans le pool : le stockage du pattern source
+         * (slot du magasin song) est réutilisé au préchargement suivant.
+         * Toutes les versions viennent d'être libérées, le pool a au moins
+         * BRICK_NUM_TRACKS blocs libres.
+         */
+        seq_version_t *v = version_at(0U);
+        v->view = *base;
+        for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+            v->blocks[t] = BLOCK_NONE;
+            if (base->tracks[t] != NULL) {
+                const uint16_t b = block_alloc();
+                memcpy(&pool[b], base->tracks[t], sizeof(seq_track_t));
+                v->blocks[t] = b;
+                v->view.tracks[t] = &pool[b];
+                stats.track_copies++;
+            }
+        }
+        hist.count = 1U;
+    }
+    stats.rebases++;
+    chMtxUnlock(&hist_mtx);
+}
+
+bool seq_history_edit_begin(void) {
+    chMtxLock(&hist_mtx);
+    const bool ok = hist_in_sync() && !hist.editing;
+    if (ok) {
+        hist.draft = *version_at(hist.cur);
+        hist.owned = 0U;
+        hist.editing = true;
+    }
+    chMtxUnlock(&hist_mtx);
+    return ok;
+}
+
+seq_track_t *seq_history_edit_track(uint8_t track) {
+    seq_track_t *out = NULL;
+
+    if (track >= BRICK_NUM_TRACKS) {
+        return NULL;
+    }
+
+    chMtxLock(&hist_mtx);
+    if (hist.editing) {
+        if ((hist.owned & (1U << track)) != 0U) {
+            out = &pool[hist.draft.blocks[track]];
+        } else {
+            /* Pool épuisé : la branche redo puis les versions anciennes cèdent leurs blocs. */
+            uint16_t b = block_alloc();
+            if (b == BLOCK_NONE) {
+                drop_redo();
+                b = block_alloc();
+            }
+            while ((b == BLOCK_NONE) && drop_oldest()) {
+                b = block_alloc();
+            }
+
+            if (b == BLOCK_NONE) {
+                stats.failed++;
+            } else {
+                const seq_track_t *src = hist.draft.view.tracks[track];
+                if (src != NULL) {
+                    memcpy(&pool[b], src, sizeof(seq_track_t));
+                } else {
+                    seq_track_clear(&pool[b]);
+                }
+                hist.draft.blocks[track] = b;
+                hist.draft.view.tracks[track] = &pool[b];
+                hist.owned |= (uint16_t)(1U << track);
+                stats.track_copies++;
+                out = &pool[b];
+            }
+        }
+    }
+    chMtxUnlock(&hist_mtx);
+    return out;
+}
+
+bool seq_history_edit_length(uint8_t length) {
+    if ((length == 0U) || (length > BRICK_STEPS_PER_TRACK)) {
+        return false;
+    }
+    chMtxLock(&hist_mtx);
+    const bool ok = hist.editing;
+    if (ok) {
+        hist.draft.view.length = length;
+    }
+    chMtxUnlock(&hist_mtx);
+    return ok;
+}
+
+bool seq_history_edit_commit(void) {
+    chMtxLock(&hist_mtx);
+    if (!hist.editing) {
+        chMtxUnlock(&hist_mtx);
+        return false;
+    }
+
+    drop_redo();
+    if (hist.count >= SEQ_HISTORY_DEPTH) {
+        (void)drop_oldest();
+    }
+
+    /* Les pistes non touchées sont partagées avec la version précédente. */
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        if ((hist.owned & (1U << t)) == 0U) {
+            block_ref(hist.draft.blocks[t]);
+        }
+    }
+
+    *version_at(hist.count) = hist.draft;
+    hist.cur = hist.count;
+    hist.count++;
+    hist.editing = false;
+    stats.commits++;
+    publish();
+    chMtxUnlock(&hist_mtx);
+    return true;
+}
+
+void seq_history_edit_abort(void) {
+    chMtxLock(&hist_mtx);
+    if (hist.editing) {
+        for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+            if ((hist.owned & (1U << t)) != 0U) {
+                block_unref(hist.draft.blocks[t]);
+            }
+        }
+        hist.editing = false;
+    }
+    chMtxUnlock(&hist_mtx);
+}
+
+bool seq_history_undo(void) {
+    chMtxLock(&hist_mtx);
+    const bool ok = hist_in_sync() && !hist.editing && (hist.cur > 0U);
+    if (ok) {
+        hist.cur--;
+        publish();
+    }
+    chMtxUnlock(&hist_mtx);
+    return ok;
+}
+
+bool seq_history_redo(void) {
+    chMtxLock(&hist_mtx);
+    const bool ok = hist_in_sync() && !hist.editing && ((uint8_t)(hist.cur + 1U) < hist.count);
+    if (ok) {
+        hist.cur++;
+        publish();
+    }
+    chMtxUnlock(&hist_mtx);
+    return ok;
+}
+
+const seq_pattern_t *seq_history_current(void) {
+    chMtxLock(&hist_mtx);
+    const seq_pattern_t *p = hist.valid ? &version_at(hist.cur)->view : NULL;
+    chMtxUnlock(&hist_mtx);
+    return p;
+}
+
+void seq_history_get_stats(seq_history_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chMtxLock(&hist_mtx);
+    *st = stats;
+    st->depth = hist.count;
+    st->undo_available = hist.cur;
+    st->redo_available = (hist.count > 0U) ? (uint8_t)(hist.count - 1U - hist.cur) : 0U;
+    st->blocks_free = pool_free_count;
+    st->blocks_used = (uint16_t)(SEQ_HISTORY_POOL_BLOCKS - pool_free_count);
+    chMtxUnlock(&hist_mtx);
+}
@@ -0,0 +1,77 @@
+/**
+ * @file seq_history.h
+ * @brief Historique d'édition des patterns (undo/redo) en copie sur écriture.
+ * @details Chaque version est une vue seq_pattern_t dont les pointeurs de
+ * piste désignent soit les blocs du pattern de base, soit des blocs d'un
+ * pool partagé (SDRAM si disponible). Une édition ne recopie que les pistes
+ * touchées ; les autres sont partagées avec la version précédente et
+ * comptées par référence. Undo et redo ne déplacent qu'un index dans
+ * l'anneau de versions : coût constant, indépendant de la taille du pattern.
+ *
+ * Usage (thread UI) :
+ * @code
+ *   seq_history_edit_begin();
+ *   seq_track_t *t = seq_history_edit_track(3);
+ *   t->steps[0].trigs[0].flags |= SEQ_TRIG_ACTIVE;
+ *   seq_history_edit_commit();
+ * @endcode
+ *
+ * La version courante est publiée au séquenceur par seq_engine_replace_pattern,
+ * uniquement s'il joue encore la version précédente de ce pattern.
+ *
+ * seq_song appelle seq_history_begin à chaque changement du pattern joué
+ * (démarrage, bascule de mesure) ; les blocs de base sont alors recopiés
+ * dans le pool, l'historique ne pointe jamais dans le magasin de patterns.
+ * Entre la bascule et ce rebasage, éditions et undo/redo sont refusés.
+ *
+ * @ingroup seq
+ */
+
+#ifndef SEQ_HISTORY_H
+#define SEQ_HISTORY_H
+
+#include "ch.h"
+#include "seq_pattern.h"
+
+/** Versions conservées (courante incluse). */
+#define SEQ_HISTORY_DEPTH         64U
+
+/** Blocs piste du pool de copie (~1,9 Ko chacun). */
+#if BRICK_SDRAM_ENABLE
+#define SEQ_HISTORY_POOL_BLOCKS   1024U
+#else
+#define SEQ_HISTORY_POOL_BLOCKS   32U
+#endif
+
+typedef struct {
+    uint8_t  depth;           /* Versions présentes dans l'anneau. */
+    uint8_t  undo_available;
+    uint8_t  redo_available;
+    uint16_t blocks_used;
+    uint16_t blocks_free;
+    uint32_t commits;
+    uint32_t track_copies;    /* Blocs recopiés depuis l'init. */
+    uint32_t dropped;         /* Versions anciennes libérées faute de place. */
+    uint32_t failed;          /* Éditions refusées (pool épuisé). */
+    uint32_t rebases;         /* Appels à seq_history_begin. */
+} seq_history_stats_t;
+
+void seq_history_init(void);
+
+/* Repart d'un pattern de base (celui que joue le séquenceur) ; vide l'historique et recopie ses pistes. */
+void seq_history_begin(const seq_pattern_t *base);
+
+bool         seq_history_edit_begin(void);
+seq_track_t *seq_history_edit_track(uint8_t track);
+bool         seq_history_edit_length(uint8_t length);
+bool         seq_history_edit_commit(void);
+void         seq_history_edit_abort(void);
+
+bool seq_history_undo(void);
+bool seq_history_redo(void);
+
+/* Version courante, ou NULL si aucun pattern de base. */
+const seq_pattern_t *seq_history_current(void);
+void                 seq_history_get_stats(seq_history_stats_t *st);
+
+#endif /* SEQ_HISTORY_H */
@@ -0,0 +1,225 @@
+/**
+ * @file seq_pattern.c
+ * @brief Codec en flux du format pattern (taille fixe, FNV-1a en pied).
+ * @ingroup seq
+ */
+
+#include "seq_pattern.h"
+#include <string.h>
+
+#define FNV1A_OFFSET   0x811C9DC5UL
+#define FNV1A_PRIME    0x01000193UL
+
+#define SEQ_TRACKS_END (SEQ_PATTERN_HEADER_SIZE + (BRICK_NUM_TRACKS * SEQ_TRACK_SERIAL_SIZE))
+
+static inline uint32_t fnv1a(uint32_t h, uint8_t b) {
+    return (h ^ b) * FNV1A_PRIME;
+}
+
+/* Localise l'octet sérialisé correspondant à un offset dans le bloc piste. */
+static inline const uint8_t *track_byte(const seq_track_t *track, uint32_t o) {
+    if (o < SEQ_TRACK_HEADER_SIZE) {
+        switch (o) {
+        case 0U:  return &track->length;
+        case 1U:  return &track->channel;
+        case 2U:  return &track->flags;
+        default:  return &track->reserved;
+        }
+    }
+
+    if (o >= (SEQ_TRACK_HEADER_SIZE + SEQ_TRACK_TRIGS_SIZE)) {
+        const uint32_t po = o - (SEQ_TRACK_HEADER_SIZE + SEQ_TRACK_TRIGS_SIZE);
+        const seq_plock_t *pl = &track->plocks[po / SEQ_PLOCK_SERIAL_SIZE];
+        /* Valeur 16 bits : octet de poids faible en premier (cible little-endian). */
+        switch (po % SEQ_PLOCK_SERIAL_SIZE) {
+        case 0U:  return &pl->step;
+        case 1U:  return &pl->param;
+        case 2U:  return &pl->flags;
+        case 3U:  return (const uint8_t *)&pl->value;
+        default:  return (const uint8_t *)&pl->value + 1;
+        }
+    }
+
+    const uint32_t idx = (o - SEQ_TRACK_HEADER_SIZE) / SEQ_TRIG_SERIAL_SIZE;
+    const seq_trig_t *trig = &track->steps[idx / BRICK_MAX_TRIGS_PER_STEP]
+                                  .trigs[idx % BRICK_MAX_TRIGS_PER_STEP];
+    switch ((o - SEQ_TRACK_HEADER_SIZE) % SEQ_TRIG_SERIAL_SIZE) {
+    case 0U:  return &trig->note;
+    case 1U:  return &trig->velocity;
+    case 2U:  return &trig->length;
+    case 3U:  return &trig->flags;
+    case 4U:  return &trig->cond;
+    default:  return &trig->cond_arg;
+    }
+}
+
+static void header_build(uint8_t *h, const seq_pattern_t *p) {
+    memset(h, 0, SEQ_PATTERN_HEADER_SIZE);
+    h[0] = (uint8_t)(SEQ_PATTERN_MAGIC & 0xFFU);
+    h[1] = (uint8_t)((SEQ_PATTERN_MAGIC >> 8) & 0xFFU);
+    h[2] = (uint8_t)((SEQ_PATTERN_MAGIC >> 16) & 0xFFU);
+    h[3] = (uint8_t)((SEQ_PATTERN_MAGIC >> 24) & 0xFFU);
+    h[4] = SEQ_PATTERN_VERSION;
+    h[5] = BRICK_NUM_TRACKS;
+    h[6] = BRICK_STEPS_PER_TRACK;
+    h[7] = BRICK_MAX_TRIGS_PER_STEP;
+    h[8] = (uint8_t)(p->id & 0xFFU);
+    h[9] = (uint8_t)(p->id >> 8);
+    h[10] = p->length;
+}
+
+static bool header_check(const uint8_t *h) {
+    const uint32_t magic = (uint32_t)h[0] | ((uint32_t)h[1] << 8) |
+                           ((uint32_t)h[2] << 16) | ((uint32_t)h[3] << 24);
+    return (magic == SEQ_PATTERN_MAGIC) &&
+           (h[4] == SEQ_PATTERN_VERSION) &&
+           (h[5] == BRICK_NUM_TRACKS) &&
+           (h[6] == BRICK_STEPS_PER_TRACK) &&
+           (h[7] == BRICK_MAX_TRIGS_PER_STEP) &&
+           (h[10] >= 1U) && (h[10] <= BRICK_STEPS_PER_TRACK);
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void seq_track_clear(seq_track_t *track) {
+    memset(track, 0, sizeof(*track));
+    track->length = BRICK_STEPS_PER_TRACK;
+}
+
+void seq_pattern_bind(seq_pattern_t *pattern, seq_track_t *tracks, uint16_t id) {
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        pattern->tracks[t] = &tracks[t];
+    }
+    pattern->id = id;
+    pattern->length = BRICK_STEPS_PER_TRACK;
+    pattern->reserved = 0U;
+}
+
+void seq_pattern_encode_begin(seq_pattern_encoder_t *enc, const seq_pattern_t *pattern) {
+    enc->pattern = pattern;
+    enc->offset = 0U;
+    enc->hash = FNV1A_OFFSET;
+}
+
+bool seq_pattern_encode_done(const seq_pattern_encoder_t *enc) {
+    return enc->offset >= SEQ_PATTERN_SERIAL_SIZE;
+}
+
+size_t seq_pattern_encode_next(seq_pattern_encoder_t *enc, uint8_t *dst, size_t len) {
+    uint8_t header[SEQ_PATTERN_HEADER_SIZE];
+    size_t n = 0U;
+
+    if (enc->offset < SEQ_PATTERN_HEADER_SIZE) {
+        header_build(header, enc->pattern);
+    }
+
+    while ((n < len) && (enc->offset < SEQ_PATTERN_SERIAL_SIZE)) {
+        const uint32_t off = enc->offset;
+        uint8_t b;
+
+        if (off < SEQ_PATTERN_HEADER_SIZE) {
+            b = header[off];
+        } else if (off < SEQ_TRACKS_END) {
+            const uint32_t t = (off - SEQ_PATTERN_HEADER_SIZE) / SEQ_TRACK_SERIAL_SIZE;
+            const uint32_t o = (off - SEQ_PATTERN_HEADER_SIZE) % SEQ_TRACK_SERIAL_SIZE;
+            const seq_track_t *track = enc->pattern->tracks[t];
+            if (track == NULL) {
+                b = (o == 0U) ? (uint8_t)BRICK_STEPS_PER_TRACK : 0U;
+            } else {
+                b = *track_byte(track, o);
+            }
+        } else {
+            /* Pied : empreinte FNV-1a de tout ce qui précède. */
+            b = (uint8_t)(enc->hash >> (8U * (off - SEQ_TRACKS_END)));
+            dst[n++] = b;
+            enc->offset++;
+            continue;
+        }
+
+        enc->hash = fnv1a(enc->hash, b);
+        dst[n++] = b;
+        enc->offset++;
+    }
+    return n;
+}
+
+void seq_pattern_decode_begin(seq_pattern_decoder_t *dec,
+                              seq_pattern_t *pattern,
+                              seq_track_t *tracks) {
+    dec->tracks = tracks;
+    dec->pattern = pattern;
+    dec->offset = 0U;
+    dec->hash = FNV1A_OFFSET;
+    dec->footer = 0U;
+    dec->status = SEQ_CODEC_MORE;
+}
+
+seq_codec_status_t seq_pattern_decode_feed(seq_pattern_decoder_t *dec,
+                                           const uint8_t *src, size_t len) {
+    if (dec->status != SEQ_CODEC_MORE) {
+        return (len == 0U) ? dec->status : SEQ_CODEC_OVERFLOW;
+    }
+
+    for (size_t i = 0U; i < len; ++i) {
+        const uint32_t off = dec->offset;
+        const uint8_t b = src[i];
+
+        if (off >= SEQ_PATTERN_SERIAL_SIZE) {
+            dec->status = SEQ_CODEC_OVERFLOW;
+            return dec->status;
+        }
+
+        if (off < SEQ_TRACKS_END) {
+            dec->hash = fnv1a(dec->hash, b);
+        }
+
+        if (off < SEQ_PATTERN_HEADER_SIZE) {
+            dec->header[off] = b;
+            if ((off == (SEQ_PATTERN_HEADER_SIZE - 1U)) && !header_check(dec->header)) {
+                dec->status = SEQ_CODEC_BAD_HEADER;
+                return dec->status;
+            }
+        } else if (off < SEQ_TRACKS_END) {
+            const uint32_t t = (off - SEQ_PATTERN_HEADER_SIZE) / SEQ_TRACK_SERIAL_SIZE;
+            const uint32_t o = (off - SEQ_PATTERN_HEADER_SIZE) % SEQ_TRACK_SERIAL_SIZE;
+            /* Le bloc de destination appartient au décodeur : écriture directe. */
+            if (dec->tracks != NULL) {
+                *(uint8_t *)track_byte(&dec->tracks[t], o) = b;
+            }
+        } else {
+            dec->footer |= (uint32_t)b << (8U * (off - SEQ_TRACKS_END));
+        }
+
+        dec->offset++;
+    }
+
+    if (dec->offset < SEQ_PATTERN_SERIAL_SIZE) {
+        return SEQ_CODEC_MORE;
+    }
+
+    if (dec->footer != dec->hash) {
+        dec->status = SEQ_CODEC_BAD_CHECKSUM;
+        return dec->status;
+    }
+
+    if (dec->tracks == NULL) {
+        dec->status = SEQ_CODEC_OK;
+        return dec->status;
+    }
+
+    seq_pattern_bind(dec->pattern, dec->tracks,
+                     (uint16_t)dec->header[8] | ((uint16_t)dec->header[9] << 8));
+    dec->pattern->length = dec->header[10];
+
+    /* Longueurs de piste hors bornes ramenées à la longueur maximale. */
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        if ((dec->tracks[t].length == 0U) || (dec->tracks[t].length > BRICK_STEPS_PER_TRACK)) {
+            dec->tracks[t].length = BRICK_STEPS_PER_TRACK;
+        }
+    }
+
+    dec->status = SEQ_CODEC_OK;
+    return dec->status;
+}
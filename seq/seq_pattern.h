@@ -0,0 +1,163 @@
+/**
+ * @file seq_pattern.h
+ * @brief Modèle de données des patterns (16 pistes × 64 steps) et codec de sérialisation.
+ * @details Un pattern est une vue : un tableau de pointeurs vers des blocs
+ * piste (seq_track_t). Le séquenceur ne lit qu'à travers ces pointeurs, ce qui
+ * permet d'échanger un pattern complet par simple affectation de pointeur et
+ * de partager des blocs piste entre plusieurs versions d'un même pattern.
+ *
+ * Le format sérialisé est de taille fixe (SEQ_PATTERN_SERIAL_SIZE octets,
+ * little-endian) et se code / décode en flux, par morceaux de taille
+ * quelconque : aucun buffer intermédiaire de la taille d'un pattern n'est
+ * nécessaire, que la source soit la carte SD ou un flux SysEx.
+ *
+ * @ingroup seq
+ */
+
+#ifndef SEQ_PATTERN_H
+#define SEQ_PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "brick_config.h"
+
+/* -------------------------------------------------------------------------- */
+/* Types                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/** Steps par mesure (doubles-croches en 4/4). */
+#define SEQ_STEPS_PER_BAR         16U
+
+/* Drapeaux de trig. */
+#define SEQ_TRIG_ACTIVE           0x01U
+
+/* Conditions de trig (champ cond), évaluées à l'avance de step. */
+#define SEQ_COND_NONE             0U
+#define SEQ_COND_PROB             1U    /* cond_arg : probabilité 0..100 %. */
+#define SEQ_COND_FILL             2U
+#define SEQ_COND_NOT_FILL         3U
+#define SEQ_COND_FIRST            4U    /* Premier passage du pattern. */
+#define SEQ_COND_NOT_FIRST        5U
+#define SEQ_COND_AB               6U    /* cond_arg : A << 4 | B, passage A sur B. */
+#define SEQ_COND_COUNT            7U
+
+#define SEQ_COND_AB_ARG(a, b)     ((uint8_t)(((a) << 4) | ((b) & 0x0FU)))
+
+/* Drapeaux de piste. */
+#define SEQ_TRACK_MUTED           0x01U
+
+/* Verrous de paramètre (p-locks) par piste, toutes steps confondues. */
+#define SEQ_TRACK_PLOCKS          64U
+#define SEQ_PLOCK_ACTIVE          0x01U
+
+typedef struct {
+    uint8_t note;
+    uint8_t velocity;
+    uint8_t length;       /* Durée du gate en steps (0 = 1/2 step). */
+    uint8_t flags;        /* SEQ_TRIG_*. */
+    uint8_t cond;         /* SEQ_COND_*. */
+    uint8_t cond_arg;
+} seq_trig_t;
+
+typedef struct {
+    seq_trig_t trigs[BRICK_MAX_TRIGS_PER_STEP];
+} seq_step_t;
+
+/*
+ * Valeur imposée à un paramètre de la cartouche de la piste pendant un step ;
+ * le paramètre reprend sa valeur au premier step joué sans verrou sur lui.
+ */
+typedef struct {
+    uint8_t step;         /* Index de step (0..63). */
+    uint8_t param;        /* Index du paramètre dans le descripteur de la cartouche. */
+    uint8_t flags;        /* SEQ_PLOCK_*. */
+    uint8_t reserved;     /* Non sérialisé. */
+    int16_t value;
+} seq_plock_t;
+
+typedef struct {
+    seq_step_t  steps[BRICK_STEPS_PER_TRACK];
+    seq_plock_t plocks[SEQ_TRACK_PLOCKS];
+    uint8_t     length;   /* Longueur propre de la piste (1..64). */
+    uint8_t     channel;  /* Canal / voie de sortie (slot de cartouche). */
+    uint8_t     flags;    /* SEQ_TRACK_*. */
+    uint8_t     reserved;
+} seq_track_t;
+
+typedef struct {
+    const seq_track_t *tracks[BRICK_NUM_TRACKS];
+    uint16_t           id;       /* Index de stockage d'origine. */
+    uint8_t            length;   /* Longueur du pattern en steps (1..64). */
+    uint8_t            reserved;
+} seq_pattern_t;
+
+/* -------------------------------------------------------------------------- */
+/* Format sérialisé                                                           */
+/* -------------------------------------------------------------------------- */
+
+#define SEQ_PATTERN_MAGIC         0x504B5242UL  /* "BRKP" */
+#define SEQ_PATTERN_VERSION       3U
+
+#define SEQ_PATTERN_HEADER_SIZE   16U
+#define SEQ_TRIG_SERIAL_SIZE      6U
+#define SEQ_PLOCK_SERIAL_SIZE     5U
+#define SEQ_TRACK_HEADER_SIZE     4U
+#define SEQ_TRACK_TRIGS_SIZE      (BRICK_STEPS_PER_TRACK * BRICK_MAX_TRIGS_PER_STEP * \
+                                   SEQ_TRIG_SERIAL_SIZE)
+#define SEQ_TRACK_SERIAL_SIZE     (SEQ_TRACK_HEADER_SIZE + SEQ_TRACK_TRIGS_SIZE + \
+                                   (SEQ_TRACK_PLOCKS * SEQ_PLOCK_SERIAL_SIZE))
+#define SEQ_PATTERN_FOOTER_SIZE   4U
+#define SEQ_PATTERN_SERIAL_SIZE   (SEQ_PATTERN_HEADER_SIZE + \
+                                   (BRICK_NUM_TRACKS * SEQ_TRACK_SERIAL_SIZE) + \
+                                   SEQ_PATTERN_FOOTER_SIZE)
+
+typedef enum {
+    SEQ_CODEC_OK = 0,
+    SEQ_CODEC_MORE,          /* Flux incomplet, continuer à alimenter. */
+    SEQ_CODEC_BAD_HEADER,
+    SEQ_CODEC_BAD_CHECKSUM,
+    SEQ_CODEC_OVERFLOW
+} seq_codec_status_t;
+
+typedef struct {
+    const seq_pattern_t *pattern;
+    uint32_t             offset;
+    uint32_t             hash;
+} seq_pattern_encoder_t;
+
+typedef struct {
+    seq_track_t        *tracks;   /* BRICK_NUM_TRACKS blocs de destination. */
+    seq_pattern_t      *pattern;  /* Vue à renseigner (id, length). */
+    uint32_t            offset;
+    uint32_t            hash;
+    uint32_t            footer;
+    uint8_t             header[SEQ_PATTERN_HEADER_SIZE];
+    seq_codec_status_t  status;
+} seq_pattern_decoder_t;
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void seq_track_clear(seq_track_t *track);
+
+/** Initialise une vue pattern sur un tableau de BRICK_NUM_TRACKS blocs piste. */
+void seq_pattern_bind(seq_pattern_t *pattern, seq_track_t *tracks, uint16_t id);
+
+void   seq_pattern_encode_begin(seq_pattern_encoder_t *enc, const seq_pattern_t *pattern);
+size_t seq_pattern_encode_next(seq_pattern_encoder_t *enc, uint8_t *dst, size_t len);
+bool   seq_pattern_encode_done(const seq_pattern_encoder_t *enc);
+
+/*
+ * Avec pattern et tracks à NULL, le décodeur vérifie seulement le flux
+ * (en-tête, empreinte) sans rien écrire : validation d'un pattern reçu ou
+ * stocké sans mémoire de destination.
+ */
+void               seq_pattern_decode_begin(seq_pattern_decoder_t *dec,
+                                            seq_pattern_t *pattern,
+                                            seq_track_t *tracks);
+seq_codec_status_t seq_pattern_decode_feed(seq_pattern_decoder_t *dec,
+                                           const uint8_t *src, size_t len);
+
+#endif /* SEQ_PATTERN_H */
@@ -0,0 +1,498 @@
+/**
+ * @file seq_song.c
+ * @brief Magasin de patterns double, thread chargeur et bascule sur la mesure.
+ * @ingroup seq
+ */
+
+#include "seq_song.h"
+#include "seq_engine.h"
+#include "seq_history.h"
+#include "seq_storage.h"
+#include <string.h>
+
+#define SEQ_PATTERN_NONE   0xFFFFU
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_LOADING,
+    SLOT_READY,
+    SLOT_ACTIVE
+} slot_state_t;
+
+typedef struct {
+    seq_track_t            tracks[BRICK_NUM_TRACKS];
+    seq_pattern_t          pattern;
+    volatile uint8_t       state;
+    uint8_t                row;          /* Ligne d'origine ou SEQ_SONG_ROW_NONE. */
+    uint8_t                repeats;
+    uint32_t               ready_frame;  /* Horloge séquenceur à la fin du chargement. */
+} seq_slot_t;
+
+typedef enum {
+    SONG_MODE_LOOP = 0,   /* Pattern unique en boucle (+ chaînage par cue). */
+    SONG_MODE_SONG
+} song_mode_t;
+
+static seq_slot_t slots[2];
+
+static struct {
+    seq_song_row_t   rows[SEQ_SONG_MAX_ROWS];
+    uint8_t          length;
+    bool             loop;
+    volatile uint8_t mode;
+    volatile uint8_t active;        /* Index du slot joué. */
+    uint8_t          cur_row;
+    uint32_t         bars_left;     /* Mesures restantes, mesure courante incluse. */
+    bool             waiting;       /* Fin de ligne atteinte, suivant pas prêt. */
+    uint32_t         need_frame;
+    volatile uint16_t cue;          /* Pattern demandé par chaînage. */
+    bool             rebase;        /* Bascule faite, historique d'édition à rebaser. */
+    uint8_t          skips;         /* Lignes sautées depuis le dernier chargement réussi. */
+    bool             last;          /* Plus aucune ligne à précharger : la courante est la dernière. */
+} song;
+
+/* Requête de chargement (protégée par chSysLock). */
+static struct {
+    uint32_t gen;
+    bool     pending;               /* Requête pas encore relevée par le chargeur. */
+    uint8_t  slot;
+    uint16_t pattern;
+    uint8_t  row;
+    uint8_t  repeats;
+    uint8_t  tries;                 /* Nouvelles tentatives déjà faites pour cette source. */
+} load_req;
+
+static seq_song_stats_t stats;
+static binary_semaphore_t loader_sem;
+/*
+ * Tenu pendant tout décodage dans un slot (thread chargeur ou song_start) :
+ * un chargement synchrone n'écrit jamais dans un slot en cours de décodage.
+ */
+static mutex_t loader_lock;
+static THD_WORKING_AREA(seqLoaderWA, SEQ_LOADER_THREAD_STACK_SIZE);
+
+/* -------------------------------------------------------------------------- */
+/* Helpers                                                                    */
+/* -------------------------------------------------------------------------- */
+
+static uint32_t slot_bars(const seq_slot_t *slot) {
+    const uint32_t pass = ((uint32_t)slot->pattern.length + SEQ_STEPS_PER_BAR - 1U) /
+                          SEQ_STEPS_PER_BAR;
+    return pass * ((slot->repeats == 0U) ? 1U : slot->repeats);
+}
+
+/*
+ * Détermine la prochaine source à précharger : cue prioritaire, puis ligne
+ * du song qui suit `from`. Appelée sous chSysLock().
+ */
+static bool song_next_source(uint8_t from, uint16_t *pattern, uint8_t *row, uint8_t *repeats) {
+    if (song.cue != SEQ_PATTERN_NONE) {
+        *pattern = song.cue;
+        *row = SEQ_SONG_ROW_NONE;
+        *repeats = 1U;
+        return true;
+    }
+    if ((song.mode != (uint8_t)SONG_MODE_SONG) || (song.length == 0U)) {
+        return false;
+    }
+
+    uint8_t next = (uint8_t)(from + 1U);
+    if (next >= song.length) {
+        if (!song.loop) {
+            return false;
+        }
+        next = 0U;
+    }
+    *pattern = song.rows[next].pattern;
+    *row = next;
+    *repeats = song.rows[next].repeats;
+    return true;
+}
+
+/* Programme le chargement de la source dans le slot inactif. Appelée sous chSysLock(). */
+static void song_post_load_s(uint16_t pattern, uint8_t row, uint8_t repeats, uint8_t tries) {
+    const uint8_t inactive = (uint8_t)(song.active ^ 1U);
+    slots[inactive].state = (uint8_t)SLOT_LOADING;
+    load_req.gen++;
+    load_req.pending = true;
+    load_req.slot = inactive;
+    load_req.pattern = pattern;
+    load_req.row = row;
+    load_req.repeats = repeats;
+    load_req.tries = tries;
+    song.last = false;
+}
+
+/* Préchargement de la source qui suit la ligne `from`. Appelée sous chSysLock(). */
+static bool song_prefetch_after_s(uint8_t from) {
+    uint16_t pattern;
+    uint8_t row;
+    uint8_t repeats;
+
+    if (!song_next_source(from, &pattern, &row, &repeats)) {
+        return false;
+    }
+    song_post_load_s(pattern, row, repeats, 0U);
+    return true;
+}
+
+/* Programme le préchargement du slot inactif. Appelée sous chSysLock(). */
+static bool song_request_prefetch_s(void) {
+    return song_prefetch_after_s(song.cur_row);
+}
+
+/*
+ * Échec du chargement demandé (chargeur, sous chSysLock) : même source
+ * redemandée, puis abandon. Cue abandonné : le song reprend après la ligne
+ * courante ; ligne abandonnée : la suivante est demandée à sa place, au plus
+ * une fois par ligne du song depuis le dernier chargement réussi.
+ */
+static bool song_load_failed_s(uint8_t row) {
+    if (load_req.tries < SEQ_SONG_LOAD_RETRIES) {
+        song_post_load_s(load_req.pattern, row, load_req.repeats, (uint8_t)(load_req.tries + 1U));
+        return true;
+    }
+    stats.skipped++;
+    if (row == SEQ_SONG_ROW_NONE) {
+        song.cue = SEQ_PATTERN_NONE;
+        return song_request_prefetch_s();
+    }
+    song.skips++;
+    if ((song.skips < song.length) && song_prefetch_after_s(row)) {
+        return true;
+    }
+    song.last = true;
+    return false;
+}
+
+/*
+ * Ligne courante sans suivante : dernière d'un song sans boucle, ou plus
+ * aucune ligne lisible. Sans cue en attente. Appelée sous chSysLock().
+ */
+static bool song_at_end_s(void) {
+    return (song.mode == (uint8_t)SONG_MODE_SONG) && (song.cue == SEQ_PATTERN_NONE) &&
+           (song.last || (!song.loop && (((uint32_t)song.cur_row + 1U) >= song.length)));
+}
+
+static void stats_record_lead(uint16_t pattern, int32_t lead) {
+    stats.switches++;
+    stats.last_lead_frames = lead;
+    if ((stats.switches == 1U) || (lead < stats.min_lead_frames)) {
+        stats.min_lead_frames = lead;
+    }
+    stats.history[stats.history_head].pattern = pattern;
+    stats.history[stats.history_head].lead_frames = lead;
+    stats.history_head = (uint8_t)((stats.history_head + 1U) % SEQ_SONG_HISTORY);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Frontière de mesure (thread audio)                                         */
+/* -------------------------------------------------------------------------- */
+
+static const seq_pattern_t *song_bar_cb(uint32_t bar, uint32_t frame) {
+    (void)bar;
+
+    if (song.bars_left > 1U) {
+        song.bars_left--;
+        return NULL;
+    }
+
+    const uint8_t inactive = (uint8_t)(song.active ^ 1U);
+    seq_slot_t *next = &slots[inactive];
+
+    if (next->state != (uint8_t)SLOT_READY) {
+        /* Rien de prêt : on rejoue le pattern courant et on retente à la mesure suivante. */
+        bool pending = false;
+        chSysLock();
+        pending = (next->state == (uint8_t)SLOT_LOADING);
+        if (!pending && song_at_end_s()) {
+            /* Fin du song : arrêt sur cette frontière, comme seq_song_stop. */
+            song.mode = (uint8_t)SONG_MODE_LOOP;
+            stats.ends++;
+            chSysUnlock();
+            seq_engine_stop();
+            return NULL;
+        }
+        if (!pending && (song.mode == (uint8_t)SONG_MODE_LOOP)) {
+            song.bars_left = slot_bars(&slots[song.active]);
+        } else {
+            song.bars_left = 1U;
+        }
+        if (pending && !song.waiting) {
+            song.waiting = true;
+            song.need_frame = frame;
+            stats.late++;
+        }
+        chSysUnlock();
+        return NULL;
+    }
+
+    const int32_t lead = song.waiting ? -(int32_t)(next->ready_frame - song.need_frame)
+                                      : (int32_t)(frame - next->ready_frame);
+
+    chSysLock();
+    slots[song.active].state = (uint8_t)SLOT_FREE;
+    next->state = (uint8_t)SLOT_ACTIVE;
+    song.active = inactive;
+    song.waiting = false;
+    if (next->row == SEQ_SONG_ROW_NONE) {
+        /* Pattern chaîné : il boucle jusqu'au prochain cue. */
+        song.cue = SEQ_PATTERN_NONE;
+        song.mode = (uint8_t)SONG_MODE_LOOP;
+    } else {
+        song.cur_row = next->row;
+    }
+    song.bars_left = slot_bars(next);
+    song.rebase = true;
+    stats_record_lead(next->pattern.id, lead);
+    (void)song_request_prefetch_s();
+    chSysUnlock();
+
+    /* Réveil du chargeur : rebasage de l'historique, puis préchargement éventuel. */
+    chBSemSignal(&loader_sem);
+    return &next->pattern;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread chargeur                                                            */
+/* -------------------------------------------------------------------------- */
+
+static THD_FUNCTION(seqLoaderThread, arg) {
+    (void)arg;
+    chRegSetThreadName("seqLoader");
+
+    while (true) {
+        chBSemWait(&loader_sem);
+
+        /* Requête relevée sous le verrou : song_start ne peut pas l'invalider en cours de décodage. */
+        chMtxLock(&loader_lock);
+        chSysLock();
+        const bool rebase = song.rebase;
+        const seq_pattern_t *active = &slots[song.active].pattern;
+        song.rebase = false;
+        const bool pending = load_req.pending;
+        load_req.pending = false;
+        const uint32_t gen = load_req.gen;
+        const uint8_t s = load_req.slot;
+        const uint16_t pattern = load_req.pattern;
+        const uint8_t row = load_req.row;
+        const uint8_t repeats = load_req.repeats;
+        chSysUnlock();
+
+        /*
+         * Le slot actif ne redevient cible du chargeur qu'après une nouvelle
+         * bascule, et ce chargeur attend le verrou : la copie est cohérente.
+         * Une bascule pendant la copie relève à nouveau `rebase`.
+         */
+        if (rebase) {
+            seq_history_begin(active);
+        }
+        if (!pending) {
+            chMtxUnlock(&loader_lock);
+            continue;
+        }
+
+        seq_slot_t *slot = &slots[s];
+        const systime_t t0 = chVTGetSystemTimeX();
+        const bool ok = seq_storage_load_pattern(pattern, &slot->pattern, slot->tracks);
+        const systime_t dt = chVTTimeElapsedSinceX(t0);
+
+        chSysLock();
+        if (gen != load_req.gen) {
+            /* Requête remplacée pendant le chargement (cue) : résultat ignoré. */
+            chSysUnlock();
+            chMtxUnlock(&loader_lock);
+            continue;
+        }
+        bool retry = false;
+        if (ok) {
+            slot->row = row;
+            slot->repeats = repeats;
+            slot->ready_frame = seq_engine_get_frame();
+            slot->state = (uint8_t)SLOT_READY;
+            song.skips = 0U;
+        } else {
+            slot->state = (uint8_t)SLOT_FREE;
+            stats.load_errors++;
+            retry = song_load_failed_s(row);
+        }
+        if (dt > stats.max_load_time) {
+            stats.max_load_time = dt;
+        }
+        chSysUnlock();
+        chMtxUnlock(&loader_lock);
+
+        /* Nouvelle requête : relevée au tour suivant, sans attendre. */
+        if (retry) {
+            chBSemSignal(&loader_sem);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void seq_song_init(void) {
+    memset(&song, 0, sizeof(song));
+    memset(&stats, 0, sizeof(stats));
+    memset(&load_req, 0, sizeof(load_req));
+    song.cue = SEQ_PATTERN_NONE;
+    song.mode = (uint8_t)SONG_MODE_LOOP;
+    song.loop = true;
+
+    for (uint8_t s = 0U; s < 2U; ++s) {
+        for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+            seq_track_clear(&slots[s].tracks[t]);
+        }
+        seq_pattern_bind(&slots[s].pattern, slots[s].tracks, 0U);
+        slots[s].state = (uint8_t)SLOT_FREE;
+        slots[s].row = SEQ_SONG_ROW_NONE;
+        slots[s].repeats = 1U;
+    }
+
+    seq_storage_init();
+    chBSemObjectInit(&loader_sem, true);
+    chMtxObjectInit(&loader_lock);
+    chThdCreateStatic(seqLoaderWA, sizeof(seqLoaderWA),
+                      SEQ_LOADER_THREAD_PRIORITY, seqLoaderThread, NULL);
+    seq_engine_set_bar_cb(song_bar_cb);
+}
+
+bool seq_song_set_row(uint8_t row, uint16_t pattern, uint8_t repeats) {
+    if ((row >= SEQ_SONG_MAX_ROWS) || (pattern >= STORAGE_PATTERN_COUNT)) {
+        return false;
+    }
+    chSysLock();
+    song.rows[row].pattern = pattern;
+    song.rows[row].repeats = (repeats == 0U) ? 1U : repeats;
+    chSysUnlock();
+    return true;
+}
+
+void seq_song_set_length(uint8_t rows, bool loop) {
+    if (rows > SEQ_SONG_MAX_ROWS) {
+        rows = SEQ_SONG_MAX_ROWS;
+    }
+    chSysLock();
+    song.length = rows;
+    song.loop = loop;
+    chSysUnlock();
+}
+
+bool seq_song_get_entry(uint8_t row, seq_song_row_t *entry) {
+    if ((row >= SEQ_SONG_MAX_ROWS) || (entry == NULL)) {
+        return false;
+    }
+    chSysLock();
+    *entry = song.rows[row];
+    chSysUnlock();
+    return true;
+}
+
+uint8_t seq_song_get_length(bool *loop) {
+    chSysLock();
+    const uint8_t rows = song.length;
+    if (loop != NULL) {
+        *loop = song.loop;
+    }
+    chSysUnlock();
+    return rows;
+}
+
+/*
+ * Chargement synchrone dans le slot 0 puis démarrage (séquenceur arrêté).
+ * Attend la fin d'un décodage en cours du chargeur, qui peut viser le slot 0.
+ */
+static bool song_start(uint16_t pattern, uint8_t row, uint8_t repeats, song_mode_t mode) {
+    seq_engine_stop();
+    seq_engine_set_pattern(NULL);
+
+    chMtxLock(&loader_lock);
+    chSysLock();
+    load_req.gen++;               /* Invalide une requête pas encore relevée. */
+    load_req.pending = false;
+    song.rebase = false;
+    slots[0].state = (uint8_t)SLOT_LOADING;
+    slots[1].state = (uint8_t)SLOT_FREE;
+    chSysUnlock();
+
+    if (!seq_storage_load_pattern(pattern, &slots[0].pattern, slots[0].tracks)) {
+        chSysLock();
+        slots[0].state = (uint8_t)SLOT_FREE;
+        stats.load_errors++;
+        chSysUnlock();
+        chMtxUnlock(&loader_lock);
+        return false;
+    }
+
+    chSysLock();
+    slots[0].row = row;
+    slots[0].repeats = repeats;
+    slots[0].state = (uint8_t)SLOT_ACTIVE;
+    song.active = 0U;
+    song.mode = (uint8_t)mode;
+    song.cur_row = row;
+    song.cue = SEQ_PATTERN_NONE;
+    song.waiting = false;
+    song.skips = 0U;
+    song.last = false;
+    /* +1 : la première frontière (mesure 0) ouvre la ligne sans la décompter. */
+    song.bars_left = slot_bars(&slots[0]) + 1U;
+    const bool prefetch = song_request_prefetch_s();
+    chSysUnlock();
+    seq_history_begin(&slots[0].pattern);
+    chMtxUnlock(&loader_lock);
+
+    if (prefetch) {
+        chBSemSignal(&loader_sem);
+    }
+    seq_engine_set_pattern(&slots[0].pattern);
+    seq_engine_start();
+    return true;
+}
+
+bool seq_song_play(uint8_t row) {
+    if ((row >= song.length) || (row >= SEQ_SONG_MAX_ROWS)) {
+        return false;
+    }
+    return song_start(song.rows[row].pattern, row, song.rows[row].repeats, SONG_MODE_SONG);
+}
+
+bool seq_song_play_pattern(uint16_t pattern) {
+    return song_start(pattern, SEQ_SONG_ROW_NONE, 1U, SONG_MODE_LOOP);
+}
+
+void seq_song_stop(void) {
+    seq_engine_stop();
+    chSysLock();
+    song.mode = (uint8_t)SONG_MODE_LOOP;
+    song.cue = SEQ_PATTERN_NONE;
+    chSysUnlock();
+}
+
+void seq_song_cue(uint16_t pattern) {
+    if (pattern >= STORAGE_PATTERN_COUNT) {
+        return;
+    }
+    chSysLock();
+    song.cue = pattern;
+    const bool prefetch = song_request_prefetch_s();
+    chSysUnlock();
+    if (prefetch) {
+        chBSemSignal(&loader_sem);
+    }
+}
+
+uint8_t seq_song_get_row(void) {
+    return (song.mode == (uint8_t)SONG_MODE_SONG) ? song.cur_row : SEQ_SONG_ROW_NONE;
+}
+
+void seq_song_get_stats(seq_song_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = stats;
+    chSysUnlock();
+}
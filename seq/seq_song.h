@@ -0,0 +1,89 @@
+/**
+ * @file seq_song.h
+ * @brief Mode song / chaînage de patterns avec préchargement en tâche de fond.
+ * @details Le magasin de patterns est doublé : un slot actif lu par le
+ * séquenceur, un slot inactif rempli par un thread chargeur de basse
+ * priorité (lecture SD + décodage). À la frontière de mesure qui termine la
+ * ligne courante, le callback de mesure du séquenceur échange simplement
+ * les slots : aucune copie ni décodage sur le chemin temps réel. Après la
+ * bascule, le thread chargeur rebase l'historique d'édition (seq_history)
+ * sur le nouveau pattern avant tout préchargement.
+ *
+ * Un pattern illisible (slot vide, empreinte fausse, erreur SD) est
+ * redemandé SEQ_SONG_LOAD_RETRIES fois, puis abandonné : un cue est oublié
+ * et le song reprend son cours, une ligne est sautée au profit de la
+ * suivante ; la ligne courante est rejouée le temps des nouvelles
+ * tentatives. À la fin d'un song sans boucle, ou quand plus aucune ligne
+ * n'est lisible, le séquenceur s'arrête sur la frontière qui termine la
+ * ligne courante (la mesure suivante n'est pas jouée), comme sur
+ * seq_song_stop.
+ *
+ * L'instrumentation mesure, pour chaque changement, l'avance (en frames
+ * audio) entre l'instant où le pattern est devenu prêt et celui où il a été
+ * utilisé ; une avance négative signale un chargement en retard.
+ *
+ * @ingroup seq
+ */
+
+#ifndef SEQ_SONG_H
+#define SEQ_SONG_H
+
+#include "ch.h"
+#include "seq_pattern.h"
+
+#define SEQ_SONG_MAX_ROWS             64U
+#define SEQ_SONG_HISTORY              16U
+#define SEQ_SONG_ROW_NONE             0xFFU
+
+/** Nouvelles tentatives de chargement d'un pattern avant abandon. */
+#define SEQ_SONG_LOAD_RETRIES         2U
+
+/** Thread chargeur : basse priorité, ne doit jamais concurrencer l'UI. */
+#define SEQ_LOADER_THREAD_STACK_SIZE  1024U
+#define SEQ_LOADER_THREAD_PRIORITY    (NORMALPRIO - 10)
+
+typedef struct {
+    uint16_t pattern;     /* Index de stockage. */
+    uint8_t  repeats;     /* Nombre de passages (>= 1). */
+} seq_song_row_t;
+
+typedef struct {
+    uint16_t pattern;
+    int32_t  lead_frames; /* > 0 : prêt en avance ; < 0 : retard. */
+} seq_song_lead_t;
+
+typedef struct {
+    uint32_t        switches;
+    uint32_t        late;            /* Fins de ligne sans pattern suivant prêt. */
+    uint32_t        load_errors;
+    uint32_t        skipped;         /* Lignes ou cues abandonnés après échecs. */
+    uint32_t        ends;            /* Fins de song sans boucle (arrêt). */
+    int32_t         min_lead_frames;
+    int32_t         last_lead_frames;
+    systime_t       max_load_time;   /* Pire durée de chargement (ticks système). */
+    seq_song_lead_t history[SEQ_SONG_HISTORY];
+    uint8_t         history_head;    /* Prochaine entrée écrite. */
+} seq_song_stats_t;
+
+void seq_song_init(void);
+
+bool seq_song_set_row(uint8_t row, uint16_t pattern, uint8_t repeats);
+void seq_song_set_length(uint8_t rows, bool loop);
+
+/* Lecture de l'arrangement (dump de projet). */
+bool    seq_song_get_entry(uint8_t row, seq_song_row_t *entry);
+uint8_t seq_song_get_length(bool *loop);
+
+/* Charge la ligne `row` (bloquant) puis démarre le séquenceur en mode song. */
+bool seq_song_play(uint8_t row);
+/* Charge un pattern unique (bloquant) et le joue en boucle. */
+bool seq_song_play_pattern(uint16_t pattern);
+void seq_song_stop(void);
+
+/* Chaînage : le pattern est préchargé et joué à la fin du passage courant. */
+void seq_song_cue(uint16_t pattern);
+
+uint8_t seq_song_get_row(void);
+void    seq_song_get_stats(seq_song_stats_t *st);
+
+#endif /* SEQ_SONG_H */
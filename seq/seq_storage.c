@@ -0,0 +1,156 @@
+/**
+ * @file seq_storage.c
+ * @brief Lecture/écriture des patterns sérialisés sur la carte SD.
+ * @ingroup seq
+ */
+
+#include "seq_storage.h"
+
+BRICK_STATIC_ASSERT(SEQ_STORAGE_PATTERN_BLOCKS <= STORAGE_PATTERN_SLOT_BLOCKS,
+                    pattern_does_not_fit_storage_slot);
+
+/* Buffer IDMA : l'IDMA de SDMMC1 n'accède qu'à l'AXI SRAM (RAM par défaut). */
+static uint8_t seq_storage_buf[SEQ_STORAGE_CHUNK_BLOCKS * STORAGE_BLOCK_SIZE]
+    __attribute__((aligned(32)));
+static mutex_t seq_storage_lock;
+
+static uint32_t seq_storage_lba(uint16_t index) {
+    return STORAGE_PATTERN_BASE_LBA + ((uint32_t)index * STORAGE_PATTERN_SLOT_BLOCKS);
+}
+
+static bool seq_storage_range_ok(uint16_t slot, uint32_t block, uint32_t blocks) {
+    return (slot <= SEQ_STORAGE_STAGING_SLOT) && (blocks > 0U) &&
+           (block < STORAGE_PATTERN_SLOT_BLOCKS) &&
+           (blocks <= (STORAGE_PATTERN_SLOT_BLOCKS - block));
+}
+
+/* Lit le slot par morceaux et alimente le décodeur. */
+static seq_codec_status_t seq_storage_decode(uint16_t slot, seq_pattern_decoder_t *dec) {
+    chMtxLock(&seq_storage_lock);
+    uint32_t lba = seq_storage_lba(slot);
+    uint32_t remaining = SEQ_PATTERN_SERIAL_SIZE;
+    seq_codec_status_t st = SEQ_CODEC_MORE;
+
+    while ((remaining > 0U) && (st == SEQ_CODEC_MORE)) {
+        uint32_t blocks = (remaining + STORAGE_BLOCK_SIZE - 1U) / STORAGE_BLOCK_SIZE;
+        if (blocks > SEQ_STORAGE_CHUNK_BLOCKS) {
+            blocks = SEQ_STORAGE_CHUNK_BLOCKS;
+        }
+        if (!drv_storage_read(lba, seq_storage_buf, blocks)) {
+            break;
+        }
+        uint32_t n = blocks * STORAGE_BLOCK_SIZE;
+        if (n > remaining) {
+            n = remaining;
+        }
+        st = seq_pattern_decode_feed(dec, seq_storage_buf, n);
+        remaining -= n;
+        lba += blocks;
+    }
+    chMtxUnlock(&seq_storage_lock);
+
+    return st;
+}
+
+void seq_storage_init(void) {
+    chMtxObjectInit(&seq_storage_lock);
+    drv_storage_init();
+}
+
+bool seq_storage_load_pattern(uint16_t index, seq_pattern_t *pattern, seq_track_t *tracks) {
+    if (index >= STORAGE_PATTERN_COUNT) {
+        return false;
+    }
+
+    seq_pattern_decoder_t dec;
+    seq_pattern_decode_begin(&dec, pattern, tracks);
+    const seq_codec_status_t st = seq_storage_decode(index, &dec);
+
+    if (st != SEQ_CODEC_OK) {
+        return false;
+    }
+    pattern->id = index;
+    return true;
+}
+
+bool seq_storage_save_pattern(uint16_t index, const seq_pattern_t *pattern) {
+    if (index >= STORAGE_PATTERN_COUNT) {
+        return false;
+    }
+
+    seq_pattern_encoder_t enc;
+    seq_pattern_encode_begin(&enc, pattern);
+
+    chMtxLock(&seq_storage_lock);
+    uint32_t lba = seq_storage_lba(index);
+    bool ok = true;
+
+    while (ok && !seq_pattern_encode_done(&enc)) {
+        size_t n = seq_pattern_encode_next(&enc, seq_storage_buf, sizeof(seq_storage_buf));
+        const uint32_t blocks = (uint32_t)((n + STORAGE_BLOCK_SIZE - 1U) / STORAGE_BLOCK_SIZE);
+        /* Complète le dernier bloc partiel avec des zéros. */
+        while ((n % STORAGE_BLOCK_SIZE) != 0U) {
+            seq_storage_buf[n++] = 0U;
+        }
+        ok = drv_storage_write(lba, seq_storage_buf, blocks);
+        lba += blocks;
+    }
+    chMtxUnlock(&seq_storage_lock);
+
+    return ok;
+}
+
+bool seq_storage_read_blocks(uint16_t slot, uint32_t block, uint8_t *buf, uint32_t blocks) {
+    if (!seq_storage_range_ok(slot, block, blocks)) {
+        return false;
+    }
+    chMtxLock(&seq_storage_lock);
+    const bool ok = drv_storage_read(seq_storage_lba(slot) + block, buf, blocks);
+    chMtxUnlock(&seq_storage_lock);
+    return ok;
+}
+
+bool seq_storage_write_blocks(uint16_t slot, uint32_t block, const uint8_t *buf, uint32_t blocks) {
+    if (!seq_storage_range_ok(slot, block, blocks)) {
+        return false;
+    }
+    chMtxLock(&seq_storage_lock);
+    const bool ok = drv_storage_write(seq_storage_lba(slot) + block, buf, blocks);
+    chMtxUnlock(&seq_storage_lock);
+    return ok;
+}
+
+bool seq_storage_check_pattern(uint16_t slot) {
+    if (slot > SEQ_STORAGE_STAGING_SLOT) {
+        return false;
+    }
+
+    seq_pattern_decoder_t dec;
+    seq_pattern_decode_begin(&dec, NULL, NULL);
+    return seq_storage_decode(slot, &dec) == SEQ_CODEC_OK;
+}
+
+bool seq_storage_commit_staging(uint16_t index) {
+    if (index >= STORAGE_PATTERN_COUNT) {
+        return false;
+    }
+
+    chMtxLock(&seq_storage_lock);
+    uint32_t src = seq_storage_lba(SEQ_STORAGE_STAGING_SLOT);
+    uint32_t dst = seq_storage_lba(index);
+    uint32_t remaining = SEQ_STORAGE_PATTERN_BLOCKS;
+    bool ok = true;
+
+    while (ok && (remaining > 0U)) {
+        const uint32_t blocks = (remaining > SEQ_STORAGE_CHUNK_BLOCKS) ? SEQ_STORAGE_CHUNK_BLOCKS
+                                                                      : remaining;
+        ok = drv_storage_read(src, seq_storage_buf, blocks) &&
+             drv_storage_write(dst, seq_storage_buf, blocks);
+        src += blocks;
+        dst += blocks;
+        remaining -= blocks;
+    }
+    chMtxUnlock(&seq_storage_lock);
+
+    return ok;
+}
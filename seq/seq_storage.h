@@ -0,0 +1,50 @@
+/**
+ * @file seq_storage.h
+ * @brief Chargement / sauvegarde des patterns sur la zone SD dédiée.
+ * @details Les patterns sont lus et décodés par morceaux de
+ * SEQ_STORAGE_CHUNK_BLOCKS blocs directement dans les blocs piste de
+ * destination : aucune copie intermédiaire d'un pattern complet.
+ * Fonctions bloquantes, à appeler depuis un thread de basse priorité.
+ *
+ * @ingroup seq
+ */
+
+#ifndef SEQ_STORAGE_H
+#define SEQ_STORAGE_H
+
+#include "ch.h"
+#include "seq_pattern.h"
+#include "drv_storage.h"
+
+/** Blocs lus ou écrits par transaction SD. */
+#define SEQ_STORAGE_CHUNK_BLOCKS   4U
+
+/** Slot de transit (hors magasin) : écrit en flux, puis validé et recopié. */
+#define SEQ_STORAGE_STAGING_SLOT   ((uint16_t)STORAGE_PATTERN_COUNT)
+
+/** Blocs occupés par un pattern sérialisé dans son slot. */
+#define SEQ_STORAGE_PATTERN_BLOCKS \
+    ((SEQ_PATTERN_SERIAL_SIZE + STORAGE_BLOCK_SIZE - 1U) / STORAGE_BLOCK_SIZE)
+
+void seq_storage_init(void);
+bool seq_storage_load_pattern(uint16_t index, seq_pattern_t *pattern, seq_track_t *tracks);
+bool seq_storage_save_pattern(uint16_t index, const seq_pattern_t *pattern);
+
+/*
+ * Accès brut aux blocs d'un slot (index < STORAGE_PATTERN_COUNT ou
+ * SEQ_STORAGE_STAGING_SLOT), pour les transferts en flux (dump SysEx).
+ * `buf` doit être en AXI SRAM (IDMA de SDMMC1).
+ */
+bool seq_storage_read_blocks(uint16_t slot, uint32_t block, uint8_t *buf, uint32_t blocks);
+bool seq_storage_write_blocks(uint16_t slot, uint32_t block, const uint8_t *buf, uint32_t blocks);
+
+/* Vérifie le pattern du slot (en-tête, empreinte) sans le décoder. */
+bool seq_storage_check_pattern(uint16_t slot);
+
+/*
+ * Recopie le slot de transit vers `index` sous le verrou du stockage : un
+ * chargement concurrent lit l'ancien ou le nouveau pattern, jamais un mélange.
+ */
+bool seq_storage_commit_staging(uint16_t index);
+
+#endif /* SEQ_STORAGE_H */
@@ -0,0 +1,826 @@
+/**
+ * @file seq_sysex.c
+ * @brief Protocole de dump / restauration SysEx, fenêtre glissante et thread de transfert.
+ * @ingroup seq
+ */
+
+#include "seq_sysex.h"
+#include "midi_router.h"
+#include "seq_song.h"
+#include "seq_storage.h"
+#include <string.h>
+
+/* Message sans F0 / F7 : fabricant, modèle, commande, numéro, données, somme. */
+#define SX_HEADER_SIZE      3U
+#define SX_MSG_MAX          (SX_HEADER_SIZE + 1U + SEQ_SYSEX_CHUNK_PACKED + 1U)
+#define SX_BEGIN_ARGS       6U
+
+/* Arrangement sérialisé : longueur, boucle, puis (pattern 16 bits, répétitions). */
+#define SX_SONG_SIZE        (2U + (SEQ_SONG_MAX_ROWS * 3U))
+
+#define SX_SEQ_MASK         0x7FU
+#define SX_POLL_MS          50U
+
+BRICK_STATIC_ASSERT((SEQ_SYSEX_CHUNK_RAW % 7U) == 0U, sysex_chunk_whole_groups);
+BRICK_STATIC_ASSERT(SEQ_SYSEX_WINDOW < SX_SEQ_MASK, sysex_window_exceeds_seq);
+BRICK_STATIC_ASSERT(SEQ_PATTERN_SERIAL_SIZE < (1UL << 21), sysex_size_exceeds_21_bits);
+BRICK_STATIC_ASSERT(STORAGE_PATTERN_COUNT <= (1U << 14), sysex_index_exceeds_14_bits);
+
+/* -------------------------------------------------------------------------- */
+/* État                                                                       */
+/* -------------------------------------------------------------------------- */
+
+/* Réassemblage par port source (un seul thread par source). */
+typedef struct {
+    uint8_t buf[SX_MSG_MAX];
+    uint8_t len;
+    bool    skip;             /* Message étranger, trop long ou interrompu. */
+} sx_asm_t;
+
+/* Objet reçu en attente du thread : BEGIN, DATA ou CANCEL. */
+typedef struct {
+    uint8_t cmd;
+    uint8_t port;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t data[SEQ_SYSEX_CHUNK_RAW];
+} sx_slot_t;
+
+typedef enum {
+    TX_STAGE_PATTERNS = 0,
+    TX_STAGE_SONG,
+    TX_STAGE_END
+} tx_stage_t;
+
+static struct {
+    bool      active;
+    uint8_t   port;
+    bool      project;
+    uint8_t   stage;
+    uint16_t  scan;           /* Prochain slot examiné. */
+    uint8_t   kind;
+    uint16_t  index;
+    uint32_t  size;
+    uint32_t  chunks;
+    uint32_t  next;           /* Prochain morceau émis. */
+    uint32_t  sent;           /* Morceaux déjà émis au moins une fois. */
+    uint32_t  base;           /* Plus ancien morceau non acquitté. */
+    uint8_t   retries;
+    bool      handshake;      /* Le destinataire acquitte. */
+    bool      open_loop;
+    uint16_t  objects;
+    uint32_t  bytes;
+    uint32_t  cached_block;
+    systime_t start;
+    systime_t progress;
+} sx_tx;
+
+/* Évènements de l'émetteur, posés par le callback de réception. */
+static struct {
+    bool    ack;
+    uint8_t ack_seq;
+    bool    nak;
+    uint8_t nak_seq;
+    bool    cancel;
+} sx_tx_evt;
+
+/* Requête de dump reçue (protégée par chSysLock). */
+static struct {
+    bool     pending;
+    uint8_t  port;
+    bool     project;
+    uint16_t index;
+} sx_req;
+
+static struct {
+    bool                  active;
+    uint8_t               port;
+    uint8_t               kind;
+    uint16_t              index;
+    uint32_t              size;
+    uint32_t              offset;
+    uint32_t              block;      /* Prochain bloc du slot de transit. */
+    uint32_t              fill;       /* Octets en attente dans sx_rx_block. */
+    uint8_t               expect;
+    bool                  nak_sent;
+    systime_t             start;
+    systime_t             last;
+    seq_pattern_decoder_t check;
+} sx_rx;
+
+static sx_asm_t sx_asm[MIDI_NUM_PORTS];
+static sx_slot_t sx_slots[SEQ_SYSEX_RX_SLOTS];
+static uint32_t sx_slot_head = 0U;
+static uint32_t sx_slot_tail = 0U;
+
+/* Buffers IDMA : AXI SRAM (RAM par défaut). */
+static uint8_t sx_tx_block[STORAGE_BLOCK_SIZE] __attribute__((aligned(32)));
+static uint8_t sx_rx_block[STORAGE_BLOCK_SIZE] __attribute__((aligned(32)));
+static uint8_t sx_tx_song[SX_SONG_SIZE];
+static uint8_t sx_rx_song[SX_SONG_SIZE];
+static uint8_t sx_msg[SX_MSG_MAX];
+
+static seq_sysex_stats_t sx_stats;
+static seq_sysex_app_cb_t sx_app_cb = NULL;
+static binary_semaphore_t sx_wake;
+static bool sx_initialized = false;
+
+static THD_WORKING_AREA(seqSysexWA, SEQ_SYSEX_THREAD_STACK_SIZE);
+
+/* -------------------------------------------------------------------------- */
+/* Émission de messages                                                       */
+/* -------------------------------------------------------------------------- */
+
+static bool sx_send(uint8_t port, uint8_t cmd, const uint8_t *args, size_t n) {
+    sx_msg[0] = SEQ_SYSEX_MANUFACTURER;
+    sx_msg[1] = SEQ_SYSEX_MODEL;
+    sx_msg[2] = cmd;
+    if (n > 0U) {
+        memcpy(&sx_msg[SX_HEADER_SIZE], args, n);
+    }
+    return midi_router_send_sysex(port, sx_msg, SX_HEADER_SIZE + n,
+                                  MIDI_SYSEX_FLAG_START | MIDI_SYSEX_FLAG_END);
+}
+
+static bool sx_send_seq(uint8_t port, uint8_t cmd, uint8_t seq) {
+    return sx_send(port, cmd, &seq, 1U);
+}
+
+static uint32_t sx_rate(uint32_t bytes, systime_t start) {
+    uint32_t ms = (uint32_t)TIME_I2MS(chVTTimeElapsedSinceX(start));
+    if (ms == 0U) {
+        ms = 1U;
+    }
+    return (uint32_t)(((uint64_t)bytes * 1000U) / ms);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Dump                                                                       */
+/* -------------------------------------------------------------------------- */
+
+static void sx_song_serialize(uint8_t *dst) {
+    bool loop = false;
+    dst[0] = seq_song_get_length(&loop);
+    dst[1] = loop ? 1U : 0U;
+    for (uint8_t r = 0U; r < SEQ_SONG_MAX_ROWS; ++r) {
+        seq_song_row_t row = {0U, 1U};
+        (void)seq_song_get_entry(r, &row);
+        dst[2U + (3U * r)] = (uint8_t)(row.pattern & 0xFFU);
+        dst[3U + (3U * r)] = (uint8_t)(row.pattern >> 8);
+        dst[4U + (3U * r)] = row.repeats;
+    }
+}
+
+static bool tx_begin_object(uint8_t kind, uint16_t index, uint32_t size) {
+    sx_tx.kind = kind;
+    sx_tx.index = index;
+    sx_tx.size = size;
+    sx_tx.chunks = (size + SEQ_SYSEX_CHUNK_RAW - 1U) / SEQ_SYSEX_CHUNK_RAW;
+    sx_tx.next = 0U;
+    sx_tx.sent = 0U;
+    sx_tx.base = 0U;
+    sx_tx.retries = 0U;
+    sx_tx.cached_block = UINT32_MAX;
+    sx_tx.progress = chVTGetSystemTimeX();
+    sx_tx.objects++;
+
+    const uint8_t args[SX_BEGIN_ARGS] = {
+        kind,
+        (uint8_t)(index & 0x7FU), (uint8_t)((index >> 7) & 0x7FU),
+        (uint8_t)(size & 0x7FU), (uint8_t)((size >> 7) & 0x7FU), (uint8_t)((size >> 14) & 0x7FU)
+    };
+    return sx_send(sx_tx.port, SEQ_SYSEX_CMD_BEGIN, args, sizeof(args));
+}
+
+/* Objet suivant du dump ; false quand il n'y en a plus. */
+static bool tx_next_object(bool *ok) {
+    *ok = true;
+    if (sx_tx.stage == (uint8_t)TX_STAGE_PATTERNS) {
+        while (sx_tx.scan < STORAGE_PATTERN_COUNT) {
+            const uint16_t index = sx_tx.scan++;
+            if (seq_storage_check_pattern(index)) {
+                if (!sx_tx.project) {
+                    sx_tx.scan = STORAGE_PATTERN_COUNT;
+                    sx_tx.stage = (uint8_t)TX_STAGE_END;
+                }
+                *ok = tx_begin_object(SEQ_SYSEX_KIND_PATTERN, index, SEQ_PATTERN_SERIAL_SIZE);
+                return true;
+            }
+            if (!sx_tx.project) {
+                *ok = false;        /* Slot demandé vide ou corrompu. */
+                return false;
+            }
+        }
+        sx_tx.stage = (uint8_t)TX_STAGE_SONG;
+    }
+    if (sx_tx.stage == (uint8_t)TX_STAGE_SONG) {
+        sx_tx.stage = (uint8_t)TX_STAGE_END;
+        sx_song_serialize(sx_tx_song);
+        *ok = tx_begin_object(SEQ_SYSEX_KIND_SONG, 0U, SX_SONG_SIZE);
+        return true;
+    }
+    return false;
+}
+
+/* Lit `len` octets de l'objet courant à partir de `off`, bloc SD par bloc SD. */
+static bool tx_read(uint32_t off, uint8_t *dst, uint32_t len) {
+    if (sx_tx.kind == SEQ_SYSEX_KIND_SONG) {
+        memcpy(dst, &sx_tx_song[off], len);
+        return true;
+    }
+    while (len > 0U) {
+        const uint32_t block = off / STORAGE_BLOCK_SIZE;
+        const uint32_t pos = off % STORAGE_BLOCK_SIZE;
+        uint32_t n = STORAGE_BLOCK_SIZE - pos;
+        if (n > len) {
+            n = len;
+        }
+        if (block != sx_tx.cached_block) {
+            if (!seq_storage_read_blocks(sx_tx.index, block, sx_tx_block, 1U)) {
+                sx_tx.cached_block = UINT32_MAX;
+                return false;
+            }
+            sx_tx.cached_block = block;
+        }
+        memcpy(dst, &sx_tx_block[pos], n);
+        dst += n;
+        off += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool tx_send_chunk(uint32_t n) {
+    uint8_t raw[SEQ_SYSEX_CHUNK_RAW];
+    const uint32_t off = n * SEQ_SYSEX_CHUNK_RAW;
+    uint32_t len = sx_tx.size - off;
+    if (len > SEQ_SYSEX_CHUNK_RAW) {
+        len = SEQ_SYSEX_CHUNK_RAW;
+    }
+    if (!tx_read(off, raw, len)) {
+        return false;
+    }
+
+    uint8_t args[1U + SEQ_SYSEX_CHUNK_PACKED + 1U];
+    args[0] = (uint8_t)(n & SX_SEQ_MASK);
+    const size_t packed = midi_sysex7_pack(raw, len, &args[1]);
+    args[1U + packed] = midi_sysex7_checksum(args, 1U + packed);
+    return sx_send(sx_tx.port, SEQ_SYSEX_CMD_DATA, args, packed + 2U);
+}
+
+static void tx_finish(bool ok) {
+    if (ok) {
+        const uint8_t args[2] = {
+            (uint8_t)(sx_tx.objects & 0x7FU), (uint8_t)((sx_tx.objects >> 7) & 0x7FU)
+        };
+        ok = sx_send(sx_tx.port, SEQ_SYSEX_CMD_END, args, sizeof(args));
+    } else {
+        (void)sx_send(sx_tx.port, SEQ_SYSEX_CMD_CANCEL, NULL, 0U);
+    }
+
+    const uint32_t rate = sx_rate(sx_tx.bytes, sx_tx.start);
+    chSysLock();
+    if (ok) {
+        sx_stats.dumps++;
+        sx_stats.port[sx_tx.port].tx_rate = rate;
+    } else {
+        sx_stats.dumps_failed++;
+    }
+    if (sx_tx.open_loop) {
+        sx_stats.open_loop++;
+    }
+    sx_tx.active = false;
+    chSysUnlock();
+}
+
+/* Numéro de morceau absolu d'un numéro 7 bits, s'il est dans [base, sent). */
+static bool tx_resolve(uint8_t seq, uint32_t *n) {
+    const uint32_t cand = sx_tx.base + (((uint32_t)seq - sx_tx.base) & SX_SEQ_MASK);
+    if (cand >= sx_tx.sent) {
+        return false;
+    }
+    *n = cand;
+    return true;
+}
+
+/* Avance le dump d'un pas. Retourne true s'il reste à émettre sans attendre. */
+static bool tx_step(void) {
+    chSysLock();
+    const bool ack = sx_tx_evt.ack;
+    const uint8_t ack_seq = sx_tx_evt.ack_seq;
+    const bool nak = sx_tx_evt.nak;
+    const uint8_t nak_seq = sx_tx_evt.nak_seq;
+    const bool cancel = sx_tx_evt.cancel;
+    sx_tx_evt.ack = false;
+    sx_tx_evt.nak = false;
+    sx_tx_evt.cancel = false;
+    chSysUnlock();
+
+    if (cancel) {
+        tx_finish(false);
+        return false;
+    }
+
+    uint32_t n;
+    if (ack && tx_resolve(ack_seq, &n)) {
+        sx_tx.handshake = true;
+        sx_tx.base = n + 1U;
+        if (sx_tx.next < sx_tx.base) {
+            sx_tx.next = sx_tx.base;
+        }
+        sx_tx.retries = 0U;
+        sx_tx.progress = chVTGetSystemTimeX();
+    }
+    if (nak && tx_resolve(nak_seq, &n)) {
+        sx_tx.handshake = true;
+        sx_tx.base = n;
+        sx_tx.next = n;
+        sx_tx.progress = chVTGetSystemTimeX();
+        chSysLock();
+        sx_stats.retransmits++;
+        chSysUnlock();
+    }
+
+    /* Émission dans la fenêtre. */
+    if ((sx_tx.next < sx_tx.chunks) &&
+        (sx_tx.open_loop || ((sx_tx.next - sx_tx.base) < SEQ_SYSEX_WINDOW))) {
+        if (!tx_send_chunk(sx_tx.next)) {
+            tx_finish(false);
+            return false;
+        }
+        if (sx_tx.next == sx_tx.base) {
+            sx_tx.progress = chVTGetSystemTimeX();
+        }
+        sx_tx.next++;
+        if (sx_tx.next > sx_tx.sent) {
+            sx_tx.sent = sx_tx.next;
+        }
+        if (sx_tx.open_loop) {
+            sx_tx.base = sx_tx.next;
+        }
+        return true;
+    }
+
+    /* Objet entièrement acquitté (ou émis en boucle ouverte) : suivant. */
+    if (sx_tx.base >= sx_tx.chunks) {
+        chSysLock();
+        sx_tx.bytes += sx_tx.size;
+        sx_stats.port[sx_tx.port].tx_bytes += sx_tx.size;
+        chSysUnlock();
+
+        bool ok;
+        if (tx_next_object(&ok)) {
+            if (!ok) {
+                tx_finish(false);
+                return false;
+            }
+            return true;
+        }
+        tx_finish(ok);
+        return false;
+    }
+
+    /* Fenêtre pleine : attente des acquittements. */
+    if (chVTTimeElapsedSinceX(sx_tx.progress) >= TIME_MS2I(SEQ_SYSEX_ACK_TIMEOUT_MS)) {
+        sx_tx.progress = chVTGetSystemTimeX();
+        if (!sx_tx.handshake) {
+            /* Aucun ACK depuis le début : destinataire passif. */
+            sx_tx.open_loop = true;
+            sx_tx.base = sx_tx.next;
+            return true;
+        }
+        if (++sx_tx.retries > SEQ_SYSEX_MAX_RETRIES) {
+            tx_finish(false);
+            return false;
+        }
+        sx_tx.next = sx_tx.base;
+        chSysLock();
+        sx_stats.retransmits++;
+        chSysUnlock();
+        return true;
+    }
+    return false;
+}
+
+static void tx_start(uint8_t port, bool project, uint16_t index) {
+    chSysLock();
+    memset(&sx_tx, 0, sizeof(sx_tx));
+    memset(&sx_tx_evt, 0, sizeof(sx_tx_evt));
+    sx_tx.port = port;
+    sx_tx.project = project;
+    sx_tx.stage = (uint8_t)TX_STAGE_PATTERNS;
+    sx_tx.scan = project ? 0U : index;
+    sx_tx.start = chVTGetSystemTimeX();
+    sx_tx.active = true;
+    chSysUnlock();
+
+    bool ok = false;
+    if ((!project && (index >= STORAGE_PATTERN_COUNT)) || !tx_next_object(&ok) || !ok) {
+        tx_finish(false);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Restauration                                                               */
+/* -------------------------------------------------------------------------- */
+
+static void rx_fail(void) {
+    (void)sx_send(sx_rx.port, SEQ_SYSEX_CMD_CANCEL, NULL, 0U);
+    sx_rx.active = false;
+    chSysLock();
+    sx_stats.restores_failed++;
+    chSysUnlock();
+}
+
+static void sx_song_apply(const uint8_t *src) {
+    for (uint8_t r = 0U; r < SEQ_SONG_MAX_ROWS; ++r) {
+        const uint16_t pattern = (uint16_t)src[2U + (3U * r)] |
+                                 ((uint16_t)src[3U + (3U * r)] << 8);
+        (void)seq_song_set_row(r, pattern, src[4U + (3U * r)]);
+    }
+    seq_song_set_length(src[0], src[1] != 0U);
+}
+
+static void rx_begin(const sx_slot_t *s) {
+    if (sx_rx.active && (sx_rx.port != s->port) &&
+        (chVTTimeElapsedSinceX(sx_rx.last) < TIME_MS2I(SEQ_SYSEX_IDLE_TIMEOUT_MS))) {
+        /* Une seule restauration à la fois. */
+        (void)sx_send(s->port, SEQ_SYSEX_CMD_CANCEL, NULL, 0U);
+        return;
+    }
+
+    const uint8_t kind = s->data[0];
+    const uint16_t index = (uint16_t)s->data[1] | ((uint16_t)s->data[2] << 7);
+    const uint32_t size = (uint32_t)s->data[3] | ((uint32_t)s->data[4] << 7) |
+                          ((uint32_t)s->data[5] << 14);
+
+    memset(&sx_rx, 0, sizeof(sx_rx));
+    sx_rx.port = s->port;
+    sx_rx.kind = kind;
+    sx_rx.index = index;
+    sx_rx.size = size;
+    sx_rx.start = chVTGetSystemTimeX();
+    sx_rx.last = sx_rx.start;
+
+    const bool valid = ((kind == SEQ_SYSEX_KIND_PATTERN) && (index < STORAGE_PATTERN_COUNT) &&
+                        (size == SEQ_PATTERN_SERIAL_SIZE)) ||
+                       ((kind == SEQ_SYSEX_KIND_SONG) && (size == SX_SONG_SIZE));
+    if (!valid) {
+        chSysLock();
+        sx_stats.rx_errors++;
+        chSysUnlock();
+        rx_fail();
+        return;
+    }
+    seq_pattern_decode_begin(&sx_rx.check, NULL, NULL);
+    sx_rx.active = true;
+}
+
+/* Écrit le bloc de transit courant (complété par des zéros). */
+static bool rx_flush_block(void) {
+    if (sx_rx.fill == 0U) {
+        return true;
+    }
+    memset(&sx_rx_block[sx_rx.fill], 0, STORAGE_BLOCK_SIZE - sx_rx.fill);
+    const bool ok = seq_storage_write_blocks(SEQ_STORAGE_STAGING_SLOT, sx_rx.block,
+                                             sx_rx_block, 1U);
+    sx_rx.block++;
+    sx_rx.fill = 0U;
+    return ok;
+}
+
+static bool rx_store(const uint8_t *data, uint32_t len) {
+    if (sx_rx.kind == SEQ_SYSEX_KIND_SONG) {
+        memcpy(&sx_rx_song[sx_rx.offset], data, len);
+        return true;
+    }
+
+    const seq_codec_status_t st = seq_pattern_decode_feed(&sx_rx.check, data, len);
+    if ((st != SEQ_CODEC_MORE) && (st != SEQ_CODEC_OK)) {
+        return false;
+    }
+    while (len > 0U) {
+        uint32_t n = STORAGE_BLOCK_SIZE - sx_rx.fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&sx_rx_block[sx_rx.fill], data, n);
+        sx_rx.fill += n;
+        data += n;
+        len -= n;
+        if ((sx_rx.fill == STORAGE_BLOCK_SIZE) && !rx_flush_block()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool rx_complete(void) {
+    if (sx_rx.kind == SEQ_SYSEX_KIND_SONG) {
+        sx_song_apply(sx_rx_song);
+        return true;
+    }
+    return rx_flush_block() &&
+           (seq_pattern_decode_feed(&sx_rx.check, NULL, 0U) == SEQ_CODEC_OK) &&
+           seq_storage_commit_staging(sx_rx.index);
+}
+
+static void rx_data(const sx_slot_t *s) {
+    if (!sx_rx.active || (s->port != sx_rx.port)) {
+        return;
+    }
+    sx_rx.last = chVTGetSystemTimeX();
+
+    if (s->seq != sx_rx.expect) {
+        /* Doublon (ACK perdu, reprise sur délai) : ré-acquitté. */
+        const uint8_t behind = (uint8_t)((sx_rx.expect - s->seq) & SX_SEQ_MASK);
+        if (behind <= SEQ_SYSEX_WINDOW) {
+            (void)sx_send_seq(sx_rx.port, SEQ_SYSEX_CMD_ACK,
+                              (uint8_t)((sx_rx.expect - 1U) & SX_SEQ_MASK));
+            return;
+        }
+        /* Un seul NAK par trou : l'émetteur reprend au morceau attendu. */
+        if (!sx_rx.nak_sent) {
+            sx_rx.nak_sent = true;
+            (void)sx_send_seq(sx_rx.port, SEQ_SYSEX_CMD_NAK, sx_rx.expect);
+            chSysLock();
+            sx_stats.naks++;
+            chSysUnlock();
+        }
+        return;
+    }
+    sx_rx.nak_sent = false;
+
+    const uint32_t remaining = sx_rx.size - sx_rx.offset;
+    const uint32_t len = s->len;
+    if ((len > remaining) || ((len < SEQ_SYSEX_CHUNK_RAW) && (len != remaining)) ||
+        !rx_store(s->data, len)) {
+        rx_fail();
+        return;
+    }
+    sx_rx.offset += len;
+    sx_rx.expect = (uint8_t)((sx_rx.expect + 1U) & SX_SEQ_MASK);
+
+    if (sx_rx.offset == sx_rx.size) {
+        if (!rx_complete()) {
+            rx_fail();
+            return;
+        }
+        sx_rx.active = false;
+        const uint32_t rate = sx_rate(sx_rx.size, sx_rx.start);
+        chSysLock();
+        sx_stats.restores++;
+        sx_stats.port[sx_rx.port].rx_bytes += sx_rx.size;
+        sx_stats.port[sx_rx.port].rx_rate = rate;
+        chSysUnlock();
+    }
+
+    /* Acquitté après écriture : l'ACK cadence l'émetteur. */
+    (void)sx_send_seq(sx_rx.port, SEQ_SYSEX_CMD_ACK, s->seq);
+}
+
+static bool rx_pop(sx_slot_t *s) {
+    chSysLock();
+    const bool any = sx_slot_tail != sx_slot_head;
+    if (any) {
+        *s = sx_slots[sx_slot_tail % SEQ_SYSEX_RX_SLOTS];
+        sx_slot_tail++;
+    }
+    chSysUnlock();
+    return any;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Réception (thread de la source)                                            */
+/* -------------------------------------------------------------------------- */
+
+static void rx_push(uint8_t cmd, uint8_t port, uint8_t seq, const uint8_t *data, size_t len) {
+    chSysLock();
+    if ((sx_slot_head - sx_slot_tail) < SEQ_SYSEX_RX_SLOTS) {
+        sx_slot_t *s = &sx_slots[sx_slot_head % SEQ_SYSEX_RX_SLOTS];
+        s->cmd = cmd;
+        s->port = port;
+        s->seq = seq;
+        s->len = (uint8_t)len;
+        if (len > 0U) {
+            memcpy(s->data, data, len);
+        }
+        sx_slot_head++;
+        chBSemSignalI(&sx_wake);
+        chSchRescheduleS();
+    } else {
+        sx_stats.rx_overflows++;
+    }
+    chSysUnlock();
+}
+
+static void sx_post_request(uint8_t port, bool project, uint16_t index) {
+    chSysLock();
+    if (!sx_req.pending) {
+        sx_req.pending = true;
+        sx_req.port = port;
+        sx_req.project = project;
+        sx_req.index = index;
+        chBSemSignalI(&sx_wake);
+        chSchRescheduleS();
+    }
+    chSysUnlock();
+}
+
+static void sx_rx_message(uint8_t port, const uint8_t *m, size_t len) {
+    const uint8_t cmd = m[2];
+    const uint8_t *args = &m[SX_HEADER_SIZE];
+    const size_t n = len - SX_HEADER_SIZE;
+
+    switch (cmd) {
+    case SEQ_SYSEX_CMD_REQ_PATTERN:
+        if (n == 2U) {
+            sx_post_request(port, false, (uint16_t)args[0] | ((uint16_t)args[1] << 7));
+        }
+        return;
+    case SEQ_SYSEX_CMD_REQ_PROJECT:
+        sx_post_request(port, true, 0U);
+        return;
+    case SEQ_SYSEX_CMD_BEGIN:
+        if (n == SX_BEGIN_ARGS) {
+            rx_push(cmd, port, 0U, args, n);
+        }
+        return;
+    case SEQ_SYSEX_CMD_DATA: {
+        uint8_t raw[SEQ_SYSEX_CHUNK_RAW];
+        size_t raw_len = 0U;
+        if ((n >= 3U) && (n <= (SEQ_SYSEX_CHUNK_PACKED + 2U)) &&
+            (midi_sysex7_checksum(args, n - 1U) == args[n - 1U])) {
+            raw_len = midi_sysex7_unpack(&args[1], n - 2U, raw);
+        }
+        if (raw_len == 0U) {
+            chSysLock();
+            sx_stats.rx_errors++;
+            chSysUnlock();
+            return;    /* Le trou sera signalé par NAK au morceau suivant. */
+        }
+        rx_push(cmd, port, args[0], raw, raw_len);
+        return;
+    }
+    case SEQ_SYSEX_CMD_ACK:
+    case SEQ_SYSEX_CMD_NAK:
+    case SEQ_SYSEX_CMD_CANCEL:
+        chSysLock();
+        if (sx_tx.active && (sx_tx.port == port)) {
+            if (cmd == SEQ_SYSEX_CMD_CANCEL) {
+                sx_tx_evt.cancel = true;
+            } else if ((n == 1U) && (cmd == SEQ_SYSEX_CMD_ACK)) {
+                sx_tx_evt.ack = true;
+                sx_tx_evt.ack_seq = args[0];
+            } else if (n == 1U) {
+                sx_tx_evt.nak = true;
+                sx_tx_evt.nak_seq = args[0];
+            }
+            chBSemSignalI(&sx_wake);
+            chSchRescheduleS();
+        }
+        chSysUnlock();
+        if (cmd == SEQ_SYSEX_CMD_CANCEL) {
+            rx_push(cmd, port, 0U, NULL, 0U);
+        }
+        return;
+    default:
+        if ((cmd >= SEQ_SYSEX_CMD_APP_FIRST) && (cmd <= SEQ_SYSEX_CMD_APP_LAST) &&
+            (sx_app_cb != NULL)) {
+            sx_app_cb(port, cmd, args, n);
+        }
+        return;
+    }
+}
+
+void seq_sysex_rx(void *ctx, const uint8_t *data, size_t len, uint8_t flags, uint32_t frame) {
+    (void)frame;
+    const uint8_t port = (uint8_t)(uintptr_t)ctx;
+    if ((port >= MIDI_NUM_PORTS) || !sx_initialized) {
+        return;
+    }
+
+    sx_asm_t *a = &sx_asm[port];
+    if ((flags & MIDI_SYSEX_FLAG_START) != 0U) {
+        a->len = 0U;
+        a->skip = false;
+    }
+    if ((flags & MIDI_SYSEX_FLAG_ABORT) != 0U) {
+        a->skip = true;
+        return;
+    }
+    if (a->skip) {
+        return;
+    }
+    if ((a->len + len) > SX_MSG_MAX) {
+        a->skip = true;
+        return;
+    }
+    memcpy(&a->buf[a->len], data, len);
+    a->len = (uint8_t)(a->len + len);
+
+    /* Message d'un autre appareil : ignoré dès l'en-tête. */
+    if (((a->len >= 1U) && (a->buf[0] != SEQ_SYSEX_MANUFACTURER)) ||
+        ((a->len >= 2U) && (a->buf[1] != SEQ_SYSEX_MODEL))) {
+        a->skip = true;
+        return;
+    }
+    if (((flags & MIDI_SYSEX_FLAG_END) != 0U) && (a->len >= SX_HEADER_SIZE)) {
+        sx_rx_message(port, a->buf, a->len);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread de transfert                                                        */
+/* -------------------------------------------------------------------------- */
+
+static THD_FUNCTION(seqSysexThread, arg) {
+    (void)arg;
+    chRegSetThreadName("seqSysex");
+    bool more = false;
+
+    while (true) {
+        if (!more) {
+            (void)chBSemWaitTimeout(&sx_wake, TIME_MS2I(SX_POLL_MS));
+        }
+
+        sx_slot_t s;
+        while (rx_pop(&s)) {
+            if (s.cmd == SEQ_SYSEX_CMD_BEGIN) {
+                rx_begin(&s);
+            } else if (s.cmd == SEQ_SYSEX_CMD_DATA) {
+                rx_data(&s);
+            } else if (sx_rx.active && (sx_rx.port == s.port)) {
+                sx_rx.active = false;      /* CANCEL de l'émetteur. */
+                chSysLock();
+                sx_stats.restores_failed++;
+                chSysUnlock();
+            }
+        }
+        if (sx_rx.active &&
+            (chVTTimeElapsedSinceX(sx_rx.last) >= TIME_MS2I(SEQ_SYSEX_IDLE_TIMEOUT_MS))) {
+            rx_fail();
+        }
+
+        if (!sx_tx.active) {
+            chSysLock();
+            const bool pending = sx_req.pending;
+            const uint8_t port = sx_req.port;
+            const bool project = sx_req.project;
+            const uint16_t index = sx_req.index;
+            sx_req.pending = false;
+            chSysUnlock();
+            if (pending) {
+                tx_start(port, project, index);
+            }
+        }
+        more = sx_tx.active && tx_step();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void seq_sysex_init(void) {
+    if (sx_initialized) {
+        return;
+    }
+    memset(&sx_stats, 0, sizeof(sx_stats));
+    memset(sx_asm, 0, sizeof(sx_asm));
+    chBSemObjectInit(&sx_wake, true);
+    chThdCreateStatic(seqSysexWA, sizeof(seqSysexWA),
+                      SEQ_SYSEX_THREAD_PRIORITY, seqSysexThread, NULL);
+    sx_initialized = true;
+}
+
+void seq_sysex_set_app_cb(seq_sysex_app_cb_t cb) {
+    sx_app_cb = cb;
+}
+
+bool seq_sysex_dump_pattern(uint8_t port, uint16_t index) {
+    if ((port == MIDI_PORT_INTERNAL) || (port >= MIDI_NUM_PORTS) ||
+        (index >= STORAGE_PATTERN_COUNT) || sx_tx.active || sx_req.pending) {
+        return false;
+    }
+    sx_post_request(port, false, index);
+    return true;
+}
+
+bool seq_sysex_dump_project(uint8_t port) {
+    if ((port == MIDI_PORT_INTERNAL) || (port >= MIDI_NUM_PORTS) ||
+        sx_tx.active || sx_req.pending) {
+        return false;
+    }
+    sx_post_request(port, true, 0U);
+    return true;
+}
+
+void seq_sysex_get_stats(seq_sysex_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = sx_stats;
+    chSysUnlock();
+}
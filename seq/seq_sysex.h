@@ -0,0 +1,121 @@
+/**
+ * @file seq_sysex.h
+ * @brief Dump et restauration SysEx des patterns et du projet, en flux.
+ * @details Messages F0 7D 42 <cmd> … F7 (identifiant non commercial). Un
+ * transfert est une suite d'objets : BEGIN (type, index, taille), morceaux
+ * DATA de SEQ_SYSEX_CHUNK_RAW octets bruts empaquetés 7 bits (numéro de
+ * morceau modulo 128, somme de contrôle), puis END en fin de dump. Un
+ * pattern est l'image exacte de son slot SD (format seq_pattern, empreinte
+ * comprise) ; le projet est la suite des slots valides puis l'arrangement
+ * du mode song.
+ *
+ * Dump : lu bloc par bloc dans le slot SD au fil de l'émission, sans
+ * sérialisation préalable. Contrôle de flux par fenêtre glissante de
+ * SEQ_SYSEX_WINDOW morceaux non acquittés : ACK cumulatif, NAK = reprise au
+ * morceau indiqué, délai = reprise au plus ancien non acquitté. Un
+ * destinataire qui n'acquitte jamais (enregistreur SysEx) fait passer le
+ * dump en boucle ouverte, cadencé par la seule contre-pression du routeur.
+ *
+ * Restauration : les morceaux sont écrits bloc par bloc dans le slot de
+ * transit (SEQ_STORAGE_STAGING_SLOT) et vérifiés au passage ; le pattern
+ * n'est recopié vers son slot qu'une fois complet et valide, puis le
+ * dernier morceau est acquitté. Un pattern en cours de lecture reste
+ * intact ; il sera relu au prochain chargement. L'ACK n'est émis qu'après
+ * l'écriture SD : c'est lui qui cadence l'émetteur.
+ *
+ * Débits atteignables (octets utiles) :
+ *  - DIN, 31 250 bauds : 3 125 octets/s sur le fil, un DATA de 135 octets
+ *    porte 112 octets, soit au plus ~2 590 octets/s, ~9,5 s par pattern.
+ *    Avec deux morceaux en vol, l'ACK (6 octets, ~2 ms sur la voie retour)
+ *    arrive pendant l'émission du morceau suivant (~43 ms) : la ligne ne
+ *    s'arrête pas ;
+ *  - USB full speed : un DATA tient en 45 paquets USB-MIDI, le débit est
+ *    borné par la fenêtre, deux morceaux par aller-retour de l'hôte (1 à
+ *    2 ms), soit ~100 à 200 ko/s, et en restauration par les écritures SD.
+ * Les débits mesurés sont publiés par port dans seq_sysex_stats_t.
+ *
+ * Les commandes SEQ_SYSEX_CMD_APP_FIRST..SEQ_SYSEX_CMD_APP_LAST ne sont pas
+ * interprétées ici : elles sont passées au callback de l'application
+ * (seq_sysex_set_app_cb), qui répond elle-même sur le port source.
+ *
+ * @ingroup seq
+ */
+
+#ifndef SEQ_SYSEX_H
+#define SEQ_SYSEX_H
+
+#include "ch.h"
+#include "midi_parser.h"
+#include "midi_sysex7.h"
+
+#define SEQ_SYSEX_MANUFACTURER        0x7DU    /* Non commercial. */
+#define SEQ_SYSEX_MODEL               0x42U
+
+/* Commandes (octet suivant le modèle). */
+#define SEQ_SYSEX_CMD_REQ_PATTERN     0x01U    /* index (2 × 7 bits). */
+#define SEQ_SYSEX_CMD_REQ_PROJECT     0x02U
+#define SEQ_SYSEX_CMD_BEGIN           0x10U    /* type, index (2 × 7), taille (3 × 7). */
+#define SEQ_SYSEX_CMD_DATA            0x11U    /* numéro, données 7 bits, somme. */
+#define SEQ_SYSEX_CMD_END             0x12U    /* objets émis (2 × 7). */
+#define SEQ_SYSEX_CMD_ACK             0x20U    /* numéro du dernier morceau reçu. */
+#define SEQ_SYSEX_CMD_NAK             0x21U    /* numéro du morceau attendu. */
+#define SEQ_SYSEX_CMD_CANCEL          0x23U
+#define SEQ_SYSEX_CMD_APP_FIRST       0x30U    /* Commandes de l'application. */
+#define SEQ_SYSEX_CMD_APP_LAST        0x3FU
+
+/* Types d'objet (BEGIN). */
+#define SEQ_SYSEX_KIND_PATTERN        0U
+#define SEQ_SYSEX_KIND_SONG           1U
+
+/** Octets bruts par morceau : 16 groupes de 7, 128 octets empaquetés. */
+#define SEQ_SYSEX_CHUNK_RAW           112U
+#define SEQ_SYSEX_CHUNK_PACKED        MIDI_SYSEX7_PACKED_SIZE(SEQ_SYSEX_CHUNK_RAW)
+
+#define SEQ_SYSEX_WINDOW              2U       /* Morceaux émis non acquittés. */
+#define SEQ_SYSEX_RX_SLOTS            4U       /* Morceaux reçus en attente d'écriture. */
+#define SEQ_SYSEX_ACK_TIMEOUT_MS      500U
+#define SEQ_SYSEX_MAX_RETRIES         3U
+#define SEQ_SYSEX_IDLE_TIMEOUT_MS     2000U    /* Restauration abandonnée. */
+
+#define SEQ_SYSEX_THREAD_STACK_SIZE   1024U
+#define SEQ_SYSEX_THREAD_PRIORITY     (NORMALPRIO - 5)
+
+typedef struct {
+    uint32_t tx_bytes;        /* Octets bruts émis par les dumps. */
+    uint32_t rx_bytes;        /* Octets bruts restaurés. */
+    uint32_t tx_rate;         /* Débit utile du dernier dump complet, octets/s. */
+    uint32_t rx_rate;         /* Débit utile du dernier objet restauré, octets/s. */
+} seq_sysex_port_stats_t;
+
+typedef struct {
+    seq_sysex_port_stats_t port[MIDI_NUM_PORTS];
+    uint32_t dumps;
+    uint32_t dumps_failed;
+    uint32_t open_loop;       /* Dumps passés en boucle ouverte. */
+    uint32_t retransmits;     /* Reprises sur NAK ou délai. */
+    uint32_t restores;        /* Objets restaurés. */
+    uint32_t restores_failed; /* Empreinte, écriture SD, abandon. */
+    uint32_t naks;
+    uint32_t rx_errors;       /* Somme de contrôle, format. */
+    uint32_t rx_overflows;    /* Morceaux perdus faute de place. */
+} seq_sysex_stats_t;
+
+/*
+ * Commande de l'application reçue complète (callback SysEx du routeur) :
+ * arguments sans en-tête ni F0/F7. Ne pas bloquer.
+ */
+typedef void (*seq_sysex_app_cb_t)(uint8_t port, uint8_t cmd, const uint8_t *args, size_t n);
+
+void seq_sysex_init(void);
+void seq_sysex_set_app_cb(seq_sysex_app_cb_t cb);
+
+/* Callback SysEx de la sortie interne du routeur (ctx = port source). */
+void seq_sysex_rx(void *ctx, const uint8_t *data, size_t len, uint8_t flags, uint32_t frame);
+
+/* Dumps à l'initiative de l'appareil ; false si un dump est déjà en cours. */
+bool seq_sysex_dump_pattern(uint8_t port, uint16_t index);
+bool seq_sysex_dump_project(uint8_t port);
+
+void seq_sysex_get_stats(seq_sysex_stats_t *st);
+
+#endif /* SEQ_SYSEX_H */
@@ -0,0 +1,330 @@
+/**
+ * @file audio_align_run.c
+ * @brief Mesure de latence et alignement d'audio_align sur un banc simulé, coût par bloc.
+ * @details Le banc reproduit l'ordre de drv_audio, bloc de 16 frames par
+ * bloc : entrées (SPI-LINK, ADC) -> audio_align_input -> mixeur ->
+ * sorties -> audio_align_output -> push. Le monde simulé :
+ *  - cartouches 0, 1, 2 : chaîne de 0, 3 et 5 blocs, la sortie SPI-LINK
+ *    d'un bloc revient en entrée 1 + latence blocs plus tard (transfert
+ *    SPI-LINK compris) ; une note partie dans la trame revient pareil ;
+ *  - cartouche 3 : latence tirée à chaque bloc entre 1 et 2 blocs
+ *    (instable), puis muette (délai dépassé), puis remplacée par une
+ *    chaîne de 4 blocs dont la latence (80 frames) est imposée ;
+ *  - ADC : sortie DAC 0 reliée à l'entrée ADC 0 avec 37 frames de retard.
+ *
+ * Vérifié : latences mesurées (16, 64, 96 et 37 frames), échecs de la
+ * cartouche instable puis muette, bouclage demandé pendant la mesure
+ * seulement, chemin muet pendant sa mesure, puis une impulsion émise au
+ * même instant sur tous les chemins arrive à la même frame au mixeur,
+ * avant et après l'oubli du chemin le plus lent et avec une latence
+ * imposée. Coût d'un bloc (entrée + sortie, lignes à retard actives).
+ *
+ * Usage : audio_align_run
+ */
+
+#include "host_check.h"
+#include "audio_align.h"
+
+#include <string.h>
+
+#define FRAMES                BRICK_AUDIO_FRAME_SAMPLES
+#define DAC_CHANNELS          8U
+#define HIST_BLOCKS           16U          /* Puissance de 2. */
+#define ADC_LOOP_FRAMES       37U
+#define ADC_HIST_FRAMES       1024U        /* Puissance de 2. */
+#define JITTER_CART           3U
+#define BENCH_BLOCKS          1000000U
+#define NO_FRAME              0xFFFFFFFFU
+
+typedef int32_t spi_block_t[BRICK_MAX_CARTRIDGES][FRAMES][AUDIO_ALIGN_CART_CHANNELS];
+
+/* -------------------------------------------------------------------------- */
+/* Monde simulé                                                               */
+/* -------------------------------------------------------------------------- */
+
+static const int32_t cart_latency_blocks[BRICK_MAX_CARTRIDGES] = { 0, 3, 5, -1 };
+
+typedef enum {
+    CART3_JITTER = 0,
+    CART3_DEAD,
+    CART3_FIXED
+} cart3_mode_t;
+
+static spi_block_t spi_hist[HIST_BLOCKS];           /* Sorties SPI-LINK poussées. */
+static int32_t dac_hist[ADC_HIST_FRAMES][DAC_CHANNELS];
+static uint32_t block_no;
+static uint32_t rng = 0x414C4E31U;
+static cart3_mode_t cart3_mode = CART3_JITTER;
+
+static bool looped[AUDIO_ALIGN_PATHS];
+static uint32_t loop_calls[AUDIO_ALIGN_PATHS];
+
+static void loop_cb(uint8_t path, bool loop) {
+    CHECK(path < AUDIO_ALIGN_PATHS);
+    CHECK(looped[path] != loop);
+    looped[path] = loop;
+    loop_calls[path]++;
+}
+
+static void world_inputs(spi_block_t spi_in, int32_t adc_in[FRAMES][AUDIO_ALIGN_ADC_CHANNELS]) {
+    for (uint32_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        int32_t lat = cart_latency_blocks[c];
+        if (c == JITTER_CART) {
+            if (cart3_mode == CART3_JITTER) {
+                lat = (int32_t)(1U + (host_rand(&rng) & 1U));
+            } else {
+                lat = (cart3_mode == CART3_DEAD) ? -1 : 4;
+            }
+        }
+        const uint32_t back = 1U + (uint32_t)lat;
+        if ((lat < 0) || (block_no < back)) {
+            memset(spi_in[c], 0, sizeof(spi_in[c]));
+        } else {
+            memcpy(spi_in[c], spi_hist[(block_no - back) & (HIST_BLOCKS - 1U)][c], sizeof(spi_in[c]));
+        }
+    }
+    memset(adc_in, 0, sizeof(int32_t) * FRAMES * AUDIO_ALIGN_ADC_CHANNELS);
+    for (uint32_t f = 0U; f < FRAMES; ++f) {
+        const uint32_t now = (block_no * FRAMES) + f;
+        if (now >= ADC_LOOP_FRAMES) {
+            adc_in[f][0] = dac_hist[(now - ADC_LOOP_FRAMES) & (ADC_HIST_FRAMES - 1U)][0];
+        }
+    }
+}
+
+static void world_push(spi_block_t spi_out, int32_t dac_out[FRAMES][DAC_CHANNELS]) {
+    memcpy(spi_hist[block_no & (HIST_BLOCKS - 1U)], spi_out, sizeof(spi_block_t));
+    for (uint32_t f = 0U; f < FRAMES; ++f) {
+        memcpy(dac_hist[((block_no * FRAMES) + f) & (ADC_HIST_FRAMES - 1U)], dac_out[f],
+               sizeof(dac_out[f]));
+    }
+    block_no++;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Boucle audio                                                               */
+/* -------------------------------------------------------------------------- */
+
+/* Première frame (absolue) où le mixeur a vu un signal, par chemin. */
+static uint32_t seen[AUDIO_ALIGN_PATHS];
+
+/*
+ * Un bloc : `emit_at` >= 0 place une impulsion à cette frame du bloc sur
+ * toutes les sorties (canal 1 des cartouches, DAC 0).
+ */
+static void run_block(int32_t emit_at) {
+    static spi_block_t spi_in;
+    static spi_block_t spi_out;
+    static int32_t adc_in[FRAMES][AUDIO_ALIGN_ADC_CHANNELS];
+    static int32_t adc_out[FRAMES][AUDIO_ALIGN_ADC_CHANNELS];
+    static int32_t dac_out[FRAMES][DAC_CHANNELS];
+
+    world_inputs(spi_in, adc_in);
+    audio_align_input(&adc_in[0][0], &adc_out[0][0], spi_in, FRAMES, true);
+
+    /* Mixeur : rien ne doit passer d'un chemin en cours de mesure. */
+    for (uint32_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        audio_align_status_t st;
+        audio_align_get_status((uint8_t)p, &st);
+        for (uint32_t f = 0U; f < FRAMES; ++f) {
+            bool hit = false;
+            for (uint32_t ch = 0U; ch < AUDIO_ALIGN_CART_CHANNELS; ++ch) {
+                hit |= (p == AUDIO_ALIGN_ADC) ? (adc_out[f][ch] != 0) : (spi_in[p][f][ch] != 0);
+            }
+            if (hit) {
+                CHECK(st.state != AUDIO_ALIGN_MEASURING);
+                if (seen[p] == NO_FRAME) {
+                    seen[p] = (block_no * FRAMES) + f;
+                }
+            }
+        }
+    }
+
+    memset(spi_out, 0, sizeof(spi_out));
+    memset(dac_out, 0, sizeof(dac_out));
+    if (emit_at >= 0) {
+        for (uint32_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+            spi_out[c][emit_at][1] = AUDIO_ALIGN_LEVEL;
+        }
+        dac_out[emit_at][0] = AUDIO_ALIGN_LEVEL;
+    }
+    audio_align_output(&dac_out[0][0], DAC_CHANNELS, spi_out, FRAMES);
+    world_push(spi_out, dac_out);
+}
+
+static void run_idle(uint32_t blocks) {
+    for (uint32_t i = 0U; i < blocks; ++i) {
+        run_block(-1);
+    }
+}
+
+static void status(uint8_t path, audio_align_status_t *st) {
+    audio_align_get_status(path, st);
+}
+
+static bool any_measuring(void) {
+    for (uint8_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        audio_align_status_t st;
+        status(p, &st);
+        if (st.state == AUDIO_ALIGN_MEASURING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_until_done(void) {
+    run_block(-1);
+    for (uint32_t i = 0U; any_measuring(); ++i) {
+        CHECK(i < 10000U);
+        run_block(-1);
+    }
+}
+
+/*
+ * Impulsion simultanée sur tous les chemins ; chaque chemin connu doit
+ * l'amener au mixeur à `emit + latence du plus lent`.
+ */
+static void check_alignment(const char *what) {
+    uint16_t slowest = 0U;
+    audio_align_status_t st[AUDIO_ALIGN_PATHS];
+
+    /* Les requêtes ne sont prises qu'à l'entrée du bloc suivant. */
+    run_block(-1);
+    const uint32_t emit = (block_no * FRAMES) + 5U;
+
+    for (uint8_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        status(p, &st[p]);
+        seen[p] = NO_FRAME;
+        if (((st[p].state == AUDIO_ALIGN_MEASURED) || (st[p].state == AUDIO_ALIGN_MANUAL)) &&
+            (st[p].latency > slowest)) {
+            slowest = st[p].latency;
+        }
+    }
+    run_block(5);
+    run_idle((AUDIO_ALIGN_RING_FRAMES / FRAMES) + 8U);
+
+    printf("  %-34s", what);
+    for (uint8_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        if ((st[p].state == AUDIO_ALIGN_MEASURED) || (st[p].state == AUDIO_ALIGN_MANUAL)) {
+            CHECK_EQ(st[p].delay, slowest - st[p].latency);
+            CHECK_EQ(seen[p], emit + slowest);
+            printf(" %u:+%u", p, seen[p] - emit);
+        } else {
+            CHECK_EQ(st[p].delay, 0U);
+        }
+    }
+    printf(" : ok\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* Scénario                                                                   */
+/* -------------------------------------------------------------------------- */
+
+static void measurement(void) {
+    audio_align_status_t st;
+
+    audio_align_init();
+    audio_align_set_loop_cb(loop_cb);
+    for (uint32_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        seen[p] = NO_FRAME;
+    }
+    run_idle(4U);
+
+    /* Tous les chemins mesurés en même temps, sorties et entrées différentes. */
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        CHECK(audio_align_measure(c, 2U, 2U));
+    }
+    CHECK(audio_align_measure(AUDIO_ALIGN_ADC, 0U, 0U));
+    CHECK(!audio_align_measure(0U, AUDIO_ALIGN_CART_CHANNELS, 0U));
+    CHECK(!audio_align_measure(AUDIO_ALIGN_ADC, 0U, AUDIO_ALIGN_ADC_CHANNELS));
+    run_block(-1);
+    for (uint8_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        CHECK(looped[p]);
+    }
+    run_until_done();
+
+    static const uint16_t expected[AUDIO_ALIGN_PATHS - 1U] = { 16U, 64U, 96U };
+    printf("mesure :\n");
+    for (uint8_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        status(p, &st);
+        CHECK(!looped[p]);
+        CHECK_EQ(loop_calls[p], 2U);
+        printf("  chemin %u : état %u, latence %u, écart %u, %u mesures\n",
+               p, st.state, st.latency, st.spread, st.runs);
+        if (p == JITTER_CART) {
+            CHECK_EQ(st.state, AUDIO_ALIGN_FAILED);
+            CHECK(st.spread > AUDIO_ALIGN_TOLERANCE);
+        } else {
+            CHECK_EQ(st.state, AUDIO_ALIGN_MEASURED);
+            CHECK_EQ(st.spread, 0U);
+            CHECK_EQ(st.latency, (p == AUDIO_ALIGN_ADC) ? ADC_LOOP_FRAMES : expected[p]);
+        }
+    }
+
+    /* Cartouche muette : délai dépassé. */
+    cart3_mode = CART3_DEAD;
+    CHECK(audio_align_measure(JITTER_CART, 0U, 0U));
+    run_until_done();
+    status(JITTER_CART, &st);
+    CHECK_EQ(st.state, AUDIO_ALIGN_FAILED);
+    CHECK_EQ(st.runs, 0U);
+    CHECK(!looped[JITTER_CART]);
+    printf("  chemin %u muet : échec après le délai : ok\n", JITTER_CART);
+}
+
+static void alignment(void) {
+    printf("alignement (retard au mixeur) :\n");
+    check_alignment("mesurés");
+
+    audio_align_forget(2U);
+    check_alignment("cartouche 2 oubliée");
+
+    cart3_mode = CART3_FIXED;
+    CHECK(audio_align_set_latency(JITTER_CART, 80U));
+    check_alignment("cartouche 3 imposée à 80");
+
+    /* Latence imposée au-delà de l'anneau : retard borné à AUDIO_ALIGN_MAX_DELAY. */
+    audio_align_status_t st;
+    CHECK(audio_align_set_latency(JITTER_CART, 1000U));
+    run_block(-1);
+    status(0U, &st);
+    CHECK_EQ(st.delay, AUDIO_ALIGN_MAX_DELAY);
+    printf("  latence de 1000 : retard borné à %u : ok\n", st.delay);
+}
+
+static void bench(void) {
+    static spi_block_t spi_in;
+    static spi_block_t spi_out;
+    static int32_t adc_in[FRAMES][AUDIO_ALIGN_ADC_CHANNELS];
+    static int32_t adc_out[FRAMES][AUDIO_ALIGN_ADC_CHANNELS];
+    static int32_t dac_out[FRAMES][DAC_CHANNELS];
+    int32_t sink = 0;
+
+    /* Tous les chemins retardés. */
+    audio_align_init();
+    for (uint8_t p = 0U; p < AUDIO_ALIGN_PATHS; ++p) {
+        CHECK(audio_align_set_latency(p, (uint16_t)(13U * p)));
+    }
+    for (uint32_t i = 0U; i < (FRAMES * AUDIO_ALIGN_ADC_CHANNELS); ++i) {
+        (&adc_in[0][0])[i] = (int32_t)i;
+    }
+
+    const double t0 = host_now();
+    for (uint32_t b = 0U; b < BENCH_BLOCKS; ++b) {
+        spi_in[b & 3U][0][0] = (int32_t)b;
+        audio_align_input(&adc_in[0][0], &adc_out[0][0], spi_in, FRAMES, true);
+        audio_align_output(&dac_out[0][0], DAC_CHANNELS, spi_out, FRAMES);
+        sink += spi_in[b & 3U][0][0] + adc_out[0][0];
+    }
+    const double dt = host_now() - t0;
+    printf("coût : %.3f µs par bloc de %u frames (entrée + sortie, 5 chemins retardés) [%d]\n",
+           (dt * 1e6) / (double)BENCH_BLOCKS, FRAMES, sink & 1);
+}
+
+int main(void) {
+    measurement();
+    alignment();
+    bench();
+    return 0;
+}
@@ -0,0 +1,267 @@
+/**
+ * @file bounce_render.c
+ * @brief Rendu hors ligne (bounce_run) sur hôte : WAV écrit dans un fichier, multiple du temps réel.
+ * @details bounce.c, drv_audio.c, mod_matrix.c et seq_engine.c tournent tels
+ * quels sur les noyau et HAL réduits (chibios/). drv_storage est remplacé
+ * par un fichier : le bloc SD `STORAGE_BOUNCE_BASE_LBA + n` est l'octet
+ * n × STORAGE_BLOCK_SIZE du fichier, qui est donc le WAV du rendu, ramené à
+ * sa taille exacte à la fin. Le hook de contrôle est celui de main.c réduit
+ * au séquenceur et à la modulation ; le DSP est un petit synthétiseur (une
+ * voix par piste, carré amorti) joué par un pattern de quatre pistes, dont
+ * chaque frame rendue est aussi relevée en mémoire.
+ *
+ * Vérifié, pour un rendu court (dans le premier chunk) puis pour
+ * BOUNCE_BARS mesures (plusieurs centaines de chunks) : en-tête WAV, puis
+ * chaque échantillon du fichier égal à la frame rendue, de part et d'autre
+ * de chaque frontière de chunk. Un second rendu de même longueur sans
+ * écriture (mesure seule) doit produire exactement les mêmes frames.
+ *
+ * Multiples du temps réel affichés : DSP seul et bounce complet (mise en
+ * forme 24 bits et écritures comprises), ceux de la machine hôte.
+ *
+ * Usage : bounce_render [fichier.wav]
+ */
+
+#include "host_check.h"
+#include "bounce.h"
+#include "drv_storage.h"
+#include "mod_matrix.h"
+#include "seq_engine.h"
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BOUNCE_BARS           4U
+#define FRAMES_PER_BAR        ((AUDIO_SAMPLE_RATE_HZ * 60U * 4U * 10U) / SEQ_DEFAULT_TEMPO_X10)
+#define RENDER_FRAMES         (BOUNCE_BARS * FRAMES_PER_BAR)
+#define SHORT_FRAMES          200U
+#define SYNTH_TRACKS          BOUNCE_CHANNELS
+#define SYNTH_DECAY           0.9997f
+#define SYNTH_LEVEL           (4194304.0f / 127.0f)     /* -6 dBFS à vélocité 127. */
+
+static const char *wav_path = "build/bounce.wav";
+static FILE *wav;
+static uint32_t wav_writes;
+
+/* Frames rendues, dans l'ordre : référence du contenu du fichier. */
+static int32_t rendered[RENDER_FRAMES][BOUNCE_CHANNELS];
+static uint32_t rendered_frames;
+static uint32_t events;
+
+typedef struct {
+    uint32_t phase;
+    uint32_t inc;
+    float    level;
+} voice_t;
+
+static voice_t voices[SYNTH_TRACKS];
+static seq_track_t tracks[BRICK_NUM_TRACKS];
+static seq_pattern_t pattern;
+
+/* -------------------------------------------------------------------------- */
+/* Stockage : un fichier à la place de la zone SD de rendu                    */
+/* -------------------------------------------------------------------------- */
+
+void drv_storage_init(void) {
+}
+
+bool drv_storage_write(uint32_t lba, const uint8_t *buf, uint32_t blocks) {
+    CHECK(wav != NULL);
+    CHECK((lba >= STORAGE_BOUNCE_BASE_LBA) && ((lba + blocks) <= STORAGE_BOUNCE_END_LBA));
+    wav_writes++;
+    return (fseek(wav, (long)(lba - STORAGE_BOUNCE_BASE_LBA) * STORAGE_BLOCK_SIZE, SEEK_SET) == 0) &&
+           (fwrite(buf, STORAGE_BLOCK_SIZE, blocks, wav) == blocks);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Application : séquenceur, modulation, synthétiseur                         */
+/* -------------------------------------------------------------------------- */
+
+static void app_seq_event(const seq_event_t *ev) {
+    voice_t *v = &voices[ev->track % SYNTH_TRACKS];
+    const double hz = 440.0 * pow(2.0, ((double)ev->note - 69.0) / 12.0);
+
+    v->inc = (uint32_t)((hz * 4294967296.0) / (double)AUDIO_SAMPLE_RATE_HZ);
+    v->level = SYNTH_LEVEL * (float)ev->velocity;
+    events++;
+}
+
+static void app_control_block(size_t frames) {
+    seq_engine_process_block(frames);
+    mod_matrix_process_block(frames);
+}
+
+static void app_dsp_reset(void) {
+    memset(voices, 0, sizeof(voices));
+    rendered_frames = 0U;
+    events = 0U;
+}
+
+void drv_audio_process_block(const int32_t              *adc_in,
+                             const spilink_audio_block_t spi_in,
+                             int32_t                    *dac_out,
+                             spilink_audio_block_t       spi_out,
+                             size_t                      frames) {
+    const size_t pcm_base = AUDIO_PCM4104_SUBFRAME * AUDIO_PCM4104_CHANNELS;
+
+    (void)adc_in;
+    (void)spi_in;
+    for (size_t n = 0U; n < frames; ++n) {
+        int32_t *out = &dac_out[n * AUDIO_NUM_OUTPUT_CHANNELS];
+        memset(out, 0, AUDIO_NUM_OUTPUT_CHANNELS * sizeof(int32_t));
+        for (uint8_t t = 0U; t < SYNTH_TRACKS; ++t) {
+            voice_t *v = &voices[t];
+            const float s = ((v->phase & 0x80000000U) != 0U) ? -v->level : v->level;
+            out[pcm_base + t] = (int32_t)s;
+            v->phase += v->inc;
+            v->level *= SYNTH_DECAY;
+        }
+        if (rendered_frames < RENDER_FRAMES) {
+            memcpy(rendered[rendered_frames], &out[pcm_base], sizeof(rendered[0]));
+            rendered_frames++;
+        }
+    }
+    if (spi_out != NULL) {
+        memset(spi_out, 0, sizeof(spilink_audio_block_t));
+    }
+}
+
+/* Grosse caisse, caisse claire, charleston à 50 %, basse en 1:2 et 2:2. */
+static void pattern_build(void) {
+    static const uint8_t bass_steps[5] = { 0U, 3U, 6U, 10U, 14U };
+
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        seq_track_clear(&tracks[t]);
+        tracks[t].length = SEQ_STEPS_PER_BAR;
+    }
+    seq_pattern_bind(&pattern, tracks, 0U);
+    pattern.length = SEQ_STEPS_PER_BAR;
+
+    for (uint8_t s = 0U; s < SEQ_STEPS_PER_BAR; ++s) {
+        seq_trig_t *kick = &tracks[0].steps[s].trigs[0];
+        seq_trig_t *snare = &tracks[1].steps[s].trigs[0];
+        seq_trig_t *hat = &tracks[2].steps[s].trigs[0];
+        if ((s % 4U) == 0U) {
+            *kick = (seq_trig_t){ 36U, 127U, 1U, SEQ_TRIG_ACTIVE, SEQ_COND_NONE, 0U };
+        }
+        if ((s % 8U) == 4U) {
+            *snare = (seq_trig_t){ 50U, 110U, 1U, SEQ_TRIG_ACTIVE, SEQ_COND_NONE, 0U };
+        }
+        *hat = (seq_trig_t){ 78U, 60U, 0U, SEQ_TRIG_ACTIVE, SEQ_COND_PROB, 50U };
+    }
+    for (uint8_t i = 0U; i < sizeof(bass_steps); ++i) {
+        tracks[3].steps[bass_steps[i]].trigs[0] =
+            (seq_trig_t){ (uint8_t)(33U + (i * 5U)), 100U, 2U, SEQ_TRIG_ACTIVE, SEQ_COND_AB,
+                          SEQ_COND_AB_ARG((i & 1U) + 1U, 2U) };
+    }
+}
+
+static void setup(void) {
+    drv_audio_init();
+    drv_audio_register_control_cb(app_control_block);
+    drv_audio_register_reset_cb(app_dsp_reset);
+    mod_matrix_init();
+    seq_engine_init();
+    seq_engine_set_event_cb(app_seq_event);
+    pattern_build();
+    seq_engine_set_pattern(&pattern);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Vérification du fichier                                                    */
+/* -------------------------------------------------------------------------- */
+
+static uint32_t get_le(const uint8_t *p, uint32_t bytes) {
+    uint32_t v = 0U;
+    for (uint32_t i = 0U; i < bytes; ++i) {
+        v |= (uint32_t)p[i] << (8U * i);
+    }
+    return v;
+}
+
+static void check_wav(uint32_t frames) {
+    static uint8_t data[RENDER_FRAMES * BOUNCE_CHANNELS * BOUNCE_BYTES_PER_SAMPLE];
+    uint8_t h[BOUNCE_WAV_HEADER_SIZE];
+    const uint32_t data_bytes = frames * BOUNCE_CHANNELS * BOUNCE_BYTES_PER_SAMPLE;
+
+    CHECK(fseek(wav, 0L, SEEK_SET) == 0);
+    CHECK(fread(h, 1U, sizeof(h), wav) == sizeof(h));
+    CHECK(memcmp(&h[0], "RIFF", 4U) == 0);
+    CHECK_EQ(get_le(&h[4], 4U), (BOUNCE_WAV_HEADER_SIZE - 8U) + data_bytes);
+    CHECK(memcmp(&h[8], "WAVEfmt ", 8U) == 0);
+    CHECK_EQ(get_le(&h[20], 2U), 0xFFFEU);
+    CHECK_EQ(get_le(&h[22], 2U), BOUNCE_CHANNELS);
+    CHECK_EQ(get_le(&h[24], 4U), AUDIO_SAMPLE_RATE_HZ);
+    CHECK_EQ(get_le(&h[34], 2U), 24U);
+    CHECK(memcmp(&h[60], "data", 4U) == 0);
+    CHECK_EQ(get_le(&h[64], 4U), data_bytes);
+
+    CHECK(fread(data, 1U, data_bytes, wav) == data_bytes);
+    CHECK(fgetc(wav) == EOF);
+    for (uint32_t f = 0U; f < frames; ++f) {
+        for (uint32_t c = 0U; c < BOUNCE_CHANNELS; ++c) {
+            const uint8_t *p = &data[((f * BOUNCE_CHANNELS) + c) * BOUNCE_BYTES_PER_SAMPLE];
+            const int32_t v = (int32_t)(get_le(p, 3U) << 8) >> 8;
+            CHECK_EQ(v, rendered[f][c]);
+        }
+    }
+}
+
+static void render(uint32_t frames, bounce_result_t *res) {
+    wav = fopen(wav_path, "w+b");
+    CHECK(wav != NULL);
+    wav_writes = 0U;
+
+    CHECK(bounce_run(frames, true, res));
+    CHECK(!res->write_error);
+    CHECK_EQ(res->frames, frames);
+    CHECK_EQ(rendered_frames, frames);
+    CHECK_EQ(res->data_bytes, frames * BOUNCE_CHANNELS * BOUNCE_BYTES_PER_SAMPLE);
+    CHECK(!seq_engine_is_playing());
+
+    /* La zone SD est écrite par blocs entiers : le fichier est ramené au WAV. */
+    CHECK(fflush(wav) == 0);
+    CHECK(ftruncate(fileno(wav), (off_t)BOUNCE_WAV_HEADER_SIZE + res->data_bytes) == 0);
+    check_wav(frames);
+}
+
+int main(int argc, char **argv) {
+    bounce_result_t res;
+
+    if (argc > 1) {
+        wav_path = argv[1];
+    }
+    setup();
+
+    render(SHORT_FRAMES - (SHORT_FRAMES % AUDIO_FRAMES_PER_BUFFER), &res);
+    CHECK(fclose(wav) == 0);
+    printf("rendu court : %u frames dans le premier chunk, %u écritures : ok\n",
+           res.frames, wav_writes);
+
+    render(RENDER_FRAMES, &res);
+    CHECK(fclose(wav) == 0);
+    const uint32_t chunk_bytes = BOUNCE_CHUNK_BLOCKS * STORAGE_BLOCK_SIZE;
+    CHECK(res.data_bytes > (2U * chunk_bytes));
+    CHECK(events > 0U);
+    printf("rendu : %u mesures, %u frames, %u notes, %u octets sur %u chunks (%u écritures) "
+           "identiques aux frames rendues : ok\n",
+           BOUNCE_BARS, res.frames, events, res.data_bytes,
+           (res.data_bytes + BOUNCE_WAV_HEADER_SIZE + chunk_bytes - 1U) / chunk_bytes, wav_writes);
+    printf("  %s : ×%u.%02u temps réel (DSP), ×%u.%02u (bounce complet)\n", wav_path,
+           res.dsp_speed_x100 / 100U, res.dsp_speed_x100 % 100U,
+           res.total_speed_x100 / 100U, res.total_speed_x100 % 100U);
+
+    /* Même rendu sans écriture : mêmes frames, mêmes notes. */
+    static int32_t first[RENDER_FRAMES][BOUNCE_CHANNELS];
+    const uint32_t first_events = events;
+    memcpy(first, rendered, sizeof(first));
+    wav = NULL;
+    CHECK(bounce_run(RENDER_FRAMES, false, &res));
+    CHECK_EQ(rendered_frames, RENDER_FRAMES);
+    CHECK_EQ(events, first_events);
+    CHECK(memcmp(first, rendered, sizeof(first)) == 0);
+    printf("mesure seule : rendu identique, ×%u.%02u temps réel : ok\n",
+           res.dsp_speed_x100 / 100U, res.dsp_speed_x100 % 100U);
+    return 0;
+}
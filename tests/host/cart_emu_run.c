@@ -0,0 +1,368 @@
+/**
+ * @file cart_emu_run.c
+ * @brief drv_audio et cart_* sur cartouches émulées : détection, mesure de latence, contrôle, masse.
+ * @details Le chemin cartouche du firmware tourne tel quel sur hôte :
+ * drv_audio (bloc complet, SPI-LINK compris) avec cart_emu_pull /
+ * cart_emu_push à la place de drv_spilink, et cart_manager, cart_params et
+ * cart_bulk sur cart_emu_link_ops, câblés comme dans main.c. Le DSP est
+ * celui par défaut de drv_audio ; le hook de contrôle relève la crête de
+ * l'entrée cartouche alignée. Pas de threads : après chaque bloc, le
+ * programme fait ce que fait la boucle du gestionnaire (réveil par le
+ * transport ou CART_MANAGER_POLL_MS écoulées), le temps système avançant
+ * d'un tick par frame (voir chibios/ch.h).
+ *
+ * Vérifié, dans l'ordre :
+ *  - insertion de trois cartouches (0, 2 et 4 blocs de latence) : slots
+ *    prêts, descripteurs lus, latences mesurées par bouclage (16, 48,
+ *    80 frames), audio présent après la mesure ;
+ *  - paramètres, notes et écho d'un message arrivés côté cartouche ;
+ *  - transfert de masse complet, CRC vérifié par la cartouche ;
+ *  - retrait pendant un transfert : slot vide après le silence, chemin
+ *    oublié, transfert suspendu ; réinsertion : énumération, mesure et
+ *    reprise du transfert à l'offset acquitté.
+ * Puis coût d'un bloc avec quatre cartouches, l'une à 50 ppm d'erreurs
+ * binaires.
+ *
+ * Les deux modules qui gardent leur boucle en statique (drv_audio,
+ * cart_manager) sont inclus tels quels.
+ *
+ * Usage : cart_emu_run [graine]
+ */
+
+#include "host_check.h"
+#include "drv_audio.c"
+#include "cart_manager.c"
+#include "cart_params.h"
+#include "cart_bulk.h"
+#include "cart_emu.h"
+
+#define FRAMES                AUDIO_FRAMES_PER_BUFFER
+#define SETTLE_BLOCKS         4000U
+#define BULK_BYTES            12000U
+#define BENCH_BLOCKS          200000U
+
+systime_t host_systime = 0U;
+
+static int32_t adc_in[FRAMES][AUDIO_NUM_INPUT_CHANNELS];
+static int32_t dac_out[FRAMES][AUDIO_NUM_OUTPUT_CHANNELS];
+static systime_t manager_last;
+static uint32_t blocks_run;
+
+/* Crête de l'entrée cartouche alignée (canal 0), remise à zéro par le lecteur. */
+static int32_t cart_peak[BRICK_MAX_CARTRIDGES];
+
+static uint8_t bulk_blob[2][BULK_BYTES];
+
+/* -------------------------------------------------------------------------- */
+/* Câblage (main.c)                                                           */
+/* -------------------------------------------------------------------------- */
+
+static void app_cart_event(uint8_t slot, cart_slot_state_t state) {
+    cart_params_slot_event(slot, state);
+    cart_bulk_slot_event(slot, state);
+    if (state == CART_SLOT_READY) {
+        (void)audio_align_measure(slot, 0U, 0U);
+    } else {
+        audio_align_forget(slot);
+    }
+}
+
+static void app_align_loop(uint8_t path, bool loop) {
+    if (path < BRICK_MAX_CARTRIDGES) {
+        const uint8_t msg[2] = { CART_MSG_LOOPBACK, loop ? 1U : 0U };
+        (void)cart_manager_send(path, msg, sizeof(msg));
+    }
+}
+
+static void app_cart_msg(uint8_t slot, const uint8_t *msg, size_t len) {
+    cart_bulk_on_msg(slot, msg, len);
+}
+
+static void app_control_tap(size_t frames) {
+    int32_t (*spi_in)[FRAMES][4] = drv_audio_get_spi_in_buffers();
+
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        for (size_t f = 0U; f < frames; ++f) {
+            const int32_t s = spi_in[c][f][0];
+            const int32_t a = (s < 0) ? -s : s;
+            if (a > cart_peak[c]) {
+                cart_peak[c] = a;
+            }
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Boucle                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Un bloc audio, puis un passage du gestionnaire s'il est réveillé ou si son délai est écoulé. */
+static void run_block(void) {
+    audio_run_block(&adc_in[0][0], &dac_out[0][0], FRAMES, true);
+    host_systime += FRAMES;
+    blocks_run++;
+
+    if ((chBSemWaitTimeout(&cart_wake_sem, 0U) == MSG_OK) ||
+        (chVTTimeElapsedSinceX(manager_last) >= TIME_MS2I(CART_MANAGER_POLL_MS))) {
+        manager_last = host_systime;
+        for (uint8_t s = 0U; s < BRICK_MAX_CARTRIDGES; ++s) {
+            cart_slot_service(s);
+        }
+    }
+}
+
+static void run_blocks(uint32_t n) {
+    for (uint32_t i = 0U; i < n; ++i) {
+        run_block();
+    }
+}
+
+/* Mesure de latence demandée à l'insertion et terminée, pour chaque slot de `mask`. */
+static bool measured(uint8_t mask) {
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        audio_align_status_t st;
+        audio_align_get_status(c, &st);
+        if (((mask & (1U << c)) != 0U) &&
+            ((st.state == AUDIO_ALIGN_UNKNOWN) || (st.state == AUDIO_ALIGN_MEASURING))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Blocs jusqu'à ce que `mask` soit exactement l'ensemble des slots prêts, tous mesurés. */
+static uint32_t run_until_ready(uint8_t mask) {
+    const uint32_t start = blocks_run;
+
+    while ((cart_manager_ready_mask() != mask) || !measured(mask)) {
+        CHECK((blocks_run - start) < SETTLE_BLOCKS);
+        run_block();
+    }
+    return blocks_run - start;
+}
+
+static void insert(uint8_t cart, cart_emu_signal_t signal, uint8_t latency, uint16_t params) {
+    cart_emu_config_t cfg;
+
+    cart_emu_default_config(&cfg);
+    cfg.signal = signal;
+    cfg.latency_blocks = latency;
+    cfg.param_count = params;
+    CHECK(cart_emu_configure(cart, &cfg));
+}
+
+static void remove_cart(uint8_t cart) {
+    cart_emu_config_t cfg;
+
+    cart_emu_default_config(&cfg);
+    cfg.present = false;
+    CHECK(cart_emu_configure(cart, &cfg));
+}
+
+static void check_measured(uint8_t cart, uint16_t latency) {
+    audio_align_status_t st;
+
+    audio_align_get_status(cart, &st);
+    CHECK_EQ(st.state, AUDIO_ALIGN_MEASURED);
+    CHECK_EQ(st.latency, latency);
+    CHECK_EQ(st.spread, 0U);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Scénario                                                                   */
+/* -------------------------------------------------------------------------- */
+
+static void setup(uint32_t seed) {
+    cart_emu_init(seed);
+    drv_audio_init();
+    CHECK(audio_initialized);
+    drv_audio_register_spilink_pull(cart_emu_pull);
+    drv_audio_register_spilink_push(cart_emu_push);
+    drv_audio_register_control_cb(app_control_tap);
+    audio_align_set_loop_cb(app_align_loop);
+
+    cart_manager_init(&cart_emu_link_ops);
+    cart_params_init(&cart_emu_link_ops);
+    cart_bulk_init(&cart_emu_link_ops);
+    cart_manager_set_event_cb(app_cart_event);
+    cart_manager_set_msg_cb(app_cart_msg);
+    cart_manager_start();
+}
+
+static void insertion(void) {
+    static const uint16_t params[3] = { 16U, 32U, 0U };
+
+    run_blocks(64U);
+    CHECK_EQ(cart_manager_ready_mask(), 0U);
+
+    insert(0U, CART_EMU_SINE, 0U, params[0]);
+    insert(1U, CART_EMU_SQUARE, 2U, params[1]);
+    insert(2U, CART_EMU_NOISE, 4U, params[2]);
+    const uint32_t n = run_until_ready(0x07U);
+
+    for (uint8_t c = 0U; c < 3U; ++c) {
+        const cart_caps_t *caps = cart_manager_get_caps(c);
+        cart_manager_stats_t ms;
+        CHECK(caps != NULL);
+        CHECK(strcmp(caps->name, "EMULATOR") == 0);
+        CHECK_EQ(caps->param_count, params[c]);
+        CHECK_EQ(caps->voices, BRICK_MAX_VOICES_PER_CART);
+        cart_manager_get_stats(c, &ms);
+        CHECK_EQ(ms.inserts, 1U);
+        CHECK_EQ(ms.enum_failures, 0U);
+    }
+    CHECK_EQ(cart_manager_get_state(3U), CART_SLOT_EMPTY);
+    check_measured(0U, 16U);
+    check_measured(1U, 48U);
+    check_measured(2U, 80U);
+
+    memset(cart_peak, 0, sizeof(cart_peak));
+    run_blocks(32U);
+    for (uint8_t c = 0U; c < 3U; ++c) {
+        CHECK(cart_peak[c] > (int32_t)AUDIO_ALIGN_THRESHOLD);
+    }
+    CHECK_EQ(cart_peak[3], 0);
+    printf("insertion : 3 slots prêts et mesurés (16, 48, 80 frames) en %u blocs (%u ms) : ok\n",
+           n, (unsigned)TIME_I2MS(n * FRAMES));
+}
+
+static void control(void) {
+    static const uint8_t ping[4] = { 0x30U, 1U, 2U, 3U };
+    cart_emu_stats_t es;
+    cart_manager_stats_t ms;
+
+    CHECK(cart_params_set(0U, 5U, 1234, CART_PRIO_UI));
+    CHECK(cart_params_set_norm(1U, 31U, 65535U, CART_PRIO_MOD));
+    CHECK(cart_params_note(0U, 1U, 60U, 100U));
+    CHECK(cart_params_note(0U, 1U, 60U, 0U));
+    CHECK(!cart_params_set(3U, 0U, 1, CART_PRIO_UI));
+    CHECK(cart_manager_send(2U, ping, sizeof(ping)));
+    run_blocks(16U);
+
+    CHECK_EQ(cart_emu_get_param(0U, 5U), 1234);
+    CHECK_EQ(cart_emu_get_param(1U, 31U), 8191);
+    cart_emu_get_stats(0U, &es);
+    CHECK_EQ(es.notes_rx, 2U);
+    cart_emu_get_stats(2U, &es);
+    CHECK_EQ(es.echoed, 1U);
+    cart_manager_get_stats(2U, &ms);
+    CHECK_EQ(ms.msgs_rx, 1U);
+    printf("contrôle : paramètre, modulation, notes et écho reçus : ok\n");
+}
+
+static uint32_t run_until_bulk(uint8_t slot, cart_bulk_state_t state) {
+    const uint32_t start = blocks_run;
+    cart_bulk_status_t bs;
+
+    for (cart_bulk_get_status(slot, &bs); bs.state != state; cart_bulk_get_status(slot, &bs)) {
+        CHECK(bs.state != CART_BULK_FAILED);
+        CHECK((blocks_run - start) < (20U * SETTLE_BLOCKS));
+        run_block();
+    }
+    return blocks_run - start;
+}
+
+static void bulk(uint32_t seed) {
+    cart_bulk_status_t bs;
+    cart_emu_stats_t es;
+    uint32_t r = seed;
+
+    for (uint32_t i = 0U; i < sizeof(bulk_blob); ++i) {
+        (&bulk_blob[0][0])[i] = (uint8_t)host_rand(&r);
+    }
+
+    CHECK(cart_bulk_start(1U, CART_BULK_WAVETABLE, bulk_blob[0], BULK_BYTES, 1U));
+    const uint32_t n = run_until_bulk(1U, CART_BULK_DONE);
+    cart_bulk_get_status(1U, &bs);
+    cart_emu_get_stats(1U, &es);
+    CHECK_EQ(es.bulk_done, 1U);
+    CHECK_EQ(es.bulk_rx, BULK_BYTES);
+    CHECK_EQ(bs.acked, BULK_BYTES);
+    printf("masse : %u octets en %u blocs, %u o/s, CRC vérifié par la cartouche : ok\n",
+           BULK_BYTES, n, bs.bytes_per_s);
+}
+
+static void removal(void) {
+    cart_bulk_status_t bs;
+    cart_manager_stats_t ms;
+    audio_align_status_t as;
+    cart_emu_stats_t es;
+
+    /* Retrait de la cartouche 2 au milieu d'un transfert. */
+    CHECK(cart_bulk_start(2U, CART_BULK_SAMPLE, bulk_blob[1], BULK_BYTES, 1U));
+    do {
+        run_block();
+        cart_bulk_get_status(2U, &bs);
+    } while (bs.acked < (BULK_BYTES / 2U));
+    remove_cart(2U);
+
+    const uint32_t start = blocks_run;
+    while (cart_manager_get_state(2U) != CART_SLOT_EMPTY) {
+        CHECK((blocks_run - start) < SETTLE_BLOCKS);
+        run_block();
+    }
+    const uint32_t lost = blocks_run - start;
+    CHECK(lost >= SPILINK_LINK_DOWN_BLOCKS);
+    cart_manager_get_stats(2U, &ms);
+    CHECK_EQ(ms.removals, 1U);
+    cart_bulk_get_status(2U, &bs);
+    CHECK_EQ(bs.state, CART_BULK_SUSPENDED);
+    CHECK_EQ(cart_manager_ready_mask(), 0x03U);
+    run_blocks(64U);
+    audio_align_get_status(2U, &as);
+    CHECK_EQ(as.state, AUDIO_ALIGN_UNKNOWN);
+    memset(cart_peak, 0, sizeof(cart_peak));
+    run_blocks(8U);
+    CHECK_EQ(cart_peak[2], 0);
+    printf("retrait : slot vide après %u blocs, chemin oublié, transfert suspendu à %u octets : ok\n",
+           lost, bs.acked);
+
+    /* Réinsertion : énumération, mesure, reprise. */
+    insert(2U, CART_EMU_NOISE, 4U, 0U);
+    const uint32_t n = run_until_ready(0x07U);
+    check_measured(2U, 80U);
+    cart_manager_get_stats(2U, &ms);
+    CHECK_EQ(ms.inserts, 2U);
+    (void)run_until_bulk(2U, CART_BULK_DONE);
+    cart_bulk_get_status(2U, &bs);
+    cart_emu_get_stats(2U, &es);
+    CHECK_EQ(bs.resumes, 1U);
+    CHECK_EQ(es.bulk_done, 1U);
+    CHECK(es.bulk_rx < BULK_BYTES);
+    printf("réinsertion : prête et mesurée en %u blocs, transfert repris et terminé : ok\n", n);
+}
+
+static void bench(void) {
+    cart_emu_config_t cfg;
+    cart_emu_stats_t es;
+
+    cart_emu_default_config(&cfg);
+    cfg.signal = CART_EMU_IMPULSE;
+    cfg.latency_blocks = 1U;
+    cfg.ber_ppm = 50U;
+    CHECK(cart_emu_configure(3U, &cfg));
+    (void)run_until_ready(0x0FU);
+
+    const double t0 = host_now();
+    run_blocks(BENCH_BLOCKS);
+    const double dt = host_now() - t0;
+
+    cart_emu_get_stats(3U, &es);
+    CHECK(es.crc_errors > 0U);
+    CHECK(es.linked);
+    printf("coût : %.2f µs par bloc de %u frames (4 cartouches, drv_audio + cart_*), "
+           "%u trames rejetées à 50 ppm\n",
+           (dt * 1e6) / (double)BENCH_BLOCKS, FRAMES, es.crc_errors + es.cart_crc_errors);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 0x43415254U;
+
+    setup(seed);
+    insertion();
+    control();
+    bulk(seed);
+    removal();
+    bench();
+    return 0;
+}
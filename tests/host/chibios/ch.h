@@ -0,0 +1,204 @@
+/**
+ * @file ch.h
+ * @brief ChibiOS/RT réduit à ce qu'utilisent les modules firmware compilés sur hôte.
+ * @details Un seul fil d'exécution : verrous sans effet, threads jamais
+ * lancés (le programme appelle lui-même ce que fait leur boucle), sémaphores
+ * binaires réduits à un drapeau que le programme consulte. Le temps système
+ * est avancé par le programme (host_systime, CH_CFG_ST_FREQUENCY ticks par
+ * seconde), ce qui rend délais et reprises déterministes. Le compteur de
+ * cycles suit en revanche l'horloge monotone de l'hôte, à la fréquence du
+ * cœur (HOST_REALTIME_FREQUENCY) : les mesures chTM et les multiples du
+ * temps réel sont ceux de la machine hôte.
+ */
+
+#ifndef HOST_CH_H
+#define HOST_CH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TRUE                          1
+#define FALSE                         0
+
+/** Un tick par frame audio : un bloc avance le temps de AUDIO_FRAMES_PER_BUFFER. */
+#define CH_CFG_ST_FREQUENCY           48000U
+
+/** Fréquence du compteur de cycles, celle du cœur (STM32_CORE_CK dans hal.h). */
+#define HOST_REALTIME_FREQUENCY       480000000U
+
+#define NORMALPRIO                    128
+#define HIGHPRIO                      255
+
+#define MSG_OK                        ((msg_t)0)
+#define MSG_TIMEOUT                   ((msg_t)-1)
+
+typedef int32_t  msg_t;
+typedef int32_t  tprio_t;
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t rtcnt_t;
+
+#define TIME_MS2I(ms)   ((sysinterval_t)(((uint64_t)(ms) * CH_CFG_ST_FREQUENCY) / 1000U))
+#define TIME_I2MS(i)    ((uint32_t)(((uint64_t)(i) * 1000U) / CH_CFG_ST_FREQUENCY))
+
+/* Défini par le programme hôte. */
+extern systime_t host_systime;
+
+static inline systime_t chVTGetSystemTimeX(void) {
+    return host_systime;
+}
+
+static inline sysinterval_t chVTTimeElapsedSinceX(systime_t start) {
+    return (sysinterval_t)(host_systime - start);
+}
+
+static inline rtcnt_t chSysGetRealtimeCounterX(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    const uint64_t ns = ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+    return (rtcnt_t)((ns * (HOST_REALTIME_FREQUENCY / 1000000U)) / 1000U);
+}
+
+static inline void chSysLock(void) {
+}
+
+static inline void chSysUnlock(void) {
+}
+
+static inline void chSysLockFromISR(void) {
+}
+
+static inline void chSysUnlockFromISR(void) {
+}
+
+static inline void chSysHalt(const char *reason) {
+    (void)reason;
+    abort();
+}
+
+/* -------------------------------------------------------------------------- */
+/* Synchronisation                                                            */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    bool signaled;
+} binary_semaphore_t;
+
+static inline void chBSemObjectInit(binary_semaphore_t *bsp, bool taken) {
+    bsp->signaled = !taken;
+}
+
+static inline void chBSemSignalI(binary_semaphore_t *bsp) {
+    bsp->signaled = true;
+}
+
+static inline void chBSemSignal(binary_semaphore_t *bsp) {
+    bsp->signaled = true;
+}
+
+static inline msg_t chBSemWaitTimeout(binary_semaphore_t *bsp, sysinterval_t timeout) {
+    const bool was = bsp->signaled;
+    (void)timeout;
+    bsp->signaled = false;
+    return was ? MSG_OK : MSG_TIMEOUT;
+}
+
+static inline msg_t chBSemWait(binary_semaphore_t *bsp) {
+    bsp->signaled = false;
+    return MSG_OK;
+}
+
+typedef struct {
+    uint8_t unused;
+} mutex_t;
+
+static inline void chMtxObjectInit(mutex_t *mp) {
+    (void)mp;
+}
+
+static inline void chMtxLock(mutex_t *mp) {
+    (void)mp;
+}
+
+static inline void chMtxUnlock(mutex_t *mp) {
+    (void)mp;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Mesure de durée (chTM)                                                     */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    rtcnt_t  best;
+    rtcnt_t  worst;
+    rtcnt_t  last;
+    uint32_t n;
+    uint64_t cumulative;
+} time_measurement_t;
+
+static inline void chTMObjectInit(time_measurement_t *tmp) {
+    tmp->best = (rtcnt_t)-1;
+    tmp->worst = 0U;
+    tmp->last = 0U;
+    tmp->n = 0U;
+    tmp->cumulative = 0U;
+}
+
+static inline void chTMStartMeasurementX(time_measurement_t *tmp) {
+    tmp->last = chSysGetRealtimeCounterX();
+}
+
+static inline void chTMStopMeasurementX(time_measurement_t *tmp) {
+    tmp->last = (rtcnt_t)(chSysGetRealtimeCounterX() - tmp->last);
+    tmp->n++;
+    tmp->cumulative += tmp->last;
+    if (tmp->last > tmp->worst) {
+        tmp->worst = tmp->last;
+    }
+    if (tmp->last < tmp->best) {
+        tmp->best = tmp->last;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Threads : jamais lancés                                                    */
+/* -------------------------------------------------------------------------- */
+
+typedef struct host_thread thread_t;
+typedef void (*tfunc_t)(void *arg);
+
+#define THD_WORKING_AREA_SIZE(n)      (n)
+#define THD_WORKING_AREA(s, n)        uint8_t s[THD_WORKING_AREA_SIZE(n)]
+#define THD_FUNCTION(tname, arg)      void tname(void *arg)
+
+static inline thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf,
+                                          void *arg) {
+    (void)wsp;
+    (void)size;
+    (void)prio;
+    (void)pf;
+    (void)arg;
+    return NULL;
+}
+
+static inline void chThdTerminate(thread_t *tp) {
+    (void)tp;
+}
+
+static inline msg_t chThdWait(thread_t *tp) {
+    (void)tp;
+    return MSG_OK;
+}
+
+static inline bool chThdShouldTerminateX(void) {
+    return true;
+}
+
+static inline void chRegSetThreadName(const char *name) {
+    (void)name;
+}
+
+#endif /* HOST_CH_H */
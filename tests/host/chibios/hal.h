@@ -0,0 +1,52 @@
+/**
+ * @file hal.h
+ * @brief HAL réduite à ce que référencent drv_audio (hors configuration SAI/DMA) et drv_storage.h, pour les programmes hôte.
+ * @details Ni STM32H7xx ni DMAMUX ni D-Cache : drv_audio compile sans
+ * configurer le SAI ni allouer de DMA ; seuls restent l'arrêt des streams et
+ * les bits d'activation du SAI, sur des registres factices.
+ */
+
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include "ch.h"
+
+#define HAL_RET_SUCCESS               MSG_OK
+#define STM32_CORE_CK                 HOST_REALTIME_FREQUENCY
+#define STM32_DMA_SUPPORTS_DMAMUX     FALSE
+#define MMCSD_BLOCK_SIZE              512U
+
+#define STM32_DMA_ISR_FEIF            (1U << 0)
+#define STM32_DMA_ISR_DMEIF           (1U << 2)
+#define STM32_DMA_ISR_TEIF            (1U << 3)
+#define STM32_DMA_ISR_HTIF            (1U << 4)
+#define STM32_DMA_ISR_TCIF            (1U << 5)
+
+typedef struct {
+    uint32_t unused;
+} stm32_dma_stream_t;
+
+static inline void dmaStreamDisable(const stm32_dma_stream_t *stp) {
+    (void)stp;
+}
+
+static inline void dmaStreamFree(const stm32_dma_stream_t *stp) {
+    (void)stp;
+}
+
+#define SAI_xCR1_SAIEN                (1U << 16)
+#define SAI_xCR1_DMAEN                (1U << 17)
+
+typedef struct {
+    volatile uint32_t CR1;
+} SAI_Block_TypeDef;
+
+static inline SAI_Block_TypeDef *host_sai_block(uint32_t n) {
+    static SAI_Block_TypeDef blocks[2];
+    return &blocks[n];
+}
+
+#define SAI1_Block_A                  host_sai_block(0U)
+#define SAI1_Block_B                  host_sai_block(1U)
+
+#endif /* HOST_HAL_H */
@@ -0,0 +1,439 @@
+/**
+ * @file display_gfx_bench.c
+ * @brief Banc de display_gfx sur hôte : contrôle pixel à pixel, puis redessin de pages d'UI.
+ * @details Contrôle : 20 000 cas tirés au hasard (rectangles pleins ou
+ * vides, inversions, traits, points, bitmaps, caractères et chaînes aux
+ * échelles 1 et 2, trois modes) sur un tampon initial aléatoire et une
+ * découpe aléatoire, éventuellement hors écran ou vide. Chaque résultat est
+ * comparé à une référence qui trace pixel par pixel dans une image
+ * 128 × 64 ; tout octet modifié doit avoir été signalé au callback de
+ * marquage.
+ *
+ * Banc : pages typiques de l'UI, cache de glyphes chaud, meilleur temps
+ * sur plusieurs séries (l'hôte est partagé) :
+ *  - page séquenceur complète (effacement, en-tête, 16 cases de pas,
+ *    tête de lecture inversée, deux rangées de paramètres, BPM ×2) ;
+ *  - écran plein de texte (8 × 21 caractères) ;
+ *  - déplacement de la tête de lecture et nouveau BPM ;
+ *  - une rangée de paramètres.
+ *
+ * Le module est inclus tel quel pour que la référence lise la même police.
+ *
+ * Usage : display_gfx_bench [graine]
+ */
+
+#include "host_check.h"
+#include "display_gfx.c"
+
+#define CHECK_CASES           20000U
+#define BENCH_ITERS           20000U
+#define BENCH_SERIES          5U
+
+/* -------------------------------------------------------------------------- */
+/* Référence pixel à pixel                                                    */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    uint8_t px[GFX_HEIGHT][GFX_WIDTH];
+    int32_t x0, y0, x1, y1;   /* Découpe, bornes incluses (vide si x0 > x1). */
+} ref_t;
+
+static void ref_from_fb(ref_t *r, const display_gfx_fb_t *fb) {
+    for (uint32_t y = 0U; y < GFX_HEIGHT; ++y) {
+        for (uint32_t x = 0U; x < GFX_WIDTH; ++x) {
+            r->px[y][x] = (uint8_t)(((*fb)[y / 8U][x] >> (y & 7U)) & 1U);
+        }
+    }
+}
+
+static void ref_set_clip(ref_t *r, int32_t x, int32_t y, int32_t w, int32_t h) {
+    r->x0 = (x > 0) ? x : 0;
+    r->y0 = (y > 0) ? y : 0;
+    r->x1 = ((x + w - 1) < (int32_t)(GFX_WIDTH - 1U)) ? (x + w - 1) : (int32_t)(GFX_WIDTH - 1U);
+    r->y1 = ((y + h - 1) < (int32_t)(GFX_HEIGHT - 1U)) ? (y + h - 1) : (int32_t)(GFX_HEIGHT - 1U);
+    if ((w <= 0) || (h <= 0) || (r->x0 > r->x1) || (r->y0 > r->y1)) {
+        r->x0 = 1;
+        r->x1 = 0;
+    }
+}
+
+static void ref_plot(ref_t *r, int32_t x, int32_t y, display_gfx_mode_t mode) {
+    if ((x < r->x0) || (x > r->x1) || (y < r->y0) || (y > r->y1)) {
+        return;
+    }
+    uint8_t *p = &r->px[y][x];
+    switch (mode) {
+    case GFX_CLEAR:
+        *p = 0U;
+        break;
+    case GFX_XOR:
+        *p ^= 1U;
+        break;
+    default:
+        *p = 1U;
+        break;
+    }
+}
+
+static void ref_fill(ref_t *r, int32_t x, int32_t y, int32_t w, int32_t h, display_gfx_mode_t mode) {
+    for (int32_t j = 0; j < h; ++j) {
+        for (int32_t i = 0; i < w; ++i) {
+            ref_plot(r, x + i, y + j, mode);
+        }
+    }
+}
+
+static void ref_rect(ref_t *r, int32_t x, int32_t y, int32_t w, int32_t h, display_gfx_mode_t mode) {
+    if ((w <= 0) || (h <= 0)) {
+        return;
+    }
+    /* Chaque pixel du contour une seule fois (XOR). */
+    for (int32_t j = 0; j < h; ++j) {
+        for (int32_t i = 0; i < w; ++i) {
+            if ((j == 0) || (j == (h - 1)) || (i == 0) || (i == (w - 1))) {
+                ref_plot(r, x + i, y + j, mode);
+            }
+        }
+    }
+}
+
+static void ref_line(ref_t *r, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                     display_gfx_mode_t mode) {
+    const int32_t dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
+    const int32_t dy = -((y1 > y0) ? (y1 - y0) : (y0 - y1));
+    const int32_t sx = (x1 > x0) ? 1 : -1;
+    const int32_t sy = (y1 > y0) ? 1 : -1;
+    int32_t err = dx + dy;
+
+    for (;;) {
+        ref_plot(r, x0, y0, mode);
+        if ((x0 == x1) && (y0 == y1)) {
+            break;
+        }
+        const int32_t e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static void ref_bitmap(ref_t *r, int32_t x, int32_t y, const display_gfx_bitmap_t *bmp,
+                       display_gfx_mode_t mode) {
+    for (int32_t j = 0; j < bmp->h; ++j) {
+        for (int32_t i = 0; i < bmp->w; ++i) {
+            if (((bmp->data[(j / 8) * bmp->w + i] >> (j & 7)) & 1U) != 0U) {
+                ref_plot(r, x + i, y + j, mode);
+            }
+        }
+    }
+}
+
+static int32_t ref_char(ref_t *r, int32_t x, int32_t y, char c, uint8_t scale,
+                        display_gfx_mode_t mode) {
+    const int32_t s = (scale < 1U) ? 1 : ((scale > GFX_MAX_SCALE) ? (int32_t)GFX_MAX_SCALE : scale);
+    uint8_t ch = (uint8_t)c;
+
+    if ((ch < GFX_FONT_FIRST) || (ch > GFX_FONT_LAST)) {
+        ch = '?';
+    }
+    for (int32_t i = 0; i < (int32_t)GFX_FONT_W; ++i) {
+        const uint8_t col = gfx_font[ch - GFX_FONT_FIRST][i];
+        for (int32_t j = 0; j < (int32_t)GFX_FONT_H; ++j) {
+            if (((col >> j) & 1U) == 0U) {
+                continue;
+            }
+            for (int32_t a = 0; a < s; ++a) {
+                for (int32_t b = 0; b < s; ++b) {
+                    ref_plot(r, x + (i * s) + a, y + (j * s) + b, mode);
+                }
+            }
+        }
+    }
+    return x + ((int32_t)GFX_CELL_W * s);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Contrôle                                                                   */
+/* -------------------------------------------------------------------------- */
+
+static display_gfx_fb_t fb;
+static display_gfx_fb_t before;
+static uint8_t marked[GFX_PAGES][GFX_WIDTH];
+static uint32_t mark_calls;
+
+static void check_mark(uint8_t page, uint8_t x0, uint8_t x1) {
+    CHECK(page < GFX_PAGES);
+    CHECK(x0 <= x1);
+    CHECK(x1 < GFX_WIDTH);
+    for (uint32_t x = x0; x <= x1; ++x) {
+        marked[page][x] = 1U;
+    }
+    mark_calls++;
+}
+
+static int16_t rand_coord(uint32_t *rng, int32_t span) {
+    return (int16_t)((int32_t)(host_rand(rng) % (uint32_t)(span + 40)) - 20);
+}
+
+static void random_string(uint32_t *rng, char *s, uint32_t max) {
+    const uint32_t n = host_rand(rng) % max;
+    for (uint32_t i = 0U; i < n; ++i) {
+        /* Surtout imprimable, parfois hors police. */
+        const uint32_t r = host_rand(rng);
+        s[i] = ((r & 15U) == 0U) ? (char)(1U + ((r >> 4) % 255U))
+                                 : (char)(GFX_FONT_FIRST + ((r >> 4) % 95U));
+    }
+    s[n] = '\0';
+}
+
+static void check_case(uint32_t *rng, uint32_t n) {
+    static ref_t ref;
+    static uint8_t bmp_data[8U * 64U];
+    display_gfx_t g;
+    char str[32];
+
+    for (uint32_t p = 0U; p < GFX_PAGES; ++p) {
+        for (uint32_t x = 0U; x < GFX_WIDTH; ++x) {
+            fb[p][x] = (uint8_t)host_rand(rng);
+        }
+    }
+    memcpy(before, fb, sizeof(fb));
+    memset(marked, 0, sizeof(marked));
+    ref_from_fb(&ref, &fb);
+    display_gfx_bind(&g, &fb, check_mark);
+
+    if ((host_rand(rng) & 3U) != 0U) {
+        const int16_t cx = rand_coord(rng, GFX_WIDTH);
+        const int16_t cy = rand_coord(rng, GFX_HEIGHT);
+        const int16_t cw = (int16_t)(host_rand(rng) % (GFX_WIDTH + 20U));
+        const int16_t ch = (int16_t)(host_rand(rng) % (GFX_HEIGHT + 20U));
+        display_gfx_set_clip(&g, cx, cy, cw, ch);
+        ref_set_clip(&ref, cx, cy, cw, ch);
+    } else {
+        ref_set_clip(&ref, 0, 0, GFX_WIDTH, GFX_HEIGHT);
+    }
+
+    const display_gfx_mode_t mode = (display_gfx_mode_t)(host_rand(rng) % 3U);
+    const int16_t x = rand_coord(rng, GFX_WIDTH);
+    const int16_t y = rand_coord(rng, GFX_HEIGHT);
+    const int16_t w = (int16_t)((int32_t)(host_rand(rng) % 90U) - 4);
+    const int16_t h = (int16_t)((int32_t)(host_rand(rng) % 50U) - 4);
+    const uint8_t scale = (uint8_t)(host_rand(rng) % 4U);
+
+    switch (n % 9U) {
+    case 0U:
+        display_gfx_fill_rect(&g, x, y, w, h, mode);
+        ref_fill(&ref, x, y, w, h, mode);
+        break;
+    case 1U:
+        display_gfx_rect(&g, x, y, w, h, mode);
+        ref_rect(&ref, x, y, w, h, mode);
+        break;
+    case 2U:
+        display_gfx_invert_rect(&g, x, y, w, h);
+        ref_fill(&ref, x, y, w, h, GFX_XOR);
+        break;
+    case 3U: {
+        const int16_t x1 = rand_coord(rng, GFX_WIDTH);
+        const int16_t y1 = ((host_rand(rng) & 3U) == 0U) ? y : rand_coord(rng, GFX_HEIGHT);
+        display_gfx_line(&g, x, y, x1, y1, mode);
+        ref_line(&ref, x, y, x1, y1, mode);
+        break;
+    }
+    case 4U:
+        display_gfx_pixel(&g, x, y, mode);
+        ref_plot(&ref, x, y, mode);
+        break;
+    case 5U: {
+        display_gfx_bitmap_t bmp;
+        bmp.w = (uint8_t)(1U + (host_rand(rng) % 64U));
+        bmp.h = (uint8_t)(1U + (host_rand(rng) % 40U));
+        bmp.data = bmp_data;
+        for (uint32_t i = 0U; i < sizeof(bmp_data); ++i) {
+            bmp_data[i] = (uint8_t)host_rand(rng);
+        }
+        display_gfx_bitmap(&g, x, y, &bmp, mode);
+        ref_bitmap(&ref, x, y, &bmp, mode);
+        break;
+    }
+    case 6U: {
+        const char c = (char)(GFX_FONT_FIRST + (host_rand(rng) % 96U));
+        CHECK_EQ(display_gfx_char(&g, x, y, c, scale, mode), ref_char(&ref, x, y, c, scale, mode));
+        break;
+    }
+    case 7U:
+        /* Mêmes lignes que le banc : y & 7 fixe, glyphes déjà en cache. */
+        random_string(rng, str, 12U);
+        CHECK_EQ(display_gfx_text(&g, x, (int16_t)(y & ~7), str, scale, mode),
+                 x + display_gfx_text_width(str, scale));
+        for (int32_t cx = x, i = 0; str[i] != '\0'; ++i) {
+            cx = ref_char(&ref, cx, y & ~7, str[i], scale, mode);
+        }
+        break;
+    default:
+        random_string(rng, str, sizeof(str));
+        CHECK_EQ(display_gfx_text(&g, x, y, str, scale, mode),
+                 x + display_gfx_text_width(str, scale));
+        for (int32_t cx = x, i = 0; str[i] != '\0'; ++i) {
+            cx = ref_char(&ref, cx, y, str[i], scale, mode);
+        }
+        break;
+    }
+
+    for (uint32_t yy = 0U; yy < GFX_HEIGHT; ++yy) {
+        for (uint32_t xx = 0U; xx < GFX_WIDTH; ++xx) {
+            const uint8_t got = (uint8_t)((fb[yy / 8U][xx] >> (yy & 7U)) & 1U);
+            if (got != ref.px[yy][xx]) {
+                fprintf(stderr, "cas %u (type %u) : pixel (%u, %u) = %u, attendu %u\n",
+                        n, n % 9U, xx, yy, got, ref.px[yy][xx]);
+                exit(1);
+            }
+        }
+    }
+    for (uint32_t p = 0U; p < GFX_PAGES; ++p) {
+        for (uint32_t xx = 0U; xx < GFX_WIDTH; ++xx) {
+            if (fb[p][xx] != before[p][xx]) {
+                CHECK(marked[p][xx] != 0U);
+            }
+        }
+    }
+}
+
+static void checked_phase(uint32_t seed) {
+    uint32_t rng = seed;
+    display_gfx_stats_t st;
+
+    display_gfx_init();
+    for (uint32_t n = 0U; n < CHECK_CASES; ++n) {
+        check_case(&rng, n);
+    }
+    display_gfx_get_stats(&st);
+    printf("contrôle : %u cas identiques à la référence, %u marquages, "
+           "glyphes %u succès / %u défauts / %u évictions : ok\n",
+           CHECK_CASES, mark_calls, st.glyph_hits, st.glyph_misses, st.glyph_evictions);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Banc                                                                       */
+/* -------------------------------------------------------------------------- */
+
+static uint32_t bench_marks;
+
+static void bench_mark(uint8_t page, uint8_t x0, uint8_t x1) {
+    bench_marks += (uint32_t)page + x0 + x1;
+}
+
+static const char *const param_names[] = { "CUT", "RES", "ENV", "DEC", "LFO", "AMT", "PAN", "VOL" };
+
+static void draw_params(display_gfx_t *g, uint32_t row, uint32_t i) {
+    char buf[8];
+    const int16_t y = (int16_t)(40U + (12U * row));
+    display_gfx_fill_rect(g, 0, y, GFX_WIDTH, 12, GFX_CLEAR);
+    for (uint32_t k = 0U; k < 4U; ++k) {
+        const int16_t x = (int16_t)(k * 32U);
+        snprintf(buf, sizeof(buf), "%3u", (unsigned)((i * 7U + k * 13U) % 128U));
+        display_gfx_text(g, x, y, param_names[(row * 4U) + k], 1U, GFX_SET);
+        display_gfx_text(g, (int16_t)(x + 2), (int16_t)(y + 8 - 4), buf, 1U, GFX_SET);
+    }
+}
+
+static void draw_bpm(display_gfx_t *g, uint32_t i) {
+    char buf[8];
+    snprintf(buf, sizeof(buf), "%3u", (unsigned)(60U + (i % 140U)));
+    display_gfx_fill_rect(g, 84, 0, 44, 16, GFX_CLEAR);
+    display_gfx_text(g, 86, 0, buf, 2U, GFX_SET);
+}
+
+static void draw_playhead(display_gfx_t *g, uint32_t step) {
+    display_gfx_invert_rect(g, (int16_t)(step * 8U), 18, 8, 20);
+}
+
+static void draw_seq_page(display_gfx_t *g, uint32_t i) {
+    display_gfx_fill(g, GFX_CLEAR);
+    display_gfx_text(g, 0, 0, "PAT A01", 1U, GFX_SET);
+    display_gfx_text(g, 0, 8, "TRK 03 SYNTH", 1U, GFX_SET);
+    for (uint32_t s = 0U; s < 16U; ++s) {
+        const int16_t x = (int16_t)(s * 8U);
+        display_gfx_rect(g, (int16_t)(x + 1), 20, 6, 16, GFX_SET);
+        if (((i >> (s & 7U)) & 1U) != 0U) {
+            display_gfx_fill_rect(g, (int16_t)(x + 2), 21, 4, 14, GFX_SET);
+        }
+    }
+    draw_playhead(g, i & 15U);
+    draw_params(g, 0U, i);
+    draw_params(g, 1U, i);
+    draw_bpm(g, i);
+}
+
+static void draw_text_screen(display_gfx_t *g, uint32_t i) {
+    static const char line[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    display_gfx_fill(g, GFX_CLEAR);
+    for (uint32_t r = 0U; r < GFX_PAGES; ++r) {
+        char buf[22];
+        memcpy(buf, &line[(r * 5U + i) % (sizeof(line) - 22U)], 21U);
+        buf[21] = '\0';
+        display_gfx_text(g, 0, (int16_t)(r * 8U), buf, 1U, GFX_SET);
+    }
+}
+
+static void draw_playhead_move(display_gfx_t *g, uint32_t i) {
+    draw_playhead(g, (i - 1U) & 15U);
+    draw_playhead(g, i & 15U);
+    draw_bpm(g, i);
+}
+
+static void draw_param_row(display_gfx_t *g, uint32_t i) {
+    draw_params(g, i & 1U, i);
+}
+
+typedef void (*bench_fn_t)(display_gfx_t *g, uint32_t i);
+
+static void bench_one(const char *name, bench_fn_t fn) {
+    display_gfx_t g;
+    double best = 1e9;
+
+    display_gfx_bind(&g, &fb, bench_mark);
+    draw_seq_page(&g, 0U);
+    for (uint32_t i = 0U; i < 256U; ++i) {
+        fn(&g, i);
+    }
+    for (uint32_t s = 0U; s < BENCH_SERIES; ++s) {
+        const double t0 = host_now();
+        for (uint32_t i = 0U; i < BENCH_ITERS; ++i) {
+            fn(&g, i);
+        }
+        const double dt = (host_now() - t0) / (double)BENCH_ITERS;
+        if (dt < best) {
+            best = dt;
+        }
+    }
+    printf("  %-34s %6.2f µs\n", name, best * 1e6);
+}
+
+static void bench_phase(void) {
+    display_gfx_stats_t st;
+
+    display_gfx_init();
+    printf("banc (meilleure de %u séries de %u) :\n", BENCH_SERIES, BENCH_ITERS);
+    bench_one("page séquenceur complète", draw_seq_page);
+    bench_one("écran de texte 8 x 21", draw_text_screen);
+    bench_one("tête de lecture + BPM", draw_playhead_move);
+    bench_one("rangée de paramètres", draw_param_row);
+    display_gfx_get_stats(&st);
+    printf("  glyphes : %u succès, %u défauts [%u]\n",
+           st.glyph_hits, st.glyph_misses, bench_marks & 1U);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 0x47465821U;
+
+    CHECK(seed != 0U);
+    checked_phase(seed);
+    bench_phase();
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file host_check.h
+ * @brief Outils communs des programmes hôte : vérifications, chronométrage, PRNG.
+ * @details Les programmes de tests/host compilent les modules sans
+ * dépendance à ChibiOS tels quels, avec le compilateur de la machine.
+ * Une vérification en échec affiche sa position et termine le programme
+ * avec un code non nul.
+ */
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "%s:%d: échec : %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                           \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                         \
+    do {                                                                       \
+        const long long check_a_ = (long long)(a);                             \
+        const long long check_b_ = (long long)(b);                             \
+        if (check_a_ != check_b_) {                                            \
+            fprintf(stderr, "%s:%d: échec : %s == %s (%lld != %lld)\n",        \
+                    __FILE__, __LINE__, #a, #b, check_a_, check_b_);           \
+            exit(1);                                                           \
+        }                                                                      \
+    } while (0)
+
+/* Horloge monotone en secondes. */
+static inline double host_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+/* xorshift32 : suites reproductibles d'une exécution à l'autre. */
+static inline uint32_t host_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+#endif /* HOST_CHECK_H */
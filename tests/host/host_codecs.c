@@ -0,0 +1,28 @@
+/**
+ * @file host_codecs.c
+ * @brief Codecs ADAU1979 et PCM4104 sans bus, pour les programmes hôte qui compilent drv_audio.c.
+ * @details Rien à configurer sur hôte : initialisation et configuration
+ * réussissent toujours, le mute est ignoré.
+ */
+
+#include "audio_codec_ada1979.h"
+#include "audio_codec_pcm4104.h"
+
+msg_t adau1979_init(void) {
+    return HAL_RET_SUCCESS;
+}
+
+msg_t adau1979_set_default_config(void) {
+    return HAL_RET_SUCCESS;
+}
+
+void adau1979_mute(bool en) {
+    (void)en;
+}
+
+void audio_codec_pcm4104_init(void) {
+}
+
+void audio_codec_pcm4104_set_mute(bool mute) {
+    (void)mute;
+}
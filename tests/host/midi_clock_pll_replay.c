@@ -0,0 +1,382 @@
+/**
+ * @file midi_clock_pll_replay.c
+ * @brief Rejeu de flux d'horloge MIDI dans midi_clock_pll et simulation de l'esclave.
+ * @details Chaque flux (horodatages en frames à 48 kHz) est rejoué bloc
+ * audio par bloc audio comme dans seq_clock : les impulsions reçues avant
+ * le bloc entrent dans la PLL, puis les impulsions esclaves dont
+ * l'instant prédit (midi_clock_pll_time_q16) tombe dans le bloc sont
+ * émises, à la frame près. L'esclave part de la première impulsion reçue
+ * une fois la PLL verrouillée.
+ *
+ * Mesures, une fois l'esclave lancé et la PLL reverrouillée : écart des
+ * intervalles entre impulsions esclaves à la période de la source, écart
+ * de phase à l'instant idéal (sans gigue) de l'impulsion correspondante,
+ * tempo lissé. Flux synthétiques : gigue uniforme ±1 ms, horodatage USB
+ * (grille de 1 ms), impulsions perdues, impulsions aberrantes, saut de
+ * tempo, silence puis reprise.
+ *
+ * Usage : midi_clock_pll_replay [fichier]
+ * Avec un fichier (une frame par ligne, décimal), le flux enregistré est
+ * rejoué et ses mesures affichées, sans seuils.
+ */
+
+#include "host_check.h"
+#include "midi_clock_pll.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SAMPLE_RATE           48000U
+#define BLOCK_FRAMES          16U
+#define MAX_TICKS             20000U
+#define MAX_PULSES            (2U * MAX_TICKS)
+#define SETTLE_PULSES         48U          /* Écartées après un (re)verrouillage. */
+
+typedef struct {
+    uint32_t frame[MAX_TICKS];        /* Horodatage reçu. */
+    uint32_t ideal[MAX_TICKS];        /* Instant sans gigue de l'impulsion de même index. */
+    double   period[MAX_TICKS];       /* Période source à cet index (frames). */
+    uint32_t n;                       /* Impulsions reçues. */
+    uint32_t n_ideal;                 /* Impulsions émises par la source (reçues ou non). */
+} stream_t;
+
+typedef struct {
+    uint32_t lock_ticks;              /* Impulsions reçues avant le premier verrouillage. */
+    uint32_t pulses;                  /* Impulsions esclaves mesurées. */
+    double   interval_dev_max;        /* |intervalle - période|, frames. */
+    double   phase_err_max;           /* |impulsion - instant idéal|, frames. */
+    double   phase_err_rms;
+    bool     phase;                   /* Phase mesurée (index source connus). */
+    uint32_t late;                    /* Impulsions prédites dans le passé. */
+    double   bpm_end;
+    midi_clock_pll_stats_t pll;
+} result_t;
+
+static stream_t stream;
+static uint32_t slave_frame[MAX_PULSES];
+static uint32_t slave_index[MAX_PULSES];
+static bool     slave_settled[MAX_PULSES];
+
+/* -------------------------------------------------------------------------- */
+/* Génération                                                                 */
+/* -------------------------------------------------------------------------- */
+
+static double period_for(double bpm) {
+    return ((double)SAMPLE_RATE * 60.0) / (bpm * 24.0);
+}
+
+/* Instants idéaux : `ticks` impulsions à `bpm` à partir de `t` ; retourne l'instant suivant. */
+static double gen_ideal(stream_t *s, double t, double bpm, uint32_t ticks) {
+    const double p = period_for(bpm);
+    for (uint32_t i = 0U; (i < ticks) && (s->n_ideal < MAX_TICKS); ++i) {
+        s->ideal[s->n_ideal] = (uint32_t)llround(t + ((double)i * p));
+        s->period[s->n_ideal] = p;
+        s->n_ideal++;
+    }
+    return t + ((double)ticks * p);
+}
+
+/* Tout instant idéal reçu, avec gigue uniforme ±jitter frames, grille optionnelle. */
+static void gen_receive_all(stream_t *s, uint32_t *rng, double jitter, uint32_t grid) {
+    s->n = 0U;
+    for (uint32_t i = 0U; i < s->n_ideal; ++i) {
+        const double u = ((double)(host_rand(rng) % 20001U) / 10000.0) - 1.0;
+        uint32_t f = (uint32_t)llround((double)s->ideal[i] + (u * jitter));
+        if (grid > 1U) {
+            f = ((f + grid - 1U) / grid) * grid;
+        }
+        s->frame[s->n++] = f;
+    }
+}
+
+static void stream_reset(stream_t *s) {
+    s->n = 0U;
+    s->n_ideal = 0U;
+}
+
+/* Retire l'impulsion reçue `i` (perte). */
+static void stream_drop(stream_t *s, uint32_t i) {
+    memmove(&s->frame[i], &s->frame[i + 1U], (s->n - i - 1U) * sizeof(s->frame[0]));
+    s->n--;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Rejeu                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * `ideal_known` : les index PLL correspondent aux index source (pas de
+ * rejet isolé ni de relance), la phase est alors mesurable. Seules les
+ * impulsions esclaves à partir de la frame `measure_from` sont mesurées
+ * (transitoire d'un changement de tempo exclu).
+ */
+static void replay(const stream_t *s, bool ideal_known, uint32_t measure_from, result_t *r) {
+    midi_clock_pll_t pll;
+    uint32_t next_tick = 0U;
+    uint32_t target = 0U;
+    uint32_t n_pulses = 0U;
+    uint32_t settle = 0U;
+    bool running = false;
+
+    memset(r, 0, sizeof(*r));
+    midi_clock_pll_init(&pll, SAMPLE_RATE);
+
+    const uint32_t first = s->frame[0] - (s->frame[0] % BLOCK_FRAMES);
+    const uint32_t last = s->frame[s->n - 1U] + BLOCK_FRAMES;
+    for (uint32_t block = first; (int32_t)(block - last) < 0; block += BLOCK_FRAMES) {
+        while ((next_tick < s->n) && ((int32_t)(s->frame[next_tick] - block) < 0)) {
+            const bool was_locked = midi_clock_pll_locked(&pll);
+            midi_clock_pll_tick(&pll, s->frame[next_tick]);
+            next_tick++;
+            if (!was_locked && midi_clock_pll_locked(&pll)) {
+                if (r->lock_ticks == 0U) {
+                    r->lock_ticks = next_tick;
+                }
+                settle = SETTLE_PULSES;
+            }
+            if (!running && midi_clock_pll_locked(&pll)) {
+                running = true;
+                target = pll.index;
+            }
+        }
+        if (!running || !midi_clock_pll_has_period(&pll)) {
+            continue;
+        }
+        if ((int32_t)(target - pll.index) >= 4) {
+            /* Source muette : l'esclave s'arrête sur l'impulsion attendue. */
+            continue;
+        }
+        for (;;) {
+            int64_t until = midi_clock_pll_time_q16(&pll, target, block);
+            if (until < 0) {
+                until = 0;
+                r->late++;
+            }
+            if (until >= ((int64_t)BLOCK_FRAMES << 16)) {
+                break;
+            }
+            CHECK(n_pulses < MAX_PULSES);
+            slave_frame[n_pulses] = block + (uint32_t)(until >> 16);
+            slave_index[n_pulses] = target;
+            slave_settled[n_pulses] = midi_clock_pll_locked(&pll) && (settle == 0U);
+            n_pulses++;
+            if (settle > 0U) {
+                settle--;
+            }
+            target++;
+        }
+    }
+
+    double sq = 0.0;
+    for (uint32_t i = 1U; i < n_pulses; ++i) {
+        if (!slave_settled[i] || !slave_settled[i - 1U] ||
+            (slave_index[i] != (slave_index[i - 1U] + 1U)) || (slave_index[i] >= s->n_ideal) ||
+            ((int32_t)(slave_frame[i - 1U] - measure_from) < 0)) {
+            continue;
+        }
+        /* Intervalle source attendu (idéaux arrondis : ±1 frame). */
+        const double p = ideal_known
+                       ? (double)(s->ideal[slave_index[i]] - s->ideal[slave_index[i] - 1U])
+                       : s->period[slave_index[i]];
+        const double dev = fabs((double)(slave_frame[i] - slave_frame[i - 1U]) - p);
+        if (dev > r->interval_dev_max) {
+            r->interval_dev_max = dev;
+        }
+        if (ideal_known) {
+            const double e = fabs((double)(int32_t)(slave_frame[i] - s->ideal[slave_index[i]]));
+            if (e > r->phase_err_max) {
+                r->phase_err_max = e;
+            }
+            sq += e * e;
+        }
+        r->pulses++;
+    }
+    r->phase = ideal_known;
+    if (r->pulses > 0U) {
+        r->phase_err_rms = sqrt(sq / (double)r->pulses);
+    }
+    r->bpm_end = (double)midi_clock_pll_bpm_x10(&pll, SAMPLE_RATE) / 10.0;
+    r->pll = pll.stats;
+}
+
+static void print_result(const char *name, const result_t *r) {
+    char phase[40] = "phase -";
+    if (r->phase) {
+        snprintf(phase, sizeof(phase), "phase max %.0f rms %.1f", r->phase_err_max, r->phase_err_rms);
+    }
+    printf("  %-28s verrou %3u imp., %5u imp. esclaves, intervalle ±%.0f, %s, "
+           "%.1f BPM, perdues %u, rejets %u, relances %u\n",
+           name, r->lock_ticks, r->pulses, r->interval_dev_max, phase,
+           r->bpm_end, r->pll.missed, r->pll.outliers, r->pll.relocks);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Scénarios                                                                  */
+/* -------------------------------------------------------------------------- */
+
+static void scenario_jitter(uint32_t *rng) {
+    result_t r;
+    double t = 1000.0;
+
+    stream_reset(&stream);
+    t = gen_ideal(&stream, t, 120.0, 4000U);
+    gen_receive_all(&stream, rng, 48.0, 1U);
+    replay(&stream, true, 0U, &r);
+    print_result("120 BPM, gigue ±1 ms", &r);
+    CHECK((r.lock_ticks > 0U) && (r.lock_ticks <= 2U * MIDI_CLOCK_PLL_ACQ_TICKS));
+    CHECK(r.pulses > 3500U);
+    CHECK(r.interval_dev_max <= 5.0);
+    CHECK(r.phase_err_max <= 48.0);
+    CHECK(fabs(r.bpm_end - 120.0) <= 0.2);
+    CHECK_EQ(r.pll.outliers, 0U);
+    CHECK_EQ(r.pll.relocks, 0U);
+}
+
+static void scenario_usb(uint32_t *rng) {
+    result_t r;
+    double t = 333.0;
+
+    /* Horodatage au SOF : grille de 1 ms, plus la gigue de l'émetteur. */
+    stream_reset(&stream);
+    t = gen_ideal(&stream, t, 174.0, 4000U);
+    gen_receive_all(&stream, rng, 12.0, 48U);
+    replay(&stream, true, 0U, &r);
+    print_result("174 BPM, grille USB 1 ms", &r);
+    CHECK(r.lock_ticks > 0U);
+    CHECK(r.interval_dev_max <= 5.0);
+    CHECK(r.phase_err_max <= 64.0);
+    CHECK(fabs(r.bpm_end - 174.0) <= 0.2);
+}
+
+static void scenario_drops(uint32_t *rng) {
+    result_t r;
+    double t = 500.0;
+    uint32_t dropped = 0U;
+
+    stream_reset(&stream);
+    t = gen_ideal(&stream, t, 132.0, 6000U);
+    gen_receive_all(&stream, rng, 24.0, 1U);
+    /* Après le verrouillage, une perte de 1 à 3 impulsions de temps en temps. */
+    for (uint32_t i = 200U; i < (stream.n - 10U); i += 40U + (host_rand(rng) % 40U)) {
+        const uint32_t k = 1U + (host_rand(rng) % 3U);
+        for (uint32_t j = 0U; j < k; ++j) {
+            stream_drop(&stream, i);
+        }
+        dropped += k;
+    }
+    replay(&stream, true, 0U, &r);
+    print_result("132 BPM, pertes", &r);
+    CHECK_EQ(r.pll.missed, dropped);
+    CHECK_EQ(r.pll.relocks, 0U);
+    CHECK(r.interval_dev_max <= 5.0);
+    CHECK(r.phase_err_max <= 48.0);
+}
+
+static void scenario_outliers(uint32_t *rng) {
+    result_t r;
+    double t = 500.0;
+    uint32_t injected = 0U;
+
+    stream_reset(&stream);
+    t = gen_ideal(&stream, t, 100.0, 4000U);
+    gen_receive_all(&stream, rng, 24.0, 1U);
+    /*
+     * Impulsions isolées avancées de 55 à 90 % d'une période : rejetées,
+     * puis l'impulsion suivante comble la perte. Un retard du même ordre
+     * est indiscernable d'une perte suivie d'une impulsion en avance.
+     */
+    const double p = period_for(100.0);
+    for (uint32_t i = 300U; i < (stream.n - 10U); i += 97U) {
+        const double frac = 0.55 + ((double)(host_rand(rng) % 350U) / 1000.0);
+        stream.frame[i] -= (uint32_t)(frac * p);
+        injected++;
+    }
+    replay(&stream, true, 0U, &r);
+    print_result("100 BPM, aberrantes", &r);
+    CHECK_EQ(r.pll.outliers, injected);
+    CHECK_EQ(r.pll.missed, injected);
+    CHECK_EQ(r.pll.relocks, 0U);
+    CHECK(r.interval_dev_max <= 5.0);
+}
+
+static void scenario_tempo_jump(uint32_t *rng) {
+    result_t r;
+    double t = 500.0;
+
+    stream_reset(&stream);
+    t = gen_ideal(&stream, t, 120.0, 2000U);
+    t = gen_ideal(&stream, t, 150.0, 2000U);
+    gen_receive_all(&stream, rng, 48.0, 1U);
+    /* Mesure à partir de quatre noires après le saut. */
+    replay(&stream, false, stream.ideal[2000U + 96U], &r);
+    print_result("120 -> 150 BPM", &r);
+    CHECK(fabs(r.bpm_end - 150.0) <= 0.2);
+    CHECK(r.interval_dev_max <= 5.0);
+}
+
+static void scenario_restart(uint32_t *rng) {
+    result_t r;
+    double t = 500.0;
+
+    /* Deux secondes de silence, reprise à un autre tempo. */
+    stream_reset(&stream);
+    t = gen_ideal(&stream, t, 90.0, 1500U);
+    t += 2.0 * SAMPLE_RATE;
+    t = gen_ideal(&stream, t, 140.0, 1500U);
+    gen_receive_all(&stream, rng, 24.0, 1U);
+    replay(&stream, false, stream.ideal[1500U + 96U], &r);
+    print_result("90 BPM, silence, 140 BPM", &r);
+    CHECK(r.pll.relocks >= 1U);
+    CHECK(fabs(r.bpm_end - 140.0) <= 0.2);
+    CHECK(r.interval_dev_max <= 5.0);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Flux enregistré                                                            */
+/* -------------------------------------------------------------------------- */
+
+static int replay_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    result_t r;
+    unsigned long v;
+
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    stream_reset(&stream);
+    while ((stream.n < MAX_TICKS) && (fscanf(f, "%lu", &v) == 1)) {
+        stream.frame[stream.n++] = (uint32_t)v;
+    }
+    fclose(f);
+    if (stream.n < 2U) {
+        fprintf(stderr, "%s : moins de deux impulsions\n", path);
+        return 1;
+    }
+    /* Période source inconnue : celle du flux entier pour les intervalles. */
+    const double p = (double)(stream.frame[stream.n - 1U] - stream.frame[0]) / (double)(stream.n - 1U);
+    for (uint32_t i = 0U; i < MAX_TICKS; ++i) {
+        stream.period[i] = p;
+    }
+    stream.n_ideal = MAX_TICKS;
+    replay(&stream, false, 0U, &r);
+    print_result(path, &r);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rng = 0x504C4C31U;
+
+    if (argc > 1) {
+        return replay_file(argv[1]);
+    }
+    printf("rejeu (frames à 48 kHz, blocs de %u) :\n", BLOCK_FRAMES);
+    scenario_jitter(&rng);
+    scenario_usb(&rng);
+    scenario_drops(&rng);
+    scenario_outliers(&rng);
+    scenario_tempo_jump(&rng);
+    scenario_restart(&rng);
+    printf("rejeu : ok\n");
+    return 0;
+}
@@ -0,0 +1,597 @@
+/**
+ * @file midi_parser_fuzz.c
+ * @brief Fuzz, flux enregistrés et débit de midi_parser sur hôte.
+ * @details Trois volets :
+ *  - flux enregistrés : suites d'octets écrites à la main (running status,
+ *    temps réel intercalé, SysEx fragmenté ou interrompu, communs système,
+ *    antidatage) avec leurs messages attendus ;
+ *  - fuzz : flux aléatoires découpés en paquets de taille aléatoire,
+ *    comparés octet par octet à un modèle de référence écrit d'après la
+ *    norme, bornes de l'état vérifiées après chaque paquet, et aller-retour
+ *    midi_tx_encode -> analyseur ;
+ *  - débit : octets par seconde sur un flux réaliste, rapporté au débit
+ *    d'une ligne DIN (3 125 octets/s).
+ *
+ * Usage : midi_parser_fuzz [graine [flux]]
+ */
+
+#include "host_check.h"
+#include "midi_parser.h"
+
+#include <string.h>
+
+#define FUZZ_DEFAULT_SEED     0x4D494449U
+#define FUZZ_DEFAULT_STREAMS  2000U
+#define FUZZ_STREAM_BYTES     4096U
+#define FUZZ_MAX_CHUNK        64U
+#define LOG_MAX_MSGS          8192U
+#define LOG_MAX_SYSEX         16384U
+#define BENCH_BYTES           (8U * 1024U * 1024U)
+
+/* Marqueurs du journal SysEx (hors plage des octets de données). */
+#define SX_START              0x100U
+#define SX_END                0x200U
+#define SX_ABORT              0x400U
+
+/* -------------------------------------------------------------------------- */
+/* Journal : ce que l'analyseur (ou le modèle) a produit                      */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    uint8_t  status;
+    uint8_t  data[2];
+    uint32_t frame;
+} log_msg_t;
+
+typedef struct {
+    uint16_t value;       /* Octet de données ou SX_*. */
+    uint32_t frame;       /* Significatif pour SX_END / SX_ABORT. */
+} log_sx_t;
+
+typedef struct {
+    log_msg_t msgs[LOG_MAX_MSGS];
+    uint32_t  n_msgs;
+    log_sx_t  sx[LOG_MAX_SYSEX];
+    uint32_t  n_sx;
+    uint32_t  fragments;
+    bool      in_sysex;   /* Vu par les fragments : START reçu, fin pas encore. */
+} log_t;
+
+static void log_clear(log_t *lg) {
+    lg->n_msgs = 0U;
+    lg->n_sx = 0U;
+    lg->fragments = 0U;
+    lg->in_sysex = false;
+}
+
+static void log_msg(log_t *lg, uint8_t status, uint8_t d0, uint8_t d1, uint32_t frame) {
+    CHECK(lg->n_msgs < LOG_MAX_MSGS);
+    log_msg_t *m = &lg->msgs[lg->n_msgs++];
+    m->status = status;
+    m->data[0] = d0;
+    m->data[1] = d1;
+    m->frame = frame;
+}
+
+static void log_sx(log_t *lg, uint16_t value, uint32_t frame) {
+    CHECK(lg->n_sx < LOG_MAX_SYSEX);
+    lg->sx[lg->n_sx].value = value;
+    lg->sx[lg->n_sx].frame = frame;
+    lg->n_sx++;
+}
+
+static void on_msg(void *ctx, const midi_msg_t *msg) {
+    log_t *lg = (log_t *)ctx;
+    CHECK(msg->status >= 0x80U);
+    CHECK(msg->status != MIDI_SYSEX_START);
+    CHECK(msg->status != MIDI_SYSEX_END);
+    CHECK(msg->data[0] < 0x80U);
+    CHECK(msg->data[1] < 0x80U);
+    log_msg(lg, msg->status, msg->data[0], msg->data[1], msg->frame);
+}
+
+static void on_sysex(void *ctx, const uint8_t *data, size_t len, uint8_t flags, uint32_t frame) {
+    log_t *lg = (log_t *)ctx;
+    const uint8_t closing = flags & (MIDI_SYSEX_FLAG_END | MIDI_SYSEX_FLAG_ABORT);
+
+    /* Forme d'un fragment : taille bornée, données seules, flags cohérents. */
+    CHECK(len <= MIDI_PARSER_SYSEX_CHUNK);
+    CHECK((flags & ~(MIDI_SYSEX_FLAG_START | MIDI_SYSEX_FLAG_END | MIDI_SYSEX_FLAG_ABORT)) == 0U);
+    CHECK(closing != (MIDI_SYSEX_FLAG_END | MIDI_SYSEX_FLAG_ABORT));
+    CHECK((len > 0U) || (flags != 0U));
+    CHECK((closing != 0U) || (len == MIDI_PARSER_SYSEX_CHUNK));
+    CHECK(((flags & MIDI_SYSEX_FLAG_START) != 0U) == !lg->in_sysex);
+
+    lg->fragments++;
+    if ((flags & MIDI_SYSEX_FLAG_START) != 0U) {
+        log_sx(lg, SX_START, 0U);
+    }
+    for (size_t i = 0U; i < len; ++i) {
+        CHECK(data[i] < 0x80U);
+        log_sx(lg, data[i], 0U);
+    }
+    if ((flags & MIDI_SYSEX_FLAG_END) != 0U) {
+        log_sx(lg, SX_END, frame);
+    }
+    if ((flags & MIDI_SYSEX_FLAG_ABORT) != 0U) {
+        log_sx(lg, SX_ABORT, frame);
+    }
+    lg->in_sysex = (closing == 0U);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Modèle de référence                                                        */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Écrit d'après la spécification MIDI 1.0, sans reprendre la structure de
+ * midi_parser.c : un octet à la fois, état explicite.
+ */
+typedef struct {
+    uint8_t  status;      /* Statut dont on attend les données (0 = aucun). */
+    uint8_t  need;
+    uint8_t  have;
+    uint8_t  d[2];
+    bool     sysex;
+    midi_parser_stats_t stats;
+} ref_t;
+
+static uint8_t ref_data_bytes(uint8_t status) {
+    switch (status & 0xF0U) {
+    case 0xC0U:
+    case 0xD0U:
+        return 1U;
+    case 0xF0U:
+        if ((status == 0xF1U) || (status == 0xF3U)) {
+            return 1U;
+        }
+        return (status == 0xF2U) ? 2U : 0U;
+    default:
+        return 2U;
+    }
+}
+
+static void ref_byte(ref_t *r, log_t *lg, uint8_t b, uint32_t frame) {
+    if (b >= 0xF8U) {
+        if ((b == 0xF9U) || (b == 0xFDU)) {
+            r->stats.undefined++;
+        } else {
+            r->stats.messages++;
+            log_msg(lg, b, 0U, 0U, frame);
+        }
+        return;
+    }
+
+    if (b < 0x80U) {
+        if (r->sysex) {
+            r->stats.sysex_bytes++;
+            log_sx(lg, b, 0U);
+        } else if (r->status == 0U) {
+            r->stats.stray_bytes++;
+        } else {
+            r->d[r->have++] = b;
+            if (r->have == r->need) {
+                r->stats.messages++;
+                log_msg(lg, r->status, r->d[0], (r->need == 2U) ? r->d[1] : 0U, frame);
+                r->have = 0U;
+                if (r->status >= 0xF0U) {
+                    r->status = 0U;
+                }
+            }
+        }
+        return;
+    }
+
+    /* Statut non temps réel : termine un SysEx en cours. */
+    if (r->sysex) {
+        r->sysex = false;
+        if (b == 0xF7U) {
+            log_sx(lg, SX_END, frame);
+            return;
+        }
+        r->stats.sysex_aborted++;
+        log_sx(lg, SX_ABORT, frame);
+    }
+    r->have = 0U;
+    r->status = 0U;
+
+    if (b < 0xF0U) {
+        r->status = b;
+        r->need = ref_data_bytes(b);
+    } else if (b == 0xF0U) {
+        r->sysex = true;
+        log_sx(lg, SX_START, 0U);
+    } else if ((b == 0xF4U) || (b == 0xF5U) || (b == 0xF7U)) {
+        r->stats.undefined++;
+    } else if (b == 0xF6U) {
+        r->stats.messages++;
+        log_msg(lg, b, 0U, 0U, frame);
+    } else {
+        r->status = b;
+        r->need = ref_data_bytes(b);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Comparaison                                                                */
+/* -------------------------------------------------------------------------- */
+
+static void check_bounds(const midi_parser_t *p) {
+    CHECK(p->expected <= 2U);
+    CHECK(p->count < 2U);
+    CHECK(p->sysex_len < MIDI_PARSER_SYSEX_CHUNK);
+    CHECK((p->in_sysex) || (p->sysex_len == 0U));
+    CHECK((p->running == 0U) || ((p->running >= 0x80U) && (p->running < 0xF4U)));
+    CHECK((p->running == 0U) || (p->count < p->expected));
+    CHECK((p->running == 0U) || (!p->in_sysex));
+}
+
+static void check_same(const log_t *got, const log_t *want) {
+    CHECK_EQ(got->n_msgs, want->n_msgs);
+    for (uint32_t i = 0U; i < got->n_msgs; ++i) {
+        const log_msg_t *a = &got->msgs[i];
+        const log_msg_t *b = &want->msgs[i];
+        if ((a->status != b->status) || (a->data[0] != b->data[0]) ||
+            (a->data[1] != b->data[1]) || (a->frame != b->frame)) {
+            fprintf(stderr, "message %u : %02X %02X %02X @%u, attendu %02X %02X %02X @%u\n",
+                    i, a->status, a->data[0], a->data[1], a->frame,
+                    b->status, b->data[0], b->data[1], b->frame);
+            exit(1);
+        }
+    }
+    CHECK_EQ(got->n_sx, want->n_sx);
+    for (uint32_t i = 0U; i < got->n_sx; ++i) {
+        CHECK_EQ(got->sx[i].value, want->sx[i].value);
+        CHECK_EQ(got->sx[i].frame, want->sx[i].frame);
+    }
+}
+
+static void check_stats(const midi_parser_stats_t *a, const midi_parser_stats_t *b) {
+    CHECK_EQ(a->messages, b->messages);
+    CHECK_EQ(a->sysex_bytes, b->sysex_bytes);
+    CHECK_EQ(a->stray_bytes, b->stray_bytes);
+    CHECK_EQ(a->undefined, b->undefined);
+    CHECK_EQ(a->sysex_aborted, b->sysex_aborted);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Flux enregistrés                                                           */
+/* -------------------------------------------------------------------------- */
+
+static log_t got;
+static log_t want;
+
+static void feed_all(midi_parser_t *p, const uint8_t *data, size_t len, uint32_t frame) {
+    log_clear(&got);
+    midi_parser_init(p, MIDI_PORT_DIN, on_msg, on_sysex, &got);
+    midi_parser_feed(p, data, len, frame, 256U);
+    check_bounds(p);
+}
+
+static void expect_msg(uint32_t i, uint8_t status, uint8_t d0, uint8_t d1, uint32_t frame) {
+    CHECK(i < got.n_msgs);
+    CHECK_EQ(got.msgs[i].status, status);
+    CHECK_EQ(got.msgs[i].data[0], d0);
+    CHECK_EQ(got.msgs[i].data[1], d1);
+    CHECK_EQ(got.msgs[i].frame, frame);
+}
+
+static void recorded_streams(void) {
+    midi_parser_t p;
+
+    /* Running status : une note complète puis deux notes sans statut. */
+    static const uint8_t running[] = { 0x90, 0x3C, 0x64, 0x3E, 0x64, 0x40, 0x00 };
+    feed_all(&p, running, sizeof(running), 6U);
+    CHECK_EQ(got.n_msgs, 3U);
+    expect_msg(0U, 0x90, 0x3C, 0x64, 2U);
+    expect_msg(1U, 0x90, 0x3E, 0x64, 4U);
+    expect_msg(2U, 0x90, 0x40, 0x00, 6U);
+
+    /* Un octet par paquet : même résultat, l'état traverse les paquets. */
+    log_clear(&got);
+    midi_parser_init(&p, MIDI_PORT_DIN, on_msg, on_sysex, &got);
+    for (uint32_t i = 0U; i < sizeof(running); ++i) {
+        midi_parser_feed(&p, &running[i], 1U, i, 256U);
+        check_bounds(&p);
+    }
+    CHECK_EQ(got.n_msgs, 3U);
+    expect_msg(2U, 0x90, 0x40, 0x00, 6U);
+
+    /* Temps réel intercalé : émis aussitôt, le message en cours n'est pas touché. */
+    static const uint8_t rt[] = { 0xB0, 0x07, 0xF8, 0x7F, 0xFE, 0x08, 0xFA, 0x10 };
+    feed_all(&p, rt, sizeof(rt), 7U);
+    CHECK_EQ(got.n_msgs, 5U);
+    expect_msg(0U, 0xF8, 0x00, 0x00, 2U);
+    expect_msg(1U, 0xB0, 0x07, 0x7F, 3U);
+    expect_msg(2U, 0xFE, 0x00, 0x00, 4U);
+    expect_msg(3U, 0xFA, 0x00, 0x00, 6U);
+    expect_msg(4U, 0xB0, 0x08, 0x10, 7U);
+
+    /* Statuts indéfinis ignorés, y compris un F7 orphelin. */
+    static const uint8_t undef[] = { 0xF4, 0xF5, 0xF9, 0xFD, 0xF7, 0x10 };
+    feed_all(&p, undef, sizeof(undef), 5U);
+    CHECK_EQ(got.n_msgs, 0U);
+    CHECK_EQ(p.stats.undefined, 5U);
+    CHECK_EQ(p.stats.stray_bytes, 1U);
+
+    /* Commun système : annule le running status, puis données orphelines. */
+    static const uint8_t common[] = { 0x90, 0x3C, 0x64, 0xF3, 0x05, 0x3C, 0x64,
+                                      0xF2, 0x01, 0x02, 0xF6, 0xC0, 0x05, 0x06 };
+    feed_all(&p, common, sizeof(common), 13U);
+    CHECK_EQ(got.n_msgs, 6U);
+    expect_msg(0U, 0x90, 0x3C, 0x64, 2U);
+    expect_msg(1U, 0xF3, 0x05, 0x00, 4U);
+    expect_msg(2U, 0xF2, 0x01, 0x02, 9U);
+    expect_msg(3U, 0xF6, 0x00, 0x00, 10U);
+    expect_msg(4U, 0xC0, 0x05, 0x00, 12U);
+    expect_msg(5U, 0xC0, 0x06, 0x00, 13U);
+    CHECK_EQ(p.stats.stray_bytes, 2U);
+
+    /* SysEx de 70 octets : fragments 32 + 32 + 6, temps réel intercalé. */
+    uint8_t sx[73];
+    sx[0] = 0xF0;
+    for (uint32_t i = 0U; i < 70U; ++i) {
+        sx[1U + i] = (uint8_t)(i & 0x7FU);
+    }
+    sx[71] = 0xF8;
+    sx[72] = 0xF7;
+    const uint8_t tail[] = { 0x00 };
+    feed_all(&p, sx, sizeof(sx), 72U);
+    midi_parser_feed(&p, tail, 1U, 73U, 256U);
+    CHECK_EQ(got.fragments, 3U);
+    CHECK_EQ(got.n_sx, 72U);
+    CHECK_EQ(got.sx[0].value, SX_START);
+    CHECK_EQ(got.sx[71].value, SX_END);
+    CHECK_EQ(got.sx[71].frame, 72U);
+    CHECK_EQ(got.n_msgs, 1U);
+    expect_msg(0U, 0xF8, 0x00, 0x00, 71U);
+    CHECK_EQ(p.stats.sysex_bytes, 70U);
+    CHECK_EQ(p.stats.stray_bytes, 1U);
+    CHECK(!p.in_sysex);
+
+    /* SysEx interrompu par une note : fragment ABORT puis note analysée. */
+    static const uint8_t abort_sx[] = { 0xF0, 0x01, 0x02, 0x90, 0x3C, 0x64 };
+    feed_all(&p, abort_sx, sizeof(abort_sx), 5U);
+    CHECK_EQ(got.fragments, 1U);
+    CHECK_EQ(got.n_sx, 4U);
+    CHECK_EQ(got.sx[0].value, SX_START);
+    CHECK_EQ(got.sx[3].value, SX_ABORT);
+    CHECK_EQ(got.sx[3].frame, 3U);
+    CHECK_EQ(p.stats.sysex_aborted, 1U);
+    CHECK_EQ(got.n_msgs, 1U);
+    expect_msg(0U, 0x90, 0x3C, 0x64, 5U);
+
+    /* SysEx vide et SysEx de 32 octets exactement : fin sans données. */
+    uint8_t sx32[35];
+    sx32[0] = 0xF0;
+    sx32[1] = 0xF7;
+    sx32[2] = 0xF0;
+    for (uint32_t i = 0U; i < 32U; ++i) {
+        sx32[3U + i] = 0x55;
+    }
+    feed_all(&p, sx32, sizeof(sx32), 34U);
+    midi_parser_feed(&p, &sx32[1], 1U, 35U, 256U);
+    CHECK_EQ(got.fragments, 3U);
+    CHECK_EQ(got.n_sx, 2U + 1U + 32U + 1U);
+    CHECK_EQ(got.sx[1].value, SX_END);
+    CHECK_EQ(got.sx[35].value, SX_END);
+    CHECK_EQ(got.sx[35].frame, 35U);
+
+    /* Antidatage au débit DIN : dernier octet à 1000, le premier 3 octets plus tôt. */
+    static const uint8_t dated[] = { 0xF8, 0x90, 0x3C, 0x64 };
+    log_clear(&got);
+    midi_parser_init(&p, MIDI_PORT_DIN, on_msg, on_sysex, &got);
+    midi_parser_feed(&p, dated, sizeof(dated), 1000U, MIDI_PARSER_BYTE_FRAMES_Q8);
+    CHECK_EQ(got.n_msgs, 2U);
+    expect_msg(0U, 0xF8, 0x00, 0x00,
+               1000U - (uint32_t)((3UL * MIDI_PARSER_BYTE_FRAMES_Q8) >> 8));
+    expect_msg(1U, 0x90, 0x3C, 0x64, 1000U);
+
+    /* Reset : le running status et le SysEx en cours sont oubliés. */
+    static const uint8_t before[] = { 0x90, 0x3C };
+    static const uint8_t after[] = { 0x64, 0x3C, 0x64 };
+    feed_all(&p, before, sizeof(before), 1U);
+    midi_parser_reset(&p);
+    midi_parser_feed(&p, after, sizeof(after), 4U, 256U);
+    CHECK_EQ(got.n_msgs, 0U);
+    CHECK_EQ(p.stats.stray_bytes, 3U);
+
+    printf("flux enregistrés : ok\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* Fuzz                                                                       */
+/* -------------------------------------------------------------------------- */
+
+/* Octet aléatoire biaisé vers des flux plausibles (données, canaux, SysEx). */
+static uint8_t fuzz_byte(uint32_t *rng) {
+    const uint32_t r = host_rand(rng);
+    const uint32_t kind = r % 100U;
+    const uint8_t low = (uint8_t)(r >> 8);
+
+    if (kind < 55U) {
+        return (uint8_t)(low & 0x7FU);
+    }
+    if (kind < 75U) {
+        return (uint8_t)(0x80U | (low & 0x6FU));
+    }
+    if (kind < 82U) {
+        return 0xF0U;
+    }
+    if (kind < 88U) {
+        return 0xF7U;
+    }
+    return (uint8_t)(0xF0U | (low & 0x0FU));
+}
+
+static void fuzz_streams(uint32_t seed, uint32_t streams) {
+    static uint8_t stream[FUZZ_STREAM_BYTES];
+    midi_parser_t p;
+    ref_t r;
+    uint64_t bytes = 0U;
+    uint64_t messages = 0U;
+
+    uint32_t rng = seed;
+    for (uint32_t s = 0U; s < streams; ++s) {
+        /* Longueur et densité de SysEx variables d'un flux à l'autre. */
+        const uint32_t len = 1U + (host_rand(&rng) % FUZZ_STREAM_BYTES);
+        const bool long_sysex = (host_rand(&rng) & 3U) == 0U;
+        for (uint32_t i = 0U; i < len; ++i) {
+            stream[i] = fuzz_byte(&rng);
+            if (long_sysex && (stream[i] >= 0x80U) && (stream[i] != 0xF0U) &&
+                ((host_rand(&rng) & 7U) != 0U)) {
+                stream[i] &= 0x7FU;
+            }
+        }
+
+        log_clear(&want);
+        memset(&r, 0, sizeof(r));
+        for (uint32_t i = 0U; i < len; ++i) {
+            ref_byte(&r, &want, stream[i], i);
+        }
+
+        log_clear(&got);
+        midi_parser_init(&p, MIDI_PORT_USB, on_msg, on_sysex, &got);
+        uint32_t pos = 0U;
+        while (pos < len) {
+            uint32_t n = 1U + (host_rand(&rng) % FUZZ_MAX_CHUNK);
+            if (n > (len - pos)) {
+                n = len - pos;
+            }
+            /* Dernier octet du paquet daté de son index global. */
+            midi_parser_feed(&p, &stream[pos], n, pos + n - 1U, 256U);
+            check_bounds(&p);
+            pos += n;
+        }
+
+        /* Un SysEx resté ouvert est clos pour comparer les journaux. */
+        if (r.sysex) {
+            const uint8_t end = MIDI_SYSEX_END;
+            ref_byte(&r, &want, end, len);
+            midi_parser_feed(&p, &end, 1U, len, 256U);
+            check_bounds(&p);
+        }
+
+        check_same(&got, &want);
+        check_stats(&p.stats, &r.stats);
+        bytes += len;
+        messages += got.n_msgs;
+    }
+    printf("fuzz : %u flux, %llu octets, %llu messages, graine 0x%08X : ok\n",
+           streams, (unsigned long long)bytes, (unsigned long long)messages, seed);
+}
+
+/* Messages aléatoires -> midi_tx_encode -> analyseur : identité. */
+static void fuzz_roundtrip(uint32_t seed) {
+    static uint8_t wire[3U * 4096U];
+    static midi_msg_t sent[4096];
+    midi_tx_state_t tx;
+    midi_parser_t p;
+    size_t n = 0U;
+
+    uint32_t rng = seed ^ 0xA5A5A5A5U;
+    midi_tx_reset(&tx);
+    for (uint32_t i = 0U; i < 4096U; ++i) {
+        const uint32_t r = host_rand(&rng);
+        midi_msg_t *m = &sent[i];
+        static const uint8_t others[] = { 0xF1, 0xF2, 0xF3, 0xF6, 0xF8, 0xFA, 0xFB, 0xFC, 0xFE, 0xFF };
+        if ((r & 7U) == 0U) {
+            m->status = others[(r >> 3) % sizeof(others)];
+        } else {
+            /* Peu de statuts distincts : le running status sert souvent. */
+            m->status = (uint8_t)(0x80U | (((r >> 3) % 7U) << 4) | ((r >> 24) & 0x1U));
+        }
+        const uint8_t dl = midi_data_length(m->status);
+        m->data[0] = (dl > 0U) ? (uint8_t)((r >> 8) & 0x7FU) : 0U;
+        m->data[1] = (dl > 1U) ? (uint8_t)((r >> 16) & 0x7FU) : 0U;
+        m->port = MIDI_PORT_DIN;
+        n += midi_tx_encode(&tx, m, &wire[n]);
+    }
+
+    log_clear(&got);
+    midi_parser_init(&p, MIDI_PORT_DIN, on_msg, on_sysex, &got);
+    midi_parser_feed(&p, wire, n, 0U, 0U);
+    CHECK_EQ(got.n_msgs, 4096U);
+    for (uint32_t i = 0U; i < 4096U; ++i) {
+        CHECK_EQ(got.msgs[i].status, sent[i].status);
+        CHECK_EQ(got.msgs[i].data[0], sent[i].data[0]);
+        CHECK_EQ(got.msgs[i].data[1], sent[i].data[1]);
+    }
+    CHECK_EQ(p.stats.stray_bytes, 0U);
+    printf("aller-retour midi_tx_encode : 4096 messages en %zu octets : ok\n", n);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Débit                                                                      */
+/* -------------------------------------------------------------------------- */
+
+static uint32_t bench_count;
+
+static void bench_msg(void *ctx, const midi_msg_t *msg) {
+    (void)ctx;
+    bench_count += msg->status;
+}
+
+static void bench_sysex(void *ctx, const uint8_t *data, size_t len, uint8_t flags, uint32_t frame) {
+    (void)ctx;
+    (void)data;
+    (void)flags;
+    (void)frame;
+    bench_count += (uint32_t)len;
+}
+
+static void bench(uint32_t seed) {
+    static uint8_t stream[BENCH_BYTES];
+    midi_tx_state_t tx;
+    midi_parser_t p;
+
+    /* Flux réaliste : notes et CC en running status, horloge, un SysEx de temps en temps. */
+    uint32_t rng = seed ^ 0x5A5A5A5AU;
+    size_t n = 0U;
+    midi_tx_reset(&tx);
+    while ((n + 40U) < BENCH_BYTES) {
+        const uint32_t r = host_rand(&rng);
+        if ((r % 97U) == 0U) {
+            stream[n++] = MIDI_SYSEX_START;
+            for (uint32_t i = 0U; i < 32U; ++i) {
+                stream[n++] = (uint8_t)((r >> (i & 15U)) & 0x7FU);
+            }
+            stream[n++] = MIDI_SYSEX_END;
+            midi_tx_reset(&tx);
+            continue;
+        }
+        midi_msg_t m;
+        m.status = ((r & 15U) == 0U) ? MIDI_CLOCK
+                 : (uint8_t)((((r >> 4) & 1U) != 0U) ? MIDI_NOTE_ON : MIDI_CONTROL_CHANGE);
+        m.data[0] = (uint8_t)((r >> 8) & 0x7FU);
+        m.data[1] = (uint8_t)((r >> 16) & 0x7FU);
+        n += midi_tx_encode(&tx, &m, &stream[n]);
+    }
+
+    midi_parser_init(&p, MIDI_PORT_DIN, bench_msg, bench_sysex, NULL);
+    const double t0 = host_now();
+    for (uint32_t pass = 0U; pass < 4U; ++pass) {
+        for (size_t pos = 0U; pos < n; pos += FUZZ_MAX_CHUNK) {
+            const size_t len = ((n - pos) < FUZZ_MAX_CHUNK) ? (n - pos) : FUZZ_MAX_CHUNK;
+            midi_parser_feed(&p, &stream[pos], len, (uint32_t)pos,
+                             MIDI_PARSER_BYTE_FRAMES_Q8);
+        }
+    }
+    const double dt = host_now() - t0;
+    const double bps = (4.0 * (double)n) / dt;
+
+    printf("débit : %.1f Mo/s (%u messages, %.0f x une ligne DIN) [%u]\n",
+           bps / 1e6, p.stats.messages, bps / 3125.0, bench_count & 1U);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : FUZZ_DEFAULT_SEED;
+    const uint32_t streams = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : FUZZ_DEFAULT_STREAMS;
+
+    CHECK(seed != 0U);
+    recorded_streams();
+    fuzz_streams(seed, streams);
+    fuzz_roundtrip(seed);
+    bench(seed);
+    return 0;
+}
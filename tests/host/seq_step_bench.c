@@ -0,0 +1,129 @@
+/**
+ * @file seq_step_bench.c
+ * @brief Pire cas de l'avance de step (seq_engine_benchmark) sur hôte, en ns par step.
+ * @details seq_engine.c tourne tel quel sur les noyau et HAL réduits
+ * (chibios/) : seq_engine_benchmark joue 16 pistes × 4 trigs actifs, toutes
+ * conditions armées, un verrou par step, et mesure chaque step avec chTM
+ * (compteur de cycles suivant l'horloge monotone de l'hôte, voir
+ * chibios/ch.h).
+ *
+ * Vérifié : refus pendant la lecture ; après la mesure, pattern, position,
+ * callbacks et statistiques de l'application intacts (aucun évènement ni
+ * verrou ne lui parvient).
+ *
+ * Sur hôte, chSysLock ne masque rien : le pire absolu comprend les
+ * préemptions du système. La mesure est donc faite par lots de BATCH_STEPS
+ * et le pire retenu est la médiane des pires de lot ; sont aussi affichés
+ * le meilleur step, le pire absolu et le coût moyen (chronométré autour
+ * des appels, lecture de l'horloge comprise).
+ *
+ * Usage : seq_step_bench [lots]
+ */
+
+#include "host_check.h"
+#include "seq_engine.h"
+
+#include <string.h>
+
+#define BATCHES               2001U
+#define BATCH_STEPS           100U
+#define CYCLES_PER_NS         (HOST_REALTIME_FREQUENCY / 1000000000.0)
+
+static seq_track_t tracks[BRICK_NUM_TRACKS];
+static seq_pattern_t pattern;
+static uint32_t app_events;
+static uint32_t app_plocks;
+
+static void app_event(const seq_event_t *ev) {
+    (void)ev;
+    app_events++;
+}
+
+static void app_plock(uint8_t track, uint8_t channel, const seq_plock_t *locks, uint8_t count) {
+    (void)track;
+    (void)channel;
+    (void)locks;
+    (void)count;
+    app_plocks++;
+}
+
+static rtcnt_t batch_worst[BATCHES];
+
+static double to_ns(rtcnt_t cycles) {
+    return (double)cycles / CYCLES_PER_NS;
+}
+
+static int cmp_cycles(const void *a, const void *b) {
+    const rtcnt_t x = *(const rtcnt_t *)a;
+    const rtcnt_t y = *(const rtcnt_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t batches = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : BATCHES;
+    seq_step_stats_t st;
+    seq_step_stats_t app_st;
+
+    CHECK((batches > 0U) && (batches <= BATCHES));
+    seq_engine_init();
+    seq_engine_set_event_cb(app_event);
+    seq_engine_set_plock_cb(app_plock);
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        seq_track_clear(&tracks[t]);
+        tracks[t].length = SEQ_STEPS_PER_BAR;
+    }
+    seq_pattern_bind(&pattern, tracks, 7U);
+    pattern.length = SEQ_STEPS_PER_BAR;
+    tracks[0].steps[0].trigs[0] = (seq_trig_t){ 36U, 100U, 1U, SEQ_TRIG_ACTIVE, SEQ_COND_NONE, 0U };
+    seq_engine_set_pattern(&pattern);
+
+    /* Quelques steps joués : la mesure doit rendre la position telle quelle. */
+    seq_engine_start();
+    CHECK(!seq_engine_benchmark(BATCH_STEPS, &st));
+    for (uint32_t b = 0U; b < 1000U; ++b) {
+        seq_engine_process_block(BRICK_AUDIO_FRAME_SAMPLES);
+    }
+    seq_engine_stop();
+    const uint32_t tick = seq_engine_get_tick();
+    const uint32_t pattern_tick = seq_engine_get_pattern_tick();
+    const uint32_t events = app_events;
+    seq_engine_get_step_stats(&app_st);
+    CHECK(tick > 0U);
+    CHECK(events > 0U);
+
+    rtcnt_t best = (rtcnt_t)-1;
+    rtcnt_t worst = 0U;
+    const double t0 = host_now();
+    for (uint32_t b = 0U; b < batches; ++b) {
+        CHECK(seq_engine_benchmark(BATCH_STEPS, &st));
+        CHECK_EQ(st.steps, BATCH_STEPS);
+        CHECK(st.best_cycles <= st.worst_cycles);
+        batch_worst[b] = st.worst_cycles;
+        best = (st.best_cycles < best) ? st.best_cycles : best;
+        worst = (st.worst_cycles > worst) ? st.worst_cycles : worst;
+    }
+    const double dt = host_now() - t0;
+    qsort(batch_worst, batches, sizeof(batch_worst[0]), cmp_cycles);
+
+    CHECK(seq_engine_get_pattern() == &pattern);
+    CHECK_EQ(seq_engine_get_tick(), tick);
+    CHECK_EQ(seq_engine_get_pattern_tick(), pattern_tick);
+    CHECK_EQ(app_events, events);
+    CHECK_EQ(app_plocks, 0U);
+    CHECK(!seq_engine_is_playing());
+    CHECK(!seq_engine_get_fill());
+
+    seq_step_stats_t after;
+    seq_engine_get_step_stats(&after);
+    CHECK_EQ(after.steps, app_st.steps);
+    CHECK_EQ(after.worst_cycles, app_st.worst_cycles);
+    printf("refus en lecture, état du séquenceur restauré : ok\n");
+
+    printf("pire cas (%u pistes × %u trigs, conditions, verrous), %u × %u steps :\n",
+           BRICK_NUM_TRACKS, BRICK_MAX_TRIGS_PER_STEP, batches, BATCH_STEPS);
+    printf("  pire %.0f ns par step (médiane des lots), meilleur %.0f ns, moyen %.0f ns, "
+           "pire absolu %.0f ns (préemptions de l'hôte comprises)\n",
+           to_ns(batch_worst[batches / 2U]), to_ns(best),
+           (dt * 1e9) / ((double)batches * BATCH_STEPS), to_ns(worst));
+    return 0;
+}
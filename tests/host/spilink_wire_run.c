@@ -0,0 +1,297 @@
+/**
+ * @file spilink_wire_run.c
+ * @brief Aller-retour des formats SPI-LINK (S24, S16) et marge d'horloge SPI par cartouche.
+ * @details spilink_wire.c compilé tel quel (saturation C à la place de
+ * SSAT sur hôte). Vérifié pour chaque format :
+ *  - octets du fil, gros-boutistes, comparés à un codage de référence
+ *    écrit octet par octet ;
+ *  - S24 : aller-retour exact sur [-2^23, 2^23 - 1], saturation au-delà
+ *    (jusqu'à INT32_MIN / INT32_MAX) ;
+ *  - S16 : arrondi au plus proche (moitié vers le haut) des bits 23..8,
+ *    saturé aux bornes : erreur d'au plus un demi-pas, sauf au sommet de
+ *    l'échelle où l'arrondi est rabattu sur 0x7FFF00 ;
+ *  - bloc [frames][canaux] d'une cartouche relu depuis la ligne
+ *    spilink_audio_block_t, sans toucher aux cartouches voisines.
+ *
+ * Marge : pour chaque bus, l'horloge est choisie comme dans
+ * drv_spilink_init (horloges noyau de mcuconf.h) ; sont rapportés la durée
+ * d'une trame sur le fil, la part du bloc de 333 µs, la marge restante et
+ * l'horloge minimale, face aux int32_t bruts. Le coût des noyaux (pack +
+ * unpack d'une trame) est mesuré sur l'hôte ; sur la cible, la durée
+ * d'échange mesurée est publiée par drv_spilink_get_stats (xfer_us_max).
+ *
+ * Usage : spilink_wire_run [graine]
+ */
+
+#include "host_check.h"
+#include "drv_spilink.h"
+
+#include <string.h>
+
+#define DEFAULT_SEED          0x53504931U
+#define RANDOM_ROUNDS         20000U
+#define BENCH_ROUNDS          200000U
+
+#define S24_MAX               0x7FFFFF
+#define S24_MIN               (-0x800000)
+
+/* Horloges noyau des bus (mcuconf.h) : SPI1..3 sur PLL1_Q, SPI6 sur PCLK4. */
+static const uint32_t bus_kernel_hz[SPILINK_NUM_CARTS] = {
+    50000000U, 50000000U, 50000000U, 100000000U
+};
+static const char *const bus_name[SPILINK_NUM_CARTS] = { "SPI1", "SPI2", "SPI3", "SPI6" };
+static const char *const fmt_name[SPILINK_FORMAT_COUNT] = { "S24", "S16" };
+
+static int32_t sat(int64_t x, int32_t lo, int32_t hi) {
+    return (x < lo) ? lo : ((x > hi) ? hi : (int32_t)x);
+}
+
+/* Valeur relue attendue, d'après la description du format. */
+static int32_t expected(spilink_format_t fmt, int32_t x) {
+    const int32_t s24 = sat(x, S24_MIN, S24_MAX);
+
+    if (fmt == SPILINK_FORMAT_S24) {
+        return s24;
+    }
+    /* floor((x + 128) / 256) : arrondi au plus proche, moitié vers le haut. */
+    const int64_t q = ((int64_t)s24 + 128) >> 8;
+    return sat(q, -0x8000, 0x7FFF) * 256;
+}
+
+/* Codage de référence : gros-boutiste, octet par octet. */
+static size_t ref_pack(spilink_format_t fmt, uint8_t *wire, const int32_t *src, size_t samples) {
+    size_t n = 0U;
+
+    for (size_t i = 0U; i < samples; ++i) {
+        const uint32_t v = (uint32_t)expected(fmt, src[i]);
+        wire[n++] = (uint8_t)(v >> 16);
+        wire[n++] = (uint8_t)(v >> 8);
+        if (fmt == SPILINK_FORMAT_S24) {
+            wire[n++] = (uint8_t)v;
+        }
+    }
+    return n;
+}
+
+/* Pack, comparaison au codage de référence, unpack et comparaison aux valeurs attendues. */
+static void round_trip(spilink_format_t fmt, const int32_t *src, size_t samples) {
+    static uint8_t wire[SPILINK_WIRE_BYTES_S24(SPILINK_SAMPLES) + 4U] __attribute__((aligned(4)));
+    static uint8_t ref[SPILINK_WIRE_BYTES_S24(SPILINK_SAMPLES)];
+    static int32_t dst[SPILINK_SAMPLES + 1U];
+
+    const size_t bytes = spilink_wire_bytes(fmt, samples);
+    memset(wire, 0xA5, sizeof(wire));
+    CHECK_EQ(spilink_wire_pack(fmt, wire, src, samples), bytes);
+    CHECK_EQ(ref_pack(fmt, ref, src, samples), bytes);
+    CHECK(memcmp(wire, ref, bytes) == 0);
+    CHECK_EQ(wire[bytes], 0xA5U);
+
+    dst[samples] = 0x5A5A5A5A;
+    CHECK_EQ(spilink_wire_unpack(fmt, dst, wire, samples), bytes);
+    for (size_t i = 0U; i < samples; ++i) {
+        CHECK_EQ(dst[i], expected(fmt, src[i]));
+    }
+    CHECK_EQ(dst[samples], 0x5A5A5A5A);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Aller-retour                                                               */
+/* -------------------------------------------------------------------------- */
+
+static const int32_t limits[] = {
+    0, 1, -1, 0x7F, 0x80, -0x80, -0x81, 0xFF, 0x100, -0x100, -0x101,
+    S24_MAX, S24_MAX - 1, S24_MIN, S24_MIN + 1, S24_MAX + 1, S24_MIN - 1,
+    0x7FFF7F, 0x7FFF80, 0x7FFEFF, 0x7FFE80, -0x7FFF80, -0x7FFF81, -0x7FFF7F,
+    INT32_MAX, INT32_MIN, INT32_MAX - 0x80, INT32_MIN + 0x80, 0x01000000, -0x01000000,
+};
+
+static void test_limits(void) {
+    int32_t src[SPILINK_SAMPLES];
+    const size_t n_limits = sizeof(limits) / sizeof(limits[0]);
+
+    /* Chaque borne à chaque position d'un groupe de quatre. */
+    for (size_t k = 0U; k < n_limits; ++k) {
+        for (size_t pos = 0U; pos < 4U; ++pos) {
+            for (size_t i = 0U; i < 8U; ++i) {
+                src[i] = (i == pos) ? limits[k] : limits[(k + i + 1U) % n_limits];
+            }
+            round_trip(SPILINK_FORMAT_S24, src, 8U);
+            round_trip(SPILINK_FORMAT_S16, src, 8U);
+        }
+    }
+
+    /* Points fixés : saturation à ±2^23, arrondi S16 au sommet et au pied de l'échelle. */
+    static const int32_t fixed[][3] = {
+        /* entrée, S24, S16 */
+        { S24_MAX + 1,  S24_MAX,     0x7FFF00 },
+        { INT32_MAX,    S24_MAX,     0x7FFF00 },
+        { S24_MIN - 1,  S24_MIN,     S24_MIN },
+        { INT32_MIN,    S24_MIN,     S24_MIN },
+        { S24_MAX,      S24_MAX,     0x7FFF00 },   /* Arrondi à 0x8000 rabattu. */
+        { 0x7FFF7F,     0x7FFF7F,    0x7FFF00 },
+        { 0x7FFE80,     0x7FFE80,    0x7FFF00 },   /* Moitié : vers le haut. */
+        { 0x7FFE7F,     0x7FFE7F,    0x7FFE00 },
+        { -0x7FFF80,    -0x7FFF80,   -0x7FFF00 },
+        { -0x7FFF81,    -0x7FFF81,   S24_MIN },
+        { S24_MIN,      S24_MIN,     S24_MIN },
+        { 0x80,         0x80,        0x100 },
+        { 0x7F,         0x7F,        0 },
+        { -0x80,        -0x80,       0 },
+        { -0x81,        -0x81,       -0x100 },
+    };
+    for (size_t k = 0U; k < (sizeof(fixed) / sizeof(fixed[0])); ++k) {
+        int32_t in[4] = { fixed[k][0], 0, 0, fixed[k][0] };
+        int32_t out[4];
+        uint8_t wire[12] __attribute__((aligned(4)));
+
+        (void)spilink_wire_pack(SPILINK_FORMAT_S24, wire, in, 4U);
+        (void)spilink_wire_unpack(SPILINK_FORMAT_S24, out, wire, 4U);
+        CHECK_EQ(out[0], fixed[k][1]);
+        CHECK_EQ(out[3], fixed[k][1]);
+        (void)spilink_wire_pack(SPILINK_FORMAT_S16, wire, in, 4U);
+        (void)spilink_wire_unpack(SPILINK_FORMAT_S16, out, wire, 4U);
+        CHECK_EQ(out[0], fixed[k][2]);
+        CHECK_EQ(out[3], fixed[k][2]);
+    }
+    printf("bornes : saturation à ±2^23, arrondi S16 aux limites, octets du fil : ok\n");
+}
+
+static void test_random(uint32_t seed) {
+    int32_t src[SPILINK_SAMPLES];
+    int32_t dst[SPILINK_SAMPLES];
+    uint8_t wire[SPILINK_WIRE_BYTES_S24(SPILINK_SAMPLES)] __attribute__((aligned(4)));
+    int32_t err_max = 0;
+
+    for (uint32_t r = 0U; r < RANDOM_ROUNDS; ++r) {
+        /* Trois rondes sur quatre dans l'échelle 24 bits, une au-delà. */
+        const bool wide = ((r & 3U) == 3U);
+        for (size_t i = 0U; i < SPILINK_SAMPLES; ++i) {
+            const uint32_t x = host_rand(&seed);
+            src[i] = wide ? (int32_t)x : ((int32_t)(x << 8) >> 8);
+        }
+        round_trip(SPILINK_FORMAT_S24, src, SPILINK_SAMPLES);
+        round_trip(SPILINK_FORMAT_S16, src, SPILINK_SAMPLES);
+
+        if (!wide) {
+            (void)spilink_wire_pack(SPILINK_FORMAT_S16, wire, src, SPILINK_SAMPLES);
+            (void)spilink_wire_unpack(SPILINK_FORMAT_S16, dst, wire, SPILINK_SAMPLES);
+            for (size_t i = 0U; i < SPILINK_SAMPLES; ++i) {
+                const int32_t e = (dst[i] > src[i]) ? (dst[i] - src[i]) : (src[i] - dst[i]);
+                /* Demi-pas, sauf rabattement au sommet (au plus un pas). */
+                CHECK((e <= 128) || ((src[i] > 0x7FFF00) && (e < 256)));
+                err_max = ((src[i] <= 0x7FFF00) && (e > err_max)) ? e : err_max;
+            }
+        }
+    }
+    CHECK_EQ(err_max, 128);
+    printf("aléatoire : %u trames de %u échantillons par format, S24 exact, "
+           "S16 à ±%d (demi-pas de 2^8) : ok\n", RANDOM_ROUNDS, SPILINK_SAMPLES, err_max);
+}
+
+/* Une cartouche écrite depuis / dans sa ligne du bloc, les autres intactes. */
+static void test_block(uint32_t seed) {
+    static spilink_audio_block_t in;
+    static spilink_audio_block_t out;
+    uint8_t wire[SPILINK_WIRE_BYTES_S24(SPILINK_SAMPLES)] __attribute__((aligned(4)));
+
+    for (uint8_t f = 0U; f < (uint8_t)SPILINK_FORMAT_COUNT; ++f) {
+        const spilink_format_t fmt = (spilink_format_t)f;
+        for (size_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+            int32_t *row = &in[c][0][0];
+            for (size_t i = 0U; i < SPILINK_SAMPLES; ++i) {
+                row[i] = (int32_t)(host_rand(&seed) << 8) >> 8;
+            }
+            memset(out, 0x5A, sizeof(out));
+            (void)spilink_wire_pack(fmt, wire, row, SPILINK_SAMPLES);
+            (void)spilink_wire_unpack(fmt, &out[c][0][0], wire, SPILINK_SAMPLES);
+
+            for (size_t k = 0U; k < SPILINK_NUM_CARTS; ++k) {
+                for (size_t fr = 0U; fr < BRICK_AUDIO_FRAME_SAMPLES; ++fr) {
+                    for (size_t ch = 0U; ch < SPILINK_CHANNELS; ++ch) {
+                        CHECK_EQ(out[k][fr][ch], (k == c) ? expected(fmt, in[c][fr][ch]) : 0x5A5A5A5A);
+                    }
+                }
+            }
+        }
+    }
+    printf("bloc [cartouche][frame][canal] : ligne de la cartouche seule, dans les deux formats : ok\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* Marge d'horloge                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Coût hôte d'une trame : pack puis unpack, en ns. */
+static double bench_kernels(spilink_format_t fmt) {
+    static int32_t src[SPILINK_SAMPLES];
+    static int32_t dst[SPILINK_SAMPLES];
+    static uint8_t wire[SPILINK_WIRE_BYTES_S24(SPILINK_SAMPLES)] __attribute__((aligned(4)));
+    uint32_t seed = DEFAULT_SEED;
+    volatile int32_t sink = 0;
+
+    for (size_t i = 0U; i < SPILINK_SAMPLES; ++i) {
+        src[i] = (int32_t)(host_rand(&seed) << 8) >> 8;
+    }
+    const double t0 = host_now();
+    for (uint32_t r = 0U; r < BENCH_ROUNDS; ++r) {
+        src[r % SPILINK_SAMPLES] ^= (int32_t)(r & 0xFFU);
+        (void)spilink_wire_pack(fmt, wire, src, SPILINK_SAMPLES);
+        (void)spilink_wire_unpack(fmt, dst, wire, SPILINK_SAMPLES);
+        sink += dst[r % SPILINK_SAMPLES];
+    }
+    (void)sink;
+    return ((host_now() - t0) * 1e9) / (double)BENCH_ROUNDS;
+}
+
+static void report_headroom(void) {
+    const double block_us = 1e6 / (double)SPILINK_BLOCKS_PER_S;
+    const uint32_t raw_bytes = SPILINK_HDR_BYTES + (SPILINK_SAMPLES * 4U) + SPILINK_CRC_BYTES;
+
+    double kernel_ns[SPILINK_FORMAT_COUNT];
+    for (uint8_t f = 0U; f < (uint8_t)SPILINK_FORMAT_COUNT; ++f) {
+        kernel_ns[f] = bench_kernels((spilink_format_t)f);
+    }
+
+    printf("marge par cartouche (bloc de %.1f µs, %u blocs/s) :\n", block_us, SPILINK_BLOCKS_PER_S);
+    for (uint8_t c = 0U; c < SPILINK_NUM_CARTS; ++c) {
+        /* Même choix de prescaler que drv_spilink_init. */
+        uint32_t mbr = 0U;
+        while ((mbr < 7U) && ((bus_kernel_hz[c] >> (mbr + 1U)) > SPILINK_CLOCK_HZ)) {
+            mbr++;
+        }
+        const uint32_t clock = bus_kernel_hz[c] >> (mbr + 1U);
+        CHECK(clock <= SPILINK_CLOCK_HZ);
+
+        const double raw_us = ((double)raw_bytes * 8.0 * 1e6) / (double)clock;
+        const double raw_hz = (double)raw_bytes * 8.0 * (double)SPILINK_BLOCKS_PER_S;
+        printf("  cartouche %u (%s, %.1f MHz) : int32_t bruts %u octets, %.1f µs, marge %.1f µs, "
+               "horloge min. %.2f MHz (×%.2f de marge)\n",
+               c, bus_name[c], (double)clock * 1e-6, raw_bytes, raw_us, block_us - raw_us,
+               raw_hz * 1e-6, (double)clock / raw_hz);
+
+        for (uint8_t f = 0U; f < (uint8_t)SPILINK_FORMAT_COUNT; ++f) {
+            const uint32_t bytes = (uint32_t)spilink_frame_bytes((spilink_format_t)f);
+            const double wire_us = ((double)bytes * 8.0 * 1e6) / (double)clock;
+            const double min_hz = (double)bytes * 8.0 * (double)SPILINK_BLOCKS_PER_S;
+            CHECK(bytes < raw_bytes);
+            CHECK(wire_us < block_us);
+            printf("    %s : %u octets, %.1f µs (%.0f %% du bloc), marge %.1f µs (+%.1f µs), "
+                   "horloge min. %.2f MHz (×%.2f de marge)\n",
+                   fmt_name[f], bytes, wire_us, (wire_us * 100.0) / block_us, block_us - wire_us,
+                   raw_us - wire_us, min_hz * 1e-6, (double)clock / min_hz);
+        }
+    }
+    printf("  noyaux pack + unpack d'une trame (hôte) : S24 %.0f ns, S16 %.0f ns\n",
+           kernel_ns[SPILINK_FORMAT_S24], kernel_ns[SPILINK_FORMAT_S16]);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : DEFAULT_SEED;
+
+    CHECK(seed != 0U);
+    test_limits();
+    test_random(seed);
+    test_block(seed);
+    report_headroom();
+    return 0;
+}
@@ -0,0 +1,566 @@
+/**
+ * @file usb_midi_run.c
+ * @brief Paquets USB-MIDI, découpage SysEx et file d'émission face à un endpoint IN simulé.
+ * @details Trois volets :
+ *  - paquets : usb_midi_pack sur tous les statuts (CIN, câble, masquage
+ *    des données, refus de F0/F7), relus avec usb_midi_cin_length ;
+ *  - SysEx : flux découpés en fragments aléatoires (un fragment par appel
+ *    de l'émetteur), comparés au découpage de la norme ; F0 arrivant en
+ *    milieu de paquet ;
+ *  - file d'émission : usb_midi_txq put/start/done face à un endpoint IN
+ *    bulk pleine vitesse simulé, avec la politique de usb_midi_send
+ *    (réserve temps réel) et de usb_midi_send_sysex (attente de place).
+ *    Chaque paquet reçu par l'hôte est comparé, dans l'ordre, à celui mis
+ *    en file ; le tampon en transfert ne doit pas bouger avant sa fin.
+ *    Sont mesurés le débit à saturation et la latence (mise en file -> fin
+ *    du transfert) sous une charge de séquenceur, l'hôte interrogeant
+ *    l'endpoint une fois par trame de 1 ms ou en continu.
+ *
+ * Usage : usb_midi_run [graine]
+ */
+
+#include "host_check.h"
+#include "usb_midi_packet.h"
+
+#include <math.h>
+#include <string.h>
+
+#define DEFAULT_SEED          0x55534221U
+#define SYSEX_STREAMS         2000U
+#define SYSEX_MAX_LEN         300U
+
+/* Politique de usb_midi.c (usb_midi.h dépend de la pile USB). */
+#define TX_RT_RESERVE         2U
+#define CABLE                 0U
+
+/* Bus pleine vitesse : 12 Mbit/s, bourrage de bits ignoré. */
+#define FS_BYTE_NS            (8.0e9 / 12.0e6)
+/* Jeton IN, PID et CRC de données, handshake, synchro et EOP. */
+#define FS_XFER_OVERHEAD      13U
+#define FS_FRAME_NS           1.0e6
+
+/* Charge du séquenceur : 120 BPM, blocs audio de 16 frames à 48 kHz. */
+#define SIM_RATE              48000U
+#define SIM_BLOCK_FRAMES      16U
+#define SIM_CLOCK_FRAMES      1000U     /* 24 PPQN à 120 BPM. */
+#define SIM_STEP_FRAMES       6000U     /* Double croche à 120 BPM. */
+#define SIM_NOTES_PER_STEP    6U
+#define SIM_SYSEX_EVERY       (2U * SIM_RATE)
+#define SIM_SYSEX_LEN         1024U
+#define SIM_SECONDS           10U
+
+#define RING_SIZE             64U       /* > deux tampons de paquets. */
+
+/* -------------------------------------------------------------------------- */
+/* Paquets                                                                    */
+/* -------------------------------------------------------------------------- */
+
+/* CIN attendu d'après la norme USB-MIDI 1.0 (0 : statut refusé). */
+static uint8_t expected_cin(uint8_t status) {
+    if (status < 0xF0U) {
+        return (uint8_t)(status >> 4);
+    }
+    switch (status) {
+    case MIDI_SYSEX_START:
+    case MIDI_SYSEX_END:
+        return 0U;
+    case MIDI_MTC_QUARTER:
+    case MIDI_SONG_SELECT:
+        return USB_MIDI_CIN_SYSCOM_2;
+    case MIDI_SONG_POSITION:
+        return USB_MIDI_CIN_SYSCOM_3;
+    default:
+        return (status >= 0xF8U) ? USB_MIDI_CIN_SINGLE_BYTE : USB_MIDI_CIN_SYSEX_END_1;
+    }
+}
+
+static void test_pack(void) {
+    for (uint32_t s = 0x80U; s <= 0xFFU; ++s) {
+        for (uint8_t cable = 0U; cable < 16U; cable = (uint8_t)(cable + 15U)) {
+            const midi_msg_t msg = { 0U, (uint8_t)s, { 0xD5U, 0xAAU }, MIDI_PORT_INTERNAL };
+            uint8_t pkt[USB_MIDI_PACKET_SIZE] = { 0xEEU, 0xEEU, 0xEEU, 0xEEU };
+            const uint8_t cin = expected_cin((uint8_t)s);
+
+            const bool ok = usb_midi_pack(&msg, cable, pkt);
+            CHECK_EQ(ok, cin != 0U);
+            if (!ok) {
+                continue;
+            }
+            const uint8_t n = usb_midi_cin_length(pkt[0]);
+            CHECK_EQ(pkt[0] & 0x0FU, cin);
+            CHECK_EQ(pkt[0] >> 4, cable);
+            CHECK_EQ(n, 1U + midi_data_length((uint8_t)s));
+            CHECK_EQ(pkt[1], s);
+            CHECK_EQ(pkt[2], (n > 1U) ? 0x55U : 0U);
+            CHECK_EQ(pkt[3], (n > 2U) ? 0x2AU : 0U);
+        }
+    }
+    printf("paquets : 128 statuts, CIN, câble, données masquées, F0/F7 refusés : ok\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* SysEx                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Découpage de la norme : groupes de trois, le dernier en CIN 5..7. */
+static size_t ref_sysex_packets(const uint8_t *data, size_t len, uint8_t *out) {
+    size_t n = 0U;
+
+    for (size_t i = 0U; i < len; i += 3U) {
+        const size_t r = ((len - i) < 3U) ? (len - i) : 3U;
+        const bool last = ((i + r) == len);
+        uint8_t *pkt = &out[n * USB_MIDI_PACKET_SIZE];
+        const uint8_t cin = last ? (uint8_t)(USB_MIDI_CIN_SYSEX_END_1 + (r - 1U))
+                                 : USB_MIDI_CIN_SYSEX_START;
+        pkt[0] = (uint8_t)((CABLE << 4) | cin);
+        pkt[1] = data[i];
+        pkt[2] = (r > 1U) ? data[i + 1U] : 0U;
+        pkt[3] = (r > 2U) ? data[i + 2U] : 0U;
+        n++;
+    }
+    return n;
+}
+
+/* Un fragment par appel, comme usb_midi_send_sysex. */
+static size_t pack_fragment(usb_midi_sysex_packer_t *sp, const uint8_t *data, size_t len,
+                            uint8_t *out) {
+    size_t n = 0U;
+
+    for (size_t i = 0U; i < len; ++i) {
+        if (usb_midi_sysex_packer_put(sp, data[i], CABLE, &out[n * USB_MIDI_PACKET_SIZE])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void make_sysex(uint8_t *msg, size_t len, uint32_t *seed) {
+    msg[0] = MIDI_SYSEX_START;
+    for (size_t i = 1U; (i + 1U) < len; ++i) {
+        msg[i] = (uint8_t)(host_rand(seed) & 0x7FU);
+    }
+    msg[len - 1U] = MIDI_SYSEX_END;
+}
+
+static void test_sysex(uint32_t seed) {
+    static uint8_t msg[SYSEX_MAX_LEN];
+    static uint8_t want[SYSEX_MAX_LEN * USB_MIDI_PACKET_SIZE];
+    static uint8_t got[SYSEX_MAX_LEN * USB_MIDI_PACKET_SIZE];
+    usb_midi_sysex_packer_t sp;
+    uint64_t packets = 0U;
+
+    /* Flux successifs, fragments aléatoires d'un octet à tout le message. */
+    usb_midi_sysex_packer_reset(&sp);
+    for (uint32_t k = 0U; k < SYSEX_STREAMS; ++k) {
+        const size_t len = 2U + (host_rand(&seed) % (SYSEX_MAX_LEN - 1U));
+        make_sysex(msg, len, &seed);
+        const size_t n_want = ref_sysex_packets(msg, len, want);
+
+        size_t n_got = 0U;
+        for (size_t i = 0U; i < len;) {
+            size_t frag = 1U + (host_rand(&seed) % len);
+            frag = (frag > (len - i)) ? (len - i) : frag;
+            n_got += pack_fragment(&sp, &msg[i], frag, &got[n_got * USB_MIDI_PACKET_SIZE]);
+            i += frag;
+        }
+        CHECK_EQ(n_got, n_want);
+        CHECK(memcmp(got, want, n_want * USB_MIDI_PACKET_SIZE) == 0);
+        CHECK_EQ(sp.n, 0U);
+        packets += n_got;
+    }
+    printf("SysEx : %u flux de 2 à %u octets en fragments aléatoires, %llu paquets conformes : ok\n",
+           SYSEX_STREAMS, SYSEX_MAX_LEN, (unsigned long long)packets);
+
+    /*
+     * F0 à chaque position d'un paquet : un paquet entamé est perdu, le
+     * nouveau SysEx repart sur un paquet neuf ; à une frontière de paquet
+     * rien n'est perdu (le SysEx précédent reste simplement sans F7).
+     */
+    static const uint8_t next[] = { MIDI_SYSEX_START, 0x01U, 0x02U, 0x03U, MIDI_SYSEX_END };
+    for (size_t head = 3U; head <= 5U; ++head) {
+        const uint8_t first[] = { MIDI_SYSEX_START, 0x10U, 0x11U, 0x12U, 0x13U };
+        usb_midi_sysex_packer_reset(&sp);
+
+        size_t n_got = pack_fragment(&sp, first, head, got);
+        CHECK_EQ(n_got, 1U);
+        CHECK_EQ(sp.n, head - 3U);
+        n_got += pack_fragment(&sp, next, sizeof(next), &got[USB_MIDI_PACKET_SIZE]);
+
+        const size_t n_want = ref_sysex_packets(next, sizeof(next), want);
+        CHECK_EQ(n_got, 1U + n_want);
+        CHECK(memcmp(got, (const uint8_t[]){ 0x04U, MIDI_SYSEX_START, 0x10U, 0x11U }, 4U) == 0);
+        CHECK(memcmp(&got[USB_MIDI_PACKET_SIZE], want, n_want * USB_MIDI_PACKET_SIZE) == 0);
+        CHECK_EQ(sp.n, 0U);
+    }
+
+    /* F0 F7 et F0 xx F7 : un seul paquet de fin. */
+    for (size_t len = 2U; len <= 3U; ++len) {
+        const uint8_t m[] = { MIDI_SYSEX_START, 0x7FU, MIDI_SYSEX_END };
+        const uint8_t *src = (len == 2U) ? (const uint8_t[]){ MIDI_SYSEX_START, MIDI_SYSEX_END } : m;
+        usb_midi_sysex_packer_reset(&sp);
+        CHECK_EQ(pack_fragment(&sp, src, len, got), 1U);
+        CHECK_EQ(got[0], USB_MIDI_CIN_SYSEX_END_1 + (len - 1U));
+        CHECK_EQ(usb_midi_cin_length(got[0]), len);
+    }
+    printf("SysEx : F0 en milieu de paquet (paquet entamé perdu), messages courts : ok\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* File d'émission                                                            */
+/* -------------------------------------------------------------------------- */
+
+static void fill_packets(uint8_t *pkts, size_t n, uint8_t tag) {
+    for (size_t i = 0U; i < n; ++i) {
+        uint8_t *p = &pkts[i * USB_MIDI_PACKET_SIZE];
+        p[0] = 0x09U;
+        p[1] = MIDI_NOTE_ON;
+        p[2] = tag;
+        p[3] = (uint8_t)i;
+    }
+}
+
+static void test_txq(void) {
+    uint8_t pkts[USB_MIDI_PACKETS_PER_TRANSFER * USB_MIDI_PACKET_SIZE];
+    usb_midi_txq_t q;
+    size_t len = 0U;
+
+    usb_midi_txq_init(&q);
+    CHECK_EQ(usb_midi_txq_room(&q), USB_MIDI_PACKETS_PER_TRANSFER);
+    CHECK(usb_midi_txq_start(&q, &len) == NULL);
+
+    /* Tampon plein : rien n'est ajouté, pas même en partie. */
+    fill_packets(pkts, USB_MIDI_PACKETS_PER_TRANSFER, 1U);
+    CHECK(usb_midi_txq_put(&q, pkts, 10U));
+    CHECK(!usb_midi_txq_put(&q, &pkts[10U * USB_MIDI_PACKET_SIZE], 7U));
+    CHECK_EQ(usb_midi_txq_room(&q), 6U);
+    CHECK(usb_midi_txq_put(&q, &pkts[10U * USB_MIDI_PACKET_SIZE], 6U));
+    CHECK_EQ(usb_midi_txq_room(&q), 0U);
+    CHECK(!usb_midi_txq_put(&q, pkts, 1U));
+
+    /* Un transfert emporte les 16 paquets ; l'autre tampon se remplit pendant ce temps. */
+    const uint8_t *a = usb_midi_txq_start(&q, &len);
+    CHECK(a != NULL);
+    CHECK_EQ(len, USB_MIDI_EP_SIZE);
+    CHECK(memcmp(a, pkts, USB_MIDI_EP_SIZE) == 0);
+    CHECK_EQ(usb_midi_txq_room(&q), USB_MIDI_PACKETS_PER_TRANSFER);
+    CHECK(usb_midi_txq_start(&q, &len) == NULL);
+
+    fill_packets(pkts, 3U, 2U);
+    CHECK(usb_midi_txq_put(&q, pkts, 3U));
+    CHECK(usb_midi_txq_start(&q, &len) == NULL);
+    CHECK_EQ(a[2], 1U);
+
+    usb_midi_txq_done(&q);
+    const uint8_t *b = usb_midi_txq_start(&q, &len);
+    CHECK(b != NULL);
+    CHECK(b != a);
+    CHECK_EQ(len, 3U * USB_MIDI_PACKET_SIZE);
+    CHECK(memcmp(b, pkts, len) == 0);
+
+    /* Le tampon rendu est réutilisé, vide. */
+    CHECK_EQ(usb_midi_txq_room(&q), USB_MIDI_PACKETS_PER_TRANSFER);
+    usb_midi_txq_done(&q);
+    CHECK(usb_midi_txq_start(&q, &len) == NULL);
+    CHECK(usb_midi_txq_put(&q, pkts, 1U));
+    CHECK(usb_midi_txq_start(&q, &len) == a);
+    CHECK_EQ(len, USB_MIDI_PACKET_SIZE);
+    printf("file : tampon plein refusé sans ajout partiel, bascule, transfert unique : ok\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* Endpoint IN simulé                                                         */
+/* -------------------------------------------------------------------------- */
+
+typedef enum {
+    PKT_CLOCK = 0,
+    PKT_NOTE,
+    PKT_SYSEX,
+    PKT_CLASSES
+} pkt_class_t;
+
+typedef struct {
+    uint8_t pkt[USB_MIDI_PACKET_SIZE];
+    double  t_put;
+    uint8_t cls;
+} ring_entry_t;
+
+typedef struct {
+    double   sum;
+    double   max;
+    uint64_t n;
+} lat_stats_t;
+
+typedef struct {
+    usb_midi_txq_t q;
+    double         poll_ns;       /* Période des jetons IN ; 0 : en continu. */
+
+    bool           in_flight;
+    double         done_at;
+    const uint8_t *buf;
+    size_t         len;
+    uint8_t        snapshot[USB_MIDI_EP_SIZE];
+
+    /* Paquets en file ou en transfert, dans l'ordre d'émission. */
+    ring_entry_t   ring[RING_SIZE];
+    uint32_t       ring_rd;
+    uint32_t       ring_wr;
+
+    uint64_t       packets;
+    uint64_t       transfers;
+    uint32_t       dropped[PKT_CLASSES];
+    lat_stats_t    lat[PKT_CLASSES];
+} ep_sim_t;
+
+static double xfer_ns(size_t len) {
+    return (double)(len + FS_XFER_OVERHEAD) * FS_BYTE_NS;
+}
+
+static void ep_init(ep_sim_t *ep, double poll_ns) {
+    memset(ep, 0, sizeof(*ep));
+    usb_midi_txq_init(&ep->q);
+    ep->poll_ns = poll_ns;
+}
+
+/* usb_midi_tx_kick_i : lance le lot en attente si l'endpoint est libre. */
+static void ep_kick(ep_sim_t *ep, double now) {
+    size_t len = 0U;
+    const uint8_t *buf = usb_midi_txq_start(&ep->q, &len);
+
+    if (buf == NULL) {
+        return;
+    }
+    CHECK(!ep->in_flight);
+    CHECK((len > 0U) && (len <= USB_MIDI_EP_SIZE) && ((len % USB_MIDI_PACKET_SIZE) == 0U));
+    CHECK_EQ(len / USB_MIDI_PACKET_SIZE, ep->ring_wr - ep->ring_rd);
+    memcpy(ep->snapshot, buf, len);
+    ep->buf = buf;
+    ep->len = len;
+    ep->in_flight = true;
+
+    /* Les données partent au premier jeton IN suivant. */
+    const double t = (ep->poll_ns > 0.0) ? (ceil(now / ep->poll_ns) * ep->poll_ns) : now;
+    ep->done_at = t + xfer_ns(len);
+}
+
+/* Transferts terminés jusqu'à `t` : contrôle des paquets reçus, usb_midi_in_cb. */
+static void ep_run_until(ep_sim_t *ep, double t) {
+    while (ep->in_flight && (ep->done_at <= t)) {
+        CHECK(memcmp(ep->buf, ep->snapshot, ep->len) == 0);
+        for (size_t i = 0U; i < ep->len; i += USB_MIDI_PACKET_SIZE) {
+            CHECK(ep->ring_rd != ep->ring_wr);
+            const ring_entry_t *e = &ep->ring[ep->ring_rd % RING_SIZE];
+            CHECK(memcmp(&ep->buf[i], e->pkt, USB_MIDI_PACKET_SIZE) == 0);
+            lat_stats_t *ls = &ep->lat[e->cls];
+            const double lat = ep->done_at - e->t_put;
+            ls->sum += lat;
+            ls->max = (lat > ls->max) ? lat : ls->max;
+            ls->n++;
+            ep->ring_rd++;
+        }
+        ep->packets += ep->len / USB_MIDI_PACKET_SIZE;
+        ep->transfers++;
+        ep->in_flight = false;
+        usb_midi_txq_done(&ep->q);
+        ep_kick(ep, ep->done_at);
+    }
+}
+
+static bool ep_put(ep_sim_t *ep, const uint8_t *pkt, pkt_class_t cls, double now) {
+    if (!usb_midi_txq_put(&ep->q, pkt, 1U)) {
+        return false;
+    }
+    CHECK((ep->ring_wr - ep->ring_rd) < RING_SIZE);
+    ring_entry_t *e = &ep->ring[ep->ring_wr % RING_SIZE];
+    memcpy(e->pkt, pkt, USB_MIDI_PACKET_SIZE);
+    e->t_put = now;
+    e->cls = (uint8_t)cls;
+    ep->ring_wr++;
+    ep_kick(ep, now);
+    return true;
+}
+
+/* usb_midi_send : les messages non temps réel laissent la réserve libre. */
+static bool ep_send(ep_sim_t *ep, const midi_msg_t *msg, pkt_class_t cls, double now) {
+    uint8_t pkt[USB_MIDI_PACKET_SIZE];
+    const size_t need = midi_is_realtime(msg->status) ? 1U : (1U + TX_RT_RESERVE);
+
+    CHECK(usb_midi_pack(msg, CABLE, pkt));
+    if ((usb_midi_txq_room(&ep->q) >= need) && ep_put(ep, pkt, cls, now)) {
+        return true;
+    }
+    ep->dropped[cls]++;
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Débit et latence                                                           */
+/* -------------------------------------------------------------------------- */
+
+static const char *host_name(double poll_ns) {
+    return (poll_ns > 0.0) ? "IN à chaque trame de 1 ms" : "IN en continu";
+}
+
+/* Saturation : la file est remplie à chaque fin de transfert. */
+static void bench_throughput(double poll_ns) {
+    ep_sim_t ep;
+    const midi_msg_t note = { 0U, MIDI_NOTE_ON, { 60U, 100U }, MIDI_PORT_INTERNAL };
+    double t = 0.0;
+
+    ep_init(&ep, poll_ns);
+    while (t < 1.0e9) {
+        while (ep_send(&ep, &note, PKT_NOTE, t)) {
+        }
+        CHECK_EQ(usb_midi_txq_room(&ep.q), TX_RT_RESERVE);
+        CHECK(ep.in_flight);
+        t = ep.done_at;
+        ep_run_until(&ep, t);
+    }
+
+    const double sec = t * 1e-9;
+    const double per_xfer = (double)ep.packets / (double)ep.transfers;
+    printf("  débit, %s : %.0f messages/s (%.1f paquets par transfert, %.0f transferts/s), "
+           "%.0f × une ligne DIN\n",
+           host_name(poll_ns), (double)ep.packets / sec, per_xfer, (double)ep.transfers / sec,
+           ((double)ep.packets / sec) / (3125.0 / 3.0));
+    /* Hors le premier (un paquet), chaque transfert emporte un tampon rempli jusqu'à la réserve. */
+    CHECK_EQ(ep.packets, 1U + ((ep.transfers - 1U) * (USB_MIDI_PACKETS_PER_TRANSFER - TX_RT_RESERVE)));
+}
+
+/* Paquets SysEx en attente d'émission (usb_midi_send_sysex bloqué). */
+typedef struct {
+    uint8_t  msg[SIM_SYSEX_LEN];
+    uint8_t  pkts[SIM_SYSEX_LEN * USB_MIDI_PACKET_SIZE];
+    size_t   n_pkts;
+    size_t   next;
+    uint64_t sent;
+} sysex_src_t;
+
+static void sysex_pump(ep_sim_t *ep, sysex_src_t *sx, double now) {
+    while ((sx->next < sx->n_pkts) && (usb_midi_txq_room(&ep->q) > TX_RT_RESERVE)) {
+        CHECK(ep_put(ep, &sx->pkts[sx->next * USB_MIDI_PACKET_SIZE], PKT_SYSEX, now));
+        sx->next++;
+        sx->sent++;
+    }
+}
+
+/*
+ * Charge de séquenceur : horloge 24 PPQN, SIM_NOTES_PER_STEP note-off +
+ * note-on par double croche émis dans un même bloc audio, un dump SysEx
+ * toutes les deux secondes qui attend la place laissée par le reste.
+ */
+static void bench_latency(double poll_ns, uint32_t seed) {
+    static sysex_src_t sx;
+    usb_midi_sysex_packer_t sp;
+    ep_sim_t ep;
+    const double block_ns = ((double)SIM_BLOCK_FRAMES * 1e9) / (double)SIM_RATE;
+    const uint32_t blocks = (SIM_SECONDS * SIM_RATE) / SIM_BLOCK_FRAMES;
+    uint64_t sysex_total = 0U;
+
+    ep_init(&ep, poll_ns);
+    memset(&sx, 0, sizeof(sx));
+    usb_midi_sysex_packer_reset(&sp);
+
+    for (uint32_t b = 0U; b < blocks; ++b) {
+        const double t = (double)b * block_ns;
+        const uint32_t f0 = b * SIM_BLOCK_FRAMES;
+        ep_run_until(&ep, t);
+        sysex_pump(&ep, &sx, t);
+
+        /* Évènements tombant dans le bloc [f0, f0 + 16[ : émis au début du bloc. */
+        const uint32_t in_clock = (f0 + SIM_BLOCK_FRAMES - 1U) / SIM_CLOCK_FRAMES;
+        if ((in_clock * SIM_CLOCK_FRAMES) >= f0) {
+            const midi_msg_t clk = { f0, MIDI_CLOCK, { 0U, 0U }, MIDI_PORT_INTERNAL };
+            (void)ep_send(&ep, &clk, PKT_CLOCK, t);
+        }
+        const uint32_t in_step = (f0 + SIM_BLOCK_FRAMES - 1U) / SIM_STEP_FRAMES;
+        if ((in_step * SIM_STEP_FRAMES) >= f0) {
+            for (uint8_t n = 0U; n < SIM_NOTES_PER_STEP; ++n) {
+                const midi_msg_t off = { f0, (uint8_t)(MIDI_NOTE_OFF | n), { (uint8_t)(36U + n), 0U },
+                                         MIDI_PORT_INTERNAL };
+                const midi_msg_t on = { f0, (uint8_t)(MIDI_NOTE_ON | n),
+                                        { (uint8_t)(36U + n), (uint8_t)(1U + (host_rand(&seed) % 127U)) },
+                                        MIDI_PORT_INTERNAL };
+                (void)ep_send(&ep, &off, PKT_NOTE, t);
+                (void)ep_send(&ep, &on, PKT_NOTE, t);
+            }
+        }
+        if (((f0 % SIM_SYSEX_EVERY) < SIM_BLOCK_FRAMES) && (sx.next == sx.n_pkts)) {
+            make_sysex(sx.msg, SIM_SYSEX_LEN, &seed);
+            sx.n_pkts = pack_fragment(&sp, sx.msg, SIM_SYSEX_LEN, sx.pkts);
+            sx.next = 0U;
+            sysex_total += sx.n_pkts;
+            sysex_pump(&ep, &sx, t);
+        }
+
+        /* Entre deux blocs, l'émetteur SysEx est réveillé par chaque fin de transfert. */
+        const double t_end = t + block_ns;
+        while (ep.in_flight && (ep.done_at < t_end)) {
+            const double td = ep.done_at;
+            ep_run_until(&ep, td);
+            sysex_pump(&ep, &sx, td);
+        }
+    }
+    ep_run_until(&ep, INFINITY);
+
+    CHECK_EQ(ep.dropped[PKT_CLOCK], 0U);
+    CHECK_EQ(ep.dropped[PKT_NOTE], 0U);
+    CHECK_EQ(sx.next, sx.n_pkts);
+    CHECK_EQ(ep.lat[PKT_SYSEX].n, sysex_total);
+    CHECK_EQ(ep.ring_rd, ep.ring_wr);
+
+    /*
+     * Borne : le transfert en cours (au plus 64 octets) se termine, puis
+     * celui qui emporte le paquet ; en mode trame, chacun attend son jeton.
+     */
+    const double bound = (poll_ns > 0.0) ? ((2.0 * poll_ns) + xfer_ns(USB_MIDI_EP_SIZE))
+                                         : (2.0 * xfer_ns(USB_MIDI_EP_SIZE));
+    CHECK(ep.lat[PKT_CLOCK].max <= bound);
+    CHECK(ep.lat[PKT_NOTE].max <= bound);
+
+    printf("  latence, %s : horloge %.1f µs moy. %.1f µs max, notes %.1f µs moy. %.1f µs max "
+           "(borne %.1f µs), SysEx %.1f µs max ; %llu transferts, rien de perdu\n",
+           host_name(poll_ns),
+           (ep.lat[PKT_CLOCK].sum / (double)ep.lat[PKT_CLOCK].n) * 1e-3, ep.lat[PKT_CLOCK].max * 1e-3,
+           (ep.lat[PKT_NOTE].sum / (double)ep.lat[PKT_NOTE].n) * 1e-3, ep.lat[PKT_NOTE].max * 1e-3,
+           bound * 1e-3, ep.lat[PKT_SYSEX].max * 1e-3, (unsigned long long)ep.transfers);
+}
+
+/* Rafale de messages non temps réel acceptée d'un coup, endpoint libre. */
+static uint32_t burst_capacity(void) {
+    ep_sim_t ep;
+    const midi_msg_t note = { 0U, MIDI_NOTE_ON, { 60U, 100U }, MIDI_PORT_INTERNAL };
+    uint32_t n = 0U;
+
+    ep_init(&ep, FS_FRAME_NS);
+    while (ep_send(&ep, &note, PKT_NOTE, 0.0)) {
+        n++;
+    }
+    /* La réserve reste disponible pour le temps réel. */
+    const midi_msg_t clk = { 0U, MIDI_CLOCK, { 0U, 0U }, MIDI_PORT_INTERNAL };
+    for (uint32_t i = 0U; i < TX_RT_RESERVE; ++i) {
+        CHECK(ep_send(&ep, &clk, PKT_CLOCK, 0.0));
+    }
+    CHECK(!ep_send(&ep, &clk, PKT_CLOCK, 0.0));
+    return n;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : DEFAULT_SEED;
+
+    CHECK(seed != 0U);
+    test_pack();
+    test_sysex(seed);
+    test_txq();
+
+    const uint32_t burst = burst_capacity();
+    CHECK_EQ(burst, 1U + USB_MIDI_PACKETS_PER_TRANSFER - TX_RT_RESERVE);
+    CHECK(burst >= (2U * SIM_NOTES_PER_STEP));
+    printf("endpoint simulé (pleine vitesse, %u octets par transfert), rafale acceptée d'un coup : "
+           "%u messages + %u temps réel : ok\n", USB_MIDI_EP_SIZE, burst, TX_RT_RESERVE);
+
+    bench_throughput(FS_FRAME_NS);
+    bench_throughput(0.0);
+    bench_latency(FS_FRAME_NS, seed);
+    bench_latency(0.0, seed);
+    return 0;
+}
@@ -0,0 +1,367 @@
+/**
+ * @file voice_alloc_bench.c
+ * @brief Banc de voice_alloc sur hôte : contrôle contre un modèle miroir, puis 2M évènements chronométrés.
+ * @details Configuration : toutes les cartouches présentes (16 voix), 16
+ * pistes utilisant toutes les voix, politiques de vol mélangées (pistes
+ * 0..3 plus faible, 4..7 même note, autres plus ancienne), piste 8 legato,
+ * piste 9 avec une voix réservée.
+ *
+ * Phase contrôlée : chaque résultat est confronté à un miroir de l'état
+ * (propriétaire de chaque voix) : voix candidate, note interrompue
+ * annoncée, voix libre prise avant toute voix relâchée et toute voix
+ * relâchée avant un vol, note off renvoyant la voix de la note. Une
+ * cartouche est retirée puis réinsérée régulièrement.
+ *
+ * Phase chronométrée : 2M évènements denses pré-tirés (note on/off, fin de
+ * release, niveau), sans miroir ; coût moyen par évènement et part des
+ * note on ayant volé une voix.
+ *
+ * Usage : voice_alloc_bench [graine]
+ */
+
+#include "host_check.h"
+#include "voice_alloc.h"
+
+#include <string.h>
+
+#define BENCH_EVENTS          2000000U
+#define CHECK_EVENTS          400000U
+#define HOTPLUG_PERIOD        25000U
+#define NOTE_LOW              36U
+#define NOTE_SPAN             24U
+#define RESERVED_TRACK        9U
+#define RESERVED_VOICE        (VOICE_ALLOC_VOICES - 1U)
+#define LEGATO_TRACK          8U
+
+typedef enum {
+    EV_NOTE_ON = 0,
+    EV_NOTE_OFF,
+    EV_IDLE,
+    EV_LEVEL
+} ev_kind_t;
+
+typedef struct {
+    uint8_t  kind;
+    uint8_t  track;
+    uint8_t  note;        /* Note, ou voix pour EV_IDLE / EV_LEVEL. */
+    uint8_t  velocity;
+    uint16_t level;
+} ev_t;
+
+/* -------------------------------------------------------------------------- */
+/* Miroir                                                                     */
+/* -------------------------------------------------------------------------- */
+
+typedef enum {
+    V_FREE = 0,
+    V_HELD,
+    V_RELEASED
+} vstate_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t track;
+    uint8_t note;
+    uint32_t age;
+} shadow_t;
+
+static shadow_t shadow[VOICE_ALLOC_VOICES];
+static uint32_t shadow_age;
+static uint32_t shadow_available;
+static uint32_t shadow_req;
+static voice_track_cfg_t cfgs[VOICE_ALLOC_TRACKS];
+
+static uint32_t all_voices(void) {
+    return (VOICE_ALLOC_VOICES == 32) ? 0xFFFFFFFFU : ((1U << VOICE_ALLOC_VOICES) - 1U);
+}
+
+static void shadow_apply(void) {
+    if (shadow_req == shadow_available) {
+        return;
+    }
+    for (uint32_t v = 0U; v < VOICE_ALLOC_VOICES; ++v) {
+        if ((shadow_req & (1U << v)) == 0U) {
+            shadow[v].state = V_FREE;
+        }
+    }
+    shadow_available = shadow_req;
+}
+
+static uint32_t shadow_mask(uint8_t state) {
+    uint32_t m = 0U;
+    for (uint32_t v = 0U; v < VOICE_ALLOC_VOICES; ++v) {
+        if (shadow[v].state == state) {
+            m |= 1U << v;
+        }
+    }
+    return m;
+}
+
+static uint32_t candidates(uint8_t track) {
+    uint32_t others = 0U;
+    for (uint32_t t = 0U; t < VOICE_ALLOC_TRACKS; ++t) {
+        if (t != track) {
+            others |= cfgs[t].reserved;
+        }
+    }
+    return cfgs[track].eligible & shadow_available & ~others;
+}
+
+static uint8_t shadow_find(uint8_t track, uint8_t note, uint8_t state) {
+    for (uint32_t v = 0U; v < VOICE_ALLOC_VOICES; ++v) {
+        if ((shadow[v].state == state) && (shadow[v].track == track) && (shadow[v].note == note)) {
+            return (uint8_t)v;
+        }
+    }
+    return VOICE_NONE;
+}
+
+/* Voix allouée le plus tôt parmi `mask`. */
+static uint8_t shadow_oldest(uint32_t mask) {
+    uint8_t best = VOICE_NONE;
+    for (uint32_t v = 0U; v < VOICE_ALLOC_VOICES; ++v) {
+        if (((mask & (1U << v)) != 0U) &&
+            ((best == VOICE_NONE) || (shadow[v].age < shadow[best].age))) {
+            best = (uint8_t)v;
+        }
+    }
+    return best;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Mise en place                                                              */
+/* -------------------------------------------------------------------------- */
+
+static void setup(void) {
+    voice_alloc_init();
+    memset(shadow, 0, sizeof(shadow));
+    shadow_age = 0U;
+    for (uint8_t c = 0U; c < BRICK_MAX_CARTRIDGES; ++c) {
+        voice_alloc_set_cart_voices(c, BRICK_MAX_VOICES_PER_CART);
+    }
+    shadow_available = 0U;
+    shadow_req = all_voices();
+
+    for (uint8_t t = 0U; t < VOICE_ALLOC_TRACKS; ++t) {
+        voice_track_cfg_t *c = &cfgs[t];
+        c->eligible = all_voices();
+        c->reserved = (t == RESERVED_TRACK) ? (1U << RESERVED_VOICE) : 0U;
+        c->steal = (t < 4U) ? VOICE_STEAL_QUIETEST
+                 : ((t < 8U) ? VOICE_STEAL_SAME_NOTE : VOICE_STEAL_OLDEST);
+        c->legato = (t == LEGATO_TRACK);
+        CHECK(voice_alloc_config_track(t, c));
+    }
+
+    /* Réservation chevauchante refusée, réservation hors `eligible` aussi. */
+    voice_track_cfg_t bad = cfgs[0];
+    bad.reserved = 1U << RESERVED_VOICE;
+    CHECK(!voice_alloc_config_track(0U, &bad));
+    bad.eligible = 1U;
+    bad.reserved = 2U;
+    CHECK(!voice_alloc_config_track(0U, &bad));
+}
+
+static void make_event(uint32_t *rng, ev_t *ev) {
+    const uint32_t r = host_rand(rng);
+    const uint32_t kind = r % 100U;
+
+    ev->track = (uint8_t)((r >> 8) % VOICE_ALLOC_TRACKS);
+    ev->note = (uint8_t)(NOTE_LOW + ((r >> 12) % NOTE_SPAN));
+    ev->velocity = (uint8_t)(1U + ((r >> 20) % 127U));
+    ev->level = (uint16_t)(r >> 16);
+    if (kind < 50U) {
+        ev->kind = EV_NOTE_ON;
+    } else if (kind < 85U) {
+        ev->kind = EV_NOTE_OFF;
+    } else if (kind < 95U) {
+        ev->kind = EV_IDLE;
+        ev->note = (uint8_t)((r >> 12) % VOICE_ALLOC_VOICES);
+    } else {
+        ev->kind = EV_LEVEL;
+        ev->note = (uint8_t)((r >> 12) % VOICE_ALLOC_VOICES);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Phase contrôlée                                                            */
+/* -------------------------------------------------------------------------- */
+
+static void checked_note_on(const ev_t *ev) {
+    voice_alloc_result_t res;
+
+    shadow_apply();
+    const uint32_t cand = candidates(ev->track);
+    const uint32_t held = shadow_mask(V_HELD);
+    const uint32_t released = shadow_mask(V_RELEASED);
+    const uint32_t idle = cand & ~(held | released);
+    const uint8_t same = (shadow_find(ev->track, ev->note, V_HELD) != VOICE_NONE)
+                       ? shadow_find(ev->track, ev->note, V_HELD)
+                       : shadow_find(ev->track, ev->note, V_RELEASED);
+
+    const bool ok = voice_alloc_note_on(ev->track, ev->note, ev->velocity, &res);
+    CHECK_EQ(ok, cand != 0U);
+    if (!ok) {
+        return;
+    }
+
+    const uint8_t v = res.voice;
+    CHECK(v < VOICE_ALLOC_VOICES);
+    CHECK((cand & (1U << v)) != 0U);
+    CHECK_EQ(res.cart, v / BRICK_MAX_VOICES_PER_CART);
+    CHECK_EQ(res.cart_voice, v % BRICK_MAX_VOICES_PER_CART);
+
+    const shadow_t *s = &shadow[v];
+    if (s->state == V_FREE) {
+        CHECK_EQ(res.prev_track, VOICE_NONE);
+        CHECK_EQ(res.prev_note, VOICE_NONE);
+    } else {
+        CHECK_EQ(res.prev_track, s->track);
+        CHECK_EQ(res.prev_note, s->note);
+    }
+
+    switch (res.flags) {
+    case VOICE_ALLOC_LEGATO:
+        CHECK_EQ(ev->track, LEGATO_TRACK);
+        CHECK_EQ(s->state, V_HELD);
+        CHECK_EQ(s->track, ev->track);
+        break;
+    case VOICE_ALLOC_RETRIGGER:
+        CHECK_EQ(v, same);
+        break;
+    case VOICE_ALLOC_STOLEN:
+        /* Vol seulement sans voix libre ni relâchée parmi les candidates. */
+        CHECK_EQ(idle, 0U);
+        CHECK_EQ(cand & released, 0U);
+        CHECK_EQ(s->state, V_HELD);
+        if (cfgs[ev->track].steal == VOICE_STEAL_OLDEST) {
+            CHECK_EQ(v, shadow_oldest(cand));
+        }
+        break;
+    case 0U:
+        CHECK((same == VOICE_NONE) || ((cand & (1U << same)) == 0U));
+        if (idle != 0U) {
+            CHECK_EQ(s->state, V_FREE);
+        } else {
+            CHECK_EQ(v, shadow_oldest(cand & released));
+        }
+        break;
+    default:
+        CHECK(false);
+        break;
+    }
+
+    shadow[v].state = V_HELD;
+    shadow[v].track = ev->track;
+    shadow[v].note = ev->note;
+    shadow[v].age = ++shadow_age;
+}
+
+static void checked_phase(uint32_t seed) {
+    uint32_t rng = seed;
+    uint32_t removed = 0U;
+    ev_t ev;
+
+    setup();
+    for (uint32_t i = 0U; i < CHECK_EVENTS; ++i) {
+        if ((i % HOTPLUG_PERIOD) == (HOTPLUG_PERIOD - 1U)) {
+            /* Retrait puis réinsertion de la dernière cartouche. */
+            const uint8_t cart = BRICK_MAX_CARTRIDGES - 1U;
+            const uint8_t n = (removed == 0U) ? 0U : BRICK_MAX_VOICES_PER_CART;
+            voice_alloc_set_cart_voices(cart, n);
+            shadow_req = (shadow_req & ~VOICE_ALLOC_CART_MASK(cart)) |
+                         ((n == 0U) ? 0U : VOICE_ALLOC_CART_MASK(cart));
+            removed ^= 1U;
+        }
+
+        make_event(&rng, &ev);
+        switch (ev.kind) {
+        case EV_NOTE_ON:
+            checked_note_on(&ev);
+            break;
+        case EV_NOTE_OFF: {
+            shadow_apply();
+            const uint8_t want = shadow_find(ev.track, ev.note, V_HELD);
+            CHECK_EQ(voice_alloc_note_off(ev.track, ev.note), want);
+            if (want != VOICE_NONE) {
+                shadow[want].state = V_RELEASED;
+            }
+            break;
+        }
+        case EV_IDLE:
+            voice_alloc_voice_idle(ev.note);
+            shadow[ev.note].state = V_FREE;
+            break;
+        default:
+            voice_alloc_set_level(ev.note, ev.level);
+            break;
+        }
+    }
+
+    voice_alloc_all_off(VOICE_ALLOC_TRACKS);
+    for (uint32_t v = 0U; v < VOICE_ALLOC_VOICES; ++v) {
+        shadow[v].state = V_FREE;
+    }
+    ev.track = 0U;
+    ev.note = NOTE_LOW;
+    ev.velocity = 100U;
+    checked_note_on(&ev);
+
+    voice_alloc_stats_t st;
+    voice_alloc_get_stats(&st);
+    CHECK(st.active_max <= VOICE_ALLOC_VOICES);
+    printf("contrôle : %u évènements, %u allocations, %u vols, %u legato, %u réattaques : ok\n",
+           CHECK_EVENTS, st.allocs, st.steals, st.legato, st.retriggers);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Phase chronométrée                                                         */
+/* -------------------------------------------------------------------------- */
+
+static void timed_phase(uint32_t seed) {
+    static ev_t events[BENCH_EVENTS];
+    uint32_t rng = seed ^ 0x9E3779B9U;
+    uint32_t sink = 0U;
+    voice_alloc_result_t res;
+
+    for (uint32_t i = 0U; i < BENCH_EVENTS; ++i) {
+        make_event(&rng, &events[i]);
+    }
+    setup();
+
+    const double t0 = host_now();
+    for (uint32_t i = 0U; i < BENCH_EVENTS; ++i) {
+        const ev_t *ev = &events[i];
+        switch (ev->kind) {
+        case EV_NOTE_ON:
+            if (voice_alloc_note_on(ev->track, ev->note, ev->velocity, &res)) {
+                sink += res.voice;
+            }
+            break;
+        case EV_NOTE_OFF:
+            sink += voice_alloc_note_off(ev->track, ev->note);
+            break;
+        case EV_IDLE:
+            voice_alloc_voice_idle(ev->note);
+            break;
+        default:
+            voice_alloc_set_level(ev->note, ev->level);
+            break;
+        }
+    }
+    const double dt = host_now() - t0;
+
+    voice_alloc_stats_t st;
+    voice_alloc_get_stats(&st);
+    printf("banc : %u évènements, %.1f ns/évènement, %.0f %% des note on volent (%u/%u) [%u]\n",
+           BENCH_EVENTS, (dt * 1e9) / (double)BENCH_EVENTS,
+           (100.0 * (double)st.steals) / (double)st.allocs, st.steals, st.allocs, sink & 1U);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 0x564F4943U;
+
+    CHECK(seed != 0U);
+    checked_phase(seed);
+    timed_phase(seed);
+    return 0;
+}
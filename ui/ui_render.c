@@ -0,0 +1,265 @@
+/**
+ * @file ui_render.c
+ * @brief Page principale (transport, pistes, cartouches, mixeur) depuis la vue d'état.
+ * @ingroup ui
+ */
+
+#include "ui_render.h"
+#include "display_gfx.h"
+#include "drv_display.h"
+#include "drv_leds_addr.h"
+
+/* Disposition de la page (pixels). */
+#define UI_HEADER_Y           0
+#define UI_TRACKS_Y           12
+#define UI_TRACK_W            8
+#define UI_TRACK_H            8
+#define UI_STEP_BAR_Y         23
+#define UI_STEP_TEXT_Y        28
+#define UI_CARTS_Y            37
+#define UI_CART_W             32
+#define UI_FOOTER_Y           56
+
+/* Libellés d'état de slot (ordre de cart_slot_state_t). */
+static const char *const ui_slot_label[] = { "--", "..", "OK", "!!" };
+
+static ui_render_stats_t ui_stats;
+static display_gfx_t ui_gfx;
+
+static THD_WORKING_AREA(uiRenderThreadWA, UI_RENDER_THREAD_STACK_SIZE);
+
+static inline uint32_t ui_cycles_to_us(rtcnt_t cycles) {
+    return (uint32_t)(((uint64_t)cycles * 1000000U) / STM32_CORE_CK);
+}
+
+/* Formatage minimal (pas de printf dans le firmware) : retournent la fin de chaîne. */
+static char *ui_put_str(char *p, const char *s) {
+    while (*s != '\0') {
+        *p++ = *s++;
+    }
+    *p = '\0';
+    return p;
+}
+
+/* Entier décimal sur au moins `width` caractères, complété par `pad` à gauche. */
+static char *ui_put_uint(char *p, uint32_t v, uint8_t width, char pad) {
+    char tmp[10];
+    uint8_t n = 0U;
+
+    do {
+        tmp[n++] = (char)('0' + (v % 10U));
+        v /= 10U;
+    } while ((v != 0U) && (n < sizeof(tmp)));
+    while (width > n) {
+        *p++ = pad;
+        width--;
+    }
+    while (n > 0U) {
+        *p++ = tmp[--n];
+    }
+    *p = '\0';
+    return p;
+}
+
+/* Gain 0..1 en pixels 0..w. */
+static int16_t ui_gain_px(float gain, int16_t w) {
+    if (gain <= 0.0f) {
+        return 0;
+    }
+    if (gain >= 1.0f) {
+        return w;
+    }
+    return (int16_t)(gain * (float)w);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Dessin                                                                     */
+/* -------------------------------------------------------------------------- */
+
+static void ui_draw_header(display_gfx_t *g, const ui_seq_state_t *seq) {
+    char txt[24];
+    char *p;
+
+    p = ui_put_str(txt, seq->playing ? "> PTN " : "# PTN ");
+    (void)ui_put_uint(p, seq->pattern_id, 3U, '0');
+    (void)display_gfx_text(g, 0, UI_HEADER_Y, txt, 1U, GFX_SET);
+    if (seq->song_row != UI_SONG_ROW_NONE) {
+        p = ui_put_str(txt, "S");
+        (void)ui_put_uint(p, seq->song_row + 1U, 2U, '0');
+        (void)display_gfx_text(g, 66, UI_HEADER_Y, txt, 1U, GFX_SET);
+    }
+    p = ui_put_str(txt, seq->ext_clock ? "E" : " ");
+    p = ui_put_uint(p, seq->tempo_x10 / 10U, 3U, ' ');
+    p = ui_put_str(p, ".");
+    (void)ui_put_uint(p, seq->tempo_x10 % 10U, 1U, '0');
+    (void)display_gfx_text(g, (int16_t)(GFX_WIDTH - display_gfx_text_width(txt, 1U)),
+                           UI_HEADER_Y, txt, 1U, GFX_SET);
+    display_gfx_hline(g, 0, 9, (int16_t)GFX_WIDTH, GFX_SET);
+}
+
+/* Une case par piste : pleine si la piste joue au step courant, tiret si muette. */
+static void ui_draw_tracks(display_gfx_t *g, const ui_seq_state_t *seq) {
+    for (uint8_t t = 0U; t < BRICK_NUM_TRACKS; ++t) {
+        const int16_t x = (int16_t)(t * UI_TRACK_W);
+        const uint16_t bit = (uint16_t)(1U << t);
+
+        if ((seq->muted_mask & bit) != 0U) {
+            display_gfx_hline(g, (int16_t)(x + 1), UI_TRACKS_Y + UI_TRACK_H / 2,
+                              UI_TRACK_W - 3, GFX_SET);
+        } else if (seq->playing && ((seq->trig_mask & bit) != 0U)) {
+            display_gfx_fill_rect(g, x, UI_TRACKS_Y, UI_TRACK_W - 1, UI_TRACK_H, GFX_SET);
+        } else {
+            display_gfx_rect(g, x, UI_TRACKS_Y, UI_TRACK_W - 1, UI_TRACK_H, GFX_SET);
+        }
+    }
+}
+
+static void ui_draw_position(display_gfx_t *g, const ui_seq_state_t *seq) {
+    char txt[24];
+    char *p;
+    const uint8_t len = (seq->pattern_len != 0U) ? seq->pattern_len : 1U;
+    const int16_t fill = (int16_t)(((uint32_t)(seq->step + 1U) * (GFX_WIDTH - 2U)) / len);
+
+    display_gfx_rect(g, 0, UI_STEP_BAR_Y, (int16_t)GFX_WIDTH, 3, GFX_SET);
+    if (seq->playing) {
+        display_gfx_hline(g, 1, UI_STEP_BAR_Y + 1, fill, GFX_SET);
+    }
+
+    p = ui_put_str(txt, "STEP ");
+    p = ui_put_uint(p, seq->step + 1U, 2U, '0');
+    p = ui_put_str(p, "/");
+    (void)ui_put_uint(p, len, 2U, '0');
+    (void)display_gfx_text(g, 0, UI_STEP_TEXT_Y, txt, 1U, GFX_SET);
+    if (seq->fill) {
+        const int16_t x = (int16_t)(GFX_WIDTH - display_gfx_text_width("FILL", 1U) - 2);
+        (void)display_gfx_text(g, (int16_t)(x + 1), UI_STEP_TEXT_Y, "FILL", 1U, GFX_SET);
+        display_gfx_invert_rect(g, x, UI_STEP_TEXT_Y - 1, (int16_t)(GFX_WIDTH - x), 9);
+    }
+}
+
+/* Une colonne par slot : nom (tronqué), état et voix, niveau de la route principale. */
+static void ui_draw_carts(display_gfx_t *g, const ui_cart_state_t *carts, const ui_mix_state_t *mix) {
+    char txt[16];
+
+    for (uint8_t s = 0U; s < BRICK_MAX_CARTRIDGES; ++s) {
+        const ui_cart_slot_t *slot = &carts->slots[s];
+        const int16_t x = (int16_t)(s * UI_CART_W);
+        const uint8_t st = (slot->state < 4U) ? slot->state : 3U;
+
+        display_gfx_set_clip(g, x, UI_CARTS_Y, UI_CART_W - 2, 16);
+        if (slot->name[0] != '\0') {
+            (void)display_gfx_text(g, x, UI_CARTS_Y, slot->name, 1U, GFX_SET);
+        } else {
+            (void)ui_put_uint(ui_put_str(txt, "CART"), s + 1U, 1U, '0');
+            (void)display_gfx_text(g, x, UI_CARTS_Y, txt, 1U, GFX_SET);
+        }
+        char *p = ui_put_str(txt, ui_slot_label[st]);
+        p = ui_put_str(p, " ");
+        p = ui_put_uint(p, slot->voices, 1U, '0');
+        (void)ui_put_str(p, "v");
+        (void)display_gfx_text(g, x, UI_CARTS_Y + 8, txt, 1U, GFX_SET);
+        display_gfx_reset_clip(g);
+
+        /* Route principale : barre au niveau du gain si active, trait fin sinon. */
+        const int16_t w = UI_CART_W - 4;
+        if ((mix->to_main_mask & (1U << s)) != 0U) {
+            display_gfx_fill_rect(g, x, UI_FOOTER_Y - 3, ui_gain_px(mix->gain_main[s], w), 2, GFX_SET);
+        } else {
+            display_gfx_hline(g, x, UI_FOOTER_Y - 2, w, GFX_SET);
+        }
+    }
+}
+
+static void ui_draw_footer(display_gfx_t *g, const ui_mix_state_t *mix) {
+    const int16_t w = 64;
+
+    (void)display_gfx_text(g, 0, UI_FOOTER_Y, "VOL", 1U, GFX_SET);
+    display_gfx_rect(g, 24, UI_FOOTER_Y + 1, w + 2, 6, GFX_SET);
+    display_gfx_fill_rect(g, 25, UI_FOOTER_Y + 2, ui_gain_px(mix->master_volume, w), 4, GFX_SET);
+}
+
+static void ui_draw_page(display_gfx_t *g, const ui_snapshot_t *snap) {
+    display_gfx_fill(g, GFX_CLEAR);
+    ui_draw_header(g, snap->seq);
+    ui_draw_tracks(g, snap->seq);
+    ui_draw_position(g, snap->seq);
+    ui_draw_carts(g, snap->carts, snap->mix);
+    ui_draw_footer(g, snap->mix);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Thread                                                                     */
+/* -------------------------------------------------------------------------- */
+
+static THD_FUNCTION(uiRenderThread, arg) {
+    (void)arg;
+    chRegSetThreadName("uiRender");
+
+    ui_snapshot_t snap;
+    uint32_t last_version = 0U;
+    const systime_t period = TIME_US2I(1000000U / UI_RENDER_FPS);
+    systime_t next = chVTGetSystemTimeX();
+
+    while (true) {
+        systime_t prev = next;
+        next = chTimeAddX(next, period);
+
+        if (!ui_snapshot_acquire(&snap, last_version)) {
+            chSysLock();
+            ui_stats.skipped++;
+            chSysUnlock();
+        } else {
+            last_version = snap.version;
+
+            const rtcnt_t t0 = chSysGetRealtimeCounterX();
+            drv_display_fb_t *fb = drv_display_begin();
+            display_gfx_bind(&ui_gfx, fb, drv_display_mark);
+            ui_draw_page(&ui_gfx, &snap);
+            drv_display_end();
+            const uint32_t us = ui_cycles_to_us(chSysGetRealtimeCounterX() - t0);
+
+            chSysLock();
+            ui_stats.frames++;
+            ui_stats.render_us_last = us;
+            if (us > ui_stats.render_us_max) {
+                ui_stats.render_us_max = us;
+            }
+            chSysUnlock();
+        }
+
+        /* LEDs : n'émet que si une couleur a changé, sans attendre la fin du DMA. */
+        (void)drv_leds_addr_render();
+
+        /* Échéance dépassée : repart de maintenant, sans rattrapage. */
+        const systime_t now = chVTGetSystemTimeX();
+        if (!chTimeIsInRangeX(now, prev, next)) {
+            prev = now;
+            next = chTimeAddX(now, period);
+        }
+        chThdSleepUntilWindowed(prev, next);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* API publique                                                               */
+/* -------------------------------------------------------------------------- */
+
+void ui_render_start(void) {
+    static bool started = false;
+
+    if (started) {
+        return;
+    }
+    started = true;
+    (void)chThdCreateStatic(uiRenderThreadWA, sizeof(uiRenderThreadWA),
+                            UI_RENDER_THREAD_PRIORITY, uiRenderThread, NULL);
+}
+
+void ui_render_get_stats(ui_render_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    chSysLock();
+    *st = ui_stats;
+    chSysUnlock();
+}
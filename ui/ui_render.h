@@ -0,0 +1,41 @@
+/**
+ * @file ui_render.h
+ * @brief Thread de rendu de l'UI : page principale dessinée depuis l'instantané d'état.
+ * @details À chaque échéance (UI_RENDER_FPS), le thread acquiert la vue de
+ * ui_snapshot. Si sa version n'a pas bougé, l'image est sautée sans toucher
+ * au tampon de l'écran. Sinon, la page est redessinée entièrement dans le
+ * tampon arrière de drv_display (display_gfx), et le pilote n'envoie que
+ * les octets réellement changés.
+ *
+ * Le rendu ne lit que la vue immuable : aucun accès à l'état du
+ * séquenceur, du mixeur ou des cartouches, aucun verrou partagé avec les
+ * threads temps réel. Seul le mutex du tampon d'écran est pris, le temps
+ * du dessin.
+ *
+ * @ingroup ui
+ */
+
+#ifndef UI_RENDER_H
+#define UI_RENDER_H
+
+#include "ch.h"
+#include "hal.h"
+#include "ui_snapshot.h"
+
+#define UI_RENDER_FPS                 30U
+#define UI_RENDER_THREAD_STACK_SIZE   1024U
+#define UI_RENDER_THREAD_PRIORITY     (NORMALPRIO - 2)
+
+typedef struct {
+    uint32_t frames;              /* Images redessinées. */
+    uint32_t skipped;             /* Échéances sans nouvelle version. */
+    uint32_t render_us_last;
+    uint32_t render_us_max;
+} ui_render_stats_t;
+
+/* Après drv_display_start et ui_snapshot_init. */
+void ui_render_start(void);
+
+void ui_render_get_stats(ui_render_stats_t *st);
+
+#endif /* UI_RENDER_H */
@@ -0,0 +1,145 @@
+/**
+ * @file ui_snapshot.c
+ * @brief Triples tampons par section et version globale, échanges atomiques.
+ * @ingroup ui
+ */
+
+#include "ui_snapshot.h"
+#include <stddef.h>
+#include <string.h>
+
+#define SNAP_INDEX_MASK       0x03U
+#define SNAP_FRESH            0x04U       /* Tampon du milieu pas encore lu. */
+
+/*
+ * Indices des trois tampons d'une section : `back` à l'écrivain, `front`
+ * au lecteur, `middle` partagé (échangé atomiquement, drapeau de fraîcheur).
+ */
+typedef struct {
+    uint8_t back;
+    uint8_t front;
+    uint8_t middle;
+    uint8_t *bufs;                /* 3 × size. */
+    uint8_t *last;                /* Dernière publication, côté écrivain. */
+    size_t   size;
+} snap_section_t;
+
+typedef enum {
+    SNAP_SEQ = 0,
+    SNAP_MIX,
+    SNAP_CARTS,
+    SNAP_SECTIONS
+} snap_id_t;
+
+static ui_seq_state_t  snap_seq[3];
+static ui_mix_state_t  snap_mix[3];
+static ui_cart_state_t snap_carts[3];
+static ui_seq_state_t  snap_seq_last;
+static ui_mix_state_t  snap_mix_last;
+static ui_cart_state_t snap_carts_last;
+
+static snap_section_t snap_sec[SNAP_SECTIONS] = {
+    [SNAP_SEQ]   = { 0U, 2U, 1U, (uint8_t *)snap_seq, (uint8_t *)&snap_seq_last, sizeof(ui_seq_state_t) },
+    [SNAP_MIX]   = { 0U, 2U, 1U, (uint8_t *)snap_mix, (uint8_t *)&snap_mix_last, sizeof(ui_mix_state_t) },
+    [SNAP_CARTS] = { 0U, 2U, 1U, (uint8_t *)snap_carts, (uint8_t *)&snap_carts_last, sizeof(ui_cart_state_t) },
+};
+
+static uint32_t snap_version = 0U;
+static ui_snapshot_stats_t snap_stats;
+
+/* -------------------------------------------------------------------------- */
+/* Triple tampon                                                              */
+/* -------------------------------------------------------------------------- */
+
+static bool snap_publish(snap_section_t *s, const void *src) {
+    if (src == NULL) {
+        return false;
+    }
+    if (memcmp(s->last, src, s->size) == 0) {
+        __atomic_fetch_add(&snap_stats.unchanged, 1U, __ATOMIC_RELAXED);
+        return false;
+    }
+    memcpy(s->last, src, s->size);
+    memcpy(&s->bufs[s->back * s->size], src, s->size);
+
+    /* Le contenu est visible avant l'échange, l'échange avant la version. */
+    const uint8_t old = __atomic_exchange_n(&s->middle, (uint8_t)(s->back | SNAP_FRESH),
+                                            __ATOMIC_ACQ_REL);
+    s->back = (uint8_t)(old & SNAP_INDEX_MASK);
+    __atomic_fetch_add(&snap_version, 1U, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&snap_stats.published, 1U, __ATOMIC_RELAXED);
+    return true;
+}
+
+static const void *snap_take(snap_section_t *s) {
+    if ((__atomic_load_n(&s->middle, __ATOMIC_ACQUIRE) & SNAP_FRESH) != 0U) {
+        const uint8_t old = __atomic_exchange_n(&s->middle, s->front, __ATOMIC_ACQ_REL);
+        s->front = (uint8_t)(old & SNAP_INDEX_MASK);
+    }
+    return &s->bufs[s->front * s->size];
+}
+
+/* -------------------------------------------------------------------------- */
+/* API                                                                        */
+/* -------------------------------------------------------------------------- */
+
+void ui_snapshot_init(void) {
+    memset(snap_seq, 0, sizeof(snap_seq));
+    memset(snap_mix, 0, sizeof(snap_mix));
+    memset(snap_carts, 0, sizeof(snap_carts));
+    memset(&snap_seq_last, 0, sizeof(snap_seq_last));
+    memset(&snap_mix_last, 0, sizeof(snap_mix_last));
+    memset(&snap_carts_last, 0, sizeof(snap_carts_last));
+    for (uint32_t i = 0U; i < (uint32_t)SNAP_SECTIONS; i++) {
+        snap_sec[i].back = 0U;
+        snap_sec[i].middle = 1U;
+        snap_sec[i].front = 2U;
+    }
+    memset(&snap_stats, 0, sizeof(snap_stats));
+    /* Version 1 : la première acquisition (last_version = 0) rend l'état initial. */
+    __atomic_store_n(&snap_version, 1U, __ATOMIC_RELEASE);
+}
+
+bool ui_snapshot_publish_seq(const ui_seq_state_t *st) {
+    return snap_publish(&snap_sec[SNAP_SEQ], st);
+}
+
+bool ui_snapshot_publish_mix(const ui_mix_state_t *st) {
+    return snap_publish(&snap_sec[SNAP_MIX], st);
+}
+
+bool ui_snapshot_publish_carts(const ui_cart_state_t *st) {
+    return snap_publish(&snap_sec[SNAP_CARTS], st);
+}
+
+bool ui_snapshot_acquire(ui_snapshot_t *snap, uint32_t last_version) {
+    /*
+     * Version lue avant les échanges : une publication concurrente est soit
+     * déjà prise, soit signalée par une version plus récente à l'image suivante.
+     */
+    const uint32_t v = __atomic_load_n(&snap_version, __ATOMIC_ACQUIRE);
+
+    if (snap == NULL) {
+        return false;
+    }
+    if (v == last_version) {
+        snap_stats.stale++;
+        return false;
+    }
+    snap->version = v;
+    snap->seq = (const ui_seq_state_t *)snap_take(&snap_sec[SNAP_SEQ]);
+    snap->mix = (const ui_mix_state_t *)snap_take(&snap_sec[SNAP_MIX]);
+    snap->carts = (const ui_cart_state_t *)snap_take(&snap_sec[SNAP_CARTS]);
+    snap_stats.acquired++;
+    return true;
+}
+
+void ui_snapshot_get_stats(ui_snapshot_stats_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    st->published = __atomic_load_n(&snap_stats.published, __ATOMIC_RELAXED);
+    st->unchanged = __atomic_load_n(&snap_stats.unchanged, __ATOMIC_RELAXED);
+    st->acquired = snap_stats.acquired;
+    st->stale = snap_stats.stale;
+}
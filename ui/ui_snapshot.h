@@ -0,0 +1,102 @@
+/**
+ * @file ui_snapshot.h
+ * @brief Instantanés d'état pour l'UI, publiés sans verrou par les threads propriétaires.
+ * @details Trois sections, chacune écrite par un seul thread :
+ *  - séquenceur (transport, tempo, pattern, position) : thread audio ;
+ *  - mixeur (volume maître, routes) : thread audio ;
+ *  - cartouches (état, nom, voix) : thread du gestionnaire de cartouches.
+ *
+ * Chaque section est un triple tampon : l'écrivain remplit son tampon
+ * arrière puis l'échange atomiquement avec le tampon du milieu (marqué
+ * frais) ; le lecteur échange le milieu avec son tampon avant s'il est
+ * frais. Ni l'un ni l'autre n'attend jamais : l'écrivain ne voit pas le
+ * lecteur, et le rendu ne prend aucun verrou partagé avec l'audio ou le
+ * séquenceur (audio_control.lock notamment).
+ *
+ * Une publication identique à la précédente est ignorée (comparaison
+ * côté écrivain), si bien que l'écrivain peut publier à chaque bloc.
+ * Chaque publication effective incrémente une version globale : le rendu
+ * saute l'image entière si elle n'a pas bougé.
+ *
+ * La vue acquise reste immuable jusqu'à l'acquisition suivante par le même
+ * lecteur (un seul lecteur : le thread d'UI).
+ * Module sans dépendance à ChibiOS (compilable sur hôte).
+ *
+ * @ingroup ui
+ */
+
+#ifndef UI_SNAPSHOT_H
+#define UI_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "brick_config.h"
+
+#define UI_CART_NAME_LEN              12U
+#define UI_SONG_ROW_NONE              0xFFU
+
+typedef struct {
+    uint16_t tempo_x10;
+    uint16_t pattern_id;
+    uint8_t  pattern_len;
+    uint8_t  step;                /* Dernier step joué dans le pattern. */
+    uint8_t  song_row;            /* UI_SONG_ROW_NONE hors mode song. */
+    bool     playing;
+    bool     fill;
+    bool     ext_clock;
+    uint16_t muted_mask;          /* Une piste par bit. */
+    uint16_t trig_mask;           /* Pistes ayant un trig actif au step courant. */
+} ui_seq_state_t;
+
+typedef struct {
+    float   master_volume;
+    float   gain_main[BRICK_MAX_CARTRIDGES];
+    float   gain_cue[BRICK_MAX_CARTRIDGES];
+    uint8_t to_main_mask;
+    uint8_t to_cue_mask;
+} ui_mix_state_t;
+
+typedef struct {
+    uint8_t state;                /* cart_slot_state_t. */
+    uint8_t voices;
+    char    name[UI_CART_NAME_LEN + 1U];
+} ui_cart_slot_t;
+
+typedef struct {
+    ui_cart_slot_t slots[BRICK_MAX_CARTRIDGES];
+} ui_cart_state_t;
+
+/* Vue d'une image : valide jusqu'à l'acquisition suivante. */
+typedef struct {
+    uint32_t               version;
+    const ui_seq_state_t  *seq;
+    const ui_mix_state_t  *mix;
+    const ui_cart_state_t *carts;
+} ui_snapshot_t;
+
+typedef struct {
+    uint32_t published;           /* Publications effectives, toutes sections. */
+    uint32_t unchanged;           /* Publications identiques ignorées. */
+    uint32_t acquired;            /* Vues renouvelées. */
+    uint32_t stale;               /* Acquisitions sans nouvelle version. */
+} ui_snapshot_stats_t;
+
+void ui_snapshot_init(void);
+
+/*
+ * Écrivain unique par section ; vrai si l'état a changé. Comparaison octet
+ * à octet : l'état source est mis à zéro (memset) avant d'être rempli.
+ */
+bool ui_snapshot_publish_seq(const ui_seq_state_t *st);
+bool ui_snapshot_publish_mix(const ui_mix_state_t *st);
+bool ui_snapshot_publish_carts(const ui_cart_state_t *st);
+
+/*
+ * Lecteur : renouvelle la vue si la version diffère de `last_version`,
+ * sinon la laisse intacte et retourne faux (image à sauter).
+ */
+bool ui_snapshot_acquire(ui_snapshot_t *snap, uint32_t last_version);
+
+void ui_snapshot_get_stats(ui_snapshot_stats_t *st);
+
+#endif /* UI_SNAPSHOT_H */